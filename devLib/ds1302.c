@@ -26,8 +26,10 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <time.h>
 
 #include <wiringPi.h>
+#include <wiringPiBitBang.h>
 
 #include "ds1302.h"
 
@@ -49,6 +51,20 @@
 
 static int dPin, cPin, sPin ;
 
+// The shifting is done by the bit-bang engine: pins resolved to register
+//	handles once, half-microsecond pacing per clock phase (the chip is
+//	good to ~1MHz at 3v3). A full 8-byte clock burst then takes ~100uS
+//	instead of the ~2mS of a delayMicroseconds(1) around every edge.
+
+static int dsBB = -1 ;
+
+
+static void dsPauseNs (unsigned int ns)
+{
+  delayNanoseconds (ns) ;	// calibrated spin - the raw clock_gettime loop it replaces overshot by the call cost
+}
+
+
 /*
  * dsShiftIn:
  *	Shift a number in from the chip, LSB first. Note that the data is
@@ -58,19 +74,7 @@ static int dPin, cPin, sPin ;
 
 static unsigned int dsShiftIn (void)
 {
-  uint8_t value = 0 ;
-  int i ;
-
-  pinMode (dPin, INPUT) ;	delayMicroseconds (1) ;
-
-  for (i = 0 ; i < 8 ; ++i)
-  {
-    value |= (digitalRead (dPin) << i) ;
-    digitalWrite (cPin, HIGH) ; delayMicroseconds (1) ;
-    digitalWrite (cPin, LOW) ;	delayMicroseconds (1) ;
-  }
-
-  return value;
+  return wpiBitBangShiftIn (dsBB, 8) ;
 }
 
 
@@ -83,16 +87,7 @@ static unsigned int dsShiftIn (void)
 
 static void dsShiftOut (unsigned int data)
 {
-  int i ;
-
-  pinMode (dPin, OUTPUT) ;
-
-  for (i = 0 ; i < 8 ; ++i)
-  {
-    digitalWrite (dPin, data & (1 << i)) ;	delayMicroseconds (1) ;
-    digitalWrite (cPin, HIGH) ;			delayMicroseconds (1) ;
-    digitalWrite (cPin, LOW) ;			delayMicroseconds (1) ;
-  }
+  wpiBitBangShiftOut (dsBB, data, 8) ;
 }
 
 
@@ -106,20 +101,20 @@ static unsigned int ds1302regRead (const int reg)
 {
   unsigned int data ;
 
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
+  digitalWrite (sPin, HIGH) ; dsPauseNs (500) ;
     dsShiftOut (reg) ;
     data = dsShiftIn () ;
-  digitalWrite (sPin, LOW)  ; delayMicroseconds (1) ;
+  digitalWrite (sPin, LOW)  ; dsPauseNs (500) ;
 
   return data ;
 }
 
 static void ds1302regWrite (const int reg, const unsigned int data)
 {
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
+  digitalWrite (sPin, HIGH) ; dsPauseNs (500) ;
     dsShiftOut (reg) ;
     dsShiftOut (data) ;
-  digitalWrite (sPin, LOW)  ; delayMicroseconds (1) ;
+  digitalWrite (sPin, LOW)  ; dsPauseNs (500) ;
 }
 
 
@@ -167,13 +162,13 @@ void ds1302clockRead (int clockData [8])
   int i ;
   unsigned int regVal = 0x81 | ((RTC_BM & 0x1F) << 1) ;
 
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
+  digitalWrite (sPin, HIGH) ; dsPauseNs (500) ;
 
   dsShiftOut (regVal) ;
   for (i = 0 ; i < 8 ; ++i)
     clockData [i] = dsShiftIn () ;
 
-  digitalWrite (sPin, LOW) ;  delayMicroseconds (1) ;
+  digitalWrite (sPin, LOW) ;  dsPauseNs (500) ;
 }
 
 
@@ -188,13 +183,13 @@ void ds1302clockWrite (const int clockData [8])
   int i ;
   unsigned int regVal = 0x80 | ((RTC_BM & 0x1F) << 1) ;
 
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
+  digitalWrite (sPin, HIGH) ; dsPauseNs (500) ;
 
   dsShiftOut (regVal) ;
   for (i = 0 ; i < 8 ; ++i)
     dsShiftOut (clockData [i]) ;
 
-  digitalWrite (sPin, LOW) ;  delayMicroseconds (1) ;
+  digitalWrite (sPin, LOW) ;  dsPauseNs (500) ;
 }
 
 
@@ -236,5 +231,7 @@ void ds1302setup (const int clockPin, const int dataPin, const int csPin)
   pinMode (cPin, OUTPUT) ;
   pinMode (sPin, OUTPUT) ;
 
+  dsBB = wpiBitBangCreate (cPin, dPin, 500, 0) ;	// LSB first, 500nS per clock phase
+
   ds1302rtcWrite (RTC_WP, 0) ;	// Remove write-protect
 }
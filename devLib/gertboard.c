@@ -78,6 +78,44 @@ void gertboardAnalogWrite (const int chan, const int value)
 }
 
 
+/*
+ * gertboardAnalogWrite2:
+ *	Write both MCP4802 channels in one multi-message SPI transfer -
+ *	two 16-bit frames with a chip-select toggle between them, one
+ *	ioctl. The outputs latch on each CS rise (LDAC is tied low on the
+ *	Gertboard), so the inter-channel skew is just the CS toggle gap
+ *	rather than a whole syscall + transaction.
+ *********************************************************************************
+ */
+
+void gertboardAnalogWrite2 (const int value0, const int value1)
+{
+  uint8_t frameA [2], frameB [2] ;
+  struct wiringPiSPISegment segments [2] ;
+
+  frameA [0] = 0x30 | ((value0 >> 4) & 0x0F) ;
+  frameA [1] = (value0 << 4) & 0xF0 ;
+  frameB [0] = 0xB0 | ((value1 >> 4) & 0x0F) ;
+  frameB [1] = (value1 << 4) & 0xF0 ;
+
+  segments [0].txData   = frameA ;
+  segments [0].rxData   = NULL ;
+  segments [0].len      = 2 ;
+  segments [0].speed    = 0 ;
+  segments [0].delay    = 0 ;
+  segments [0].csChange = 1 ;	// Latch channel A, then drop CS for B
+
+  segments [1].txData   = frameB ;
+  segments [1].rxData   = NULL ;
+  segments [1].len      = 2 ;
+  segments [1].speed    = 0 ;
+  segments [1].delay    = 0 ;
+  segments [1].csChange = 0 ;
+
+  wiringPiSPIDataRWn (SPI_D2A, segments, 2) ;
+}
+
+
 /*
  * gertboardAnalogRead:
  *	Return the analog value of the given channel (0/1).
@@ -33,6 +33,7 @@ extern "C" {
 // Old routines
 
 extern void gertboardAnalogWrite (const int chan, const int value) ;
+extern void gertboardAnalogWrite2 (const int value0, const int value1) ;	// Interface 3.17
 extern int  gertboardAnalogRead  (const int chan) ;
 extern int  gertboardSPISetup    (void) ;
 
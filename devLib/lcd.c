@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include <wiringPi.h>
 
@@ -67,16 +68,40 @@
 
 #define	LCD_CDSHIFT_RL	0x04
 
+// Queued mode (see lcdAsync):
+//	Operations land in the display's ring as (op, byte) pairs and a
+//	background thread replays them with the real strobe timing, so
+//	the caller never waits on the bus.
+
+#define	LCD_QUEUE_SIZE	256
+
+#define	LCDQ_CMD	0
+#define	LCDQ_DATA	1
+#define	LCDQ_DELAY	2		// byte holds milliseconds
+
 struct lcdDataStruct
 {
   int bits, rows, cols ;
   int rsPin, strbPin ;
+  int rwPin ;			// -1: RW strapped low, no busy-flag reads
   int dataPins [8] ;
   int cx, cy ;
+  int strobeUs ;		// Settle time each side of the E pulse
+  int execUs ;			// Extra wait after a full byte
+  int async ;			// Operations queue rather than execute
+  int inFlight ;		// The queue thread is mid-operation
+  unsigned int qHead, qTail ;	// Free-running, slot = index % size
+  unsigned char qOp   [LCD_QUEUE_SIZE] ;
+  unsigned char qByte [LCD_QUEUE_SIZE] ;
 } ;
 
 struct lcdDataStruct *lcds [MAX_LCDS] ;
 
+static pthread_mutex_t lcdQLock = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t  lcdQWork = PTHREAD_COND_INITIALIZER ;	// Something queued
+static pthread_cond_t  lcdQDone = PTHREAD_COND_INITIALIZER ;	// Space freed / queue drained
+static int lcdQRunning = FALSE ;
+
 static int lcdControl ;
 
 // Row offsets
@@ -96,8 +121,51 @@ static void strobe (const struct lcdDataStruct *lcd)
 
 // Note timing changes for new version of delayMicroseconds ()
 
-  digitalWrite (lcd->strbPin, 1) ; delayMicroseconds (50) ;
-  digitalWrite (lcd->strbPin, 0) ; delayMicroseconds (50) ;
+  digitalWrite (lcd->strbPin, 1) ; delayMicroseconds (lcd->strobeUs) ;
+  digitalWrite (lcd->strbPin, 0) ; delayMicroseconds (lcd->strobeUs) ;
+}
+
+
+/*
+ * lcdBusyWait:
+ *	Poll the controller's busy flag (D7 with RS low, RW high) until it
+ *	clears - only possible when the RW pin is wired to us rather than
+ *	strapped low. Replaces every worst-case delay with the real
+ *	execution time of the command in front of us.
+ *********************************************************************************
+ */
+
+static void lcdBusyWait (const struct lcdDataStruct *lcd)
+{
+  int busy, i, tries ;
+  int d7 = lcd->dataPins [(lcd->bits == 4) ? 3 : 7] ;
+
+  for (i = 0 ; i < lcd->bits ; ++i)
+    pinMode (lcd->dataPins [i], INPUT) ;
+
+  digitalWrite (lcd->rsPin, 0) ;
+  digitalWrite (lcd->rwPin, 1) ;
+
+  for (tries = 0 ; tries < 2000 ; ++tries)	// ~2mS worst case command
+  {
+    digitalWrite (lcd->strbPin, 1) ; delayMicroseconds (1) ;
+    busy = digitalRead (d7) ;
+    digitalWrite (lcd->strbPin, 0) ; delayMicroseconds (1) ;
+
+    if (lcd->bits == 4)		// Low half of the status - clock it out
+    {
+      digitalWrite (lcd->strbPin, 1) ; delayMicroseconds (1) ;
+      digitalWrite (lcd->strbPin, 0) ; delayMicroseconds (1) ;
+    }
+
+    if (!busy)
+      break ;
+  }
+
+  digitalWrite (lcd->rwPin, 0) ;
+
+  for (i = 0 ; i < lcd->bits ; ++i)
+    pinMode (lcd->dataPins [i], OUTPUT) ;
 }
 
 
@@ -138,20 +206,126 @@ static void sendDataCmd (const struct lcdDataStruct *lcd, unsigned char data)
     }
   }
   strobe (lcd) ;
+
+  if (lcd->execUs != 0)
+    delayMicroseconds (lcd->execUs) ;
 }
 
 
 /*
- * putCommand:
- *	Send a command byte to the display
+ * lcdQueuePut:
+ *	Queue one operation for the background thread - TRUE if taken,
+ *	FALSE if this display runs synchronously and the caller should
+ *	do the work itself. A full ring waits for the thread to free a
+ *	slot rather than dropping anything.
  *********************************************************************************
  */
 
-static void putCommand (const struct lcdDataStruct *lcd, unsigned char command)
+static int lcdQueuePut (struct lcdDataStruct *lcd, int op, int data)
 {
+  if (!lcd->async)
+    return FALSE ;
+
+  pthread_mutex_lock (&lcdQLock) ;
+  while ((lcd->qHead - lcd->qTail) >= LCD_QUEUE_SIZE)
+    pthread_cond_wait (&lcdQDone, &lcdQLock) ;
+
+  lcd->qOp   [lcd->qHead % LCD_QUEUE_SIZE] = op ;
+  lcd->qByte [lcd->qHead % LCD_QUEUE_SIZE] = data ;
+  lcd->qHead++ ;
+  pthread_cond_signal  (&lcdQWork) ;
+  pthread_mutex_unlock (&lcdQLock) ;
+  return TRUE ;
+}
+
+
+/*
+ * putCommand: putData:
+ *	Send a command or data byte to the display - queued when the
+ *	display is in async mode, on the bus right here otherwise.
+ *********************************************************************************
+ */
+
+static void putCommandRaw (const struct lcdDataStruct *lcd, unsigned char command)
+{
+  if (lcd->rwPin >= 0)		// The busy flag tells us exactly when
+    lcdBusyWait (lcd) ;
+
   digitalWrite (lcd->rsPin,   0) ;
   sendDataCmd  (lcd, command) ;
-  delay (2) ;
+
+  if (lcd->rwPin < 0)
+    delay (2) ;
+}
+
+static void putCommand (struct lcdDataStruct *lcd, unsigned char command)
+{
+  if (!lcdQueuePut (lcd, LCDQ_CMD, command))
+    putCommandRaw (lcd, command) ;
+}
+
+static void putDataRaw (const struct lcdDataStruct *lcd, unsigned char data)
+{
+  if (lcd->rwPin >= 0)
+    lcdBusyWait (lcd) ;
+
+  digitalWrite (lcd->rsPin, 1) ;
+  sendDataCmd  (lcd, data) ;
+}
+
+static void putData (struct lcdDataStruct *lcd, unsigned char data)
+{
+  if (!lcdQueuePut (lcd, LCDQ_DATA, data))
+    putDataRaw (lcd, data) ;
+}
+
+
+/*
+ * lcdQueueThread:
+ *	Replay queued operations with the real bus timing. The lock is
+ *	dropped while an operation is on the bus - inFlight keeps
+ *	lcdFlushWait honest about the one in our hands.
+ *********************************************************************************
+ */
+
+static PI_THREAD (lcdQueueThread)
+{
+  struct lcdDataStruct *lcd ;
+  int fd, op, data, found ;
+
+  pthread_mutex_lock (&lcdQLock) ;
+  for (;;)
+  {
+    found = FALSE ;
+    for (fd = 0 ; fd < MAX_LCDS ; ++fd)
+    {
+      if (((lcd = lcds [fd]) == NULL) || (lcd->qTail == lcd->qHead))
+	continue ;
+
+      op   = lcd->qOp   [lcd->qTail % LCD_QUEUE_SIZE] ;
+      data = lcd->qByte [lcd->qTail % LCD_QUEUE_SIZE] ;
+      lcd->qTail++ ;
+      lcd->inFlight = TRUE ;
+      pthread_mutex_unlock (&lcdQLock) ;
+
+      switch (op)
+      {
+	case LCDQ_CMD:   putCommandRaw (lcd, data) ;	break ;
+	case LCDQ_DATA:  putDataRaw    (lcd, data) ;	break ;
+	case LCDQ_DELAY: delay (data) ;			break ;
+      }
+
+      pthread_mutex_lock (&lcdQLock) ;
+      lcd->inFlight = FALSE ;
+      pthread_cond_broadcast (&lcdQDone) ;
+      found = TRUE ;
+    }
+
+    if (!found)
+      pthread_cond_wait (&lcdQWork, &lcdQLock) ;
+  }
+
+  return NULL ;
 }
 
 static void put4Command (const struct lcdDataStruct *lcd, unsigned char command)
@@ -188,7 +362,8 @@ void lcdHome (const int fd)
 
   putCommand (lcd, LCD_HOME) ;
   lcd->cx = lcd->cy = 0 ;
-  delay (5) ;
+  if (!lcdQueuePut (lcd, LCDQ_DELAY, 5))
+    delay (5) ;
 }
 
 void lcdClear (const int fd)
@@ -198,7 +373,8 @@ void lcdClear (const int fd)
   putCommand (lcd, LCD_CLEAR) ;
   putCommand (lcd, LCD_HOME) ;
   lcd->cx = lcd->cy = 0 ;
-  delay (5) ;
+  if (!lcdQueuePut (lcd, LCDQ_DELAY, 5))
+    delay (5) ;
 }
 
 
@@ -294,9 +470,8 @@ void lcdCharDef (const int fd, int index, unsigned char data [8])
 
   putCommand (lcd, LCD_CGRAM | ((index & 7) << 3)) ;
 
-  digitalWrite (lcd->rsPin, 1) ;
   for (i = 0 ; i < 8 ; ++i)
-    sendDataCmd (lcd, data [i]) ;
+    putData (lcd, data [i]) ;
 }
 
 
@@ -311,8 +486,7 @@ void lcdPutchar (const int fd, unsigned char data)
 {
   struct lcdDataStruct *lcd = lcds [fd] ;
 
-  digitalWrite (lcd->rsPin, 1) ;
-  sendDataCmd  (lcd, data) ;
+  putData (lcd, data) ;
 
   if (++lcd->cx == lcd->cols)
   {
@@ -338,6 +512,154 @@ void lcdPuts (const int fd, const char *string)
 }
 
 
+/*
+ * lcdPutsBuffered:
+ *	Send a whole line in one burst: RS is set once and each byte goes
+ *	out back-to-back, paced by the busy flag or the timing profile
+ *	rather than per-character call overhead.
+ *********************************************************************************
+ */
+
+void lcdPutsBuffered (const int fd, const char *string)
+{
+  struct lcdDataStruct *lcd = lcds [fd] ;
+
+  if (lcd->async)		// Queued per byte anyway - nothing to coalesce
+  {
+    lcdPuts (fd, string) ;
+    return ;
+  }
+
+  digitalWrite (lcd->rsPin, 1) ;
+
+  while (*string)
+  {
+    if (lcd->rwPin >= 0)
+    {
+      lcdBusyWait  (lcd) ;		// Flips RS for the status read
+      digitalWrite (lcd->rsPin, 1) ;
+    }
+
+    sendDataCmd (lcd, *string++) ;
+
+    if (++lcd->cx == lcd->cols)
+    {
+      lcd->cx = 0 ;
+      if (++lcd->cy == lcd->rows)
+	lcd->cy = 0 ;
+
+      putCommand   (lcd, lcd->cx + (LCD_DGRAM | rowOff [lcd->cy])) ;
+      digitalWrite (lcd->rsPin, 1) ;
+    }
+  }
+}
+
+
+/*
+ * lcdTiming:
+ *	Set the timing profile: the settle time each side of the E pulse
+ *	and the post-byte execution wait, both in uS. The defaults (50, 0)
+ *	match the old worst-case behaviour; a healthy HD44780 runs happily
+ *	at (1, 40), roughly trebling the redraw rate. With a RW pin wired
+ *	(see lcdRwPin) the busy flag makes execUs unnecessary.
+ *********************************************************************************
+ */
+
+int lcdTiming (const int fd, int strobeUs, int execUs)
+{
+  struct lcdDataStruct *lcd = lcds [fd] ;
+
+  if ((lcd == NULL) || (strobeUs < 1) || (execUs < 0))
+    return -1 ;
+
+  lcd->strobeUs = strobeUs ;
+  lcd->execUs   = execUs ;
+  return 0 ;
+}
+
+
+/*
+ * lcdRwPin:
+ *	Tell us the display's RW pin is wired to a GPIO rather than
+ *	strapped low. We then poll the busy flag instead of sleeping
+ *	worst-case times after every command.
+ *********************************************************************************
+ */
+
+int lcdRwPin (const int fd, int rwPin)
+{
+  struct lcdDataStruct *lcd = lcds [fd] ;
+
+  if (lcd == NULL)
+    return -1 ;
+
+  digitalWrite (rwPin, 0) ;
+  pinMode      (rwPin, OUTPUT) ;
+
+  lcd->rwPin = rwPin ;
+  return 0 ;
+}
+
+
+/*
+ * lcdAsync:
+ *	Switch a display between synchronous and queued operation. In
+ *	queued mode every command and data byte lands in the display's
+ *	ring and a background thread replays it with the real strobe
+ *	timing - a status-line update returns in microseconds instead of
+ *	milliseconds. Turning it off waits for the queue to drain first,
+ *	so nothing is lost in the switch.
+ *********************************************************************************
+ */
+
+int lcdAsync (const int fd, int enable)
+{
+  struct lcdDataStruct *lcd = lcds [fd] ;
+
+  if (lcd == NULL)
+    return -1 ;
+
+  if (!enable)
+  {
+    lcdFlushWait (fd) ;
+    lcd->async = FALSE ;
+    return 0 ;
+  }
+
+  if (!lcdQRunning)
+  {
+    if (piThreadCreate (lcdQueueThread) != 0)
+      return -1 ;
+    lcdQRunning = TRUE ;
+  }
+
+  lcd->async = TRUE ;
+  return 0 ;
+}
+
+
+/*
+ * lcdFlushWait:
+ *	Block until everything queued for this display has really been
+ *	sent - for the callers who need the panel up to date before
+ *	moving on.
+ *********************************************************************************
+ */
+
+void lcdFlushWait (const int fd)
+{
+  struct lcdDataStruct *lcd = lcds [fd] ;
+
+  if ((lcd == NULL) || !lcd->async)
+    return ;
+
+  pthread_mutex_lock (&lcdQLock) ;
+  while ((lcd->qTail != lcd->qHead) || lcd->inFlight)
+    pthread_cond_wait (&lcdQDone, &lcdQLock) ;
+  pthread_mutex_unlock (&lcdQLock) ;
+}
+
+
 /*
  * lcdPrintf:
  *	Printf to an LCD display
@@ -414,11 +736,18 @@ int lcdInit (const int rows, const int cols, const int bits,
 
   lcd->rsPin   = rs ;
   lcd->strbPin = strb ;
+  lcd->rwPin   = -1 ;		// Assume strapped low until lcdRwPin says otherwise
   lcd->bits    = 8 ;		// For now - we'll set it properly later.
   lcd->rows    = rows ;
   lcd->cols    = cols ;
   lcd->cx      = 0 ;
   lcd->cy      = 0 ;
+  lcd->strobeUs = 50 ;		// The old worst-case profile - see lcdTiming
+  lcd->execUs   = 0 ;
+  lcd->async    = FALSE ;	// Synchronous until lcdAsync says otherwise
+  lcd->inFlight = FALSE ;
+  lcd->qHead    = 0 ;
+  lcd->qTail    = 0 ;
 
   lcd->dataPins [0] = d0 ;
   lcd->dataPins [1] = d1 ;
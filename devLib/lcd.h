@@ -42,6 +42,18 @@ extern void lcdPutchar     (const int fd, unsigned char data) ;
 extern void lcdPuts        (const int fd, const char *string) ;
 extern void lcdPrintf      (const int fd, const char *message, ...) ;
 
+// Interface 3.17
+
+extern void lcdPutsBuffered (const int fd, const char *string) ;
+extern int  lcdTiming       (const int fd, int strobeUs, int execUs) ;
+extern int  lcdRwPin        (const int fd, int rwPin) ;
+
+// Interface V3.17 - queued operation: a background thread does the bus
+//	work, lcdFlushWait blocks until the panel is really up to date
+
+extern int  lcdAsync        (const int fd, int enable) ;
+extern void lcdFlushWait    (const int fd) ;
+
 extern int  lcdInit (const int rows, const int cols, const int bits,
 	const int rs, const int strb,
 	const int d0, const int d1, const int d2, const int d3, const int d4,
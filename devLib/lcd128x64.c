@@ -32,6 +32,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 
 #include <wiringPi.h>
 
@@ -61,6 +64,14 @@ static int lastX,   lastY ;
 static int xOrigin, yOrigin ;
 static int lcdOrientation = 0 ;
 
+// Dirty tracking:
+//	Every plot lands in lcd128x64point, so we note there which display
+//	bytes actually changed - one bit per column, per chip, per line -
+//	and update only re-sends those. A typical text update then moves a
+//	few dozen bytes over the parallel bus instead of all 1024.
+
+static uint64_t dirtyMap [2][8] ;	// [chip][line], bit n: column for fb x n (+64 on chip 1)
+
 /*
  * strobe:
  *	Toggle the strobe (Really the "E") pin to the device.
@@ -118,55 +129,154 @@ static void setLine (int line, const int chip)
 
 
 /*
- * lcd128x64update:
- *	Copy our software version to the real display
+ * pushFrame:
+ *	Send a buffer's dirty display bytes over the parallel bus,
+ *	clearing its dirty map as we go.
  *********************************************************************************
  */
 
-void lcd128x64update (void)
+static void pushFrame (const unsigned char *fb, uint64_t map [2][8])
 {
-  int line, x, y, fbLoc ;
+  int chip, cs, line, x, xi, y, fbLoc, inRun ;
   unsigned char byte ;
+  uint64_t lineMap ;
 
-// Left side 
-
-  for (line = 0 ; line < 8 ; ++line)
+  for (chip = 0 ; chip < 2 ; ++chip)
   {
-    setCol  (0,    CS1) ;
-    setLine (line, CS1) ;
+    cs = (chip == 0) ? CS1 : CS2 ;
 
-    for (x = 63 ; x >= 0 ; --x)
+    for (line = 0 ; line < 8 ; ++line)
     {
-      byte = 0 ;
-      for (y = 0 ; y < 8 ; ++y)
+      lineMap = map [chip][line] ;
+      if (lineMap == 0)
+	continue ;
+
+// The chip auto-increments its column on each data byte, so a run of
+//	dirty columns needs just one address set-up; a gap starts a new run
+
+      inRun = FALSE ;
+      for (xi = 63 ; xi >= 0 ; --xi)
       {
-	fbLoc = x + (((7 - line) * 8) + (7 - y)) * LCD_WIDTH ;
-	if (frameBuffer [fbLoc] != 0)
-	  byte |= (1 << y) ;
+	x = xi + chip * 64 ;
+
+	if ((lineMap & (1ULL << (x & 63))) == 0)
+	{
+	  inRun = FALSE ;
+	  continue ;
+	}
+
+	if (!inRun)
+	{
+	  setCol  (63 - xi, cs) ;
+	  setLine (line,    cs) ;
+	  inRun = TRUE ;
+	}
+
+	byte = 0 ;
+	for (y = 0 ; y < 8 ; ++y)
+	{
+	  fbLoc = x + (((7 - line) * 8) + (7 - y)) * LCD_WIDTH ;
+	  if (fb [fbLoc] != 0)
+	    byte |= (1 << y) ;
+	}
+	sendData (byte, cs) ;
       }
-      sendData (byte, CS1) ;
+
+      map [chip][line] = 0 ;
     }
   }
+}
+
 
-// Right side 
+/*
+ * lcd128x64update:
+ *	Copy our software version to the real display
+ *********************************************************************************
+ */
 
-  for (line = 0 ; line < 8 ; ++line)
+void lcd128x64update (void)
+{
+  pushFrame (frameBuffer, dirtyMap) ;
+}
+
+
+/*
+ * lcd128x64flip: lcd128x64flipRate:
+ *	Double-buffered updates: flip snapshots the frame and returns at
+ *	memcpy speed, while a background thread pushes the dirty bytes
+ *	to the panel at a paced refresh rate - so a UI loop renders at
+ *	its own cadence and never stalls on the parallel bus. Flips that
+ *	land between refreshes merge; the panel always gets the newest
+ *	frame. Mixing lcd128x64update() in as well is safe but pointless.
+ *********************************************************************************
+ */
+
+static unsigned char flipBuffer [LCD_WIDTH * LCD_HEIGHT] ;
+static uint64_t flipMap [2][8] ;
+static int flipPending = FALSE ;
+static int flipRunning = FALSE ;
+static int flipRate    = 50 ;		// Frames per second
+
+static pthread_mutex_t flipLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static PI_THREAD (flipFlusher)
+{
+  static unsigned char fb [LCD_WIDTH * LCD_HEIGHT] ;	// Ours alone - no lock held while on the bus
+  uint64_t map [2][8] ;
+  int i ;
+
+  for (;;)
   {
-    setCol  (0,    CS2) ;
-    setLine (line, CS2) ;
+    delay (1000 / flipRate) ;
 
-    for (x = 127 ; x >= 64 ; --x)
+    pthread_mutex_lock (&flipLock) ;
+    if (!flipPending)
     {
-      byte = 0 ;
-      for (y = 0 ; y < 8 ; ++y)
-      {
-	fbLoc = x + (((7 - line) * 8) + (7 - y)) * LCD_WIDTH ;
-	if (frameBuffer [fbLoc] != 0)
-	  byte |= (1 << y) ;
-      }
-      sendData (byte, CS2) ;
+      pthread_mutex_unlock (&flipLock) ;
+      continue ;
+    }
+    memcpy (fb, flipBuffer, sizeof (fb)) ;
+    for (i = 0 ; i < 8 ; ++i)
+    {
+      map [0][i] = flipMap [0][i] ;
+      map [1][i] = flipMap [1][i] ;
+      flipMap [0][i] = flipMap [1][i] = 0 ;
     }
+    flipPending = FALSE ;
+    pthread_mutex_unlock (&flipLock) ;
+
+    pushFrame (fb, map) ;
   }
+
+  return NULL ;
+}
+
+void lcd128x64flip (void)
+{
+  int i ;
+
+  pthread_mutex_lock (&flipLock) ;
+  memcpy (flipBuffer, frameBuffer, sizeof (flipBuffer)) ;
+  for (i = 0 ; i < 8 ; ++i)
+  {
+    flipMap [0][i] |= dirtyMap [0][i] ;
+    flipMap [1][i] |= dirtyMap [1][i] ;
+    dirtyMap [0][i] = dirtyMap [1][i] = 0 ;
+  }
+  flipPending = TRUE ;
+  pthread_mutex_unlock (&flipLock) ;
+
+  if (!flipRunning)
+    flipRunning = (piThreadCreate (flipFlusher) == 0) ;
+}
+
+void lcd128x64flipRate (int fps)
+{
+  if (fps < 1)
+    fps = 1 ;
+  else if (fps > 200)
+    fps = 200 ;
+  flipRate = fps ;
 }
 
 
@@ -301,7 +411,11 @@ void lcd128x64point (int x, int y, int colour)
   if ((x < 0) || (x >= LCD_WIDTH) || (y < 0) || (y >= LCD_HEIGHT))
     return ;
 
+  if (frameBuffer [x + y * LCD_WIDTH] == colour)	// No change, nothing to send
+    return ;
+
   frameBuffer [x + y * LCD_WIDTH] = colour ;
+  dirtyMap [x >> 6][7 - (y >> 3)] |= 1ULL << (x & 63) ;
 }
 
 
@@ -550,16 +664,55 @@ void lcd128x64ellipse (int cx, int cy, int xRadius, int yRadius, int colour, int
 void lcd128x64putchar (int x, int y, int c, int bgCol, int fgCol)
 {
   int y1, y2 ;
+  int tx, ty, sxX, sxY, syX, syY, ex, ey, px, py, bx, idx, colour ;
 
   unsigned char line ;
   unsigned char *fontPtr ;
 
-// Can't print if we're offscreen
+  fontPtr = font + c * fontHeight ;
 
-//if ((x < 0) || (x >= (maxX - fontWidth)) || (y < 0) || (y >= (maxY - fontHeight)))
-//  return ;
+// The orientation transform is affine, so one transformed corner plus a
+//	step vector per glyph axis places every pixel with two adds -
+//	rather than re-running the transform and bounds checks through
+//	lcd128x64point for each of the glyph's pixels.
 
-  fontPtr = font + c * fontHeight ;
+  tx  = x ;     ty  = y ;     lcd128x64orientCoordinates (&tx,  &ty) ;
+  sxX = x + 1 ; sxY = y ;     lcd128x64orientCoordinates (&sxX, &sxY) ;
+  syX = x ;     syY = y + 1 ; lcd128x64orientCoordinates (&syX, &syY) ;
+  sxX -= tx ; sxY -= ty ;	// Framebuffer step per glyph x
+  syX -= tx ; syY -= ty ;	// ... and per glyph y
+
+  ex = tx + 7 * sxX + (fontHeight - 1) * syX ;	// The far corner
+  ey = ty + 7 * sxY + (fontHeight - 1) * syY ;
+
+  if ((tx >= 0) && (tx < LCD_WIDTH) && (ty >= 0) && (ty < LCD_HEIGHT) &&
+      (ex >= 0) && (ex < LCD_WIDTH) && (ey >= 0) && (ey < LCD_HEIGHT))
+  {
+    for (y1 = fontHeight - 1 ; y1 >= 0 ; --y1)
+    {
+      line = *fontPtr++ ;
+      px = tx + y1 * syX ;
+      py = ty + y1 * syY ;
+      for (bx = 0 ; bx < 8 ; ++bx)
+      {
+	colour = ((line & (0x80 >> bx)) == 0) ? bgCol : fgCol ;
+	idx    = px + py * LCD_WIDTH ;
+	if (frameBuffer [idx] != colour)
+	{
+	  frameBuffer [idx] = colour ;
+	  dirtyMap [px >> 6][7 - (py >> 3)] |= 1ULL << (px & 63) ;
+	}
+	px += sxX ;
+	py += sxY ;
+      }
+    }
+
+    lastX = x + 7 ;	// As the point-by-point path would leave them
+    lastY = y ;
+    return ;
+  }
+
+// Partly (or wholly) offscreen - take the clipped pixel-by-pixel path
 
   for (y1 = fontHeight - 1 ; y1 >= 0 ; --y1)
   {
@@ -631,6 +784,9 @@ void lcd128x64clear (int colour)
 
   for (i = 0 ; i < (maxX * maxY) ; ++i)
     *ptr++ = colour ;
+
+  for (i = 0 ; i < 8 ; ++i)	// Everything needs a re-send
+    dirtyMap [0][i] = dirtyMap [1][i] = ~0ULL ;
 }
 
 
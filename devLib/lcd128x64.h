@@ -36,4 +36,10 @@ extern void lcd128x64puts              (int  x, int  y, const char *str, int bgC
 extern void lcd128x64update            (void) ;
 extern void lcd128x64clear             (int colour) ;
 
+// Interface V3.17 - double-buffered updates: flip snapshots the frame
+//	and returns immediately, a background thread paces the bus
+
+extern void lcd128x64flip              (void) ;
+extern void lcd128x64flipRate          (int fps) ;
+
 extern int  lcd128x64setup             (void) ;
@@ -108,13 +108,88 @@ static unsigned int maxDetectClockByte (const int pin)
 
 
 /*
- * maxDetectRead:
- *	Read in and return the 4 data bytes from the MaxDetect sensor.
+ * maxDetectReadEdges:
+ *	Capture a frame from the kernel's timestamped edge events. The
+ *	waveform is recorded once - every falling edge stamped in-kernel -
+ *	and decoded afterwards from the deltas (a 0 bit spans ~77uS falling
+ *	edge to falling edge, a 1 bit ~120uS), so scheduling stalls during
+ *	the frame no longer corrupt bits. Returns TRUE/FALSE on the
+ *	checksum, or -1 when the pin can't deliver edge events.
+ *********************************************************************************
+ */
+
+static int maxDetectReadEdges (const int pin, unsigned char buffer [4])
+{
+  struct WPIEdgeEvent events [64] ;
+  unsigned long long dt ;
+  unsigned int checksum ;
+  unsigned char localBuf [5] = { 0, 0, 0, 0, 0 } ;
+  int i, n, got, base, bit ;
+
+// Wake up the RHT03 by pulling the data line low, then high
+//	Low for 10mS, high for 40uS.
+
+  pinMode      (pin, OUTPUT) ;
+  digitalWrite (pin, 0) ; delay             (10) ;
+  digitalWrite (pin, 1) ; delayMicroseconds (40) ;
+
+  if (wiringPiEdgeCaptureOpen (pin, INT_EDGE_FALLING, 0) < 0)
+  {
+    pinMode (pin, INPUT) ;
+    return -1 ;
+  }
+
+// ~5mS covers the whole frame; keep draining until it goes quiet
+
+  got = 0 ;
+  while (got < 64)
+  {
+    n = wiringPiEdgeCaptureRead (pin, events + got, 64 - got, (got == 0) ? 10 : 2) ;
+    if (n <= 0)
+      break ;
+    got += n ;
+  }
+
+  wiringPiEdgeCaptureClose (pin) ;
+
+// The 40 bit periods sit between the last 41 falling edges (the final
+//	one being the sensor releasing the bus), so any edges lost while
+//	the line request was being set up don't matter
+
+  if (got < 41)
+    return FALSE ;
+
+  base = got - 41 ;
+  for (bit = 0 ; bit < 40 ; ++bit)
+  {
+    dt = events [base + bit + 1].timeStamp_ns - events [base + bit].timeStamp_ns ;
+    localBuf [bit / 8] <<= 1 ;
+    if (dt > 100000)		// Longer than 100uS: it's a 1
+      localBuf [bit / 8] |= 1 ;
+  }
+
+  checksum = 0 ;
+  for (i = 0 ; i < 4 ; ++i)
+  {
+    buffer [i] = localBuf [i] ;
+    checksum += localBuf [i] ;
+  }
+  checksum &= 0xFF ;
+
+  return checksum == localBuf [4] ;
+}
+
+
+/*
+ * maxDetectReadSampled:
+ *	Read in and return the 4 data bytes from the MaxDetect sensor by
+ *	sampling the pin directly - the fallback when the kernel can't
+ *	give us edge events.
  *	Return TRUE/FALSE depending on the checksum validity
  *********************************************************************************
  */
 
-int maxDetectRead (const int pin, unsigned char buffer [4])
+static int maxDetectReadSampled (const int pin, unsigned char buffer [4])
 {
   int i ;
   unsigned int checksum ;
@@ -171,6 +246,30 @@ int maxDetectRead (const int pin, unsigned char buffer [4])
 }
 
 
+/*
+ * maxDetectRead:
+ *	Read a frame - from kernel edge timestamps when the pin supports
+ *	them, the old sampling loop when it doesn't.
+ *********************************************************************************
+ */
+
+int maxDetectRead (const int pin, unsigned char buffer [4])
+{
+  static int useSampling = FALSE ;
+  int result ;
+
+  if (!useSampling)
+  {
+    result = maxDetectReadEdges (pin, buffer) ;
+    if (result != -1)
+      return result ;
+    useSampling = TRUE ;	// No edge events here - don't ask again
+  }
+
+  return maxDetectReadSampled (pin, buffer) ;
+}
+
+
 /*
  * readRHT03:
  *	Read the Temperature & Humidity from an RHT03 sensor
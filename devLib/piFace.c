@@ -29,10 +29,64 @@
 #include <stdint.h>
 
 #include <wiringPi.h>
+#include <wiringPiSPI.h>
 #include <mcp23s17.h>
+#include <mcp23x0817.h>
 
 #include "piFace.h"
 
+// Event mode:
+//	The MCP23S17's INTB output can signal any change on the input port.
+//	When it's wired to a Pi GPIO and piFaceSetupInterrupts() has been
+//	called, we keep a cached copy of the inputs refreshed only when the
+//	chip says something changed - a polled button scanner then costs no
+//	SPI traffic at all between presses. The PiFace is hard-wired to SPI
+//	port 0, device 0, so one set of statics covers it.
+
+static volatile uint8_t piFaceInputs = 0xFF ;
+static int piFaceEventMode = FALSE ;
+
+
+static uint8_t piFaceReadReg (uint8_t reg)
+{
+  uint8_t spiData [4] ;
+
+  spiData [0] = CMD_READ ;
+  spiData [1] = reg ;
+  spiData [2] = 0 ;
+
+  wiringPiSPIDataRW (0, spiData, 3) ;
+
+  return spiData [2] ;
+}
+
+static void piFaceWriteReg (uint8_t reg, uint8_t data)
+{
+  uint8_t spiData [4] ;
+
+  spiData [0] = CMD_WRITE ;
+  spiData [1] = reg ;
+  spiData [2] = data ;
+
+  wiringPiSPIDataRW (0, spiData, 3) ;
+}
+
+
+/*
+ * piFaceInterrupt:
+ *	Something moved on the input port - refresh the cache. Reading
+ *	GPIOB also clears the interrupt.
+ *********************************************************************************
+ */
+
+static void piFaceInterrupt (struct WPIWfiStatus status, void *userdata)
+{
+  (void)status ;
+  (void)userdata ;
+
+  piFaceInputs = piFaceReadReg (MCP23x17_GPIOB) ;
+}
+
 
 /*
  * myDigitalWrite:
@@ -58,8 +112,11 @@ int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 {
   if ((pin - node->pinBase) >= 8)
     return digitalRead (pin + 8) ;
-  else
-    return digitalRead (pin + 16 + 8) ;
+
+  if (piFaceEventMode)		// Served from the cache, no SPI traffic
+    return ((piFaceInputs >> ((pin - node->pinBase) & 7)) & 1) ? HIGH : LOW ;
+
+  return digitalRead (pin + 16 + 8) ;
 }
 
 
@@ -110,3 +167,40 @@ int piFaceSetup (const int pinBase)
 
   return 0 ;
 }
+
+
+/*
+ * piFaceSetupInterrupts:
+ *	Wire the board's INTB output to the given Pi pin and switch input
+ *	reads over to a change-driven cache: the expander raises INTB on
+ *	any input change, the handler re-reads the port, and digitalRead
+ *	serves the cached byte. Call after piFaceSetup.
+ *********************************************************************************
+ */
+
+int piFaceSetupInterrupts (const int pinBase, const int intrPin)
+{
+  (void)pinBase ;
+
+  if (piFaceEventMode)
+    return -1 ;
+
+// Interrupt on any change of any port B pin, compared against the
+//	previous value. INTB is active-low (the power-on default).
+
+  piFaceWriteReg (MCP23x17_INTCONB,  0x00) ;
+  piFaceWriteReg (MCP23x17_GPINTENB, 0xFF) ;
+
+  if (wiringPiISR2 (intrPin, INT_EDGE_FALLING, piFaceInterrupt, 0, NULL) < 0)
+  {
+    piFaceWriteReg (MCP23x17_GPINTENB, 0x00) ;
+    return -1 ;
+  }
+
+// Seed the cache (which also clears any pending interrupt)
+
+  piFaceInputs    = piFaceReadReg (MCP23x17_GPIOB) ;
+  piFaceEventMode = TRUE ;
+
+  return 0 ;
+}
@@ -26,6 +26,7 @@ extern "C" {
 #endif
 
 extern int  piFaceSetup (const int pinBase) ;
+extern int  piFaceSetupInterrupts (const int pinBase, const int intrPin) ;	// Interface 3.17
 
 #ifdef __cplusplus
 }
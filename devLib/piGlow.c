@@ -33,6 +33,13 @@ static int leg0 [6] = {  6,  7,  8,  5,  4,  9 } ;
 static int leg1 [6] = { 17, 16, 15, 13, 11, 10 } ;
 static int leg2 [6] = {  0,  1,  2,  3, 14, 12 } ;
 
+// Gamma lookup - the LEDs are savagely bright and linear PWM codes bunch
+//	all the visible change into the bottom few steps. A square-law curve
+//	is close enough to the eye's response; filled in on first use.
+
+static unsigned char piGlowGamma [256] ;
+static int piGlowGammaReady = 0 ;
+
 
 /*
  * piGlow1:
@@ -93,6 +100,41 @@ void piGlowRing (const int ring, const int intensity)
   analogWrite (PIGLOW_BASE + leg2 [ring], intensity) ;
 }
 
+/*
+ * piGlowFrame:
+ *	Set all 18 LEDs in one go. The levels are gamma-corrected and
+ *	pushed to the SN3218 as a single block write plus one update poke,
+ *	so the whole frame changes together - animations no longer ripple
+ *	LED by LED. Levels are indexed leg * 6 + ring.
+ *********************************************************************************
+ */
+
+void piGlowFrame (const unsigned char levels [18])
+{
+  unsigned char channels [18] ;
+  int i, ring ;
+
+  if (!piGlowGammaReady)
+  {
+    for (i = 0 ; i < 256 ; ++i)
+    {
+      piGlowGamma [i] = (unsigned char)((i * i + 127) / 255) ;
+      if ((i != 0) && (piGlowGamma [i] == 0))	// Keep dim LEDs lit
+	piGlowGamma [i] = 1 ;
+    }
+    piGlowGammaReady = 1 ;
+  }
+
+  for (ring = 0 ; ring < 6 ; ++ring)
+  {
+    channels [leg0 [ring]] = piGlowGamma [levels [     ring]] ;
+    channels [leg1 [ring]] = piGlowGamma [levels [ 6 + ring]] ;
+    channels [leg2 [ring]] = piGlowGamma [levels [12 + ring]] ;
+  }
+
+  sn3218Frame (PIGLOW_BASE, channels) ;
+}
+
 /*
  * piGlowSetup:
  *	Initialise the board & remember the pins we're using
@@ -38,6 +38,7 @@ extern "C" {
 extern void piGlow1     (const int leg,  const int ring, const int intensity) ;
 extern void piGlowLeg   (const int leg,  const int intensity) ;
 extern void piGlowRing  (const int ring, const int intensity) ;
+extern void piGlowFrame (const unsigned char levels [18]) ;	// Interface 3.17
 extern void piGlowSetup (int clear) ;
 
 #ifdef __cplusplus
@@ -23,6 +23,7 @@
  */
 
 #include <wiringPi.h>
+#include <wiringPiBitBang.h>
 
 #include "piNes.h"
 
@@ -45,12 +46,18 @@
 struct nesPinsStruct
 {
   unsigned int cPin, dPin, lPin ;
+  int bb ;		// bit-bang engine handle, -1 to clock by hand
 } ;
 
 static struct nesPinsStruct nesPins [MAX_NES_JOYSTICKS] ;
 
 static int joysticks = 0 ;
 
+#ifndef	TRUE
+#  define	TRUE	(1==1)
+#  define	FALSE	(1==2)
+#endif
+
 
 /*
  * setupNesJoystick:
@@ -74,6 +81,10 @@ int setupNesJoystick (int dPin, int cPin, int lPin)
   pinMode (cPin, OUTPUT) ;
   pinMode (dPin, INPUT) ;
 
+// MSB arrives first; one clock phase per PULSE_TIME
+
+  nesPins [joysticks].bb = wpiBitBangCreate (cPin, dPin, PULSE_TIME * 1000, WPI_BB_MSBFIRST) ;
+
   return joysticks++ ;
 }
 
@@ -96,11 +107,13 @@ unsigned int readNesJoystick (int joystick)
   digitalWrite (pins->lPin, HIGH) ; delayMicroseconds (PULSE_TIME) ;
   digitalWrite (pins->lPin, LOW)  ; delayMicroseconds (PULSE_TIME) ;
 
-// Read first bit
+// Clock the 8 bits in - the engine samples before each clock pulse,
+//	which is just the read-then-clock order the 4021 wants
 
-  value = digitalRead (pins->dPin) ;
+  if (pins->bb >= 0)
+    return wpiBitBangShiftIn (pins->bb, 8) ^ 0xFF ;
 
-// Now get the next 7 bits with the clock
+  value = digitalRead (pins->dPin) ;
 
   for (i = 0 ; i < 7 ; ++i)
   {
@@ -111,3 +124,74 @@ unsigned int readNesJoystick (int joystick)
 
   return value ^ 0xFF ;
 }
+
+
+/*
+ * piNesReadAll:
+ *	Scan every registered joystick in one pass. The NES controllers all
+ *	share the clock and latch lines (those of the first joystick are
+ *	driven) with a data line each, so one latch pulse presents the first
+ *	bit on every pad and each clock then shifts all of them together.
+ *	When the data pins are on the Pi's own GPIO they're sampled with a
+ *	single level-register read per clock; eight pads cost the same 16
+ *	pulses as one. Returns the number of joysticks read.
+ *********************************************************************************
+ */
+
+int piNesReadAll (unsigned int values [MAX_NES_JOYSTICKS])
+{
+  struct nesPinsStruct *pins = &nesPins [0] ;
+  struct wiringPiPinHandle handles [MAX_NES_JOYSTICKS] ;
+  unsigned long long dataMask, levels ;
+  int fast, i, j ;
+
+  if (joysticks == 0)
+    return 0 ;
+
+// Resolve the data pins to BCM numbers - if every one resolves then all
+//	the pads can be sampled in one register read
+
+  fast     = TRUE ;
+  dataMask = 0ULL ;
+  for (j = 0 ; j < joysticks ; ++j)
+  {
+    if (wiringPiOpenPin (nesPins [j].dPin, &handles [j]) < 0)
+    {
+      fast = FALSE ;
+      break ;
+    }
+    dataMask |= 1ULL << handles [j].pinBCM ;
+  }
+
+  for (j = 0 ; j < joysticks ; ++j)
+    values [j] = 0 ;
+
+// Toggle Latch - which presents the first bit on every pad
+
+  digitalWrite (pins->lPin, HIGH) ; delayMicroseconds (PULSE_TIME) ;
+  digitalWrite (pins->lPin, LOW)  ; delayMicroseconds (PULSE_TIME) ;
+
+  for (i = 0 ; i < 8 ; ++i)
+  {
+    if (i != 0)		// First bit is valid straight after the latch
+    {
+      digitalWrite (pins->cPin, HIGH) ; delayMicroseconds (PULSE_TIME) ;
+      digitalWrite (pins->cPin, LOW)  ; delayMicroseconds (PULSE_TIME) ;
+    }
+
+    if (fast)
+    {
+      digitalReadMulti (dataMask, &levels) ;
+      for (j = 0 ; j < joysticks ; ++j)
+	values [j] = (values [j] << 1) | (unsigned int)((levels >> handles [j].pinBCM) & 1) ;
+    }
+    else
+      for (j = 0 ; j < joysticks ; ++j)
+	values [j] = (values [j] << 1) | digitalRead (nesPins [j].dPin) ;
+  }
+
+  for (j = 0 ; j < joysticks ; ++j)
+    values [j] ^= 0xFF ;
+
+  return joysticks ;
+}
@@ -39,6 +39,7 @@ extern "C" {
 
 extern int          setupNesJoystick (int dPin, int cPin, int lPin) ;
 extern unsigned int  readNesJoystick (int joystick) ;
+extern int          piNesReadAll     (unsigned int values [MAX_NES_JOYSTICKS]) ;	// Interface 3.17
 
 #ifdef __cplusplus
 }
@@ -47,6 +47,13 @@
 
 static unsigned char frameBuffer [SP_WIDTH * SP_HEIGHT] ;
 
+// Last column data actually pushed to the chip - update only sends the
+//	columns that differ, and in runs, so a one-pixel change costs one
+//	block write rather than 12 single-register transactions.
+
+static unsigned char lastPixels [SP_WIDTH] ;
+static int lastPixelsValid = 0 ;
+
 static int lastX,   lastY ;
 static int printDelayFactor  ;
 static int scrollPhatFd ;
@@ -78,7 +85,11 @@ static void delay (unsigned int howLong)
 
 /*
  * scrollPhatUpdate:
- *	Copy our software version to the real display
+ *	Copy our software version to the real display.
+ *	Only the columns which changed since the last update are sent, each
+ *	run of changed columns as a single block write - the IS31FL3730
+ *	takes sequential register writes - followed by the one update-latch
+ *	poke.
  *********************************************************************************
  */
 
@@ -86,6 +97,7 @@ void scrollPhatUpdate (void)
 {
   register int x, y ;
   register unsigned char data, pixel ;
+  int start ;
   unsigned char pixels [SP_WIDTH] ;
 
 #ifdef	DEBUG
@@ -114,10 +126,29 @@ void scrollPhatUpdate (void)
     pixels [x] = data ;
   }
 
-  for (x = 0 ; x < SP_WIDTH ; ++x)
-    wiringPiI2CWriteReg8 (scrollPhatFd, 1 + x, pixels [x]) ;
+  if (lastPixelsValid && (memcmp (pixels, lastPixels, SP_WIDTH) == 0))
+    return ;		// Nothing moved - nothing to send
+
+  x = 0 ;
+  while (x < SP_WIDTH)
+  {
+    if (lastPixelsValid && (pixels [x] == lastPixels [x]))
+    {
+      ++x ;
+      continue ;
+    }
+
+    start = x ;
+    while ((x < SP_WIDTH) && (!lastPixelsValid || (pixels [x] != lastPixels [x])))
+      ++x ;
+
+    wiringPiI2CWriteBlockData (scrollPhatFd, 1 + start, &pixels [start], x - start) ;
+  }
 
   wiringPiI2CWriteReg8 (scrollPhatFd, 0x0C, 0) ;
+
+  memcpy (lastPixels, pixels, SP_WIDTH) ;
+  lastPixelsValid = 1 ;
 }
 
 
@@ -0,0 +1,744 @@
+/*
+ * ssd1306.c:
+ *	Graphics-based OLED driver for the SSD1306 128x64 panels on SPI.
+ *
+ *	Same drawing API as lcd128x64.c, but the panel hangs off a
+ *	hardware SPI channel (plus a D/C pin and an optional reset pin)
+ *	rather than the parallel bus. The framebuffer is diffed against
+ *	what the panel already shows: every plot marks the display bytes
+ *	it touches in a dirty map, and update() sends only runs of
+ *	changed columns - each run as one batched SPI transfer. A small
+ *	text update is then a few dozen bytes on the bus; a full refresh
+ *	is eight page-sized transfers.
+ *
+ * Copyright (c) 2013-2025 Gordon Henderson and contributors.
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public License
+ *    along with wiringPi.  If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+
+#include "font.h"
+#include "ssd1306.h"
+
+// Size
+
+#define	OLED_WIDTH	128
+#define	OLED_HEIGHT	 64
+
+// The hardware interface
+
+static int spiChan = -1 ;
+static int dcPin ;
+
+// Software copy of the framebuffer
+//	it's 8-bit deep although the display itself is only 1-bit deep.
+
+static unsigned char frameBuffer [OLED_WIDTH * OLED_HEIGHT] ;
+
+static int maxX,    maxY ;
+static int lastX,   lastY ;
+static int xOrigin, yOrigin ;
+static int oledOrientation = 0 ;
+
+// Dirty tracking - a bit per display column, per page. update() re-sends
+//	only runs of set bits, each run as a single SPI transfer.
+
+static uint64_t dirtyMap [8][2] ;	// [page][x >> 6], bit: x & 63
+
+
+/*
+ * sendCommand: sendData:
+ *	Send bytes to the panel with the D/C line saying which they are.
+ *********************************************************************************
+ */
+
+static void sendCommand (const unsigned char command)
+{
+  unsigned char c = command ;
+
+  digitalWrite (dcPin, LOW) ;
+  wiringPiSPIWrite (spiChan, &c, 1) ;
+  digitalWrite (dcPin, HIGH) ;
+}
+
+static void sendData (const unsigned char *data, const int len)
+{
+  wiringPiSPIWrite (spiChan, data, len) ;	// D/C idles high = data
+}
+
+
+/*
+ * pushFrame:
+ *	Send a buffer's dirty display bytes over SPI, clearing its dirty
+ *	map as we go. The chip auto-increments its column inside a page,
+ *	so each run of dirty columns costs three command bytes plus one
+ *	data transfer.
+ *********************************************************************************
+ */
+
+static void pushFrame (const unsigned char *fb, uint64_t map [8][2])
+{
+  unsigned char run [OLED_WIDTH] ;
+  int page, x, x0, y, bit, len ;
+  unsigned char byte ;
+
+  for (page = 0 ; page < 8 ; ++page)
+  {
+    if ((map [page][0] | map [page][1]) == 0)
+      continue ;
+
+    for (x = 0 ; x < OLED_WIDTH ; ++x)
+    {
+      if ((map [page][x >> 6] & (1ULL << (x & 63))) == 0)
+	continue ;
+
+      x0  = x ;
+      len = 0 ;
+      do
+      {
+	byte = 0 ;
+	for (bit = 0 ; bit < 8 ; ++bit)
+	{
+	  y = OLED_HEIGHT - 1 - (page * 8 + bit) ;	// Framebuffer row 0 is the bottom
+	  if (fb [x + y * OLED_WIDTH] != 0)
+	    byte |= 1 << bit ;
+	}
+	run [len++] = byte ;
+	++x ;
+      }
+      while ((x < OLED_WIDTH) && ((map [page][x >> 6] & (1ULL << (x & 63))) != 0)) ;
+
+      sendCommand (0xB0 | page) ;		// Page address
+      sendCommand (0x00 | (x0 & 0x0F)) ;	// Column, low nibble
+      sendCommand (0x10 | (x0 >> 4)) ;		// Column, high nibble
+      sendData    (run, len) ;
+    }
+
+    map [page][0] = map [page][1] = 0 ;
+  }
+}
+
+
+/*
+ * ssd1306update:
+ *	Copy our software version to the real display
+ *********************************************************************************
+ */
+
+void ssd1306update (void)
+{
+  pushFrame (frameBuffer, dirtyMap) ;
+}
+
+
+/*
+ * ssd1306flip: ssd1306flipRate:
+ *	Double-buffered updates: flip snapshots the frame and returns at
+ *	memcpy speed, while a background thread pushes the dirty bytes to
+ *	the panel at a paced refresh rate. Flips that land between
+ *	refreshes merge; the panel always gets the newest frame.
+ *********************************************************************************
+ */
+
+static unsigned char flipBuffer [OLED_WIDTH * OLED_HEIGHT] ;
+static uint64_t flipMap [8][2] ;
+static int flipPending = FALSE ;
+static int flipRunning = FALSE ;
+static int flipRate    = 50 ;		// Frames per second
+
+static pthread_mutex_t flipLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static PI_THREAD (flipFlusher)
+{
+  static unsigned char fb [OLED_WIDTH * OLED_HEIGHT] ;	// Ours alone - no lock held while on the bus
+  uint64_t map [8][2] ;
+  int i ;
+
+  for (;;)
+  {
+    delay (1000 / flipRate) ;
+
+    pthread_mutex_lock (&flipLock) ;
+    if (!flipPending)
+    {
+      pthread_mutex_unlock (&flipLock) ;
+      continue ;
+    }
+    memcpy (fb, flipBuffer, sizeof (fb)) ;
+    for (i = 0 ; i < 8 ; ++i)
+    {
+      map [i][0] = flipMap [i][0] ;
+      map [i][1] = flipMap [i][1] ;
+      flipMap [i][0] = flipMap [i][1] = 0 ;
+    }
+    flipPending = FALSE ;
+    pthread_mutex_unlock (&flipLock) ;
+
+    pushFrame (fb, map) ;
+  }
+
+  return NULL ;
+}
+
+void ssd1306flip (void)
+{
+  int i ;
+
+  pthread_mutex_lock (&flipLock) ;
+  memcpy (flipBuffer, frameBuffer, sizeof (flipBuffer)) ;
+  for (i = 0 ; i < 8 ; ++i)
+  {
+    flipMap [i][0] |= dirtyMap [i][0] ;
+    flipMap [i][1] |= dirtyMap [i][1] ;
+    dirtyMap [i][0] = dirtyMap [i][1] = 0 ;
+  }
+  flipPending = TRUE ;
+  pthread_mutex_unlock (&flipLock) ;
+
+  if (!flipRunning)
+    flipRunning = (piThreadCreate (flipFlusher) == 0) ;
+}
+
+void ssd1306flipRate (int fps)
+{
+  if (fps < 1)
+    fps = 1 ;
+  else if (fps > 200)
+    fps = 200 ;
+  flipRate = fps ;
+}
+
+
+/*
+ * ssd1306setOrigin:
+ *	Set the display offset origin
+ *********************************************************************************
+ */
+
+void ssd1306setOrigin (int x, int y)
+{
+  xOrigin = x ;
+  yOrigin = y ;
+}
+
+
+/*
+ * ssd1306setOrientation:
+ *	Set the display orientation:
+ *	0: Normal, the display is portrait mode, 0,0 is top left
+ *	1: Landscape
+ *	2: Portrait, flipped
+ *	3: Landscape, flipped
+ *********************************************************************************
+ */
+
+void ssd1306setOrientation (int orientation)
+{
+  oledOrientation = orientation & 3 ;
+
+  ssd1306setOrigin (0, 0) ;
+
+  if ((oledOrientation & 1) == 0)
+  {
+    maxX = OLED_WIDTH ;
+    maxY = OLED_HEIGHT ;
+  }
+  else
+  {
+    maxX = OLED_HEIGHT ;
+    maxY = OLED_WIDTH ;
+  }
+}
+
+
+/*
+ * ssd1306orientCoordinates:
+ *	Adjust the coordinates given to the display orientation
+ *********************************************************************************
+ */
+
+void ssd1306orientCoordinates (int *x, int *y)
+{
+  register int tmp ;
+
+  *x += xOrigin ;
+  *y += yOrigin ;
+  *y  = maxY - *y - 1 ;
+
+  switch (oledOrientation)
+  {
+    case 0:
+      break ;
+
+    case 1:
+      tmp = maxY - *y - 1 ;
+      *y = *x ;
+      *x = tmp ;
+      break ;
+
+    case 2:
+      *x = maxX - *x - 1 ;
+      *y = maxY - *y - 1 ;
+      break ;
+
+    case 3:
+      *x = maxX - *x - 1 ;
+      tmp = *y ;
+      *y = *x ;
+      *x = tmp ;
+      break ;
+  }
+}
+
+
+/*
+ * ssd1306getScreenSize:
+ *	Return the max X & Y screen sizes. Needs to be called again, if you
+ *	change screen orientation.
+ *********************************************************************************
+ */
+
+void ssd1306getScreenSize (int *x, int *y)
+{
+  *x = maxX ;
+  *y = maxY ;
+}
+
+
+/*
+ *********************************************************************************
+ * Standard Graphical Functions
+ *********************************************************************************
+ */
+
+
+/*
+ * ssd1306point:
+ *	Plot a pixel.
+ *********************************************************************************
+ */
+
+void ssd1306point (int x, int y, int colour)
+{
+  lastX = x ;
+  lastY = y ;
+
+  ssd1306orientCoordinates (&x, &y) ;
+
+  if ((x < 0) || (x >= OLED_WIDTH) || (y < 0) || (y >= OLED_HEIGHT))
+    return ;
+
+  if (frameBuffer [x + y * OLED_WIDTH] == colour)	// No change, nothing to send
+    return ;
+
+  frameBuffer [x + y * OLED_WIDTH] = colour ;
+  dirtyMap [7 - (y >> 3)][x >> 6] |= 1ULL << (x & 63) ;
+}
+
+
+/*
+ * ssd1306line: ssd1306lineTo:
+ *	Classic Bressenham Line code
+ *********************************************************************************
+ */
+
+void ssd1306line (int x0, int y0, int x1, int y1, int colour)
+{
+  int dx, dy ;
+  int sx, sy ;
+  int err, e2 ;
+
+  lastX = x1 ;
+  lastY = y1 ;
+
+  dx = abs (x1 - x0) ;
+  dy = abs (y1 - y0) ;
+
+  sx = (x0 < x1) ? 1 : -1 ;
+  sy = (y0 < y1) ? 1 : -1 ;
+
+  err = dx - dy ;
+
+  for (;;)
+  {
+    ssd1306point (x0, y0, colour) ;
+
+    if ((x0 == x1) && (y0 == y1))
+      break ;
+
+    e2 = 2 * err ;
+
+    if (e2 > -dy)
+    {
+      err -= dy ;
+      x0  += sx ;
+    }
+
+    if (e2 < dx)
+    {
+      err += dx ;
+      y0  += sy ;
+    }
+  }
+}
+
+void ssd1306lineTo (int x, int y, int colour)
+{
+  ssd1306line (lastX, lastY, x, y, colour) ;
+}
+
+
+/*
+ * ssd1306rectangle:
+ *	A rectangle is a spoilt days fishing
+ *********************************************************************************
+ */
+
+void ssd1306rectangle (int x1, int y1, int x2, int y2, int colour, int filled)
+{
+  register int x ;
+
+  if (filled)
+  {
+    if      (x1 == x2)
+      ssd1306line (x1, y1, x2, y2, colour) ;
+    else if (x1 < x2)
+      for (x = x1 ; x <= x2 ; ++x)
+	ssd1306line (x, y1, x, y2, colour) ;
+    else
+      for (x = x2 ; x <= x1 ; ++x)
+	ssd1306line (x, y1, x, y2, colour) ;
+  }
+  else
+  {
+    ssd1306line   (x1, y1, x2, y1, colour) ;
+    ssd1306lineTo (x2, y2, colour) ;
+    ssd1306lineTo (x1, y2, colour) ;
+    ssd1306lineTo (x1, y1, colour) ;
+  }
+}
+
+
+/*
+ * ssd1306circle:
+ *      This is the midpoint circle algorithm.
+ *********************************************************************************
+ */
+
+void ssd1306circle (int x, int y, int r, int colour, int filled)
+{
+  int ddF_x = 1 ;
+  int ddF_y = -2 * r ;
+
+  int f = 1 - r ;
+  int x1 = 0 ;
+  int y1 = r ;
+
+  if (filled)
+  {
+    ssd1306line (x, y + r, x, y - r, colour) ;
+    ssd1306line (x + r, y, x - r, y, colour) ;
+  }
+  else
+  {
+    ssd1306point (x, y + r, colour) ;
+    ssd1306point (x, y - r, colour) ;
+    ssd1306point (x + r, y, colour) ;
+    ssd1306point (x - r, y, colour) ;
+  }
+
+  while (x1 < y1)
+  {
+    if (f >= 0)
+    {
+      y1-- ;
+      ddF_y += 2 ;
+      f += ddF_y ;
+    }
+    x1++ ;
+    ddF_x += 2 ;
+    f += ddF_x ;
+    if (filled)
+    {
+      ssd1306line (x + x1, y + y1, x - x1, y + y1, colour) ;
+      ssd1306line (x + x1, y - y1, x - x1, y - y1, colour) ;
+      ssd1306line (x + y1, y + x1, x - y1, y + x1, colour) ;
+      ssd1306line (x + y1, y - x1, x - y1, y - x1, colour) ;
+    }
+    else
+    {
+      ssd1306point (x + x1, y + y1, colour) ; ssd1306point (x - x1, y + y1, colour) ;
+      ssd1306point (x + x1, y - y1, colour) ; ssd1306point (x - x1, y - y1, colour) ;
+      ssd1306point (x + y1, y + x1, colour) ; ssd1306point (x - y1, y + x1, colour) ;
+      ssd1306point (x + y1, y - x1, colour) ; ssd1306point (x - y1, y - x1, colour) ;
+    }
+  }
+}
+
+
+/*
+ * ssd1306ellipse:
+ *	Fast ellipse drawing algorithm by
+ *      John Kennedy
+ *	Mathematics Department
+ *	Santa Monica College
+ *	1900 Pico Blvd.
+ *	Santa Monica, CA 90405
+ *	jrkennedy6@gmail.com
+ *	-Confirned in email this algorithm is in the public domain -GH-
+ *********************************************************************************
+ */
+
+static void plot4ellipsePoints (int cx, int cy, int x, int y, int colour, int filled)
+{
+  if (filled)
+  {
+    ssd1306line (cx + x, cy + y, cx - x, cy + y, colour) ;
+    ssd1306line (cx - x, cy - y, cx + x, cy - y, colour) ;
+  }
+  else
+  {
+    ssd1306point (cx + x, cy + y, colour) ;
+    ssd1306point (cx - x, cy + y, colour) ;
+    ssd1306point (cx - x, cy - y, colour) ;
+    ssd1306point (cx + x, cy - y, colour) ;
+  }
+}
+
+void ssd1306ellipse (int cx, int cy, int xRadius, int yRadius, int colour, int filled)
+{
+  int x, y ;
+  int xChange, yChange, ellipseError ;
+  int twoAsquare, twoBsquare ;
+  int stoppingX, stoppingY ;
+
+  twoAsquare = 2 * xRadius * xRadius ;
+  twoBsquare = 2 * yRadius * yRadius ;
+
+  x = xRadius ;
+  y = 0 ;
+
+  xChange = yRadius * yRadius * (1 - 2 * xRadius) ;
+  yChange = xRadius * xRadius ;
+
+  ellipseError = 0 ;
+  stoppingX    = twoBsquare * xRadius ;
+  stoppingY    = 0 ;
+
+  while (stoppingX >= stoppingY)	// 1st set of points
+  {
+    plot4ellipsePoints (cx, cy, x, y, colour, filled) ;
+    ++y ;
+    stoppingY    += twoAsquare ;
+    ellipseError += yChange ;
+    yChange      += twoAsquare ;
+
+    if ((2 * ellipseError + xChange) > 0 )
+    {
+      --x ;
+      stoppingX    -= twoBsquare ;
+      ellipseError += xChange ;
+      xChange      += twoBsquare ;
+    }
+  }
+
+  x = 0 ;
+  y = yRadius ;
+
+  xChange = yRadius * yRadius ;
+  yChange = xRadius * xRadius * (1 - 2 * yRadius) ;
+
+  ellipseError = 0 ;
+  stoppingX    = 0 ;
+  stoppingY    = twoAsquare * yRadius ;
+
+  while (stoppingX <= stoppingY)	//2nd set of points
+  {
+    plot4ellipsePoints (cx, cy, x, y, colour, filled) ;
+    ++x ;
+    stoppingX    += twoBsquare ;
+    ellipseError += xChange ;
+    xChange      += twoBsquare ;
+
+    if ((2 * ellipseError + yChange) > 0 )
+    {
+      --y ;
+      stoppingY -= twoAsquare ;
+      ellipseError += yChange ;
+      yChange += twoAsquare ;
+    }
+  }
+}
+
+
+/*
+ * ssd1306putchar:
+ *	Print a single character to the screen
+ *********************************************************************************
+ */
+
+void ssd1306putchar (int x, int y, int c, int bgCol, int fgCol)
+{
+  int y1, y2 ;
+
+  unsigned char line ;
+  unsigned char *fontPtr ;
+
+  fontPtr = font + c * fontHeight ;
+
+  for (y1 = fontHeight - 1 ; y1 >= 0 ; --y1)
+  {
+    y2 = y + y1 ;
+    line = *fontPtr++ ;
+    ssd1306point (x + 0, y2, (line & 0x80) == 0 ? bgCol : fgCol) ;
+    ssd1306point (x + 1, y2, (line & 0x40) == 0 ? bgCol : fgCol) ;
+    ssd1306point (x + 2, y2, (line & 0x20) == 0 ? bgCol : fgCol) ;
+    ssd1306point (x + 3, y2, (line & 0x10) == 0 ? bgCol : fgCol) ;
+    ssd1306point (x + 4, y2, (line & 0x08) == 0 ? bgCol : fgCol) ;
+    ssd1306point (x + 5, y2, (line & 0x04) == 0 ? bgCol : fgCol) ;
+    ssd1306point (x + 6, y2, (line & 0x02) == 0 ? bgCol : fgCol) ;
+    ssd1306point (x + 7, y2, (line & 0x01) == 0 ? bgCol : fgCol) ;
+  }
+}
+
+
+/*
+ * ssd1306puts:
+ *	Send a string to the display. Obeys \n and \r formatting
+ *********************************************************************************
+ */
+
+void ssd1306puts (int x, int y, const char *str, int bgCol, int fgCol)
+{
+  int c, mx, my ;
+
+  mx = x ; my = y ;
+
+  while (*str)
+  {
+    c = *str++ ;
+
+    if (c == '\r')
+    {
+      mx = x ;
+      continue ;
+    }
+
+    if (c == '\n')
+    {
+      mx  = x ;
+      my -= fontHeight ;
+      continue ;
+    }
+
+    ssd1306putchar (mx, my, c, bgCol, fgCol) ;
+
+    mx += fontWidth ;
+    if (mx >= (maxX - fontWidth))
+    {
+      mx  = 0 ;
+      my -= fontHeight ;
+    }
+  }
+}
+
+
+/*
+ * ssd1306clear:
+ *	Clear the display to the given colour.
+ *********************************************************************************
+ */
+
+void ssd1306clear (int colour)
+{
+  register int i ;
+  register unsigned char *ptr = frameBuffer ;
+
+  for (i = 0 ; i < (maxX * maxY) ; ++i)
+    *ptr++ = colour ;
+
+  for (i = 0 ; i < 8 ; ++i)	// Everything needs a re-send
+    dirtyMap [i][0] = dirtyMap [i][1] = ~0ULL ;
+}
+
+
+/*
+ * ssd1306setup:
+ *	Initialise the display, the SPI channel and the control pins.
+ *	rstPin may be -1 when the reset line is tied high.
+ *********************************************************************************
+ */
+
+int ssd1306setup (int spiChannel, int dataCommandPin, int rstPin)
+{
+  static const unsigned char initSeq [] =
+  {
+    0xAE,		// Display off
+    0xD5, 0x80,		// Clock divide
+    0xA8, 0x3F,		// Multiplex: 64 lines
+    0xD3, 0x00,		// No display offset
+    0x40,		// Start line 0
+    0x8D, 0x14,		// Charge pump on
+    0x20, 0x02,		// Page addressing mode
+    0xA1,		// Segment remap - 0,0 top left
+    0xC8,		// COM scan direction, ditto
+    0xDA, 0x12,		// COM pins
+    0x81, 0xCF,		// Contrast
+    0xD9, 0xF1,		// Pre-charge
+    0xDB, 0x40,		// VCOM detect
+    0xA4,		// Resume from RAM
+    0xA6,		// Normal (not inverted)
+    0xAF,		// Display on
+  } ;
+  unsigned int i ;
+
+  if (wiringPiSPISetup (spiChannel, 8000000) < 0)
+    return -1 ;
+
+  spiChan = spiChannel ;
+  dcPin   = dataCommandPin ;
+
+  digitalWrite (dcPin, HIGH) ;
+  pinMode      (dcPin, OUTPUT) ;
+
+  if (rstPin >= 0)
+  {
+    digitalWrite (rstPin, HIGH) ;
+    pinMode      (rstPin, OUTPUT) ;
+    delay (1) ;
+    digitalWrite (rstPin, LOW) ;  delay (10) ;
+    digitalWrite (rstPin, HIGH) ; delay (10) ;
+  }
+
+  for (i = 0 ; i < sizeof (initSeq) ; ++i)
+    sendCommand (initSeq [i]) ;
+
+  ssd1306setOrientation (0) ;
+  ssd1306clear          (0) ;
+  ssd1306update         () ;
+
+  return 0 ;
+}
@@ -0,0 +1,46 @@
+/*
+ * ssd1306.h:
+ *	SSD1306 128x64 OLED display over SPI.
+ *
+ * Copyright (c) 2013-2025 Gordon Henderson and contributors.
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public License
+ *    along with wiringPi.  If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+extern void ssd1306setOrigin         (int x, int y) ;
+extern void ssd1306setOrientation    (int orientation) ;
+extern void ssd1306orientCoordinates (int *x, int *y) ;
+extern void ssd1306getScreenSize     (int *x, int *y) ;
+extern void ssd1306point             (int  x, int  y, int colour) ;
+extern void ssd1306line              (int x0, int y0, int x1, int y1, int colour) ;
+extern void ssd1306lineTo            (int  x, int  y, int colour) ;
+extern void ssd1306rectangle         (int x1, int y1, int x2, int y2, int colour, int filled) ;
+extern void ssd1306circle            (int  x, int  y, int  r, int colour, int filled) ;
+extern void ssd1306ellipse           (int cx, int cy, int xRadius, int yRadius, int colour, int filled) ;
+extern void ssd1306putchar           (int  x, int  y, int c, int bgCol, int fgCol) ;
+extern void ssd1306puts              (int  x, int  y, const char *str, int bgCol, int fgCol) ;
+extern void ssd1306update            (void) ;
+extern void ssd1306clear             (int colour) ;
+
+// Interface V3.17 - double-buffered updates: flip snapshots the frame
+//	and returns immediately, a background thread paces the bus
+
+extern void ssd1306flip              (void) ;
+extern void ssd1306flipRate          (int fps) ;
+
+extern int  ssd1306setup             (int spiChannel, int dcPin, int rstPin) ;
@@ -0,0 +1,782 @@
+/*
+ * st7735.c:
+ *	Graphics-based TFT driver for the ST7735 160x128 colour panels
+ *	on SPI.
+ *
+ *	Same drawing API as lcd128x64.c, with 16-bit RGB565 colours. The
+ *	panel has no readable framebuffer, so we keep our own and track a
+ *	dirty window over it: every plot that changes a pixel grows the
+ *	window, and update() sets the panel's column/row address window
+ *	to just that rectangle and streams it out in large batched SPI
+ *	transfers. A clock-digit redraw then costs a few hundred bytes on
+ *	the bus; only a full-screen change pays for a full 40KB frame.
+ *
+ * Copyright (c) 2013-2025 Gordon Henderson and contributors.
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public License
+ *    along with wiringPi.  If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+
+#include "font.h"
+#include "st7735.h"
+
+// Size - landscape, the usual way round for these panels
+
+#define	TFT_WIDTH	160
+#define	TFT_HEIGHT	128
+
+// Panel commands
+
+#define	TFT_SWRESET	0x01
+#define	TFT_SLPOUT	0x11
+#define	TFT_NORON	0x13
+#define	TFT_INVOFF	0x20
+#define	TFT_DISPON	0x29
+#define	TFT_CASET	0x2A
+#define	TFT_RASET	0x2B
+#define	TFT_RAMWR	0x2C
+#define	TFT_MADCTL	0x36
+#define	TFT_COLMOD	0x3A
+
+#define	SPI_CHUNK	4096	// Default spidev transfer limit
+
+// The hardware interface
+
+static int spiChan = -1 ;
+static int dcPin ;
+
+// Software copy of the framebuffer, RGB565
+
+static uint16_t frameBuffer [TFT_WIDTH * TFT_HEIGHT] ;
+
+static int maxX,    maxY ;
+static int lastX,   lastY ;
+static int xOrigin, yOrigin ;
+static int tftOrientation = 0 ;
+
+// The dirty window - the bounding box of every pixel changed since the
+//	last update. Empty when minX > maxX.
+
+struct tftWindow
+{
+  int minX, minY, maxX, maxY ;
+} ;
+
+static struct tftWindow dirty = { TFT_WIDTH, TFT_HEIGHT, -1, -1 } ;
+
+
+/*
+ * sendCommand: sendData:
+ *	Send bytes to the panel with the D/C line saying which they are.
+ *********************************************************************************
+ */
+
+static void sendCommand (const unsigned char command)
+{
+  unsigned char c = command ;
+
+  digitalWrite (dcPin, LOW) ;
+  wiringPiSPIWrite (spiChan, &c, 1) ;
+  digitalWrite (dcPin, HIGH) ;
+}
+
+static void sendData (const unsigned char *data, const int len)
+{
+  wiringPiSPIWrite (spiChan, data, len) ;	// D/C idles high = data
+}
+
+
+/*
+ * setWindow:
+ *	Point the panel's address window at a framebuffer rectangle.
+ *	Framebuffer row 0 is the bottom, panel row 0 the top.
+ *********************************************************************************
+ */
+
+static void setWindow (int x0, int y0, int x1, int y1)
+{
+  unsigned char range [4] ;
+  int r0 = TFT_HEIGHT - 1 - y1 ;
+  int r1 = TFT_HEIGHT - 1 - y0 ;
+
+  sendCommand (TFT_CASET) ;
+  range [0] = 0 ; range [1] = x0 ;
+  range [2] = 0 ; range [3] = x1 ;
+  sendData (range, 4) ;
+
+  sendCommand (TFT_RASET) ;
+  range [0] = 0 ; range [1] = r0 ;
+  range [2] = 0 ; range [3] = r1 ;
+  sendData (range, 4) ;
+
+  sendCommand (TFT_RAMWR) ;
+}
+
+
+/*
+ * pushFrame:
+ *	Stream a buffer's dirty window out to the panel - one address
+ *	window, then the pixels in SPI_CHUNK-sized transfers, big-endian
+ *	as the panel wants them. Clears the window.
+ *********************************************************************************
+ */
+
+static void pushFrame (const uint16_t *fb, struct tftWindow *w)
+{
+  unsigned char chunk [SPI_CHUNK] ;
+  uint16_t pixel ;
+  int x, y, row, fill ;
+
+  if (w->minX > w->maxX)	// Nothing changed
+    return ;
+
+  setWindow (w->minX, w->minY, w->maxX, w->maxY) ;
+
+  fill = 0 ;
+  for (row = TFT_HEIGHT - 1 - w->maxY ; row <= TFT_HEIGHT - 1 - w->minY ; ++row)
+  {
+    y = TFT_HEIGHT - 1 - row ;
+    for (x = w->minX ; x <= w->maxX ; ++x)
+    {
+      pixel = fb [x + y * TFT_WIDTH] ;
+      chunk [fill++] = pixel >> 8 ;
+      chunk [fill++] = pixel & 0xFF ;
+      if (fill == SPI_CHUNK)
+      {
+	sendData (chunk, fill) ;
+	fill = 0 ;
+      }
+    }
+  }
+  if (fill != 0)
+    sendData (chunk, fill) ;
+
+  w->minX = TFT_WIDTH ;  w->minY = TFT_HEIGHT ;
+  w->maxX = -1 ;         w->maxY = -1 ;
+}
+
+
+/*
+ * st7735update:
+ *	Copy our software version to the real display
+ *********************************************************************************
+ */
+
+void st7735update (void)
+{
+  pushFrame (frameBuffer, &dirty) ;
+}
+
+
+/*
+ * st7735flip: st7735flipRate:
+ *	Double-buffered updates: flip snapshots the frame and returns at
+ *	memcpy speed, while a background thread pushes the dirty window
+ *	to the panel at a paced refresh rate. Flips that land between
+ *	refreshes merge; the panel always gets the newest frame.
+ *********************************************************************************
+ */
+
+static uint16_t flipBuffer [TFT_WIDTH * TFT_HEIGHT] ;
+static struct tftWindow flipWindow = { TFT_WIDTH, TFT_HEIGHT, -1, -1 } ;
+static int flipPending = FALSE ;
+static int flipRunning = FALSE ;
+static int flipRate    = 50 ;		// Frames per second
+
+static pthread_mutex_t flipLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static PI_THREAD (flipFlusher)
+{
+  static uint16_t fb [TFT_WIDTH * TFT_HEIGHT] ;	// Ours alone - no lock held while on the bus
+  struct tftWindow w ;
+
+  for (;;)
+  {
+    delay (1000 / flipRate) ;
+
+    pthread_mutex_lock (&flipLock) ;
+    if (!flipPending)
+    {
+      pthread_mutex_unlock (&flipLock) ;
+      continue ;
+    }
+    memcpy (fb, flipBuffer, sizeof (fb)) ;
+    w = flipWindow ;
+    flipWindow.minX = TFT_WIDTH ;  flipWindow.minY = TFT_HEIGHT ;
+    flipWindow.maxX = -1 ;         flipWindow.maxY = -1 ;
+    flipPending = FALSE ;
+    pthread_mutex_unlock (&flipLock) ;
+
+    pushFrame (fb, &w) ;
+  }
+
+  return NULL ;
+}
+
+void st7735flip (void)
+{
+  pthread_mutex_lock (&flipLock) ;
+  memcpy (flipBuffer, frameBuffer, sizeof (flipBuffer)) ;
+
+  if (dirty.minX < flipWindow.minX) flipWindow.minX = dirty.minX ;
+  if (dirty.minY < flipWindow.minY) flipWindow.minY = dirty.minY ;
+  if (dirty.maxX > flipWindow.maxX) flipWindow.maxX = dirty.maxX ;
+  if (dirty.maxY > flipWindow.maxY) flipWindow.maxY = dirty.maxY ;
+  dirty.minX = TFT_WIDTH ;  dirty.minY = TFT_HEIGHT ;
+  dirty.maxX = -1 ;         dirty.maxY = -1 ;
+
+  flipPending = TRUE ;
+  pthread_mutex_unlock (&flipLock) ;
+
+  if (!flipRunning)
+    flipRunning = (piThreadCreate (flipFlusher) == 0) ;
+}
+
+void st7735flipRate (int fps)
+{
+  if (fps < 1)
+    fps = 1 ;
+  else if (fps > 200)
+    fps = 200 ;
+  flipRate = fps ;
+}
+
+
+/*
+ * st7735setOrigin:
+ *	Set the display offset origin
+ *********************************************************************************
+ */
+
+void st7735setOrigin (int x, int y)
+{
+  xOrigin = x ;
+  yOrigin = y ;
+}
+
+
+/*
+ * st7735setOrientation:
+ *	Set the display orientation:
+ *	0: Normal, 0,0 is top left
+ *	1: Rotated 90 degrees
+ *	2: Flipped
+ *	3: Rotated the other way
+ *********************************************************************************
+ */
+
+void st7735setOrientation (int orientation)
+{
+  tftOrientation = orientation & 3 ;
+
+  st7735setOrigin (0, 0) ;
+
+  if ((tftOrientation & 1) == 0)
+  {
+    maxX = TFT_WIDTH ;
+    maxY = TFT_HEIGHT ;
+  }
+  else
+  {
+    maxX = TFT_HEIGHT ;
+    maxY = TFT_WIDTH ;
+  }
+}
+
+
+/*
+ * st7735orientCoordinates:
+ *	Adjust the coordinates given to the display orientation
+ *********************************************************************************
+ */
+
+void st7735orientCoordinates (int *x, int *y)
+{
+  register int tmp ;
+
+  *x += xOrigin ;
+  *y += yOrigin ;
+  *y  = maxY - *y - 1 ;
+
+  switch (tftOrientation)
+  {
+    case 0:
+      break ;
+
+    case 1:
+      tmp = maxY - *y - 1 ;
+      *y = *x ;
+      *x = tmp ;
+      break ;
+
+    case 2:
+      *x = maxX - *x - 1 ;
+      *y = maxY - *y - 1 ;
+      break ;
+
+    case 3:
+      *x = maxX - *x - 1 ;
+      tmp = *y ;
+      *y = *x ;
+      *x = tmp ;
+      break ;
+  }
+}
+
+
+/*
+ * st7735getScreenSize:
+ *	Return the max X & Y screen sizes. Needs to be called again, if you
+ *	change screen orientation.
+ *********************************************************************************
+ */
+
+void st7735getScreenSize (int *x, int *y)
+{
+  *x = maxX ;
+  *y = maxY ;
+}
+
+
+/*
+ * st7735colour:
+ *	Pack red/green/blue (0-255 each) into the panel's RGB565 format.
+ *********************************************************************************
+ */
+
+int st7735colour (int r, int g, int b)
+{
+  return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | ((b & 0xF8) >> 3) ;
+}
+
+
+/*
+ *********************************************************************************
+ * Standard Graphical Functions
+ *********************************************************************************
+ */
+
+
+/*
+ * st7735point:
+ *	Plot a pixel.
+ *********************************************************************************
+ */
+
+void st7735point (int x, int y, int colour)
+{
+  lastX = x ;
+  lastY = y ;
+
+  st7735orientCoordinates (&x, &y) ;
+
+  if ((x < 0) || (x >= TFT_WIDTH) || (y < 0) || (y >= TFT_HEIGHT))
+    return ;
+
+  if (frameBuffer [x + y * TFT_WIDTH] == (uint16_t)colour)	// No change, nothing to send
+    return ;
+
+  frameBuffer [x + y * TFT_WIDTH] = colour ;
+
+  if (x < dirty.minX) dirty.minX = x ;
+  if (y < dirty.minY) dirty.minY = y ;
+  if (x > dirty.maxX) dirty.maxX = x ;
+  if (y > dirty.maxY) dirty.maxY = y ;
+}
+
+
+/*
+ * st7735line: st7735lineTo:
+ *	Classic Bressenham Line code
+ *********************************************************************************
+ */
+
+void st7735line (int x0, int y0, int x1, int y1, int colour)
+{
+  int dx, dy ;
+  int sx, sy ;
+  int err, e2 ;
+
+  lastX = x1 ;
+  lastY = y1 ;
+
+  dx = abs (x1 - x0) ;
+  dy = abs (y1 - y0) ;
+
+  sx = (x0 < x1) ? 1 : -1 ;
+  sy = (y0 < y1) ? 1 : -1 ;
+
+  err = dx - dy ;
+
+  for (;;)
+  {
+    st7735point (x0, y0, colour) ;
+
+    if ((x0 == x1) && (y0 == y1))
+      break ;
+
+    e2 = 2 * err ;
+
+    if (e2 > -dy)
+    {
+      err -= dy ;
+      x0  += sx ;
+    }
+
+    if (e2 < dx)
+    {
+      err += dx ;
+      y0  += sy ;
+    }
+  }
+}
+
+void st7735lineTo (int x, int y, int colour)
+{
+  st7735line (lastX, lastY, x, y, colour) ;
+}
+
+
+/*
+ * st7735rectangle:
+ *	A rectangle is a spoilt days fishing
+ *********************************************************************************
+ */
+
+void st7735rectangle (int x1, int y1, int x2, int y2, int colour, int filled)
+{
+  register int x ;
+
+  if (filled)
+  {
+    if      (x1 == x2)
+      st7735line (x1, y1, x2, y2, colour) ;
+    else if (x1 < x2)
+      for (x = x1 ; x <= x2 ; ++x)
+	st7735line (x, y1, x, y2, colour) ;
+    else
+      for (x = x2 ; x <= x1 ; ++x)
+	st7735line (x, y1, x, y2, colour) ;
+  }
+  else
+  {
+    st7735line   (x1, y1, x2, y1, colour) ;
+    st7735lineTo (x2, y2, colour) ;
+    st7735lineTo (x1, y2, colour) ;
+    st7735lineTo (x1, y1, colour) ;
+  }
+}
+
+
+/*
+ * st7735circle:
+ *      This is the midpoint circle algorithm.
+ *********************************************************************************
+ */
+
+void st7735circle (int x, int y, int r, int colour, int filled)
+{
+  int ddF_x = 1 ;
+  int ddF_y = -2 * r ;
+
+  int f = 1 - r ;
+  int x1 = 0 ;
+  int y1 = r ;
+
+  if (filled)
+  {
+    st7735line (x, y + r, x, y - r, colour) ;
+    st7735line (x + r, y, x - r, y, colour) ;
+  }
+  else
+  {
+    st7735point (x, y + r, colour) ;
+    st7735point (x, y - r, colour) ;
+    st7735point (x + r, y, colour) ;
+    st7735point (x - r, y, colour) ;
+  }
+
+  while (x1 < y1)
+  {
+    if (f >= 0)
+    {
+      y1-- ;
+      ddF_y += 2 ;
+      f += ddF_y ;
+    }
+    x1++ ;
+    ddF_x += 2 ;
+    f += ddF_x ;
+    if (filled)
+    {
+      st7735line (x + x1, y + y1, x - x1, y + y1, colour) ;
+      st7735line (x + x1, y - y1, x - x1, y - y1, colour) ;
+      st7735line (x + y1, y + x1, x - y1, y + x1, colour) ;
+      st7735line (x + y1, y - x1, x - y1, y - x1, colour) ;
+    }
+    else
+    {
+      st7735point (x + x1, y + y1, colour) ; st7735point (x - x1, y + y1, colour) ;
+      st7735point (x + x1, y - y1, colour) ; st7735point (x - x1, y - y1, colour) ;
+      st7735point (x + y1, y + x1, colour) ; st7735point (x - y1, y + x1, colour) ;
+      st7735point (x + y1, y - x1, colour) ; st7735point (x - y1, y - x1, colour) ;
+    }
+  }
+}
+
+
+/*
+ * st7735ellipse:
+ *	Fast ellipse drawing algorithm by
+ *      John Kennedy
+ *	Mathematics Department
+ *	Santa Monica College
+ *	1900 Pico Blvd.
+ *	Santa Monica, CA 90405
+ *	jrkennedy6@gmail.com
+ *	-Confirned in email this algorithm is in the public domain -GH-
+ *********************************************************************************
+ */
+
+static void plot4ellipsePoints (int cx, int cy, int x, int y, int colour, int filled)
+{
+  if (filled)
+  {
+    st7735line (cx + x, cy + y, cx - x, cy + y, colour) ;
+    st7735line (cx - x, cy - y, cx + x, cy - y, colour) ;
+  }
+  else
+  {
+    st7735point (cx + x, cy + y, colour) ;
+    st7735point (cx - x, cy + y, colour) ;
+    st7735point (cx - x, cy - y, colour) ;
+    st7735point (cx + x, cy - y, colour) ;
+  }
+}
+
+void st7735ellipse (int cx, int cy, int xRadius, int yRadius, int colour, int filled)
+{
+  int x, y ;
+  int xChange, yChange, ellipseError ;
+  int twoAsquare, twoBsquare ;
+  int stoppingX, stoppingY ;
+
+  twoAsquare = 2 * xRadius * xRadius ;
+  twoBsquare = 2 * yRadius * yRadius ;
+
+  x = xRadius ;
+  y = 0 ;
+
+  xChange = yRadius * yRadius * (1 - 2 * xRadius) ;
+  yChange = xRadius * xRadius ;
+
+  ellipseError = 0 ;
+  stoppingX    = twoBsquare * xRadius ;
+  stoppingY    = 0 ;
+
+  while (stoppingX >= stoppingY)	// 1st set of points
+  {
+    plot4ellipsePoints (cx, cy, x, y, colour, filled) ;
+    ++y ;
+    stoppingY    += twoAsquare ;
+    ellipseError += yChange ;
+    yChange      += twoAsquare ;
+
+    if ((2 * ellipseError + xChange) > 0 )
+    {
+      --x ;
+      stoppingX    -= twoBsquare ;
+      ellipseError += xChange ;
+      xChange      += twoBsquare ;
+    }
+  }
+
+  x = 0 ;
+  y = yRadius ;
+
+  xChange = yRadius * yRadius ;
+  yChange = xRadius * xRadius * (1 - 2 * yRadius) ;
+
+  ellipseError = 0 ;
+  stoppingX    = 0 ;
+  stoppingY    = twoAsquare * yRadius ;
+
+  while (stoppingX <= stoppingY)	//2nd set of points
+  {
+    plot4ellipsePoints (cx, cy, x, y, colour, filled) ;
+    ++x ;
+    stoppingX    += twoBsquare ;
+    ellipseError += xChange ;
+    xChange      += twoBsquare ;
+
+    if ((2 * ellipseError + yChange) > 0 )
+    {
+      --y ;
+      stoppingY -= twoAsquare ;
+      ellipseError += yChange ;
+      yChange += twoAsquare ;
+    }
+  }
+}
+
+
+/*
+ * st7735putchar:
+ *	Print a single character to the screen
+ *********************************************************************************
+ */
+
+void st7735putchar (int x, int y, int c, int bgCol, int fgCol)
+{
+  int y1, y2 ;
+
+  unsigned char line ;
+  unsigned char *fontPtr ;
+
+  fontPtr = font + c * fontHeight ;
+
+  for (y1 = fontHeight - 1 ; y1 >= 0 ; --y1)
+  {
+    y2 = y + y1 ;
+    line = *fontPtr++ ;
+    st7735point (x + 0, y2, (line & 0x80) == 0 ? bgCol : fgCol) ;
+    st7735point (x + 1, y2, (line & 0x40) == 0 ? bgCol : fgCol) ;
+    st7735point (x + 2, y2, (line & 0x20) == 0 ? bgCol : fgCol) ;
+    st7735point (x + 3, y2, (line & 0x10) == 0 ? bgCol : fgCol) ;
+    st7735point (x + 4, y2, (line & 0x08) == 0 ? bgCol : fgCol) ;
+    st7735point (x + 5, y2, (line & 0x04) == 0 ? bgCol : fgCol) ;
+    st7735point (x + 6, y2, (line & 0x02) == 0 ? bgCol : fgCol) ;
+    st7735point (x + 7, y2, (line & 0x01) == 0 ? bgCol : fgCol) ;
+  }
+}
+
+
+/*
+ * st7735puts:
+ *	Send a string to the display. Obeys \n and \r formatting
+ *********************************************************************************
+ */
+
+void st7735puts (int x, int y, const char *str, int bgCol, int fgCol)
+{
+  int c, mx, my ;
+
+  mx = x ; my = y ;
+
+  while (*str)
+  {
+    c = *str++ ;
+
+    if (c == '\r')
+    {
+      mx = x ;
+      continue ;
+    }
+
+    if (c == '\n')
+    {
+      mx  = x ;
+      my -= fontHeight ;
+      continue ;
+    }
+
+    st7735putchar (mx, my, c, bgCol, fgCol) ;
+
+    mx += fontWidth ;
+    if (mx >= (maxX - fontWidth))
+    {
+      mx  = 0 ;
+      my -= fontHeight ;
+    }
+  }
+}
+
+
+/*
+ * st7735clear:
+ *	Clear the display to the given colour.
+ *********************************************************************************
+ */
+
+void st7735clear (int colour)
+{
+  register int i ;
+  register uint16_t *ptr = frameBuffer ;
+
+  for (i = 0 ; i < (maxX * maxY) ; ++i)
+    *ptr++ = colour ;
+
+  dirty.minX = 0 ;              dirty.minY = 0 ;	// Everything needs a re-send
+  dirty.maxX = TFT_WIDTH - 1 ;  dirty.maxY = TFT_HEIGHT - 1 ;
+}
+
+
+/*
+ * st7735setup:
+ *	Initialise the display, the SPI channel and the control pins.
+ *	rstPin may be -1 when the reset line is tied high.
+ *********************************************************************************
+ */
+
+int st7735setup (int spiChannel, int dataCommandPin, int rstPin)
+{
+  unsigned char colmod = 0x05 ;		// 16-bit RGB565
+  unsigned char madctl = 0xA0 ;		// Row/column exchange + mirror: landscape, 0,0 top left
+
+  if (wiringPiSPISetup (spiChannel, 16000000) < 0)
+    return -1 ;
+
+  spiChan = spiChannel ;
+  dcPin   = dataCommandPin ;
+
+  digitalWrite (dcPin, HIGH) ;
+  pinMode      (dcPin, OUTPUT) ;
+
+  if (rstPin >= 0)
+  {
+    digitalWrite (rstPin, HIGH) ;
+    pinMode      (rstPin, OUTPUT) ;
+    delay (1) ;
+    digitalWrite (rstPin, LOW) ;  delay (10) ;
+    digitalWrite (rstPin, HIGH) ; delay (120) ;
+  }
+
+  sendCommand (TFT_SWRESET) ;	delay (150) ;
+  sendCommand (TFT_SLPOUT) ;	delay (120) ;
+
+  sendCommand (TFT_COLMOD) ;	sendData (&colmod, 1) ;
+  sendCommand (TFT_MADCTL) ;	sendData (&madctl, 1) ;
+  sendCommand (TFT_INVOFF) ;
+  sendCommand (TFT_NORON) ;
+
+  st7735setOrientation (0) ;
+  st7735clear          (0) ;
+  st7735update         () ;
+
+  sendCommand (TFT_DISPON) ;	delay (100) ;
+
+  return 0 ;
+}
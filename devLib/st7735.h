@@ -0,0 +1,50 @@
+/*
+ * st7735.h:
+ *	ST7735 160x128 colour TFT display over SPI.
+ *
+ * Copyright (c) 2013-2025 Gordon Henderson and contributors.
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public License
+ *    along with wiringPi.  If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+extern void st7735setOrigin         (int x, int y) ;
+extern void st7735setOrientation    (int orientation) ;
+extern void st7735orientCoordinates (int *x, int *y) ;
+extern void st7735getScreenSize     (int *x, int *y) ;
+extern void st7735point             (int  x, int  y, int colour) ;
+extern void st7735line              (int x0, int y0, int x1, int y1, int colour) ;
+extern void st7735lineTo            (int  x, int  y, int colour) ;
+extern void st7735rectangle         (int x1, int y1, int x2, int y2, int colour, int filled) ;
+extern void st7735circle            (int  x, int  y, int  r, int colour, int filled) ;
+extern void st7735ellipse           (int cx, int cy, int xRadius, int yRadius, int colour, int filled) ;
+extern void st7735putchar           (int  x, int  y, int c, int bgCol, int fgCol) ;
+extern void st7735puts              (int  x, int  y, const char *str, int bgCol, int fgCol) ;
+extern void st7735update            (void) ;
+extern void st7735clear             (int colour) ;
+
+// Colours are RGB565
+
+extern int  st7735colour            (int r, int g, int b) ;
+
+// Interface V3.17 - double-buffered updates: flip snapshots the frame
+//	and returns immediately, a background thread paces the bus
+
+extern void st7735flip              (void) ;
+extern void st7735flipRate          (int fps) ;
+
+extern int  st7735setup             (int spiChannel, int dcPin, int rstPin) ;
@@ -0,0 +1,321 @@
+/*
+ * ws2812.c:
+ *	Driver for WS2812/NeoPixel LED strips hung off SPI MOSI.
+ *
+ *	The WS2812 wants its bits as timed pulses, which SPI can fake:
+ *	at 2.4MHz every data bit becomes a 3-bit symbol on the wire -
+ *	110 for a one, 100 for a zero - giving the 800KHz cadence the
+ *	LEDs expect, with the chip-select and clock pins unused.
+ *
+ *	Encoding is the expensive half on long strips, so it's done a
+ *	nibble at a time from lookup tables: on AArch64 a NEON loop
+ *	expands 16 colour bytes per iteration into 48 wire bytes with
+ *	vqtbl1q table lookups and one interleaving store, and everything
+ *	else uses the same tables through a byte-wide scalar LUT. A
+ *	300-LED frame encodes in a few microseconds either way.
+ *
+ * Copyright (c) 2013-2025 Gordon Henderson and contributors.
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public License
+ *    along with wiringPi.  If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined (__aarch64__) && defined (__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+
+#include "ws2812.h"
+
+#define	WS2812_SPI_SPEED	2400000	// 3 wire bits per data bit = 800KHz at the LED
+#define	WS2812_LATCH_BYTES	60	// > 50uS of zeros - the latch/reset gap
+#define	WS2812_CHANNELS		4
+#define	WS2812_FRAME_BYTES	(WS2812_MAX_LEDS * 9 + WS2812_LATCH_BYTES)
+
+// One strip per SPI channel. The wire frame lives in a wpiBufAlloc()
+//	buffer so the spidev write goes out cache-line aligned - from an
+//	unaligned static the kernel bounce-copies every frame.
+
+struct ws2812Strip
+{
+  int numLeds ;				// 0 marks a free slot
+  unsigned char pixels     [WS2812_MAX_LEDS * 3] ;	// GRB, wire order
+  unsigned char flipPixels [WS2812_MAX_LEDS * 3] ;
+  unsigned char *frame ;
+  int flipPending ;
+} ;
+
+static struct ws2812Strip strips [WS2812_CHANNELS] ;
+
+// Encode tables, built on first setup. A nibble becomes 12 wire bits,
+//	so a byte becomes 3 wire bytes: t0 is the top 8 bits of the high
+//	nibble's symbol, t1a/t1b the nibble-straddling middle byte and t2
+//	the low 8 bits of the low nibble's symbol. encLut is the same
+//	thing folded byte-wide for the scalar path.
+
+static uint8_t encT0 [16], encT1a [16], encT1b [16], encT2 [16] ;
+static unsigned char encLut [256][3] ;
+static int encReady = FALSE ;
+
+
+/*
+ * encSymbol:
+ *	The 12-bit wire symbol for one data nibble - 110 per one bit,
+ *	100 per zero bit, MSB first.
+ *********************************************************************************
+ */
+
+static unsigned int encSymbol (const unsigned int nibble)
+{
+  unsigned int sym = 0 ;
+  int bit ;
+
+  for (bit = 3 ; bit >= 0 ; --bit)
+    sym = (sym << 3) | ((nibble & (1 << bit)) ? 6 : 4) ;
+
+  return sym ;
+}
+
+static void encBuildTables (void)
+{
+  unsigned int n, b, hi, lo ;
+
+  for (n = 0 ; n < 16 ; ++n)
+  {
+    encT0  [n] =  encSymbol (n) >> 4 ;
+    encT1a [n] = (encSymbol (n) & 0x0F) << 4 ;
+    encT1b [n] =  encSymbol (n) >> 8 ;
+    encT2  [n] =  encSymbol (n) & 0xFF ;
+  }
+
+  for (b = 0 ; b < 256 ; ++b)
+  {
+    hi = b >> 4 ;
+    lo = b & 0x0F ;
+    encLut [b][0] = encT0 [hi] ;
+    encLut [b][1] = encT1a [hi] | encT1b [lo] ;
+    encLut [b][2] = encT2 [lo] ;
+  }
+
+  encReady = TRUE ;
+}
+
+
+/*
+ * ws2812Encode:
+ *	Expand colour bytes into wire bytes, 3 for 1. The NEON loop does
+ *	16 input bytes per iteration; the scalar LUT mops up the tail and
+ *	carries the other platforms.
+ *********************************************************************************
+ */
+
+static void ws2812Encode (const unsigned char *pixels, unsigned char *frame, const int numBytes)
+{
+  int i = 0 ;
+
+#if defined (__aarch64__) && defined (__ARM_NEON)
+  {
+    const uint8x16_t t0  = vld1q_u8 (encT0) ;
+    const uint8x16_t t1a = vld1q_u8 (encT1a) ;
+    const uint8x16_t t1b = vld1q_u8 (encT1b) ;
+    const uint8x16_t t2  = vld1q_u8 (encT2) ;
+    const uint8x16_t nib = vdupq_n_u8 (0x0F) ;
+    uint8x16_t v, hi, lo ;
+    uint8x16x3_t out ;
+
+    for (; i + 16 <= numBytes ; i += 16)
+    {
+      v  = vld1q_u8 (pixels + i) ;
+      hi = vshrq_n_u8 (v, 4) ;
+      lo = vandq_u8 (v, nib) ;
+      out.val [0] = vqtbl1q_u8 (t0, hi) ;
+      out.val [1] = vorrq_u8 (vqtbl1q_u8 (t1a, hi), vqtbl1q_u8 (t1b, lo)) ;
+      out.val [2] = vqtbl1q_u8 (t2, lo) ;
+      vst3q_u8 (frame + i * 3, out) ;
+    }
+  }
+#endif
+
+  for (; i < numBytes ; ++i)
+  {
+    frame [i * 3 + 0] = encLut [pixels [i]][0] ;
+    frame [i * 3 + 1] = encLut [pixels [i]][1] ;
+    frame [i * 3 + 2] = encLut [pixels [i]][2] ;
+  }
+}
+
+
+/*
+ * pushStrip:
+ *	Encode a pixel buffer and send it, latch gap included.
+ *********************************************************************************
+ */
+
+static void pushStrip (const int chan, const unsigned char *pixels)
+{
+  struct ws2812Strip *strip = &strips [chan] ;
+
+  ws2812Encode (pixels, strip->frame, strip->numLeds * 3) ;
+  wiringPiSPIWrite (chan, strip->frame, strip->numLeds * 9 + WS2812_LATCH_BYTES) ;
+}
+
+
+/*
+ * ws2812SetPixel:
+ *	Set one LED in the soft buffer - nothing hits the wire until
+ *	ws2812Show or ws2812Flip.
+ *********************************************************************************
+ */
+
+void ws2812SetPixel (int spiChannel, int led, int r, int g, int b)
+{
+  unsigned char *p ;
+
+  if ((spiChannel < 0) || (spiChannel >= WS2812_CHANNELS) || (strips [spiChannel].numLeds == 0))
+    return ;
+  if ((led < 0) || (led >= strips [spiChannel].numLeds))
+    return ;
+
+  p = &strips [spiChannel].pixels [led * 3] ;
+  p [0] = g ;			// The wire wants GRB
+  p [1] = r ;
+  p [2] = b ;
+}
+
+
+/*
+ * ws2812Show:
+ *	Encode and send the current pixels, blocking until they're out.
+ *********************************************************************************
+ */
+
+void ws2812Show (int spiChannel)
+{
+  if ((spiChannel < 0) || (spiChannel >= WS2812_CHANNELS) || (strips [spiChannel].numLeds == 0))
+    return ;
+
+  pushStrip (spiChannel, strips [spiChannel].pixels) ;
+}
+
+
+/*
+ * ws2812Flip: ws2812FlipRate:
+ *	Double-buffered updates: flip snapshots the pixels and returns at
+ *	memcpy speed, while a background thread encodes and pushes frames
+ *	at a paced rate. Flips that land between refreshes merge; the
+ *	strip always gets the newest frame.
+ *********************************************************************************
+ */
+
+static int flipRunning = FALSE ;
+static int flipRate    = 60 ;		// Frames per second
+
+static pthread_mutex_t flipLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static PI_THREAD (flipFlusher)
+{
+  static unsigned char fb [WS2812_MAX_LEDS * 3] ;	// Ours alone - no lock held while on the bus
+  int chan, send ;
+
+  for (;;)
+  {
+    delay (1000 / flipRate) ;
+
+    for (chan = 0 ; chan < WS2812_CHANNELS ; ++chan)
+    {
+      pthread_mutex_lock (&flipLock) ;
+      send = strips [chan].flipPending ;
+      if (send)
+      {
+	memcpy (fb, strips [chan].flipPixels, strips [chan].numLeds * 3) ;
+	strips [chan].flipPending = FALSE ;
+      }
+      pthread_mutex_unlock (&flipLock) ;
+
+      if (send)
+	pushStrip (chan, fb) ;
+    }
+  }
+
+  return NULL ;
+}
+
+void ws2812Flip (int spiChannel)
+{
+  if ((spiChannel < 0) || (spiChannel >= WS2812_CHANNELS) || (strips [spiChannel].numLeds == 0))
+    return ;
+
+  pthread_mutex_lock (&flipLock) ;
+  memcpy (strips [spiChannel].flipPixels, strips [spiChannel].pixels, strips [spiChannel].numLeds * 3) ;
+  strips [spiChannel].flipPending = TRUE ;
+  pthread_mutex_unlock (&flipLock) ;
+
+  if (!flipRunning)
+    flipRunning = (piThreadCreate (flipFlusher) == 0) ;
+}
+
+void ws2812FlipRate (int fps)
+{
+  if (fps < 1)
+    fps = 1 ;
+  else if (fps > 200)
+    fps = 200 ;
+  flipRate = fps ;
+}
+
+
+/*
+ * ws2812Setup:
+ *	Claim an SPI channel for a strip. Wire the LED DIN to that
+ *	channel's MOSI; clock and chip-select stay unused.
+ *********************************************************************************
+ */
+
+int ws2812Setup (int spiChannel, int numLeds)
+{
+  struct ws2812Strip *strip ;
+
+  if ((spiChannel < 0) || (spiChannel >= WS2812_CHANNELS))
+    return -1 ;
+  if ((numLeds < 1) || (numLeds > WS2812_MAX_LEDS))
+    return -1 ;
+
+  if (wiringPiSPISetup (spiChannel, WS2812_SPI_SPEED) < 0)
+    return -1 ;
+
+  if (!encReady)
+    encBuildTables () ;
+
+  strip = &strips [spiChannel] ;
+  if (strip->frame == NULL)
+    if ((strip->frame = (unsigned char *)wpiBufAlloc (WS2812_FRAME_BYTES, 0)) == NULL)
+      return -1 ;
+  memset (strip->pixels, 0, sizeof (strip->pixels)) ;
+  memset (strip->frame,  0, WS2812_FRAME_BYTES) ;	// Includes the latch tail
+  strip->flipPending = FALSE ;
+  strip->numLeds     = numLeds ;
+
+  pushStrip (spiChannel, strip->pixels) ;	// Start dark
+
+  return 0 ;
+}
@@ -0,0 +1,36 @@
+/*
+ * ws2812.h:
+ *	WS2812/NeoPixel LED strips over SPI MOSI.
+ *
+ * Copyright (c) 2013-2025 Gordon Henderson and contributors.
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public License
+ *    along with wiringPi.  If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#define	WS2812_MAX_LEDS	1024
+
+extern int  ws2812Setup    (int spiChannel, int numLeds) ;
+extern void ws2812SetPixel (int spiChannel, int led, int r, int g, int b) ;
+extern void ws2812Show     (int spiChannel) ;
+
+// Interface V3.17 - double-buffered updates: flip snapshots the pixels
+//	and returns immediately, a background thread encodes and paces
+//	the bus
+
+extern void ws2812Flip     (int spiChannel) ;
+extern void ws2812FlipRate (int fps) ;
@@ -31,10 +31,18 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include <wiringPi.h>
+#include <wiringPiI2C.h>
+#include <wiringPiSPI.h>
+#include <wiringPiWave.h>
 #include <wpiExtensions.h>
 
 #include <gertboard.h>
@@ -77,13 +85,32 @@ char *usage = "Usage: gpio -v\n"
               "       gpio readall\n"
               "       gpio wfi <pin> <mode>\n"
               "         where <mode> can be: rising, falling, both\n"
+              "       gpio monitor [-o file] [-b] [-t seconds] <pin> [pin...]\n"
+              "         stream timestamped edges; -b: binary records, -o: to file\n"
               "       gpio drive <group> <value>\n"
               "       gpio pwm-bal/pwm-ms \n"
               "       gpio pwmr <range> \n"
               "       gpio pwmc <divider> \n"
               "       gpio i2cd/i2cdetect\n"
+              "       gpio i2cscan [bus]\n"
+              "         fast quick-write probe, all buses scanned concurrently\n"
+              "       gpio i2c <bus> <addr> w <byte>.. r <n> ..\n"
+              "       gpio spi <bus> <cs> [speed <hz>] xfer <byte>..\n"
+              "         raw combined transfers; `batch <file>` runs one per line\n"
               "       gpio rbx/rbd\n"
               "       gpio wb <value>\n"
+              "       gpio batch [file]\n"
+              "       gpio -\n"
+              "         batch/-: many commands (one per line, # comments) against one setup\n"
+              "       gpio daemon\n"
+              "         serve commands over a Unix socket; gpio delegates to it when up\n"
+              "       gpio stats [file]\n"
+              "         show per-bus I2C/SPI transaction counters\n"
+              "       gpio wave info/play/record <file> ...\n"
+              "         inspect, replay or capture a .wpiwave waveform (BCM pins)\n"
+              "       gpio compileconfig <text> <profile>\n"
+              "       gpio applyconfig <profile>\n"
+              "         one-pass boot pin configuration from a compiled profile\n"
               "       gpio usbp high/low\n"
               "       gpio gbr <channel>\n"
               "       gpio gbw <channel> <value>" ;	// No trailing newline needed here.
@@ -133,6 +160,333 @@ static void doI2Cdetect (const char *progName)
 }
 
 
+/*
+ * doI2Cscan:
+ *	Probe every I2C bus with fast quick-write probes - all buses in
+ *	flight at once, so a stuck bus doesn't hold up the others. An
+ *	optional bus number limits the scan to that one bus.
+ *********************************************************************************
+ */
+
+#define	MAX_I2C_BUSES	32
+#define	MAX_I2C_ADDRS	120
+
+static int scanBuses  [MAX_I2C_BUSES] ;
+static int scanCounts [MAX_I2C_BUSES] ;
+static int scanAddrs  [MAX_I2C_BUSES][MAX_I2C_ADDRS] ;
+static int scanDone ;
+
+static void i2cScanWorker (void *arg)
+{
+  int slot = (int)(intptr_t)arg ;
+
+  scanCounts [slot] = wiringPiI2CScan (scanBuses [slot], scanAddrs [slot], MAX_I2C_ADDRS) ;
+  __atomic_add_fetch (&scanDone, 1, __ATOMIC_RELEASE) ;
+}
+
+static void doI2Cscan (int argc, char *argv [])
+{
+  char device [32] ;
+  int numBuses = 0 ;
+  int bus, slot, i ;
+
+  if (argc > 2)
+    scanBuses [numBuses++] = atoi (argv [2]) ;
+  else
+    for (bus = 0 ; (bus < 256) && (numBuses < MAX_I2C_BUSES) ; ++bus)
+    {
+      snprintf (device, 32, "/dev/i2c-%d", bus) ;
+      if (access (device, F_OK) == 0)
+	scanBuses [numBuses++] = bus ;
+    }
+
+  if (numBuses == 0)
+  {
+    fprintf (stderr, "%s: No I2C buses found - is the i2c-dev module loaded?\n", argv [0]) ;
+    exit (1) ;
+  }
+
+  if ((numBuses > 1) && (piThreadPoolCreate (numBuses, 0) == 0))
+  {
+    for (slot = 0 ; slot < numBuses ; ++slot)
+      piThreadPoolSubmit (i2cScanWorker, (void *)(intptr_t)slot) ;
+    while (__atomic_load_n (&scanDone, __ATOMIC_ACQUIRE) != numBuses)
+      delay (1) ;
+  }
+  else
+    for (slot = 0 ; slot < numBuses ; ++slot)
+      scanCounts [slot] = wiringPiI2CScan (scanBuses [slot], scanAddrs [slot], MAX_I2C_ADDRS) ;
+
+  for (slot = 0 ; slot < numBuses ; ++slot)
+  {
+    if (scanCounts [slot] < 0)
+    {
+      printf ("i2c-%d: unable to open\n", scanBuses [slot]) ;
+      continue ;
+    }
+    printf ("i2c-%d:", scanBuses [slot]) ;
+    if (scanCounts [slot] == 0)
+      printf (" (no devices)") ;
+    for (i = 0 ; (i < scanCounts [slot]) && (i < MAX_I2C_ADDRS) ; ++i)
+      printf (" 0x%02X", scanAddrs [slot][i]) ;
+    printf ("\n") ;
+  }
+}
+
+
+/*
+ * doBusI2C: doBusSPI:
+ *	Raw bus transfers from the command line, so bringing up a new
+ *	device doesn't need a throwaway C program:
+ *
+ *	  gpio i2c <bus> <addr> w <byte> .. r <n> ..
+ *	  gpio spi <bus> <cs> [speed <hz>] xfer <byte> ..
+ *
+ *	Each w collects the bytes after it into a write segment, each
+ *	r <n> adds a read segment, and all segments of one command go out
+ *	as a single combined transaction - repeated starts on I2C, CS
+ *	held across the segments on SPI. `batch <file>` runs one command
+ *	per line (same syntax minus the bus prefix, # comments) on one
+ *	open device, so a scripted register dump is one process and a few
+ *	milliseconds. Bytes and counts take the usual 0x prefix for hex.
+ *********************************************************************************
+ */
+
+#define	BUS_MAX_SEGS		8
+#define	BUS_MAX_DATA		256
+#define	BUS_MAX_TOKENS		64
+
+static int busTokenise (char *line, char *toks [])
+{
+  char *token, *hash ;
+  int nToks = 0 ;
+
+  if ((hash = strchr (line, '#')) != NULL)	// Comment runs to end of line
+    *hash = 0 ;
+
+  for (token = strtok (line, " \t\r\n") ; (token != NULL) && (nToks < BUS_MAX_TOKENS) ; token = strtok (NULL, " \t\r\n"))
+    toks [nToks++] = token ;
+
+  return nToks ;
+}
+
+static void busI2CXfer (const char *progName, int fd, int addr, int nToks, char *toks [])
+{
+  struct wiringPiI2CMsg msgs [BUS_MAX_SEGS] ;
+  static uint8_t data [BUS_MAX_SEGS][BUS_MAX_DATA] ;
+  int i = 0, n, seg, b, nMsgs = 0 ;
+
+  while (i < nToks)
+  {
+    if (nMsgs == BUS_MAX_SEGS)
+    {
+      fprintf (stderr, "%s: i2c: too many segments (max %d)\n", progName, BUS_MAX_SEGS) ;
+      exit (EXIT_FAILURE) ;
+    }
+
+    if (strcasecmp (toks [i], "w") == 0)
+    {
+      n = 0 ;
+      for (++i ; (i < nToks) && isdigit ((unsigned char)toks [i][0]) ; ++i)
+      {
+	if (n == BUS_MAX_DATA)
+	{
+	  fprintf (stderr, "%s: i2c: write too long (max %d bytes)\n", progName, BUS_MAX_DATA) ;
+	  exit (EXIT_FAILURE) ;
+	}
+	data [nMsgs][n++] = (uint8_t)strtol (toks [i], NULL, 0) ;
+      }
+      if (n == 0)
+      {
+	fprintf (stderr, "%s: i2c: w needs at least one byte\n", progName) ;
+	exit (EXIT_FAILURE) ;
+      }
+      msgs [nMsgs].flags = 0 ;
+    }
+    else if (strcasecmp (toks [i], "r") == 0)
+    {
+      if (++i >= nToks)
+      {
+	fprintf (stderr, "%s: i2c: r needs a byte count\n", progName) ;
+	exit (EXIT_FAILURE) ;
+      }
+      n = (int)strtol (toks [i++], NULL, 0) ;
+      if ((n < 1) || (n > BUS_MAX_DATA))
+      {
+	fprintf (stderr, "%s: i2c: bad read length: %d\n", progName, n) ;
+	exit (EXIT_FAILURE) ;
+      }
+      msgs [nMsgs].flags = WPI_I2C_M_RD ;
+    }
+    else
+    {
+      fprintf (stderr, "%s: i2c: expected w or r, got: %s\n", progName, toks [i]) ;
+      exit (EXIT_FAILURE) ;
+    }
+
+    msgs [nMsgs].addr = addr ;
+    msgs [nMsgs].len  = n ;
+    msgs [nMsgs].buf  = data [nMsgs] ;
+    ++nMsgs ;
+  }
+
+  if (nMsgs == 0)
+    return ;
+
+  if (wiringPiI2CTransfer (fd, msgs, nMsgs) < 0)
+  {
+    fprintf (stderr, "%s: i2c transfer failed: %s\n", progName, strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  for (seg = 0 ; seg < nMsgs ; ++seg)
+    if (msgs [seg].flags & WPI_I2C_M_RD)
+    {
+      for (b = 0 ; b < msgs [seg].len ; ++b)
+	printf ("%s0x%02X", (b == 0) ? "" : " ", msgs [seg].buf [b]) ;
+      printf ("\n") ;
+    }
+}
+
+static void doBusI2C (int argc, char *argv [])
+{
+  char device [32] ;
+  char line [256] ;
+  char *toks [BUS_MAX_TOKENS] ;
+  FILE *in ;
+  int bus, addr, fd ;
+
+  if (argc < 6)
+  {
+    fprintf (stderr, "Usage: %s i2c <bus> <addr> w <byte> .. r <n> ..\n"
+		     "       %s i2c <bus> <addr> batch <file>\n", argv [0], argv [0]) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  bus  = (int)strtol (argv [2], NULL, 0) ;
+  addr = (int)strtol (argv [3], NULL, 0) ;
+
+  snprintf (device, 32, "/dev/i2c-%d", bus) ;
+  fd = wiringPiI2CSetupInterface (device, addr) ;
+
+  if (strcasecmp (argv [4], "batch") == 0)
+  {
+    if ((in = fopen (argv [5], "r")) == NULL)
+    {
+      fprintf (stderr, "%s: Unable to open %s: %s\n", argv [0], argv [5], strerror (errno)) ;
+      exit (EXIT_FAILURE) ;
+    }
+    while (fgets (line, sizeof (line), in) != NULL)
+      busI2CXfer (argv [0], fd, addr, busTokenise (line, toks), toks) ;
+    fclose (in) ;
+  }
+  else
+    busI2CXfer (argv [0], fd, addr, argc - 4, &argv [4]) ;
+
+  wiringPiI2CClose (fd) ;
+}
+
+static void busSPIXfer (const char *progName, int bus, int cs, int nToks, char *toks [])
+{
+  struct wiringPiSPISegment segs [BUS_MAX_SEGS] ;
+  static unsigned char tx [BUS_MAX_SEGS][BUS_MAX_DATA], rx [BUS_MAX_SEGS][BUS_MAX_DATA] ;
+  int i = 0, n, seg, b, nSegs = 0 ;
+
+  while (i < nToks)
+  {
+    if ((nSegs == BUS_MAX_SEGS) || (strcasecmp (toks [i], "xfer") != 0))
+    {
+      fprintf (stderr, "%s: spi: expected xfer (max %d segments), got: %s\n", progName, BUS_MAX_SEGS, toks [i]) ;
+      exit (EXIT_FAILURE) ;
+    }
+
+    n = 0 ;
+    for (++i ; (i < nToks) && isdigit ((unsigned char)toks [i][0]) ; ++i)
+    {
+      if (n == BUS_MAX_DATA)
+      {
+	fprintf (stderr, "%s: spi: transfer too long (max %d bytes)\n", progName, BUS_MAX_DATA) ;
+	exit (EXIT_FAILURE) ;
+      }
+      tx [nSegs][n++] = (unsigned char)strtol (toks [i], NULL, 0) ;
+    }
+    if (n == 0)
+    {
+      fprintf (stderr, "%s: spi: xfer needs at least one byte\n", progName) ;
+      exit (EXIT_FAILURE) ;
+    }
+
+    memset (&segs [nSegs], 0, sizeof (segs [nSegs])) ;
+    segs [nSegs].txData = tx [nSegs] ;
+    segs [nSegs].rxData = rx [nSegs] ;
+    segs [nSegs].len    = n ;
+    ++nSegs ;
+  }
+
+  if (nSegs == 0)
+    return ;
+
+  if (wiringPiSPIxDataRWn (bus, cs, segs, nSegs) < 0)
+  {
+    fprintf (stderr, "%s: spi transfer failed: %s\n", progName, strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  for (seg = 0 ; seg < nSegs ; ++seg)
+  {
+    for (b = 0 ; b < (int)segs [seg].len ; ++b)
+      printf ("%s0x%02X", (b == 0) ? "" : " ", rx [seg][b]) ;
+    printf ("\n") ;
+  }
+}
+
+static void doBusSPI (int argc, char *argv [])
+{
+  char line [256] ;
+  char *toks [BUS_MAX_TOKENS] ;
+  FILE *in ;
+  int bus, cs, speed = 1000000, arg = 4 ;
+
+  if (argc < 6)
+  {
+    fprintf (stderr, "Usage: %s spi <bus> <cs> [speed <hz>] xfer <byte> ..\n"
+		     "       %s spi <bus> <cs> [speed <hz>] batch <file>\n", argv [0], argv [0]) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  bus = (int)strtol (argv [2], NULL, 0) ;
+  cs  = (int)strtol (argv [3], NULL, 0) ;
+
+  if ((strcasecmp (argv [arg], "speed") == 0) && (arg + 2 < argc))
+  {
+    speed = (int)strtol (argv [arg + 1], NULL, 0) ;
+    arg += 2 ;
+  }
+
+  if (wiringPiSPIxSetup (bus, cs, speed) < 0)
+  {
+    fprintf (stderr, "%s: Unable to open SPI %d.%d: %s\n", argv [0], bus, cs, strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  if (strcasecmp (argv [arg], "batch") == 0)
+  {
+    if ((arg + 1 >= argc) || ((in = fopen (argv [arg + 1], "r")) == NULL))
+    {
+      fprintf (stderr, "%s: Unable to open batch file: %s\n", argv [0], strerror (errno)) ;
+      exit (EXIT_FAILURE) ;
+    }
+    while (fgets (line, sizeof (line), in) != NULL)
+      busSPIXfer (argv [0], bus, cs, busTokenise (line, toks), toks) ;
+    fclose (in) ;
+  }
+  else
+    busSPIXfer (argv [0], bus, cs, argc - arg, &argv [arg]) ;
+
+  wiringPiSPIxClose (bus, cs) ;
+}
+
+
 void SYSFS_DEPRECATED(const char *progName) {
   fprintf(stderr, "%s: GPIO Sysfs Interface for Userspace is deprecated (https://www.kernel.org/doc/Documentation/gpio/sysfs.txt).\n Function is now useless and empty.\n\n", progName);
 }
@@ -272,42 +626,637 @@ void doWfi(int argc, char *argv [])
   if (argc>=5) {
     interations = atoi(argv[4]);
   }
-  if (argc>=6) {
-    timeoutSec = atoi(argv[5]);
+  if (argc>=6) {
+    timeoutSec = atoi(argv[5]);
+  }
+
+  doWfiInternal(argv[1], pin, mode, interations, timeoutSec, -1);
+}
+
+
+void doWfi2(int argc, char *argv [])
+{
+  int pin, mode, interations=1, debounce=50000;
+  int timeoutSec = 2147483647;
+
+  if (argc != 4 && argc != 5 && argc != 6 && argc != 7) {
+    fprintf (stderr, "Usage: %s wfis pin mode [debounce period microsec.] [interations] [timeout sec.]\n", argv [0]);
+    exit(-2);
+  }
+
+  pin  = atoi (argv[2]) ;
+  mode = get_wfi_edge(argv[1], argv[3], -1);
+  if (argc>=5) {
+    debounce = atoi(argv[4]);
+  }
+  if (argc>=6) {
+    interations = atoi(argv[5]);
+  }
+  if (argc>=7) {
+    timeoutSec = atoi(argv[6]);
+  }
+  if (timeoutSec<0 || interations<0 || debounce<0) {
+    fprintf (stderr, " invalid parameter\n");
+    exit(-2);
+  }
+
+  doWfiInternal(argv[1], pin, mode, interations, timeoutSec, debounce);
+  exit(-1); // timeout
+}
+
+
+/*
+ * doMonitor:
+ *	gpio monitor [-o file] [-b] [-t seconds] pin [pin...]
+ *	Stream kernel-timestamped edges from any number of pins through the
+ *	shared epoll event loop - one C process instead of a Python gpiomon
+ *	per node. Text goes to stdout or the -o file; -b switches to fixed
+ *	16-byte binary records for rates where formatting is the bottleneck.
+ *	A once-a-second event rate is shown on stderr.
+ *********************************************************************************
+ */
+
+struct monitorRecord {		// the -b binary record, 16 bytes, host byte order
+  uint64_t timeStampUs ;
+  uint32_t pinBCM ;
+  uint32_t edge ;		// INT_EDGE_RISING or INT_EDGE_FALLING
+} ;
+
+static FILE *monitorOut = NULL ;
+static int monitorBinary = FALSE ;
+static volatile unsigned long long monitorCount = 0 ;
+static volatile int monitorStop = FALSE ;
+
+static void monitorEvent (struct WPIWfiStatus wfiStatus, UNU void *userdata)
+{
+  monitorCount++ ;
+  if (monitorBinary)
+  {
+    struct monitorRecord rec ;
+
+    rec.timeStampUs = (uint64_t)wfiStatus.timeStamp_us ;
+    rec.pinBCM      = wfiStatus.pinBCM ;
+    rec.edge        = (uint32_t)wfiStatus.edge ;
+    fwrite (&rec, sizeof (rec), 1, monitorOut) ;
+  }
+  else
+    fprintf (monitorOut, "%lld %u %s\n", wfiStatus.timeStamp_us, wfiStatus.pinBCM,
+	(wfiStatus.edge == INT_EDGE_RISING) ? "rising" : "falling") ;
+}
+
+static void monitorSigint (UNU int signum)
+{
+  monitorStop = TRUE ;
+}
+
+static void doMonitor (int argc, char *argv [])
+{
+  unsigned long long last, now ;
+  int pins [64] ;
+  int numPins, seconds, runSec, arg, i ;
+  const char *fileName ;
+
+  fileName = NULL ;
+  seconds  = 0 ;		// 0: until interrupted
+
+  for (arg = 2 ; arg < argc ; ++arg)
+  {
+    if ((strcasecmp (argv [arg], "-o") == 0) && (arg + 1 < argc))
+      fileName = argv [++arg] ;
+    else if (strcasecmp (argv [arg], "-b") == 0)
+      monitorBinary = TRUE ;
+    else if ((strcasecmp (argv [arg], "-t") == 0) && (arg + 1 < argc))
+      seconds = atoi (argv [++arg]) ;
+    else
+      break ;			// first pin
+  }
+
+  numPins = 0 ;
+  for (; arg < argc && numPins < 64 ; ++arg)
+    pins [numPins++] = atoi (argv [arg]) ;
+
+  if (numPins == 0)
+  {
+    fprintf (stderr, "Usage: %s monitor [-o file] [-b] [-t seconds] pin [pin...]\n", argv [0]) ;
+    exit (1) ;
+  }
+
+  if (fileName != NULL)
+  {
+    monitorOut = fopen (fileName, monitorBinary ? "wb" : "w") ;
+    if (monitorOut == NULL)
+    {
+      fprintf (stderr, "%s: monitor: Unable to open %s: %s\n", argv [0], fileName, strerror (errno)) ;
+      exit (1) ;
+    }
+  }
+  else
+    monitorOut = stdout ;
+
+  for (i = 0 ; i < numPins ; ++i)
+    if (wiringPiEventLoopAdd (pins [i], INT_EDGE_BOTH, &monitorEvent, 0, NULL) < 0)
+    {
+      fprintf (stderr, "%s: monitor: Unable to watch pin %d: %s\n", argv [0], pins [i], strerror (errno)) ;
+      exit (1) ;
+    }
+
+  signal (SIGINT, monitorSigint) ;
+
+  last = 0 ;
+  for (runSec = 0 ; !monitorStop && (seconds == 0 || runSec < seconds) ; ++runSec)
+  {
+    delay (1000) ;
+    now = monitorCount ;
+    fprintf (stderr, "\r%llu events, %llu/s    ", now, now - last) ;
+    last = now ;
+  }
+  fprintf (stderr, "\n") ;
+
+  for (i = 0 ; i < numPins ; ++i)
+    wiringPiEventLoopRemove (pins [i]) ;
+
+  fflush (monitorOut) ;
+  if (monitorOut != stdout)
+    fclose (monitorOut) ;
+}
+
+
+/*
+ * doWave:
+ *	gpio wave info/play/record <file> - the .wpiwave format (see
+ *	wiringPiWave.h) holds packed wpiWavePulse records, so play is an
+ *	mmap handed straight to wpiWaveCreate(): a stored test sequence
+ *	loads in microseconds and replays with engine-level timing. All
+ *	pins are BCM numbered, as the waveform masks are.
+ *********************************************************************************
+ */
+
+static volatile int waveStop = FALSE ;
+
+static void waveSigint (UNU int signum)
+{
+  waveStop = TRUE ;
+}
+
+static void doWaveInfo (const char *progName, const char *fileName)
+{
+  struct wpiWaveFileHeader hdr ;
+  struct wpiWavePulse pulse ;
+  unsigned long long us, mask ;
+  unsigned int i ;
+  FILE *in ;
+  int pin ;
+
+  if ((in = fopen (fileName, "rb")) == NULL)
+  {
+    fprintf (stderr, "%s: wave: Unable to open %s: %s\n", progName, fileName, strerror (errno)) ;
+    exit (1) ;
+  }
+  if ((fread (&hdr, sizeof (hdr), 1, in) != 1) || (memcmp (hdr.magic, WPI_WAVE_MAGIC, sizeof (hdr.magic)) != 0))
+  {
+    fprintf (stderr, "%s: wave: %s is not a .wpiwave file\n", progName, fileName) ;
+    exit (1) ;
+  }
+
+  us = 0 ;
+  for (i = 0 ; i < hdr.numPulses ; ++i)
+  {
+    if (fread (&pulse, sizeof (pulse), 1, in) != 1)
+      break ;
+    us += pulse.usDelay ;
+  }
+  fclose (in) ;
+
+  printf ("steps:    %u%s\n", hdr.numPulses, (i == hdr.numPulses) ? "" : " (file truncated!)") ;
+  printf ("duration: %llu.%06llu seconds\n", us / 1000000ULL, us % 1000000ULL) ;
+  printf ("pins:    ") ;
+  for (pin = 0, mask = hdr.pinMask ; mask != 0 ; ++pin, mask >>= 1)
+    if (mask & 1)
+      printf (" %d", pin) ;
+  printf ("\n") ;
+}
+
+static void doWavePlay (const char *progName, const char *fileName, int loop)
+{
+  const struct wpiWaveFileHeader *hdr ;
+  const struct wpiWavePulse *pulses ;
+  struct stat sb ;
+  unsigned long long mask ;
+  void *map ;
+  int fd, wave, pin ;
+
+  if ((fd = open (fileName, O_RDONLY)) < 0)
+  {
+    fprintf (stderr, "%s: wave: Unable to open %s: %s\n", progName, fileName, strerror (errno)) ;
+    exit (1) ;
+  }
+  fstat (fd, &sb) ;
+
+  map = mmap (NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+  close (fd) ;
+  hdr = (const struct wpiWaveFileHeader *)map ;
+
+  if ((map == MAP_FAILED) || ((size_t)sb.st_size < sizeof (*hdr)) ||
+	(memcmp (hdr->magic, WPI_WAVE_MAGIC, sizeof (hdr->magic)) != 0) ||
+	((size_t)sb.st_size < sizeof (*hdr) + (size_t)hdr->numPulses * sizeof (struct wpiWavePulse)))
+  {
+    fprintf (stderr, "%s: wave: %s is not a complete .wpiwave file\n", progName, fileName) ;
+    exit (1) ;
+  }
+  pulses = (const struct wpiWavePulse *)(hdr + 1) ;
+
+  for (pin = 0, mask = hdr->pinMask ; mask != 0 ; ++pin, mask >>= 1)
+    if (mask & 1)
+      pinMode (pin, OUTPUT) ;
+
+  if ((wave = wpiWaveCreate (pulses, (int)hdr->numPulses)) < 0)
+  {
+    fprintf (stderr, "%s: wave: Unable to create the waveform\n", progName) ;
+    exit (1) ;
+  }
+  munmap (map, sb.st_size) ;	// the engine holds its own copy now
+
+  signal (SIGINT, waveSigint) ;
+
+  if (wpiWaveTxStart (wave, loop) < 0)
+  {
+    fprintf (stderr, "%s: wave: Unable to start transmission\n", progName) ;
+    exit (1) ;
+  }
+  while (!waveStop && wpiWaveTxBusy ())
+    delay (10) ;
+
+  wpiWaveTxStop () ;
+  wpiWaveDelete (wave) ;
+}
+
+static int waveEventCompare (const void *a, const void *b)
+{
+  const struct WPIEdgeEvent *ea = (const struct WPIEdgeEvent *)a ;
+  const struct WPIEdgeEvent *eb = (const struct WPIEdgeEvent *)b ;
+
+  return (ea->timeStamp_ns < eb->timeStamp_ns) ? -1 : (ea->timeStamp_ns > eb->timeStamp_ns) ? 1 : 0 ;
+}
+
+static void doWaveRecord (const char *progName, const char *fileName, int seconds, const int *pins, int numPins)
+{
+  struct wpiWaveFileHeader hdr ;
+  struct WPIEdgeEvent *events ;
+  struct wpiWavePulse *pulses, *step ;
+  unsigned long long startMs, lastNs, bit ;
+  int numEvents, maxEvents, numPulses ;
+  FILE *out ;
+  int i, n ;
+
+  for (i = 0 ; i < numPins ; ++i)
+    if (wiringPiEdgeCaptureOpen (pins [i], INT_EDGE_BOTH, 0) < 0)
+    {
+      fprintf (stderr, "%s: wave: Unable to capture pin %d\n", progName, pins [i]) ;
+      exit (1) ;
+    }
+
+  maxEvents = 4096 ;
+  numEvents = 0 ;
+  events    = (struct WPIEdgeEvent *)malloc (maxEvents * sizeof (struct WPIEdgeEvent)) ;
+
+  signal (SIGINT, waveSigint) ;
+  startMs = millis () ;
+
+  while (!waveStop && ((seconds == 0) || (millis () - startMs < (unsigned int)seconds * 1000ULL)))
+    for (i = 0 ; i < numPins ; ++i)
+    {
+      if (numEvents + 256 > maxEvents)
+      {
+	maxEvents *= 2 ;
+	events = (struct WPIEdgeEvent *)realloc (events, maxEvents * sizeof (struct WPIEdgeEvent)) ;
+      }
+      // The first pin carries the wait so an idle recording doesn't spin
+      n = wiringPiEdgeCaptureRead (pins [i], events + numEvents, 256, (i == 0) ? 20 : 0) ;
+      if (n > 0)
+	numEvents += n ;
+    }
+
+  for (i = 0 ; i < numPins ; ++i)
+    wiringPiEdgeCaptureClose (pins [i]) ;
+
+  if ((events == NULL) || (numEvents == 0))
+  {
+    fprintf (stderr, "%s: wave: no edges captured\n", progName) ;
+    exit (1) ;
+  }
+
+// Batches interleave per pin, so order the lot, then fold edges that
+//	share a microsecond into one step whose delay runs to the next step
+
+  qsort (events, numEvents, sizeof (struct WPIEdgeEvent), waveEventCompare) ;
+
+  pulses    = (struct wpiWavePulse *)calloc (numEvents, sizeof (struct wpiWavePulse)) ;
+  numPulses = 0 ;
+  lastNs    = 0 ;
+  for (i = 0 ; i < numEvents ; ++i)
+  {
+    bit = 1ULL << events [i].pinBCM ;
+    if ((numPulses == 0) || ((events [i].timeStamp_ns / 1000) != (lastNs / 1000)))
+    {
+      if (numPulses > 0)
+	pulses [numPulses - 1].usDelay = (unsigned int)((events [i].timeStamp_ns - lastNs) / 1000) ;
+      ++numPulses ;
+      lastNs = events [i].timeStamp_ns ;
+    }
+    step = &pulses [numPulses - 1] ;
+    if (events [i].edge == INT_EDGE_RISING)
+    {
+      step->gpioOn  |=  bit ;
+      step->gpioOff &= ~bit ;
+    }
+    else
+    {
+      step->gpioOff |=  bit ;
+      step->gpioOn  &= ~bit ;
+    }
+  }
+  pulses [numPulses - 1].usDelay = 1 ;
+  free (events) ;
+
+  memset (&hdr, 0, sizeof (hdr)) ;
+  memcpy (hdr.magic, WPI_WAVE_MAGIC, sizeof (hdr.magic)) ;
+  hdr.numPulses = (unsigned int)numPulses ;
+  for (i = 0 ; i < numPins ; ++i)
+    hdr.pinMask |= 1ULL << pins [i] ;
+
+  if ((out = fopen (fileName, "wb")) == NULL)
+  {
+    fprintf (stderr, "%s: wave: Unable to write %s: %s\n", progName, fileName, strerror (errno)) ;
+    exit (1) ;
+  }
+  fwrite (&hdr, sizeof (hdr), 1, out) ;
+  fwrite (pulses, sizeof (struct wpiWavePulse), numPulses, out) ;
+  fclose (out) ;
+  free (pulses) ;
+
+  printf ("%d edges -> %d steps -> %s\n", numEvents, numPulses, fileName) ;
+}
+
+/*
+ * doCompileConfig: doApplyConfig:
+ *	gpio compileconfig <text> <profile> / gpio applyconfig <profile> -
+ *	one-pass board bring-up. A boot script of 35 single gpio commands
+ *	pays 35 process setups; a compiled profile applies everything in
+ *	one process through wiringPiConfigPins() and one digitalWriteMulti.
+ *
+ *	Text format, one directive per line, # comments, BCM pins:
+ *	  extension <name:pinBase:args>        as gpio -x
+ *	  pin <n> [in|out|pwm|clock] [up|down|tri] [drive 0-3] [high|low]
+ *
+ *	The profile holds the extension strings, packed WPIPinConfig
+ *	records and the initial levels - no parsing at boot.
+ *********************************************************************************
+ */
+
+#define	CFG_MAGIC	"WPICFG1"
+#define	CFG_EXT_LEN	96
+
+struct cfgFileHeader
+{
+  char magic [8] ;
+  unsigned int numExtensions ;
+  unsigned int numConfigs ;
+  unsigned int numLevels ;
+  unsigned int reserved ;
+} ;
+
+struct cfgLevel
+{
+  int pin ;
+  int value ;
+} ;
+
+#define	CFG_MAX_ENTRIES	256
+
+static void doCompileConfig (const char *progName, const char *textName, const char *profileName)
+{
+  static char extensions [CFG_MAX_ENTRIES][CFG_EXT_LEN] ;
+  static struct WPIPinConfig cfgs [CFG_MAX_ENTRIES] ;
+  static struct cfgLevel levels [CFG_MAX_ENTRIES] ;
+  struct cfgFileHeader hdr ;
+  struct WPIPinConfig *cfg ;
+  char line [256], *p, *tok ;
+  FILE *in, *out ;
+  int lineNo ;
+
+  memset (&hdr, 0, sizeof (hdr)) ;
+  memcpy (hdr.magic, CFG_MAGIC, sizeof (hdr.magic)) ;
+
+  if ((in = fopen (textName, "r")) == NULL)
+  {
+    fprintf (stderr, "%s: applyconfig: Unable to open %s: %s\n", progName, textName, strerror (errno)) ;
+    exit (1) ;
+  }
+
+  for (lineNo = 1 ; fgets (line, sizeof (line), in) != NULL ; ++lineNo)
+  {
+    if ((p = strchr (line, '#')) != NULL)
+      *p = 0 ;
+
+    if ((tok = strtok (line, " \t\r\n")) == NULL)
+      continue ;
+
+    if (strcasecmp (tok, "extension") == 0)
+    {
+      if (((tok = strtok (NULL, " \t\r\n")) == NULL) || (strlen (tok) >= CFG_EXT_LEN) ||
+	  (hdr.numExtensions >= CFG_MAX_ENTRIES))
+      {
+	fprintf (stderr, "%s: %s:%d: bad extension line\n", progName, textName, lineNo) ;
+	exit (1) ;
+      }
+      strcpy (extensions [hdr.numExtensions++], tok) ;
+      continue ;
+    }
+
+    if ((strcasecmp (tok, "pin") != 0) || ((tok = strtok (NULL, " \t\r\n")) == NULL) ||
+	(hdr.numConfigs >= CFG_MAX_ENTRIES))
+    {
+      fprintf (stderr, "%s: %s:%d: expected 'pin <n> ...' or 'extension <spec>'\n", progName, textName, lineNo) ;
+      exit (1) ;
+    }
+
+    cfg = &cfgs [hdr.numConfigs++] ;
+    cfg->pin   = atoi (tok) ;
+    cfg->mode  = -1 ;
+    cfg->pud   = -1 ;
+    cfg->drive = -1 ;
+
+    while ((tok = strtok (NULL, " \t\r\n")) != NULL)
+    {
+      if      (strcasecmp (tok, "in")    == 0) cfg->mode = INPUT ;
+      else if (strcasecmp (tok, "out")   == 0) cfg->mode = OUTPUT ;
+      else if (strcasecmp (tok, "pwm")   == 0) cfg->mode = PWM_OUTPUT ;
+      else if (strcasecmp (tok, "clock") == 0) cfg->mode = GPIO_CLOCK ;
+      else if (strcasecmp (tok, "up")    == 0) cfg->pud  = PUD_UP ;
+      else if (strcasecmp (tok, "down")  == 0) cfg->pud  = PUD_DOWN ;
+      else if ((strcasecmp (tok, "tri") == 0) || (strcasecmp (tok, "off") == 0))
+	cfg->pud = PUD_OFF ;
+      else if (strcasecmp (tok, "drive") == 0)
+      {
+	if ((tok = strtok (NULL, " \t\r\n")) == NULL)
+	  break ;
+	cfg->drive = atoi (tok) ;
+      }
+      else if ((strcasecmp (tok, "high") == 0) || (strcasecmp (tok, "low") == 0))
+      {
+	if (hdr.numLevels >= CFG_MAX_ENTRIES)
+	  break ;
+	levels [hdr.numLevels].pin     = cfg->pin ;
+	levels [hdr.numLevels++].value = (strcasecmp (tok, "high") == 0) ? HIGH : LOW ;
+      }
+      else
+      {
+	fprintf (stderr, "%s: %s:%d: unknown token: %s\n", progName, textName, lineNo, tok) ;
+	exit (1) ;
+      }
+    }
+  }
+  fclose (in) ;
+
+  if ((out = fopen (profileName, "wb")) == NULL)
+  {
+    fprintf (stderr, "%s: applyconfig: Unable to write %s: %s\n", progName, profileName, strerror (errno)) ;
+    exit (1) ;
+  }
+  fwrite (&hdr, sizeof (hdr), 1, out) ;
+  fwrite (extensions, CFG_EXT_LEN, hdr.numExtensions, out) ;
+  fwrite (cfgs, sizeof (struct WPIPinConfig), hdr.numConfigs, out) ;
+  fwrite (levels, sizeof (struct cfgLevel), hdr.numLevels, out) ;
+  fclose (out) ;
+
+  printf ("%u extensions, %u pins, %u levels -> %s\n",
+	hdr.numExtensions, hdr.numConfigs, hdr.numLevels, profileName) ;
+}
+
+static void doApplyConfig (const char *progName, const char *profileName)
+{
+  const struct cfgFileHeader *hdr ;
+  const struct WPIPinConfig *cfgs ;
+  const struct cfgLevel *levels ;
+  const char (*extensions)[CFG_EXT_LEN] ;
+  unsigned long long mask, values ;
+  struct stat sb ;
+  size_t need ;
+  void *map ;
+  char spec [CFG_EXT_LEN] ;
+  unsigned int i ;
+  int fd ;
+
+  if ((fd = open (profileName, O_RDONLY)) < 0)
+  {
+    fprintf (stderr, "%s: applyconfig: Unable to open %s: %s\n", progName, profileName, strerror (errno)) ;
+    exit (1) ;
+  }
+  fstat (fd, &sb) ;
+  map = mmap (NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+  close (fd) ;
+  hdr = (const struct cfgFileHeader *)map ;
+
+  need = sizeof (*hdr) ;
+  if ((map != MAP_FAILED) && ((size_t)sb.st_size >= need) &&
+	(memcmp (hdr->magic, CFG_MAGIC, sizeof (hdr->magic)) == 0))
+    need += (size_t)hdr->numExtensions * CFG_EXT_LEN +
+	    (size_t)hdr->numConfigs * sizeof (struct WPIPinConfig) +
+	    (size_t)hdr->numLevels * sizeof (struct cfgLevel) ;
+
+  if ((map == MAP_FAILED) || ((size_t)sb.st_size < need))
+  {
+    fprintf (stderr, "%s: applyconfig: %s is not a complete profile\n", progName, profileName) ;
+    exit (1) ;
+  }
+
+  extensions = (const char (*)[CFG_EXT_LEN])(hdr + 1) ;
+  cfgs       = (const struct WPIPinConfig *)(extensions + hdr->numExtensions) ;
+  levels     = (const struct cfgLevel *)(cfgs + hdr->numConfigs) ;
+
+// Extensions first (levels and configs may target their pins), then the
+//	output latches, then modes/pulls/drives in one bulk pass - a pin
+//	drives its configured level from the first moment it's an output
+
+  for (i = 0 ; i < hdr->numExtensions ; ++i)
+  {
+    memcpy (spec, extensions [i], CFG_EXT_LEN) ;	// loadWPiExtension scribbles on it
+    spec [CFG_EXT_LEN - 1] = 0 ;
+    if (!loadWPiExtension ((char *)progName, spec, TRUE))
+    {
+      fprintf (stderr, "%s: applyconfig: extension load failed: %s\n", progName, extensions [i]) ;
+      exit (1) ;
+    }
+  }
+
+  mask = values = 0 ;
+  for (i = 0 ; i < hdr->numLevels ; ++i)
+  {
+    if ((levels [i].pin & PI_GPIO_MASK) == 0)	// On-board: gather into one mask write
+    {
+      mask |= 1ULL << levels [i].pin ;
+      if (levels [i].value != LOW)
+	values |= 1ULL << levels [i].pin ;
+    }
+    else
+      digitalWrite (levels [i].pin, levels [i].value) ;
+  }
+  if (mask != 0)
+    digitalWriteMulti (mask, values) ;
+
+  if ((hdr->numConfigs > 0) && (wiringPiConfigPins (cfgs, (int)hdr->numConfigs) < 0))
+  {
+    fprintf (stderr, "%s: applyconfig: bulk pin configuration failed\n", progName) ;
+    exit (1) ;
   }
 
-  doWfiInternal(argv[1], pin, mode, interations, timeoutSec, -1);
+  munmap (map, sb.st_size) ;
 }
 
-
-void doWfi2(int argc, char *argv [])
+static void doWave (int argc, char *argv [])
 {
-  int pin, mode, interations=1, debounce=50000;
-  int timeoutSec = 2147483647;
+  int pins [64] ;
+  int numPins, seconds, arg, loop ;
 
-  if (argc != 4 && argc != 5 && argc != 6 && argc != 7) {
-    fprintf (stderr, "Usage: %s wfis pin mode [debounce period microsec.] [interations] [timeout sec.]\n", argv [0]);
-    exit(-2);
+  if (argc < 4)
+  {
+    fprintf (stderr, "Usage: %s wave info <file>\n", argv [0]) ;
+    fprintf (stderr, "       %s wave play <file> [loop]\n", argv [0]) ;
+    fprintf (stderr, "       %s wave record <file> [-t seconds] pin [pin...]\n", argv [0]) ;
+    exit (1) ;
   }
 
-  pin  = atoi (argv[2]) ;
-  mode = get_wfi_edge(argv[1], argv[3], -1);
-  if (argc>=5) {
-    debounce = atoi(argv[4]);
-  }
-  if (argc>=6) {
-    interations = atoi(argv[5]);
+  if (strcasecmp (argv [2], "info") == 0)
+    doWaveInfo (argv [0], argv [3]) ;
+  else if (strcasecmp (argv [2], "play") == 0)
+  {
+    loop = (argc > 4) && (strcasecmp (argv [4], "loop") == 0) ;
+    doWavePlay (argv [0], argv [3], loop) ;
   }
-  if (argc>=7) {
-    timeoutSec = atoi(argv[6]);
+  else if (strcasecmp (argv [2], "record") == 0)
+  {
+    seconds = 0 ;
+    arg     = 4 ;
+    if ((arg + 1 < argc) && (strcasecmp (argv [arg], "-t") == 0))
+    {
+      seconds = atoi (argv [arg + 1]) ;
+      arg += 2 ;
+    }
+    numPins = 0 ;
+    for (; arg < argc && numPins < 64 ; ++arg)
+      pins [numPins++] = atoi (argv [arg]) ;
+    if (numPins == 0)
+    {
+      fprintf (stderr, "Usage: %s wave record <file> [-t seconds] pin [pin...]\n", argv [0]) ;
+      exit (1) ;
+    }
+    doWaveRecord (argv [0], argv [3], seconds, pins, numPins) ;
   }
-  if (timeoutSec<0 || interations<0 || debounce<0) {
-    fprintf (stderr, " invalid parameter\n");
-    exit(-2);
+  else
+  {
+    fprintf (stderr, "%s: wave: unknown subcommand: %s\n", argv [0], argv [2]) ;
+    exit (1) ;
   }
-
-  doWfiInternal(argv[1], pin, mode, interations, timeoutSec, debounce);
-  exit(-1); // timeout
 }
 
 
@@ -745,7 +1694,7 @@ void doToggle (int argc, char *argv [])
 
   pin = atoi (argv [2]) ;
 
-  digitalWrite (pin, !digitalRead (pin)) ;
+  digitalToggle (pin) ;
 }
 
 
@@ -979,6 +1928,334 @@ static void doIs40Pin ()
   exit(piBoard40Pin() ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
+/*
+ * doStats:
+ *	gpio stats [file]
+ *	Print the per-bus I2C/SPI transaction counters. With a file argument
+ *	(or WIRINGPI_STATS_FILE set) the counters come from the shared page
+ *	an instrumented program is writing to, so you can watch another
+ *	process's bus traffic.
+ *********************************************************************************
+ */
+
+static void doStats (int argc, char *argv [])
+{
+  struct WPIBusStatsPage *page ;
+  int slot, printed ;
+
+  if (argc == 3)
+    setenv (WPI_BUS_STATS_ENV, argv [2], 1) ;
+  else if (argc != 2)
+  {
+    fprintf (stderr, "Usage: %s stats [file]\n", argv [0]) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  if ((page = wiringPiBusStatsOpen (FALSE)) == NULL)
+  {
+    fprintf (stderr, "%s: No stats page. Run the program under test with %s set\n"
+		     "  to a file, then point gpio stats at the same file.\n", argv [0], WPI_BUS_STATS_ENV) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  printed = 0 ;
+  printf ("%-12s %12s %12s %8s %12s\n", "bus", "transactions", "bytes", "errors", "busTime_us") ;
+  for (slot = 0 ; slot < WPI_BUS_STATS_SLOTS ; ++slot)
+  {
+    struct WPIBusStatsSlot *s = &page->slots [slot] ;
+
+    if (s->kind == 0)
+      continue ;
+
+    if (s->kind == WPI_BUS_STATS_I2C)
+      printf ("i2c fd %-5d", s->id) ;
+    else if (s->kind == WPI_BUS_STATS_SPI)
+      printf ("spi %d.%-7d", s->id / 4, s->id % 4) ;
+    else
+      printf ("?%c %-9d", s->kind, s->id) ;
+
+    printf (" %12llu %12llu %8llu %12llu\n",
+	s->stats.transactions, s->stats.bytes, s->stats.errors, s->stats.busTime_us) ;
+    ++printed ;
+  }
+
+  if (printed == 0)
+    printf ("(no bus traffic counted yet)\n") ;
+}
+
+/*
+ * doCommand:
+ *	Dispatch one already-tokenised command - from the command line or
+ *	a batch stream. Errors exit, so a batch aborts at its first bad
+ *	command rather than blundering on.
+ *********************************************************************************
+ */
+
+static void doCommand (int argc, char *argv [])
+{
+
+// Core wiringPi functions
+
+  if      (strcasecmp (argv [1], "mode"   ) == 0) doMode      (argc, argv) ;
+  else if (strcasecmp (argv [1], "read"   ) == 0) doRead      (argc, argv) ;
+  else if (strcasecmp (argv [1], "write"  ) == 0) doWrite     (argc, argv) ;
+  else if (strcasecmp (argv [1], "pwm"    ) == 0) doPwm       (argc, argv) ;
+  else if (strcasecmp (argv [1], "awrite" ) == 0) doAwrite    (argc, argv) ;
+  else if (strcasecmp (argv [1], "aread"  ) == 0) doAread     (argc, argv) ;
+
+// GPIO Nicies
+
+  else if (strcasecmp (argv [1], "toggle" ) == 0) doToggle    (argc, argv) ;
+  else if (strcasecmp (argv [1], "blink"  ) == 0) doBlink     (argc, argv) ;
+
+// Pi Specifics
+
+  else if (strcasecmp (argv [1], "pwm-bal"  ) == 0) doPwmMode    (PWM_MODE_BAL) ;
+  else if (strcasecmp (argv [1], "pwm-ms"   ) == 0) doPwmMode    (PWM_MODE_MS) ;
+  else if (strcasecmp (argv [1], "pwmr"     ) == 0) doPwmRange   (argc, argv) ;
+  else if (strcasecmp (argv [1], "pwmc"     ) == 0) doPwmClock   (argc, argv) ;
+  else if (strcasecmp (argv [1], "pwmTone"  ) == 0) doPwmTone    (argc, argv) ;
+  else if (strcasecmp (argv [1], "drive"    ) == 0) doPadDrive   (argc, argv) ;
+  else if (strcasecmp (argv [1], "drivepin" ) == 0) doPadDrivePin(argc, argv) ;
+  else if (strcasecmp (argv [1], "readall"  ) == 0) doReadall    () ;
+  else if (strcasecmp (argv [1], "nreadall" ) == 0) doReadall    () ;
+  else if (strcasecmp (argv [1], "pins"     ) == 0) doReadall    () ;
+  else if (strcasecmp (argv [1], "qmode"    ) == 0) doQmode      (argc, argv) ;
+  else if (strcasecmp (argv [1], "i2cdetect") == 0) doI2Cdetect  (argv [0]) ;
+  else if (strcasecmp (argv [1], "i2cd"     ) == 0) doI2Cdetect  (argv [0]) ;
+  else if (strcasecmp (argv [1], "i2cscan"  ) == 0) doI2Cscan    (argc, argv) ;
+  else if (strcasecmp (argv [1], "i2c"      ) == 0) doBusI2C     (argc, argv) ;
+  else if (strcasecmp (argv [1], "spi"      ) == 0) doBusSPI     (argc, argv) ;
+  else if (strcasecmp (argv [1], "reset"    ) == 0) doReset      (argv [0]) ;
+  else if (strcasecmp (argv [1], "wb"       ) == 0) doWriteByte  (argc, argv) ;
+  else if (strcasecmp (argv [1], "rbx"      ) == 0) doReadByte   (argc, argv, TRUE) ;
+  else if (strcasecmp (argv [1], "rbd"      ) == 0) doReadByte   (argc, argv, FALSE) ;
+  else if (strcasecmp (argv [1], "clock"    ) == 0) doClock      (argc, argv) ;
+  else if (strcasecmp (argv [1], "wfis"     ) == 0) doWfi2       (argc, argv) ;
+  else if (strcasecmp (argv [1], "wfi"      ) == 0) doWfi        (argc, argv) ;
+  else if (strcasecmp (argv [1], "monitor"  ) == 0) doMonitor    (argc, argv) ;
+  else if (strcasecmp (argv [1], "is40pin"  ) == 0) doIs40Pin    () ;
+  else if (strcasecmp (argv [1], "stats"    ) == 0) doStats      (argc, argv) ;
+  else
+  {
+    fprintf (stderr, "%s: Unknown command: %s.\n", argv [0], argv [1]) ;
+    exit (EXIT_FAILURE) ;
+  }
+}
+
+
+/*
+ * doLine: doBatch:
+ *	Execute commands from a line or a whole stream against the one
+ *	context we've already set up - provisioning scripts driving many
+ *	pins pay for one wiringPiSetup instead of one per invocation.
+ *********************************************************************************
+ */
+
+#define	BATCH_MAX_ARGS	16
+
+static void doLine (const char *progName, char *line)
+{
+  char *myArgv [BATCH_MAX_ARGS + 1] ;
+  char *token, *hash ;
+  int myArgc ;
+
+  if ((hash = strchr (line, '#')) != NULL)	// Comment runs to end of line
+    *hash = 0 ;
+
+  myArgv [0] = (char *)progName ;
+  myArgc     = 1 ;
+  for (token = strtok (line, " \t\r\n") ; (token != NULL) && (myArgc <= BATCH_MAX_ARGS) ; token = strtok (NULL, " \t\r\n"))
+    myArgv [myArgc++] = token ;
+
+  if (myArgc == 1)	// Blank line
+    return ;
+
+  doCommand (myArgc, myArgv) ;
+}
+
+static void doBatch (const char *progName, FILE *in)
+{
+  char line [256] ;
+
+  while (fgets (line, sizeof (line), in) != NULL)
+    doLine (progName, line) ;
+}
+
+
+/*
+ * doDaemon: gpiodTryDelegate:
+ *	Daemon mode: keep the mmap'd registers open and service one-line
+ *	commands over a SOCK_SEQPACKET Unix socket - each command costs a
+ *	socket round trip instead of a full setup. Each command runs in a
+ *	fork of the daemon (the mappings are inherited; an exit()ing
+ *	command can't take the daemon down) with its output sent back on
+ *	the socket. Commands execute in whatever numbering mode the
+ *	daemon was started with.
+ *	A gpio invocation delegates transparently when the daemon is up,
+ *	but only the bare commands doCommand knows - anything starting
+ *	with an option flag (-g, -x, ...) or needing main's own handling
+ *	(batch, daemon) runs locally as before. The daemon sends the
+ *	command's exit status back in a trailing packet (a leading NUL
+ *	byte, which command output never starts with) and the delegating
+ *	side returns it, so scripts still see failures. Set
+ *	WIRINGPI_NO_DAEMON to force local execution.
+ *********************************************************************************
+ */
+
+#define	GPIOD_SOCKET	"/var/run/wiringpi-gpiod.sock"
+
+static const char *gpiodCommands [] =
+{
+  "mode", "read", "write", "pwm", "awrite", "aread",
+  "toggle", "blink",
+  "pwm-bal", "pwm-ms", "pwmr", "pwmc", "pwmTone",
+  "drive", "drivepin", "readall", "nreadall", "pins",
+  "qmode", "i2cdetect", "i2cd", "i2cscan", "i2c", "spi",
+  "reset", "wb", "rbx", "rbd", "clock", "wfis", "wfi",
+  "monitor", "is40pin", "stats",
+  NULL
+} ;
+
+static int gpiodTryDelegate (int argc, char *argv [])	// -1: not delegated, else exit status
+{
+  struct sockaddr_un addr ;
+  char line [512] ;
+  int fd, i, status ;
+  ssize_t n ;
+
+  if (getenv ("WIRINGPI_NO_DAEMON") != NULL)
+    return -1 ;
+
+  if (argv [1][0] == '-')	// Option flags are main's business, not doCommand's
+    return -1 ;
+
+  for (i = 0 ; gpiodCommands [i] != NULL ; ++i)
+    if (strcasecmp (argv [1], gpiodCommands [i]) == 0)
+      break ;
+  if (gpiodCommands [i] == NULL)
+    return -1 ;
+
+  if ((fd = socket (AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+    return -1 ;
+
+  memset (&addr, 0, sizeof (addr)) ;
+  addr.sun_family = AF_UNIX ;
+  strncpy (addr.sun_path, GPIOD_SOCKET, sizeof (addr.sun_path) - 1) ;
+  if (connect (fd, (struct sockaddr *)&addr, sizeof (addr)) != 0)
+  {
+    close (fd) ;
+    return -1 ;
+  }
+
+  line [0] = 0 ;
+  for (i = 1 ; i < argc ; ++i)
+  {
+    strncat (line, argv [i], sizeof (line) - strlen (line) - 2) ;
+    if (i < argc - 1)
+      strncat (line, " ", sizeof (line) - strlen (line) - 1) ;
+  }
+
+  if (send (fd, line, strlen (line), 0) < 0)
+  {
+    close (fd) ;
+    return -1 ;
+  }
+
+  status = EXIT_FAILURE ;	// No status packet counts as a failure
+  while ((n = recv (fd, line, sizeof (line), 0)) > 0)
+  {
+    if ((n == 2) && (line [0] == 0))	// Trailing status packet
+      status = (unsigned char)line [1] ;
+    else
+      fwrite (line, 1, n, stdout) ;
+  }
+
+  close (fd) ;
+  return status ;
+}
+
+static void doDaemon (const char *progName)
+{
+  struct sockaddr_un addr ;
+  char line [512] ;
+  int sock, client ;
+  ssize_t n ;
+
+  unlink (GPIOD_SOCKET) ;
+
+  if ((sock = socket (AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+  {
+    fprintf (stderr, "%s: Unable to create daemon socket: %s\n", progName, strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  memset (&addr, 0, sizeof (addr)) ;
+  addr.sun_family = AF_UNIX ;
+  strncpy (addr.sun_path, GPIOD_SOCKET, sizeof (addr.sun_path) - 1) ;
+
+  if (bind (sock, (struct sockaddr *)&addr, sizeof (addr)) != 0)
+  {
+    fprintf (stderr, "%s: Unable to bind %s: %s\n", progName, GPIOD_SOCKET, strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  if (listen (sock, 8) != 0)
+  {
+    fprintf (stderr, "%s: Unable to listen on %s: %s\n", progName, GPIOD_SOCKET, strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  signal (SIGCHLD, SIG_IGN) ;	// No zombies from the command children
+
+  for (;;)
+  {
+    if ((client = accept (sock, NULL, NULL)) < 0)
+    {
+      if (errno == EINTR)
+	continue ;
+      break ;
+    }
+
+    if ((n = recv (client, line, sizeof (line) - 1, 0)) > 0)
+    {
+      line [n] = 0 ;
+
+      if (fork () == 0)	// Child: run the command against the inherited mappings
+      {
+	pid_t cmdPid ;
+	int wstatus ;
+	char reply [2] ;
+
+	close (sock) ;
+	signal (SIGCHLD, SIG_DFL) ;	// So we can reap the command below
+
+	if ((cmdPid = fork ()) == 0)	// Grandchild: the command itself
+	{
+	  dup2 (client, STDOUT_FILENO) ;
+	  dup2 (client, STDERR_FILENO) ;
+	  close (client) ;
+	  doLine (progName, line) ;
+	  exit (EXIT_SUCCESS) ;
+	}
+
+	reply [0] = 0 ;			// Trailing status packet for the client
+	reply [1] = EXIT_FAILURE ;
+	if ((cmdPid > 0) && (waitpid (cmdPid, &wstatus, 0) == cmdPid) && WIFEXITED (wstatus))
+	  reply [1] = (char)WEXITSTATUS (wstatus) ;
+	send (client, reply, sizeof (reply), 0) ;
+	exit (EXIT_SUCCESS) ;
+      }
+    }
+
+    close (client) ;
+  }
+
+  close (sock) ;
+  unlink (GPIOD_SOCKET) ;
+}
+
+
 /*
  * main:
  *	Start here
@@ -1055,6 +2332,14 @@ int main (int argc, char *argv [])
     exit (EXIT_SUCCESS) ;
   }
 
+// If the daemon is up, hand the command over - one IPC round trip
+//	instead of a full setup (and no root needed here). Only bare
+//	doCommand commands delegate; the remote exit status comes back
+//	so scripts still see failures.
+
+  if ((i = gpiodTryDelegate (argc, argv)) >= 0)
+    return i ;
+
   if (geteuid () != 0)
   {
     fprintf (stderr, "%s: Must be root to run. Program should be suid root. This is an error.\n", argv [0]) ;
@@ -1078,11 +2363,53 @@ int main (int argc, char *argv [])
 
   if (strcasecmp (argv [1], "usbp"   ) == 0)	{ doUsbP   (argc, argv) ; return 0 ; }
 
+// Bus statistics viewer - reads a shared page, no GPIO setup needed
+
+  if (strcasecmp (argv [1], "stats"  ) == 0)	{ doStats  (argc, argv) ; return 0 ; }
+
 // Gertboard commands
 
   if (strcasecmp (argv [1], "gbr" ) == 0)	{ doGbr (argc, argv) ; return 0 ; }
   if (strcasecmp (argv [1], "gbw" ) == 0)	{ doGbw (argc, argv) ; return 0 ; }
 
+// Compile a pin-configuration profile - pure file work, no GPIO setup
+
+  if (strcasecmp (argv [1], "compileconfig") == 0)
+  {
+    if (argc != 4)
+    {
+      fprintf (stderr, "Usage: %s compileconfig <text> <profile>\n", argv [0]) ;
+      exit (EXIT_FAILURE) ;
+    }
+    doCompileConfig (argv [0], argv [2], argv [3]) ;
+    return 0 ;
+  }
+
+// Apply one - profiles store BCM pins, so force Gpio mode
+
+  if (strcasecmp (argv [1], "applyconfig") == 0)
+  {
+    if (argc != 3)
+    {
+      fprintf (stderr, "Usage: %s applyconfig <profile>\n", argv [0]) ;
+      exit (EXIT_FAILURE) ;
+    }
+    wiringPiSetupGpio () ;
+    doApplyConfig (argv [0], argv [2]) ;
+    return 0 ;
+  }
+
+// Waveform files use BCM masks throughout, so force Gpio mode
+//	("wave info" never touches the hardware at all)
+
+  if (strcasecmp (argv [1], "wave") == 0)
+  {
+    if ((argc < 3) || (strcasecmp (argv [2], "info") != 0))
+      wiringPiSetupGpio () ;
+    doWave (argc, argv) ;
+    return 0 ;
+  }
+
 // Check for allreadall command, force Gpio mode
 
   if (strcasecmp (argv [1], "allreadall") == 0)
@@ -1178,48 +2505,37 @@ int main (int argc, char *argv [])
     exit (EXIT_FAILURE) ;
   }
 
-// Core wiringPi functions
+// Daemon mode - keep this setup alive and serve commands over a socket
 
-  if      (strcasecmp (argv [1], "mode"   ) == 0) doMode      (argc, argv) ;
-  else if (strcasecmp (argv [1], "read"   ) == 0) doRead      (argc, argv) ;
-  else if (strcasecmp (argv [1], "write"  ) == 0) doWrite     (argc, argv) ;
-  else if (strcasecmp (argv [1], "pwm"    ) == 0) doPwm       (argc, argv) ;
-  else if (strcasecmp (argv [1], "awrite" ) == 0) doAwrite    (argc, argv) ;
-  else if (strcasecmp (argv [1], "aread"  ) == 0) doAread     (argc, argv) ;
+  if (strcasecmp (argv [1], "daemon") == 0)
+  {
+    doDaemon (argv [0]) ;
+    return 0 ;
+  }
 
-// GPIO Nicies
+// Batch mode - many commands against the one setup we've just done
 
-  else if (strcasecmp (argv [1], "toggle" ) == 0) doToggle    (argc, argv) ;
-  else if (strcasecmp (argv [1], "blink"  ) == 0) doBlink     (argc, argv) ;
+  if ((strcasecmp (argv [1], "batch") == 0) || (strcmp (argv [1], "-") == 0))
+  {
+    FILE *in = stdin ;
 
-// Pi Specifics
+    if ((strcasecmp (argv [1], "batch") == 0) && (argc > 2))
+    {
+      if ((in = fopen (argv [2], "r")) == NULL)
+      {
+	fprintf (stderr, "%s: Unable to open %s: %s\n", argv [0], argv [2], strerror (errno)) ;
+	exit (EXIT_FAILURE) ;
+      }
+    }
 
-  else if (strcasecmp (argv [1], "pwm-bal"  ) == 0) doPwmMode    (PWM_MODE_BAL) ;
-  else if (strcasecmp (argv [1], "pwm-ms"   ) == 0) doPwmMode    (PWM_MODE_MS) ;
-  else if (strcasecmp (argv [1], "pwmr"     ) == 0) doPwmRange   (argc, argv) ;
-  else if (strcasecmp (argv [1], "pwmc"     ) == 0) doPwmClock   (argc, argv) ;
-  else if (strcasecmp (argv [1], "pwmTone"  ) == 0) doPwmTone    (argc, argv) ;
-  else if (strcasecmp (argv [1], "drive"    ) == 0) doPadDrive   (argc, argv) ;
-  else if (strcasecmp (argv [1], "drivepin" ) == 0) doPadDrivePin(argc, argv) ;
-  else if (strcasecmp (argv [1], "readall"  ) == 0) doReadall    () ;
-  else if (strcasecmp (argv [1], "nreadall" ) == 0) doReadall    () ;
-  else if (strcasecmp (argv [1], "pins"     ) == 0) doReadall    () ;
-  else if (strcasecmp (argv [1], "qmode"    ) == 0) doQmode      (argc, argv) ;
-  else if (strcasecmp (argv [1], "i2cdetect") == 0) doI2Cdetect  (argv [0]) ;
-  else if (strcasecmp (argv [1], "i2cd"     ) == 0) doI2Cdetect  (argv [0]) ;
-  else if (strcasecmp (argv [1], "reset"    ) == 0) doReset      (argv [0]) ;
-  else if (strcasecmp (argv [1], "wb"       ) == 0) doWriteByte  (argc, argv) ;
-  else if (strcasecmp (argv [1], "rbx"      ) == 0) doReadByte   (argc, argv, TRUE) ;
-  else if (strcasecmp (argv [1], "rbd"      ) == 0) doReadByte   (argc, argv, FALSE) ;
-  else if (strcasecmp (argv [1], "clock"    ) == 0) doClock      (argc, argv) ;
-  else if (strcasecmp (argv [1], "wfis"     ) == 0) doWfi2       (argc, argv) ;
-  else if (strcasecmp (argv [1], "wfi"      ) == 0) doWfi        (argc, argv) ;
-  else if (strcasecmp (argv [1], "is40pin"  ) == 0) doIs40Pin    () ;
-  else
-  {
-    fprintf (stderr, "%s: Unknown command: %s.\n", argv [0], argv [1]) ;
-    exit (EXIT_FAILURE) ;
+    doBatch (argv [0], in) ;
+
+    if (in != stdin)
+      fclose (in) ;
+    return 0 ;
   }
 
+  doCommand (argc, argv) ;
+
   return 0 ;
 }
@@ -93,6 +93,36 @@ static const char* GetAltString(int alt) {
 }
 
 
+// Level snapshot:
+//	One digitalReadMulti() bank load per table instead of a mode
+//	dispatch and register (or ioctl) round trip per pin - so the
+//	whole table shows one instant and reading it doesn't perturb a
+//	live system.
+
+static uint64_t readallLevels ;
+static int      readallHaveLevels = FALSE ;
+
+static void readallSnapshot (void)
+{
+  unsigned long long levels = 0 ;
+
+  readallHaveLevels = FALSE ;
+  if ((wpMode == WPI_MODE_PINS) || (wpMode == WPI_MODE_PHYS) || (wpMode == WPI_MODE_GPIO))
+    readallHaveLevels = (digitalReadMulti (0xFFFFFFFFFFFFFFFFULL, &levels) == 0) ;
+  readallLevels = levels ;
+}
+
+static int readallLevel (int physPin, int modePin)
+{
+  int bcm = physPinToGpio (physPin) ;
+
+  if (readallHaveLevels && (bcm >= 0) && (bcm < 64))
+    return (int)((readallLevels >> bcm) & 1ULL) ;
+
+  return digitalRead (modePin) ;
+}
+
+
 static int physToWpi [64] =
 {
   -1,           // 0
@@ -191,7 +221,7 @@ static void readallPhys (int physPin)
       pin = physToWpi [physPin] ;
 
     printf (" | %4s", GetAltString(getAlt (pin))) ;
-    printf (" | %d", digitalRead (pin)) ;
+    printf (" | %d", readallLevel (physPin, pin)) ;
   }
 
 // Pin numbers:
@@ -213,7 +243,7 @@ static void readallPhys (int physPin)
     else
       pin = physToWpi [physPin] ;
 
-    printf (" | %d", digitalRead (pin)) ;
+    printf (" | %d", readallLevel (physPin, pin)) ;
     printf (" | %-4s", GetAltString(getAlt (pin))) ;
   }
 
@@ -235,10 +265,20 @@ static void readallPhys (int physPin)
  *********************************************************************************
  */
 
+static int allReadallLevel (int pin)
+{
+  if (readallHaveLevels && (wpMode == WPI_MODE_GPIO))	// Pins here are BCM numbers
+    return (int)((readallLevels >> pin) & 1ULL) ;
+
+  return digitalRead (pin) ;
+}
+
 static void allReadall (void)
 {
   int pin ;
 
+  readallSnapshot () ;
+
   printf ("+-----+------+-------+      +-----+------+-------+\n") ;
   printf ("| Pin | Mode | Value |      | Pin | Mode | Value |\n") ;
   printf ("+-----+------+-------+      +-----+------+-------+\n") ;
@@ -247,11 +287,11 @@ static void allReadall (void)
   {
     printf ("| %3d ", pin) ;
     printf ("| %-4s ", GetAltString(getAlt (pin))) ;
-    printf ("| %s  ", digitalRead (pin) == HIGH ? "High" : "Low ") ;
+    printf ("| %s  ", allReadallLevel (pin) == HIGH ? "High" : "Low ") ;
     printf ("|      ") ;
     printf ("| %3d ", pin + 27) ;
     printf ("| %-4s ", GetAltString(getAlt (pin + 27))) ;
-    printf ("| %s  ", digitalRead (pin + 27) == HIGH ? "High" : "Low ") ;
+    printf ("| %s  ", allReadallLevel (pin + 27) == HIGH ? "High" : "Low ") ;
     printf ("|\n") ;
   }
 
@@ -279,6 +319,8 @@ void abReadall (int model, int rev)
     else
       type = "B1" ;
 
+  readallSnapshot () ;
+
   printf (" +-----+-----+---------+------+---+-Model %s-+---+------+---------+-----+-----+\n", type) ;
   printf (" | BCM | wPi |   Name  | Mode | V | Physical | V | Mode | Name    | wPi | BCM |\n") ;
   printf (" +-----+-----+---------+------+---+----++----+---+------+---------+-----+-----+\n") ;
@@ -348,6 +390,8 @@ static void piPlusReadall (int model)
 {
   int pin ;
 
+  readallSnapshot () ;
+
   plus2header (model) ;
 
   printf (" | BCM | wPi |   Name  | Mode | V | Physical | V | Mode | Name    | wPi | BCM |\n") ;
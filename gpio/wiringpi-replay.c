@@ -0,0 +1,190 @@
+/*
+ * wiringpi-replay.c:
+ *	Drive the waveform engine from a log captured by wiringpi-record,
+ *	reproducing the recorded edge timing on the same (or remapped)
+ *	pins - capture a field failure once, iterate on the bench. See
+ *	wiringpi-record.c for the log format; events are sorted by
+ *	timestamp on load, so logs with interleaved multi-pin batches
+ *	replay correctly.
+ *
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public License
+ *    along with wiringPi.  If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+#include <wiringPi.h>
+#include <wiringPiWave.h>
+
+#define	REC_MAGIC	"WPIREC1"
+
+struct recHeader
+{
+  char magic [8] ;
+  unsigned long long baseNs ;
+  unsigned long long pinMask ;
+} ;
+
+static volatile int stopNow = 0 ;
+
+static void sigHandler (int sig)
+{
+  (void)sig ;
+  stopNow = 1 ;
+}
+
+static int wordCompare (const void *a, const void *b)
+{
+  unsigned long long ta = *(const unsigned long long *)a >> 8 ;
+  unsigned long long tb = *(const unsigned long long *)b >> 8 ;
+
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0 ;
+}
+
+static void usage (void)
+{
+  fprintf (stderr, "Usage: wiringpi-replay [-l] file\n") ;
+  fprintf (stderr, "  -l: loop the waveform until interrupted (default: one pass)\n") ;
+  exit (EXIT_FAILURE) ;
+}
+
+int main (int argc, char *argv [])
+{
+  struct recHeader header ;
+  struct wpiWavePulse *pulses ;
+  unsigned long long *words ;
+  unsigned long long deltaNs, nextNs = 0, bit ;
+  FILE *in ;
+  long fileSize ;
+  int loop = FALSE ;
+  int opt, i, pin, numEvents, numPulses, wave ;
+
+  while ((opt = getopt (argc, argv, "lh")) != -1)
+    switch (opt)
+    {
+      case 'l': loop = TRUE ; break ;
+      default:  usage () ;
+    }
+
+  if (optind != argc - 1)
+    usage () ;
+
+  if ((in = fopen (argv [optind], "rb")) == NULL)
+  {
+    fprintf (stderr, "wiringpi-replay: cannot read %s: %s\n", argv [optind], strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
+  }
+  fseek (in, 0, SEEK_END) ;
+  fileSize = ftell (in) ;
+  fseek (in, 0, SEEK_SET) ;
+
+  if (fread (&header, sizeof (header), 1, in) != 1 ||
+	memcmp (header.magic, REC_MAGIC, sizeof (header.magic)) != 0)
+  {
+    fprintf (stderr, "wiringpi-replay: %s is not a wiringpi-record log\n", argv [optind]) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  numEvents = (int)((fileSize - (long)sizeof (header)) / 8) ;
+  if (numEvents <= 0)
+  {
+    fprintf (stderr, "wiringpi-replay: %s holds no events\n", argv [optind]) ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  words = (unsigned long long *)malloc (numEvents * sizeof (unsigned long long)) ;
+  pulses = (struct wpiWavePulse *)malloc (numEvents * sizeof (struct wpiWavePulse)) ;
+  if (words == NULL || pulses == NULL ||
+	fread (words, sizeof (unsigned long long), numEvents, in) != (size_t)numEvents)
+  {
+    fprintf (stderr, "wiringpi-replay: cannot load %s\n", argv [optind]) ;
+    exit (EXIT_FAILURE) ;
+  }
+  fclose (in) ;
+
+  qsort (words, numEvents, sizeof (unsigned long long), wordCompare) ;
+
+// Fold the edges into waveform steps: events on the same microsecond
+//	share a step, each step holds until the next one is due
+
+  numPulses = 0 ;
+  for (i = 0 ; i < numEvents ; ++i)
+  {
+    deltaNs = words [i] >> 8 ;
+    pin     = (int)((words [i] >> 2) & 0x3F) ;
+    bit     = 1ULL << pin ;
+
+    if (numPulses == 0 || (deltaNs / 1000) != (nextNs / 1000))
+    {
+      if (numPulses > 0)
+	pulses [numPulses - 1].usDelay = (unsigned int)((deltaNs - nextNs) / 1000) ;
+      memset (&pulses [numPulses], 0, sizeof (struct wpiWavePulse)) ;
+      ++numPulses ;
+      nextNs = deltaNs ;
+    }
+    if ((words [i] & 3) == 1)
+    {
+      pulses [numPulses - 1].gpioOn  |= bit ;
+      pulses [numPulses - 1].gpioOff &= ~bit ;
+    }
+    else
+    {
+      pulses [numPulses - 1].gpioOff |= bit ;
+      pulses [numPulses - 1].gpioOn  &= ~bit ;
+    }
+  }
+  pulses [numPulses - 1].usDelay = 1 ;
+
+  wiringPiSetupGpio () ;
+  for (pin = 0 ; pin < 64 ; ++pin)
+    if (header.pinMask & (1ULL << pin))
+      pinMode (pin, OUTPUT) ;
+
+  if ((wave = wpiWaveCreate (pulses, numPulses)) < 0)
+  {
+    fprintf (stderr, "wiringpi-replay: cannot create the waveform\n") ;
+    exit (EXIT_FAILURE) ;
+  }
+  free (words) ;
+  free (pulses) ;
+
+  signal (SIGINT,  sigHandler) ;
+  signal (SIGTERM, sigHandler) ;
+
+  printf ("%d events, %d steps%s\n", numEvents, numPulses, loop ? ", looping" : "") ;
+  if (wpiWaveTxStart (wave, loop) < 0)
+  {
+    fprintf (stderr, "wiringpi-replay: cannot start transmission\n") ;
+    exit (EXIT_FAILURE) ;
+  }
+
+  while (!stopNow && wpiWaveTxBusy ())
+    delay (10) ;
+
+  wpiWaveTxStop () ;
+  wpiWaveDelete (wave) ;
+
+  return 0 ;
+}
@@ -129,22 +129,30 @@ static const uint16_t gains [6] =
 
 
 /*
- * analogRead:
- *	Pin is the channel to sample on the device.
- *	Channels 0-3 are single ended inputs,
- *	channels 4-7 are the various differential combinations.
+ * chanRateIdx:
+ *	Per-channel data rate - 3 bits per channel packed into data2, an
+ *	index into dataRates[]. All channels start at the 128 SPS default;
+ *	ads1115SetChannelRate() (or the digitalWrite control register, for
+ *	every channel at once) changes them.
  *********************************************************************************
  */
 
-static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+static int chanRateIdx (struct wiringPiNodeStruct *node, int chan)
 {
-  int chan = pin - node->pinBase ;
-  int16_t  result ;
-  uint16_t config = CONFIG_DEFAULT ;
+  return (node->data2 >> (3 * chan)) & 7 ;
+}
 
-  chan &= 7 ;
 
-// Setup the configuration register
+/*
+ * makeConfig:
+ *	Build the configuration register value for a conversion on the
+ *	given channel with the node's current gain and data rate.
+ *********************************************************************************
+ */
+
+static uint16_t makeConfig (struct wiringPiNodeStruct *node, int chan)
+{
+  uint16_t config = CONFIG_DEFAULT ;
 
 //	Set PGA/voltage range
 
@@ -154,7 +162,7 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 //	Set sample speed
 
   config &= ~CONFIG_DR_MASK ;
-  config |= node->data1 ;
+  config |= dataRates [chanRateIdx (node, chan)] ;
 
 //	Set single-ended channel or differential mode
 
@@ -173,9 +181,29 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
     case 7: config |= CONFIG_MUX_DIFF_1_3 ; break ;
   }
 
-//	Start a single conversion
+  return config ;
+}
+
 
-  config |= CONFIG_OS_SINGLE ;
+/*
+ * analogRead:
+ *	Pin is the channel to sample on the device.
+ *	Channels 0-3 are single ended inputs,
+ *	channels 4-7 are the various differential combinations.
+ *********************************************************************************
+ */
+
+static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+{
+  int chan = pin - node->pinBase ;
+  int16_t  result ;
+  uint16_t config ;
+
+  chan &= 7 ;
+
+// Setup the configuration register and start a single conversion
+
+  config = makeConfig (node, chan) | CONFIG_OS_SINGLE ;
   config = __bswap_16 (config) ;
   wiringPiI2CWriteReg16 (node->fd, 1, config) ;
 
@@ -196,13 +224,69 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 // Sometimes with a 0v input on a single-ended channel the internal 0v reference
 //	can be higher than the input, so you get a negative result...
 
-  if ( (chan < 4) && (result < 0) ) 
+  if ( (chan < 4) && (result < 0) )
     return 0 ;
   else
     return (int)result ;
 }
 
 
+/*
+ * myAnalogReadScan:
+ *	Round-robin scan of the masked channels, pipelined: as soon as a
+ *	conversion completes we program the mux for the next channel -
+ *	which starts it converting - and only then collect the previous
+ *	result (the conversion register holds it until the next one
+ *	lands). The chip converts while we're on the bus, so a
+ *	multi-channel scan costs one conversion period per channel rather
+ *	than a conversion plus the readback overhead.
+ *********************************************************************************
+ */
+
+static int myAnalogReadScan (struct wiringPiNodeStruct *node, unsigned int mask, int *results)
+{
+  int chans [8] ;
+  int nChans, i, chan ;
+  uint16_t status ;
+  int16_t result ;
+
+  nChans = 0 ;
+  for (chan = 0 ; chan < 8 ; ++chan)
+    if (mask & (1 << chan))
+      chans [nChans++] = chan ;
+
+  if (nChans == 0)
+    return 0 ;
+
+// Start the first conversion
+
+  wiringPiI2CWriteReg16 (node->fd, 1, __bswap_16 (makeConfig (node, chans [0]) | CONFIG_OS_SINGLE)) ;
+
+  for (i = 0 ; i < nChans ; ++i)
+  {
+    for (;;)
+    {
+      status = __bswap_16 (wiringPiI2CReadReg16 (node->fd, 1)) ;
+      if ((status & CONFIG_OS_MASK) != 0)
+	break ;
+      delayMicroseconds (100) ;
+    }
+
+// Kick off the next channel before collecting this result
+
+    if (i + 1 < nChans)
+      wiringPiI2CWriteReg16 (node->fd, 1, __bswap_16 (makeConfig (node, chans [i + 1]) | CONFIG_OS_SINGLE)) ;
+
+    result = __bswap_16 (wiringPiI2CReadReg16 (node->fd, 0)) ;
+    if ((chans [i] < 4) && (result < 0))	// See myAnalogRead
+      result = 0 ;
+    results [chans [i]] = result ;
+  }
+
+  return nChans ;
+}
+
+
 /*
  * digitalWrite:
  *	It may seem odd to have a digital write here, but it's the best way
@@ -224,13 +308,19 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int data)
       data = 2 ;
     node->data0 = gains [data] ;
   }
-  else			// Data rate control
+  else			// Data rate control - every channel at once
   {
+    int i ;
+    unsigned int packed = 0 ;
+
     if ( (data < 0) || (data > 7) )	// Use default if out of range
       data = 4 ;
     node->data1 = dataRates [data] ;	// Bugfix 0-1 by "Eric de jong (gm)" <ericdejong@gmx.net> - Thanks.
+    for (i = 0 ; i < 8 ; ++i)
+      packed |= (unsigned int)data << (3 * i) ;
+    node->data2 = packed ;
   }
-  
+
 }
 
 
@@ -265,6 +355,94 @@ static void myAnalogWrite (struct wiringPiNodeStruct *node, int pin, int data)
 
 
 
+/*
+ * ads1115ReadStream:
+ *	Log a run of samples from one channel using the chip's continuous
+ *	conversion mode. The chip is programmed once, then we just collect
+ *	the conversion register at the sample rate - no busy-polling of the
+ *	OS bit between samples, so the full 860 SPS rate is reachable.
+ *	Returns the number of samples stored, or -1 if pin is not an
+ *	ads1115 pin.
+ *********************************************************************************
+ */
+
+int ads1115ReadStream (int pin, int16_t *buffer, int numSamples)
+{
+  struct wiringPiNodeStruct *node ;
+  uint16_t config ;
+  unsigned int periodUs ;
+  int sample, chan ;
+  int16_t result ;
+
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return -1 ;
+
+  chan = (pin - node->pinBase) & 7 ;
+
+// One conversion period at the channel's programmed data rate
+
+  switch (dataRates [chanRateIdx (node, chan)])
+  {
+    case CONFIG_DR_8SPS:   periodUs = 125000 ; break ;
+    case CONFIG_DR_16SPS:  periodUs =  62500 ; break ;
+    case CONFIG_DR_32SPS:  periodUs =  31250 ; break ;
+    case CONFIG_DR_64SPS:  periodUs =  15625 ; break ;
+    case CONFIG_DR_128SPS: periodUs =   7813 ; break ;
+    case CONFIG_DR_475SPS: periodUs =   2106 ; break ;
+    case CONFIG_DR_860SPS: periodUs =   1163 ; break ;
+    default:               periodUs =   7813 ; break ;
+  }
+
+// Program the channel once in continuous mode
+
+  config = makeConfig (node, chan) ;
+  config &= ~(CONFIG_OS_MASK | CONFIG_MODE) ;
+  wiringPiI2CWriteReg16 (node->fd, 1, __bswap_16 (config)) ;
+
+  delayMicroseconds (periodUs) ;		// First conversion
+
+  for (sample = 0 ; sample < numSamples ; ++sample)
+  {
+    result = wiringPiI2CReadReg16 (node->fd, 0) ;
+    buffer [sample] = __bswap_16 (result) ;
+    if (sample < (numSamples - 1))
+      delayMicroseconds (periodUs) ;
+  }
+
+// Back to the power-saving single-shot mode
+
+  wiringPiI2CWriteReg16 (node->fd, 1, __bswap_16 (config | CONFIG_MODE)) ;
+
+  return numSamples ;
+}
+
+
+/*
+ * ads1115SetChannelRate:
+ *	Give one channel its own data rate (an ADS1115_DR_* index) - slow
+ *	rates for quiet precision channels, fast ones for the rest. The
+ *	digitalWrite data-rate control register still sets every channel
+ *	at once. Returns -1 for a bad rate or a pin with no ads1115 node.
+ *********************************************************************************
+ */
+
+int ads1115SetChannelRate (int pin, int rate)
+{
+  struct wiringPiNodeStruct *node ;
+  int chan ;
+
+  if ( (rate < 0) || (rate > 7) )
+    return -1 ;
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return -1 ;
+
+  chan = (pin - node->pinBase) & 7 ;
+  node->data2 = (node->data2 & ~(7u << (3 * chan))) | ((unsigned int)rate << (3 * chan)) ;
+
+  return 0 ;
+}
+
+
 /*
  * ads1115Setup:
  *	Create a new wiringPi device node for an ads1115 on the Pi's
@@ -282,12 +460,14 @@ int ads1115Setup (const int pinBase, int i2cAddr)
 
   node = wiringPiNewNode (pinBase, 8) ;
 
-  node->fd           = fd ;
-  node->data0        = CONFIG_PGA_4_096V ;	// Gain in data0
-  node->data1        = CONFIG_DR_128SPS ;	// Samples/sec in data1
-  node->analogRead   = myAnalogRead ;
-  node->analogWrite  = myAnalogWrite ;
-  node->digitalWrite = myDigitalWrite ;
+  node->fd             = fd ;
+  node->data0          = CONFIG_PGA_4_096V ;	// Gain in data0
+  node->data1          = CONFIG_DR_128SPS ;	// Samples/sec in data1
+  node->data2          = 0x924924 ;		// Per-channel rates: all at index 4 (128 SPS)
+  node->analogRead     = myAnalogRead ;
+  node->analogReadScan = myAnalogReadScan ;
+  node->analogWrite    = myAnalogWrite ;
+  node->digitalWrite   = myDigitalWrite ;
 
   return TRUE ;
 }
@@ -44,11 +44,15 @@
 #define	ADS1115_DR_475		6
 #define	ADS1115_DR_860		7
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern int ads1115Setup (int pinBase, int i2cAddress) ;
+extern int ads1115ReadStream (int pin, int16_t *buffer, int numSamples) ;	// continuous-conversion mode
+extern int ads1115SetChannelRate (int pin, int rate) ;				// ADS1115_DR_* index, per channel
 
 #ifdef __cplusplus
 }
@@ -32,6 +32,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "wiringPi.h"
 #include "wiringPiI2C.h"
@@ -62,6 +64,39 @@ uint32_t cPress, cTemp ;
 
 static int altitude ;
 
+// Non-blocking state machine:
+//	The blocking read stalls the caller twice (5ms after starting each
+//	conversion). In non-blocking mode analogRead instead advances one
+//	state when its conversion is due and returns the cached values, so
+//	a control loop sharing the thread never waits on the weather.
+
+#define	BMP180_IDLE		0
+#define	BMP180_TEMP_WAIT	1
+#define	BMP180_PRESS_WAIT	2
+
+#define	BMP180_CONV_MS		5	// 4.5ms at OSS 0, for both conversions
+
+static int nbEnabled = FALSE ;
+static int nbState   = BMP180_IDLE ;
+static unsigned long long nbStartedAt = 0 ;
+
+static double lastFTemp   = 25.0 ;	// Pressure compensation needs it
+static int    haveReading = FALSE ;
+static int    bmp180Fd    = -1 ;
+
+static pthread_t refresherThread ;
+static volatile int refresherRunning = FALSE ;
+static unsigned int refresherIntervalMs = 0 ;
+
+
+static unsigned long long bmp180Now (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (unsigned long long)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL ;
+}
+
 /*
  * read16:
  *	Quick hack to read the 16-bit data with the correct endian
@@ -76,56 +111,81 @@ uint16_t read16 (int fd, int reg)
 
 
 /*
- * bmp180ReadTempPress:
- *	Does the hard work of reading the sensor
+ * bmp180StartTemp, bmp180StartPress:
+ *	Kick off a conversion - the chip then needs ~4.5ms on its own
  *********************************************************************************
  */
 
-static void bmp180ReadTempPress (int fd)
+static void bmp180StartTemp (int fd)
 {
-  double fTemp, fPress ;
-  double tu, a ;
-  double pu, s, x, y, z ;
+  wiringPiI2CWriteReg8 (fd, 0xF4, 0x2E) ;
+}
 
-  uint8_t data [4] ;
+static void bmp180StartPress (int fd)
+{
+  wiringPiI2CWriteReg8 (fd, 0xF4, 0x34 | (BMP180_OSS << 6)) ;
+}
 
-// Start a temperature sensor reading
 
-  wiringPiI2CWriteReg8 (fd, 0xF4, 0x2E) ;
-  delay (5) ;
+/*
+ * bmp180HarvestTemp:
+ *	Collect a finished temperature conversion and update the cache
+ *********************************************************************************
+ */
+
+static void bmp180HarvestTemp (int fd)
+{
+  double tu, a ;
+  uint8_t data [4] ;
 
-// Read the raw data
+// Read the raw data - one block transaction, the chip auto-increments
 
-  data [0] = wiringPiI2CReadReg8 (fd, 0xF6) ;
-  data [1] = wiringPiI2CReadReg8 (fd, 0xF7) ;
+  if (wiringPiI2CReadBlockData (fd, 0xF6, data, 2) != 2)
+  {
+    data [0] = wiringPiI2CReadReg8 (fd, 0xF6) ;
+    data [1] = wiringPiI2CReadReg8 (fd, 0xF7) ;
+  }
 
 // And calculate...
 
   tu = (data [0] * 256.0) + data [1] ;
 
   a = c5 * (tu - c6) ;
-  fTemp = a + (mc / (a + md)) ;
-  cTemp = (int)rint (((100.0 * fTemp) + 0.5) / 10.0) ;
+  lastFTemp = a + (mc / (a + md)) ;
+  cTemp = (int)rint (((100.0 * lastFTemp) + 0.5) / 10.0) ;
 
 #ifdef	DEBUG
-  printf ("fTemp: %f, cTemp: %6d\n", fTemp, cTemp) ;
+  printf ("fTemp: %f, cTemp: %6d\n", lastFTemp, cTemp) ;
 #endif
+}
 
-// Start a pressure snsor reading
 
-  wiringPiI2CWriteReg8 (fd, 0xF4, 0x34 | (BMP180_OSS << 6)) ;
-  delay (5) ;
+/*
+ * bmp180HarvestPress:
+ *	Collect a finished pressure conversion, compensated with the last
+ *	temperature, and update the cache
+ *********************************************************************************
+ */
 
-// Read the raw data
+static void bmp180HarvestPress (int fd)
+{
+  double fPress ;
+  double pu, s, x, y, z ;
+  uint8_t data [4] ;
+
+// Read the raw data - one block transaction, the chip auto-increments
 
-  data [0] = wiringPiI2CReadReg8 (fd, 0xF6) ;
-  data [1] = wiringPiI2CReadReg8 (fd, 0xF7) ;
-  data [2] = wiringPiI2CReadReg8 (fd, 0xF8) ;
+  if (wiringPiI2CReadBlockData (fd, 0xF6, data, 3) != 3)
+  {
+    data [0] = wiringPiI2CReadReg8 (fd, 0xF6) ;
+    data [1] = wiringPiI2CReadReg8 (fd, 0xF7) ;
+    data [2] = wiringPiI2CReadReg8 (fd, 0xF8) ;
+  }
 
 // And calculate...
 
   pu = ((double)data [0] * 256.0) + (double)data [1] + ((double)data [2] / 256.0) ;
-  s = fTemp - 25.0 ;
+  s = lastFTemp - 25.0 ;
   x = (x2 * pow (s, 2.0)) + (x1 * s) + x0 ;
   y = (yy2 * pow (s, 2.0)) + (yy1 * s) + yy0 ;
   z = (pu - x) / y ;
@@ -138,6 +198,68 @@ static void bmp180ReadTempPress (int fd)
 }
 
 
+/*
+ * bmp180ReadTempPress:
+ *	Does the hard work of reading the sensor - the blocking way
+ *********************************************************************************
+ */
+
+static void bmp180ReadTempPress (int fd)
+{
+  bmp180StartTemp (fd) ;
+  delay (5) ;
+  bmp180HarvestTemp (fd) ;
+
+  bmp180StartPress (fd) ;
+  delay (5) ;
+  bmp180HarvestPress (fd) ;
+
+  haveReading = TRUE ;
+}
+
+
+/*
+ * bmp180Step:
+ *	Advance the state machine by at most one state: start a conversion,
+ *	or harvest one whose time is up. Never waits. Returns the state we
+ *	left the chip in.
+ *********************************************************************************
+ */
+
+static int bmp180Step (int fd)
+{
+  switch (nbState)
+  {
+    case BMP180_IDLE:
+      bmp180StartTemp (fd) ;
+      nbStartedAt = bmp180Now () ;
+      nbState     = BMP180_TEMP_WAIT ;
+      break ;
+
+    case BMP180_TEMP_WAIT:
+      if ((bmp180Now () - nbStartedAt) >= BMP180_CONV_MS)
+      {
+	bmp180HarvestTemp (fd) ;
+	bmp180StartPress  (fd) ;
+	nbStartedAt = bmp180Now () ;
+	nbState     = BMP180_PRESS_WAIT ;
+      }
+      break ;
+
+    case BMP180_PRESS_WAIT:
+      if ((bmp180Now () - nbStartedAt) >= BMP180_CONV_MS)
+      {
+	bmp180HarvestPress (fd) ;
+	haveReading = TRUE ;
+	nbState     = BMP180_IDLE ;
+      }
+      break ;
+  }
+
+  return nbState ;
+}
+
+
 /*
  * myAnalogWrite:
  *	Write to a fake register to represent the height above sea level
@@ -162,7 +284,17 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 {
   int chan = pin - node->pinBase ;
 
-  bmp180ReadTempPress (node->fd) ;
+  if (refresherRunning)			// The thread keeps the cache fresh
+    ;
+  else if (nbEnabled)
+  {
+    if (!haveReading)			// Nothing cached yet - block this once
+      bmp180ReadTempPress (node->fd) ;
+    else
+      bmp180Step (node->fd) ;
+  }
+  else
+    bmp180ReadTempPress (node->fd) ;
 
   if      (chan == 0)	// Read Temperature
     return cTemp ;
@@ -176,6 +308,90 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * bmp180SetNonBlocking:
+ *	When enabled, analogRead never waits on a conversion: it nudges the
+ *	state machine along and returns the cached values, which therefore
+ *	lag by up to one full temperature + pressure cycle (~10ms). The very
+ *	first read still blocks once to have something to serve.
+ *********************************************************************************
+ */
+
+void bmp180SetNonBlocking (int enable)
+{
+  nbEnabled = enable ;
+  nbState   = BMP180_IDLE ;
+}
+
+
+/*
+ * bmp180Refresher:
+ *	Drive the state machine from its own thread: poll while a conversion
+ *	is pending, rest for the interval between full cycles.
+ *********************************************************************************
+ */
+
+static void *bmp180Refresher (void *arg)
+{
+  (void)arg ;
+
+  while (refresherRunning)
+  {
+    if (bmp180Step (bmp180Fd) == BMP180_IDLE)	// Cycle complete
+      delay (refresherIntervalMs) ;
+    else
+      delay (1) ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * bmp180RefresherStart:
+ *	Start a background thread which re-reads the sensor continually,
+ *	pausing intervalMs between cycles; analogRead then serves the cache
+ *	without ever touching the bus. Returns TRUE on success.
+ *********************************************************************************
+ */
+
+int bmp180RefresherStart (unsigned int intervalMs)
+{
+  if (refresherRunning || (bmp180Fd < 0))
+    return FALSE ;
+
+  refresherIntervalMs = intervalMs ;
+  nbState             = BMP180_IDLE ;
+  refresherRunning    = TRUE ;
+
+  if (pthread_create (&refresherThread, NULL, bmp180Refresher, NULL) != 0)
+  {
+    refresherRunning = FALSE ;
+    return FALSE ;
+  }
+
+  return TRUE ;
+}
+
+
+/*
+ * bmp180RefresherStop:
+ *	Stop the background thread. Can block up to an interval.
+ *********************************************************************************
+ */
+
+int bmp180RefresherStop (void)
+{
+  if (!refresherRunning)
+    return FALSE ;
+
+  refresherRunning = FALSE ;
+  pthread_join (refresherThread, NULL) ;
+
+  return TRUE ;
+}
+
+
 /*
  * bmp180Setup:
  *	Create a new instance of a PCF8591 I2C GPIO interface. We know it
@@ -189,6 +405,7 @@ int bmp180Setup (const int pinBase)
 {
   double c3, c4, b1 ;
   int fd ;
+  uint8_t calib [22] ;
   struct wiringPiNodeStruct *node ;
 
   if ((fd = wiringPiI2CSetup (I2C_ADDRESS)) < 0)
@@ -200,19 +417,39 @@ int bmp180Setup (const int pinBase)
   node->analogRead  = myAnalogRead ;
   node->analogWrite = myAnalogWrite ;
 
-// Read calibration data
-
-  AC1 = read16 (fd, 0xAA) ;
-  AC2 = read16 (fd, 0xAC) ;
-  AC3 = read16 (fd, 0xAE) ;
-  AC4 = read16 (fd, 0xB0) ;
-  AC5 = read16 (fd, 0xB2) ;
-  AC6 = read16 (fd, 0xB4) ;
-  VB1 = read16 (fd, 0xB6) ;
-  VB2 = read16 (fd, 0xB8) ;
-   MB = read16 (fd, 0xBA) ;
-   MC = read16 (fd, 0xBC) ;
-   MD = read16 (fd, 0xBE) ;
+  bmp180Fd = fd ;	// For the refresher thread
+
+// Read the calibration data - all 22 bytes in one block transaction if we
+//	can, else the old 2 bus transactions per value
+
+  if (wiringPiI2CReadBlockData (fd, 0xAA, calib, 22) == 22)
+  {
+    AC1 = (calib [ 0] << 8) | calib [ 1] ;
+    AC2 = (calib [ 2] << 8) | calib [ 3] ;
+    AC3 = (calib [ 4] << 8) | calib [ 5] ;
+    AC4 = (calib [ 6] << 8) | calib [ 7] ;
+    AC5 = (calib [ 8] << 8) | calib [ 9] ;
+    AC6 = (calib [10] << 8) | calib [11] ;
+    VB1 = (calib [12] << 8) | calib [13] ;
+    VB2 = (calib [14] << 8) | calib [15] ;
+     MB = (calib [16] << 8) | calib [17] ;
+     MC = (calib [18] << 8) | calib [19] ;
+     MD = (calib [20] << 8) | calib [21] ;
+  }
+  else
+  {
+    AC1 = read16 (fd, 0xAA) ;
+    AC2 = read16 (fd, 0xAC) ;
+    AC3 = read16 (fd, 0xAE) ;
+    AC4 = read16 (fd, 0xB0) ;
+    AC5 = read16 (fd, 0xB2) ;
+    AC6 = read16 (fd, 0xB4) ;
+    VB1 = read16 (fd, 0xB6) ;
+    VB2 = read16 (fd, 0xB8) ;
+     MB = read16 (fd, 0xBA) ;
+     MC = read16 (fd, 0xBC) ;
+     MD = read16 (fd, 0xBE) ;
+  }
 
 // Calculate coefficients
 
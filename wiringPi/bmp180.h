@@ -29,6 +29,14 @@ extern "C" {
 
 extern int bmp180Setup (const int pinBase) ;
 
+// Interface V3.17 - analogRead without the ~10ms conversion stall:
+//	either poll the state machine from the caller's loop, or hand the
+//	whole cycle to a background thread and serve reads from the cache
+
+extern void bmp180SetNonBlocking (int enable) ;
+extern int  bmp180RefresherStart (unsigned int intervalMs) ;
+extern int  bmp180RefresherStop  (void) ;
+
 #ifdef __cplusplus
 }
 #endif
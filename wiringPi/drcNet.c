@@ -27,8 +27,11 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
+#include <poll.h>
 #include <string.h>
 #include <errno.h>
 #include <crypt.h>
@@ -39,6 +42,91 @@
 #include "../wiringPiD/drcNetCmd.h"
 
 
+// Command batching:
+//	Every remote operation is a 12-byte struct which the server executes
+//	in arrival order, echoing the struct back as the reply. Sent one at a
+//	time each write costs a full network round trip, so a burst of remote
+//	digitalWrite()s over WiFi crawls. Between drcNetBatchBegin() and
+//	drcNetBatchFlush() the write-type operations are queued instead, then
+//	flushed with a single send() - the whole queue fits one TCP segment -
+//	and the replies are matched back against the queue by their sequence
+//	number (the queue slot). One round trip total, not one per command.
+//	Reads can't be deferred (the caller needs the value now) so they
+//	flush the queue and then run synchronously as before.
+
+#define	DRCN_BATCH_MAX	120	// 120 * 12 bytes - inside a standard MSS
+
+static struct drcNetComStruct batchQueue [DRCN_BATCH_MAX] ;
+static int batchHasReply [DRCN_BATCH_MAX] ;	// Some commands aren't echoed
+static int batchFd    = -1 ;			// -1: not batching
+static int batchCount =  0 ;
+
+// UDP transport:
+//	Fire-and-forget datagrams for the idempotent writes - no reply, no
+//	RTT, one datagram per flush. We shadow the last value written to
+//	each pin so drcNetUdpSync() can re-send the whole state and heal
+//	any losses. One UDP node per process.
+
+#define	DRCN_UDP_MAX_PINS	64
+
+struct drcUdpShadow
+{
+  uint8_t  hasMode, hasPud, hasValue ;
+  uint8_t  valueCmd ;		// Which write last touched the pin
+  uint32_t mode, pud, value ;
+} ;
+
+static struct drcUdpShadow udpShadow [DRCN_UDP_MAX_PINS] ;
+static int      udpNodeFd   = -1 ;
+static int      udpNumPins  =  0 ;
+static uint32_t udpSeq      =  0 ;
+
+// Connection pool:
+//	One slot per remote daemon, keyed by host and port. A slot keeps
+//	the credentials and the resume token the daemon handed back
+//	(DRCN_SESSION), so the next connection to the same daemon -
+//	another drcSetupNet() or an explicit drcNetReconnect() - presents
+//	the token in the challenge phase and skips the crypt handshake.
+//	TCP keepalive probes on every pooled connection spot a dead
+//	daemon in seconds rather than on the next command's timeout.
+
+#define	DRCN_POOL_MAX	16
+
+struct drcPoolSlot
+{
+  int  used ;
+  int  fd ;			// -1: not currently connected
+  char host [64] ;
+  char port [16] ;
+  char password [64] ;
+  uint32_t tokenHi, tokenLo ;	// 0,0: no live token
+} ;
+
+static struct drcPoolSlot pool [DRCN_POOL_MAX] ;
+
+
+static int udpSend (const struct drcNetComStruct *cmds, int count)
+{
+  struct
+  {
+    struct drcNetUdpHead   head ;
+    struct drcNetComStruct cmds [DRCN_BATCH_MAX] ;
+  } packet ;
+  ssize_t len ;
+
+  if (count == 0)
+    return 0 ;
+
+  packet.head.magic = DRCN_UDP_MAGIC ;
+  packet.head.seq   = ++udpSeq ;
+  packet.head.count = count ;
+  memcpy (packet.cmds, cmds, count * sizeof (struct drcNetComStruct)) ;
+
+  len = sizeof (struct drcNetUdpHead) + count * sizeof (struct drcNetComStruct) ;
+  return (send (udpNodeFd, &packet, len, 0) == len) ? count : -1 ;
+}
+
+
 /*
  * remoteReadline:
  *	Read in a line of data from the remote server, ending with a newline
@@ -132,13 +220,12 @@ static int authenticate (int fd, const char *pass)
 
 
 /*
- * _drcSetupNet:
- *	Do the hard work of establishing a network connection and authenticating
- *	the password.
+ * drcConnect:
+ *	Establish the TCP connection - the authentication happens on top.
  *********************************************************************************
  */
 
-int _drcSetupNet (const char *ipAddress, const char *port, const char *password)
+static int drcConnect (const char *ipAddress, const char *port)
 {
   struct addrinfo hints;
   struct addrinfo *result, *rp ;
@@ -180,21 +267,476 @@ int _drcSetupNet (const char *ipAddress, const char *port, const char *password)
     if ((remoteFd = socket (rp->ai_family, rp->ai_socktype, rp->ai_protocol)) < 0)
       continue ;
 
-    if (connect (remoteFd, rp->ai_addr, rp->ai_addrlen) < 0)
-      continue ;
+    if (connect (remoteFd, rp->ai_addr, rp->ai_addrlen) == 0)
+    {
+      freeaddrinfo (result) ;
+      return remoteFd ;
+    }
+
+    close (remoteFd) ;
+  }
+  freeaddrinfo (result) ;
+
+  errno = EHOSTUNREACH ;	// Host unreachable - may not be right, but good enough
+  return -1 ; // Nothing connected
+}
+
+
+/*
+ * poolTake: poolFindByFd:
+ *	Slot management for the connection pool.
+ *********************************************************************************
+ */
+
+static struct drcPoolSlot *poolTake (const char *host, const char *port, const char *password)
+{
+  int i, slot = -1 ;
+
+  for (i = 0 ; i < DRCN_POOL_MAX ; ++i)
+  {
+    if (pool [i].used && (strcmp (pool [i].host, host) == 0) && (strcmp (pool [i].port, port) == 0))
+      return &pool [i] ;
+    if (!pool [i].used && (slot == -1))
+      slot = i ;
+  }
+
+  if (slot == -1)
+    return NULL ;	// Full - the connection still works, just unpooled
+
+  if ((strlen (host)     >= sizeof (pool [slot].host)) ||
+      (strlen (port)     >= sizeof (pool [slot].port)) ||
+      (strlen (password) >= sizeof (pool [slot].password)))
+    return NULL ;
+
+  pool [slot].used = TRUE ;
+  pool [slot].fd   = -1 ;
+  strcpy (pool [slot].host,     host) ;
+  strcpy (pool [slot].port,     port) ;
+  strcpy (pool [slot].password, password) ;
+  pool [slot].tokenHi = pool [slot].tokenLo = 0 ;
+  return &pool [slot] ;
+}
+
+static struct drcPoolSlot *poolFindByFd (int fd)
+{
+  int i ;
+
+  for (i = 0 ; i < DRCN_POOL_MAX ; ++i)
+    if (pool [i].used && (pool [i].fd == fd))
+      return &pool [i] ;
+
+  return NULL ;
+}
+
 
+/*
+ * resumeAuth:
+ *	Answer the challenge with our resume token instead of the hash -
+ *	the daemon's 86-byte slot reads "RESUME " plus 16 hex digits,
+ *	'.'-padded. The token is single use, so it's spent here whatever
+ *	the daemon makes of it.
+ *********************************************************************************
+ */
+
+static int resumeAuth (int fd, struct drcPoolSlot *slot)
+{
+  char blob [87] ;
+
+  if (getChallenge (fd) == NULL)	// The daemon always opens with one
+    return -1 ;
+
+  memset (blob, '.', 86) ;
+  sprintf (blob, "RESUME %08x%08x", slot->tokenHi, slot->tokenLo) ;
+  blob [23] = '.' ;			// sprintf's terminator
+  slot->tokenHi = slot->tokenLo = 0 ;
+
+  return (write (fd, blob, 86) == 86) ? 0 : -1 ;
+}
+
+
+/*
+ * sessionFetch:
+ *	Ask the (authenticated) connection for a resume token for next
+ *	time. Doubles as the liveness check after a resume attempt: a
+ *	daemon that rejected the token has dropped us and the recv fails.
+ *	An old daemon swallows the record without replying, hence the
+ *	timeout - we just carry on tokenless.
+ *********************************************************************************
+ */
+
+static int sessionFetch (int fd, struct drcPoolSlot *slot)
+{
+  struct drcNetComStruct cmd ;
+  struct pollfd p ;
+
+  if (slot == NULL)
+    return 0 ;
+
+  cmd.pin  = 0 ;
+  cmd.cmd  = DRCN_SESSION ;
+  cmd.data = 0 ;
+  if (send (fd, &cmd, sizeof (cmd), 0) != (ssize_t)sizeof (cmd))
+    return -1 ;
+
+  p.fd      = fd ;
+  p.events  = POLLIN ;
+  p.revents = 0 ;
+  if (poll (&p, 1, 2000) <= 0)
+    return -1 ;
+  if (recv (fd, &cmd, sizeof (cmd), 0) != (ssize_t)sizeof (cmd))
+    return -1 ;
+
+  slot->tokenHi = cmd.pin ;
+  slot->tokenLo = cmd.data ;
+  return 0 ;
+}
+
+
+/*
+ * drcKeepalive:
+ *	Probe an idle pooled connection so a dead daemon shows up in
+ *	around ten seconds instead of on the next command's timeout.
+ *********************************************************************************
+ */
+
+static void drcKeepalive (int fd)
+{
+  int val ;
+
+  val =  1 ; (void)setsockopt (fd, SOL_SOCKET,  SO_KEEPALIVE,  (void *)&val, sizeof (val)) ;
+  val = 10 ; (void)setsockopt (fd, IPPROTO_TCP, TCP_KEEPIDLE,  (void *)&val, sizeof (val)) ;
+  val =  3 ; (void)setsockopt (fd, IPPROTO_TCP, TCP_KEEPINTVL, (void *)&val, sizeof (val)) ;
+  val =  3 ; (void)setsockopt (fd, IPPROTO_TCP, TCP_KEEPCNT,   (void *)&val, sizeof (val)) ;
+}
+
+
+/*
+ * _drcSetupNet:
+ *	Do the hard work of establishing a network connection and
+ *	authenticating - by resume token when the pool holds a live one,
+ *	by the full crypt exchange otherwise.
+ *********************************************************************************
+ */
+
+int _drcSetupNet (const char *ipAddress, const char *port, const char *password)
+{
+  struct drcPoolSlot *slot ;
+  int remoteFd, resumed ;
+
+  slot = poolTake (ipAddress, port, password) ;
+
+  if ((remoteFd = drcConnect (ipAddress, port)) < 0)
+    return -1 ;
+
+// Try the fast path first: a rejected token costs us this connection,
+//	so it's a fresh one plus the full handshake from there.
+
+  resumed = FALSE ;
+  if ((slot != NULL) && ((slot->tokenHi | slot->tokenLo) != 0))
+  {
+    if ((resumeAuth (remoteFd, slot) == 0) && (sessionFetch (remoteFd, slot) == 0))
+      resumed = TRUE ;
+    else
+    {
+      close (remoteFd) ;
+      if ((remoteFd = drcConnect (ipAddress, port)) < 0)
+	return -1 ;
+    }
+  }
+
+  if (!resumed)
+  {
     if (authenticate (remoteFd, password) < 0)
     {
       close (remoteFd) ;
       errno = EACCES ;		// Permission denied
       return -1 ;
     }
-    else
-      return remoteFd ;
+    (void)sessionFetch (remoteFd, slot) ;	// May fail on an old daemon - fine
   }
 
-  errno = EHOSTUNREACH ;	// Host unreachable - may not be right, but good enough
-  return -1 ; // Nothing connected
+  drcKeepalive (remoteFd) ;
+  if (slot != NULL)
+    slot->fd = remoteFd ;
+  return remoteFd ;
+}
+
+
+/*
+ * drcNetReconnect:
+ *	Re-establish the connection under an existing DRC node after a
+ *	daemon restart or network drop - by resume token when one is
+ *	live, so failover to a recovered daemon is a connect and one
+ *	line. The node's fd number is preserved (dup2) so anything
+ *	holding it - a batch in progress, the pool - stays valid.
+ *	Returns TRUE on success.
+ *********************************************************************************
+ */
+
+int drcNetReconnect (const int pinBase)
+{
+  struct wiringPiNodeStruct *node ;
+  struct drcPoolSlot *slot ;
+  int fd, len ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return FALSE ;
+
+  if ((slot = poolFindByFd (node->fd)) == NULL)
+    return FALSE ;	// Not a pooled TCP node
+
+  if ((fd = _drcSetupNet (slot->host, slot->port, slot->password)) < 0)
+    return FALSE ;
+
+// The same per-record framing and Nagle setting as drcSetupNet gave
+//	the original connection
+
+  len = sizeof (struct drcNetComStruct) ;
+  (void)setsockopt (fd, SOL_SOCKET, SO_RCVLOWAT, (void *)&len, sizeof (len)) ;
+  len = 1 ;
+  (void)setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, (void *)&len, sizeof (len)) ;
+
+  if (fd != node->fd)
+  {
+    if (dup2 (fd, node->fd) < 0)
+    {
+      close (fd) ;
+      return FALSE ;
+    }
+    close (fd) ;
+    slot->fd = node->fd ;
+  }
+
+  return TRUE ;
+}
+
+
+/*
+ * drcNetBatchBegin:
+ *	Start queuing write-type commands for the DRC node owning pinBase.
+ *	Returns TRUE, or FALSE if there's no such node (or another node is
+ *	already batching - one batch at a time).
+ *********************************************************************************
+ */
+
+int drcNetBatchBegin (const int pinBase)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return FALSE ;
+
+  if ((batchFd != -1) && (batchFd != node->fd))
+    return FALSE ;
+
+  batchFd = node->fd ;
+  return TRUE ;
+}
+
+
+/*
+ * drcNetBatchFlush:
+ *	Send every queued command in one segment, then read back the echoed
+ *	replies and match them against the queue by sequence number.
+ *	Returns the number of commands flushed, or -1 with errno set on a
+ *	network failure or a reply arriving out of sequence.
+ *********************************************************************************
+ */
+
+int drcNetBatchFlush (void)
+{
+  struct drcNetComStruct replies [DRCN_BATCH_MAX] ;
+  int expected, got, num, seq, rep ;
+
+  if ((batchFd == -1) || (batchCount == 0))
+  {
+    batchCount = 0 ;
+    return 0 ;
+  }
+
+  num = batchCount ;
+  batchCount = 0 ;
+
+  if ((udpNodeFd != -1) && (batchFd == udpNodeFd))	// One datagram, no replies
+    return udpSend (batchQueue, num) ;
+
+  if (send (batchFd, batchQueue, num * sizeof (struct drcNetComStruct), 0) !=
+			(ssize_t)(num * sizeof (struct drcNetComStruct)))
+    return -1 ;
+
+  expected = 0 ;
+  for (seq = 0 ; seq < num ; ++seq)
+    if (batchHasReply [seq])
+      ++expected ;
+
+  for (got = 0 ; got < expected ; )
+  {
+    ssize_t len = recv (batchFd, (char *)replies + got * sizeof (struct drcNetComStruct),
+			(expected - got) * sizeof (struct drcNetComStruct), 0) ;
+    if (len <= 0)
+      return -1 ;
+    got += len / sizeof (struct drcNetComStruct) ;
+  }
+
+// The server executes and echoes in arrival order, so reply N must be the
+//	echo of the Nth queued command that expects one.
+
+  rep = 0 ;
+  for (seq = 0 ; seq < num ; ++seq)
+  {
+    if (!batchHasReply [seq])
+      continue ;
+    if ((replies [rep].cmd != batchQueue [seq].cmd) || (replies [rep].pin != batchQueue [seq].pin))
+    {
+      errno = EBADE ;
+      return -1 ;
+    }
+    ++rep ;
+  }
+
+  return num ;
+}
+
+
+/*
+ * drcNetBatchEnd:
+ *	Flush anything still queued and leave batch mode.
+ *********************************************************************************
+ */
+
+int drcNetBatchEnd (void)
+{
+  int result = drcNetBatchFlush () ;
+
+  batchFd = -1 ;
+  return result ;
+}
+
+
+/*
+ * drcBatchAdd:
+ *	Queue a command if batching is active on this node's connection.
+ *	Returns TRUE if queued, FALSE if the caller should send it itself.
+ *********************************************************************************
+ */
+
+static int drcBatchAdd (struct wiringPiNodeStruct *node, struct drcNetComStruct *cmd, int hasReply)
+{
+  if ((batchFd == -1) || (batchFd != node->fd))
+    return FALSE ;
+
+  if (batchCount == DRCN_BATCH_MAX)	// Full: flush and keep going
+    if (drcNetBatchFlush () < 0)
+      return FALSE ;
+
+  batchQueue    [batchCount] = *cmd ;
+  batchHasReply [batchCount] = hasReply ;
+  ++batchCount ;
+  return TRUE ;
+}
+
+
+/*
+ * drcBatchSync:
+ *	A read is about to go out - drain any queued writes first so the
+ *	commands still execute in program order.
+ *********************************************************************************
+ */
+
+static void drcBatchSync (struct wiringPiNodeStruct *node)
+{
+  if ((batchFd != -1) && (batchFd == node->fd))
+    (void)drcNetBatchFlush () ;
+}
+
+
+/*
+ * drcNetBroadcast:
+ *	Fan one write out over every pooled connection - the same record
+ *	to every downstream daemon we hold a socket to. Everything is
+ *	sent before any echo is collected, so the round trips overlap
+ *	and the whole fan-out costs one RTT, not one per node. pin is
+ *	the offset within each node's range; op is one of the write
+ *	commands (0: DRCN_DIGITAL_WRITE). Returns the number of nodes
+ *	reached, -1 for a bad op.
+ *********************************************************************************
+ */
+
+int drcNetBroadcast (const int pin, int op, const unsigned int value)
+{
+  struct drcNetComStruct cmd, echo ;
+  int fds [DRCN_POOL_MAX] ;
+  int slot, i, n = 0, reached = 0 ;
+
+  if (op == 0)
+    op = DRCN_DIGITAL_WRITE ;
+
+  switch (op)
+  {
+    case DRCN_PIN_MODE:
+    case DRCN_PULL_UP_DN:
+    case DRCN_DIGITAL_WRITE:
+    case DRCN_PWM_WRITE:
+    case DRCN_ANALOG_WRITE:
+      break ;
+    default:
+      return -1 ;
+  }
+
+  if (batchFd != -1)		// Don't interleave with a batch's echo matching
+    (void)drcNetBatchFlush () ;
+
+  cmd.pin  = pin ;
+  cmd.cmd  = op ;
+  cmd.data = value ;
+
+  for (slot = 0 ; slot < DRCN_POOL_MAX ; ++slot)
+    if (pool [slot].used && (pool [slot].fd != -1))
+      fds [n++] = pool [slot].fd ;
+
+  for (i = 0 ; i < n ; ++i)
+    if (send (fds [i], &cmd, sizeof (cmd), 0) == sizeof (cmd))
+      ++reached ;
+    else
+      fds [i] = -1 ;
+
+  for (i = 0 ; i < n ; ++i)	// Now collect the echoes
+    if (fds [i] != -1)
+      (void)recv (fds [i], &echo, sizeof (echo), 0) ;
+
+  return reached ;
+}
+
+
+/*
+ * drcNetBroadcastWrite:
+ *	Ask the proxy daemon owning pinBase to fan a digitalWrite out to
+ *	all of its downstream nodes - one round trip to the proxy however
+ *	many nodes sit behind it. pin is the offset within each node's
+ *	range. Returns the number of nodes the proxy reached, or -1.
+ *********************************************************************************
+ */
+
+int drcNetBroadcastWrite (const int pinBase, const int pin, const int value)
+{
+  struct wiringPiNodeStruct *node ;
+  struct drcNetComStruct cmd ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  drcBatchSync (node) ;
+
+  cmd.pin  = pin ;
+  cmd.cmd  = DRCN_BROADCAST | ((uint32_t)DRCN_DIGITAL_WRITE << 16) ;
+  cmd.data = value ;
+
+  if (send (node->fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
+    return -1 ;
+  if (recv (node->fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
+    return -1 ;
+
+  return (int)cmd.data ;
 }
 
 
@@ -212,6 +754,9 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
   cmd.cmd  = DRCN_PIN_MODE ;
   cmd.data = mode ;
 
+  if (drcBatchAdd (node, &cmd, TRUE))
+    return ;
+
   (void)send (node->fd, &cmd, sizeof (cmd), 0) ;
   (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
 }
@@ -230,6 +775,9 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
   cmd.cmd  = DRCN_PULL_UP_DN ;
   cmd.data = mode ;
 
+  if (drcBatchAdd (node, &cmd, FALSE))	// The server doesn't echo this one
+    return ;
+
   (void)send (node->fd, &cmd, sizeof (cmd), 0) ;
   (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
 }
@@ -248,6 +796,9 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
   cmd.cmd  = DRCN_DIGITAL_WRITE ;
   cmd.data = value ;
 
+  if (drcBatchAdd (node, &cmd, TRUE))
+    return ;
+
   (void)send (node->fd, &cmd, sizeof (cmd), 0) ;
   (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
 }
@@ -266,6 +817,9 @@ static void myAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
   cmd.cmd  = DRCN_ANALOG_WRITE ;
   cmd.data = value ;
 
+  if (drcBatchAdd (node, &cmd, TRUE))
+    return ;
+
   (void)send (node->fd, &cmd, sizeof (cmd), 0) ;
   (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
 }
@@ -284,6 +838,9 @@ static void myPwmWrite (struct wiringPiNodeStruct *node, int pin, int value)
   cmd.cmd  = DRCN_PWM_WRITE ;
   cmd.data = value ;
 
+  if (drcBatchAdd (node, &cmd, TRUE))
+    return ;
+
   (void)send (node->fd, &cmd, sizeof (cmd), 0) ;
   (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
 }
@@ -298,6 +855,8 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 {
   struct drcNetComStruct cmd ;
 
+  drcBatchSync (node) ;
+
   cmd.pin  = pin - node->pinBase ;
   cmd.cmd  = DRCN_ANALOG_READ ;
   cmd.data = 0 ;
@@ -318,6 +877,8 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 {
   struct drcNetComStruct cmd ;
 
+  drcBatchSync (node) ;
+
   cmd.pin  = pin - node->pinBase ;
   cmd.cmd  = DRCN_DIGITAL_READ ;
   cmd.data = 0 ;
@@ -349,6 +910,11 @@ int drcSetupNet (const int pinBase, const int numPins, const char *ipAddress, co
   if (setsockopt (fd, SOL_SOCKET, SO_RCVLOWAT, (void *)&len, sizeof (len)) < 0)
     return FALSE ;
 
+// Don't let Nagle sit on a flushed batch waiting for the previous ACK
+
+  len = 1 ;
+  (void)setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, (void *)&len, sizeof (len)) ;
+
   node = wiringPiNewNode (pinBase, numPins) ;
 
   node->fd               = fd ;
@@ -363,3 +929,235 @@ int drcSetupNet (const int pinBase, const int numPins, const char *ipAddress, co
 
   return TRUE ;
 }
+
+
+/*
+ * drcSetupNetUnix:
+ *	As drcSetupNet, but over the daemon's local Unix-domain socket -
+ *	no TCP stack, no password (the daemon checks who we are via
+ *	SO_PEERCRED) and SOCK_SEQPACKET keeps each batch one framed
+ *	message. path NULL: the daemon's default socket.
+ *********************************************************************************
+ */
+
+int drcSetupNetUnix (const int pinBase, const int numPins, const char *path)
+{
+  struct sockaddr_un sun ;
+  struct wiringPiNodeStruct *node ;
+  int fd ;
+
+  if (path == NULL)
+    path = DEFAULT_UNIX_SOCKET ;
+
+  if (strlen (path) >= sizeof (sun.sun_path))
+    return FALSE ;
+
+  if ((fd = socket (AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+    return FALSE ;
+
+  memset (&sun, 0, sizeof (sun)) ;
+  sun.sun_family = AF_UNIX ;
+  strcpy (sun.sun_path, path) ;
+
+  if (connect (fd, (struct sockaddr *)&sun, sizeof (sun)) < 0)
+  {
+    close (fd) ;
+    return FALSE ;
+  }
+
+  node = wiringPiNewNode (pinBase, numPins) ;
+
+  node->fd               = fd ;
+  node->pinMode          = myPinMode ;
+  node->pullUpDnControl  = myPullUpDnControl ;
+  node->analogRead       = myAnalogRead ;
+  node->analogWrite      = myAnalogWrite ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->pwmWrite         = myPwmWrite ;
+
+  return TRUE ;
+}
+
+
+/*
+ * The UDP node methods:
+ *	Writes only - shadow the value, then one datagram (or a batch
+ *	queue entry). There's nothing to wait for.
+ *********************************************************************************
+ */
+
+static void myUdpPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  struct drcNetComStruct cmd ;
+  int p = pin - node->pinBase ;
+
+  cmd.pin  = p ;
+  cmd.cmd  = DRCN_PIN_MODE ;
+  cmd.data = mode ;
+
+  if (p < DRCN_UDP_MAX_PINS)
+    { udpShadow [p].hasMode = TRUE ; udpShadow [p].mode = mode ; }
+
+  if (!drcBatchAdd (node, &cmd, FALSE))
+    (void)udpSend (&cmd, 1) ;
+}
+
+static void myUdpPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  struct drcNetComStruct cmd ;
+  int p = pin - node->pinBase ;
+
+  cmd.pin  = p ;
+  cmd.cmd  = DRCN_PULL_UP_DN ;
+  cmd.data = mode ;
+
+  if (p < DRCN_UDP_MAX_PINS)
+    { udpShadow [p].hasPud = TRUE ; udpShadow [p].pud = mode ; }
+
+  if (!drcBatchAdd (node, &cmd, FALSE))
+    (void)udpSend (&cmd, 1) ;
+}
+
+static void myUdpWrite (struct wiringPiNodeStruct *node, int pin, uint32_t writeCmd, int value)
+{
+  struct drcNetComStruct cmd ;
+  int p = pin - node->pinBase ;
+
+  cmd.pin  = p ;
+  cmd.cmd  = writeCmd ;
+  cmd.data = value ;
+
+  if (p < DRCN_UDP_MAX_PINS)
+  {
+    udpShadow [p].hasValue = TRUE ;
+    udpShadow [p].valueCmd = writeCmd ;
+    udpShadow [p].value    = value ;
+  }
+
+  if (!drcBatchAdd (node, &cmd, FALSE))
+    (void)udpSend (&cmd, 1) ;
+}
+
+static void myUdpDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  myUdpWrite (node, pin, DRCN_DIGITAL_WRITE, value) ;
+}
+
+static void myUdpPwmWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  myUdpWrite (node, pin, DRCN_PWM_WRITE, value) ;
+}
+
+static void myUdpAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  myUdpWrite (node, pin, DRCN_ANALOG_WRITE, value) ;
+}
+
+
+/*
+ * drcNetUdpSync:
+ *	Re-send everything we've ever written through the UDP node - mode,
+ *	pull and last value per pin - so a receiver that missed a datagram
+ *	converges on the next sync. Returns the number of commands sent,
+ *	or -1 on a send failure.
+ *********************************************************************************
+ */
+
+int drcNetUdpSync (void)
+{
+  struct drcNetComStruct cmds [DRCN_BATCH_MAX] ;
+  int pin, count = 0, total = 0 ;
+
+  if (udpNodeFd == -1)
+    return -1 ;
+
+  for (pin = 0 ; (pin < udpNumPins) && (pin < DRCN_UDP_MAX_PINS) ; ++pin)
+  {
+    struct drcUdpShadow *s = &udpShadow [pin] ;
+
+    if (s->hasMode)
+      { cmds [count].pin = pin ; cmds [count].cmd = DRCN_PIN_MODE ;   cmds [count].data = s->mode ;  ++count ; }
+    if (s->hasPud)
+      { cmds [count].pin = pin ; cmds [count].cmd = DRCN_PULL_UP_DN ; cmds [count].data = s->pud ;   ++count ; }
+    if (s->hasValue)
+      { cmds [count].pin = pin ; cmds [count].cmd = s->valueCmd ;     cmds [count].data = s->value ; ++count ; }
+
+    if (count > (DRCN_BATCH_MAX - 3))	// Room for the next pin's three
+    {
+      if (udpSend (cmds, count) < 0)
+	return -1 ;
+      total += count ;
+      count  = 0 ;
+    }
+  }
+
+  if (count != 0)
+  {
+    if (udpSend (cmds, count) < 0)
+      return -1 ;
+    total += count ;
+  }
+
+  return total ;
+}
+
+
+/*
+ * drcSetupNetUdp:
+ *	Create a write-only DRC node over UDP - for things like frame
+ *	pushes to a wall of remote Pis where losing one update doesn't
+ *	matter but waiting for an ACK does. No authentication: the daemon
+ *	end only enables this path on trusted networks.
+ *********************************************************************************
+ */
+
+int drcSetupNetUdp (const int pinBase, const int numPins, const char *ipAddress, const char *port)
+{
+  struct addrinfo hints ;
+  struct addrinfo *result, *rp ;
+  struct wiringPiNodeStruct *node ;
+  int fd = -1 ;
+
+  if (udpNodeFd != -1)		// Just the one per process
+    return FALSE ;
+
+  memset (&hints, 0, sizeof (hints)) ;
+  hints.ai_flags    = AI_NUMERICSERV ;
+  hints.ai_family   = AF_UNSPEC ;
+  hints.ai_socktype = SOCK_DGRAM ;
+
+  if (getaddrinfo (ipAddress, port, &hints, &result) != 0)
+    return FALSE ;
+
+  for (rp = result ; rp != NULL ; rp = rp->ai_next)
+  {
+    if ((fd = socket (rp->ai_family, rp->ai_socktype, rp->ai_protocol)) < 0)
+      continue ;
+
+    if (connect (fd, rp->ai_addr, rp->ai_addrlen) == 0)
+      break ;
+
+    close (fd) ;
+    fd = -1 ;
+  }
+  freeaddrinfo (result) ;
+
+  if (fd < 0)
+    return FALSE ;
+
+  node = wiringPiNewNode (pinBase, numPins) ;
+
+  node->fd              = fd ;
+  node->pinMode         = myUdpPinMode ;
+  node->pullUpDnControl = myUdpPullUpDnControl ;
+  node->digitalWrite    = myUdpDigitalWrite ;
+  node->pwmWrite        = myUdpPwmWrite ;
+  node->analogWrite     = myUdpAnalogWrite ;
+
+  udpNodeFd  = fd ;
+  udpNumPins = numPins ;
+  memset (udpShadow, 0, sizeof (udpShadow)) ;
+
+  return TRUE ;
+}
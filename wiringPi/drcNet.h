@@ -37,6 +37,38 @@ extern "C" {
 
 extern int drcSetupNet (const int pinBase, const int numPins, const char *ipAddress, const char *port, const char *password) ;
 
+// Interface V3.17 - queue write-type commands and flush them in a single
+//	round trip instead of paying one per command
+
+extern int drcNetBatchBegin (const int pinBase) ;
+extern int drcNetBatchFlush (void) ;
+extern int drcNetBatchEnd   (void) ;
+
+// Interface V3.17 - write-only fire-and-forget UDP transport with a
+//	periodic full state re-send to heal datagram loss
+
+extern int drcSetupNetUdp (const int pinBase, const int numPins, const char *ipAddress, const char *port) ;
+extern int drcNetUdpSync  (void) ;
+
+// Interface V3.17 - local Unix-domain transport, no password (the daemon
+//	authenticates by peer credentials); path NULL for the default
+
+extern int drcSetupNetUnix (const int pinBase, const int numPins, const char *path) ;
+
+// Interface V3.17 - pooled connections: keepalive probes, session-token
+//	fast resume and in-place reconnection after a daemon restart
+
+extern int drcNetReconnect (const int pinBase) ;
+
+// Interface V3.17 - fan-out: drcNetBroadcast writes one record to every
+//	pooled connection with the round trips overlapped (the daemon
+//	uses it for DRCN_BROADCAST); drcNetBroadcastWrite asks the proxy
+//	daemon owning pinBase to do the fan-out to its nodes - one client
+//	RTT regardless of the node count
+
+extern int drcNetBroadcast      (const int pin, int op, const unsigned int value) ;
+extern int drcNetBroadcastWrite (const int pinBase, const int pin, const int value) ;
+
 #ifdef __cplusplus
 }
 #endif
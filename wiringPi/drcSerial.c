@@ -33,6 +33,89 @@
 #include "drcSerial.h"
 
 
+/*
+ * Batch frames:   (Interface 3.17)
+ *	'Z' <len> <len command bytes> <xor checksum over len and payload>
+ *	The payload is the ordinary command stream, so any run of the
+ *	2-byte (and 3-byte 'v') commands can ride in one frame; the remote
+ *	executes the lot and answers a single '!' ack. Driving a bank of
+ *	pins then costs one serial round trip instead of one per pin.
+ *	Support is probed once at setup with an empty frame - firmwares
+ *	that don't know 'Z' stay on the classic per-command path.
+ *	Acks are pipelined: we don't wait for one frame's ack before
+ *	sending the next, only draining them before a read (replies come
+ *	back in order) or once DRC_MAX_PENDING frames are outstanding.
+ *
+ *	node->data0: remote speaks batch frames
+ *	node->data1: batch acks sent but not yet drained
+ *********************************************************************************
+ */
+
+#define	DRC_BATCH_CMD		'Z'
+#define	DRC_BATCH_ACK		'!'
+#define	DRC_BATCH_MAX		128
+#define	DRC_MAX_PENDING		4
+
+static void drcDrainAcks (struct wiringPiNodeStruct *node)
+{
+  while (node->data1 > 0)
+  {
+    if (serialGetchar (node->fd) < 0)	// Timeout - remote wedged, stop counting
+      break ;
+    node->data1-- ;
+  }
+}
+
+static void drcSendBatch (struct wiringPiNodeStruct *node, const unsigned char *payload, int len)
+{
+  unsigned char frame [2 + DRC_BATCH_MAX + 1] ;
+  unsigned char sum ;
+  int i ;
+
+  if (node->data1 >= DRC_MAX_PENDING)	// Bound the pipeline
+    drcDrainAcks (node) ;
+
+  frame [0] = DRC_BATCH_CMD ;
+  frame [1] = (unsigned char)len ;
+  sum       = (unsigned char)len ;
+  for (i = 0 ; i < len ; ++i)
+  {
+    frame [2 + i] = payload [i] ;
+    sum ^= payload [i] ;
+  }
+  frame [2 + len] = sum ;
+
+  serialWrite (node->fd, frame, 3 + len) ;	// One write, one eventual ack
+  node->data1++ ;
+}
+
+
+/*
+ * myDigitalWriteBank:
+ *	All masked pins in one frame - only installed when the probe at
+ *	setup found a batch-capable firmware.
+ *********************************************************************************
+ */
+
+static void myDigitalWriteBank (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int values)
+{
+  unsigned char payload [DRC_BATCH_MAX] ;
+  int pin, n ;
+
+  n = 0 ;
+  for (pin = 0 ; (pin < 32) && (pin <= node->pinMax - node->pinBase) ; ++pin)
+  {
+    if ((mask & (1u << pin)) == 0)
+      continue ;
+    payload [n++] = (values & (1u << pin)) ? '1' : '0' ;
+    payload [n++] = (unsigned char)pin ;
+  }
+
+  if (n != 0)
+    drcSendBatch (node, payload, n) ;
+}
+
+
 /*
  * myPinMode:
  *	Change the pin mode on the remote DRC device
@@ -113,6 +196,8 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 {
   int vHi, vLo ;
 
+  drcDrainAcks (node) ;		// Any batch acks arrive ahead of our reply
+
   serialPutchar (node->fd, 'a') ;
   serialPutchar (node->fd, pin - node->pinBase) ;
   vHi = serialGetchar (node->fd) ;
@@ -129,6 +214,8 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 
 static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 {
+  drcDrainAcks (node) ;		// Any batch acks arrive ahead of our reply
+
   serialPutchar (node->fd, 'r') ; // Send read command
   serialPutchar (node->fd, pin - node->pinBase) ;
   return (serialGetchar (node->fd) == '0') ? 0 : 1 ;
@@ -146,7 +233,7 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 int drcSetupSerial (const int pinBase, const int numPins, const char *device, const int baud)
 {
   int fd ;
-  int ok, tries ;
+  int ok, batched, tries ;
   time_t then ;
   struct wiringPiNodeStruct *node ;
 
@@ -182,9 +269,29 @@ int drcSetupSerial (const int pinBase, const int numPins, const char *device, co
     return FALSE ;
   }
 
+// Probe for batch frame support: an empty frame must come back with a
+//	single ack. Older firmwares ignore the unknown command and the
+//	probe simply times out.
+
+  serialPutchar (fd, DRC_BATCH_CMD) ;
+  serialPutchar (fd, 0) ;
+  serialPutchar (fd, 0) ;		// Checksum over nothing
+
+  batched = FALSE ;
+  then    = time (NULL) + 1 ;
+  while (time (NULL) < then)
+    if (serialDataAvail (fd))
+    {
+      if (serialGetchar (fd) == DRC_BATCH_ACK)
+        batched = TRUE ;
+      break ;
+    }
+
   node = wiringPiNewNode (pinBase, numPins) ;
 
   node->fd              = fd ;
+  node->data0           = batched ;
+  node->data1           = 0 ;
   node->pinMode         = myPinMode ;
   node->pullUpDnControl = myPullUpDnControl ;
   node->analogRead      = myAnalogRead ;
@@ -192,5 +299,8 @@ int drcSetupSerial (const int pinBase, const int numPins, const char *device, co
   node->digitalWrite    = myDigitalWrite ;
   node->pwmWrite        = myPwmWrite ;
 
+  if (batched)
+    node->digitalWriteBank = myDigitalWriteBank ;
+
   return TRUE ;
 }
@@ -33,30 +33,100 @@
 #include <string.h>
 #include <malloc.h>
 #include <ctype.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "wiringPi.h"
+#include "wiringPiCRC.h"
 
 #include "ds18b20.h"
 
 #define	W1_PREFIX	"/sys/bus/w1/devices/28-"
 #define	W1_POSTFIX	"/w1_slave"
 
+// The manager:
+//	Each w1_slave read blocks ~750ms while the probe converts, so a
+//	scan over several probes serialises into seconds. Every probe we
+//	set up is remembered here; ds18b20ManagerStart() gives each one a
+//	worker thread which re-reads it continually, all the conversions
+//	overlapping, and analogRead then serves the cached temperature
+//	without blocking at all.
+
+#define	DS18B20_MAX_PROBES	16
+
+struct ds18b20Probe
+{
+  int fd ;			// -1: slot free
+  int pinBase ;
+  pthread_t thread ;
+  volatile int temp ;		// Last good reading, C * 10
+  volatile unsigned long long readAt ;	// Monotonic ms; 0: never read
+} ;
+
+static struct ds18b20Probe ds18b20Probes [DS18B20_MAX_PROBES] =
+	{ [0 ... DS18B20_MAX_PROBES - 1] = { .fd = -1 } } ;
+
+static volatile int ds18b20ManagerRunning = FALSE ;
+static unsigned int ds18b20IntervalMs = 0 ;
+
+
+static unsigned long long ds18b20Now (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (unsigned long long)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL ;
+}
+
 
 /*
- * myAnalogRead:
+ * hexByte:
+ *	Two hex digits to a byte, -1 if they aren't hex digits.
  *********************************************************************************
  */
 
-static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+static int hexByte (const char *p)
+{
+  int nibble, byte = 0 ;
+  int i ;
+
+  for (i = 0 ; i < 2 ; ++i)
+  {
+    /**/ if (p [i] >= '0' && p [i] <= '9')
+      nibble = p [i] - '0' ;
+    else if (p [i] >= 'a' && p [i] <= 'f')
+      nibble = p [i] - 'a' + 10 ;
+    else if (p [i] >= 'A' && p [i] <= 'F')
+      nibble = p [i] - 'A' + 10 ;
+    else
+      return -1 ;
+    byte = (byte << 4) | nibble ;
+  }
+
+  return byte ;
+}
+
+
+/*
+ * ds18b20ReadSensor:
+ *	One blocking read and parse of a probe's w1_slave file.
+ *	Returns the temperature in C * 10, or a -999x code on failure.
+ *
+ *	The first line starts with the 9 raw scratchpad bytes in hex at
+ *	fixed offsets, so rather than trusting the kernel's YES/NO text
+ *	further down we decode those, check the Dallas CRC8 ourselves
+ *	(a valid scratchpad sums to 0 with the CRC byte included) and
+ *	take the temperature straight from bytes 0/1 - a corrupt read
+ *	is rejected, and a retry decided, without any string searching.
+ *********************************************************************************
+ */
+
+static int ds18b20ReadSensor (int fd)
 {
-  int  chan = pin - node->pinBase ;
-  int  fd = node->fd ;
   char buffer [4096] ;
+  unsigned char scratch [9] ;
   char *p ;
-  int  temp, sign ;
-
-  if (chan != 0)
-    return -9999 ;
+  int  temp, sign, n, i ;
 
 // Rewind the file - we're keeping it open to keep things going
 //	smoothly
@@ -66,10 +136,33 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 // Read the file - we know it's only a couple of lines, so this ought to be
 //	more than enough
 
-  if (read (fd, buffer, 4096) <= 0)	// Read nothing, or it failed in some odd way
+  if ((n = read (fd, buffer, 4095)) <= 0)	// Read nothing, or it failed in some odd way
     return -9998 ;
 
-// Look for YES, then t=
+  buffer [n] = 0 ;
+
+// Decode the scratchpad bytes off the front of the first line: 9 of
+//	"xx " back to back
+
+  for (i = 0 ; i < 9 ; ++i)
+  {
+    if ((temp = hexByte (buffer + i * 3)) < 0)
+      break ;
+    scratch [i] = (unsigned char)temp ;
+  }
+
+  if (i == 9)					// Got a scratchpad - the CRC is the verdict
+  {
+    if (wpiCRC8 (scratch, 9) != 0)
+      return -9997 ;
+
+    temp = (int)(short)((scratch [1] << 8) | scratch [0]) ;	// Raw, C * 16
+
+    return (temp * 10 + ((temp < 0) ? -8 : 8)) / 16 ;
+  }
+
+// Unexpected layout - fall back to the kernel's own verdict and its
+//	t= value
 
   if (strstr (buffer, "YES") == NULL)
     return -9997 ;
@@ -108,6 +201,143 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myAnalogRead:
+ *	From the cache when the manager runs, the slow way when it doesn't.
+ *********************************************************************************
+ */
+
+static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+{
+  struct ds18b20Probe *probe = &ds18b20Probes [node->data0] ;
+  int chan = pin - node->pinBase ;
+
+  if (chan != 0)
+    return -9999 ;
+
+  if (ds18b20ManagerRunning && (probe->readAt != 0))
+    return probe->temp ;
+
+  return ds18b20ReadSensor (node->fd) ;
+}
+
+
+/*
+ * ds18b20Worker:
+ *	One per probe: read (the ~750ms conversion happens in here, all
+ *	the workers' overlapping), cache, wait out the interval, repeat.
+ *********************************************************************************
+ */
+
+static void *ds18b20Worker (void *arg)
+{
+  struct ds18b20Probe *probe = (struct ds18b20Probe *)arg ;
+  int temp ;
+
+  while (ds18b20ManagerRunning)
+  {
+    temp = ds18b20ReadSensor (probe->fd) ;
+    if (temp > -9990)		// Keep the last good reading over a bad scan
+    {
+      probe->temp   = temp ;
+      probe->readAt = ds18b20Now () ;
+    }
+
+    delay (ds18b20IntervalMs) ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * ds18b20ManagerStart:
+ *	Start the background re-read cycle over every probe set up so far,
+ *	pausing intervalMs between each probe's reads. Returns the number
+ *	of probes being managed, 0 if there are none or it's running.
+ *********************************************************************************
+ */
+
+int ds18b20ManagerStart (unsigned int intervalMs)
+{
+  int i, count = 0 ;
+
+  if (ds18b20ManagerRunning)
+    return 0 ;
+
+  ds18b20IntervalMs     = intervalMs ;
+  ds18b20ManagerRunning = TRUE ;
+
+  for (i = 0 ; i < DS18B20_MAX_PROBES ; ++i)
+    if (ds18b20Probes [i].fd != -1)
+    {
+      if (pthread_create (&ds18b20Probes [i].thread, NULL, ds18b20Worker, &ds18b20Probes [i]) == 0)
+	++count ;
+      else
+	ds18b20Probes [i].thread = 0 ;
+    }
+
+  if (count == 0)
+    ds18b20ManagerRunning = FALSE ;
+
+  return count ;
+}
+
+
+/*
+ * ds18b20ManagerStop:
+ *	Stop the workers. Can block up to a conversion plus an interval.
+ *********************************************************************************
+ */
+
+int ds18b20ManagerStop (void)
+{
+  int i ;
+
+  if (!ds18b20ManagerRunning)
+    return FALSE ;
+
+  ds18b20ManagerRunning = FALSE ;
+
+  for (i = 0 ; i < DS18B20_MAX_PROBES ; ++i)
+    if ((ds18b20Probes [i].fd != -1) && (ds18b20Probes [i].thread != 0))
+    {
+      pthread_join (ds18b20Probes [i].thread, NULL) ;
+      ds18b20Probes [i].thread = 0 ;
+    }
+
+  return TRUE ;
+}
+
+
+/*
+ * ds18b20Read:
+ *	The cached temperature (C * 10) and how stale it is. Returns FALSE
+ *	if the pinBase isn't a probe or nothing has been read yet.
+ *********************************************************************************
+ */
+
+int ds18b20Read (const int pinBase, int *temp, unsigned int *ageMs)
+{
+  int i ;
+
+  for (i = 0 ; i < DS18B20_MAX_PROBES ; ++i)
+    if ((ds18b20Probes [i].fd != -1) && (ds18b20Probes [i].pinBase == pinBase))
+    {
+      if (ds18b20Probes [i].readAt == 0)
+	return FALSE ;
+
+      if (temp != NULL)
+	*temp = ds18b20Probes [i].temp ;
+      if (ageMs != NULL)
+	*ageMs = (unsigned int)(ds18b20Now () - ds18b20Probes [i].readAt) ;
+      return TRUE ;
+    }
+
+  return FALSE ;
+}
+
+
 /*
  * ds18b20Setup:
  *	Create a new instance of a DS18B20 temperature sensor.
@@ -116,10 +346,19 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 
 int ds18b20Setup (const int pinBase, const char *deviceId)
 {
-  int fd ;
+  int fd, slot ;
   struct wiringPiNodeStruct *node ;
   char *fileName ;
 
+// Find a manager slot first - a probe we can't manage isn't worth having
+
+  for (slot = 0 ; slot < DS18B20_MAX_PROBES ; ++slot)
+    if (ds18b20Probes [slot].fd == -1)
+      break ;
+
+  if (slot == DS18B20_MAX_PROBES)
+    return FALSE ;
+
 // Allocate space for the filename
 
   if ((fileName = malloc (strlen (W1_PREFIX) + strlen (W1_POSTFIX) + strlen (deviceId) + 1)) == NULL)
@@ -140,7 +379,13 @@ int ds18b20Setup (const int pinBase, const char *deviceId)
   node = wiringPiNewNode (pinBase, 1) ;
 
   node->fd         = fd ;
+  node->data0      = slot ;
   node->analogRead = myAnalogRead ;
 
+  ds18b20Probes [slot].fd      = fd ;
+  ds18b20Probes [slot].pinBase = pinBase ;
+  ds18b20Probes [slot].temp    = 0 ;
+  ds18b20Probes [slot].readAt  = 0 ;
+
   return TRUE ;
 }
@@ -29,6 +29,13 @@ extern "C" {
 
 extern int ds18b20Setup (const int pinBase, const char *serialNum) ;
 
+// Interface V3.17 - background conversion over every probe at once,
+//	with analogRead served from the cache
+
+extern int ds18b20ManagerStart (unsigned int intervalMs) ;
+extern int ds18b20ManagerStop  (void) ;
+extern int ds18b20Read (const int pinBase, int *temp, unsigned int *ageMs) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,433 @@
+/*
+ * gpioChip.c:
+ *	Extend wiringPi with any extra kernel gpiochip character device
+ *	(HAT GPIO expanders on CM carriers, FPGA fabric pins, etc.) so
+ *	that all kernel-visible GPIO is reachable through the one
+ *	wiringPi pin namespace.
+ *
+ *	All lines of a chip live in a single V2 line request, so a
+ *	single-pin read or write is one GET/SET_VALUES ioctl on a cached
+ *	fd and digitalWriteBank()/digitalReadBank() move up to 64 lines
+ *	in that same single ioctl. The request is (re)built only when a
+ *	new line is first used or a line's configuration changes.
+ *
+ *	Copyright (c) 2012-2026 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include <wiringPi.h>
+
+#include "gpioChip.h"
+
+#define	MAX_GPIO_CHIPS	8
+
+struct gpioChip
+{
+  int chipFd ;				// The /dev/gpiochipN device, -1 when free
+  int reqFd ;				// The one live line request, -1 until first use
+  int lines ;				// Lines on the chip (capped at GPIO_V2_LINES_MAX)
+  int slot     [GPIO_V2_LINES_MAX] ;	// Line -> offsets[] index, -1 if unused
+  uint64_t flags [GPIO_V2_LINES_MAX] ;	// V2 flags of each used line
+  uint64_t outBits ;			// Last value written to each output line
+} ;
+
+static struct gpioChip gpioChips [MAX_GPIO_CHIPS] =
+  { [0 ... MAX_GPIO_CHIPS - 1] = { .chipFd = -1, .reqFd = -1 } } ;
+
+
+/*
+ * rebuildRequest:
+ *	(Re)issue the chip's single line request covering every line used
+ *	so far. Lines with identical flags share one FLAGS attribute and
+ *	output lines get their last written values back via an
+ *	OUTPUT_VALUES attribute, so outputs don't glitch across a rebuild.
+ *	When no new line is being added the live request is mutated with
+ *	SET_CONFIG instead - no close, no glitch window at all.
+ *********************************************************************************
+ */
+
+static int rebuildRequest (struct gpioChip *chip, int newLine)
+{
+  struct gpio_v2_line_request req ;
+  struct gpio_v2_line_config_attribute *attr ;
+  uint64_t outMask, outVals ;
+  unsigned int a ;
+  int line, other, slot ;
+
+  memset (&req, 0, sizeof (req)) ;
+  strcpy (req.consumer, "wiringpi_gpio_req") ;
+
+  if (newLine >= 0)
+    chip->slot [newLine] = 0 ;		// reserve; real slot assigned below
+
+  slot = 0 ;
+  for (line = 0 ; line < chip->lines ; ++line)
+    if (chip->slot [line] >= 0)
+    {
+      chip->slot [line] = slot ;
+      req.offsets [slot] = line ;
+      ++slot ;
+    }
+  req.num_lines = slot ;
+
+// One FLAGS attribute per distinct flag value - the kernel allows at
+//	most GPIO_V2_LINE_NUM_ATTRS_MAX of them (one slot is kept back for
+//	the output values)
+
+  for (line = 0 ; line < chip->lines ; ++line)
+  {
+    if (chip->slot [line] < 0)
+      continue ;
+    for (other = 0 ; other < line ; ++other)
+      if ((chip->slot [other] >= 0) && (chip->flags [other] == chip->flags [line]))
+	break ;
+    if (other != line)			// flags already covered
+    {
+      attr = &req.config.attrs [0] ;
+      for (a = 0 ; a < req.config.num_attrs ; ++a)
+	if (req.config.attrs [a].attr.flags == chip->flags [line])
+	  attr = &req.config.attrs [a] ;
+      attr->mask |= 1ULL << chip->slot [line] ;
+      continue ;
+    }
+    if (req.config.num_attrs >= (GPIO_V2_LINE_NUM_ATTRS_MAX - 1))
+    {
+      fprintf (stderr, "gpioChip: Too many distinct line configurations on one chip\n") ;
+      return FALSE ;
+    }
+    attr = &req.config.attrs [req.config.num_attrs++] ;
+    attr->attr.id    = GPIO_V2_LINE_ATTR_ID_FLAGS ;
+    attr->attr.flags = chip->flags [line] ;
+    attr->mask       = 1ULL << chip->slot [line] ;
+  }
+
+  outMask = outVals = 0 ;
+  for (line = 0 ; line < chip->lines ; ++line)
+    if ((chip->slot [line] >= 0) && (chip->flags [line] & GPIO_V2_LINE_FLAG_OUTPUT))
+    {
+      outMask |= 1ULL << chip->slot [line] ;
+      if (chip->outBits & (1ULL << line))
+	outVals |= 1ULL << chip->slot [line] ;
+    }
+  if (outMask != 0)
+  {
+    attr = &req.config.attrs [req.config.num_attrs++] ;
+    attr->attr.id     = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES ;
+    attr->attr.values = outVals ;
+    attr->mask        = outMask ;
+  }
+
+  if ((newLine < 0) && (chip->reqFd >= 0))	// config change only
+  {
+    if (ioctl (chip->reqFd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &req.config) == 0)
+      return TRUE ;
+    close (chip->reqFd) ;			// kernel said no - fresh request
+    chip->reqFd = -1 ;
+  }
+
+  if (chip->reqFd >= 0)				// lines are exclusive: release before re-request
+  {
+    close (chip->reqFd) ;
+    chip->reqFd = -1 ;
+  }
+
+  if ((ioctl (chip->chipFd, GPIO_V2_GET_LINE_IOCTL, &req) != 0) || (req.fd < 0))
+  {
+    fprintf (stderr, "gpioChip: Unable to request lines: %s\n", strerror (errno)) ;
+    if (newLine >= 0)
+      chip->slot [newLine] = -1 ;
+    return FALSE ;
+  }
+
+  chip->reqFd = req.fd ;
+  return TRUE ;
+}
+
+
+/*
+ * ensureLine:
+ *	Make sure a line is part of the request with the wanted flags,
+ *	adding or reconfiguring it as needed.
+ *********************************************************************************
+ */
+
+static int ensureLine (struct gpioChip *chip, int line, uint64_t flags)
+{
+  if ((chip->slot [line] >= 0) && (chip->flags [line] == flags))
+    return TRUE ;
+
+  chip->flags [line] = flags ;
+  return rebuildRequest (chip, (chip->slot [line] < 0) ? line : -1) ;
+}
+
+
+/*
+ * myPinMode:
+ *********************************************************************************
+ */
+
+static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  struct gpioChip *chip = &gpioChips [node->data0] ;
+  int line = pin - node->pinBase ;
+  uint64_t flags ;
+
+  flags = chip->flags [line] & (GPIO_V2_LINE_FLAG_BIAS_PULL_UP | GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN | GPIO_V2_LINE_FLAG_BIAS_DISABLED) ;
+
+  if (mode == OUTPUT)
+    flags |= GPIO_V2_LINE_FLAG_OUTPUT ;
+  else
+    flags |= GPIO_V2_LINE_FLAG_INPUT ;
+
+  (void)ensureLine (chip, line, flags) ;
+}
+
+
+/*
+ * myPullUpDnControl:
+ *********************************************************************************
+ */
+
+static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  struct gpioChip *chip = &gpioChips [node->data0] ;
+  int line = pin - node->pinBase ;
+  uint64_t flags ;
+
+  flags = chip->flags [line] & ~(uint64_t)(GPIO_V2_LINE_FLAG_BIAS_PULL_UP | GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN | GPIO_V2_LINE_FLAG_BIAS_DISABLED) ;
+  if ((flags & (GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_OUTPUT)) == 0)
+    flags |= GPIO_V2_LINE_FLAG_INPUT ;
+
+  /**/ if (mode == PUD_UP)
+    flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP ;
+  else if (mode == PUD_DOWN)
+    flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN ;
+  else
+    flags |= GPIO_V2_LINE_FLAG_BIAS_DISABLED ;
+
+  (void)ensureLine (chip, line, flags) ;
+}
+
+
+/*
+ * myDigitalRead:
+ *********************************************************************************
+ */
+
+static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
+{
+  struct gpioChip *chip = &gpioChips [node->data0] ;
+  struct gpio_v2_line_values lv ;
+  int line = pin - node->pinBase ;
+
+  if (chip->slot [line] < 0)
+    if (!ensureLine (chip, line, chip->flags [line] | GPIO_V2_LINE_FLAG_INPUT))
+      return LOW ;
+
+  lv.mask = 1ULL << chip->slot [line] ;
+  lv.bits = 0 ;
+  if (ioctl (chip->reqFd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lv) != 0)
+    return LOW ;
+
+  return (lv.bits & (1ULL << chip->slot [line])) ? HIGH : LOW ;
+}
+
+
+/*
+ * myDigitalWrite:
+ *********************************************************************************
+ */
+
+static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  struct gpioChip *chip = &gpioChips [node->data0] ;
+  struct gpio_v2_line_values lv ;
+  int line = pin - node->pinBase ;
+
+  if ((chip->slot [line] < 0) || !(chip->flags [line] & GPIO_V2_LINE_FLAG_OUTPUT))
+  {
+    uint64_t flags = chip->flags [line] & ~(uint64_t)GPIO_V2_LINE_FLAG_INPUT ;
+    if (!ensureLine (chip, line, flags | GPIO_V2_LINE_FLAG_OUTPUT))
+      return ;
+  }
+
+  if (value == LOW)
+    chip->outBits &= ~(1ULL << line) ;
+  else
+    chip->outBits |=   1ULL << line ;
+
+  lv.mask = 1ULL << chip->slot [line] ;
+  lv.bits = (value == LOW) ? 0 : lv.mask ;
+  (void)ioctl (chip->reqFd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lv) ;
+}
+
+
+/*
+ * myDigitalWriteBank:
+ *	Bit N of the mask is pin (pinBase + N) - every masked line goes
+ *	out in a single SET_VALUES ioctl.
+ *********************************************************************************
+ */
+
+static void myDigitalWriteBank (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int values)
+{
+  struct gpioChip *chip = &gpioChips [node->data0] ;
+  struct gpio_v2_line_values lv ;
+  int line ;
+
+  for (line = 0 ; line < chip->lines ; ++line)		// settles after the first call
+    if ((mask & (1U << line)) && ((chip->slot [line] < 0) || !(chip->flags [line] & GPIO_V2_LINE_FLAG_OUTPUT)))
+      myDigitalWrite (node, node->pinBase + line, (values & (1U << line)) ? HIGH : LOW) ;
+
+  lv.mask = lv.bits = 0 ;
+  for (line = 0 ; line < chip->lines ; ++line)
+    if (mask & (1U << line))
+    {
+      lv.mask |= 1ULL << chip->slot [line] ;
+      if (values & (1U << line))
+      {
+	lv.bits       |= 1ULL << chip->slot [line] ;
+	chip->outBits |= 1ULL << line ;
+      }
+      else
+	chip->outBits &= ~(1ULL << line) ;
+    }
+
+  if (lv.mask != 0)
+    (void)ioctl (chip->reqFd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lv) ;
+}
+
+
+/*
+ * myDigitalReadBank:
+ *	As above: one GET_VALUES ioctl covers every masked line.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadBank (struct wiringPiNodeStruct *node, unsigned int mask)
+{
+  struct gpioChip *chip = &gpioChips [node->data0] ;
+  struct gpio_v2_line_values lv ;
+  unsigned int result ;
+  int line ;
+
+  for (line = 0 ; line < chip->lines ; ++line)
+    if ((mask & (1U << line)) && (chip->slot [line] < 0))
+      if (!ensureLine (chip, line, GPIO_V2_LINE_FLAG_INPUT))
+	mask &= ~(1U << line) ;
+
+  lv.mask = lv.bits = 0 ;
+  for (line = 0 ; line < chip->lines ; ++line)
+    if (mask & (1U << line))
+      lv.mask |= 1ULL << chip->slot [line] ;
+
+  if ((lv.mask == 0) || (ioctl (chip->reqFd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lv) != 0))
+    return 0 ;
+
+  result = 0 ;
+  for (line = 0 ; line < chip->lines ; ++line)
+    if ((mask & (1U << line)) && (lv.bits & (1ULL << chip->slot [line])))
+      result |= 1U << line ;
+
+  return result ;
+}
+
+
+/*
+ * wiringPiAttachChip:
+ *	Map an extra kernel gpiochip character device into the wiringPi
+ *	extension pin space at pinBase - one extension pin per line.
+ *********************************************************************************
+ */
+
+int wiringPiAttachChip (const char *device, const int pinBase)
+{
+  struct wiringPiNodeStruct *node ;
+  struct gpiochip_info info ;
+  struct gpioChip *chip ;
+  int chipNum, fd, lines, line ;
+
+  for (chipNum = 0 ; chipNum < MAX_GPIO_CHIPS ; ++chipNum)
+    if (gpioChips [chipNum].chipFd < 0)
+      break ;
+
+  if (chipNum == MAX_GPIO_CHIPS)
+  {
+    fprintf (stderr, "gpioChip: Too many attached chips (max %d)\n", MAX_GPIO_CHIPS) ;
+    return FALSE ;
+  }
+
+  if ((fd = open (device, O_RDWR)) < 0)
+  {
+    fprintf (stderr, "gpioChip: Unable to open %s: %s\n", device, strerror (errno)) ;
+    return FALSE ;
+  }
+
+  memset (&info, 0, sizeof (info)) ;
+  if (ioctl (fd, GPIO_GET_CHIPINFO_IOCTL, &info) != 0)
+  {
+    fprintf (stderr, "gpioChip: %s: Not a gpiochip device: %s\n", device, strerror (errno)) ;
+    close (fd) ;
+    return FALSE ;
+  }
+
+  lines = (int)info.lines ;
+  if (lines > GPIO_V2_LINES_MAX)	// one V2 request covers at most 64 lines
+    lines = GPIO_V2_LINES_MAX ;
+
+  node = wiringPiNewNode (pinBase, lines) ;
+  if (node == NULL)
+  {
+    close (fd) ;
+    return FALSE ;
+  }
+
+  chip = &gpioChips [chipNum] ;
+  chip->chipFd  = fd ;
+  chip->reqFd   = -1 ;
+  chip->lines   = lines ;
+  chip->outBits = 0 ;
+  for (line = 0 ; line < GPIO_V2_LINES_MAX ; ++line)
+  {
+    chip->slot  [line] = -1 ;
+    chip->flags [line] = 0 ;
+  }
+
+  node->fd              = fd ;
+  node->data0           = (unsigned int)chipNum ;
+  node->pinMode         = myPinMode ;
+  node->pullUpDnControl = myPullUpDnControl ;
+  node->digitalRead     = myDigitalRead ;
+  node->digitalWrite    = myDigitalWrite ;
+
+  node->digitalWriteBank = myDigitalWriteBank ;
+  node->digitalReadBank  = myDigitalReadBank ;
+
+  return TRUE ;
+}
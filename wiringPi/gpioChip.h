@@ -0,0 +1,36 @@
+/*
+ * gpioChip.h:
+ *	Extend wiringPi with extra kernel gpiochip character devices
+ *	Copyright (c) 2012-2026 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interface V3.17 - map another /dev/gpiochipN into the extension pin
+//	space, one pin per line, batched bank operations included
+
+extern int wiringPiAttachChip (const char *device, const int pinBase) ;
+
+#ifdef __cplusplus
+}
+#endif
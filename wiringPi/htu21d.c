@@ -27,6 +27,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
 
 #include "wiringPi.h"
 #include "wiringPiI2C.h"
@@ -38,76 +39,142 @@
 
 #define	I2C_ADDRESS	0x40
 
-int checksum (UNU uint8_t data [4])
+// The measurement commands - no-hold master, so the chip releases the
+//	bus while it converts and simply NACKs reads until it's done
+
+#define	HTU21D_TRIG_TEMP	0xF3
+#define	HTU21D_TRIG_HUMID	0xF5
+
+// Conversion times from the data sheet - typical and maximum
+
+#define	HTU21D_TEMP_TYP_MS	44
+#define	HTU21D_TEMP_MAX_MS	50
+#define	HTU21D_HUMID_TYP_MS	14
+#define	HTU21D_HUMID_MAX_MS	16
+
+// One trigger measures both values; reads inside this window are served
+//	from the cache rather than re-converting
+
+#define	HTU21D_CACHE_MS		500
+
+static int cTemp, cHumid ;
+static unsigned long long cacheAt = 0 ;
+
+
+static unsigned long long htu21dNow (void)
 {
-  return TRUE ;
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (unsigned long long)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL ;
 }
 
 
+/*
+ * checksum:
+ *	The chip appends a CRC-8 (x^8 + x^5 + x^4 + 1) over the two data
+ *	bytes; a remainder of zero over all three means a clean transfer.
+ *********************************************************************************
+ */
+
+int checksum (uint8_t data [4])
+{
+  uint32_t rem = ((uint32_t)data [0] << 16) | ((uint32_t)data [1] << 8) | data [2] ;
+  uint32_t div = 0x988000 ;	// The polynomial, lined up with bit 23
+  int i ;
+
+  for (i = 0 ; i < 16 ; ++i)
+  {
+    if (rem & (1UL << (23 - i)))
+      rem ^= div ;
+    div >>= 1 ;
+  }
+
+  return (rem == 0) ? TRUE : FALSE ;
+}
+
 
 /*
- * myAnalogRead:
+ * htu21dMeasure:
+ *	Run one no-hold conversion: trigger it, sleep the typical time with
+ *	the bus free, then poll for the result - the chip NACKs the read
+ *	until it's ready. Returns 0 with the raw value, or a -999x code.
  *********************************************************************************
  */
 
-static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+static int htu21dMeasure (int fd, uint8_t cmd, unsigned int typMs, unsigned int maxMs, uint32_t *raw)
 {
-  int chan = pin - node->pinBase ;
-  int fd   = node->fd ;
   uint8_t data [4] ;
-  uint32_t sTemp, sHumid ;
-  double   fTemp, fHumid ;
-  int      cTemp, cHumid ;
+  unsigned int waited ;
+
+  data [0] = cmd ;
+  if (write (fd, data, 1) != 1)
+    return -9999 ;
+
+  delay (typMs) ;
 
-  if (chan == 0)  // Read Temperature
+  for (waited = typMs ; read (fd, data, 3) != 3 ; ++waited)
   {
+    if (waited > (maxMs + 5))	// Something's wrong - it's given up
+      return -9998 ;
+    delay (1) ;
+  }
 
-// Send read temperature command:
+  if (!checksum (data))
+    return -9997 ;
 
-    data [0] = 0xF3 ;
-    if (write (fd, data, 1) != 1)
-      return -9999 ;
+  *raw = (data [0] << 8) | (data [1] & 0xFC) ;	// Low 2 bits are status
+  return 0 ;
+}
 
-// Wait then read the data
 
-    delay (50) ;
-    if (read (fd, data, 3) != 3)
-      return -9998 ;
+/*
+ * htu21dUpdate:
+ *	Refresh both cached values from one trigger pair
+ *********************************************************************************
+ */
 
-    if (!checksum (data))
-      return -9997 ;
+static int htu21dUpdate (int fd)
+{
+  uint32_t sTemp, sHumid ;
+  double   fTemp, fHumid ;
+  int      status ;
 
-// Do the calculation
+  if ((status = htu21dMeasure (fd, HTU21D_TRIG_TEMP, HTU21D_TEMP_TYP_MS, HTU21D_TEMP_MAX_MS, &sTemp)) < 0)
+    return status ;
 
-    sTemp = (data [0] << 8) | data [1] ;
-    fTemp = -48.85 + 175.72 * (double)sTemp / 63356.0 ;
-    cTemp = (int)rint (((100.0 * fTemp) + 0.5) / 10.0) ;
-    return cTemp ;
-  }
-  else if (chan == 1)	// humidity
-  {
-// Send read humidity command:
+  if ((status = htu21dMeasure (fd, HTU21D_TRIG_HUMID, HTU21D_HUMID_TYP_MS, HTU21D_HUMID_MAX_MS, &sHumid)) < 0)
+    return status ;
 
-    data [0] = 0xF5 ;
-    if (write (fd, data, 1) != 1)
-      return -9999 ;
+  fTemp = -46.85 + 175.72 * (double)sTemp / 65536.0 ;
+  cTemp = (int)rint (((100.0 * fTemp) + 0.5) / 10.0) ;
 
-// Wait then read the data
+  fHumid = -6.0 + 125.0 * (double)sHumid / 65536.0 ;
+  cHumid = (int)rint (((100.0 * fHumid) + 0.5) / 10.0) ;
 
-    delay (50) ;
-    if (read (fd, data, 3) != 3)
-      return -9998 ;
+  cacheAt = htu21dNow () ;
+  return 0 ;
+}
 
-    if (!checksum (data))
-      return -9997 ;
 
-    sHumid = (data [0] << 8) | data [1] ;
-    fHumid = -6.0 + 125.0 * (double)sHumid / 65536.0 ;
-    cHumid = (int)rint (((100.0 * fHumid) + 0.5) / 10.0) ;
-    return cHumid ;
-  }
-  else
+/*
+ * myAnalogRead:
+ *********************************************************************************
+ */
+
+static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+{
+  int chan = pin - node->pinBase ;
+  int status ;
+
+  if ((chan != 0) && (chan != 1))
     return -9999 ;
+
+  if ((cacheAt == 0) || ((htu21dNow () - cacheAt) > HTU21D_CACHE_MS))
+    if ((status = htu21dUpdate (node->fd)) < 0)
+      return status ;
+
+  return (chan == 0) ? cTemp : cHumid ;
 }
 
 
@@ -0,0 +1,364 @@
+/*
+ * matrixKeypad.c:
+ *	Scan a row/column switch matrix (keypads, button banks) from a
+ *	periodic task using whole-bank strobes instead of per-pin calls.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "wiringPi.h"
+#include "matrixKeypad.h"
+
+extern int ToBCMPin (int *pin) ;	// From wiringPi.c
+
+// A hand-rolled keypad loop makes rows*cols+rows pin calls per scan -
+//	at 200Hz through an I2C expander that's thousands of bus
+//	transactions a second for a keypad that's mostly idle. Here each
+//	row strobe is one digitalWriteMulti (on-board) or one node bank
+//	write, and all the columns come back in one read, so a 4x4 scan
+//	is 8 operations instead of 20 - and the debounce logic lives in
+//	one place instead of in every sketch.
+//
+// Wiring assumptions are the usual ones: rows are driven outputs,
+//	active low; columns are inputs with pull-ups, so a pressed key
+//	reads its strobed row's low on the column.
+
+#define	MATRIX_MAX_KEYPADS	4
+#define	MATRIX_SETTLE_US	5
+#define	MATRIX_DEFAULT_HZ	200
+#define	MATRIX_DEFAULT_SCANS	2
+
+// How one side (the row set or the column set) gets accessed: a single
+//	masked on-board operation, one extension-node bank transaction,
+//	or pin by pin when the set spans domains.
+
+#define	MATRIX_ONBOARD	0
+#define	MATRIX_NODE	1
+#define	MATRIX_SLOW	2
+
+struct matrixSide
+{
+  int mode ;
+  int numPins ;
+  int pins [MATRIX_MAX_PINS] ;			// As the caller numbered them
+  unsigned long long mask ;			// ONBOARD: whole side, BCM numbering
+  unsigned long long bit [MATRIX_MAX_PINS] ;	// ONBOARD: BCM bit per pin
+  int pinBase ;					// NODE
+  unsigned int bankMask ;			// NODE: bits relative to pinBase
+  unsigned int bankBit [MATRIX_MAX_PINS] ;
+} ;
+
+struct matrixKeypad
+{
+  int inUse ;
+  int task ;					// piPeriodic handle
+  struct matrixSide rows, cols ;
+  unsigned int debounceScans ;
+  uint8_t stable [MATRIX_MAX_PINS] ;		// Pressed columns per row
+  uint8_t count  [MATRIX_MAX_PINS][MATRIX_MAX_PINS] ;
+  void (*handler) (int row, int col, int pressed, void *userdata) ;
+  void *userdata ;
+} ;
+
+static struct matrixKeypad keypads [MATRIX_MAX_KEYPADS] ;
+
+
+/*
+ * matrixSideClassify:
+ *	Work out the fastest way to access a pin set: all on-board pins
+ *	become one BCM mask for the Multi calls, all pins on one
+ *	extension node become a bank mask (the bank wrappers fall back
+ *	pin by pin if the driver has no bank entry points), anything
+ *	mixed scans pin by pin.
+ *********************************************************************************
+ */
+
+static int matrixSideClassify (struct matrixSide *side, const int *pins, int numPins)
+{
+  struct wiringPiNodeStruct *node ;
+  int i, bcm, onBoard = TRUE, oneNode = TRUE ;
+
+  if ((numPins < 1) || (numPins > MATRIX_MAX_PINS))
+    return -1 ;
+
+  side->numPins = numPins ;
+  for (i = 0 ; i < numPins ; ++i)
+  {
+    side->pins [i] = pins [i] ;
+    if ((pins [i] & PI_GPIO_MASK) == 0)
+      oneNode = FALSE ;
+    else
+      onBoard = FALSE ;
+  }
+
+  if (onBoard)
+  {
+    side->mode = MATRIX_ONBOARD ;
+    side->mask = 0 ;
+    for (i = 0 ; i < numPins ; ++i)
+    {
+      bcm = pins [i] ;
+      if (!ToBCMPin (&bcm) || (bcm < 0))
+	return -1 ;
+      side->bit [i] = 1ULL << bcm ;
+      side->mask   |= side->bit [i] ;
+    }
+    return 0 ;
+  }
+
+  if (oneNode && ((node = wiringPiFindNode (pins [0])) != NULL))
+  {
+    for (i = 1 ; i < numPins ; ++i)
+      if ((pins [i] < node->pinBase) || (pins [i] > node->pinMax))
+	oneNode = FALSE ;
+
+    if (oneNode)
+    {
+      side->mode     = MATRIX_NODE ;
+      side->pinBase  = node->pinBase ;
+      side->bankMask = 0 ;
+      for (i = 0 ; i < numPins ; ++i)
+      {
+	side->bankBit [i] = 1u << (pins [i] - node->pinBase) ;
+	side->bankMask   |= side->bankBit [i] ;
+      }
+      return 0 ;
+    }
+  }
+
+  side->mode = MATRIX_SLOW ;
+  return 0 ;
+}
+
+
+/*
+ * matrixStrobe:
+ *	Drive one row low and the rest high in a single operation
+ *	(activeRow -1: everything high - the idle state).
+ *********************************************************************************
+ */
+
+static void matrixStrobe (struct matrixKeypad *kp, int activeRow)
+{
+  struct matrixSide *rows = &kp->rows ;
+  int i ;
+
+  switch (rows->mode)
+  {
+    case MATRIX_ONBOARD:
+      digitalWriteMulti (rows->mask, (activeRow < 0) ? rows->mask : (rows->mask & ~rows->bit [activeRow])) ;
+      break ;
+
+    case MATRIX_NODE:
+      digitalWriteBank (rows->pinBase, rows->bankMask,
+		(activeRow < 0) ? rows->bankMask : (rows->bankMask & ~rows->bankBit [activeRow])) ;
+      break ;
+
+    default:
+      for (i = 0 ; i < rows->numPins ; ++i)
+	digitalWrite (rows->pins [i], (i == activeRow) ? LOW : HIGH) ;
+      break ;
+  }
+}
+
+
+/*
+ * matrixReadCols:
+ *	Sample every column at once - returns a bitmask of the pressed
+ *	(low) columns, or -1 if the bulk read failed this scan.
+ *********************************************************************************
+ */
+
+static int matrixReadCols (struct matrixKeypad *kp)
+{
+  struct matrixSide *cols = &kp->cols ;
+  unsigned long long levels ;
+  unsigned int bank ;
+  int i, sample = 0 ;
+
+  switch (cols->mode)
+  {
+    case MATRIX_ONBOARD:
+      if (digitalReadMulti (cols->mask, &levels) < 0)
+	return -1 ;
+      for (i = 0 ; i < cols->numPins ; ++i)
+	if ((levels & cols->bit [i]) == 0)
+	  sample |= 1 << i ;
+      break ;
+
+    case MATRIX_NODE:
+      bank = digitalReadBank (cols->pinBase, cols->bankMask) ;
+      for (i = 0 ; i < cols->numPins ; ++i)
+	if ((bank & cols->bankBit [i]) == 0)
+	  sample |= 1 << i ;
+      break ;
+
+    default:
+      for (i = 0 ; i < cols->numPins ; ++i)
+	if (digitalRead (cols->pins [i]) == LOW)
+	  sample |= 1 << i ;
+      break ;
+  }
+
+  return sample ;
+}
+
+
+/*
+ * matrixScanTask:
+ *	One full scan - runs from the piPeriodic worker. A change has to
+ *	hold for debounceScans consecutive scans before it's committed
+ *	and reported, so contact bounce shorter than that never reaches
+ *	the handler.
+ *********************************************************************************
+ */
+
+static void matrixScanTask (void *arg)
+{
+  struct matrixKeypad *kp = (struct matrixKeypad *)arg ;
+  int r, c, sample ;
+  uint8_t changed ;
+
+  for (r = 0 ; r < kp->rows.numPins ; ++r)
+  {
+    matrixStrobe (kp, r) ;
+    delayMicroseconds (MATRIX_SETTLE_US) ;
+
+    if ((sample = matrixReadCols (kp)) < 0)
+      continue ;
+
+    changed = (uint8_t)sample ^ kp->stable [r] ;
+    for (c = 0 ; c < kp->cols.numPins ; ++c)
+    {
+      if ((changed & (1 << c)) == 0)
+      {
+	kp->count [r][c] = 0 ;
+	continue ;
+      }
+      if (++kp->count [r][c] < kp->debounceScans)
+	continue ;
+
+      kp->count  [r][c] = 0 ;
+      kp->stable [r]   ^= 1 << c ;
+      if (kp->handler != NULL)
+	kp->handler (r, c, (kp->stable [r] >> c) & 1, kp->userdata) ;
+    }
+  }
+
+  matrixStrobe (kp, -1) ;	// Leave the bus and the rows idle
+}
+
+
+/*
+ * matrixKeypadCreate:
+ *	Set the pins up (rows: outputs, idle high; columns: inputs with
+ *	pull-ups), start the periodic scan and return a handle, or -1.
+ *********************************************************************************
+ */
+
+int matrixKeypadCreate (const int *rowPins, int numRows, const int *colPins, int numCols,
+	void (*handler)(int row, int col, int pressed, void *userdata), void *userdata,
+	unsigned int scanHz, unsigned int debounceScans)
+{
+  struct matrixKeypad *kp = NULL ;
+  int i, handle ;
+
+  for (handle = 0 ; handle < MATRIX_MAX_KEYPADS ; ++handle)
+    if (!keypads [handle].inUse)
+    {
+      kp = &keypads [handle] ;
+      break ;
+    }
+  if (kp == NULL)
+    return -1 ;
+
+  memset (kp, 0, sizeof (*kp)) ;
+  if ((matrixSideClassify (&kp->rows, rowPins, numRows) < 0) ||
+      (matrixSideClassify (&kp->cols, colPins, numCols) < 0))
+    return -1 ;
+
+  if (scanHz == 0)
+    scanHz = MATRIX_DEFAULT_HZ ;
+  else if (scanHz > 1000)
+    scanHz = 1000 ;
+
+  kp->debounceScans = (debounceScans == 0) ? MATRIX_DEFAULT_SCANS : debounceScans ;
+  kp->handler       = handler ;
+  kp->userdata      = userdata ;
+
+  for (i = 0 ; i < numRows ; ++i)
+    pinMode (rowPins [i], OUTPUT) ;
+  for (i = 0 ; i < numCols ; ++i)
+  {
+    pinMode         (colPins [i], INPUT) ;
+    pullUpDnControl (colPins [i], PUD_UP) ;
+  }
+  matrixStrobe (kp, -1) ;
+
+  kp->inUse = TRUE ;
+  if ((kp->task = piPeriodicCreate (1000000 / scanHz, matrixScanTask, kp, 0)) < 0)
+  {
+    kp->inUse = FALSE ;
+    return -1 ;
+  }
+
+  return handle ;
+}
+
+
+/*
+ * matrixKeypadState:
+ *	The debounced state of one row - bit N set while (row, N) is
+ *	held - for callers that would rather poll than take callbacks.
+ *********************************************************************************
+ */
+
+unsigned int matrixKeypadState (int handle, int row)
+{
+  if ((handle < 0) || (handle >= MATRIX_MAX_KEYPADS) || !keypads [handle].inUse)
+    return 0 ;
+  if ((row < 0) || (row >= keypads [handle].rows.numPins))
+    return 0 ;
+
+  return keypads [handle].stable [row] ;
+}
+
+
+/*
+ * matrixKeypadStop:
+ *	Stop the scan task and leave the rows idle.
+ *********************************************************************************
+ */
+
+void matrixKeypadStop (int handle)
+{
+  struct matrixKeypad *kp ;
+
+  if ((handle < 0) || (handle >= MATRIX_MAX_KEYPADS) || !keypads [handle].inUse)
+    return ;
+
+  kp = &keypads [handle] ;
+  piPeriodicDestroy (kp->task) ;
+  matrixStrobe (kp, -1) ;
+  kp->inUse = FALSE ;
+}
@@ -0,0 +1,47 @@
+/*
+ * matrixKeypad.h:
+ *	Scan a row/column switch matrix (keypads, button banks) from a
+ *	periodic task using whole-bank strobes.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#define	MATRIX_MAX_PINS		8	// Rows and columns each
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All Interface V3.17. The handler runs on the scanner's periodic task
+//	thread with pressed 1 on key-down, 0 on key-up, after debouncing.
+//	debounceScans is how many consecutive scans a change must survive
+//	(0: a sensible default), scanHz the scan rate (0: 200).
+
+extern int matrixKeypadCreate (const int *rowPins, int numRows,
+		const int *colPins, int numCols,
+		void (*handler)(int row, int col, int pressed, void *userdata), void *userdata,
+		unsigned int scanHz, unsigned int debounceScans) ;
+
+extern unsigned int matrixKeypadState (int handle, int row) ;
+extern void         matrixKeypadStop  (int handle) ;
+
+#ifdef __cplusplus
+}
+#endif
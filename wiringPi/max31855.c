@@ -24,21 +24,52 @@
 
 #include <byteswap.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
 
 #include "max31855.h"
 
-static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+// Daisy-chained readout:
+//	The chips chain DO to the next DIN, so N devices deliver N 32-bit
+//	frames in one chip-select cycle. One scan caches every frame; the
+//	chips convert continuously at ~10Hz anyway, so reads inside the
+//	window below can't see fresher data than the cache holds.
+
+#define	MAX31855_MAX_CHAINS	2	// One per CE pin
+#define	MAX31855_MAX_CHIPS	16
+#define	MAX31855_CACHE_MS	50
+
+struct max31855Chain
 {
-  uint32_t spiData ;
-  int temp ;
-  int chan = pin - node->pinBase ;
+  int count ;
+  uint32_t frames [MAX31855_MAX_CHIPS] ;
+  unsigned long long readAt ;		// Monotonic mS; 0: never
+} ;
 
-  wiringPiSPIDataRW (node->fd, (unsigned char *)&spiData, 4) ;
+static struct max31855Chain max31855Chains [MAX31855_MAX_CHAINS] ;
+static int max31855ChainsUsed = 0 ;
 
-  spiData = __bswap_32(spiData) ;
+
+static unsigned long long max31855Now (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (unsigned long long)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL ;
+}
+
+
+/*
+ * max31855Decode:
+ *	Turn one 32-bit frame into the value for a device's channel
+ *********************************************************************************
+ */
+
+static int max31855Decode (uint32_t spiData, int chan)
+{
+  int temp ;
 
   switch (chan)
   {
@@ -76,6 +107,66 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
+{
+  uint32_t spiData ;
+  int chan = pin - node->pinBase ;
+
+  wiringPiSPIDataRW (node->fd, (unsigned char *)&spiData, 4) ;
+
+  spiData = __bswap_32(spiData) ;
+
+  return max31855Decode (spiData, chan) ;
+}
+
+
+/*
+ * maxChainScan:
+ *	Clock every chip's frame out in one transfer, unless the cache is
+ *	still inside its window
+ *********************************************************************************
+ */
+
+static void maxChainScan (struct wiringPiNodeStruct *node)
+{
+  struct max31855Chain *chain = &max31855Chains [node->data0] ;
+  unsigned char buffer [MAX31855_MAX_CHIPS * 4] ;
+  unsigned long long now = max31855Now () ;
+  int i ;
+
+  if ((chain->readAt != 0) && ((now - chain->readAt) <= MAX31855_CACHE_MS))
+    return ;
+
+  wiringPiSPIDataRW (node->fd, buffer, chain->count * 4) ;
+
+// The chip nearest our MISO delivers its frame first
+
+  for (i = 0 ; i < chain->count ; ++i)
+    chain->frames [i] = ((uint32_t)buffer [i * 4 + 0] << 24) | ((uint32_t)buffer [i * 4 + 1] << 16) |
+			((uint32_t)buffer [i * 4 + 2] <<  8) |  (uint32_t)buffer [i * 4 + 3] ;
+
+  chain->readAt = now ;
+}
+
+
+/*
+ * myChainAnalogRead:
+ *	Each device gets the same 4 channels as a single chip - so pin
+ *	pinBase + device * 4 + chan.
+ *********************************************************************************
+ */
+
+static int myChainAnalogRead (struct wiringPiNodeStruct *node, int pin)
+{
+  int chan   = pin - node->pinBase ;
+  int device = chan >> 2 ;
+
+  maxChainScan (node) ;
+
+  return max31855Decode (max31855Chains [node->data0].frames [device], chan & 3) ;
+}
+
+
 /*
  * max31855Setup:
  *	Create a new wiringPi device node for an max31855 on the Pi's
@@ -97,3 +188,73 @@ int max31855Setup (const int pinBase, int spiChannel)
 
   return TRUE ;
 }
+
+
+/*
+ * max31855ChainSetup:
+ *	Create one node for count daisy-chained max31855's on an SPI
+ *	channel. Every scan clocks all the frames out in a single
+ *	chip-select cycle and caches them, so reading all the junction
+ *	temperatures costs one SPI transaction rather than one per chip.
+ *********************************************************************************
+ */
+
+int max31855ChainSetup (const int pinBase, int spiChannel, int count)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((count < 1) || (count > MAX31855_MAX_CHIPS))
+    return FALSE ;
+
+  if (max31855ChainsUsed >= MAX31855_MAX_CHAINS)
+    return FALSE ;
+
+  if (wiringPiSPISetup (spiChannel, 5000000) < 0)	// 5MHz - prob 4 on the Pi
+    return FALSE ;
+
+  node = wiringPiNewNode (pinBase, count * 4) ;
+
+  node->fd         = spiChannel ;
+  node->data0      = max31855ChainsUsed ;
+  node->analogRead = myChainAnalogRead ;
+
+  max31855Chains [max31855ChainsUsed].count  = count ;
+  max31855Chains [max31855ChainsUsed].readAt = 0 ;
+  ++max31855ChainsUsed ;
+
+  return TRUE ;
+}
+
+
+/*
+ * max31855ColdJunction:
+ *	The cold-junction (internal) temperature of one chip in a chain,
+ *	in C * 100, from the cached frame. Returns -9999 on a bad device
+ *	number or pinBase.
+ *********************************************************************************
+ */
+
+int max31855ColdJunction (const int pinBase, int device)
+{
+  struct wiringPiNodeStruct *node = wiringPiFindNode (pinBase) ;
+  int temp ;
+  uint32_t frame ;
+
+  if ((node == NULL) || (node->analogRead != myChainAnalogRead))
+    return -9999 ;
+
+  if ((device < 0) || (device >= max31855Chains [node->data0].count))
+    return -9999 ;
+
+  maxChainScan (node) ;
+
+  frame = max31855Chains [node->data0].frames [device] ;
+
+// Bits 15-4: internal temperature, 12-bit signed, 0.0625C per LSB
+
+  temp = (frame >> 4) & 0x7FF ;
+  if ((frame & 0x8000) != 0)
+    temp = -temp ;
+
+  return (temp * 25) / 4 ;
+}
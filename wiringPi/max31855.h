@@ -27,6 +27,8 @@ extern "C" {
 #endif
 
 extern int max31855Setup (int pinBase, int spiChannel) ;
+extern int max31855ChainSetup (const int pinBase, int spiChannel, int count) ;	// Interface 3.17
+extern int max31855ColdJunction (const int pinBase, int device) ;		// Interface 3.17, C * 100
 
 #ifdef __cplusplus
 }
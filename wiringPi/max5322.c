@@ -22,6 +22,11 @@
  ***********************************************************************
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
 
@@ -53,6 +58,198 @@ static void myAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
   wiringPiSPIDataRW (node->fd, spiData, 2) ;
 }
 
+
+/*
+ * The waveform streamer:
+ *	A worker thread feeds pre-encoded DAC frames to the chip in
+ *	batches of one SPI_IOC_MESSAGE(N) each. Pacing is done inside the
+ *	kernel with the per-segment inter-frame delay, with the worker
+ *	re-synchronising to an absolute deadline at every batch boundary
+ *	so timing errors can't accumulate over a long (or looped) run.
+ *********************************************************************************
+ */
+
+#define	MAX5322_MAX_WAVES	4
+#define	MAX5322_WAVE_BATCH	WPI_SPI_MAX_SEGMENTS
+#define	MAX5322_FRAME_US	2	// 16 bits at the 8MHz setup clock
+
+struct max5322Wave
+{
+  int active ;			// slot in use
+  volatile int stop ;
+  int loop ;
+  int pin ;
+  int spiChannel ;
+  unsigned char (*frames)[2] ;	// pre-encoded, one per sample
+  int n ;
+  unsigned int periodUs ;
+  pthread_t thread ;
+} ;
+
+static struct max5322Wave max5322Waves [MAX5322_MAX_WAVES] ;
+static pthread_mutex_t max5322WaveLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static void *max5322WaveWorker (void *arg)
+{
+  struct max5322Wave *wave = (struct max5322Wave *)arg ;
+  struct wiringPiSPISegment segments [MAX5322_WAVE_BATCH] ;
+  struct timespec deadline ;
+  unsigned int delayUs ;
+  int at, i, batch ;
+
+  delayUs = (wave->periodUs > MAX5322_FRAME_US) ? wave->periodUs - MAX5322_FRAME_US : 1 ;
+  if (delayUs > 65535)			// spi_ioc_transfer delay is 16-bit;
+    delayUs = 65535 ;			//  the deadline sleep paces the rest
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline) ;
+
+  do
+  {
+    for (at = 0 ; (at < wave->n) && !wave->stop ; at += batch)
+    {
+      batch = wave->n - at ;
+      if (batch > MAX5322_WAVE_BATCH)
+	batch = MAX5322_WAVE_BATCH ;
+
+      memset (segments, 0, sizeof (segments [0]) * batch) ;
+      for (i = 0 ; i < batch ; ++i)
+      {
+	segments [i].txData   = wave->frames [at + i] ;
+	segments [i].len      = 2 ;
+	segments [i].delay    = delayUs ;
+	segments [i].csChange = 1 ;	// the DAC latches on CS rising
+      }
+
+      if (wiringPiSPIDataRWn (wave->spiChannel, segments, batch) < 0)
+	return NULL ;
+
+      deadline.tv_nsec += (long)batch * wave->periodUs * 1000L ;
+      while (deadline.tv_nsec >= 1000000000L)
+      {
+	deadline.tv_nsec -= 1000000000L ;
+	++deadline.tv_sec ;
+      }
+      clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) ;
+    }
+  } while (wave->loop && !wave->stop) ;
+
+  return NULL ;
+}
+
+
+/*
+ * max5322WaveStart:
+ *	Stream a sample buffer to one DAC channel at the given rate from
+ *	a worker thread - looped if asked to - leaving the calling thread
+ *	free. The samples are encoded into SPI frames up front and the
+ *	buffer is ours from here, so the caller's copy may go away.
+ *	Returns 0 when streaming, -1 on a bad pin/rate or if the pin is
+ *	already streaming (max5322WaveStop it first).
+ *********************************************************************************
+ */
+
+int max5322WaveStart (int pin, const uint16_t *samples, int numSamples, unsigned int rateHz, int loop)
+{
+  struct wiringPiNodeStruct *node ;
+  struct max5322Wave *wave = NULL ;
+  unsigned char chanBits ;
+  int slot, i, chan ;
+
+  if ((samples == NULL) || (numSamples < 1) || (rateHz == 0) || (rateHz > 500000))
+    return -1 ;
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return -1 ;
+  chan = pin - node->pinBase ;
+
+  pthread_mutex_lock (&max5322WaveLock) ;
+  for (slot = 0 ; slot < MAX5322_MAX_WAVES ; ++slot)
+  {
+    if (max5322Waves [slot].active && (max5322Waves [slot].pin == pin))
+    {
+      pthread_mutex_unlock (&max5322WaveLock) ;
+      return -1 ;			// already streaming on this pin
+    }
+    if (!max5322Waves [slot].active && (wave == NULL))
+      wave = &max5322Waves [slot] ;
+  }
+  if (wave == NULL)
+  {
+    pthread_mutex_unlock (&max5322WaveLock) ;
+    return -1 ;
+  }
+
+  if ((wave->frames = malloc ((size_t)numSamples * 2)) == NULL)
+  {
+    pthread_mutex_unlock (&max5322WaveLock) ;
+    return -1 ;
+  }
+
+  chanBits = (chan == 0) ? 0b01000000 : 0b01010000 ;
+  for (i = 0 ; i < numSamples ; ++i)
+  {
+    wave->frames [i][0] = chanBits | ((samples [i] >> 12) & 0x0F) ;
+    wave->frames [i][1] = samples [i] & 0xFF ;
+  }
+
+  wave->stop       = FALSE ;
+  wave->loop       = loop ;
+  wave->pin        = pin ;
+  wave->spiChannel = node->fd ;
+  wave->n          = numSamples ;
+  wave->periodUs   = 1000000 / rateHz ;
+
+  if (pthread_create (&wave->thread, NULL, max5322WaveWorker, wave) != 0)
+  {
+    free (wave->frames) ;
+    wave->frames = NULL ;
+    pthread_mutex_unlock (&max5322WaveLock) ;
+    return -1 ;
+  }
+  wave->active = TRUE ;
+  pthread_mutex_unlock (&max5322WaveLock) ;
+
+  return 0 ;
+}
+
+
+/*
+ * max5322WaveStop:
+ *	Stop the stream on a pin and wait for the worker to finish its
+ *	current batch. Also reaps a one-shot wave that has already played
+ *	out. Returns -1 if nothing was streaming there.
+ *********************************************************************************
+ */
+
+int max5322WaveStop (int pin)
+{
+  struct max5322Wave *wave = NULL ;
+  int slot ;
+
+  pthread_mutex_lock (&max5322WaveLock) ;
+  for (slot = 0 ; slot < MAX5322_MAX_WAVES ; ++slot)
+    if (max5322Waves [slot].active && (max5322Waves [slot].pin == pin))
+    {
+      wave = &max5322Waves [slot] ;
+      break ;
+    }
+  pthread_mutex_unlock (&max5322WaveLock) ;
+
+  if (wave == NULL)
+    return -1 ;
+
+  wave->stop = TRUE ;
+  pthread_join (wave->thread, NULL) ;
+
+  pthread_mutex_lock (&max5322WaveLock) ;
+  free (wave->frames) ;
+  wave->frames = NULL ;
+  wave->active = FALSE ;
+  pthread_mutex_unlock (&max5322WaveLock) ;
+
+  return 0 ;
+}
+
+
 /*
  * max5322Setup:
  *	Create a new wiringPi device node for an max5322 on the Pi's
@@ -22,12 +22,18 @@
  ***********************************************************************
  */
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern int max5322Setup (int pinBase, int spiChannel) ;
 
+//Interface 3.17 - buffered waveform streaming from a paced worker thread
+extern int max5322WaveStart (int pin, const uint16_t *samples, int numSamples, unsigned int rateHz, int loop) ;
+extern int max5322WaveStop  (int pin) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,9 +29,16 @@
 #include "wiringPiI2C.h"
 #include "mcp23x0817.h"
 
+#include "wpiExtensions.h"
 #include "mcp23008.h"
 
 
+// We shadow the writable registers so no access needs a read over the
+//	bus first: data2 holds the output latch, data0 IODIR and data1
+//	GPPU. The shadows are seeded from the chip at setup time and
+//	written through from then on.
+
+
 /*
  * myPinMode:
  *********************************************************************************
@@ -39,18 +46,18 @@
 
 static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old ;
 
-  reg  = MCP23x08_IODIR ;
   mask = 1 << (pin - node->pinBase) ;
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
+  old  = node->data0 ;		// IODIR shadow
 
   if (mode == OUTPUT)
     old &= (~mask) ;
   else
     old |=   mask ;
 
-  wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+  wiringPiI2CWriteReg8 (node->fd, MCP23x08_IODIR, old) ;
+  node->data0 = old ;
 }
 
 
@@ -61,19 +68,18 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 
 static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old ;
 
-  reg  = MCP23x08_GPPU ;
   mask = 1 << (pin - node->pinBase) ;
-
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
+  old  = node->data1 ;		// GPPU shadow
 
   if (mode == PUD_UP)
     old |=   mask ;
   else
     old &= (~mask) ;
 
-  wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+  wiringPiI2CWriteReg8 (node->fd, MCP23x08_GPPU, old) ;
+  node->data1 = old ;
 }
 
 
@@ -143,7 +149,18 @@ int mcp23008Setup (const int pinBase, const int i2cAddress)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
-  node->data2           = wiringPiI2CReadReg8 (fd, MCP23x08_OLAT) ;
+  if (wpiExtensionTrust)	// Power-on defaults: outputs low, all inputs, no pulls
+  {
+    node->data2 = 0 ;
+    node->data0 = 0xFF ;
+    node->data1 = 0 ;
+  }
+  else
+  {
+    node->data2 = wiringPiI2CReadReg8 (fd, MCP23x08_OLAT) ;
+    node->data0 = wiringPiI2CReadReg8 (fd, MCP23x08_IODIR) ;
+    node->data1 = wiringPiI2CReadReg8 (fd, MCP23x08_GPPU) ;
+  }
 
   return TRUE ;
 }
@@ -29,9 +29,17 @@
 #include "wiringPiI2C.h"
 #include "mcp23x0817.h"
 
+#include "wpiExtensions.h"
 #include "mcp23017.h"
 
 
+// We shadow the writable registers so no access needs a read over the
+//	bus first: data2/data3 hold the bank A/B output latches, and
+//	data0/data1 hold IODIR (bits 0-7) and GPPU (bits 8-15) for their
+//	bank. The shadows are seeded from the chip at setup time and
+//	written through from then on.
+
+
 /*
  * myPinMode:
  *********************************************************************************
@@ -39,11 +47,12 @@
 
 static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old, reg, bankA ;
 
   pin -= node->pinBase ;
 
-  if (pin < 8)		// Bank A
+  bankA = (pin < 8) ;
+  if (bankA)
     reg  = MCP23x17_IODIRA ;
   else
   {
@@ -52,7 +61,7 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
   }
 
   mask = 1 << pin ;
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
+  old  = (bankA ? node->data0 : node->data1) & 0xFF ;	// IODIR shadow
 
   if (mode == OUTPUT)
     old &= (~mask) ;
@@ -60,6 +69,10 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+  if (bankA)
+    node->data0 = (node->data0 & ~0xFFu) | old ;
+  else
+    node->data1 = (node->data1 & ~0xFFu) | old ;
 }
 
 
@@ -70,11 +83,12 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 
 static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old, reg, bankA ;
 
   pin -= node->pinBase ;
 
-  if (pin < 8)		// Bank A
+  bankA = (pin < 8) ;
+  if (bankA)
     reg  = MCP23x17_GPPUA ;
   else
   {
@@ -83,7 +97,7 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
   }
 
   mask = 1 << pin ;
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
+  old  = ((bankA ? node->data0 : node->data1) >> 8) & 0xFF ;	// GPPU shadow
 
   if (mode == PUD_UP)
     old |=   mask ;
@@ -91,6 +105,10 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
     old &= (~mask) ;
 
   wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+  if (bankA)
+    node->data0 = (node->data0 & ~0xFF00u) | (old << 8) ;
+  else
+    node->data1 = (node->data1 & ~0xFF00u) | (old << 8) ;
 }
 
 
@@ -163,6 +181,93 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+// Interrupt-driven input mirror: with the expander's INT line wired to
+//	a Pi pin, the chip tells us when an input changes and we keep a
+//	16-bit image of the port, so digitalRead becomes a memory load
+//	instead of an I2C register read - polling 16 inputs at 100Hz costs
+//	zero bus transactions while nothing changes.
+
+#define	MCP23017_MAX_IRQ	8
+
+struct mcp17IrqState
+{
+  struct wiringPiNodeStruct *node ;	// NULL marks a free slot
+  int intPin ;
+  volatile unsigned int image ;		// GPIOB in bits 8-15, GPIOA in 0-7
+} ;
+
+static struct mcp17IrqState mcp17Irqs [MCP23017_MAX_IRQ] ;
+
+
+/*
+ * mcp17IrqService:
+ *	Runs on the INT pin's ISR thread. Reading GPIO both captures the
+ *	current levels and releases the INT line; the INTF pass afterwards
+ *	catches a change that landed while we were on the bus, since that
+ *	one re-arms INT without the line ever going high.
+ *********************************************************************************
+ */
+
+static void mcp17IrqService (struct WPIWfiStatus wfiStatus, void *userdata)
+{
+  struct mcp17IrqState *s = (struct mcp17IrqState *)userdata ;
+  int a, b, pass ;
+
+  (void)wfiStatus ;
+
+  for (pass = 0 ; pass < 2 ; ++pass)
+  {
+    a = wiringPiI2CReadReg8 (s->node->fd, MCP23x17_GPIOA) ;
+    b = wiringPiI2CReadReg8 (s->node->fd, MCP23x17_GPIOB) ;
+    __atomic_store_n (&s->image, ((unsigned int)b << 8) | (unsigned int)a, __ATOMIC_RELEASE) ;
+
+    if ((wiringPiI2CReadReg8 (s->node->fd, MCP23x17_INTFA) == 0) &&
+	(wiringPiI2CReadReg8 (s->node->fd, MCP23x17_INTFB) == 0))
+      break ;
+  }
+}
+
+
+/*
+ * myDigitalReadIrq:
+ *	The mirrored read - one acquire load of the image kept fresh by
+ *	the INT service. Output pins read back their driven level, since
+ *	the image comes from GPIO, not INTCAP.
+ *********************************************************************************
+ */
+
+static int myDigitalReadIrq (struct wiringPiNodeStruct *node, int pin)
+{
+  int i ;
+
+  pin -= node->pinBase ;
+
+  for (i = 0 ; i < MCP23017_MAX_IRQ ; ++i)
+    if (mcp17Irqs [i].node == node)
+      return ((__atomic_load_n (&mcp17Irqs [i].image, __ATOMIC_ACQUIRE) >> pin) & 1) ? HIGH : LOW ;
+
+  return LOW ;
+}
+
+
+/*
+ * myPinModeIrq:
+ *	As myPinMode, but interrupt-on-change tracks the direction bits:
+ *	every input pin raises INT, outputs never do.
+ *********************************************************************************
+ */
+
+static void myPinModeIrq (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  myPinMode (node, pin, mode) ;
+
+  if ((pin - node->pinBase) < 8)
+    wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPINTENA, node->data0 & 0xFF) ;
+  else
+    wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPINTENB, node->data1 & 0xFF) ;
+}
+
+
 /*
  * mcp23017Setup:
  *	Create a new instance of an MCP23017 I2C GPIO interface. We know it
@@ -188,8 +293,89 @@ int mcp23017Setup (const int pinBase, const int i2cAddress)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
-  node->data2           = wiringPiI2CReadReg8 (fd, MCP23x17_OLATA) ;
-  node->data3           = wiringPiI2CReadReg8 (fd, MCP23x17_OLATB) ;
+  if (wpiExtensionTrust)	// Power-on defaults: outputs low, all inputs, no pulls
+  {
+    node->data2 = 0 ;
+    node->data3 = 0 ;
+    node->data0 = 0xFF ;
+    node->data1 = 0xFF ;
+  }
+  else
+  {
+    node->data2 = wiringPiI2CReadReg8 (fd, MCP23x17_OLATA) ;
+    node->data3 = wiringPiI2CReadReg8 (fd, MCP23x17_OLATB) ;
+    node->data0 = wiringPiI2CReadReg8 (fd, MCP23x17_IODIRA) | (wiringPiI2CReadReg8 (fd, MCP23x17_GPPUA) << 8) ;
+    node->data1 = wiringPiI2CReadReg8 (fd, MCP23x17_IODIRB) | (wiringPiI2CReadReg8 (fd, MCP23x17_GPPUB) << 8) ;
+  }
+
+  return TRUE ;
+}
+
+
+/*
+ * mcp23017SetupIrq:
+ *	As mcp23017Setup, but with the expander's INT output wired to a Pi
+ *	pin (current numbering). Both banks' interrupts are mirrored onto
+ *	the one line, every input pin raises it on change, and digitalRead
+ *	serves from the cached image - worst-case input latency drops from
+ *	a polling period to the I2C service time of one interrupt.
+ *********************************************************************************
+ */
+
+int mcp23017SetupIrq (const int pinBase, const int i2cAddress, const int intPin)
+{
+  struct wiringPiNodeStruct *node ;
+  struct mcp17IrqState *s = NULL ;
+  int i, fd, a, b ;
+
+  for (i = 0 ; i < MCP23017_MAX_IRQ ; ++i)
+    if (mcp17Irqs [i].node == NULL)
+    {
+      s = &mcp17Irqs [i] ;
+      break ;
+    }
+  if (s == NULL)
+    return FALSE ;
+
+  if (!mcp23017Setup (pinBase, i2cAddress))
+    return FALSE ;
+
+  node = wiringPiFindNode (pinBase) ;
+  fd   = node->fd ;
+
+// Both banks onto the one INT pin, interrupt on any change from the
+//	previous level (INTCON 0 compares against that, not DEFVAL), on
+//	every pin the direction shadows say is an input
+
+  wiringPiI2CWriteReg8 (fd, MCP23x17_IOCON,    IOCON_INIT | IOCON_MIRROR) ;
+  wiringPiI2CWriteReg8 (fd, MCP23x17_INTCONA,  0x00) ;
+  wiringPiI2CWriteReg8 (fd, MCP23x17_INTCONB,  0x00) ;
+  wiringPiI2CWriteReg8 (fd, MCP23x17_GPINTENA, node->data0 & 0xFF) ;
+  wiringPiI2CWriteReg8 (fd, MCP23x17_GPINTENB, node->data1 & 0xFF) ;
+
+// Seed the image - these reads also clear any interrupt already pending
+
+  a = wiringPiI2CReadReg8 (fd, MCP23x17_GPIOA) ;
+  b = wiringPiI2CReadReg8 (fd, MCP23x17_GPIOB) ;
+  s->image  = ((unsigned int)b << 8) | (unsigned int)a ;
+  s->intPin = intPin ;
+  __atomic_store_n (&s->node, node, __ATOMIC_RELEASE) ;	// publish before rerouting reads
+
+  node->pinMode     = myPinModeIrq ;
+  node->digitalRead = myDigitalReadIrq ;
+
+// INT is push-pull active-low by default, so idle-high with a falling
+//	edge per interrupt
+
+  pinMode          (intPin, INPUT) ;
+  pullUpDnControl  (intPin, PUD_UP) ;
+  if (wiringPiISR2 (intPin, INT_EDGE_FALLING, mcp17IrqService, 0, s) < 0)
+  {
+    node->pinMode     = myPinMode ;
+    node->digitalRead = myDigitalRead ;
+    s->node = NULL ;
+    return FALSE ;
+  }
 
   return TRUE ;
 }
@@ -26,7 +26,8 @@
 extern "C" {
 #endif
 
-extern int mcp23017Setup (const int pinBase, const int i2cAddress) ;
+extern int mcp23017Setup    (const int pinBase, const int i2cAddress) ;
+extern int mcp23017SetupIrq (const int pinBase, const int i2cAddress, const int intPin) ;	// Interface V3.17
 
 #ifdef __cplusplus
 }
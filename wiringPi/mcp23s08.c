@@ -29,6 +29,7 @@
 #include "wiringPiSPI.h"
 #include "mcp23x0817.h"
 
+#include "wpiExtensions.h"
 #include "mcp23s08.h"
 
 #define	MCP_SPEED	4000000
@@ -71,6 +72,13 @@ static uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg)
 }
 
 
+// We shadow the writable registers so no access needs a read over the
+//	bus first. data0/data1 carry the SPI port and device id, so the
+//	output latch shadow lives in data2 and data3 holds IODIR (bits
+//	0-7) and GPPU (bits 8-15). The shadows are seeded from the chip
+//	at setup time and written through from then on.
+
+
 /*
  * myPinMode:
  *********************************************************************************
@@ -78,18 +86,18 @@ static uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg)
 
 static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old ;
 
-  reg  = MCP23x08_IODIR ;
   mask = 1 << (pin - node->pinBase) ;
-  old  = readByte (node->data0, node->data1, reg) ;
+  old  = node->data3 & 0xFF ;		// IODIR shadow
 
   if (mode == OUTPUT)
     old &= (~mask) ;
   else
     old |=   mask ;
 
-  writeByte (node->data0, node->data1, reg, old) ;
+  writeByte (node->data0, node->data1, MCP23x08_IODIR, old) ;
+  node->data3 = (node->data3 & ~0xFFu) | old ;
 }
 
 
@@ -100,19 +108,18 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 
 static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old ;
 
-  reg  = MCP23x08_GPPU ;
   mask = 1 << (pin - node->pinBase) ;
-
-  old  = readByte (node->data0, node->data1, reg) ;
+  old  = (node->data3 >> 8) & 0xFF ;	// GPPU shadow
 
   if (mode == PUD_UP)
     old |=   mask ;
   else
     old &= (~mask) ;
 
-  writeByte (node->data0, node->data1, reg, old) ;
+  writeByte (node->data0, node->data1, MCP23x08_GPPU, old) ;
+  node->data3 = (node->data3 & ~0xFF00u) | (old << 8) ;
 }
 
 
@@ -182,7 +189,17 @@ int mcp23s08Setup (const int pinBase, const int spiPort, const int devId)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
-  node->data2           = readByte (spiPort, devId, MCP23x08_OLAT) ;
+  if (wpiExtensionTrust)	// Power-on defaults: outputs low, all inputs, no pulls
+  {
+    node->data2 = 0 ;
+    node->data3 = 0xFF ;
+  }
+  else
+  {
+    node->data2 = readByte (spiPort, devId, MCP23x08_OLAT) ;
+    node->data3 = readByte (spiPort, devId, MCP23x08_IODIR)
+		| (readByte (spiPort, devId, MCP23x08_GPPU) << 8) ;
+  }
 
   return TRUE ;
 }
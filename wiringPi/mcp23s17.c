@@ -29,6 +29,7 @@
 #include "wiringPiSPI.h"
 #include "mcp23x0817.h"
 
+#include "wpiExtensions.h"
 #include "mcp23s17.h"
 
 #define	MCP_SPEED	4000000
@@ -71,6 +72,47 @@ static uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg)
 }
 
 
+/*
+ * writeWord, readWord:
+ *	Access an A/B register pair in one 4-byte SPI frame. With
+ *	IOCON.BANK = 0 and SEQOP set (our IOCON_INIT) the chip's address
+ *	pointer toggles between the two registers of a pair, so the two
+ *	data bytes land in (or come from) the A then the B register.
+ *********************************************************************************
+ */
+
+static void writeWord (uint8_t spiPort, uint8_t devId, uint8_t reg, uint16_t data)
+{
+  uint8_t spiData [4] ;
+
+  spiData [0] = CMD_WRITE | ((devId & 7) << 1) ;
+  spiData [1] = reg ;
+  spiData [2] = data & 0xFF ;
+  spiData [3] = data >> 8 ;
+
+  wiringPiSPIDataRW (spiPort, spiData, 4) ;
+}
+
+static uint16_t readWord (uint8_t spiPort, uint8_t devId, uint8_t reg)
+{
+  uint8_t spiData [4] ;
+
+  spiData [0] = CMD_READ | ((devId & 7) << 1) ;
+  spiData [1] = reg ;
+
+  wiringPiSPIDataRW (spiPort, spiData, 4) ;
+
+  return spiData [2] | (spiData [3] << 8) ;
+}
+
+
+// We shadow the writable registers so no access needs a read over the
+//	bus first. data0/data1 carry the SPI port and device id, so the
+//	bank A/B shadows share data2/data3: the output latch in bits 0-7,
+//	IODIR in bits 8-15 and GPPU in bits 16-23. The shadows are seeded
+//	from the chip at setup time and written through from then on.
+
+
 /*
  * myPinMode:
  *********************************************************************************
@@ -78,11 +120,12 @@ static uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg)
 
 static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old, reg, bankA ;
 
   pin -= node->pinBase ;
 
-  if (pin < 8)		// Bank A
+  bankA = (pin < 8) ;
+  if (bankA)
     reg  = MCP23x17_IODIRA ;
   else
   {
@@ -91,7 +134,7 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
   }
 
   mask = 1 << pin ;
-  old  = readByte (node->data0, node->data1, reg) ;
+  old  = ((bankA ? node->data2 : node->data3) >> 8) & 0xFF ;	// IODIR shadow
 
   if (mode == OUTPUT)
     old &= (~mask) ;
@@ -99,6 +142,10 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   writeByte (node->data0, node->data1, reg, old) ;
+  if (bankA)
+    node->data2 = (node->data2 & ~0xFF00u) | (old << 8) ;
+  else
+    node->data3 = (node->data3 & ~0xFF00u) | (old << 8) ;
 }
 
 
@@ -109,11 +156,12 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 
 static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
+  int mask, old, reg, bankA ;
 
   pin -= node->pinBase ;
 
-  if (pin < 8)		// Bank A
+  bankA = (pin < 8) ;
+  if (bankA)
     reg  = MCP23x17_GPPUA ;
   else
   {
@@ -122,7 +170,7 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
   }
 
   mask = 1 << pin ;
-  old  = readByte (node->data0, node->data1, reg) ;
+  old  = ((bankA ? node->data2 : node->data3) >> 16) & 0xFF ;	// GPPU shadow
 
   if (mode == PUD_UP)
     old |=   mask ;
@@ -130,6 +178,10 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
     old &= (~mask) ;
 
   writeByte (node->data0, node->data1, reg, old) ;
+  if (bankA)
+    node->data2 = (node->data2 & ~0xFF0000u) | (old << 16) ;
+  else
+    node->data3 = (node->data3 & ~0xFF0000u) | (old << 16) ;
 }
 
 
@@ -148,7 +200,7 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
   if (pin < 8)			// Bank A
   {
-    old = node->data2 ;
+    old = node->data2 & 0xFF ;	// OLAT shadow
 
     if (value == LOW)
       old &= (~bit) ;
@@ -156,11 +208,11 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
       old |=   bit ;
 
     writeByte (node->data0, node->data1, MCP23x17_GPIOA, old) ;
-    node->data2 = old ;
+    node->data2 = (node->data2 & ~0xFFu) | old ;
   }
   else				// Bank B
   {
-    old = node->data3 ;
+    old = node->data3 & 0xFF ;	// OLAT shadow
 
     if (value == LOW)
       old &= (~bit) ;
@@ -168,7 +220,7 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
       old |=   bit ;
 
     writeByte (node->data0, node->data1, MCP23x17_GPIOB, old) ;
-    node->data3 = old ;
+    node->data3 = (node->data3 & ~0xFFu) | old ;
   }
 }
 
@@ -202,6 +254,43 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalWriteBank:
+ * myDigitalReadBank:
+ *	Whole-port access - bit N is pin (pinBase + N). A write touching
+ *	both banks goes out as a single 4-byte burst frame instead of two
+ *	3-byte ones; a write confined to one bank stays a byte access.
+ *********************************************************************************
+ */
+
+static void myDigitalWriteBank (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int values)
+{
+  unsigned int olat = (node->data2 & 0xFF) | ((node->data3 & 0xFF) << 8) ;
+
+  olat = (olat & ~mask) | (values & mask) ;
+
+  if ((mask & 0xFF00) == 0)
+    writeByte (node->data0, node->data1, MCP23x17_GPIOA, olat & 0xFF) ;
+  else if ((mask & 0x00FF) == 0)
+    writeByte (node->data0, node->data1, MCP23x17_GPIOB, olat >> 8) ;
+  else
+    writeWord (node->data0, node->data1, MCP23x17_GPIOA, olat) ;
+
+  node->data2 = (node->data2 & ~0xFFu) | (olat & 0xFF) ;
+  node->data3 = (node->data3 & ~0xFFu) | (olat >> 8) ;
+}
+
+static unsigned int myDigitalReadBank (struct wiringPiNodeStruct *node, unsigned int mask)
+{
+  if ((mask & 0xFF00) == 0)
+    return readByte (node->data0, node->data1, MCP23x17_GPIOA) ;
+  else if ((mask & 0x00FF) == 0)
+    return readByte (node->data0, node->data1, MCP23x17_GPIOB) << 8 ;
+
+  return readWord (node->data0, node->data1, MCP23x17_GPIOA) ;
+}
+
+
 /*
  * mcp23s17Setup:
  *	Create a new instance of an MCP23s17 SPI GPIO interface. We know it
@@ -228,8 +317,22 @@ int mcp23s17Setup (const int pinBase, const int spiPort, const int devId)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
-  node->data2           = readByte (spiPort, devId, MCP23x17_OLATA) ;
-  node->data3           = readByte (spiPort, devId, MCP23x17_OLATB) ;
+  node->digitalWriteBank = myDigitalWriteBank ;
+  node->digitalReadBank  = myDigitalReadBank ;
+  if (wpiExtensionTrust)	// Power-on defaults: outputs low, all inputs, no pulls
+  {
+    node->data2 = 0xFF << 8 ;
+    node->data3 = 0xFF << 8 ;
+  }
+  else
+  {
+    node->data2 = readByte (spiPort, devId, MCP23x17_OLATA)
+		| (readByte (spiPort, devId, MCP23x17_IODIRA) << 8)
+		| (readByte (spiPort, devId, MCP23x17_GPPUA) << 16) ;
+    node->data3 = readByte (spiPort, devId, MCP23x17_OLATB)
+		| (readByte (spiPort, devId, MCP23x17_IODIRB) << 8)
+		| (readByte (spiPort, devId, MCP23x17_GPPUB) << 16) ;
+  }
 
   return TRUE ;
 }
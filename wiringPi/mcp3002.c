@@ -22,6 +22,8 @@
  ***********************************************************************
  */
 
+#include <string.h>
+
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
 
@@ -53,6 +55,55 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myAnalogReadScan:
+ *	Convert both channels (or just the one in the mask) in a single
+ *	SPI message train - one 2-byte frame per channel with CS dropped
+ *	between them, but only a single ioctl.
+ *********************************************************************************
+ */
+
+static int myAnalogReadScan (struct wiringPiNodeStruct *node, unsigned int mask, int *results)
+{
+  struct wiringPiSPISegment segments [2] ;
+  unsigned char spiData [2][2] ;
+  int chan, n ;
+
+  n = 0 ;
+  for (chan = 0 ; chan < 2 ; ++chan)
+  {
+    if (!(mask & (1 << chan)))
+      continue ;
+
+    spiData [n][0] = (chan == 0) ? 0b11010000 : 0b11110000 ;
+    spiData [n][1] = 0 ;
+
+    memset (&segments [n], 0, sizeof (segments [n])) ;
+    segments [n].txData   = spiData [n] ;
+    segments [n].rxData   = spiData [n] ;
+    segments [n].len      = 2 ;
+    segments [n].csChange = 1 ;		// new conversion, new CS frame
+    ++n ;
+  }
+
+  if (n == 0)
+    return 0 ;
+
+  if (wiringPiSPIDataRWn (node->fd, segments, n) < 0)
+    return -1 ;
+
+  n = 0 ;
+  for (chan = 0 ; chan < 2 ; ++chan)
+    if (mask & (1 << chan))
+    {
+      results [chan] = ((spiData [n][0] << 8) | (spiData [n][1] >> 1)) & 0x3FF ;
+      ++n ;
+    }
+
+  return n ;
+}
+
+
 /*
  * mcp3002Setup:
  *	Create a new wiringPi device node for an mcp3002 on the Pi's
@@ -69,8 +120,9 @@ int mcp3002Setup (const int pinBase, int spiChannel)
 
   node = wiringPiNewNode (pinBase, 2) ;
 
-  node->fd         = spiChannel ;
-  node->analogRead = myAnalogRead ;
+  node->fd             = spiChannel ;
+  node->analogRead     = myAnalogRead ;
+  node->analogReadScan = myAnalogReadScan ;
 
   return TRUE ;
 }
@@ -24,6 +24,8 @@
  ***********************************************************************
  */
 
+#include <string.h>
+
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
 
@@ -53,6 +55,56 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myAnalogReadScan:
+ *	Convert every channel in the mask with one SPI message train -
+ *	one 3-byte frame per channel, CS dropped between frames so each
+ *	conversion starts cleanly, but only a single ioctl.
+ *********************************************************************************
+ */
+
+static int myAnalogReadScan (struct wiringPiNodeStruct *node, unsigned int mask, int *results)
+{
+  struct wiringPiSPISegment segments [8] ;
+  unsigned char spiData [8][3] ;
+  int chan, n ;
+
+  n = 0 ;
+  for (chan = 0 ; chan <= node->pinMax - node->pinBase ; ++chan)
+  {
+    if (!(mask & (1 << chan)))
+      continue ;
+
+    spiData [n][0] = 1 ;		// Start bit
+    spiData [n][1] = 0b10000000 | (chan << 4) ;
+    spiData [n][2] = 0 ;
+
+    memset (&segments [n], 0, sizeof (segments [n])) ;
+    segments [n].txData   = spiData [n] ;
+    segments [n].rxData   = spiData [n] ;
+    segments [n].len      = 3 ;
+    segments [n].csChange = 1 ;		// new conversion, new CS frame
+    ++n ;
+  }
+
+  if (n == 0)
+    return 0 ;
+
+  if (wiringPiSPIDataRWn (node->fd, segments, n) < 0)
+    return -1 ;
+
+  n = 0 ;
+  for (chan = 0 ; chan <= node->pinMax - node->pinBase ; ++chan)
+    if (mask & (1 << chan))
+    {
+      results [chan] = ((spiData [n][1] << 8) | spiData [n][2]) & 0x3FF ;
+      ++n ;
+    }
+
+  return n ;
+}
+
+
 /*
  * mcp3004Setup:
  *	Create a new wiringPi device node for an mcp3004 on the Pi's
@@ -69,8 +121,9 @@ int mcp3004Setup (const int pinBase, int spiChannel)
 
   node = wiringPiNewNode (pinBase, 8) ;
 
-  node->fd         = spiChannel ;
-  node->analogRead = myAnalogRead ;
+  node->fd             = spiChannel ;
+  node->analogRead     = myAnalogRead ;
+  node->analogReadScan = myAnalogReadScan ;
 
   return TRUE ;
 }
@@ -37,6 +37,14 @@
 #include "mcp3422.h"
 
 
+// Nominal conversion times in mS, indexed by the MCP3422_SR_* setting.
+//	We sleep this long before the first status read, then poll - so a
+//	conversion costs 2-3 bus reads rather than one per millisecond of
+//	conversion time (267 of them at 18 bits).
+
+static const unsigned int convTimeMs [4] = { 4, 16, 66, 266 } ;
+
+
 /*
  * waitForConversion:
  *	Common code to wait for the ADC to finish conversion
@@ -70,13 +78,30 @@ int myAnalogRead (struct wiringPiNodeStruct *node, int chan)
   unsigned char config ;
   unsigned char buffer [4] ;
   int value = 0 ;
-  int realChan = (chan & 3) - node->pinBase ;
+  int realChan = (chan - node->pinBase) & 3 ;
+
+  config = (realChan << 5) | (node->data0 << 2) | (node->data1) ;
+
+  if (node->data3)	// Continuous mode
+  {
+    config |= 0x10 ;
+    if (node->data2 != config)	// (Re)arm - first read, or channel changed
+    {
+      wiringPiI2CWrite (node->fd, config) ;
+      node->data2 = config ;
+      delay (convTimeMs [node->data0 & 3]) ;
+    }
 
-// One-shot mode, trigger plus the other configs.
+// Otherwise no trigger needed: the chip is already converting and the
+//	RDY poll below picks up the next result as it lands - on average
+//	half a conversion period away rather than a full trigger + one.
 
-  config = 0x80 | (realChan << 5) | (node->data0 << 2) | (node->data1) ;
-  
-  wiringPiI2CWrite (node->fd, config) ;
+  }
+  else			// One-shot mode: trigger, sleep the conversion out
+  {
+    wiringPiI2CWrite (node->fd, 0x80 | config) ;
+    delay (convTimeMs [node->data0 & 3]) ;
+  }
 
   switch (node->data0)	// Sample rate
   {
@@ -105,6 +130,30 @@ int myAnalogRead (struct wiringPiNodeStruct *node, int chan)
 }
 
 
+/*
+ * mcp3422Continuous:
+ *	Switch between the default one-shot mode and continuous conversion,
+ *	where the chip free-runs and each analogRead collects the freshest
+ *	result without re-triggering. Best when one channel is read often -
+ *	changing channel in continuous mode re-arms the chip and costs a
+ *	full conversion again.
+ *********************************************************************************
+ */
+
+int mcp3422Continuous (const int pinBase, int enable)
+{
+  struct wiringPiNodeStruct *node = wiringPiFindNode (pinBase) ;
+
+  if (node == NULL)
+    return FALSE ;
+
+  node->data3 = enable ? TRUE : FALSE ;
+  node->data2 = 0 ;		// Force a re-arm on the next read
+
+  return TRUE ;
+}
+
+
 /*
  * mcp3422Setup:
  *	Create a new wiringPi device node for the mcp3422
@@ -37,6 +37,7 @@ extern "C" {
 #endif
 
 extern int mcp3422Setup (int pinBase, int i2cAddress, int sampleRate, int gain) ;
+extern int mcp3422Continuous (const int pinBase, int enable) ;	// Interface 3.17
 
 #ifdef __cplusplus
 }
@@ -22,6 +22,8 @@
  ***********************************************************************
  */
 
+#include <stddef.h>
+
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
 
@@ -53,6 +55,80 @@ static void myAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
   wiringPiSPIDataRW (node->fd, spiData, 2) ;
 }
 
+/*
+ * mcp4802Ldac:
+ *	Tell the node its /LDAC pin. mcp4802Write2 then holds it high while
+ *	both frames load and pulses it low afterwards, so the two outputs
+ *	change on the very same edge.
+ *********************************************************************************
+ */
+
+int mcp4802Ldac (const int pinBase, int ldacPin)
+{
+  struct wiringPiNodeStruct *node = wiringPiFindNode (pinBase) ;
+
+  if (node == NULL)
+    return FALSE ;
+
+  digitalWrite (ldacPin, LOW) ;
+  pinMode      (ldacPin, OUTPUT) ;
+
+  node->data0 = ldacPin + 1 ;	// 0 means no LDAC pin
+
+  return TRUE ;
+}
+
+
+/*
+ * mcp4802Write2:
+ *	Update both channels from one multi-message SPI transfer - two
+ *	16-bit frames with a chip-select toggle between them, one ioctl.
+ *	With an LDAC pin registered both outputs move on its falling edge;
+ *	without one they move a CS toggle apart, which is still far tighter
+ *	than two separate transactions.
+ *********************************************************************************
+ */
+
+int mcp4802Write2 (const int pinBase, const int value0, const int value1)
+{
+  struct wiringPiNodeStruct *node = wiringPiFindNode (pinBase) ;
+  unsigned char frameA [2], frameB [2] ;
+  struct wiringPiSPISegment segments [2] ;
+
+  if (node == NULL)
+    return FALSE ;
+
+  if (node->data0 != 0)			// Hold the outputs while we load
+    digitalWrite (node->data0 - 1, HIGH) ;
+
+  frameA [0] = 0x30 | ((value0 >> 4) & 0x0F) ;
+  frameA [1] = (value0 << 4) & 0xF0 ;
+  frameB [0] = 0xB0 | ((value1 >> 4) & 0x0F) ;
+  frameB [1] = (value1 << 4) & 0xF0 ;
+
+  segments [0].txData   = frameA ;
+  segments [0].rxData   = NULL ;
+  segments [0].len      = 2 ;
+  segments [0].speed    = 0 ;
+  segments [0].delay    = 0 ;
+  segments [0].csChange = 1 ;	// The chip latches each frame on CS rise
+
+  segments [1].txData   = frameB ;
+  segments [1].rxData   = NULL ;
+  segments [1].len      = 2 ;
+  segments [1].speed    = 0 ;
+  segments [1].delay    = 0 ;
+  segments [1].csChange = 0 ;
+
+  wiringPiSPIDataRWn (node->fd, segments, 2) ;
+
+  if (node->data0 != 0)			// ... and release them together
+    digitalWrite (node->data0 - 1, LOW) ;
+
+  return TRUE ;
+}
+
+
 /*
  * mcp4802Setup:
  *	Create a new wiringPi device node for an mcp4802 on the Pi's
@@ -27,6 +27,8 @@ extern "C" {
 #endif
 
 extern int mcp4802Setup (int pinBase, int spiChannel) ;
+extern int mcp4802Ldac   (const int pinBase, int ldacPin) ;			// Interface 3.17
+extern int mcp4802Write2 (const int pinBase, const int value0, const int value1) ;	// Interface 3.17
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,7 @@
  */
 
 #include <stdio.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
@@ -30,6 +31,42 @@
 
 #include "pcf8574.h"
 
+// Node data usage:
+//	data0: cached input port value
+//	data1: read-cache staleness window in mS (0: cache off)
+//	data2: output shadow - what we last wrote to the port
+//	data3: when data0 was read, in (truncated) monotonic mS; 0: never
+
+
+static unsigned int pcf8574Now (void)
+{
+  struct timespec ts ;
+  unsigned int now ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  now = (unsigned int)((unsigned long long)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL) ;
+  return (now == 0) ? 1 : now ;	// 0 is the never-read marker
+}
+
+
+/*
+ * myReadPort:
+ *	One bus read serves every digitalRead inside the staleness window
+ *********************************************************************************
+ */
+
+static int myReadPort (struct wiringPiNodeStruct *node)
+{
+  unsigned int now = pcf8574Now () ;
+
+  if ((node->data1 != 0) && (node->data3 != 0) && ((now - node->data3) <= node->data1))
+    return node->data0 ;
+
+  node->data0 = wiringPiI2CRead (node->fd) ;
+  node->data3 = now ;
+  return node->data0 ;
+}
+
 
 /*
  * myPinMode:
@@ -52,8 +89,12 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
   else
     old |=   bit ;	// Write bit to 1
 
+  if (old == (int)node->data2)	// Nothing would change on the wire
+    return ;
+
   wiringPiI2CWrite (node->fd, old) ;
   node->data2 = old ;
+  node->data3 = 0 ;		// Outputs read back - drop the cache
 }
 
 
@@ -75,8 +116,33 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
   else
     old |=   bit ;
 
+  if (old == (int)node->data2)	// Nothing would change on the wire
+    return ;
+
   wiringPiI2CWrite (node->fd, old) ;
   node->data2 = old ;
+  node->data3 = 0 ;		// Outputs read back - drop the cache
+}
+
+
+/*
+ * myDigitalWriteBank:
+ *	All 8 pins from one shadowed bus write
+ *********************************************************************************
+ */
+
+static void myDigitalWriteBank (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int values)
+{
+  int new ;
+
+  new = ((int)node->data2 & ~(int)(mask & 0xFF)) | (int)(values & mask & 0xFF) ;
+
+  if (new == (int)node->data2)
+    return ;
+
+  wiringPiI2CWrite (node->fd, new) ;
+  node->data2 = new ;
+  node->data3 = 0 ;
 }
 
 
@@ -90,15 +156,48 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
   int mask, value ;
 
   mask  = 1 << ((pin - node->pinBase) & 7) ;
-  value = wiringPiI2CRead (node->fd) ;
+  value = myReadPort (node) ;
 
   if ((value & mask) == 0)
     return LOW ;
-  else 
+  else
     return HIGH ;
 }
 
 
+/*
+ * myDigitalReadBank:
+ *	All 8 pins from one bus read (or the cache)
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadBank (struct wiringPiNodeStruct *node, unsigned int mask)
+{
+  return (unsigned int)myReadPort (node) & mask & 0xFF ;
+}
+
+
+/*
+ * pcf8574ReadCache:
+ *	Let digitalRead serve the whole port from one bus read for up to
+ *	staleMs milliseconds - a keypad scan of 8 pins then costs a single
+ *	I2C transaction. 0 (the default) reads the bus every time.
+ *********************************************************************************
+ */
+
+int pcf8574ReadCache (const int pinBase, int staleMs)
+{
+  struct wiringPiNodeStruct *node = wiringPiFindNode (pinBase) ;
+
+  if ((node == NULL) || (staleMs < 0))
+    return FALSE ;
+
+  node->data1 = staleMs ;
+  node->data3 = 0 ;
+  return TRUE ;
+}
+
+
 /*
  * pcf8574Setup:
  *	Create a new instance of a PCF8574 I2C GPIO interface. We know it
@@ -117,11 +216,13 @@ int pcf8574Setup (const int pinBase, const int i2cAddress)
 
   node = wiringPiNewNode (pinBase, 8) ;
 
-  node->fd           = fd ;
-  node->pinMode      = myPinMode ;
-  node->digitalRead  = myDigitalRead ;
-  node->digitalWrite = myDigitalWrite ;
-  node->data2        = wiringPiI2CRead (fd) ;
+  node->fd               = fd ;
+  node->pinMode          = myPinMode ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalReadBank  = myDigitalReadBank ;
+  node->digitalWriteBank = myDigitalWriteBank ;
+  node->data2            = wiringPiI2CRead (fd) ;
 
   return TRUE ;
 }
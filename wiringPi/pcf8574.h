@@ -27,6 +27,7 @@ extern "C" {
 #endif
 
 extern int pcf8574Setup (const int pinBase, const int i2cAddress) ;
+extern int pcf8574ReadCache (const int pinBase, int staleMs) ;	// Interface 3.17
 
 #ifdef __cplusplus
 }
@@ -25,12 +25,61 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "wiringPi.h"
 #include "wiringPiI2C.h"
 
 #include "pcf8591.h"
 
+// The control byte we run the chip with: DAC enabled, four single-ended
+//	inputs, auto-increment on so one burst read walks all 4 channels.
+//	Node scratch fields: data0 is the control byte the chip last saw
+//	(0: unknown), data2 the I2C address, data3 the DAC cache
+//	(0x100 | value when valid).
+
+#define	PCF8591_CTRL	0x44
+
+
+/*
+ * pcf8591ReadAll:
+ *	Snapshot all 4 ADC channels in one bus transaction - the control
+ *	byte (skipped when the chip already has it) then a 5-byte
+ *	auto-increment read, of which the first byte is the previous,
+ *	stale, conversion.
+ *********************************************************************************
+ */
+
+static int pcf8591ReadAll (struct wiringPiNodeStruct *node, unsigned char values [4])
+{
+  struct wiringPiI2CMsg msgs [2] ;
+  unsigned char ctrl = PCF8591_CTRL ;
+  unsigned char buf [5] ;
+  int n = 0 ;
+
+  if (node->data0 != PCF8591_CTRL)
+  {
+    msgs [n].addr  = node->data2 ;
+    msgs [n].flags = 0 ;
+    msgs [n].len   = 1 ;
+    msgs [n].buf   = &ctrl ;
+    ++n ;
+  }
+
+  msgs [n].addr  = node->data2 ;
+  msgs [n].flags = WPI_I2C_M_RD ;
+  msgs [n].len   = 5 ;
+  msgs [n].buf   = buf ;
+  ++n ;
+
+  if (wiringPiI2CTransfer (node->fd, msgs, n) < 0)
+    return -1 ;
+
+  node->data0 = PCF8591_CTRL ;
+  memcpy (values, &buf [1], 4) ;
+  return 0 ;
+}
+
 
 /*
  * myAnalogWrite:
@@ -40,12 +89,19 @@
 static void myAnalogWrite (struct wiringPiNodeStruct *node, UNU int pin, int value)
 {
   unsigned char b [2] ;
-  b [0] = 0x40 ;
+
+  if (node->data3 == (0x100U | (value & 0xFF)))	// DAC already holds this
+    return ;
+
+  b [0] = PCF8591_CTRL ;
   b [1] = value & 0xFF ;
   ssize_t bytes_written = write(node->fd, b, 2);
   if (bytes_written != 2) {
       perror("Error writing to file descriptor");
+      return ;
   }
+  node->data0 = PCF8591_CTRL ;
+  node->data3 = 0x100 | (value & 0xFF) ;
 }
 
 
@@ -56,14 +112,39 @@ static void myAnalogWrite (struct wiringPiNodeStruct *node, UNU int pin, int val
 
 static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 {
-  int x ;
+  unsigned char values [4] ;
+
+  if (pcf8591ReadAll (node, values) < 0)
+    return -1 ;
+
+  return values [(pin - node->pinBase) & 3] ;
+}
+
+
+/*
+ * myAnalogReadScan:
+ *	All masked channels from one snapshot - the burst costs the same
+ *	as a single-channel read anyway.
+ *********************************************************************************
+ */
+
+static int myAnalogReadScan (struct wiringPiNodeStruct *node, unsigned int mask, int *results)
+{
+  unsigned char values [4] ;
+  int chan, n ;
 
-  wiringPiI2CWrite (node->fd, 0x40 | ((pin - node->pinBase) & 3)) ;
+  if (pcf8591ReadAll (node, values) < 0)
+    return -1 ;
 
-  x = wiringPiI2CRead (node->fd) ;	// Throw away the first read
-  x = wiringPiI2CRead (node->fd) ;
+  n = 0 ;
+  for (chan = 0 ; chan < 4 ; ++chan)
+    if (mask & (1 << chan))
+    {
+      results [chan] = values [chan] ;
+      ++n ;
+    }
 
-  return x ;
+  return n ;
 }
 
 
@@ -86,9 +167,11 @@ int pcf8591Setup (const int pinBase, const int i2cAddress)
 
   node = wiringPiNewNode (pinBase, 4) ;
 
-  node->fd          = fd ;
-  node->analogRead  = myAnalogRead ;
-  node->analogWrite = myAnalogWrite ;
+  node->fd             = fd ;
+  node->data2          = i2cAddress ;
+  node->analogRead     = myAnalogRead ;
+  node->analogReadScan = myAnalogReadScan ;
+  node->analogWrite    = myAnalogWrite ;
 
   return TRUE ;
 }
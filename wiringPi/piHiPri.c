@@ -26,6 +26,10 @@
 
 #include <sched.h>
 #include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include "wiringPi.h"
 
@@ -49,3 +53,102 @@ int piHiPri (const int pri)
 
   return sched_setscheduler (0, SCHED_RR, &sched) ;
 }
+
+
+/*
+ * piSetDeadline:
+ *	Put the calling thread under SCHED_DEADLINE: the kernel reserves
+ *	runtime nS of CPU in every period nS window and guarantees it
+ *	before the deadline, so equal-priority SCHED_RR threads can no
+ *	longer interleave into a timing loop - the worst-case gap becomes
+ *	the reservation bound instead of a scheduler roll of the dice.
+ *	Needs root (or CAP_SYS_NICE); returns 0 or -1 with errno set, in
+ *	which case the caller's previous policy is untouched and
+ *	piHiPri() remains the fallback.
+ *	glibc has no wrapper for sched_setattr, hence the raw syscall and
+ *	the local attribute struct.
+ *********************************************************************************
+ */
+
+#ifndef	SCHED_DEADLINE
+#define	SCHED_DEADLINE	6
+#endif
+
+struct piSchedAttr
+{
+  uint32_t size ;
+  uint32_t sched_policy ;
+  uint64_t sched_flags ;
+  int32_t  sched_nice ;
+  uint32_t sched_priority ;
+  uint64_t sched_runtime ;
+  uint64_t sched_deadline ;
+  uint64_t sched_period ;
+} ;
+
+int piSetDeadline (const unsigned long long runtimeNs, const unsigned long long deadlineNs, const unsigned long long periodNs)
+{
+  struct piSchedAttr attr ;
+
+  memset (&attr, 0, sizeof (attr)) ;
+  attr.size           = sizeof (attr) ;
+  attr.sched_policy   = SCHED_DEADLINE ;
+  attr.sched_runtime  = runtimeNs ;
+  attr.sched_deadline = deadlineNs ;
+  attr.sched_period   = (periodNs != 0) ? periodNs : deadlineNs ;
+
+  return (int)syscall (SYS_sched_setattr, 0, &attr, 0) ;
+}
+
+
+/*
+ * piSetAffinity:
+ *	Pin the calling thread to the CPUs in the given bitmask - bit N
+ *	is CPU N. On a box with isolcpus this is what keeps a timing
+ *	thread away from everything else.
+ *********************************************************************************
+ */
+
+int piSetAffinity (const unsigned int cpuMask)
+{
+  cpu_set_t set ;
+  unsigned int cpu ;
+
+  if (cpuMask == 0)
+    return -1 ;
+
+  CPU_ZERO (&set) ;
+  for (cpu = 0 ; cpu < 32 ; ++cpu)
+    if (cpuMask & (1u << cpu))
+      CPU_SET (cpu, &set) ;
+
+  return sched_setaffinity (0, sizeof (set), &set) ;
+}
+
+
+/*
+ * piRealtimeSetup:
+ *	The whole realtime recipe in one call: RT priority, a CPU to
+ *	live on (-1: don't pin), and the process memory locked so page
+ *	faults can't add milliseconds to a microsecond loop.
+ *	Returns 0, or -1 if any step failed (best effort - the earlier
+ *	steps stay applied).
+ *********************************************************************************
+ */
+
+int piRealtimeSetup (const int pri, const int cpu)
+{
+  int res = 0 ;
+
+  if (piHiPri (pri) != 0)
+    res = -1 ;
+
+  if (cpu >= 0)
+    if (piSetAffinity (1u << cpu) != 0)
+      res = -1 ;
+
+  if (mlockall (MCL_CURRENT | MCL_FUTURE) != 0)
+    res = -1 ;
+
+  return res ;
+}
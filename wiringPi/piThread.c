@@ -24,9 +24,43 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include "wiringPi.h"
 
-static pthread_mutex_t piMutexes [4] ;
+// PI_MAX_LOCKS:
+//	64 keys so unrelated subsystems stop sharing locks. The mutexes
+//	get PTHREAD_PRIO_INHERIT where the system supports it, so a
+//	low-priority holder (e.g. a logger) is boosted rather than
+//	stalling an RT thread - no more priority inversion against the
+//	ISR dispatch thread.
+
+#define	PI_MAX_LOCKS	64
+
+static pthread_mutex_t piMutexes [PI_MAX_LOCKS] ;
+static pthread_once_t  piMutexesOnce = PTHREAD_ONCE_INIT ;
+
+
+static void piMutexesInit (void)
+{
+  pthread_mutexattr_t attr ;
+  int key ;
+
+  pthread_mutexattr_init (&attr) ;
+#if defined(_POSIX_THREAD_PRIO_INHERIT) && (_POSIX_THREAD_PRIO_INHERIT > 0)
+  pthread_mutexattr_setprotocol (&attr, PTHREAD_PRIO_INHERIT) ;	// ENOTSUP just leaves PRIO_NONE
+#endif
+
+  for (key = 0 ; key < PI_MAX_LOCKS ; ++key)
+    pthread_mutex_init (&piMutexes [key], &attr) ;
+
+  pthread_mutexattr_destroy (&attr) ;
+}
 
 
 
@@ -43,21 +77,430 @@ int piThreadCreate (void *(*fn)(void *))
   return pthread_create (&myThread, NULL, fn, NULL) ;
 }
 
+/*
+ * piThreadCreateOn:
+ *	As piThreadCreate, but the thread starts pinned to the given CPU
+ *	(-1: don't pin) at the given SCHED_RR priority (0: inherit).
+ *	If RT scheduling is refused (no privilege) the thread is still
+ *	created with the affinity applied.
+ *********************************************************************************
+ */
+
+int piThreadCreateOn (void *(*fn)(void *), const int cpu, const int priority)
+{
+  pthread_t myThread ;
+  pthread_attr_t attr ;
+  struct sched_param param ;
+  cpu_set_t set ;
+  int res ;
+
+  pthread_attr_init (&attr) ;
+
+  if (cpu >= 0)
+  {
+    CPU_ZERO (&set) ;
+    CPU_SET (cpu, &set) ;
+    pthread_attr_setaffinity_np (&attr, sizeof (set), &set) ;
+  }
+
+  if (priority > 0)
+  {
+    param.sched_priority = (priority > sched_get_priority_max (SCHED_RR)) ?
+				sched_get_priority_max (SCHED_RR) : priority ;
+    pthread_attr_setinheritsched (&attr, PTHREAD_EXPLICIT_SCHED) ;
+    pthread_attr_setschedpolicy  (&attr, SCHED_RR) ;
+    pthread_attr_setschedparam   (&attr, &param) ;
+  }
+
+  res = pthread_create (&myThread, &attr, fn, NULL) ;
+
+  if (res != 0 && priority > 0)	// No RT privilege - drop back to inherited scheduling
+  {
+    pthread_attr_setinheritsched (&attr, PTHREAD_INHERIT_SCHED) ;
+    res = pthread_create (&myThread, &attr, fn, NULL) ;
+  }
+
+  pthread_attr_destroy (&attr) ;
+  return res ;
+}
+
+
+/*
+ * piThreadPoolCreate:
+ * piThreadPoolSubmit:
+ *	A small pool of warm worker threads for one-shot work - sensor
+ *	conversion waits, deferred I2C transactions and the like - where
+ *	spawning a fresh pthread per task costs ~100us before the task
+ *	even starts. Tasks go through a bounded lock-free MPMC ring (one
+ *	sequence word per slot, compare-exchange on the head/tail), so
+ *	submission from any thread is a few atomic operations plus at
+ *	most one futex wake; idle workers sleep on the futex and cost
+ *	nothing.
+ *	The pool is created once and lives for the process - there is no
+ *	teardown, matching how the rest of the library treats its helper
+ *	threads.
+ *********************************************************************************
+ */
+
+#define	PI_POOL_QUEUE	256		// must be a power of two
+#define	PI_POOL_MAX	16
+
+static struct
+{
+  unsigned int seq ;
+  void (*fn) (void *) ;
+  void *arg ;
+} piPoolRing [PI_POOL_QUEUE] ;
+
+static unsigned int piPoolHead = 0 ;	// next slot to fill
+static unsigned int piPoolTail = 0 ;	// next slot to drain
+static unsigned int piPoolWork = 0 ;	// futex word: bumped per submission
+static int piPoolThreads = 0 ;
+
+static void *piThreadPoolWorker (void *dummy)
+{
+  unsigned int pos, seen ;
+  void (*fn) (void *) ;
+  void *arg ;
+
+  (void)dummy ;
+
+  for (;;)
+  {
+    pos = __atomic_load_n (&piPoolTail, __ATOMIC_RELAXED) ;
+    for (;;)
+    {
+      unsigned int seq = __atomic_load_n (&piPoolRing [pos % PI_POOL_QUEUE].seq, __ATOMIC_ACQUIRE) ;
+      int dif = (int)(seq - (pos + 1)) ;
+
+      if (dif == 0)
+      {
+	if (__atomic_compare_exchange_n (&piPoolTail, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	  break ;
+      }
+      else if (dif < 0)				// ring empty - sleep until a submission bumps the futex word
+      {
+	seen = __atomic_load_n (&piPoolWork, __ATOMIC_ACQUIRE) ;
+	seq  = __atomic_load_n (&piPoolRing [pos % PI_POOL_QUEUE].seq, __ATOMIC_ACQUIRE) ;
+	if ((int)(seq - (pos + 1)) < 0)		// still empty after the re-check
+	  (void)syscall (SYS_futex, &piPoolWork, FUTEX_WAIT, seen, NULL, NULL, 0) ;
+	pos = __atomic_load_n (&piPoolTail, __ATOMIC_RELAXED) ;
+      }
+      else
+	pos = __atomic_load_n (&piPoolTail, __ATOMIC_RELAXED) ;
+    }
+
+    fn  = piPoolRing [pos % PI_POOL_QUEUE].fn ;
+    arg = piPoolRing [pos % PI_POOL_QUEUE].arg ;
+    __atomic_store_n (&piPoolRing [pos % PI_POOL_QUEUE].seq, pos + PI_POOL_QUEUE, __ATOMIC_RELEASE) ;
+
+    fn (arg) ;
+  }
+
+  return NULL ;
+}
+
+int piThreadPoolCreate (int nThreads, unsigned int affinityMask)
+{
+  pthread_t myThread ;
+  pthread_attr_t attr ;
+  cpu_set_t set ;
+  int thread, cpu, res ;
+  unsigned int i ;
+
+  if (piPoolThreads != 0)			// one pool per process
+    return 0 ;
+
+  if (nThreads < 1)
+    nThreads = 1 ;
+  else if (nThreads > PI_POOL_MAX)
+    nThreads = PI_POOL_MAX ;
+
+  for (i = 0 ; i < PI_POOL_QUEUE ; ++i)
+    piPoolRing [i].seq = i ;
+
+  cpu = -1 ;
+  for (thread = 0 ; thread < nThreads ; ++thread)
+  {
+    pthread_attr_init (&attr) ;
+
+    if (affinityMask != 0)			// round-robin the workers over the masked CPUs
+    {
+      do
+	cpu = (cpu + 1) % 32 ;
+      while ((affinityMask & (1U << cpu)) == 0) ;
+      CPU_ZERO (&set) ;
+      CPU_SET (cpu, &set) ;
+      pthread_attr_setaffinity_np (&attr, sizeof (set), &set) ;
+    }
+
+    res = pthread_create (&myThread, &attr, piThreadPoolWorker, NULL) ;
+    pthread_attr_destroy (&attr) ;
+    if (res != 0)
+      return (piPoolThreads != 0) ? 0 : res ;	// partial pool still works
+    ++piPoolThreads ;
+  }
+
+  return 0 ;
+}
+
+int piThreadPoolSubmit (void (*fn) (void *), void *arg)
+{
+  unsigned int pos, seq ;
+  int dif ;
+
+  if (piPoolThreads == 0)
+    return FALSE ;
+
+  pos = __atomic_load_n (&piPoolHead, __ATOMIC_RELAXED) ;
+  for (;;)
+  {
+    seq = __atomic_load_n (&piPoolRing [pos % PI_POOL_QUEUE].seq, __ATOMIC_ACQUIRE) ;
+    dif = (int)(seq - pos) ;
+
+    /**/ if (dif == 0)
+    {
+      if (__atomic_compare_exchange_n (&piPoolHead, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	break ;
+    }
+    else if (dif < 0)				// ring full
+      return FALSE ;
+    else
+      pos = __atomic_load_n (&piPoolHead, __ATOMIC_RELAXED) ;
+  }
+
+  piPoolRing [pos % PI_POOL_QUEUE].fn  = fn ;
+  piPoolRing [pos % PI_POOL_QUEUE].arg = arg ;
+  __atomic_store_n (&piPoolRing [pos % PI_POOL_QUEUE].seq, pos + 1, __ATOMIC_RELEASE) ;
+
+  __atomic_add_fetch (&piPoolWork, 1, __ATOMIC_RELEASE) ;
+  (void)syscall (SYS_futex, &piPoolWork, FUTEX_WAKE, 1, NULL, NULL, 0) ;
+
+  return TRUE ;
+}
+
+
+/*
+ * piPeriodicCreate:
+ *	Run a callback at a fixed rate without the long-term drift of a
+ *	hand-rolled delay() loop. The worker blocks on a timerfd armed
+ *	with an absolute CLOCK_MONOTONIC interval, so each tick is
+ *	scheduled from the ideal timeline, not from when the last
+ *	callback happened to finish - a 1kHz loop stays at exactly 1kHz
+ *	over hours. Ticks that pile up behind a slow callback are counted
+ *	as overruns (one callback runs, the rest are reported via
+ *	piPeriodicOverruns), PI_PERIODIC_RT runs the worker at SCHED_RR
+ *	and PI_PERIODIC_ALIGN starts the timer on the next whole multiple
+ *	of the period so several aligned tasks tick in phase with each
+ *	other.
+ *	Returns a handle for piPeriodicOverruns()/piPeriodicDestroy(), or
+ *	-1 on error.
+ *********************************************************************************
+ */
+
+#define	PI_PERIODIC_MAX	16
+
+static struct piPeriodicTask
+{
+  int timerFd ;
+  int running ;
+  int flags ;
+  unsigned long long periodNs ;
+  unsigned long long overruns ;
+  void (*fn) (void *) ;
+  void *arg ;
+} piPeriodicTasks [PI_PERIODIC_MAX] = { [0 ... PI_PERIODIC_MAX - 1] = { .timerFd = -1 } } ;
+
+static void *piPeriodicWorker (void *data)
+{
+  struct piPeriodicTask *task = (struct piPeriodicTask *)data ;
+  uint64_t expirations ;
+
+// SCHED_DEADLINE must be requested by the thread itself. A fifth of
+//	the period is a generous callback budget; without privilege the
+//	worker just keeps whatever PI_PERIODIC_RT set up.
+
+  if (task->flags & PI_PERIODIC_DEADLINE)
+    (void)piSetDeadline (task->periodNs / 5, task->periodNs, task->periodNs) ;
+
+  while (__atomic_load_n (&task->running, __ATOMIC_ACQUIRE))
+  {
+    if (read (task->timerFd, &expirations, sizeof (expirations)) != sizeof (expirations))
+      continue ;
+    if (!__atomic_load_n (&task->running, __ATOMIC_ACQUIRE))
+      break ;
+    if (expirations > 1)		// ticks that piled up behind a slow callback
+      __atomic_add_fetch (&task->overruns, expirations - 1, __ATOMIC_RELAXED) ;
+    task->fn (task->arg) ;
+  }
+
+  close (task->timerFd) ;
+  __atomic_store_n (&task->timerFd, -1, __ATOMIC_RELEASE) ;	// slot free again
+  return NULL ;
+}
+
+int piPeriodicCreate (unsigned int periodUs, void (*fn) (void *), void *arg, int flags)
+{
+  struct piPeriodicTask *task ;
+  struct itimerspec spec ;
+  struct timespec now ;
+  pthread_t myThread ;
+  pthread_attr_t attr ;
+  struct sched_param param ;
+  unsigned long long periodNs, startNs ;
+  int handle, fd, res ;
+
+  if ((periodUs == 0) || (fn == NULL))
+    return -1 ;
+
+  for (handle = 0 ; handle < PI_PERIODIC_MAX ; ++handle)
+    if (piPeriodicTasks [handle].timerFd < 0)
+      break ;
+  if (handle == PI_PERIODIC_MAX)
+    return -1 ;
+
+  if ((fd = timerfd_create (CLOCK_MONOTONIC, 0)) < 0)
+    return -1 ;
+
+  periodNs = (unsigned long long)periodUs * 1000ULL ;
+  spec.it_interval.tv_sec  = (time_t)(periodNs / 1000000000ULL) ;
+  spec.it_interval.tv_nsec = (long)  (periodNs % 1000000000ULL) ;
+
+  if (flags & PI_PERIODIC_ALIGN)	// first tick on the next whole multiple of the period
+  {
+    clock_gettime (CLOCK_MONOTONIC, &now) ;
+    startNs = (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec ;
+    startNs = (startNs / periodNs + 1) * periodNs ;
+  }
+  else
+  {
+    clock_gettime (CLOCK_MONOTONIC, &now) ;
+    startNs = (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec + periodNs ;
+  }
+  spec.it_value.tv_sec  = (time_t)(startNs / 1000000000ULL) ;
+  spec.it_value.tv_nsec = (long)  (startNs % 1000000000ULL) ;
+
+  if (timerfd_settime (fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0)
+  {
+    close (fd) ;
+    return -1 ;
+  }
+
+  task = &piPeriodicTasks [handle] ;
+  task->running  = TRUE ;
+  task->flags    = flags ;
+  task->periodNs = periodNs ;
+  task->overruns = 0 ;
+  task->fn       = fn ;
+  task->arg      = arg ;
+  __atomic_store_n (&task->timerFd, fd, __ATOMIC_RELEASE) ;
+
+  pthread_attr_init (&attr) ;
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED) ;
+
+  if (flags & PI_PERIODIC_RT)
+  {
+    param.sched_priority = sched_get_priority_max (SCHED_RR) / 2 ;
+    pthread_attr_setinheritsched (&attr, PTHREAD_EXPLICIT_SCHED) ;
+    pthread_attr_setschedpolicy  (&attr, SCHED_RR) ;
+    pthread_attr_setschedparam   (&attr, &param) ;
+  }
+
+  res = pthread_create (&myThread, &attr, piPeriodicWorker, task) ;
+
+  if (res != 0 && (flags & PI_PERIODIC_RT))	// no RT privilege - inherit instead
+  {
+    pthread_attr_setinheritsched (&attr, PTHREAD_INHERIT_SCHED) ;
+    res = pthread_create (&myThread, &attr, piPeriodicWorker, task) ;
+  }
+
+  pthread_attr_destroy (&attr) ;
+
+  if (res != 0)
+  {
+    close (fd) ;
+    task->timerFd = -1 ;
+    return -1 ;
+  }
+
+  return handle ;
+}
+
+
+/*
+ * piPeriodicOverruns:
+ *	Cumulative count of ticks this task has missed because the
+ *	callback overran its period.
+ *********************************************************************************
+ */
+
+unsigned int piPeriodicOverruns (int handle)
+{
+  if (handle < 0 || handle >= PI_PERIODIC_MAX)
+    return 0 ;
+
+  return (unsigned int)__atomic_load_n (&piPeriodicTasks [handle].overruns, __ATOMIC_RELAXED) ;
+}
+
+
+/*
+ * piPeriodicDestroy:
+ *	Stop a periodic task. The worker notices on its next tick,
+ *	closes the timer and frees the slot.
+ *********************************************************************************
+ */
+
+void piPeriodicDestroy (int handle)
+{
+  if (handle < 0 || handle >= PI_PERIODIC_MAX)
+    return ;
+  if (piPeriodicTasks [handle].timerFd < 0)
+    return ;
+
+  __atomic_store_n (&piPeriodicTasks [handle].running, FALSE, __ATOMIC_RELEASE) ;
+}
+
+
 /*
  * piLock: piUnlock:
  *	Activate/Deactivate a mutex.
- *	We're keeping things simple here and only tracking 4 mutexes which
- *	is more than enough for out entry-level pthread programming
+ *	Keys 0-63; out of range keys are silently ignored (only 0-3
+ *	existed historically, so old code never checked a result).
  *********************************************************************************
  */
 
 void piLock (int key)
 {
+  if (key < 0 || key >= PI_MAX_LOCKS)
+    return ;
+
+  pthread_once (&piMutexesOnce, piMutexesInit) ;
   pthread_mutex_lock (&piMutexes [key]) ;
 }
 
 void piUnlock (int key)
 {
+  if (key < 0 || key >= PI_MAX_LOCKS)
+    return ;
+
+  pthread_once (&piMutexesOnce, piMutexesInit) ;
   pthread_mutex_unlock (&piMutexes [key]) ;
 }
 
+
+/*
+ * piTryLock:
+ *	As piLock, but returns immediately: TRUE if the lock was taken,
+ *	FALSE if it's already held (or the key is out of range) - so hot
+ *	paths can fail fast instead of blocking.
+ *********************************************************************************
+ */
+
+int piTryLock (int key)
+{
+  if (key < 0 || key >= PI_MAX_LOCKS)
+    return FALSE ;
+
+  pthread_once (&piMutexesOnce, piMutexesInit) ;
+  return (pthread_mutex_trylock (&piMutexes [key]) == 0) ? TRUE : FALSE ;
+}
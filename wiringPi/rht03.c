@@ -164,6 +164,80 @@ static int maxDetectRead (const int pin, unsigned char buffer [4])
 }
 
 
+/*
+ * maxDetectReadEdges:
+ *	Read a frame using the kernel's timestamped edge events instead of
+ *	spin-sampling. Every bit starts with a falling edge, and the gap to
+ *	the next falling edge is ~77uS for a 0 or ~120uS for a 1 - the kernel
+ *	stamps each edge the moment it fires, so a scheduling stall on our
+ *	side no longer corrupts the timing or burns a core while we wait.
+ *	Returns TRUE/FALSE on the checksum, or -1 if the kernel can't give
+ *	us edge events on this pin (the caller then falls back to sampling).
+ *********************************************************************************
+ */
+
+static int maxDetectReadEdges (const int pin, unsigned char buffer [4])
+{
+  struct WPIEdgeEvent events [64] ;
+  unsigned long long dt ;
+  unsigned int checksum ;
+  unsigned char localBuf [5] = { 0, 0, 0, 0, 0 } ;
+  int i, n, got, base, bit ;
+
+// Wake up the RHT03 by pulling the data line low, then high
+//	Low for 10mS, high for 40uS.
+
+  pinMode      (pin, OUTPUT) ;
+  digitalWrite (pin, 0) ; delay             (10) ;
+  digitalWrite (pin, 1) ; delayMicroseconds (40) ;
+
+  if (wiringPiEdgeCaptureOpen (pin, INT_EDGE_FALLING, 0) < 0)
+  {
+    pinMode (pin, INPUT) ;
+    return -1 ;
+  }
+
+// The whole 40-bit frame is over in ~5mS - collect until it goes quiet
+
+  got = 0 ;
+  while (got < 64)
+  {
+    n = wiringPiEdgeCaptureRead (pin, events + got, 64 - got, (got == 0) ? 10 : 2) ;
+    if (n <= 0)
+      break ;
+    got += n ;
+  }
+
+  wiringPiEdgeCaptureClose (pin) ;
+
+// 40 bit periods are delimited by 41 falling edges, ending on the edge
+//	where the sensor releases the bus - so decode the last 41 and any
+//	edges we lost while requesting the line don't matter
+
+  if (got < 41)
+    return FALSE ;
+
+  base = got - 41 ;
+  for (bit = 0 ; bit < 40 ; ++bit)
+  {
+    dt = events [base + bit + 1].timeStamp_ns - events [base + bit].timeStamp_ns ;
+    localBuf [bit / 8] <<= 1 ;
+    if (dt > 100000)			// 50uS low + 70uS high: it's a 1
+      localBuf [bit / 8] |= 1 ;
+  }
+
+  checksum = 0 ;
+  for (i = 0 ; i < 4 ; ++i)
+  {
+    buffer [i] = localBuf [i] ;
+    checksum += localBuf [i] ;
+  }
+  checksum &= 0xFF ;
+
+  return checksum == localBuf [4] ;
+}
+
+
 /*
  * myReadRHT03:
  *	Read the Temperature & Humidity from an RHT03 sensor
@@ -173,12 +247,24 @@ static int maxDetectRead (const int pin, unsigned char buffer [4])
 
 static int myReadRHT03 (const int pin, int *temp, int *rh)
 {
+  static int useSampling = FALSE ;
   int result ;
   unsigned char buffer [4] ;
 
-// Read ...
-  
-  result = maxDetectRead (pin, buffer) ;
+// Read - kernel edge timestamps when we can get them, the old
+//	spin-sampling loop when we can't
+
+  if (useSampling)
+    result = maxDetectRead (pin, buffer) ;
+  else
+  {
+    result = maxDetectReadEdges (pin, buffer) ;
+    if (result == -1)
+    {
+      useSampling = TRUE ;
+      result = maxDetectRead (pin, buffer) ;
+    }
+  }
 
   if (!result)
     return FALSE ;
@@ -22,6 +22,8 @@
  ***********************************************************************
  */
 
+#include <stddef.h>
+
 #include <wiringPi.h>
 #include <wiringPiI2C.h>
 
@@ -42,6 +44,27 @@ static void myAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
   wiringPiI2CWriteReg8 (fd, 0x16, 0x00) ;		// Update
 }
 
+/*
+ * sn3218Frame:
+ *	Write all 18 PWM channels in one I2C block transaction, then the
+ *	single update-register poke that latches them together. One frame
+ *	costs 2 transactions rather than the 36 that 18 analogWrites make.
+ *********************************************************************************
+ */
+
+int sn3218Frame (const int pinBase, const uint8_t values [18])
+{
+  struct wiringPiNodeStruct *node = wiringPiFindNode (pinBase) ;
+
+  if (node == NULL)
+    return -1 ;
+
+  wiringPiI2CWriteBlockData (node->fd, 0x01, values, 18) ;	// Channels 1..18
+  wiringPiI2CWriteReg8      (node->fd, 0x16, 0x00) ;		// Update
+
+  return 0 ;
+}
+
 /*
  * sn3218Setup:
  *	Create a new wiringPi device node for an sn3218 on the Pi's
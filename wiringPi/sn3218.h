@@ -22,11 +22,14 @@
  ***********************************************************************
  */
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern int sn3218Setup (int pinBase) ;
+extern int sn3218Frame (const int pinBase, const uint8_t values [18]) ;	// Interface 3.17
 
 #ifdef __cplusplus
 }
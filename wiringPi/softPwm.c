@@ -23,7 +23,9 @@
  */
 
 #include <stdio.h>
-#include <malloc.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
@@ -43,61 +45,247 @@
 //	which is a frequency of 100Hz.
 //
 //	It's possible to get a higher frequency by lowering the pulse time,
-//	however CPU uage will skyrocket as wiringPi uses a hard-loop to time
-//	periods under 100µS - this is because the Linux timer calls are just
-//	not accurate at all, and have an overhead.
+//	however the Linux timer calls are just not accurate enough for
+//	much under 100µS.
 //
 //	Another way to increase the frequency is to reduce the range - however
 //	that reduces the overall output accuracy...
 
 #define	PULSE_TIME	100
 
-static volatile int marks         [MAX_PINS] ;
-static volatile int range         [MAX_PINS] ;
-static volatile pthread_t threads [MAX_PINS] ;
-static volatile int newPin = -1 ;
+// Per-pin frequency - Interface V3.17
+//	The scheduler fires edges on an absolute nS timeline, so duty
+//	resolution is not tied to a step count: each pin just carries its
+//	own period and the falling edge lands at mark/range of the way
+//	through it. What limits fine dimming is wakeup jitter - edges
+//	closer together than the timing floor below can't be told apart -
+//	so softPwmFrequency() reports how many distinct duty levels a
+//	given frequency really delivers.
+
+#define	SOFT_PWM_MIN_PERIOD_NS	50000ULL	// 20kHz - above this the thread just spins
+#define	SOFT_PWM_FLOOR_NS	10000ULL	// practical wakeup jitter under SCHED_RR
+
+// One scheduler thread runs all the pins. Each active pin carries the
+//	absolute CLOCK_MONOTONIC time of its next rising edge (the cycle
+//	start) and, once a cycle has started, of its falling edge. The
+//	thread sleeps to the earliest of those and fires everything that's
+//	due, so 16 channels cost 16 pthreads' worth less of scheduler
+//	churn than the old thread-per-pin arrangement.
+
+static volatile int marks  [MAX_PINS] ;
+static volatile int range  [MAX_PINS] ;
+static int      bcmPin [MAX_PINS] ;	// BCM translation for grouped writes, -1: none
+static uint64_t riseAt [MAX_PINS] ;	// nS, next cycle start
+static uint64_t fallAt [MAX_PINS] ;	// nS, pending falling edge, 0: none
+static uint64_t periodNs [MAX_PINS] ;	// nS, per-pin cycle length
+
+static pthread_t       schedThread ;
+static int             schedRunning = FALSE ;
+static int             numChannels  = 0 ;
+static pthread_mutex_t schedLock    = PTHREAD_MUTEX_INITIALIZER ;
+
+// Wakeup jitter bookkeeping - how late each scheduler wakeup was past
+//	its absolute deadline. Updated under schedLock.
+
+static uint64_t jitterSum   = 0 ;	// nS
+static uint64_t jitterMax   = 0 ;	// nS
+static uint64_t jitterCount = 0 ;
+
+// SCHED_DEADLINE opt-in (softPwmDeadline). Applied by the scheduler
+//	thread itself on its next pass - sched_setattr only works on the
+//	calling thread without a tid. Zero runtime: back to SCHED_RR.
+
+static int      deadlinePending   = FALSE ;
+static uint64_t deadlineRuntimeNs = 0 ;
+static uint64_t deadlinePeriodNs  = 0 ;
+
+// From wiringPi.c:
+//	Translate a pin in the current numbering mode to its BCM_GPIO
+//	number. Only succeeds in the memory-mapped modes - which are
+//	exactly the ones digitalWriteMulti() can group edges for.
+
+extern int ToBCMPin (int *pin) ;
+
+
+static uint64_t softPwmNow (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+
+static void softPwmSleepUntil (const uint64_t deadline)
+{
+  struct timespec ts ;
+
+  ts.tv_sec  = deadline / 1000000000ULL ;
+  ts.tv_nsec = deadline % 1000000000ULL ;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+}
 
 
 /*
- * softPwmThread:
- *	Thread to do the actual PWM output
+ * softPwmScheduler:
+ *	The one thread that runs every softPwm pin
  *********************************************************************************
  */
 
-static void *softPwmThread (void *arg)
+static void *softPwmScheduler (void *arg)
 {
-  int pin, mark, space ;
   struct sched_param param ;
+  uint64_t next, now, period ;
+  uint64_t riseMask, fallMask ;
+  int pin, mark ;
+
+  (void)arg ;
 
   param.sched_priority = sched_get_priority_max (SCHED_RR) ;
   pthread_setschedparam (pthread_self (), SCHED_RR, &param) ;
 
-  pin = *((int *)arg) ;
-  free (arg) ;
-
-  pin    = newPin ;
-  newPin = -1 ;
-
   piHiPri (90) ;
 
   for (;;)
   {
-    mark  = marks [pin] ;
-    space = range [pin] - mark ;
 
-    if (mark != 0)
-      digitalWrite (pin, HIGH) ;
-    delayMicroseconds (mark * 100) ;
+// Find the earliest pending edge
+
+    pthread_mutex_lock (&schedLock) ;
+
+    if (deadlinePending)
+    {
+      deadlinePending = FALSE ;
+      if (deadlineRuntimeNs == 0)		// back to plain SCHED_RR
+      {
+	param.sched_priority = sched_get_priority_max (SCHED_RR) ;
+	pthread_setschedparam (pthread_self (), SCHED_RR, &param) ;
+      }
+      else
+	(void)piSetDeadline (deadlineRuntimeNs, deadlinePeriodNs, deadlinePeriodNs) ;	// no privilege: RR stays
+    }
+
+    if (numChannels == 0)		// Last pin stopped
+    {
+      schedRunning = FALSE ;
+      pthread_mutex_unlock (&schedLock) ;
+      return NULL ;
+    }
 
-    if (space != 0)
-      digitalWrite (pin, LOW) ;
-    delayMicroseconds (space * 100) ;
+    next = 0 ;
+    for (pin = 0 ; pin < MAX_PINS ; ++pin)
+    {
+      if (range [pin] == 0)
+	continue ;
+      if ((next == 0) || (riseAt [pin] < next))
+	next = riseAt [pin] ;
+      if ((fallAt [pin] != 0) && (fallAt [pin] < next))
+	next = fallAt [pin] ;
+    }
+    pthread_mutex_unlock (&schedLock) ;
+
+    softPwmSleepUntil (next) ;
+
+// Fire everything that's now due. Edges on BCM-translatable pins are
+//	gathered into one digitalWriteMulti() store; anything else gets
+//	an individual digitalWrite.
+
+    pthread_mutex_lock (&schedLock) ;
+    now      = softPwmNow () ;
+    riseMask = 0 ;
+    fallMask = 0 ;
+
+    if (now > next)
+    {
+      jitterSum += now - next ;
+      if (now - next > jitterMax)
+	jitterMax = now - next ;
+    }
+    ++jitterCount ;
+
+    for (pin = 0 ; pin < MAX_PINS ; ++pin)
+    {
+      if (range [pin] == 0)
+	continue ;
+      period = periodNs [pin] ;
+
+      if ((fallAt [pin] != 0) && (fallAt [pin] <= now))
+      {
+	fallAt [pin] = 0 ;
+	if (bcmPin [pin] < 0)
+	  digitalWrite (pin, LOW) ;
+	else
+	  fallMask |= 1ULL << bcmPin [pin] ;
+      }
+
+      if (riseAt [pin] <= now)			// Cycle start
+      {
+	mark = marks [pin] ;
+
+	if (mark > 0)
+	{
+	  if (bcmPin [pin] < 0)
+	    digitalWrite (pin, HIGH) ;
+	  else
+	    riseMask |= 1ULL << bcmPin [pin] ;
+
+	  if (mark < range [pin])
+	    fallAt [pin] = riseAt [pin] + period * (uint64_t)mark / (uint64_t)range [pin] ;
+	}
+	else					// Fully off - make sure of it
+	{
+	  if (bcmPin [pin] < 0)
+	    digitalWrite (pin, LOW) ;
+	  else
+	    fallMask |= 1ULL << bcmPin [pin] ;
+	}
+
+// Advance in whole periods - preempted cycles are skipped, not burst
+
+	do
+	  riseAt [pin] += period ;
+	while (riseAt [pin] <= now) ;
+      }
+    }
+
+    if ((riseMask | fallMask) != 0)
+      digitalWriteMulti (riseMask | fallMask, riseMask) ;
+    pthread_mutex_unlock (&schedLock) ;
   }
 
   return NULL ;
 }
 
 
+/*
+ * softPwmStats:
+ *	Report the scheduler's measured wakeup jitter - the average and
+ *	worst lateness past the absolute deadlines, in µS - since the
+ *	last call. Returns the number of wakeups measured and resets the
+ *	counters.
+ *********************************************************************************
+ */
+
+int softPwmStats (unsigned int *avgJitterUs, unsigned int *maxJitterUs)
+{
+  uint64_t samples ;
+
+  pthread_mutex_lock (&schedLock) ;
+  samples = jitterCount ;
+  if (avgJitterUs != NULL)
+    *avgJitterUs = (samples == 0) ? 0 : (unsigned int)(jitterSum / samples / 1000ULL) ;
+  if (maxJitterUs != NULL)
+    *maxJitterUs = (unsigned int)(jitterMax / 1000ULL) ;
+  jitterSum   = 0 ;
+  jitterMax   = 0 ;
+  jitterCount = 0 ;
+  pthread_mutex_unlock (&schedLock) ;
+
+  return (int)samples ;
+}
+
+
 /*
  * softPwmWrite:
  *	Write a PWM value to the given pin
@@ -106,7 +294,7 @@ static void *softPwmThread (void *arg)
 
 void softPwmWrite (int pin, int value)
 {
-  if (pin < MAX_PINS)
+  if (pin >= 0 && pin < MAX_PINS)
   {
     if      (value < 0)           { value = 0 ; }
     else if (value > range [pin]) { value = range [pin] ; }
@@ -118,17 +306,17 @@ void softPwmWrite (int pin, int value)
 
 /*
  * softPwmCreate:
- *	Create a new softPWM thread.
+ *	Register a pin with the softPWM scheduler, starting it if this is
+ *	the first one.
  *********************************************************************************
  */
 
 int softPwmCreate (int pin, int initialValue, int pwmRange)
 {
-  int res ;
-  pthread_t myThread ;
-  int *passPin ;
+  int res = 0 ;
+  int bcm ;
 
-  if (pin >= MAX_PINS)
+  if (pin < 0 || pin >= MAX_PINS)
     return -1 ;
 
   if (range [pin] != 0)	// Already running on this pin
@@ -137,48 +325,134 @@ int softPwmCreate (int pin, int initialValue, int pwmRange)
   if (pwmRange <= 0)
     return -1 ;
 
-  passPin = malloc (sizeof (*passPin)) ;
-  if (passPin == NULL)
-    return -1 ;
-
   digitalWrite (pin, LOW) ;
   pinMode      (pin, OUTPUT) ;
 
-  marks [pin] = initialValue ;
-  range [pin] = pwmRange ;
-
-  *passPin = pin ;
-  newPin   = pin ;
-  res      = pthread_create (&myThread, NULL, softPwmThread, (void *)passPin) ;
+  bcm = pin ;
+  bcmPin [pin] = ToBCMPin (&bcm) ? bcm : -1 ;
 
-  if (res != 0)
-    return res ;
-  
-  while (newPin != -1)
-    delay (1) ;
+  pthread_mutex_lock (&schedLock) ;
+  marks  [pin] = initialValue ;
+  riseAt [pin] = softPwmNow () + PULSE_TIME * 1000ULL ;	// Join at the next tick
+  fallAt [pin] = 0 ;
+  range  [pin] = pwmRange ;
+  periodNs [pin] = (uint64_t)pwmRange * PULSE_TIME * 1000ULL ;	// classic 100Hz @ range 100
+  ++numChannels ;
 
-  threads [pin] = myThread ;
+  if (!schedRunning)
+  {
+    res = pthread_create (&schedThread, NULL, softPwmScheduler, NULL) ;
+    if (res == 0)
+      schedRunning = TRUE ;
+    else
+    {
+      range [pin] = 0 ;
+      --numChannels ;
+    }
+  }
+  pthread_mutex_unlock (&schedLock) ;
 
   return res ;
 }
 
 
+/*
+ * softPwmDeadline:
+ *	Opt the scheduler thread into a SCHED_DEADLINE reservation of
+ *	runtimeUs CPU every periodUs, so its worst-case gap is the
+ *	reservation bound rather than whatever equal-priority SCHED_RR
+ *	threads are up to. Needs root; without privilege the thread just
+ *	stays on SCHED_RR. runtimeUs 0 reverts to SCHED_RR.
+ *********************************************************************************
+ */
+
+void softPwmDeadline (unsigned int runtimeUs, unsigned int periodUs)
+{
+  pthread_mutex_lock (&schedLock) ;
+  deadlineRuntimeNs = (uint64_t)runtimeUs * 1000ULL ;
+  deadlinePeriodNs  = (uint64_t)periodUs  * 1000ULL ;
+  deadlinePending   = TRUE ;
+  pthread_mutex_unlock (&schedLock) ;
+}
+
+
+/*
+ * softPwmFrequency:
+ *	Set a pin's base PWM frequency, keeping its range. The duty value
+ *	still runs 0..range; the falling edge lands proportionally within
+ *	the new period. Returns the number of distinct duty levels the
+ *	scheduler can genuinely deliver at that frequency - range if the
+ *	period is long enough, fewer once duty steps drop below the
+ *	~10µS wakeup jitter floor - so callers see the
+ *	resolution/frequency trade-off instead of silently losing it.
+ *	1kHz with a 10-bit range reports ~100 true levels; drop to 500Hz
+ *	for ~200, or keep 1kHz and know that the bottom bits dither.
+ *	Returns -1 if the pin isn't running or the frequency is out of
+ *	range (the period is clamped at 20kHz).
+ *********************************************************************************
+ */
+
+int softPwmFrequency (int pin, int freqHz)
+{
+  uint64_t period, levels ;
+
+  if (pin < 0 || pin >= MAX_PINS || freqHz <= 0)
+    return -1 ;
+
+  period = 1000000000ULL / (uint64_t)freqHz ;
+  if (period < SOFT_PWM_MIN_PERIOD_NS)
+    period = SOFT_PWM_MIN_PERIOD_NS ;
+
+  pthread_mutex_lock (&schedLock) ;
+  if (range [pin] == 0)
+  {
+    pthread_mutex_unlock (&schedLock) ;
+    return -1 ;
+  }
+
+  periodNs [pin] = period ;
+  riseAt   [pin] = softPwmNow () + period ;	// rejoin on the new timeline
+  fallAt   [pin] = 0 ;
+
+  levels = period / SOFT_PWM_FLOOR_NS ;
+  if (levels > (uint64_t)range [pin])
+    levels = (uint64_t)range [pin] ;
+  pthread_mutex_unlock (&schedLock) ;
+
+  return (int)levels ;
+}
+
+
 /*
  * softPwmStop:
- *	Stop an existing softPWM thread
+ *	Remove a pin from the scheduler; the scheduler thread exits by
+ *	itself once the last pin is gone.
  *********************************************************************************
  */
 
 void softPwmStop (int pin)
 {
-  if (pin < MAX_PINS)
+  pthread_t thread = 0 ;
+  int lastOne = FALSE ;
+
+  if (pin < 0 || pin >= MAX_PINS)
+    return ;
+
+  pthread_mutex_lock (&schedLock) ;
+  if (range [pin] != 0)
   {
-    if (range [pin] != 0)
+    range  [pin] = 0 ;
+    fallAt [pin] = 0 ;
+    if (--numChannels == 0)
     {
-      pthread_cancel (threads [pin]) ;
-      pthread_join   (threads [pin], NULL) ;
-      range [pin] = 0 ;
-      digitalWrite (pin, LOW) ;
+      lastOne = TRUE ;
+      thread  = schedThread ;
     }
   }
+  pthread_mutex_unlock (&schedLock) ;
+
+  digitalWrite (pin, LOW) ;
+
+  if (lastOne)
+    pthread_join (thread, NULL) ;
 }
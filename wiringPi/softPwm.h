@@ -29,6 +29,18 @@ extern "C" {
 extern int  softPwmCreate (int pin, int value, int range) ;
 extern void softPwmWrite  (int pin, int value) ;
 extern void softPwmStop   (int pin) ;
+extern int  softPwmStats  (unsigned int *avgJitterUs, unsigned int *maxJitterUs) ;  //Interface 3.17
+
+// Interface V3.17 - per-pin base frequency, range unchanged. Returns the
+//	number of duty levels genuinely resolvable at that frequency (the
+//	resolution/frequency trade-off), or -1.
+
+extern int  softPwmFrequency (int pin, int freqHz) ;
+
+// Interface V3.17 - SCHED_DEADLINE reservation for the scheduler thread
+//	(needs root; SCHED_RR stays otherwise). runtimeUs 0 reverts.
+
+extern void softPwmDeadline  (unsigned int runtimeUs, unsigned int periodUs) ;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,424 @@
+/*
+ * softSerial.c:
+ *	Software UART on arbitrary GPIO pins.
+ *
+ *	The old way - a delay loop per bit - collapses under load: one
+ *	preemption in the middle of a byte corrupts it, in both
+ *	directions. Here neither direction has a per-bit delay loop at
+ *	all. Transmit compiles whole buffers into waveform-engine pulse
+ *	trains (one pulse per level run, sub-bit rounding carried so the
+ *	error never accumulates) and plays them from the wave thread's
+ *	absolute deadlines. Receive reads kernel-timestamped edge events
+ *	and reconstructs the bits from the gaps between edges, so it
+ *	doesn't matter when we get scheduled - the kernel stamped the
+ *	edges when they happened.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "wiringPi.h"
+#include "wiringPiWave.h"
+#include "softSerial.h"
+
+extern int ToBCMPin (int *pin) ;	// From wiringPi.c
+
+#define	MAX_SOFT_SERIAL		4
+#define	SOFT_SERIAL_BUF		2048	// RX ring, power of two
+#define	SOFT_SERIAL_TX_CHUNK	128	// Bytes compiled into one wave
+#define	SOFT_SERIAL_FRAME_BITS	10	// 8N1: start + 8 data + stop
+
+struct softSerialUart
+{
+  int inUse ;
+  int txPin, rxPin ;			// As given; -1: direction unused
+  unsigned long long txBit ;		// BCM bit for the wave pulses
+  unsigned int bitNs ;
+
+// RX ring - head owned by the decode thread, tail by the reader
+
+  pthread_t rxThread ;
+  volatile int rxRun ;
+  volatile unsigned int head, tail ;
+  unsigned char buf [SOFT_SERIAL_BUF] ;
+} ;
+
+static struct softSerialUart uarts [MAX_SOFT_SERIAL] ;
+
+// The wave transmitter is single, so writes from different ports (or
+//	threads) take their turns here.
+
+static pthread_mutex_t txLock = PTHREAD_MUTEX_INITIALIZER ;
+
+
+/*
+ * softSerialRxThread:
+ *	Decode edge events into bytes. A frame starts at a falling edge;
+ *	every later edge says how many bit slots have elapsed (rounded to
+ *	the nearest, so mid-frame jitter under half a bit is harmless)
+ *	and what level they all held. A frame ending in high bits makes
+ *	no final edge, so the read timeout finalises any frame that's
+ *	been open longer than eleven bits.
+ *********************************************************************************
+ */
+
+static void softSerialRxByte (struct softSerialUart *u, unsigned int frame)
+{
+  if (((frame & 1) != 0) || ((frame & (1u << 9)) == 0))
+    return ;				// Bad start or stop bit - framing error
+
+  if (u->head - u->tail >= SOFT_SERIAL_BUF)
+    return ;				// Ring full - drop, like a real UART overrun
+
+  u->buf [u->head & (SOFT_SERIAL_BUF - 1)] = (unsigned char)((frame >> 1) & 0xFF) ;
+  __atomic_store_n (&u->head, u->head + 1, __ATOMIC_RELEASE) ;
+}
+
+static void *softSerialRxThread (void *arg)
+{
+  struct softSerialUart *u = (struct softSerialUart *)arg ;
+  struct WPIEdgeEvent events [64] ;
+  struct timespec ts ;
+  uint64_t frameStart = 0, now ;
+  unsigned int frame = 0, bits = 0, slots ;
+  int n, i, level = HIGH, newLevel, inFrame = FALSE ;
+
+  while (u->rxRun)
+  {
+    n = wiringPiEdgeCaptureRead (u->rxPin, events, 64, 20) ;
+    if (n < 0)
+    {
+      delay (10) ;
+      continue ;
+    }
+
+    for (i = 0 ; i < n ; ++i)
+    {
+      newLevel = (events [i].edge == INT_EDGE_RISING) ? HIGH : LOW ;
+
+      if (!inFrame)
+      {
+	if (newLevel == LOW)		// Start bit
+	{
+	  inFrame    = TRUE ;
+	  frameStart = events [i].timeStamp_ns ;
+	  frame      = 0 ;
+	  bits       = 0 ;
+	}
+      }
+      else
+      {
+	slots = (unsigned int)((events [i].timeStamp_ns - frameStart + u->bitNs / 2) / u->bitNs) ;
+	for (; (bits < slots) && (bits < SOFT_SERIAL_FRAME_BITS) ; ++bits)
+	  if (level == HIGH)
+	    frame |= 1u << bits ;
+
+	if (bits >= SOFT_SERIAL_FRAME_BITS)
+	{
+	  softSerialRxByte (u, frame) ;
+	  inFrame = FALSE ;
+	  if (newLevel == LOW)		// This edge is already the next start bit
+	  {
+	    inFrame    = TRUE ;
+	    frameStart = events [i].timeStamp_ns ;
+	    frame      = 0 ;
+	    bits       = 0 ;
+	  }
+	}
+      }
+      level = newLevel ;
+    }
+
+// Quiet line: close out a frame whose tail bits were all high
+
+    if (inFrame)
+    {
+      clock_gettime (CLOCK_MONOTONIC, &ts) ;
+      now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+      if (now - frameStart > (uint64_t)u->bitNs * (SOFT_SERIAL_FRAME_BITS + 1))
+      {
+	for (; bits < SOFT_SERIAL_FRAME_BITS ; ++bits)
+	  if (level == HIGH)
+	    frame |= 1u << bits ;
+	softSerialRxByte (u, frame) ;
+	inFrame = FALSE ;
+      }
+    }
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * softSerialTxChunk:
+ *	Compile up to SOFT_SERIAL_TX_CHUNK bytes into one wave and play
+ *	it out. Consecutive equal bits collapse into one pulse, and the
+ *	microsecond rounding carries forward in nanoseconds, so a byte
+ *	is at most ten pulses and the timing error never grows past half
+ *	a microsecond no matter how long the buffer is.
+ *********************************************************************************
+ */
+
+static void softSerialTxChunk (struct softSerialUart *u, const unsigned char *buf, int len)
+{
+  struct wpiWavePulse *pulses ;
+  uint64_t idealNs = 0, emittedNs = 0 ;
+  unsigned int us, runBits = 0 ;
+  int numPulses = 0, runLevel = -1 ;
+  int i, bit, wave, tries, frame ;
+
+  if ((pulses = (struct wpiWavePulse *)malloc (sizeof (struct wpiWavePulse) * len * SOFT_SERIAL_FRAME_BITS)) == NULL)
+    return ;
+
+  for (i = 0 ; i < len ; ++i)
+  {
+    frame = ((int)buf [i] << 1) | (1 << 9) ;	// Start low, data LSB first, stop high
+
+    for (bit = 0 ; bit < SOFT_SERIAL_FRAME_BITS ; ++bit)
+    {
+      int b = (frame >> bit) & 1 ;
+
+      if (b == runLevel)
+      {
+	++runBits ;
+	continue ;
+      }
+      if (runLevel != -1)
+      {
+	idealNs += (uint64_t)runBits * u->bitNs ;
+	us = (unsigned int)((idealNs - emittedNs + 500) / 1000) ;
+	emittedNs += (uint64_t)us * 1000 ;
+	pulses [numPulses].gpioOn  = runLevel ? u->txBit : 0 ;
+	pulses [numPulses].gpioOff = runLevel ? 0 : u->txBit ;
+	pulses [numPulses].usDelay = us ;
+	++numPulses ;
+      }
+      runLevel = b ;
+      runBits  = 1 ;
+    }
+  }
+
+// The last run is the final stop bit(s) - always high, leaves the line idle
+
+  idealNs += (uint64_t)runBits * u->bitNs ;
+  us = (unsigned int)((idealNs - emittedNs + 500) / 1000) ;
+  pulses [numPulses].gpioOn  = u->txBit ;
+  pulses [numPulses].gpioOff = 0 ;
+  pulses [numPulses].usDelay = us ;
+  ++numPulses ;
+
+  pthread_mutex_lock (&txLock) ;
+
+  if ((wave = wpiWaveCreate (pulses, numPulses)) >= 0)
+  {
+    for (tries = 0 ; tries < 1000 ; ++tries)	// Someone else's wave may be playing
+    {
+      if (wpiWaveTxStart (wave, FALSE) == 0)
+      {
+	while (wpiWaveTxBusy ())
+	  delayMicroseconds (200) ;
+	wpiWaveTxStop () ;			// Reap the transmit thread
+	break ;
+      }
+      delay (1) ;
+    }
+    wpiWaveDelete (wave) ;
+  }
+
+  pthread_mutex_unlock (&txLock) ;
+  free (pulses) ;
+}
+
+
+/*
+ * softSerialOpen:
+ *	Set up a port - returns the handle or -1. The transmit pin must
+ *	be an on-board pin (the wave engine drives the GPIO banks
+ *	directly); receive works anywhere edge capture does.
+ *********************************************************************************
+ */
+
+int softSerialOpen (int txPin, int rxPin, int baud)
+{
+  struct softSerialUart *u = NULL ;
+  int handle, bcm ;
+
+  if ((baud < 300) || (baud > 115200) || ((txPin < 0) && (rxPin < 0)))
+    return -1 ;
+
+  for (handle = 0 ; handle < MAX_SOFT_SERIAL ; ++handle)
+    if (!uarts [handle].inUse)
+    {
+      u = &uarts [handle] ;
+      break ;
+    }
+  if (u == NULL)
+    return -1 ;
+
+  memset (u, 0, sizeof (*u)) ;
+  u->txPin = txPin ;
+  u->rxPin = rxPin ;
+  u->bitNs = (unsigned int)(1000000000ULL / (unsigned int)baud) ;
+
+  if (txPin >= 0)
+  {
+    bcm = txPin ;
+    if (((txPin & PI_GPIO_MASK) != 0) || !ToBCMPin (&bcm) || (bcm < 0))
+      return -1 ;
+    u->txBit = 1ULL << bcm ;
+    pinMode      (txPin, OUTPUT) ;
+    digitalWrite (txPin, HIGH) ;	// Idle
+  }
+
+  if (rxPin >= 0)
+  {
+    if (wiringPiEdgeCaptureOpen (rxPin, INT_EDGE_BOTH, 0) < 0)
+      return -1 ;
+    u->rxRun = TRUE ;
+    if (pthread_create (&u->rxThread, NULL, softSerialRxThread, u) != 0)
+    {
+      (void)wiringPiEdgeCaptureClose (rxPin) ;
+      return -1 ;
+    }
+  }
+
+  u->inUse = TRUE ;
+  return handle ;
+}
+
+
+/*
+ * softSerialClose:
+ *********************************************************************************
+ */
+
+void softSerialClose (int handle)
+{
+  struct softSerialUart *u ;
+
+  if ((handle < 0) || (handle >= MAX_SOFT_SERIAL) || !uarts [handle].inUse)
+    return ;
+
+  u = &uarts [handle] ;
+  if (u->rxPin >= 0)
+  {
+    u->rxRun = FALSE ;
+    pthread_join (u->rxThread, NULL) ;
+    (void)wiringPiEdgeCaptureClose (u->rxPin) ;
+  }
+  u->inUse = FALSE ;
+}
+
+
+/*
+ * softSerialWrite:
+ * softSerialPutchar:
+ * softSerialPuts:
+ *	Send bytes - blocks until the wave has gone out, like the
+ *	blocking write behind serialPutchar does.
+ *********************************************************************************
+ */
+
+void softSerialWrite (int handle, const unsigned char *buf, int len)
+{
+  struct softSerialUart *u ;
+  int chunk ;
+
+  if ((handle < 0) || (handle >= MAX_SOFT_SERIAL) || !uarts [handle].inUse)
+    return ;
+
+  u = &uarts [handle] ;
+  if ((u->txPin < 0) || (buf == NULL))
+    return ;
+
+  while (len > 0)
+  {
+    chunk = (len > SOFT_SERIAL_TX_CHUNK) ? SOFT_SERIAL_TX_CHUNK : len ;
+    softSerialTxChunk (u, buf, chunk) ;
+    buf += chunk ;
+    len -= chunk ;
+  }
+}
+
+void softSerialPutchar (int handle, unsigned char c)
+{
+  softSerialWrite (handle, &c, 1) ;
+}
+
+void softSerialPuts (int handle, const char *s)
+{
+  softSerialWrite (handle, (const unsigned char *)s, (int)strlen (s)) ;
+}
+
+
+/*
+ * softSerialDataAvail:
+ *	Bytes waiting in the receive ring.
+ *********************************************************************************
+ */
+
+int softSerialDataAvail (int handle)
+{
+  struct softSerialUart *u ;
+
+  if ((handle < 0) || (handle >= MAX_SOFT_SERIAL) || !uarts [handle].inUse)
+    return -1 ;
+
+  u = &uarts [handle] ;
+  return (int)(__atomic_load_n (&u->head, __ATOMIC_ACQUIRE) - u->tail) ;
+}
+
+
+/*
+ * softSerialGetchar:
+ *	Next received byte, waiting up to 10 seconds for one to arrive -
+ *	the same contract as serialGetchar.
+ *********************************************************************************
+ */
+
+int softSerialGetchar (int handle)
+{
+  struct softSerialUart *u ;
+  int waited ;
+  unsigned char c ;
+
+  if ((handle < 0) || (handle >= MAX_SOFT_SERIAL) || !uarts [handle].inUse)
+    return -1 ;
+
+  u = &uarts [handle] ;
+  for (waited = 0 ; waited < 10000 ; ++waited)
+  {
+    if (__atomic_load_n (&u->head, __ATOMIC_ACQUIRE) != u->tail)
+    {
+      c = u->buf [u->tail & (SOFT_SERIAL_BUF - 1)] ;
+      __atomic_store_n (&u->tail, u->tail + 1, __ATOMIC_RELEASE) ;
+      return c ;
+    }
+    delay (1) ;
+  }
+
+  return -1 ;
+}
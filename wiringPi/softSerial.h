@@ -0,0 +1,46 @@
+/*
+ * softSerial.h:
+ *	Software UART on arbitrary GPIO pins - transmit through the
+ *	waveform engine, receive from timestamped edge events.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All Interface V3.17. 8N1 framing; either pin may be -1 for a
+//	one-way port. The API mirrors wiringSerial, but on a handle
+//	rather than an fd.
+
+extern int  softSerialOpen      (int txPin, int rxPin, int baud) ;
+extern void softSerialClose     (int handle) ;
+
+extern void softSerialPutchar   (int handle, unsigned char c) ;
+extern void softSerialPuts      (int handle, const char *s) ;
+extern void softSerialWrite     (int handle, const unsigned char *buf, int len) ;
+
+extern int  softSerialDataAvail (int handle) ;
+extern int  softSerialGetchar   (int handle) ;
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,14 +25,15 @@
 
 //#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
-#include <sys/time.h>
+#include <errno.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
 #include "softServo.h"
 
-// RC Servo motors are a bit of an oddity - designed in the days when 
+// RC Servo motors are a bit of an oddity - designed in the days when
 //	radio control was experimental and people were tryin to make
 //	things as simple as possible as it was all very expensive...
 //
@@ -50,25 +51,46 @@
 // In practice we have a total slot width of about 20mS - so we're sending 50
 //	updates per second to each servo.
 //
-// In this code, we don't need to be too fussy about the gap as we're not doing
-//	the multipexing, but it does need to be at least 10mS, and preferably 16
-//	from what I've been able to determine.
-
-// WARNING:
-//	This code is really experimental. It was written in response to some people
-//	asking for a servo driver, however while it works, there is too much
-//	jitter to successfully drive a small servo - I have tried it with a micro
-//	servo and it worked, but the servo ran hot due to the jitter in the signal
-//	being sent to it.
-//
-//	If you want servo control for the Pi, then use the servoblaster kernel
-//	module.
+// All channels' rising edges fire together from one digitalWriteMulti()
+//	store at the start of each 20mS frame, and each falling edge is
+//	scheduled against its own absolute CLOCK_MONOTONIC deadline -
+//	channels no longer queue up behind each other's delays, so one
+//	servo's pulse width doesn't jitter its neighbours.
 
 #define	MAX_SERVOS	8
 
+#define	FRAME_NS	20000000ULL	// 20mS -> 50Hz refresh
+
 static int pinMap     [MAX_SERVOS] ;	// Keep track of our pins
 static int pulseWidth [MAX_SERVOS] ;	// microseconds
 
+// From wiringPi.c:
+//	Translate a pin in the current numbering mode to its BCM_GPIO
+//	number - only succeeds in the memory-mapped modes, which are the
+//	ones digitalWriteMulti() can group edges for.
+
+extern int ToBCMPin (int *pin) ;
+
+
+static uint64_t softServoNow (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+
+static void softServoSleepUntil (const uint64_t deadline)
+{
+  struct timespec ts ;
+
+  ts.tv_sec  = deadline / 1000000000ULL ;
+  ts.tv_nsec = deadline % 1000000000ULL ;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+}
+
 
 /*
  * softServoThread:
@@ -78,27 +100,29 @@ static int pulseWidth [MAX_SERVOS] ;	// microseconds
 
 static PI_THREAD (softServoThread)
 {
-  register int i, j, k, m, tmp ;
-  int lastDelay, pin, servo ;
+  int i, j, k, m, tmp ;
+  int pin, servo ;
+  uint64_t frameStart, riseMask, fallMask ;
 
   int myDelays [MAX_SERVOS] ;
   int myPins   [MAX_SERVOS] ;
-
-  struct timeval  tNow, tStart, tPeriod, tGap, tTotal ;
-  struct timespec tNs ;
-
-  tTotal.tv_sec  =    0 ;
-  tTotal.tv_usec = 8000 ;
+  int myBcm    [MAX_SERVOS] ;
 
   piHiPri (50) ;
 
+  frameStart = softServoNow () ;
+
   for (;;)
   {
-    gettimeofday (&tStart, NULL) ;
-
     memcpy (myDelays, pulseWidth, sizeof (myDelays)) ;
     memcpy (myPins,   pinMap,     sizeof (myPins)) ;
 
+    for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
+    {
+      tmp = myPins [servo] ;
+      myBcm [servo] = ((tmp != -1) && ToBCMPin (&tmp)) ? tmp : -1 ;
+    }
+
 // Sort the delays (& pins), shortest first
 
     for (m = MAX_SERVOS / 2 ; m > 0 ; m /= 2 )
@@ -112,41 +136,63 @@ static PI_THREAD (softServoThread)
 	  {
 	    tmp = myDelays [i] ; myDelays [i] = myDelays [k] ; myDelays [k] = tmp ;
 	    tmp = myPins   [i] ; myPins   [i] = myPins   [k] ; myPins   [k] = tmp ;
+	    tmp = myBcm    [i] ; myBcm    [i] = myBcm    [k] ; myBcm    [k] = tmp ;
 	  }
 	}
 
-// All on
+// All on together - one store for the translatable pins
 
-    lastDelay = 0 ;
+    riseMask = 0 ;
     for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
     {
       if ((pin = myPins [servo]) == -1)
 	continue ;
 
-      digitalWrite (pin, HIGH) ;
-      myDelays [servo] = myDelays [servo] - lastDelay ;
-      lastDelay += myDelays [servo] ;
+      if (myBcm [servo] >= 0)
+	riseMask |= 1ULL << myBcm [servo] ;
+      else
+	digitalWrite (pin, HIGH) ;
     }
+    if (riseMask != 0)
+      digitalWriteMulti (riseMask, riseMask) ;
 
-// Now loop, turning them all off as required
+// Now turn them off - each falling edge at its own absolute deadline,
+//	with equal pulse widths grouped into one store
 
     for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
     {
-      if ((pin = myPins [servo]) == -1)
+      if (myPins [servo] == -1)
 	continue ;
 
-      delayMicroseconds (myDelays [servo]) ;
-      digitalWrite (pin, LOW) ;
+      softServoSleepUntil (frameStart + (uint64_t)myDelays [servo] * 1000ULL) ;
+
+      fallMask = 0 ;
+      do
+      {
+	if ((pin = myPins [servo]) != -1)
+	{
+	  if (myBcm [servo] >= 0)
+	    fallMask |= 1ULL << myBcm [servo] ;
+	  else
+	    digitalWrite (pin, LOW) ;
+	}
+	++servo ;
+      }
+      while ((servo < MAX_SERVOS) && (myDelays [servo] == myDelays [servo - 1])) ;
+      --servo ;
+
+      if (fallMask != 0)
+	digitalWriteMulti (fallMask, 0) ;
     }
 
-// Wait until the end of an 8mS time-slot
+// Wait out the rest of the 20mS frame - absolute, so preemption in the
+//	pulses above doesn't stretch the frame. Skip frames we've
+//	completely lost rather than bursting pulses out
 
-    gettimeofday (&tNow, NULL) ;
-    timersub (&tNow, &tStart, &tPeriod) ;
-    timersub (&tTotal, &tPeriod, &tGap) ;
-    tNs.tv_sec  = tGap.tv_sec ;
-    tNs.tv_nsec = tGap.tv_usec * 1000 ;
-    nanosleep (&tNs, NULL) ;
+    frameStart += FRAME_NS ;
+    while (frameStart <= softServoNow ())
+      frameStart += FRAME_NS ;
+    softServoSleepUntil (frameStart) ;
   }
 
   return NULL ;
@@ -206,6 +252,6 @@ int softServoSetup (int p0, int p1, int p2, int p3, int p4, int p5, int p6, int
 
   for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
     pulseWidth [servo] = 1500 ;		// Mid point
-  
+
   return piThreadCreate (softServoThread) ;
 }
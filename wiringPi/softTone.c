@@ -27,6 +27,9 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
@@ -34,23 +37,65 @@
 
 #define	MAX_PINS	64
 
-#define	PULSE_TIME	100
-
 static int freqs         [MAX_PINS] ;
 static pthread_t threads [MAX_PINS] ;
 
 static int newPin = -1 ;
 
+// Wakeup jitter bookkeeping, aggregated over all tone threads - how
+//	late each wakeup was past its absolute deadline
+
+static pthread_mutex_t jitterLock  = PTHREAD_MUTEX_INITIALIZER ;
+static uint64_t        jitterSum   = 0 ;	// nS
+static uint64_t        jitterMax   = 0 ;	// nS
+static uint64_t        jitterCount = 0 ;
+
+
+static uint64_t softToneNow (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+
+static void softToneSleepUntil (const uint64_t deadline)
+{
+  struct timespec ts ;
+  uint64_t now ;
+
+  ts.tv_sec  = deadline / 1000000000ULL ;
+  ts.tv_nsec = deadline % 1000000000ULL ;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+
+  now = softToneNow () ;
+  pthread_mutex_lock (&jitterLock) ;
+  if (now > deadline)
+  {
+    jitterSum += now - deadline ;
+    if (now - deadline > jitterMax)
+      jitterMax = now - deadline ;
+  }
+  ++jitterCount ;
+  pthread_mutex_unlock (&jitterLock) ;
+}
+
 
 /*
  * softToneThread:
- *	Thread to do the actual PWM output
+ *	Thread to do the actual tone output. Each half cycle is scheduled
+ *	against an absolute CLOCK_MONOTONIC deadline, so preemption costs
+ *	one late edge rather than a permanent phase shift - no more
+ *	audible warble when the box is busy.
  *********************************************************************************
  */
 
 static PI_THREAD (softToneThread)
 {
-  int pin, freq, halfPeriod ;
+  int pin, freq ;
+  uint64_t halfPeriod, deadline, now ;
   struct sched_param param ;
 
   param.sched_priority = sched_get_priority_max (SCHED_RR) ;
@@ -61,20 +106,35 @@ static PI_THREAD (softToneThread)
 
   piHiPri (50) ;
 
+  deadline = 0 ;
   for (;;)
   {
     freq = freqs [pin] ;
     if (freq == 0)
+    {
       delay (1) ;
+      deadline = 0 ;		// Resync when the tone restarts
+    }
     else
     {
-      halfPeriod = 500000 / freq ;
+      halfPeriod = 500000000ULL / freq ;
+      if (deadline == 0)
+	deadline = softToneNow () ;
 
       digitalWrite (pin, HIGH) ;
-      delayMicroseconds (halfPeriod) ;
+      deadline += halfPeriod ;
+      softToneSleepUntil (deadline) ;
 
       digitalWrite (pin, LOW) ;
-      delayMicroseconds (halfPeriod) ;
+      deadline += halfPeriod ;
+      softToneSleepUntil (deadline) ;
+
+// If we're more than a full cycle behind, drop the lost cycles rather
+//	than bursting them out
+
+      now = softToneNow () ;
+      if (now > deadline + 2 * halfPeriod)
+	deadline = now ;
     }
   }
 
@@ -82,6 +142,34 @@ static PI_THREAD (softToneThread)
 }
 
 
+/*
+ * softToneStats:
+ *	Report the measured wakeup jitter over all tone pins - average
+ *	and worst lateness past the absolute deadlines, in µS - since the
+ *	last call. Returns the number of wakeups measured and resets the
+ *	counters.
+ *********************************************************************************
+ */
+
+int softToneStats (unsigned int *avgJitterUs, unsigned int *maxJitterUs)
+{
+  uint64_t samples ;
+
+  pthread_mutex_lock (&jitterLock) ;
+  samples = jitterCount ;
+  if (avgJitterUs != NULL)
+    *avgJitterUs = (samples == 0) ? 0 : (unsigned int)(jitterSum / samples / 1000ULL) ;
+  if (maxJitterUs != NULL)
+    *maxJitterUs = (unsigned int)(jitterMax / 1000ULL) ;
+  jitterSum   = 0 ;
+  jitterMax   = 0 ;
+  jitterCount = 0 ;
+  pthread_mutex_unlock (&jitterLock) ;
+
+  return (int)samples ;
+}
+
+
 /*
  * softToneWrite:
  *	Write a frequency value to the given pin
@@ -33,6 +33,7 @@ extern "C" {
 extern int  softToneCreate (int pin) ;
 extern void softToneStop   (int pin) ;
 extern void softToneWrite  (int pin, int freq) ;
+extern int  softToneStats  (unsigned int *avgJitterUs, unsigned int *maxJitterUs) ;  //Interface 3.17
 
 #ifdef __cplusplus
 }
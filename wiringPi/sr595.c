@@ -31,10 +31,60 @@
 #include <stdint.h>
 
 #include "wiringPi.h"
+#include "wiringPiSPI.h"
+#include "wiringPiBitBang.h"
 
 #include "sr595.h"
 
 
+/*
+ * sr595Shift:
+ *	Shift the whole output register down the chain and latch it.
+ *	No inter-bit delays: the 595 needs ~40nS per clock phase at 3v3
+ *	and even a register-level write takes longer than that. The shift
+ *	itself runs on the bit-bang engine, whose handle lives in data0.
+ *********************************************************************************
+ */
+
+static void sr595Shift (struct wiringPiNodeStruct *node)
+{
+  int latchPin = node->data2 ;
+  int bits     = node->pinMax - node->pinBase + 1 ;	// ie. number of clock pulses
+
+// A low -> high latch transition copies the latch to the output pins
+
+  digitalWrite (latchPin, LOW) ;
+    wpiBitBangShiftOut (node->data0, node->data3, bits) ;
+  digitalWrite (latchPin, HIGH) ;
+}
+
+
+/*
+ * sr595ShiftSpi:
+ *	As above, but the chain hangs off a hardware SPI channel: MOSI to
+ *	data, SCLK to clock and the chip-select to the latch - CE rises at
+ *	the end of the frame, which is exactly the latch edge we want. The
+ *	whole chain goes out in one transfer. data0 is the SPI channel here.
+ *********************************************************************************
+ */
+
+static void sr595ShiftSpi (struct wiringPiNodeStruct *node)
+{
+  unsigned char buffer [4] ;
+  int i, bits  = node->pinMax - node->pinBase + 1 ;
+  int   bytes  = (bits + 7) / 8 ;
+  unsigned int output = node->data3 ;
+
+// Furthest register down the chain wants its byte first, MSB first -
+//	the same order the bit-bang loop clocks them out
+
+  for (i = 0 ; i < bytes ; ++i)
+    buffer [i] = (output >> ((bytes - 1 - i) * 8)) & 0xFF ;
+
+  wiringPiSPIDataRW (node->data0, buffer, bytes) ;
+}
+
+
 /*
  * myDigitalWrite:
  *********************************************************************************
@@ -43,15 +93,10 @@
 static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
   unsigned int mask ;
-  int  dataPin, clockPin, latchPin ;
-  int  bit, bits, output ;
+  unsigned int output ;
 
-  pin     -= node->pinBase ;				// Normalise pin number
-  bits     = node->pinMax - node->pinBase + 1 ;		// ie. number of clock pulses
-  dataPin  = node->data0 ;
-  clockPin = node->data1 ;
-  latchPin = node->data2 ;
-  output   = node->data3 ;
+  pin   -= node->pinBase ;		// Normalise pin number
+  output = node->data3 ;
 
   mask = 1 << pin ;
 
@@ -60,19 +105,63 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
   else
     output |=   mask ;
 
+  if (output == node->data3)		// Nothing would change on the wire
+    return ;
+
   node->data3 = output ;
+  sr595Shift (node) ;
+}
 
-// A low -> high latch transition copies the latch to the output pins
+static void myDigitalWriteSpi (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  unsigned int mask ;
+  unsigned int output ;
+
+  pin   -= node->pinBase ;
+  output = node->data3 ;
+
+  mask = 1 << pin ;
+
+  if (value == LOW)
+    output &= (~mask) ;
+  else
+    output |=   mask ;
+
+  if (output == node->data3)
+    return ;
 
-  digitalWrite (latchPin, LOW) ; delayMicroseconds (1) ;
-    for (bit = bits - 1 ; bit >= 0 ; --bit)
-    {
-      digitalWrite (dataPin, output & (1 << bit)) ;
+  node->data3 = output ;
+  sr595ShiftSpi (node) ;
+}
+
+
+/*
+ * myDigitalWriteBank:
+ *	Move any set of pins in one shift and one latch pulse, so the whole
+ *	chain updates atomically on the output side.
+ *********************************************************************************
+ */
+
+static void myDigitalWriteBank (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int values)
+{
+  unsigned int output = (node->data3 & ~mask) | (values & mask) ;
+
+  if (output == node->data3)
+    return ;
 
-      digitalWrite (clockPin, HIGH) ; delayMicroseconds (1) ;
-      digitalWrite (clockPin, LOW) ;  delayMicroseconds (1) ;
-    }
-  digitalWrite (latchPin, HIGH) ; delayMicroseconds (1) ;
+  node->data3 = output ;
+  sr595Shift (node) ;
+}
+
+static void myDigitalWriteBankSpi (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int values)
+{
+  unsigned int output = (node->data3 & ~mask) | (values & mask) ;
+
+  if (output == node->data3)
+    return ;
+
+  node->data3 = output ;
+  sr595ShiftSpi (node) ;
 }
 
 
@@ -89,11 +178,11 @@ int sr595Setup (const int pinBase, const int numPins,
 
   node = wiringPiNewNode (pinBase, numPins) ;
 
-  node->data0           = dataPin ;
-  node->data1           = clockPin ;
-  node->data2           = latchPin ;
-  node->data3           = 0 ;		// Output register
-  node->digitalWrite    = myDigitalWrite ;
+  node->data1            = clockPin ;
+  node->data2            = latchPin ;
+  node->data3            = 0 ;		// Output register
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalWriteBank = myDigitalWriteBank ;
 
 // Initialise the underlying hardware
 
@@ -105,5 +194,43 @@ int sr595Setup (const int pinBase, const int numPins,
   pinMode (clockPin, OUTPUT) ;
   pinMode (latchPin, OUTPUT) ;
 
+// The engine handle goes in data0, like the SPI channel does in the
+//	SPI variant - furthest register down the chain gets its bit first
+
+  node->data0 = wpiBitBangCreate (clockPin, dataPin, 0, WPI_BB_MSBFIRST) ;
+
+  return TRUE ;
+}
+
+
+/*
+ * sr595SetupSpi:
+ *	As sr595Setup, but the chain hangs off hardware SPI: MOSI to the
+ *	data pin, SCLK to the clock pin and the channel's chip-select to
+ *	the latch. One transfer shifts and latches the whole chain.
+ *********************************************************************************
+ */
+
+int sr595SetupSpi (const int pinBase, const int numPins, const int spiChannel)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((numPins < 1) || (numPins > 32))
+    return FALSE ;
+
+  if (wiringPiSPISetup (spiChannel, 8000000) < 0)
+    return FALSE ;
+
+  node = wiringPiNewNode (pinBase, numPins) ;
+
+  node->data0            = spiChannel ;
+  node->data3            = 0 ;		// Output register
+  node->digitalWrite     = myDigitalWriteSpi ;
+  node->digitalWriteBank = myDigitalWriteBankSpi ;
+
+// Push the all-zeros register out so the chain starts in a known state
+
+  sr595ShiftSpi (node) ;
+
   return TRUE ;
 }
@@ -28,6 +28,8 @@ extern "C" {
 
 extern int sr595Setup (const int pinBase, const int numPins,
 	const int dataPin, const int clockPin, const int latchPin) ;
+extern int sr595SetupSpi (const int pinBase, const int numPins,
+	const int spiChannel) ;	// Interface 3.17
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,420 @@
+// WiringPi benchmark suite
+// Compile: gcc -Wall wiringpi_bench_suite.c -o wiringpi_bench_suite -lwiringPi
+//
+// Run with `make bench` (or directly with no arguments) to execute every
+// phase and emit one CSV row per measurement on stdout:
+//
+//   benchmark,unit,samples,min,mean,p50,p90,p99,max
+//
+// Needs BCM19 <-> BCM26 connected (1kOhm) like the other loopback tests.
+// Each phase runs in its own forked child so the per-mode setups
+// (gpiomem vs gpiod) don't fight over the one-shot library init.
+//
+// Optional phases, skipped quietly when the hardware isn't there:
+//   spi  - needs /dev/spidev0.0 (loopback MOSI<->MISO for a data check)
+//   i2c  - needs WIRINGPI_BENCH_I2C=<addr> (hex) naming a readable device
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include <wiringPi.h>
+#include <wiringPiI2C.h>
+#include <wiringPiSPI.h>
+#include <wiringPiPerf.h>
+#include <softPwm.h>
+
+static int GPIO   = 19;
+static int GPIOIN = 26;
+
+#define MAX_SAMPLES 4096
+
+static double samples[MAX_SAMPLES];
+static int    nSamples = 0;
+
+static void sampleReset(void) {
+  nSamples = 0;
+}
+
+static void sampleAdd(double value) {
+  if (nSamples < MAX_SAMPLES)
+    samples[nSamples++] = value;
+}
+
+static int cmpDouble(const void *a, const void *b) {
+  double d = *(const double *)a - *(const double *)b;
+  return (d > 0) - (d < 0);
+}
+
+static double percentile(double p) {
+  int idx = (int)((p / 100.0) * nSamples);
+  if (idx >= nSamples)
+    idx = nSamples - 1;
+  return samples[idx];
+}
+
+static void sampleReport(const char *name, const char *unit) {
+  double sum = 0.0;
+  int i;
+
+  if (nSamples == 0)
+    return;
+
+  qsort(samples, nSamples, sizeof(double), cmpDouble);
+  for (i = 0; i < nSamples; i++)
+    sum += samples[i];
+
+  printf("%s,%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+    name, unit, nSamples,
+    samples[0], sum / nSamples,
+    percentile(50), percentile(90), percentile(99),
+    samples[nSamples - 1]);
+  fflush(stdout);
+}
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+// digitalWrite/digitalRead/pinMode micro-benchmarks - batched, one
+// sample is the mean ns/op over a batch so a single preemption doesn't
+// swamp the numbers; the spread across batches shows up in p99.
+
+static void benchReadWrite(const char *tag, int opsPerBatch, int batches) {
+  char name[64];
+  double t0;
+  int b, i;
+
+  pinMode(GPIO, OUTPUT);
+  pinMode(GPIOIN, INPUT);
+
+  sampleReset();
+  for (b = 0; b < batches; b++) {
+    t0 = nowNs();
+    for (i = 0; i < opsPerBatch; i += 2) {
+      digitalWrite(GPIO, HIGH);
+      digitalWrite(GPIO, LOW);
+    }
+    sampleAdd((nowNs() - t0) / opsPerBatch);
+  }
+  snprintf(name, sizeof(name), "digitalWrite_%s", tag);
+  sampleReport(name, "ns/op");
+
+  sampleReset();
+  for (b = 0; b < batches; b++) {
+    t0 = nowNs();
+    for (i = 0; i < opsPerBatch; i++)
+      digitalRead(GPIOIN);
+    sampleAdd((nowNs() - t0) / opsPerBatch);
+  }
+  snprintf(name, sizeof(name), "digitalRead_%s", tag);
+  sampleReport(name, "ns/op");
+
+  sampleReset();
+  for (b = 0; b < batches; b++) {
+    t0 = nowNs();
+    for (i = 0; i < opsPerBatch; i += 2) {
+      pinMode(GPIO, OUTPUT);
+      pinMode(GPIO, INPUT);
+    }
+    sampleAdd((nowNs() - t0) / opsPerBatch);
+  }
+  snprintf(name, sizeof(name), "pinMode_%s", tag);
+  sampleReport(name, "ns/op");
+
+  pinMode(GPIO, OUTPUT);
+  digitalWrite(GPIO, LOW);
+  pinMode(GPIO, INPUT);
+}
+
+static int phaseGpiomem(void) {
+  double t0 = nowNs();
+
+  if (wiringPiSetupGpio() == -1)
+    return 1;
+  sampleReset();
+  sampleAdd((nowNs() - t0) / 1000.0);
+  sampleReport("setup_gpiomem", "us");
+
+  benchReadWrite("gpiomem", 1000000, 50);
+  return 0;
+}
+
+static int phaseGpiod(void) {
+  double t0 = nowNs();
+
+  if (wiringPiSetupGpioDevice(WPI_PIN_BCM) == -1)
+    return 1;
+  sampleReset();
+  sampleAdd((nowNs() - t0) / 1000.0);
+  sampleReport("setup_gpiod", "us");
+
+  benchReadWrite("gpiod", 2000, 50);
+  return 0;
+}
+
+
+// PMU counters per call - cycles, instructions and cache misses over a
+// batch of digitalWrite/digitalRead, so per-call costs come out to the
+// cycle instead of through the clock_gettime overhead the ns/op rows
+// carry. Skipped quietly where perf_event_paranoid forbids PMU access.
+
+static void benchPerfCounts(const char *name, const char *unit, int member,
+                            int perf, int opsPerBatch, int batches) {
+  struct WPIPerfCounts a, b;
+  unsigned long long delta;
+  int bt, i;
+
+  sampleReset();
+  for (bt = 0; bt < batches; bt++) {
+    if (wpiPerfRead(perf, &a) < 0)
+      return;
+    if (member < 2) {                         // write batches
+      for (i = 0; i < opsPerBatch; i += 2) {
+        digitalWrite(GPIO, HIGH);
+        digitalWrite(GPIO, LOW);
+      }
+    } else {                                  // read batch
+      for (i = 0; i < opsPerBatch; i++)
+        digitalRead(GPIOIN);
+    }
+    if (wpiPerfRead(perf, &b) < 0)
+      return;
+    switch (member) {
+      case 0:  delta = b.cycles - a.cycles;            break;
+      case 1:  delta = b.instructions - a.instructions; break;
+      default: delta = b.cycles - a.cycles;            break;
+    }
+    sampleAdd((double)delta / opsPerBatch);
+  }
+  sampleReport(name, unit);
+}
+
+static int phasePerf(void) {
+  struct WPIPerfCounts probe;
+  int perf;
+
+  if (wiringPiSetupGpio() == -1)
+    return 1;
+  if ((perf = wpiPerfOpen()) < 0)
+    return 0;                                 // No PMU access here - not an error
+
+  pinMode(GPIO, OUTPUT);
+  pinMode(GPIOIN, INPUT);
+
+  benchPerfCounts("digitalWrite_cycles", "cycles/op", 0, perf, 100000, 50);
+  if (wpiPerfRead(perf, &probe) == 0 && probe.instructions != 0)
+    benchPerfCounts("digitalWrite_instructions", "instr/op", 1, perf, 100000, 50);
+  benchPerfCounts("digitalRead_cycles", "cycles/op", 2, perf, 100000, 50);
+
+  // Cache misses per op round to zero; report them per batch instead
+  if (wpiPerfRead(perf, &probe) == 0 && probe.cacheMisses != 0) {
+    struct WPIPerfCounts a, b;
+    int bt, i;
+
+    sampleReset();
+    for (bt = 0; bt < 50; bt++) {
+      if (wpiPerfRead(perf, &a) < 0)
+        break;
+      for (i = 0; i < 100000; i += 2) {
+        digitalWrite(GPIO, HIGH);
+        digitalWrite(GPIO, LOW);
+      }
+      if (wpiPerfRead(perf, &b) < 0)
+        break;
+      sampleAdd((double)(b.cacheMisses - a.cacheMisses));
+    }
+    sampleReport("digitalWrite_cachemisses", "misses/100kop");
+  }
+
+  wpiPerfClose(perf);
+  pinMode(GPIO, INPUT);
+  return 0;
+}
+
+
+// ISR latency - kernel event timestamp to callback entry, the part of
+// the interrupt path this library owns.
+
+static volatile double isrLatencyUs;
+static volatile int    isrSeen;
+
+static void isrHandler(struct WPIWfiStatus status, void *userdata) {
+  (void)userdata;
+  if (status.statusOK)
+    isrLatencyUs = (nowNs() / 1000.0) - (double)status.timeStamp_us;
+  isrSeen = 1;
+}
+
+static int phaseIsr(void) {
+  int i, tries;
+
+  if (wiringPiSetupGpio() == -1)
+    return 1;
+
+  pinMode(GPIO, OUTPUT);
+  digitalWrite(GPIO, LOW);
+  if (wiringPiISR2(GPIOIN, INT_EDGE_RISING, isrHandler, 0, NULL) < 0)
+    return 1;
+
+  sampleReset();
+  for (i = 0; i < 500; i++) {
+    isrSeen = 0;
+    digitalWrite(GPIO, HIGH);
+    for (tries = 0; !isrSeen && tries < 10000; tries++)
+      delayMicroseconds(10);
+    digitalWrite(GPIO, LOW);
+    if (isrSeen)
+      sampleAdd(isrLatencyUs);
+    delayMicroseconds(200);
+  }
+  sampleReport("isr_edge_to_handler", "us");
+
+  wiringPiISRStop(GPIOIN);
+  pinMode(GPIO, INPUT);
+  return 0;
+}
+
+
+// SPI throughput - 64-byte full-duplex transfers at 10MHz.
+
+static int phaseSpi(void) {
+  unsigned char buf[64];
+  double t0;
+  int i;
+
+  if (wiringPiSPISetup(0, 10000000) < 0)
+    return 0;                                 // No SPI here - not an error
+
+  sampleReset();
+  for (i = 0; i < 200; i++) {
+    memset(buf, 0x5A, sizeof(buf));
+    t0 = nowNs();
+    if (wiringPiSPIDataRW(0, buf, sizeof(buf)) < 0)
+      return 1;
+    sampleAdd((nowNs() - t0) / 1000.0);
+  }
+  sampleReport("spi_xfer_64B", "us");
+
+  wiringPiSPIClose(0);
+  return 0;
+}
+
+
+// I2C transaction time - only when told which device is safe to read.
+
+static int phaseI2c(void) {
+  const char *addrStr = getenv("WIRINGPI_BENCH_I2C");
+  double t0;
+  int addr, fd, i;
+
+  if (addrStr == NULL)
+    return 0;                                 // Not requested
+
+  addr = (int)strtol(addrStr, NULL, 16);
+  if ((fd = wiringPiI2CSetup(addr)) < 0)
+    return 1;
+
+  sampleReset();
+  for (i = 0; i < 200; i++) {
+    t0 = nowNs();
+    if (wiringPiI2CReadReg8(fd, 0) < 0)
+      return 1;
+    sampleAdd((nowNs() - t0) / 1000.0);
+  }
+  sampleReport("i2c_readreg8", "us");
+  return 0;
+}
+
+
+// softPwm jitter - drive softPwm on the output pin and timestamp the
+// rising edges on the looped-back input; the deviation of the periods
+// from the nominal 10ms is the scheduler-induced jitter.
+
+static int phaseSoftPwm(void) {
+  struct WPIEdgeEvent events[256];
+  int i, n, got;
+
+  if (wiringPiSetupGpio() == -1)
+    return 1;
+
+  pinMode(GPIOIN, INPUT);
+  if (softPwmCreate(GPIO, 50, 100) != 0)
+    return 1;
+  delay(100);                                 // Let the thread settle
+
+  if (wiringPiEdgeCaptureOpen(GPIOIN, INT_EDGE_RISING, 0) < 0) {
+    softPwmStop(GPIO);
+    return 0;                                 // No edge events - skip
+  }
+
+  got = 0;
+  while (got < 200) {
+    n = wiringPiEdgeCaptureRead(GPIOIN, events + got, 256 - got, 3000);
+    if (n <= 0)
+      break;
+    got += n;
+  }
+  wiringPiEdgeCaptureClose(GPIOIN);
+  softPwmStop(GPIO);
+  pinMode(GPIO, INPUT);
+
+  sampleReset();
+  for (i = 1; i < got; i++)
+    sampleAdd((events[i].timeStamp_ns - events[i - 1].timeStamp_ns) / 1000.0 - 10000.0);
+  sampleReport("softpwm_period_jitter", "us");
+  return 0;
+}
+
+
+static const struct {
+  const char *name;
+  int (*run)(void);
+} phases[] = {
+  { "gpiomem", phaseGpiomem },
+  { "gpiod",   phaseGpiod   },
+  { "perf",    phasePerf    },
+  { "isr",     phaseIsr     },
+  { "spi",     phaseSpi     },
+  { "i2c",     phaseI2c     },
+  { "softpwm", phaseSoftPwm },
+};
+
+#define NUM_PHASES ((int)(sizeof(phases) / sizeof(phases[0])))
+
+int main(int argc, char *argv[]) {
+  int i, status, failed = 0;
+  pid_t pid;
+
+  if (argc > 1) {                             // Child: run one phase
+    for (i = 0; i < NUM_PHASES; i++)
+      if (strcmp(argv[1], phases[i].name) == 0)
+        return phases[i].run();
+    fprintf(stderr, "%s: unknown phase %s\n", argv[0], argv[1]);
+    return 1;
+  }
+
+  printf("benchmark,unit,samples,min,mean,p50,p90,p99,max\n");
+  fflush(stdout);
+
+  for (i = 0; i < NUM_PHASES; i++) {
+    if ((pid = fork()) == 0) {
+      execl(argv[0], argv[0], phases[i].name, (char *)NULL);
+      _exit(127);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) < 0)
+      return 1;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "phase %s failed\n", phases[i].name);
+      failed = 1;
+    }
+  }
+
+  return failed;
+}
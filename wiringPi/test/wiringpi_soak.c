@@ -0,0 +1,337 @@
+// WiringPi timing soak monitor
+// Compile: gcc -Wall wiringpi_soak.c -o wiringpi_soak -lwiringPi -lpthread
+//
+// Runs forever measuring the library's timing health and exports rolling
+// histograms in Prometheus text format over a tiny built-in HTTP server,
+// so a fleet dashboard can alarm on regressions after a kernel update:
+//
+//   wiringpi_soak [-p port] [-t seconds]     (default port 9559, -t 0: forever)
+//   curl localhost:9559/metrics
+//
+// Needs BCM19 <-> BCM26 connected (1kOhm) like the other loopback tests.
+// What it measures, alternating one-second cycles:
+//
+//   delay_overshoot_us  - how far delayMicroseconds(100) runs past its target
+//   softpwm_jitter_us   - softPwm edge period error seen through kernel
+//                         timestamps on the loopback pin (scheduler jitter)
+//   isr_rtt_us          - digitalWrite to ISR-callback round trip
+//   micros_backwards    - times micros() went backwards (counter, never ok)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <wiringPi.h>
+#include <softPwm.h>
+
+static int GPIO   = 19;
+static int GPIOIN = 26;
+
+// Rolling log2 histograms, same bucketing idea as WPIIsrStats: bucket i
+// counts samples below (1us << i), the top bucket takes the rest.
+
+#define SOAK_BUCKETS 24
+
+struct soakHist {
+  unsigned long long count;
+  unsigned long long minUs;       // 0 until the first sample
+  unsigned long long maxUs;
+  unsigned long long totalUs;
+  unsigned long long buckets[SOAK_BUCKETS];
+};
+
+static struct soakHist histDelay;     // delayMicroseconds(100) overshoot
+static struct soakHist histSoftPwm;   // softPwm period error
+static struct soakHist histIsrRtt;    // write -> callback round trip
+
+static unsigned long long microsBackwards = 0;
+static unsigned long long cycles = 0;
+
+static pthread_mutex_t histLock = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile int running = 1;
+
+static void histAdd(struct soakHist *h, unsigned long long us) {
+  int bucket;
+
+  pthread_mutex_lock(&histLock);
+  h->count++;
+  h->totalUs += us;
+  if (h->minUs == 0 || us < h->minUs)
+    h->minUs = us;
+  if (us > h->maxUs)
+    h->maxUs = us;
+  for (bucket = 0; bucket < SOAK_BUCKETS - 1; ++bucket)
+    if (us < (1ULL << bucket))
+      break;
+  h->buckets[bucket]++;
+  pthread_mutex_unlock(&histLock);
+}
+
+static unsigned long long nowUs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+// ISR callback - serves both measurement modes. In RTT mode the main
+// thread parks the send timestamp in rttSentUs before each edge; in
+// softPwm mode we histogram the rising-to-rising period error against
+// the expected softPwm cycle.
+
+#define MODE_IDLE    0
+#define MODE_RTT     1
+#define MODE_SOFTPWM 2
+
+static volatile int measureMode = MODE_IDLE;
+static volatile unsigned long long rttSentUs = 0;
+static volatile int rttSeen = 0;
+static unsigned long long lastRisingUs = 0;
+static unsigned long long softPwmPeriodUs = 0;   // expected, set by the soak loop
+
+static void edgeCallback(struct WPIWfiStatus wfiStatus, void *userdata) {
+  (void)userdata;
+
+  switch (measureMode) {
+    case MODE_RTT:
+      if (rttSentUs != 0 && !rttSeen) {
+        histAdd(&histIsrRtt, nowUs() - rttSentUs);
+        rttSeen = 1;
+      }
+      break;
+    case MODE_SOFTPWM:
+      if (wfiStatus.edge == INT_EDGE_RISING) {
+        unsigned long long ts = (unsigned long long)wfiStatus.timeStamp_us;
+        if (lastRisingUs != 0 && softPwmPeriodUs != 0) {
+          unsigned long long period = ts - lastRisingUs;
+          unsigned long long err = (period > softPwmPeriodUs)
+                                 ? period - softPwmPeriodUs
+                                 : softPwmPeriodUs - period;
+          histAdd(&histSoftPwm, err);
+        }
+        lastRisingUs = ts;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// One second of delayMicroseconds(100) overshoot plus a micros()
+// monotonicity check riding along on the same loop.
+
+static void soakDelayPhase(void) {
+  unsigned int lastMicros = micros();
+  int i;
+
+  for (i = 0; i < 1000 && running; ++i) {
+    unsigned long long before = nowUs();
+    unsigned int m;
+
+    delayMicroseconds(100);
+    histAdd(&histDelay, nowUs() - before - 100ULL);
+
+    m = micros();
+    if ((int)(m - lastMicros) < 0) {
+      pthread_mutex_lock(&histLock);
+      microsBackwards++;
+      pthread_mutex_unlock(&histLock);
+    }
+    lastMicros = m;
+  }
+}
+
+// One second of write -> callback round trips, ~100Hz.
+
+static void soakRttPhase(void) {
+  int i;
+
+  measureMode = MODE_RTT;
+  for (i = 0; i < 100 && running; ++i) {
+    digitalWrite(GPIO, LOW);
+    delayMicroseconds(500);
+    rttSeen = 0;
+    rttSentUs = nowUs();
+    digitalWrite(GPIO, HIGH);
+    delayMicroseconds(9500);        // callback fires well within this
+  }
+  rttSentUs = 0;
+  measureMode = MODE_IDLE;
+}
+
+// One second of softPwm on the loopback pin: 50/100 at the default 100us
+// step is a 10ms cycle, and every rising edge lets the callback compare
+// the achieved period against it.
+
+static void soakSoftPwmPhase(void) {
+  softPwmCreate(GPIO, 50, 100);
+  softPwmPeriodUs = 10000;
+  lastRisingUs = 0;
+  measureMode = MODE_SOFTPWM;
+  delay(1000);
+  measureMode = MODE_IDLE;
+  softPwmStop(GPIO);
+  softPwmPeriodUs = 0;
+  pinMode(GPIO, OUTPUT);            // back for the RTT phase
+  digitalWrite(GPIO, LOW);
+}
+
+// Prometheus text rendering - cumulative le buckets as the format wants.
+
+static void renderHist(FILE *f, const char *name, const struct soakHist *h) {
+  unsigned long long cum = 0;
+  int i;
+
+  fprintf(f, "# TYPE wiringpi_soak_%s histogram\n", name);
+  for (i = 0; i < SOAK_BUCKETS - 1; ++i) {
+    cum += h->buckets[i];
+    fprintf(f, "wiringpi_soak_%s_bucket{le=\"%llu\"} %llu\n", name, 1ULL << i, cum);
+  }
+  cum += h->buckets[SOAK_BUCKETS - 1];
+  fprintf(f, "wiringpi_soak_%s_bucket{le=\"+Inf\"} %llu\n", name, cum);
+  fprintf(f, "wiringpi_soak_%s_sum %llu\n", name, h->totalUs);
+  fprintf(f, "wiringpi_soak_%s_count %llu\n", name, h->count);
+  fprintf(f, "# TYPE wiringpi_soak_%s_min gauge\n", name);
+  fprintf(f, "wiringpi_soak_%s_min %llu\n", name, h->minUs);
+  fprintf(f, "# TYPE wiringpi_soak_%s_max gauge\n", name);
+  fprintf(f, "wiringpi_soak_%s_max %llu\n", name, h->maxUs);
+}
+
+static void serveMetrics(int clientFd) {
+  char *body = NULL;
+  size_t bodyLen = 0;
+  FILE *f = open_memstream(&body, &bodyLen);
+  char header[128];
+  char request[512];
+
+  if (f == NULL)
+    return;
+
+  // we answer every request with the metrics page - there's nothing else
+  (void)!read(clientFd, request, sizeof(request));
+
+  pthread_mutex_lock(&histLock);
+  renderHist(f, "delay_overshoot_us", &histDelay);
+  renderHist(f, "softpwm_jitter_us", &histSoftPwm);
+  renderHist(f, "isr_rtt_us", &histIsrRtt);
+  fprintf(f, "# TYPE wiringpi_soak_micros_backwards_total counter\n");
+  fprintf(f, "wiringpi_soak_micros_backwards_total %llu\n", microsBackwards);
+  fprintf(f, "# TYPE wiringpi_soak_cycles_total counter\n");
+  fprintf(f, "wiringpi_soak_cycles_total %llu\n", cycles);
+  pthread_mutex_unlock(&histLock);
+  fclose(f);
+
+  snprintf(header, sizeof(header),
+           "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+           bodyLen);
+  (void)!write(clientFd, header, strlen(header));
+  (void)!write(clientFd, body, bodyLen);
+  free(body);
+}
+
+static int listenOn(int port) {
+  struct sockaddr_in addr;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+
+  if (fd < 0)
+    return -1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void pollHttp(int listenFd) {
+  struct pollfd p = { listenFd, POLLIN, 0 };
+
+  while (poll(&p, 1, 0) > 0) {
+    int clientFd = accept(listenFd, NULL, NULL);
+    if (clientFd < 0)
+      break;
+    serveMetrics(clientFd);
+    close(clientFd);
+  }
+}
+
+static void onSigint(int signum) {
+  (void)signum;
+  running = 0;
+}
+
+int main(int argc, char *argv[]) {
+  int port = 9559;
+  int seconds = 0;
+  int listenFd;
+  int opt;
+  time_t start;
+
+  while ((opt = getopt(argc, argv, "p:t:")) != -1) {
+    switch (opt) {
+      case 'p': port = atoi(optarg); break;
+      case 't': seconds = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-p port] [-t seconds]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (wiringPiSetupGpio() == -1) {
+    fprintf(stderr, "%s: wiringPiSetupGpio failed\n", argv[0]);
+    return 1;
+  }
+
+  pinMode(GPIO, OUTPUT);
+  digitalWrite(GPIO, LOW);
+  pinMode(GPIOIN, INPUT);
+  if (wiringPiEventLoopAdd(GPIOIN, INT_EDGE_BOTH, &edgeCallback, 0, NULL) < 0) {
+    fprintf(stderr, "%s: cannot watch BCM%d (loopback from BCM%d)\n", argv[0], GPIOIN, GPIO);
+    return 1;
+  }
+
+  listenFd = listenOn(port);
+  if (listenFd < 0) {
+    fprintf(stderr, "%s: cannot listen on port %d: %s\n", argv[0], port, strerror(errno));
+    return 1;
+  }
+  printf("%s: metrics on http://localhost:%d/metrics (BCM%d -> BCM%d loopback)\n",
+         argv[0], port, GPIO, GPIOIN);
+
+  signal(SIGINT, onSigint);
+  start = time(NULL);
+
+  while (running) {
+    soakDelayPhase();
+    pollHttp(listenFd);
+    soakRttPhase();
+    pollHttp(listenFd);
+    soakSoftPwmPhase();
+    pollHttp(listenFd);
+
+    pthread_mutex_lock(&histLock);
+    cycles++;
+    pthread_mutex_unlock(&histLock);
+
+    if (seconds > 0 && time(NULL) - start >= seconds)
+      break;
+  }
+
+  wiringPiEventLoopRemove(GPIOIN);
+  close(listenFd);
+  return 0;
+}
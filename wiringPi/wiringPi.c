@@ -74,13 +74,24 @@
 #include <byteswap.h>
 #include <sys/utsname.h>
 #include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <semaphore.h>
 #include <dirent.h>
 #include <inttypes.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#if defined (__aarch64__) && defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "softPwm.h"
 #include "softTone.h"
 
 #include "wiringPi.h"
+#include "wiringPiTrace.h"
+#include "wiringPiUring.h"
 #include "../version.h"
 #include "wiringPiLegacy.h"
 
@@ -89,6 +100,7 @@
 #define	ENV_DEBUG	"WIRINGPI_DEBUG"
 #define	ENV_CODES	"WIRINGPI_CODES"
 #define	ENV_GPIOMEM	"WIRINGPI_GPIOMEM"
+#define	ENV_SIM_FILE	"WIRINGPI_SIM_FILE"
 
 
 // Extend wiringPi with other pin-based devices and keep track of
@@ -149,7 +161,8 @@ const unsigned int RP1_RIO_OUT = 0x0000;
 const unsigned int RP1_RIO_OE  = (0x0004/4);
 const unsigned int RP1_RIO_IN  = (0x0008/4);
 
-//RP1 chip (@Pi5) RIO offset for set/clear value
+//RP1 chip (@Pi5) RIO offset for xor/set/clear value
+const unsigned int RP1_XOR_OFFSET = (0x1000/4);
 const unsigned int RP1_SET_OFFSET = (0x2000/4);
 const unsigned int RP1_CLR_OFFSET = (0x3000/4);
 
@@ -254,6 +267,30 @@ static volatile unsigned int GPIO_RIO ;
 static unsigned int usingGpioMem    = FALSE ;
 static          int wiringPiSetuped = FALSE ;
 
+// Concurrent first-call guard: the setup entry points serialise on this
+//	mutex and publish wiringPiSetupDone with release semantics only
+//	once a setup has fully completed - so two threads (or plugins)
+//	calling a setup function at the same time no longer race on the
+//	mmaps, and the post-setup fast path is one acquire load.
+
+static          int wiringPiSetupDone  = FALSE ;
+
+// Setup profile, applied by wiringPiSetupEx() before the real setup runs.
+//	The plain wiringPiSetup*() entry points never touch these, so they
+//	keep their historical behaviour: timer mapped, everything else lazy.
+
+static unsigned int wiringPiSetupSubsystems = WPI_SETUP_TIMER ;
+static          int wiringPiSetupGpioMemPreferred = FALSE ;
+static pthread_mutex_t wiringPiSetupMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+// Simulation backend - in WPI_MODE_SIM the pin state lives in this
+//	mmap'd shared page rather than hardware registers, so reads and
+//	writes are plain memory operations a harness process can observe
+
+#define	WPI_SIM_DEFAULT_FILE	"/dev/shm/wiringpi-sim"
+
+static struct WPISimState *simState = NULL ;
+
 // PWM
 //	Word offsets into the PWM control region
 
@@ -264,6 +301,12 @@ static          int wiringPiSetuped = FALSE ;
 #define	PWM1_RANGE  8
 #define	PWM1_DATA   9
 
+#define	PWM_FIFO    6
+
+#define	PWM_STA_FULL	0x0001  // FIFO full
+#define	PWM_STA_EMPT	0x0002  // FIFO empty
+#define	PWM_CLRFIFO	0x0040  // Clear the FIFO (control register)
+
 //	Clock regsiter offsets
 
 #define	PWMCLK_CNTL	40
@@ -498,6 +541,59 @@ static pthread_t isrThreads[64];
 static int isrEdgeMode[64];             // irq on rising/falling edge
 static unsigned long isrDebouncePeriodUs[64];      // 0: debounce is off
 
+// Software debounce fallback: used when the kernel rejects the debounce
+//	line attribute (pre-5.10ish kernels). Filtering happens on the kernel
+//	timestamps already in hand, so it costs no extra syscall.
+static unsigned long isrSoftDebounceUs[64];
+static unsigned long long isrLastEdgeNs[64];
+
+// Fast ISR teardown: each reader thread polls a per-pin eventfd next to
+//	its line fd, so wiringPiISRStop() is one write plus a join - done in
+//	microseconds where pthread_cancel took milliseconds and left the fd
+//	state ambiguous. The line request survives the stop (isrLineEdgeMode
+//	and isrLineDebounceUs remember how it was configured) so a re-register
+//	with the same parameters adopts it instead of re-issuing the ioctl.
+static int isrStopFds [64] =
+{
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+} ;
+static int isrLineEdgeMode [64] ;		// configuration the cached line request was made with
+static unsigned long isrLineDebounceUs [64] ;
+static int isrLineSoftDebounce [64] ;		// it fell back to timestamp filtering
+
+// Reader thread scheduling, set by wiringPiISR2Sched() and applied by the
+//	thread to itself before the first event. isrSchedSet gates it so a
+//	plain wiringPiISR registration keeps the historical piHiPri(55).
+static struct WPIIsrSched isrSched [64] ;
+static int isrSchedSet [64] ;
+
+// Kernel event buffer depth and overflow accounting. We ask for 45 events
+//	per line request; kHz burst sources overflow that before the reader
+//	wakes, so wiringPiISRBufferSize() lets the user trade memory for
+//	loss-free absorption. A gap in the kernel's per-line seqno means
+//	events were dropped kernel-side - counted per pin, written only by
+//	the thread dispatching that pin.
+static unsigned int isrEventBufferSize [64] ;	// 0: the built-in default
+static unsigned int isrLineBufferSize [64] ;	// what the cached request was made with
+static unsigned int isrLostEvents [64] ;
+static unsigned int isrLastSeqno [64] ;
+
+// ISR latency histograms - each written only by the thread dispatching
+//	that pin's callbacks (plain stores, no locks); readers snapshot
+static struct WPIIsrStats isrStats [64] ;
+static int isrStatsEnabled [64] ;
+
+// Queued ISR delivery (see the isrEventQueue block further down)
+struct isrEventQueue ;
+static struct isrEventQueue *isrQueues [64] ;
+static int       isrQueued [64] ;
+static sem_t     isrQueueSem ;
+static pthread_t isrDispatchThread ;
+static int       isrDispatchRunning = FALSE ;
+
 // Doing it the Arduino way with lookup tables...
 //	Yes, it's probably more innefficient than all the bit-twidling, but it
 //	does tend to make it all a bit clearer. At least to me!
@@ -506,11 +602,11 @@ static unsigned long isrDebouncePeriodUs[64];      // 0: debounce is off
 //	Take a Wiring pin (0 through X) and re-map it to the BCM_GPIO pin
 //	Cope for 3 different board revisions here.
 
-static int *pinToGpio ;
+static const int *pinToGpio ;
 
 // Revision 1, 1.1:
 
-static int pinToGpioR1 [64] =
+static const int pinToGpioR1 [64] =
 {
   17, 18, 21, 22, 23, 24, 25, 4,	// From the Original Wiki - GPIO 0 through 7:	wpi  0 -  7
    0,  1,				// I2C  - SDA1, SCL1				wpi  8 -  9
@@ -527,7 +623,7 @@ static int pinToGpioR1 [64] =
 
 // Revision 2:
 
-static int pinToGpioR2 [64] =
+static const int pinToGpioR2 [64] =
 {
   17, 18, 27, 22, 23, 24, 25, 4,	// From the Original Wiki - GPIO 0 through 7:	wpi  0 -  7
    2,  3,				// I2C  - SDA0, SCL0				wpi  8 -  9
@@ -551,9 +647,9 @@ static int pinToGpioR2 [64] =
 //	Cope for 2 different board revisions here.
 //	Also add in the P5 connector, so the P5 pins are 3,4,5,6, so 53,54,55,56
 
-static int *physToGpio ;
+static const int *physToGpio ;
 
-static int physToGpioR1 [64] =
+static const int physToGpioR1 [64] =
 {
   -1,		// 0
   -1, -1,	// 1, 2
@@ -575,7 +671,7 @@ static int physToGpioR1 [64] =
   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,	// ... 63
 } ;
 
-static int physToGpioR2 [64] =
+static const int physToGpioR2 [64] =
 {
   -1,		// 0
   -1, -1,	// 1, 2
@@ -676,29 +772,6 @@ int GetMaxPin() {
 }
 
 
-int ToBCMPin(int* pin) {
-  if (*pin<0 || *pin>63) {
-    return FALSE;
-  }
-  switch(wiringPiMode) {
-    case WPI_MODE_PINS:
-      *pin = pinToGpio[*pin];
-      break;
-    case WPI_MODE_PHYS:
-      *pin = physToGpio[*pin];
-      break;
-    case WPI_MODE_GPIO:
-      return TRUE;
-    default:
-      return FALSE;
-  }
-  if (piRP1Model() && *pin>27) {
-    return FALSE;
-  }
-  return TRUE;
-}
-
-
 #define RETURN_ON_MODEL5 if (piRP1Model()) { if (wiringPiDebug) printf("Function not supported on Pi5\n");  return; }
 
 int FailOnModel5(const char *function) {
@@ -768,6 +841,100 @@ static uint8_t gpioToGPLEV [] =
 } ;
 
 
+// pinDesc:
+//	The tables above answer one question each, so a digitalWrite was
+//	pulling its register offset and its bit mask from different cache
+//	lines (and pinMode from two more). This packs everything a pin
+//	operation needs into one 12-byte descriptor - four pins per cache
+//	line - built once at setup and used by the hot paths on BCM and
+//	RP1 alike (the RP1 rio interface only wants the mask).
+//	The pin-numbering translations live here too: the selected layout's
+//	pinToGpio/physToGpio columns are folded in as single bytes (0xFF
+//	for "no such pin"), so translating never leaves the descriptor.
+
+struct wpiPinDesc
+{
+  uint8_t  setOff ;	// GPSET register, word offset
+  uint8_t  clrOff ;	// GPCLR
+  uint8_t  levOff ;	// GPLEV
+  uint8_t  fselOff ;	// GPFSEL
+  uint8_t  shift ;	// shift within the FSEL register
+  uint8_t  toBcm ;	// active mode's pin -> BCM, 0xFF if none
+  uint8_t  wpiToBcm ;	// wiringPi pin -> BCM for this layout
+  uint8_t  physToBcm ;	// physical pin -> BCM for this layout
+  uint32_t mask ;	// 1 << (pin & 31)
+} ;
+
+static struct wpiPinDesc pinDesc [64] ;
+
+static void initPinDescriptors (void)
+{
+  for (int pin = 0 ; pin < 64 ; ++pin)
+  {
+    pinDesc [pin].setOff  = gpioToGPSET [pin] ;
+    pinDesc [pin].clrOff  = gpioToGPCLR [pin] ;
+    pinDesc [pin].levOff  = gpioToGPLEV [pin] ;
+    pinDesc [pin].fselOff = pin / 10 ;		// as gpioToGPFSEL/gpioToShift,
+    pinDesc [pin].shift   = (pin % 10) * 3 ;	//  which stop at pin 59
+    pinDesc [pin].mask    = 1u << (pin & 31) ;
+    pinDesc [pin].toBcm   = 0xFF ;		// until the layout/mode is known
+  }
+}
+
+
+// wiringPiSelectLayout:
+//	Point the translation tables at the right board revision and fold
+//	them into the pin descriptors. Only the chosen revision's numbers
+//	end up in writable memory - the int tables themselves are const
+//	now, so the inactive layout never leaves the (shared) text pages.
+
+static void wiringPiSelectLayout (int layout)
+{
+  if (layout == GPIO_LAYOUT_PI1_REV1)
+  {
+    pinToGpio  = pinToGpioR1 ;
+    physToGpio = physToGpioR1 ;
+  }
+  else
+  {
+    pinToGpio  = pinToGpioR2 ;
+    physToGpio = physToGpioR2 ;
+  }
+
+  for (int pin = 0 ; pin < 64 ; ++pin)
+  {
+    pinDesc [pin].wpiToBcm  = (pinToGpio  [pin] < 0) ? 0xFF : (uint8_t)pinToGpio  [pin] ;
+    pinDesc [pin].physToBcm = (physToGpio [pin] < 0) ? 0xFF : (uint8_t)physToGpio [pin] ;
+  }
+}
+
+
+int ToBCMPin(int* pin) {
+  uint8_t bcm;
+
+  if (*pin<0 || *pin>63) {
+    return FALSE;
+  }
+  switch(wiringPiMode) {
+    case WPI_MODE_PINS:
+      bcm = pinDesc[*pin].wpiToBcm;
+      break;
+    case WPI_MODE_PHYS:
+      bcm = pinDesc[*pin].physToBcm;
+      break;
+    case WPI_MODE_GPIO:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+  *pin = (bcm==0xFF) ? -1 : bcm;
+  if (piRP1Model() && *pin>27) {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
 #ifdef notYetReady
 // gpioToEDS
 //	(Word) offset to the Event Detect Status
@@ -934,6 +1101,43 @@ int wiringPiFailure (int fatal, const char *message, ...)
 }
 
 
+/*
+ * wiringPiSetErrorHandler:
+ * wiringPiError:
+ *	Non-fatal error reporting. The historical behaviour is an fprintf
+ *	to stderr, but stderr is often journald-backed these days and a
+ *	blocking write there from a fast loop can stall the caller for
+ *	hundreds of milliseconds. A program that cares installs a handler
+ *	and gets the error code and formatted message with no stdio
+ *	involved - it can rate-limit, count or hand off to a cold thread
+ *	as it sees fit. NULL restores the stderr behaviour.
+ *********************************************************************************
+ */
+
+static wiringPiErrorHandler wiringPiErrorCb = NULL ;
+
+void wiringPiSetErrorHandler (wiringPiErrorHandler handler)
+{
+  __atomic_store_n (&wiringPiErrorCb, handler, __ATOMIC_RELEASE) ;
+}
+
+void wiringPiError (int code, const char *message, ...)
+{
+  va_list argp ;
+  char buffer [1024] ;
+  wiringPiErrorHandler handler = __atomic_load_n (&wiringPiErrorCb, __ATOMIC_ACQUIRE) ;
+
+  va_start (argp, message) ;
+    vsnprintf (buffer, 1023, message, argp) ;
+  va_end (argp) ;
+
+  if (handler != NULL)
+    handler (code, buffer) ;
+  else
+    fprintf (stderr, "%s\n", buffer) ;
+}
+
+
 /*
  * setupCheck
  *	Another sanity check because some users forget to call the setup
@@ -969,6 +1173,234 @@ static void usingGpioMemCheck (const char *what)
 }
 
 
+/*
+ * The RP1 kernel PWM fallback:
+ *	The PWM0 block (0x40098000) sits below the window that /dev/gpiomem0
+ *	maps, so an unprivileged program on a Pi 5 has no register access to
+ *	it. The kernel's own rp1 driver does though, and exposes it as a
+ *	4-channel pwmchip in sysfs. When we're running from gpiomem the pwm*
+ *	calls fold their divisor/range/duty state into a period and
+ *	duty_cycle in nanoseconds and drive that chip instead - the waveform
+ *	still comes from the RP1 hardware, so nothing here burns CPU.
+ *********************************************************************************
+ */
+
+#define	RP1_SYSPWM_CHANNELS	4
+
+static char rp1SysPwmChip [40] ;			// sysfs path of the RP1 pwmchip
+static int  rp1SysPwmFound = -1 ;			// -1: not probed yet
+static unsigned int rp1SysPwmRange   = 1024 ;		// mirrors the register defaults
+static unsigned int rp1SysPwmDivisor = 32 ;
+static unsigned int rp1SysPwmDuty     [RP1_SYSPWM_CHANNELS] ;
+static int          rp1SysPwmActive   [RP1_SYSPWM_CHANNELS] ;
+static unsigned long long rp1SysPwmPeriodNs [RP1_SYSPWM_CHANNELS] ;
+
+static int rp1SysPwmWriteAttr (int channel, const char *attr, unsigned long long value)
+{
+  char path [80], buf [24] ;
+  int fd, len ;
+
+  if (channel < 0)					// a chip-level attribute
+    snprintf (path, sizeof (path), "%s/%s", rp1SysPwmChip, attr) ;
+  else
+    snprintf (path, sizeof (path), "%s/pwm%d/%s", rp1SysPwmChip, channel, attr) ;
+
+  if ((fd = open (path, O_WRONLY)) < 0)
+    return -1 ;
+  len = snprintf (buf, sizeof (buf), "%llu", value) ;
+  if (write (fd, buf, len) != len)
+  {
+    close (fd) ;
+    return -1 ;
+  }
+  close (fd) ;
+  return 0 ;
+}
+
+static int rp1SysPwmUse (void)
+{
+  char path [64], buf [8] ;
+  int chip, fd, n ;
+
+  if (!piRP1Model () || (pwm != NULL) || !usingGpioMem)
+    return FALSE ;					// registers (or no RP1): not for us
+  if (rp1SysPwmFound >= 0)
+    return rp1SysPwmFound ;
+
+  rp1SysPwmFound = FALSE ;
+  for (chip = 0 ; chip < 8 ; ++chip)			// the chip number depends on probe order
+  {
+    snprintf (path, sizeof (path), "/sys/class/pwm/pwmchip%d/npwm", chip) ;
+    if ((fd = open (path, O_RDONLY)) < 0)
+      continue ;
+    n = read (fd, buf, sizeof (buf) - 1) ;
+    close (fd) ;
+    if (n <= 0)
+      continue ;
+    buf [n] = 0 ;
+    if (atoi (buf) == RP1_SYSPWM_CHANNELS)		// the RP1 PWM0 block
+    {
+      snprintf (rp1SysPwmChip, sizeof (rp1SysPwmChip), "/sys/class/pwm/pwmchip%d", chip) ;
+      rp1SysPwmFound = TRUE ;
+      break ;
+    }
+  }
+  if (wiringPiDebug)
+    printf ("wiringPi: RP1 pwmchip %s\n", rp1SysPwmFound ? rp1SysPwmChip : "not found in sysfs") ;
+  return rp1SysPwmFound ;
+}
+
+static void rp1SysPwmApply (int channel)
+{
+  unsigned long long periodNs, dutyNs ;
+  unsigned int duty, divisor, range ;
+  char path [64] ;
+
+  snprintf (path, sizeof (path), "%s/pwm%d", rp1SysPwmChip, channel) ;
+  if ((access (path, F_OK) != 0) && (rp1SysPwmWriteAttr (-1, "export", channel) != 0))
+  {
+    wiringPiError (WPI_ERROR_IO, "wiringPi: export of RP1 pwmchip channel %d failed (%s)", channel, strerror (errno)) ;
+    return ;
+  }
+
+  range   = (rp1SysPwmRange   > 0) ? rp1SysPwmRange   : 1 ;
+  divisor = (rp1SysPwmDivisor > 0) ? rp1SysPwmDivisor : 1 ;
+  duty    = rp1SysPwmDuty [channel] ;
+  if (duty > range)
+    duty = range ;					// the driver rejects duty > period
+
+// One PWM tick is divisor / 19.2MHz, as on the register path (OSC is in x100kHz)
+
+  periodNs = ((unsigned long long)divisor * range * 10000ULL) / OSC_FREQ_DEFAULT ;
+  dutyNs   = ((unsigned long long)divisor * duty  * 10000ULL) / OSC_FREQ_DEFAULT ;
+
+  if (periodNs != rp1SysPwmPeriodNs [channel])
+  {
+    rp1SysPwmWriteAttr (channel, "duty_cycle", 0) ;	// keep duty <= period across the change
+    if (rp1SysPwmWriteAttr (channel, "period", periodNs) == 0)
+      rp1SysPwmPeriodNs [channel] = periodNs ;
+  }
+  rp1SysPwmWriteAttr (channel, "duty_cycle", dutyNs) ;
+  rp1SysPwmWriteAttr (channel, "enable", rp1SysPwmActive [channel] ? 1 : 0) ;
+}
+
+static void rp1SysPwmStop (int channel)
+{
+  rp1SysPwmActive [channel] = FALSE ;
+  rp1SysPwmWriteAttr (channel, "enable", 0) ;
+}
+
+
+/*
+ * The function-select shadow:
+ *	Every pinMode/pullUpDnControl used to read the live GPFSEL (or RP1
+ *	pad) register before masking its bits back in, and an uncached
+ *	peripheral read costs a good 100ns - which matters once a matrix
+ *	scanner starts flipping pin directions thousands of times a second.
+ *	We own these registers after setup, so keep a shadow of the last
+ *	value instead: a register is read once on first touch and a
+ *	direction flip is then just the masked write. Anything outside the
+ *	library (another process, a kernel driver) that changes them behind
+ *	our back calls for wiringPiFselResync(), which drops the lot.
+ *********************************************************************************
+ */
+
+static uint32_t fselShadow [6] ;
+static unsigned int fselShadowValid = 0 ;	// bit per GPFSEL register
+static uint32_t rp1PadShadow [64] ;
+static uint64_t rp1PadShadowValid = 0 ;		// bit per pin
+
+static unsigned int fselRead (int reg)
+{
+  if (!(fselShadowValid & (1u << reg)))
+  {
+    fselShadow [reg] = *(gpio + reg) ;
+    fselShadowValid |= 1u << reg ;
+  }
+  return fselShadow [reg] ;
+}
+
+static void fselWrite (int reg, unsigned int value)
+{
+  fselShadow [reg] = value ;
+  fselShadowValid |= 1u << reg ;
+  *(gpio + reg) = value ;
+}
+
+static unsigned int rp1PadRead (int pin)
+{
+  if (!(rp1PadShadowValid & (1ULL << pin)))
+  {
+    rp1PadShadow [pin] = pads [1 + pin] ;
+    rp1PadShadowValid |= 1ULL << pin ;
+  }
+  return rp1PadShadow [pin] ;
+}
+
+static void rp1PadWrite (int pin, unsigned int value)
+{
+  rp1PadShadow [pin] = value ;
+  rp1PadShadowValid |= 1ULL << pin ;
+  pads [1 + pin] = value ;
+}
+
+void wiringPiFselResync (void)
+{
+  fselShadowValid   = 0 ;
+  rp1PadShadowValid = 0 ;
+}
+
+
+/*
+ * bcmEnsureMapped:
+ *	Map one of the BCM peripheral blocks on first use. wiringPiSetup()
+ *	only maps the GPIO and timer blocks eagerly these days - most
+ *	programs never touch PWM, the clocks or the pads, so their mmaps
+ *	(and the TLB pressure) are deferred until something actually asks.
+ *	The RP1 maps one contiguous block anyway, so this is BCM-only.
+ *********************************************************************************
+ */
+
+static int wiringPiMmapFd = -1 ;	// kept open for the lazy mappings
+
+static volatile unsigned int *bcmEnsureMapped (volatile unsigned int **block, unsigned int addr, const char *what)
+{
+  if (*block != NULL)
+    return *block ;
+  if (wiringPiMmapFd < 0)
+    return NULL ;
+
+  *block = (unsigned int *)mmap (0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, wiringPiMmapFd, addr) ;
+  if (*block == MAP_FAILED)
+  {
+    *block = NULL ;
+    (void)wiringPiFailure (WPI_ALMOST, "wiringPi: mmap (%s) failed: %s\n", what, strerror (errno)) ;
+  }
+  return *block ;
+}
+
+static volatile unsigned int *bcmPwm (void)
+{
+  volatile unsigned int *p = bcmEnsureMapped (&pwm, GPIO_PWM, "PWM") ;
+  _wiringPiPwm = pwm ;
+  return p ;
+}
+
+static volatile unsigned int *bcmClk (void)
+{
+  volatile unsigned int *p = bcmEnsureMapped (&clk, GPIO_CLOCK_ADR, "CLOCK") ;
+  _wiringPiClk = clk ;
+  return p ;
+}
+
+static volatile unsigned int *bcmPads (void)
+{
+  volatile unsigned int *p = bcmEnsureMapped (&pads, GPIO_PADS, "PADS") ;
+  _wiringPiPads = pads ;
+  return p ;
+}
+
+
 void PrintSystemStdErr () {
   struct utsname sys_info;
   if (uname(&sys_info) == 0) {
@@ -1048,14 +1480,12 @@ int piGpioLayout (void)
 
 /*
  * piBoardRev:
- *	Deprecated, but does the same as piGpioLayout
+ *	Deprecated - a link-time alias of piGpioLayout, so the old entry
+ *	point costs exactly what the new one does.
  *********************************************************************************
  */
 
-int piBoardRev (void)
-{
-  return piGpioLayout () ;
-}
+int piBoardRev (void) __attribute__ ((alias ("piGpioLayout"))) ;
 
 const char* GetPiRevision(char* line, int linelength, unsigned int* revision) {
 
@@ -1152,6 +1582,13 @@ const char* GetPiRevision(char* line, int linelength, unsigned int* revision) {
  *********************************************************************************
  */
 
+// The decoded board identity never changes while we're running, so keep it
+//	around after the first successful decode - callers like the gpio tool
+//	ask several times and the device-tree read is by far the slowest part
+//	of wiringPiSetup().
+
+static int cachedBoardRev, cachedBoardMem, cachedBoardMaker, cachedBoardWarranty ;
+
 void piBoardId (int *model, int *rev, int *mem, int *maker, int *warranty)
 {
   const int maxlength = 120;
@@ -1160,6 +1597,16 @@ void piBoardId (int *model, int *rev, int *mem, int *maker, int *warranty)
   unsigned int revision = 0x00 ;
   int bRev, bType, bProc, bMfg, bMem, bWarranty ;
 
+  if (RaspberryPiModel >= 0)	// Already decoded once
+  {
+    *model    = RaspberryPiModel ;
+    *rev      = cachedBoardRev ;
+    *mem      = cachedBoardMem ;
+    *maker    = cachedBoardMaker ;
+    *warranty = cachedBoardWarranty ;
+    return ;
+  }
+
   //piGpioLayoutOops ("this is only a test case");
 
   c = GetPiRevision(line, maxlength,  &revision); // device tree
@@ -1251,6 +1698,10 @@ void piBoardId (int *model, int *rev, int *mem, int *maker, int *warranty)
   }
 
   RaspberryPiModel = *model;
+  cachedBoardRev      = *rev ;
+  cachedBoardMem      = *mem ;
+  cachedBoardMaker    = *maker ;
+  cachedBoardWarranty = *warranty ;
 
   switch (RaspberryPiModel){
     case PI_MODEL_A:
@@ -1329,7 +1780,7 @@ void setPadDrivePin (int pin, int value) {
   uint32_t wrVal;
   value = value & 3; // 0-3 supported
   wrVal = (value << 4); //Drive strength 0-3
-  pads[1+pin] = (pads[1+pin] & RP1_INV_PAD_DRIVE_MASK) | wrVal;
+  rp1PadWrite(pin, (rp1PadRead(pin) & RP1_INV_PAD_DRIVE_MASK) | wrVal);
   if (wiringPiDebug) {
     printf ("setPadDrivePin: pin: %d, value: %d (%08X)\n", pin, value, pads[1+pin]) ;
   }
@@ -1369,10 +1820,14 @@ void setPadDrive (int group, int value)
       wrVal = (value << 4); //Drive strength 0-3
       //set for all pins even when it's avaiable for each pin separately
       for (int pin=0, maxpin=GetMaxPin(); pin<=maxpin; ++pin) {
-        pads[1+pin] = (pads[1+pin] & RP1_INV_PAD_DRIVE_MASK) | wrVal;
+        rp1PadWrite(pin, (rp1PadRead(pin) & RP1_INV_PAD_DRIVE_MASK) | wrVal);
       }
       rdVal = pads[1+17]; // only pin 17 readback, for logging
     } else {
+      if (!bcmPads()) {
+        fprintf(stderr, "wiringPi: setPadDrive but no pads memory available, ignoring\n");
+        return;
+      }
       if (-1==group) {
         printf ("Pad register: Group 0: 0x%08X, Group 1: 0x%08X, Group 2: 0x%08X\n", *(pads + 0 + 11), *(pads + 1 + 11), *(pads + 2 + 11)) ;
       }
@@ -1445,10 +1900,10 @@ int getAlt (int pin)
       default:return alt;
     }
   } else {
-    int fSel    = gpioToGPFSEL [pin] ;
-    int shift   = gpioToShift  [pin] ;
+    int fSel    = pinDesc [pin].fselOff ;
+    int shift   = pinDesc [pin].shift ;
 
-    alt = (*(gpio + fSel) >> shift) & 7 ;
+    alt = (fselRead (fSel) >> shift) & 7 ;
   }
   return alt;
 }
@@ -1475,6 +1930,10 @@ void pwmSetMode (int mode)
       }
       return;
     }
+    if (!bcmPwm()) {
+      fprintf(stderr, "wiringPi: pwmSetMode but no pwm memory available, ignoring\n");
+      return;
+    }
     if (mode == PWM_MODE_MS) {
       *(pwm + PWM_CONTROL) = PWM0_ENABLE | PWM1_ENABLE | PWM0_MS_MODE | PWM1_MS_MODE ;
     } else {
@@ -1503,7 +1962,19 @@ void pwmSetRange (unsigned int range)
       range = (OSC_FREQ_BCM2711*range)/OSC_FREQ_DEFAULT;
     }
     */
+    if (!piRP1Model()) {
+      bcmPwm();
+    }
     if (!pwm) {
+      if (rp1SysPwmUse()) {		// Pi 5 from gpiomem: the kernel driver has the block
+        rp1SysPwmRange = range;
+        for (int channel = 0; channel < RP1_SYSPWM_CHANNELS; channel++) {
+          if (rp1SysPwmActive[channel]) {
+            rp1SysPwmApply(channel);
+          }
+        }
+        return;
+      }
       fprintf(stderr, "wiringPi: pwmSetRange but no pwm memory available, ignoring\n");
       return;
     }
@@ -1537,7 +2008,29 @@ void pwmSetRange (unsigned int range)
 void pwmSetClock (int divisor)
 {
   uint32_t pwm_control ;
-  if (!clk) {
+  if (!piRP1Model()) {
+    bcmPwm();
+    bcmClk();
+  }
+  if (!clk || (!piRP1Model() && !pwm)) {
+      if (rp1SysPwmUse()) {		// Pi 5 from gpiomem: the kernel driver has the block
+        if (divisor > PWMCLK_DIVI_MAX) {
+          divisor = PWMCLK_DIVI_MAX;
+        }
+        if (divisor >= 1) {
+          rp1SysPwmDivisor = divisor;
+        }
+        for (int channel = 0; channel < RP1_SYSPWM_CHANNELS; channel++) {
+          if (rp1SysPwmActive[channel]) {
+            if (divisor < 1) {		// 0 = disable, as on the register path
+              rp1SysPwmWriteAttr(channel, "enable", 0);
+            } else {
+              rp1SysPwmApply(channel);
+            }
+          }
+        }
+        return;
+      }
       fprintf(stderr, "wiringPi: pwmSetClock but no clk memory available, ignoring\n");
       return;
   }
@@ -1629,6 +2122,10 @@ void gpioClockSet (int pin, int freq)
   if (divi > PWMCLK_DIVI_MAX) {
     divi = PWMCLK_DIVI_MAX;
   }
+  if (!bcmClk()) {
+    fprintf(stderr, "wiringPi: gpioClockSet but no clk memory available, ignoring\n");
+    return;
+  }
   *(clk + gpioToClkCon [pin]) = BCM_PASSWORD | GPIO_CLOCK_SOURCE ;		// Stop GPIO Clock
   while ((*(clk + gpioToClkCon [pin]) & 0x80) != 0)				// ... and wait
     ;
@@ -1639,58 +2136,246 @@ void gpioClockSet (int pin, int freq)
 
 
 /*
- * wiringPiFindNode:
- *      Locate our device node
+ * The extension arena:
+ *	Node structs and the little strings the extension parser produces
+ *	are small, long-lived allocations, and a daemon that hot-plugs
+ *	extensions for months peppers its heap with them - fragmentation
+ *	plus a steady leak, since the parser's strings were never freed.
+ *	They all come from chunked arenas now: allocation is a bump of a
+ *	pointer inside a page-sized chunk, nothing is freed piecemeal, and
+ *	wiringPiExtensionArenaReset() hands the whole lot back at once.
+ *	Allocations are zeroed, like the callocs they replace.
  *********************************************************************************
  */
 
-struct wiringPiNodeStruct *wiringPiFindNode (int pin)
+#define	WPI_ARENA_CHUNK	4096
+
+struct wpiArenaChunk
 {
-  struct wiringPiNodeStruct *node = wiringPiNodes ;
+  struct wpiArenaChunk *next ;
+  size_t size ;
+  size_t used ;
+  unsigned char mem [] ;
+} ;
 
-  while (node != NULL)
-    if ((pin >= node->pinBase) && (pin <= node->pinMax))
-      return node ;
-    else
-      node = node->next ;
+static struct wpiArenaChunk *wpiArenaHead ;
+static pthread_mutex_t wpiArenaLock = PTHREAD_MUTEX_INITIALIZER ;
 
-  return NULL ;
+void *wiringPiExtensionAlloc (size_t size)
+{
+  struct wpiArenaChunk *chunk ;
+  size_t need ;
+  void *mem ;
+
+  size = (size + 15) & ~(size_t)15 ;		// keep everything aligned
+
+  pthread_mutex_lock (&wpiArenaLock) ;
+  chunk = wpiArenaHead ;
+  if ((chunk == NULL) || (chunk->used + size > chunk->size))
+  {
+    need  = (size > WPI_ARENA_CHUNK) ? size : WPI_ARENA_CHUNK ;
+    chunk = (struct wpiArenaChunk *)malloc (sizeof (struct wpiArenaChunk) + need) ;
+    if (chunk == NULL)
+      (void)wiringPiFailure (WPI_FATAL, "wiringPiExtensionAlloc: Unable to allocate memory: %s\n", strerror (errno)) ;
+    chunk->next  = wpiArenaHead ;
+    chunk->size  = need ;
+    chunk->used  = 0 ;
+    wpiArenaHead = chunk ;
+  }
+  mem = chunk->mem + chunk->used ;
+  chunk->used += size ;
+  pthread_mutex_unlock (&wpiArenaLock) ;
+
+  return memset (mem, 0, size) ;
 }
 
 
 /*
- * wiringPiNewNode:
- *	Create a new GPIO node into the wiringPi handling system
+ * wpiBufAlloc: wpiBufFree:
+ *	Aligned I/O buffers. A multi-megabyte sampler buffer walked at
+ *	10MSa/s thrashes the TLB on 4K pages, and spidev bounce-copies
+ *	transfers whose buffers aren't cache-line aligned. These come
+ *	straight from mmap, so they're page aligned at worst; ask for
+ *	WPI_BUF_HUGE and the mapping comes from the hugetlb pool when one
+ *	is configured, or gets MADV_HUGEPAGE so khugepaged collapses it,
+ *	and WPI_BUF_LOCK pins the pages so a capture never takes a major
+ *	fault mid-run. mlock failure (RLIMIT_MEMLOCK) is not fatal - the
+ *	buffer is still good, just evictable.
  *********************************************************************************
  */
 
-static void pinModeDummy         (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int mode)  { return ; }
-static void pullUpDnControlDummy (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int pud)   { return ; }
-static  int digitalReadDummy     (UNU struct wiringPiNodeStruct *node, UNU int UNU pin)            { return LOW ; }
-static void digitalWriteDummy    (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
-static void pwmWriteDummy        (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
-static  int analogReadDummy      (UNU struct wiringPiNodeStruct *node, UNU int pin)                { return 0 ; }
-static void analogWriteDummy     (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
+#define	WPI_BUF_SLOTS		64
+#define	WPI_BUF_HUGE_BYTES	(2 * 1024 * 1024)
 
-struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
+static struct
 {
-  int    pin ;
-  struct wiringPiNodeStruct *node ;
+  void  *mem ;
+  size_t size ;
+} wpiBufTable [WPI_BUF_SLOTS] ;
 
-// Minimum pin base is 64
+static pthread_mutex_t wpiBufLock = PTHREAD_MUTEX_INITIALIZER ;
+
+void *wpiBufAlloc (unsigned int size, int flags)
+{
+  void *mem = MAP_FAILED ;
+  size_t rounded ;
+  int slot ;
+
+  if (size == 0)
+    return NULL ;
+
+  pthread_mutex_lock (&wpiBufLock) ;
+
+  for (slot = 0 ; slot < WPI_BUF_SLOTS ; ++slot)
+    if (wpiBufTable [slot].mem == NULL)
+      break ;
+  if (slot == WPI_BUF_SLOTS)
+  {
+    pthread_mutex_unlock (&wpiBufLock) ;
+    return NULL ;
+  }
+
+  rounded = ((size_t)size + 4095) & ~(size_t)4095 ;
+
+#ifdef MAP_HUGETLB
+  if (flags & WPI_BUF_HUGE)
+  {
+    size_t hugeSize = ((size_t)size + WPI_BUF_HUGE_BYTES - 1) & ~(size_t)(WPI_BUF_HUGE_BYTES - 1) ;
+
+    mem = mmap (NULL, hugeSize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0) ;
+    if (mem != MAP_FAILED)
+      rounded = hugeSize ;		// the pool had pages for us
+  }
+#endif
+
+  if (mem == MAP_FAILED)
+  {
+    mem = mmap (NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+    if (mem == MAP_FAILED)
+    {
+      pthread_mutex_unlock (&wpiBufLock) ;
+      return NULL ;
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & WPI_BUF_HUGE)
+      (void)madvise (mem, rounded, MADV_HUGEPAGE) ;
+#endif
+  }
+
+  if (flags & WPI_BUF_LOCK)
+    (void)mlock (mem, rounded) ;
+
+  wpiBufTable [slot].mem  = mem ;
+  wpiBufTable [slot].size = rounded ;
+  pthread_mutex_unlock (&wpiBufLock) ;
+
+  return mem ;
+}
+
+int wpiBufFree (void *mem)
+{
+  int slot ;
+
+  if (mem == NULL)
+    return 0 ;
+
+  pthread_mutex_lock (&wpiBufLock) ;
+  for (slot = 0 ; slot < WPI_BUF_SLOTS ; ++slot)
+    if (wpiBufTable [slot].mem == mem)
+    {
+      (void)munlock (mem, wpiBufTable [slot].size) ;
+      munmap (mem, wpiBufTable [slot].size) ;
+      wpiBufTable [slot].mem  = NULL ;
+      wpiBufTable [slot].size = 0 ;
+      pthread_mutex_unlock (&wpiBufLock) ;
+      return 0 ;
+    }
+  pthread_mutex_unlock (&wpiBufLock) ;
+
+  return -1 ;				// not one of ours
+}
+
+
+/*
+ * wiringPiFindNode:
+ *      Locate our device node
+ *	Every extension read/write comes through here, so the common pin
+ *	range has a direct pin-to-node map filled in by wiringPiNewNode()
+ *	- one array load instead of walking the node list. Pins above the
+ *	map (unusually high pinBase) still take the list.
+ *	Lock-free by design: wiringPiNewNode() publishes fully-built nodes
+ *	with release stores and nothing here is ever modified or freed
+ *	afterwards, so any number of threads may read/write extension pins
+ *	concurrently with registrations without taking a lock.
+ *********************************************************************************
+ */
+
+#define	WPI_NODE_MAP_SIZE	1024
+
+static struct wiringPiNodeStruct *wiringPiNodeMap [WPI_NODE_MAP_SIZE] ;
+
+struct wiringPiNodeStruct *wiringPiFindNode (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((pin >= 0) && (pin < WPI_NODE_MAP_SIZE))
+    return __atomic_load_n (&wiringPiNodeMap [pin], __ATOMIC_ACQUIRE) ;
+
+  node = __atomic_load_n (&wiringPiNodes, __ATOMIC_ACQUIRE) ;
+  while (node != NULL)
+    if ((pin >= node->pinBase) && (pin <= node->pinMax))
+      return node ;
+    else
+      node = node->next ;
+
+  return NULL ;
+}
+
+
+/*
+ * wiringPiNewNode:
+ *	Create a new GPIO node into the wiringPi handling system.
+ *	Registration is RCU-style: the node is built completely (dummy
+ *	methods and all) and only then published - to the list head and
+ *	the pin map - with release stores. A concurrent wiringPiFindNode()
+ *	therefore either misses the node or sees it fully formed; it never
+ *	sees a half-initialised one, and readers need no lock. The mutex
+ *	below only serialises writers against each other.
+ *********************************************************************************
+ */
+
+static void pinModeDummy         (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int mode)  { return ; }
+static void pullUpDnControlDummy (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int pud)   { return ; }
+static  int digitalReadDummy     (UNU struct wiringPiNodeStruct *node, UNU int UNU pin)            { return LOW ; }
+static void digitalWriteDummy    (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
+static void pwmWriteDummy        (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
+static  int analogReadDummy      (UNU struct wiringPiNodeStruct *node, UNU int pin)                { return 0 ; }
+static void analogWriteDummy     (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
+
+static pthread_mutex_t wiringPiNodeMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
+{
+  int    pin ;
+  struct wiringPiNodeStruct *node ;
+
+// Minimum pin base is 64
 
   if (pinBase < 64)
     (void)wiringPiFailure (WPI_FATAL, "wiringPiNewNode: pinBase of %d is < 64\n", pinBase) ;
 
+// Serialised so extension setups may run on parallel threads
+
+  pthread_mutex_lock (&wiringPiNodeMutex) ;
+
 // Check all pins in-case there is overlap:
 
   for (pin = pinBase ; pin < (pinBase + numPins) ; ++pin)
     if (wiringPiFindNode (pin) != NULL)
       (void)wiringPiFailure (WPI_FATAL, "wiringPiNewNode: Pin %d overlaps with existing definition\n", pin) ;
 
-  node = (struct wiringPiNodeStruct *)calloc (sizeof (struct wiringPiNodeStruct), 1) ;	// calloc zeros
-  if (node == NULL)
-    (void)wiringPiFailure (WPI_FATAL, "wiringPiNewNode: Unable to allocate memory: %s\n", strerror (errno)) ;
+  node = (struct wiringPiNodeStruct *)wiringPiExtensionAlloc (sizeof (struct wiringPiNodeStruct)) ;	// zeroed
 
   node->pinBase          = pinBase ;
   node->pinMax           = pinBase + numPins - 1 ;
@@ -1702,12 +2387,465 @@ struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
   node->analogRead       = analogReadDummy ;
   node->analogWrite      = analogWriteDummy ;
   node->next             = wiringPiNodes ;
-  wiringPiNodes          = node ;
+  __atomic_store_n (&wiringPiNodes, node, __ATOMIC_RELEASE) ;	// publish fully-built
+
+  for (pin = pinBase ; (pin <= node->pinMax) && (pin < WPI_NODE_MAP_SIZE) ; ++pin)
+    __atomic_store_n (&wiringPiNodeMap [pin], node, __ATOMIC_RELEASE) ;	// fast lookup for wiringPiFindNode
+
+  pthread_mutex_unlock (&wiringPiNodeMutex) ;
 
   return node ;
 }
 
 
+/*
+ * wiringPiRemoveNode:
+ *	Take a node out of the list and the lookup map so its pin range can
+ *	be claimed again - this is how a lazy placeholder makes way for the
+ *	real device. The memory stays with the caller: another thread may
+ *	still be inside one of the node's methods.
+ *********************************************************************************
+ */
+
+void wiringPiRemoveNode (struct wiringPiNodeStruct *node)
+{
+  struct wiringPiNodeStruct **link ;
+  int pin ;
+
+  pthread_mutex_lock (&wiringPiNodeMutex) ;
+
+  for (link = &wiringPiNodes ; *link != NULL ; link = &(*link)->next)
+    if (*link == node)
+    {
+      *link = node->next ;
+      break ;
+    }
+
+  for (pin = node->pinBase ; (pin <= node->pinMax) && (pin < WPI_NODE_MAP_SIZE) ; ++pin)
+    if (wiringPiNodeMap [pin] == node)
+      wiringPiNodeMap [pin] = NULL ;
+
+  pthread_mutex_unlock (&wiringPiNodeMutex) ;
+}
+
+
+/*
+ * Per-node command queues:
+ *	Expander drivers run read-modify-write bus sequences, so two
+ *	threads writing the same MCP23017 can interleave mid-transaction
+ *	and corrupt the port state. Rather than one global lock that also
+ *	serialises unrelated devices, a node can opt in to a lock-free
+ *	MPSC ring drained by its own worker thread: any thread enqueues
+ *	in a few atomic operations, the worker replays the commands in
+ *	order on the one device, and different devices stay fully
+ *	parallel. Reads travel the same ring (with a semaphore to hand
+ *	the result back) so they can't land mid-way through a queued
+ *	write sequence. The ring is the piThreadPool sequence scheme cut
+ *	down to a single consumer.
+ *********************************************************************************
+ */
+
+#define	NODE_CMD_QUEUE	128		// Must be a power of two
+
+#define	NODE_OP_PIN_MODE	0
+#define	NODE_OP_PUD		1
+#define	NODE_OP_DIGITAL_WRITE	2
+#define	NODE_OP_PWM_WRITE	3
+#define	NODE_OP_ANALOG_WRITE	4
+#define	NODE_OP_DIGITAL_READ	5
+#define	NODE_OP_ANALOG_READ	6
+
+struct nodeCmd
+{
+  int op, pin, value ;
+  int *result ;				// Reads only
+  sem_t *done ;				//  ditto
+} ;
+
+struct nodeCmdQueue
+{
+  struct
+  {
+    unsigned int seq ;
+    struct nodeCmd cmd ;
+  } ring [NODE_CMD_QUEUE] ;
+  unsigned int head ;			// CAS'd by producers
+  unsigned int tail ;			// Worker only
+  sem_t work ;
+  struct wiringPiNodeStruct *node ;
+  pthread_t thread ;
+
+// The driver's real entry points - the node's own slots hold the
+//	queueing shims once serialised
+
+  void (*pinMode)         (struct wiringPiNodeStruct *node, int pin, int mode) ;
+  void (*pullUpDnControl) (struct wiringPiNodeStruct *node, int pin, int mode) ;
+  int  (*digitalRead)     (struct wiringPiNodeStruct *node, int pin) ;
+  void (*digitalWrite)    (struct wiringPiNodeStruct *node, int pin, int value) ;
+  void (*pwmWrite)        (struct wiringPiNodeStruct *node, int pin, int value) ;
+  int  (*analogRead)      (struct wiringPiNodeStruct *node, int pin) ;
+  void (*analogWrite)     (struct wiringPiNodeStruct *node, int pin, int value) ;
+} ;
+
+static void nodeCmdEnqueue (struct nodeCmdQueue *q, int op, int pin, int value, int *result, sem_t *done)
+{
+  unsigned int pos, seq ;
+  int dif ;
+
+  pos = __atomic_load_n (&q->head, __ATOMIC_RELAXED) ;
+  for (;;)
+  {
+    seq = __atomic_load_n (&q->ring [pos % NODE_CMD_QUEUE].seq, __ATOMIC_ACQUIRE) ;
+    dif = (int)(seq - pos) ;
+
+    /**/ if (dif == 0)
+    {
+      if (__atomic_compare_exchange_n (&q->head, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	break ;
+    }
+    else if (dif < 0)			// Ring full - the device is 128 commands behind
+    {
+      sched_yield () ;
+      pos = __atomic_load_n (&q->head, __ATOMIC_RELAXED) ;
+    }
+    else
+      pos = __atomic_load_n (&q->head, __ATOMIC_RELAXED) ;
+  }
+
+  q->ring [pos % NODE_CMD_QUEUE].cmd.op     = op ;
+  q->ring [pos % NODE_CMD_QUEUE].cmd.pin    = pin ;
+  q->ring [pos % NODE_CMD_QUEUE].cmd.value  = value ;
+  q->ring [pos % NODE_CMD_QUEUE].cmd.result = result ;
+  q->ring [pos % NODE_CMD_QUEUE].cmd.done   = done ;
+  __atomic_store_n (&q->ring [pos % NODE_CMD_QUEUE].seq, pos + 1, __ATOMIC_RELEASE) ;
+
+  sem_post (&q->work) ;
+}
+
+static void *nodeCmdWorker (void *arg)
+{
+  struct nodeCmdQueue *q = (struct nodeCmdQueue *)arg ;
+  struct nodeCmd cmd ;
+  unsigned int pos, seq ;
+
+  for (;;)
+  {
+    sem_wait (&q->work) ;
+
+    pos = q->tail ;
+    seq = __atomic_load_n (&q->ring [pos % NODE_CMD_QUEUE].seq, __ATOMIC_ACQUIRE) ;
+    if ((int)(seq - (pos + 1)) < 0)
+      continue ;			// Spurious wake - the slot isn't filled yet
+
+    cmd = q->ring [pos % NODE_CMD_QUEUE].cmd ;
+    __atomic_store_n (&q->ring [pos % NODE_CMD_QUEUE].seq, pos + NODE_CMD_QUEUE, __ATOMIC_RELEASE) ;
+    q->tail = pos + 1 ;
+
+    switch (cmd.op)
+    {
+      case NODE_OP_PIN_MODE:      q->pinMode         (q->node, cmd.pin, cmd.value) ; break ;
+      case NODE_OP_PUD:           q->pullUpDnControl (q->node, cmd.pin, cmd.value) ; break ;
+      case NODE_OP_DIGITAL_WRITE: q->digitalWrite    (q->node, cmd.pin, cmd.value) ; break ;
+      case NODE_OP_PWM_WRITE:     q->pwmWrite        (q->node, cmd.pin, cmd.value) ; break ;
+      case NODE_OP_ANALOG_WRITE:  q->analogWrite     (q->node, cmd.pin, cmd.value) ; break ;
+      case NODE_OP_DIGITAL_READ:  *cmd.result = q->digitalRead (q->node, cmd.pin) ; break ;
+      case NODE_OP_ANALOG_READ:   *cmd.result = q->analogRead  (q->node, cmd.pin) ; break ;
+    }
+    if (cmd.done != NULL)
+      sem_post (cmd.done) ;
+  }
+
+  return NULL ;
+}
+
+// The shims installed in the node's slots - fire-and-forget for writes,
+//	enqueue-and-wait for reads so they stay ordered behind them
+
+static void nodeQueuedPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
+  { nodeCmdEnqueue ((struct nodeCmdQueue *)node->cmdQueue, NODE_OP_PIN_MODE, pin, mode, NULL, NULL) ; }
+
+static void nodeQueuedPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int pud)
+  { nodeCmdEnqueue ((struct nodeCmdQueue *)node->cmdQueue, NODE_OP_PUD, pin, pud, NULL, NULL) ; }
+
+static void nodeQueuedDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+  { nodeCmdEnqueue ((struct nodeCmdQueue *)node->cmdQueue, NODE_OP_DIGITAL_WRITE, pin, value, NULL, NULL) ; }
+
+static void nodeQueuedPwmWrite (struct wiringPiNodeStruct *node, int pin, int value)
+  { nodeCmdEnqueue ((struct nodeCmdQueue *)node->cmdQueue, NODE_OP_PWM_WRITE, pin, value, NULL, NULL) ; }
+
+static void nodeQueuedAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
+  { nodeCmdEnqueue ((struct nodeCmdQueue *)node->cmdQueue, NODE_OP_ANALOG_WRITE, pin, value, NULL, NULL) ; }
+
+static int nodeQueuedSyncRead (struct wiringPiNodeStruct *node, int op, int pin)
+{
+  sem_t done ;
+  int result = LOW ;
+
+  sem_init (&done, 0, 0) ;
+  nodeCmdEnqueue ((struct nodeCmdQueue *)node->cmdQueue, op, pin, 0, &result, &done) ;
+  sem_wait (&done) ;
+  sem_destroy (&done) ;
+  return result ;
+}
+
+static int nodeQueuedDigitalRead (struct wiringPiNodeStruct *node, int pin)
+  { return nodeQueuedSyncRead (node, NODE_OP_DIGITAL_READ, pin) ; }
+
+static int nodeQueuedAnalogRead (struct wiringPiNodeStruct *node, int pin)
+  { return nodeQueuedSyncRead (node, NODE_OP_ANALOG_READ, pin) ; }
+
+
+/*
+ * wiringPiNodeSerialize:
+ *	Attach a command queue and worker to the node owning pinBase. The
+ *	function-pointer swaps are single word stores, so callers already
+ *	in flight hit either the direct driver or the queue - both safe.
+ *	The bank/scan batch entry points are not rerouted: callers mixing
+ *	those with serialised single-pin traffic supply their own ordering.
+ *	Like the library's other helper threads the worker lives for the
+ *	process. Idempotent; -1 if there's no node there or no memory.
+ *********************************************************************************
+ */
+
+int wiringPiNodeSerialize (int pinBase)
+{
+  struct wiringPiNodeStruct *node ;
+  struct nodeCmdQueue *q ;
+  unsigned int i ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  pthread_mutex_lock (&wiringPiNodeMutex) ;
+  if (node->cmdQueue != NULL)			// Already serialised
+  {
+    pthread_mutex_unlock (&wiringPiNodeMutex) ;
+    return 0 ;
+  }
+
+  if ((q = (struct nodeCmdQueue *)calloc (1, sizeof (struct nodeCmdQueue))) == NULL)
+  {
+    pthread_mutex_unlock (&wiringPiNodeMutex) ;
+    return -1 ;
+  }
+  for (i = 0 ; i < NODE_CMD_QUEUE ; ++i)
+    q->ring [i].seq = i ;
+  sem_init (&q->work, 0, 0) ;
+
+  q->node            = node ;
+  q->pinMode         = node->pinMode ;
+  q->pullUpDnControl = node->pullUpDnControl ;
+  q->digitalRead     = node->digitalRead ;
+  q->digitalWrite    = node->digitalWrite ;
+  q->pwmWrite        = node->pwmWrite ;
+  q->analogRead      = node->analogRead ;
+  q->analogWrite     = node->analogWrite ;
+
+  if (pthread_create (&q->thread, NULL, nodeCmdWorker, q) != 0)
+  {
+    sem_destroy (&q->work) ;
+    free (q) ;
+    pthread_mutex_unlock (&wiringPiNodeMutex) ;
+    return -1 ;
+  }
+
+  __atomic_store_n (&node->cmdQueue, (void *)q, __ATOMIC_RELEASE) ;	// Shims need this first
+  __atomic_store_n (&node->pinMode,         nodeQueuedPinMode,         __ATOMIC_RELEASE) ;
+  __atomic_store_n (&node->pullUpDnControl, nodeQueuedPullUpDnControl, __ATOMIC_RELEASE) ;
+  __atomic_store_n (&node->digitalRead,     nodeQueuedDigitalRead,     __ATOMIC_RELEASE) ;
+  __atomic_store_n (&node->digitalWrite,    nodeQueuedDigitalWrite,    __ATOMIC_RELEASE) ;
+  __atomic_store_n (&node->pwmWrite,        nodeQueuedPwmWrite,        __ATOMIC_RELEASE) ;
+  __atomic_store_n (&node->analogRead,      nodeQueuedAnalogRead,      __ATOMIC_RELEASE) ;
+  __atomic_store_n (&node->analogWrite,     nodeQueuedAnalogWrite,     __ATOMIC_RELEASE) ;
+
+  pthread_mutex_unlock (&wiringPiNodeMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * Cached reads:
+ *	The slow sensors - bmp180, htu21d, rht03, ds18b20 - block for their
+ *	full conversion time on every analogRead, even polled at UI rates
+ *	far above anything the physical quantity can do. A node can opt in
+ *	to a TTL cache over its analogRead: within the window the shim
+ *	returns the stored value immediately; once it expires the next
+ *	caller gets the stale value back and a refresh is kicked off on the
+ *	piThreadPool behind it (or done in line when there's no pool), so
+ *	the device converts at most once per TTL no matter how hard the UI
+ *	polls. Only the very first read of a channel blocks. Stacks on top
+ *	of wiringPiNodeSerialize if that ran first - the cache saves and
+ *	calls whatever analogRead pointer it found.
+ *********************************************************************************
+ */
+
+struct nodeCacheEntry
+{
+  int value ;
+  unsigned long long stampNs ;		// 0 = never read
+  volatile int refreshing ;
+  int pin ;
+  struct nodeReadCache *owner ;
+} ;
+
+struct nodeReadCache
+{
+  struct wiringPiNodeStruct *node ;
+  int (*analogRead) (struct wiringPiNodeStruct *node, int pin) ;
+  unsigned long long ttlNs ;
+  struct nodeCacheEntry entries [1] ;	// Really (pinMax - pinBase + 1) of them
+} ;
+
+static unsigned long long nodeCacheNowNs (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec ;
+}
+
+static void nodeCacheRefresh (void *arg)
+{
+  struct nodeCacheEntry *e = (struct nodeCacheEntry *)arg ;
+  struct nodeReadCache *c = e->owner ;
+  int value ;
+
+  value = c->analogRead (c->node, e->pin) ;
+  e->value = value ;
+  __atomic_store_n (&e->stampNs, nodeCacheNowNs (), __ATOMIC_RELEASE) ;
+  __atomic_store_n (&e->refreshing, FALSE, __ATOMIC_RELEASE) ;
+}
+
+static int nodeCachedAnalogRead (struct wiringPiNodeStruct *node, int pin)
+{
+  struct nodeReadCache *c = (struct nodeReadCache *)node->readCache ;
+  struct nodeCacheEntry *e ;
+  unsigned long long stamp, now ;
+  int expect ;
+
+  if (c == NULL || pin < node->pinBase || pin > node->pinMax)
+    return 0 ;
+  e = &c->entries [pin - node->pinBase] ;
+
+  stamp = __atomic_load_n (&e->stampNs, __ATOMIC_ACQUIRE) ;
+  now   = nodeCacheNowNs () ;
+
+  if (stamp == 0)			// First ever read - nothing to serve yet
+  {
+    nodeCacheRefresh (e) ;
+    return e->value ;
+  }
+  if ((now - stamp) < c->ttlNs)
+    return e->value ;
+
+// Expired: hand back the stale value and let one caller arrange the
+//	refresh behind it
+
+  expect = FALSE ;
+  if (__atomic_compare_exchange_n (&e->refreshing, &expect, TRUE, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    if (!piThreadPoolSubmit (nodeCacheRefresh, e))
+      nodeCacheRefresh (e) ;		// No pool (or full) - pay for it here
+
+  return e->value ;
+}
+
+
+/*
+ * wiringPiNodeCacheReads:
+ *	Put a TTL cache (in milliseconds) over the node's analogRead, or
+ *	restore direct reads with a TTL of 0. As with serialisation the
+ *	pointer swap is a single word store; the cache memory is never
+ *	freed since a reader may still be inside it.
+ *********************************************************************************
+ */
+
+int wiringPiNodeCacheReads (int pinBase, unsigned int ttlMs)
+{
+  struct wiringPiNodeStruct *node ;
+  struct nodeReadCache *c ;
+  int numPins, pin ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  pthread_mutex_lock (&wiringPiNodeMutex) ;
+
+  c = (struct nodeReadCache *)node->readCache ;
+  if (ttlMs == 0)			// Back to direct reads
+  {
+    if (c != NULL)
+      __atomic_store_n (&node->analogRead, c->analogRead, __ATOMIC_RELEASE) ;
+    pthread_mutex_unlock (&wiringPiNodeMutex) ;
+    return 0 ;
+  }
+
+  if (c == NULL)
+  {
+    numPins = node->pinMax - node->pinBase + 1 ;
+    c = (struct nodeReadCache *)calloc (1, sizeof (struct nodeReadCache) +
+		(numPins - 1) * sizeof (struct nodeCacheEntry)) ;
+    if (c == NULL)
+    {
+      pthread_mutex_unlock (&wiringPiNodeMutex) ;
+      return -1 ;
+    }
+    c->node       = node ;
+    c->analogRead = node->analogRead ;
+    for (pin = 0 ; pin < numPins ; ++pin)
+    {
+      c->entries [pin].pin   = node->pinBase + pin ;
+      c->entries [pin].owner = c ;
+    }
+    __atomic_store_n (&node->readCache, (void *)c, __ATOMIC_RELEASE) ;
+  }
+
+  c->ttlNs = (unsigned long long)ttlMs * 1000000ULL ;
+  __atomic_store_n (&node->analogRead, nodeCachedAnalogRead, __ATOMIC_RELEASE) ;
+
+  pthread_mutex_unlock (&wiringPiNodeMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiExtensionArenaReset:
+ *	Forget every extension node and return the arena memory to the
+ *	heap in one go - the unload half of a hot-plug cycle. Only legal
+ *	once no other thread can still be touching extension pins: the
+ *	lock-free lookup guarantee holds because nodes are never freed
+ *	under a reader, and this is the one explicit exception, so the
+ *	caller supplies that quiescence. File descriptors the extensions
+ *	opened are untouched; close them before calling if the devices
+ *	are going away too.
+ *	Interface 3.17
+ *********************************************************************************
+ */
+
+void wiringPiExtensionArenaReset (void)
+{
+  struct wpiArenaChunk *chunk, *next ;
+  int pin ;
+
+  pthread_mutex_lock (&wiringPiNodeMutex) ;
+  __atomic_store_n (&wiringPiNodes, NULL, __ATOMIC_RELEASE) ;
+  for (pin = 0 ; pin < WPI_NODE_MAP_SIZE ; ++pin)
+    __atomic_store_n (&wiringPiNodeMap [pin], NULL, __ATOMIC_RELEASE) ;
+  pthread_mutex_unlock (&wiringPiNodeMutex) ;
+
+  pthread_mutex_lock (&wpiArenaLock) ;
+  chunk        = wpiArenaHead ;
+  wpiArenaHead = NULL ;
+  pthread_mutex_unlock (&wpiArenaLock) ;
+
+  while (chunk != NULL)
+  {
+    next = chunk->next ;
+    free (chunk) ;
+    chunk = next ;
+  }
+}
+
+
 #ifdef notYetReady
 /*
  * pinED01:
@@ -1795,18 +2933,49 @@ void releaseLine(int pin) {
 }
 
 
-int requestLineV2(int pin, const unsigned int lineRequestFlags) {
-   struct gpio_v2_line_request req;
-   struct gpio_v2_line_config config;
-   int ret;
-   
-   if (lineFds[pin]>=0) {
-    if (lineRequestFlags == lineFlags[pin]) {
+static unsigned long long lineFlagsToV2(const unsigned int lineRequestFlags) {
+  unsigned long long flags = 0;
+
+  if (lineRequestFlags & WPI_FLAG_INPUT) {
+    flags |= GPIO_V2_LINE_FLAG_INPUT;
+  }
+  if (lineRequestFlags & WPI_FLAG_OUTPUT) {
+    flags |= GPIO_V2_LINE_FLAG_OUTPUT;
+  }
+  if (lineRequestFlags & WPI_FLAG_BIAS_OFF) {
+    flags |= GPIO_V2_LINE_FLAG_BIAS_DISABLED;
+  }
+  if (lineRequestFlags & WPI_FLAG_BIAS_UP) {
+    flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+  }
+  if (lineRequestFlags & WPI_FLAG_BIAS_DOWN) {
+    flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+  }
+  return flags;
+}
+
+int requestLineV2(int pin, const unsigned int lineRequestFlags) {
+   struct gpio_v2_line_request req;
+   struct gpio_v2_line_config config;
+   int ret;
+   
+   if (lineFds[pin]>=0) {
+    if (lineRequestFlags == lineFlags[pin]) {
       //already requested
       return lineFds[pin];
     } else {
-      //different request -> rerequest
-      releaseLine(pin);
+      //different request -> mutate the live request in place. One
+      //SET_CONFIG ioctl instead of close + GET_LINE, which is what a
+      //handshake pin flipping direction at kHz rates ends up paying
+      memset(&config, 0, sizeof(config));
+      config.flags = lineFlagsToV2(lineRequestFlags);
+      if (ioctl(lineFds[pin], GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) == 0) {
+        lineFlags[pin] = lineRequestFlags;
+        if (wiringPiDebug)
+          printf ("requestLine reconfigured: pin:%d, flags: 0x%u, fd :%d\n", pin, lineRequestFlags, lineFds[pin]) ;
+        return lineFds[pin];
+      }
+      releaseLine(pin);   // kernel said no - fall back to a fresh request
     }
   }
 
@@ -1817,21 +2986,7 @@ int requestLineV2(int pin, const unsigned int lineRequestFlags) {
   
   memset(&req, 0, sizeof(req));
   memset(&config, 0, sizeof(config));
-  if (lineRequestFlags & WPI_FLAG_INPUT) {
-    config.flags |= GPIO_V2_LINE_FLAG_INPUT;
-  }
-  if (lineRequestFlags & WPI_FLAG_OUTPUT) {
-    config.flags |= GPIO_V2_LINE_FLAG_OUTPUT;
-  }
-  if (lineRequestFlags & WPI_FLAG_BIAS_OFF) {
-    config.flags |= GPIO_V2_LINE_FLAG_BIAS_DISABLED;
-  }
-  if (lineRequestFlags & WPI_FLAG_BIAS_UP) {
-    config.flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
-  }
-  if (lineRequestFlags & WPI_FLAG_BIAS_DOWN) {
-    config.flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
-  }
+  config.flags = lineFlagsToV2(lineRequestFlags);
   if (wiringPiDebug) {
     printf ("requestLine flags v2: %llu\n", config.flags);
   }
@@ -1855,6 +3010,153 @@ int requestLineV2(int pin, const unsigned int lineRequestFlags) {
   return lineFds[pin];
 }
 
+/*
+ helper functions for gpio_v2_line_values bits
+*/
+static inline void gpiotools_set_bit(__u64 *b, int n)
+{
+	*b |= _BITULL(n);
+}
+
+static inline void gpiotools_clear_bit(__u64 *b, int n)
+{
+	*b &= ~_BITULL(n);
+}
+
+static inline void gpiotools_assign_bit(__u64 *b, int n, bool value)
+{
+	if (value)
+		gpiotools_set_bit(b, n);
+	else
+		gpiotools_clear_bit(b, n);
+}
+
+static inline int gpiotools_test_bit(__u64 b, int n)
+{
+	return !!(b & _BITULL(n));
+}
+
+//*********************************************
+
+
+// Grouped line requests (gpiod V2):
+//	One request covering a whole set of pins so a bulk read or write is a
+//	single ioctl instead of one per pin. We keep one group per direction -
+//	a line can't be both - and remember where each BCM pin landed in the
+//	request's offsets array, as the values ioctl is indexed by position.
+
+static int      groupLineFds   [2] = { -1, -1 } ;	// 0: input group, 1: output group
+static uint64_t groupLineMasks [2] = { 0, 0 } ;
+static int      groupLineIndex [2][64] ;
+
+int requestLineGroupV2 (uint64_t pinMask, int output)
+{
+  struct gpio_v2_line_request req ;
+  struct gpio_v2_line_config config ;
+  const int group = output ? 1 : 0 ;
+  int pin, ret ;
+
+  if (groupLineFds [group] >= 0)
+  {
+    if (groupLineMasks [group] == pinMask)
+      return groupLineFds [group] ;		// Same set - reuse the request
+    close (groupLineFds [group]) ;
+    groupLineFds   [group] = -1 ;
+    groupLineMasks [group] = 0 ;
+  }
+
+  if (wiringPiGpioDeviceGetFd () < 0)
+    return -1 ;
+
+  memset (&req, 0, sizeof (req)) ;
+  memset (&config, 0, sizeof (config)) ;
+  config.flags = output ? GPIO_V2_LINE_FLAG_OUTPUT : GPIO_V2_LINE_FLAG_INPUT ;
+  strcpy (req.consumer, "wiringpi_gpio_group") ;
+
+  for (pin = 0 ; pin < 64 ; ++pin)
+  {
+    if ((pinMask & _BITULL (pin)) == 0)
+      continue ;
+    if (lineFds [pin] >= 0)
+      releaseLine (pin) ;			// Give up any per-pin request first
+    groupLineIndex [group][pin] = req.num_lines ;
+    req.offsets [req.num_lines++] = pin ;
+  }
+  if (req.num_lines == 0)
+    return -1 ;
+  req.config = config ;
+
+  ret = ioctl (chipFd, GPIO_V2_GET_LINE_IOCTL, &req) ;
+  if (ret || req.fd < 0)
+  {
+    ReportDeviceError ("get line group v2", (int)req.offsets [0], "RequestLineGroup", ret) ;
+    return -1 ;
+  }
+
+  groupLineFds   [group] = req.fd ;
+  groupLineMasks [group] = pinMask ;
+  if (wiringPiDebug)
+    printf ("requestLineGroupV2 succeeded: mask:0x%llx, output:%d, fd:%d\n",
+		(unsigned long long)pinMask, output, req.fd) ;
+  return req.fd ;
+}
+
+static int digitalWriteMultiDevice (uint64_t pinMask, uint64_t values)
+{
+  struct gpio_v2_line_values lv ;
+  int pin, fd, ret ;
+
+  fd = requestLineGroupV2 (pinMask, TRUE) ;
+  if (fd < 0)
+    return -1 ;
+
+  lv.mask = 0 ;
+  lv.bits = 0 ;
+  for (pin = 0 ; pin < 64 ; ++pin)
+    if (pinMask & _BITULL (pin))
+    {
+      gpiotools_set_bit (&lv.mask, groupLineIndex [1][pin]) ;
+      gpiotools_assign_bit (&lv.bits, groupLineIndex [1][pin], (values & _BITULL (pin)) != 0) ;
+    }
+
+  ret = ioctl (fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lv) ;
+  if (ret)
+  {
+    ReportDeviceError ("set line group values", -1, "digitalWriteMulti", ret) ;
+    return -1 ;
+  }
+  return 0 ;
+}
+
+static int digitalReadMultiDevice (uint64_t pinMask, unsigned long long *levels)
+{
+  struct gpio_v2_line_values lv ;
+  int pin, fd, ret ;
+
+  fd = requestLineGroupV2 (pinMask, FALSE) ;
+  if (fd < 0)
+    return -1 ;
+
+  lv.mask = 0 ;
+  lv.bits = 0 ;
+  for (pin = 0 ; pin < 64 ; ++pin)
+    if (pinMask & _BITULL (pin))
+      gpiotools_set_bit (&lv.mask, groupLineIndex [0][pin]) ;
+
+  ret = ioctl (fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lv) ;
+  if (ret)
+  {
+    ReportDeviceError ("get line group values", -1, "digitalReadMulti", ret) ;
+    return -1 ;
+  }
+
+  *levels = 0 ;
+  for (pin = 0 ; pin < 64 ; ++pin)
+    if ((pinMask & _BITULL (pin)) && gpiotools_test_bit (lv.bits, groupLineIndex [0][pin]))
+      *levels |= _BITULL (pin) ;
+  return 0 ;
+}
+
 /*
  *********************************************************************************
  * Core Functions
@@ -1917,10 +3219,10 @@ void pinModeAlt (int pin, int mode)
     //printf("pinModeAlt: Pi5 alt pin %d to %d\n", pin, modeRP1);
     gpio[2*pin+1] = (modeRP1 & RP1_FSEL_NONE_HW) | RP1_DEBOUNCE_DEFAULT; //0-4  function, 5-11 debounce time
   } else {
-    int fSel  = gpioToGPFSEL [pin] ;
-    int shift = gpioToShift  [pin] ;
+    int fSel  = pinDesc [pin].fselOff ;
+    int shift = pinDesc [pin].shift ;
 
-    *(gpio + fSel) = (*(gpio + fSel) & ~(7 << shift)) | ((mode & 0x7) << shift) ;
+    fselWrite (fSel, (fselRead (fSel) & ~(7 << shift)) | ((mode & 0x7) << shift)) ;
   }
  }
 
@@ -1934,7 +3236,7 @@ void pinModeAlt (int pin, int mode)
 //Default: rp1_set_pad(pin, 0, 1, 0, 1, 1, 1, 0);
 void rp1_set_pad(int pin, int slewfast, int schmitt, int pulldown, int pullup, int drive, int inputenable, int outputdisable) {
 
-  pads[1+pin] = (slewfast != 0) | ((schmitt != 0) << 1) | ((pulldown != 0) << 2) | ((pullup != 0) << 3) | ((drive & 0x3) << 4) | ((inputenable != 0) << 6) | ((outputdisable != 0) << 7);
+  rp1PadWrite(pin, (slewfast != 0) | ((schmitt != 0) << 1) | ((pulldown != 0) << 2) | ((pullup != 0) << 3) | ((drive & 0x3) << 4) | ((inputenable != 0) << 6) | ((outputdisable != 0) << 7));
 }
 
 void pinModeFlagsDevice (int pin, int mode, const unsigned int flags) {
@@ -1975,6 +3277,8 @@ void pinMode (int pin, int mode)
   if (wiringPiDebug)
     printf ("pinMode: pin:%d mode:%d\n", pin, mode) ;
 
+  WPI_TRACE (WPI_TRACE_PINMODE, pin, mode) ;
+
   setupCheck ("pinMode") ;
 
   if ((pin & PI_GPIO_MASK) == 0)		// On-board pin
@@ -1998,6 +3302,9 @@ void pinMode (int pin, int mode)
       case WPI_MODE_GPIO_DEVICE_PHYS:
         pinModeDevice(physToGpio[pin], mode);
         return;
+      case WPI_MODE_SIM:
+        simState->modes [pin & 63] = (unsigned char)mode ;
+        return;
       case WPI_MODE_GPIO:
         break;
     }
@@ -2008,21 +3315,24 @@ void pinMode (int pin, int mode)
     softPwmStop  (origPin) ;
     softToneStop (origPin) ;
 
-    fSel    = gpioToGPFSEL [pin] ;
-    shift   = gpioToShift  [pin] ;
+    fSel    = pinDesc [pin].fselOff ;
+    shift   = pinDesc [pin].shift ;
 
     if (INPUT==mode  || PM_OFF==mode) {
       if (piRP1Model()) {
         if (INPUT==mode) {
-          pads[1+pin] = (pin<=8) ? RP1_PAD_DEFAULT_0TO8 : RP1_PAD_DEFAULT_FROM9;
+          rp1PadWrite(pin, (pin<=8) ? RP1_PAD_DEFAULT_0TO8 : RP1_PAD_DEFAULT_FROM9);
           gpio[2*pin+1] = RP1_FSEL_GPIO | RP1_DEBOUNCE_DEFAULT; // GPIO
           rio[RP1_RIO_OE + RP1_CLR_OFFSET] = 1<<pin;            // Input
         } else  { //PM_OFF
-          pads[1+pin] = (pin<=8) ? RP1_PAD_IC_DEFAULT_0TO8 : RP1_PAD_IC_DEFAULT_FROM9;
+          rp1PadWrite(pin, (pin<=8) ? RP1_PAD_IC_DEFAULT_0TO8 : RP1_PAD_IC_DEFAULT_FROM9);
           gpio[2*pin+1] = RP1_IRQRESET | RP1_FSEL_NONE_HW | RP1_DEBOUNCE_DEFAULT; // default but with irq reset
         }
       } else {
-        *(gpio + fSel) = (*(gpio + fSel) & ~(7 << shift)) ; // Sets bits to zero = input
+        fselWrite (fSel, fselRead (fSel) & ~(7 << shift)) ; // Sets bits to zero = input
+      }
+      if (PM_OFF==mode && !usingGpioMem && !piRP1Model() && gpioToPwmALT[pin]>0) {
+        bcmPwm();  // pin may be in PWM mode from an earlier run
       }
       if (PM_OFF==mode && !usingGpioMem && pwm && gpioToPwmALT[pin]>0) { //PWM pin -> reset
         pwmWrite(origPin, 0);
@@ -2033,13 +3343,19 @@ void pinMode (int pin, int mode)
           //printf("Disable PWM0[%d] (0x%08X->0x%08X)\n", channel, ctrl, pwm[RP1_PWM0_GLOBAL_CTRL]);
         }
       }
+      if (PM_OFF==mode && gpioToPwmALT[pin]>0 && rp1SysPwmUse()) { //PWM via the kernel driver -> reset
+        int channel = gpioToPwmPort[pin];
+        if (channel>=0 && channel<=3) {
+          rp1SysPwmStop(channel);
+        }
+      }
     } else if (mode == OUTPUT) {
       if (piRP1Model()) {
-        pads[1+pin] = (pin<=8) ? RP1_PAD_DEFAULT_0TO8 : RP1_PAD_DEFAULT_FROM9;
+        rp1PadWrite(pin, (pin<=8) ? RP1_PAD_DEFAULT_0TO8 : RP1_PAD_DEFAULT_FROM9);
         gpio[2*pin+1] = RP1_FSEL_GPIO | RP1_DEBOUNCE_DEFAULT; // GPIO
         rio[RP1_RIO_OE + RP1_SET_OFFSET] = 1<<pin;            // Output
       } else {
-        *(gpio + fSel) = (*(gpio + fSel) & ~(7 << shift)) | (1 << shift) ;
+        fselWrite (fSel, (fselRead (fSel) & ~(7 << shift)) | (1 << shift)) ;
       }
     } else if (mode == SOFT_PWM_OUTPUT) {
       softPwmCreate (origPin, 0, 100) ;
@@ -2052,7 +3368,9 @@ void pinMode (int pin, int mode)
     }
     else if (PWM_OUTPUT==mode || PWM_MS_OUTPUT==mode || PWM_BAL_OUTPUT==mode) {
 
-      usingGpioMemCheck("pinMode PWM") ;  // exit on error!
+      if (!rp1SysPwmUse()) {		// the Pi 5 kernel driver works from gpiomem
+        usingGpioMemCheck("pinMode PWM") ;  // exit on error!
+      }
       alt = gpioToPwmALT[pin];
       if (0==alt) {	// Not a hardware capable PWM pin
 	      return;
@@ -2060,19 +3378,24 @@ void pinMode (int pin, int mode)
       int channel = gpioToPwmPort[pin];
       if (piRP1Model()) {
         if (channel>=0 && channel<=3) {
-          // enable channel pwm m:s mode
-          pwm[RP1_PWM0_CHAN_START+RP1_PWM0_CHAN_OFFSET*channel+RP1_PWM0_CHAN_CTRL]  = (RP1_PWM_TRAIL_EDGE_MS | RP1_PWM_FIFO_POP_MASK);
-          // enable pwm global
-          unsigned int ctrl = pwm[RP1_PWM0_GLOBAL_CTRL];
-          pwm[RP1_PWM0_GLOBAL_CTRL] = ctrl | (1<<channel) | RP1_PWM_CTRL_SETUPDATE;
-          //printf("Enable PWM0[%d] (0x%08X->0x%08X)\n", channel, ctrl, pwm[RP1_PWM0_GLOBAL_CTRL]);
+          if (pwm) {
+            // enable channel pwm m:s mode
+            pwm[RP1_PWM0_CHAN_START+RP1_PWM0_CHAN_OFFSET*channel+RP1_PWM0_CHAN_CTRL]  = (RP1_PWM_TRAIL_EDGE_MS | RP1_PWM_FIFO_POP_MASK);
+            // enable pwm global
+            unsigned int ctrl = pwm[RP1_PWM0_GLOBAL_CTRL];
+            pwm[RP1_PWM0_GLOBAL_CTRL] = ctrl | (1<<channel) | RP1_PWM_CTRL_SETUPDATE;
+            //printf("Enable PWM0[%d] (0x%08X->0x%08X)\n", channel, ctrl, pwm[RP1_PWM0_GLOBAL_CTRL]);
+          } else {
+            rp1SysPwmActive[channel] = TRUE;  // gpiomem: the kernel driver owns the block
+            rp1SysPwmApply(channel);
+          }
           //change GPIO mode
-          pads[1+pin] = RP1_PAD_DEFAULT_FROM9;  // enable output
+          rp1PadWrite(pin, RP1_PAD_DEFAULT_FROM9);  // enable output
           pinModeAlt(origPin, alt); //switch to PWM mode
         }
       } else {
         // Set pin to PWM mode
-        *(gpio + fSel) = (*(gpio + fSel) & ~(7 << shift)) | (alt << shift) ;
+        fselWrite (fSel, (fselRead (fSel) & ~(7 << shift)) | (alt << shift)) ;
         delayMicroseconds (110) ;		// See comments in pwmSetClockWPi
 
         if (PWM_OUTPUT==mode || PWM_BAL_OUTPUT==mode) {
@@ -2096,7 +3419,7 @@ void pinMode (int pin, int mode)
 
 // Set pin to GPIO_CLOCK mode and set the clock frequency to 100KHz
 
-      *(gpio + fSel) = (*(gpio + fSel) & ~(7 << shift)) | (alt << shift) ;
+      fselWrite (fSel, (fselRead (fSel) & ~(7 << shift)) | (alt << shift)) ;
       delayMicroseconds (110) ;
       gpioClockSet      (pin, 100000) ;
     }
@@ -2162,16 +3485,19 @@ void pullUpDnControl (int pin, int pud)
         return pullUpDnControlDevice(pinToGpio[pin], pud);
       case WPI_MODE_GPIO_DEVICE_PHYS:
         return pullUpDnControlDevice(physToGpio[pin], pud);
+      case WPI_MODE_SIM:
+        simState->pud [pin & 63] = (unsigned char)pud ;
+        return;
       case WPI_MODE_GPIO:
         break;
     }
 
     if (piRP1Model()) {
-      unsigned int pullbits = pads[1+pin] & RP1_INV_PUD_MASK; // remove bits
+      unsigned int pullbits = rp1PadRead(pin) & RP1_INV_PUD_MASK; // remove bits
       switch (pud){
-        case PUD_OFF:  pads[1+pin] = pullbits;                break;
-        case PUD_UP:   pads[1+pin] = pullbits | RP1_PUD_UP;   break;
-        case PUD_DOWN: pads[1+pin] = pullbits | RP1_PUD_DOWN; break;
+        case PUD_OFF:  rp1PadWrite(pin, pullbits);                break;
+        case PUD_UP:   rp1PadWrite(pin, pullbits | RP1_PUD_UP);   break;
+        case PUD_DOWN: rp1PadWrite(pin, pullbits | RP1_PUD_DOWN); break;
         default: return ; /* An illegal value */
       }
     } else {
@@ -2214,33 +3540,271 @@ void pullUpDnControl (int pin, int pud)
   }
 }
 
+
 /*
- helper functions for gpio_v2_line_values bits 
-*/
-static inline void gpiotools_set_bit(__u64 *b, int n)
+ * wiringPiConfigPins:
+ *	Pi Specific
+ *	Configure a whole set of pins - mode, pull and (Pi 5) pad drive -
+ *	in one pass. On the BCM models the configs are folded together by
+ *	register, so each FSEL and pull register is read and written once
+ *	however many of its pins are in the list, instead of once per pin;
+ *	a 40-pin fixture goes from ~120 read-modify-writes to a handful,
+ *	and pins sharing a register change together with no glitch window
+ *	in between. Any field may be -1 to leave it alone, and modes that
+ *	are more than an FSEL write (PWM, clock, the soft schemes) plus
+ *	extension nodes take their usual path. The RP1 and the character
+ *	device have per-pin registers, so there the list is simply walked.
+ *	Returns the number of entries processed, or -1.
+ *********************************************************************************
+ */
+
+int wiringPiConfigPins (const struct WPIPinConfig *cfgs, int numConfigs)
 {
-	*b |= _BITULL(n);
+  uint32_t fselClear [6] = { 0 }, fselSet [6] = { 0 } ;
+  uint32_t pullClear [4] = { 0 }, pullSet [4] = { 0 } ;
+  uint32_t pudClk [3][2] = { { 0 } } ;
+  int fselTouched = 0, pullTouched = 0, pudUsed = 0 ;
+  int i, reg, shift, bcm, mode, pud ;
+
+  setupCheck ("wiringPiConfigPins") ;
+
+  if ((cfgs == NULL) || (numConfigs < 1))
+    return -1 ;
+
+// The RP1, the gpio device and the simulator are per-pin anyway
+
+  if (piRP1Model () ||
+      ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO)))
+  {
+    for (i = 0 ; i < numConfigs ; ++i)
+    {
+      if (cfgs [i].mode  >= 0) pinMode         (cfgs [i].pin, cfgs [i].mode) ;
+      if (cfgs [i].pud   >= 0) pullUpDnControl (cfgs [i].pin, cfgs [i].pud) ;
+      if (cfgs [i].drive >= 0) setPadDrivePin  (cfgs [i].pin, cfgs [i].drive) ;
+    }
+    return numConfigs ;
+  }
+
+  for (i = 0 ; i < numConfigs ; ++i)
+  {
+    if ((cfgs [i].pin & PI_GPIO_MASK) != 0)	// Extension node: usual path
+    {
+      if (cfgs [i].mode >= 0) pinMode         (cfgs [i].pin, cfgs [i].mode) ;
+      if (cfgs [i].pud  >= 0) pullUpDnControl (cfgs [i].pin, cfgs [i].pud) ;
+      continue ;
+    }
+    bcm = cfgs [i].pin ;
+    if (!ToBCMPin (&bcm))
+      continue ;
+
+    mode = cfgs [i].mode ;
+    if ((mode == INPUT) || (mode == OUTPUT))
+    {
+      reg   = gpioToGPFSEL [bcm] ;
+      shift = gpioToShift  [bcm] ;
+      fselClear [reg] |= 7u << shift ;
+      if (mode == OUTPUT)
+	fselSet [reg] |= 1u << shift ;
+      fselTouched |= 1 << reg ;
+    }
+    else if (mode >= 0)				// PWM, clock, soft... more than an FSEL write
+      pinMode (cfgs [i].pin, mode) ;
+
+    pud = cfgs [i].pud ;
+    if ((pud >= PUD_OFF) && (pud <= PUD_UP))
+    {
+      if (piGpioPupOffset == GPPUPPDN0)
+      {
+	unsigned int pull = (pud == PUD_UP) ? 1 : (pud == PUD_DOWN) ? 2 : 0 ;
+	reg   = bcm >> 4 ;
+	shift = (bcm & 0xF) << 1 ;
+	pullClear [reg] |= 3u << shift ;
+	pullSet   [reg] |= pull << shift ;
+	pullTouched |= 1 << reg ;
+      }
+      else
+      {
+	pudClk [pud][bcm >> 5] |= 1u << (bcm & 31) ;
+	pudUsed |= 1 << pud ;
+      }
+    }
+
+    if (cfgs [i].drive >= 0)
+      setPadDrivePin (cfgs [i].pin, cfgs [i].drive) ;	// no-op before the Pi 5
+  }
+
+// One read-modify-write per touched register
+
+  for (reg = 0 ; reg < 6 ; ++reg)
+    if (fselTouched & (1 << reg))
+      fselWrite (reg, (fselRead (reg) & ~fselClear [reg]) | fselSet [reg]) ;
+
+  if (piGpioPupOffset == GPPUPPDN0)
+  {
+    for (reg = 0 ; reg < 4 ; ++reg)
+      if (pullTouched & (1 << reg))
+	*(gpio + GPPUPPDN0 + reg) = (*(gpio + GPPUPPDN0 + reg) & ~pullClear [reg]) | pullSet [reg] ;
+  }
+  else
+  {
+    for (pud = PUD_OFF ; pud <= PUD_UP ; ++pud)	// legacy walk, once per pull value
+      if (pudUsed & (1 << pud))
+      {
+	*(gpio + GPPUD) = pud & 3 ;		delayMicroseconds (5) ;
+	if (pudClk [pud][0]) *(gpio + 38) = pudClk [pud][0] ;
+	if (pudClk [pud][1]) *(gpio + 39) = pudClk [pud][1] ;
+	delayMicroseconds (5) ;
+	*(gpio + GPPUD) = 0 ;			delayMicroseconds (5) ;
+	if (pudClk [pud][0]) *(gpio + 38) = 0 ;
+	if (pudClk [pud][1]) *(gpio + 39) = 0 ;
+	delayMicroseconds (5) ;
+      }
+  }
+
+  return numConfigs ;
 }
 
-static inline void gpiotools_clear_bit(__u64 *b, int n)
+
+/*
+ * wpiSaveConfig: wpiRestoreConfig:
+ *	Capture the whole GPIO configuration - FSEL (or RP1 function and
+ *	output-enable), pulls and pad drive - in one register sweep, and
+ *	put it back with the minimal set of masked writes: only registers
+ *	that actually differ from the snapshot are touched, so switching a
+ *	fixture between two profiles is a handful of stores rather than
+ *	thirty read-modify-write pinMode/pullUpDnControl calls, with no
+ *	transient states on pins that are the same in both profiles.
+ *	Levels are NOT part of a snapshot - set your outputs first.
+ *	Needs the memory-mapped GPIO; pulls can't be read back on the
+ *	pre-2711 BCMs (write-only GPPUD) so they're skipped there, and the
+ *	BCM pad groups are only captured when the pads block is mapped
+ *	(ie. not under /dev/gpiomem). Restore returns the number of
+ *	registers written, or -1.
+ *********************************************************************************
+ */
+
+#define	RP1_BANK0_PINS	28
+
+int wpiSaveConfig (struct WPIConfigSnapshot *snap)
 {
-	*b &= ~_BITULL(n);
+  int reg, pin, group ;
+
+  setupCheck ("wpiSaveConfig") ;
+
+  if ((snap == NULL) ||
+      ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO)))
+    return -1 ;
+
+  memset (snap, 0, sizeof (*snap)) ;
+  snap->rp1 = piRP1Model () ;
+
+  if (snap->rp1)
+  {
+    for (pin = 0 ; pin < RP1_BANK0_PINS ; ++pin)
+    {
+      snap->rp1Ctrl [pin] = gpio [2 * pin + 1] ;
+      snap->rp1Pad  [pin] = rp1PadRead (pin) ;
+    }
+    snap->rp1Oe = rio [RP1_RIO_OE] ;
+    return 0 ;
+  }
+
+  for (reg = 0 ; reg < 6 ; ++reg)
+    snap->fsel [reg] = fselRead (reg) ;
+
+  if (piGpioPupOffset == GPPUPPDN0)
+    for (reg = 0 ; reg < 4 ; ++reg)
+      snap->pull [reg] = *(gpio + GPPUPPDN0 + reg) ;
+
+  if (bcmPads () != NULL)
+  {
+    for (group = 0 ; group < 3 ; ++group)
+      snap->pads [group] = *(pads + 11 + group) & 0x1F ;
+    snap->padsValid = TRUE ;
+  }
+
+  return 0 ;
 }
 
-static inline void gpiotools_assign_bit(__u64 *b, int n, bool value)
+int wpiRestoreConfig (const struct WPIConfigSnapshot *snap)
 {
-	if (value)
-		gpiotools_set_bit(b, n);
-	else
-		gpiotools_clear_bit(b, n);
+  unsigned int cur, diff ;
+  int reg, pin, group ;
+  int written = 0 ;
+
+  setupCheck ("wpiRestoreConfig") ;
+
+  if ((snap == NULL) || (snap->rp1 != piRP1Model ()) ||
+      ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO)))
+    return -1 ;
+
+  if (snap->rp1)
+  {
+    for (pin = 0 ; pin < RP1_BANK0_PINS ; ++pin)
+    {
+      if (gpio [2 * pin + 1] != snap->rp1Ctrl [pin])
+	{ gpio [2 * pin + 1] = snap->rp1Ctrl [pin] ; ++written ; }
+      if (rp1PadRead (pin) != snap->rp1Pad [pin])
+	{ rp1PadWrite (pin, snap->rp1Pad [pin]) ; ++written ; }
+    }
+
+// Direction lives in the RIO output-enables - flip the changed bits
+//	through the SET/CLR aliases so the others never glitch
+
+    diff = rio [RP1_RIO_OE] ^ snap->rp1Oe ;
+    if (diff & snap->rp1Oe)
+      { rio [RP1_RIO_OE + RP1_SET_OFFSET] = diff & snap->rp1Oe ; ++written ; }
+    if (diff & ~snap->rp1Oe)
+      { rio [RP1_RIO_OE + RP1_CLR_OFFSET] = diff & ~snap->rp1Oe ; ++written ; }
+
+    return written ;
+  }
+
+  for (reg = 0 ; reg < 6 ; ++reg)
+    if (fselRead (reg) != snap->fsel [reg])
+      { fselWrite (reg, snap->fsel [reg]) ; ++written ; }
+
+  if (piGpioPupOffset == GPPUPPDN0)
+    for (reg = 0 ; reg < 4 ; ++reg)
+      if (*(gpio + GPPUPPDN0 + reg) != snap->pull [reg])
+	{ *(gpio + GPPUPPDN0 + reg) = snap->pull [reg] ; ++written ; }
+
+  if (snap->padsValid && (bcmPads () != NULL))
+    for (group = 0 ; group < 3 ; ++group)
+    {
+      cur = *(pads + 11 + group) & 0x1F ;
+      if (cur != snap->pads [group])
+	{ *(pads + 11 + group) = BCM_PASSWORD | snap->pads [group] ; ++written ; }
+    }
+
+  return written ;
 }
 
-static inline int gpiotools_test_bit(__u64 b, int n)
+
+/*
+ * digitalWriteSim: digitalReadSim:
+ *	The simulation backend - pin levels are bits in the shared page,
+ *	so these cost no syscalls at all. Single library writer; the
+ *	harness on the other side of the page drives the input levels.
+ *********************************************************************************
+ */
+
+static void digitalWriteSim (int pin, int value)
 {
-	return !!(b & _BITULL(n));
+  pin &= 63 ;
+  if (value == LOW)
+    simState->levels [pin >> 5] &= ~(1u << (pin & 31)) ;
+  else
+    simState->levels [pin >> 5] |=  (1u << (pin & 31)) ;
+  ++simState->writes ;
 }
 
-//*********************************************
+static int digitalReadSim (int pin)
+{
+  pin &= 63 ;
+  ++simState->reads ;
+  return ((simState->levels [pin >> 5] >> (pin & 31)) & 1) ? HIGH : LOW ;
+}
 
 
 /*
@@ -2272,40 +3836,290 @@ int digitalReadDeviceV2(int pin) {   // INPUT and OUTPUT should work
 }
 
 
-int digitalRead (int pin)
+/*
+ * Board-specialised dispatch:
+ *	wiringPiMode and the SoC generation are both fixed once setup has
+ *	run, yet every digitalRead/Write/Toggle re-tested them on the way
+ *	to a one-store register operation. When setup leaves us in a
+ *	memory-mapped mode it fills the toBcm descriptor byte for the mode
+ *	and installs a board-specific routine into function pointers, so
+ *	the hot path is one indirect call with no mode switch and no model
+ *	test - which a fast bit-bang loop can feel. The generic routines
+ *	below remain for the character-device and simulator modes, and as
+ *	the safe default before setup.
+ *********************************************************************************
+ */
+
+static int  digitalReadGeneric   (int pin) ;
+static void digitalWriteGeneric  (int pin, int value) ;
+static void digitalToggleGeneric (int pin) ;
+
+static int  (*digitalReadImpl)   (int pin)            = digitalReadGeneric ;
+static void (*digitalWriteImpl)  (int pin, int value) = digitalWriteGeneric ;
+static void (*digitalToggleImpl) (int pin)            = digitalToggleGeneric ;
+
+
+// Register write batching - Interface V3.17
+//	Every store to the peripheral window is a full bus transaction, so
+//	a burst of digitalWrite()s pays one per pin. Between wpiBatchBegin()
+//	and wpiBatchCommit() the memory-mapped write paths accumulate their
+//	SET/CLR masks here instead and the commit lands the whole group as
+//	at most one store per register, inside a single barrier pair.
+//	Reads and toggles flush the pending batch first so levels are never
+//	stale. Like digitalWriteByte() this is not thread-safe: a batch
+//	belongs to one thread's write burst.
+
+#define	WPI_BATCH_REGS	4		// GPSET0/1 + GPCLR0/1 is the worst case
+
+static int wpiBatchActive = FALSE ;
+static int wpiBatchCount  = 0 ;
+static struct
 {
-  struct wiringPiNodeStruct *node = wiringPiNodes ;
+  volatile unsigned int *reg ;
+  unsigned int mask ;
+} wpiBatchRegs [WPI_BATCH_REGS] ;
 
-  if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
-  {
-    switch(wiringPiMode) {
-      default: //WPI_MODE_GPIO_SYS
-        fprintf(stderr, "digitalRead: invalid mode\n");
-        return LOW;
-      case WPI_MODE_PINS:
-        pin = pinToGpio [pin];
-        break;
-      case WPI_MODE_PHYS:
-        pin = physToGpio [pin];
-        break;
-      case WPI_MODE_GPIO_DEVICE_BCM:
-        return digitalReadDeviceV2(pin);
-      case WPI_MODE_GPIO_DEVICE_WPI:
-        return digitalReadDeviceV2(pinToGpio[pin]);
-      case WPI_MODE_GPIO_DEVICE_PHYS:
-        return digitalReadDeviceV2(physToGpio[pin]);
-      case WPI_MODE_GPIO:
-        break;
-    }
+static void wpiBatchFlush (void)
+{
+  int i ;
+
+  __sync_synchronize () ;
+  for (i = 0 ; i < wpiBatchCount ; ++i)
+    if (wpiBatchRegs [i].mask != 0)
+      *wpiBatchRegs [i].reg = wpiBatchRegs [i].mask ;
+  __sync_synchronize () ;
+  wpiBatchCount = 0 ;
+}
 
-    if (ISRP1MODEL) {
+// Fold one SET/CLR-style store into the open batch. The same bit pending
+//	on the partner register is withdrawn first, so a pin written twice
+//	within one batch ends up with its last value only - single-store
+//	semantics, just deferred.
+
+static void wpiBatchStore (volatile unsigned int *reg, volatile unsigned int *partner, unsigned int mask)
+{
+  int i, slot = -1 ;
+
+  for (i = 0 ; i < wpiBatchCount ; ++i)
+  {
+    /**/ if (wpiBatchRegs [i].reg == partner)
+      wpiBatchRegs [i].mask &= ~mask ;
+    else if (wpiBatchRegs [i].reg == reg)
+      slot = i ;
+  }
+
+  if (slot < 0)
+  {
+    if (wpiBatchCount == WPI_BATCH_REGS)	// can't happen with the on-board banks
+      wpiBatchFlush () ;
+    slot = wpiBatchCount++ ;
+    wpiBatchRegs [slot].reg  = reg ;
+    wpiBatchRegs [slot].mask = 0 ;
+  }
+  wpiBatchRegs [slot].mask |= mask ;
+}
+
+
+static int digitalReadFastBCM (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if (wpiBatchActive)
+    wpiBatchFlush () ;
+
+  if ((pin & PI_GPIO_MASK) == 0)
+  {
+    if ((pin = pinDesc [pin & 63].toBcm) == 0xFF)
+      return LOW ;
+    return ((*(gpio + pinDesc [pin].levOff) & pinDesc [pin].mask) != 0) ? HIGH : LOW ;
+  }
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return LOW ;
+  return node->digitalRead (node, pin) ;
+}
+
+static int digitalReadFastRP1 (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if (wpiBatchActive)
+    wpiBatchFlush () ;
+
+  if ((pin & PI_GPIO_MASK) == 0)
+  {
+    if ((pin = pinDesc [pin & 63].toBcm) == 0xFF)
+      return LOW ;
+    return ((gpio [2*pin] & RP1_STATUS_LEVEL_MASK) == RP1_STATUS_LEVEL_HIGH) ? HIGH : LOW ;
+  }
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return LOW ;
+  return node->digitalRead (node, pin) ;
+}
+
+static void digitalWriteFastBCM (int pin, int value)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((pin & PI_GPIO_MASK) == 0)
+  {
+    if ((pin = pinDesc [pin & 63].toBcm) == 0xFF)
+      return ;
+    if (wpiBatchActive)
+    {
+      if (value == LOW)
+	wpiBatchStore (gpio + pinDesc [pin].clrOff, gpio + pinDesc [pin].setOff, pinDesc [pin].mask) ;
+      else
+	wpiBatchStore (gpio + pinDesc [pin].setOff, gpio + pinDesc [pin].clrOff, pinDesc [pin].mask) ;
+      return ;
+    }
+    if (value == LOW)
+      *(gpio + pinDesc [pin].clrOff) = pinDesc [pin].mask ;
+    else
+      *(gpio + pinDesc [pin].setOff) = pinDesc [pin].mask ;
+  }
+  else if ((node = wiringPiFindNode (pin)) != NULL)
+    node->digitalWrite (node, pin, value) ;
+}
+
+static void digitalWriteFastRP1 (int pin, int value)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((pin & PI_GPIO_MASK) == 0)
+  {
+    if ((pin = pinDesc [pin & 63].toBcm) == 0xFF)
+      return ;
+    if (wpiBatchActive)
+    {
+      if (value == LOW)
+	wpiBatchStore (&rio [RP1_RIO_OUT + RP1_CLR_OFFSET], &rio [RP1_RIO_OUT + RP1_SET_OFFSET], pinDesc [pin].mask) ;
+      else
+	wpiBatchStore (&rio [RP1_RIO_OUT + RP1_SET_OFFSET], &rio [RP1_RIO_OUT + RP1_CLR_OFFSET], pinDesc [pin].mask) ;
+      return ;
+    }
+    if (value == LOW)
+      rio [RP1_RIO_OUT + RP1_CLR_OFFSET] = pinDesc [pin].mask ;
+    else
+      rio [RP1_RIO_OUT + RP1_SET_OFFSET] = pinDesc [pin].mask ;
+  }
+  else if ((node = wiringPiFindNode (pin)) != NULL)
+    node->digitalWrite (node, pin, value) ;
+}
+
+static void digitalToggleFastBCM (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if (wpiBatchActive)		// toggle reads the level: pending writes first
+    wpiBatchFlush () ;
+
+  if ((pin & PI_GPIO_MASK) == 0)
+  {
+    if ((pin = pinDesc [pin & 63].toBcm) == 0xFF)
+      return ;
+    if ((*(gpio + pinDesc [pin].levOff) & pinDesc [pin].mask) != 0)
+      *(gpio + pinDesc [pin].clrOff) = pinDesc [pin].mask ;
+    else
+      *(gpio + pinDesc [pin].setOff) = pinDesc [pin].mask ;
+  }
+  else if ((node = wiringPiFindNode (pin)) != NULL)
+    node->digitalWrite (node, pin, !node->digitalRead (node, pin)) ;
+}
+
+static void digitalToggleFastRP1 (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if (wpiBatchActive)		// XOR depends on the live level: pending writes first
+    wpiBatchFlush () ;
+
+  if ((pin & PI_GPIO_MASK) == 0)
+  {
+    if ((pin = pinDesc [pin & 63].toBcm) == 0xFF)
+      return ;
+    rio [RP1_RIO_OUT + RP1_XOR_OFFSET] = pinDesc [pin].mask ;
+  }
+  else if ((node = wiringPiFindNode (pin)) != NULL)
+    node->digitalWrite (node, pin, !node->digitalRead (node, pin)) ;
+}
+
+static void wiringPiSpecialiseDispatch (void)
+{
+  digitalReadImpl   = digitalReadGeneric ;
+  digitalWriteImpl  = digitalWriteGeneric ;
+  digitalToggleImpl = digitalToggleGeneric ;
+
+  switch (wiringPiMode)
+  {
+    case WPI_MODE_PINS:
+      for (int pin = 0 ; pin < 64 ; ++pin)
+	pinDesc [pin].toBcm = pinDesc [pin].wpiToBcm ;
+      break ;
+    case WPI_MODE_PHYS:
+      for (int pin = 0 ; pin < 64 ; ++pin)
+	pinDesc [pin].toBcm = pinDesc [pin].physToBcm ;
+      break ;
+    case WPI_MODE_GPIO:
+      for (int pin = 0 ; pin < 64 ; ++pin)
+	pinDesc [pin].toBcm = (piRP1Model () && pin > 27) ? 0xFF : (uint8_t)pin ;
+      break ;
+    default:		return ;	// device/sim modes keep the generic path
+  }
+
+  if (piRP1Model ())
+  {
+    digitalReadImpl   = digitalReadFastRP1 ;
+    digitalWriteImpl  = digitalWriteFastRP1 ;
+    digitalToggleImpl = digitalToggleFastRP1 ;
+  }
+  else
+  {
+    digitalReadImpl   = digitalReadFastBCM ;
+    digitalWriteImpl  = digitalWriteFastBCM ;
+    digitalToggleImpl = digitalToggleFastBCM ;
+  }
+}
+
+
+static int digitalReadGeneric (int pin)
+{
+  struct wiringPiNodeStruct *node = wiringPiNodes ;
+
+  if (wpiBatchActive)
+    wpiBatchFlush () ;
+
+  if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
+  {
+    switch(wiringPiMode) {
+      default: //WPI_MODE_GPIO_SYS
+        fprintf(stderr, "digitalRead: invalid mode\n");
+        return LOW;
+      case WPI_MODE_PINS:
+        pin = pinToGpio [pin];
+        break;
+      case WPI_MODE_PHYS:
+        pin = physToGpio [pin];
+        break;
+      case WPI_MODE_GPIO_DEVICE_BCM:
+        return digitalReadDeviceV2(pin);
+      case WPI_MODE_GPIO_DEVICE_WPI:
+        return digitalReadDeviceV2(pinToGpio[pin]);
+      case WPI_MODE_GPIO_DEVICE_PHYS:
+        return digitalReadDeviceV2(physToGpio[pin]);
+      case WPI_MODE_SIM:
+        return digitalReadSim(pin);
+      case WPI_MODE_GPIO:
+        break;
+    }
+
+    if (ISRP1MODEL) {
       switch(gpio[2*pin] & RP1_STATUS_LEVEL_MASK) {
         default: // 11 or 00 not allowed, give LOW!
         case RP1_STATUS_LEVEL_LOW:  return LOW ;
         case RP1_STATUS_LEVEL_HIGH: return HIGH ;
       }
     } else {
-      if ((*(gpio + gpioToGPLEV [pin]) & (1 << (pin & 31))) != 0)
+      if ((*(gpio + pinDesc [pin].levOff) & pinDesc [pin].mask) != 0)
         return HIGH ;
       else
         return LOW ;
@@ -2319,6 +4133,13 @@ int digitalRead (int pin)
   }
 }
 
+int digitalRead (int pin)
+{
+  WPI_TRACE (WPI_TRACE_DREAD, pin, 0) ;
+
+  return digitalReadImpl (pin) ;
+}
+
 
 /*
  * digitalWrite:
@@ -2356,7 +4177,7 @@ void digitalWriteDeviceV2(int pin, int value) {
 }
 
 
-void digitalWrite (int pin, int value)
+static void digitalWriteGeneric (int pin, int value)
 {
   struct wiringPiNodeStruct *node = wiringPiNodes ;
 
@@ -2381,23 +4202,37 @@ void digitalWrite (int pin, int value)
       case WPI_MODE_GPIO_DEVICE_PHYS:
         digitalWriteDeviceV2(physToGpio[pin], value);
         return;
+      case WPI_MODE_SIM:
+        digitalWriteSim(pin, value);
+        return;
       case WPI_MODE_GPIO:
         break;
     }
 
     if (ISRP1MODEL) {
-      if (value == LOW) {
+      if (wpiBatchActive) {
+        if (value == LOW)
+          wpiBatchStore (&rio [RP1_RIO_OUT + RP1_CLR_OFFSET], &rio [RP1_RIO_OUT + RP1_SET_OFFSET], pinDesc [pin].mask) ;
+        else
+          wpiBatchStore (&rio [RP1_RIO_OUT + RP1_SET_OFFSET], &rio [RP1_RIO_OUT + RP1_CLR_OFFSET], pinDesc [pin].mask) ;
+      } else if (value == LOW) {
         //printf("Set pin %d >>0x%08x<< to low\n", pin, 1<<pin);
-        rio[RP1_RIO_OUT + RP1_CLR_OFFSET] = 1<<pin;
+        rio[RP1_RIO_OUT + RP1_CLR_OFFSET] = pinDesc [pin].mask;
       } else {
         //printf("Set pin %d >>0x%08x<< to high\n", pin, 1<<pin);
-        rio[RP1_RIO_OUT + RP1_SET_OFFSET] = 1<<pin;
+        rio[RP1_RIO_OUT + RP1_SET_OFFSET] = pinDesc [pin].mask;
       }
     } else {
-      if (value == LOW)
-        *(gpio + gpioToGPCLR [pin]) = 1 << (pin & 31) ;
+      if (wpiBatchActive) {
+        if (value == LOW)
+          wpiBatchStore (gpio + pinDesc [pin].clrOff, gpio + pinDesc [pin].setOff, pinDesc [pin].mask) ;
+        else
+          wpiBatchStore (gpio + pinDesc [pin].setOff, gpio + pinDesc [pin].clrOff, pinDesc [pin].mask) ;
+      }
+      else if (value == LOW)
+        *(gpio + pinDesc [pin].clrOff) = pinDesc [pin].mask ;
       else
-        *(gpio + gpioToGPSET [pin]) = 1 << (pin & 31) ;
+        *(gpio + pinDesc [pin].setOff) = pinDesc [pin].mask ;
     }
   }
   else
@@ -2407,6 +4242,81 @@ void digitalWrite (int pin, int value)
   }
 }
 
+void digitalWrite (int pin, int value)
+{
+  WPI_TRACE (WPI_TRACE_DWRITE, pin, value) ;
+
+  digitalWriteImpl (pin, value) ;
+}
+
+
+/*
+ * digitalToggle:
+ *	Flip an output bit. On the Pi 5 the RIO block has an XOR alias
+ *	next to SET/CLR, so this is a single unconditional store - no
+ *	read-back and no value-dependent branch - which matters to
+ *	bit-banging code that toggles constantly. Everywhere else it's a
+ *	read of the current level and the opposite write.
+ *********************************************************************************
+ */
+
+static void digitalToggleGeneric (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
+  {
+    switch(wiringPiMode) {
+      default: //WPI_MODE_GPIO_SYS
+        fprintf(stderr, "digitalToggle: invalid mode\n");
+        return;
+      case WPI_MODE_PINS:
+        pin = pinToGpio [pin];
+        break;
+      case WPI_MODE_PHYS:
+        pin = physToGpio [pin];
+        break;
+      case WPI_MODE_GPIO_DEVICE_BCM:
+        digitalWriteDeviceV2(pin, !digitalReadDeviceV2(pin));
+        return;
+      case WPI_MODE_GPIO_DEVICE_WPI:
+        pin = pinToGpio [pin];
+        digitalWriteDeviceV2(pin, !digitalReadDeviceV2(pin));
+        return;
+      case WPI_MODE_GPIO_DEVICE_PHYS:
+        pin = physToGpio [pin];
+        digitalWriteDeviceV2(pin, !digitalReadDeviceV2(pin));
+        return;
+      case WPI_MODE_SIM:
+        digitalWriteSim(pin, !digitalReadSim(pin));
+        return;
+      case WPI_MODE_GPIO:
+        break;
+    }
+
+    if (ISRP1MODEL) {
+      rio[RP1_RIO_OUT + RP1_XOR_OFFSET] = pinDesc [pin].mask;
+    } else {
+      if ((*(gpio + pinDesc [pin].levOff) & pinDesc [pin].mask) != 0)
+        *(gpio + pinDesc [pin].clrOff) = pinDesc [pin].mask ;
+      else
+        *(gpio + pinDesc [pin].setOff) = pinDesc [pin].mask ;
+    }
+  }
+  else
+  {
+    if ((node = wiringPiFindNode (pin)) != NULL)
+      node->digitalWrite (node, pin, !node->digitalRead (node, pin)) ;
+  }
+}
+
+void digitalToggle (int pin)
+{
+  WPI_TRACE (WPI_TRACE_DWRITE, pin, 2) ;
+
+  digitalToggleImpl (pin) ;
+}
+
 
 void pwmWrite (int pin, int value)
 {
@@ -2425,8 +4335,17 @@ void pwmWrite (int pin, int value)
       value = (OSC_FREQ_BCM2711*value)/OSC_FREQ_DEFAULT;
     }
     */
-    usingGpioMemCheck ("pwmWrite") ;
     int channel = gpioToPwmPort[pin];
+    if (piRP1Model() && !pwm && rp1SysPwmUse()) {
+      if (channel>=0 && channel<=3) {
+        rp1SysPwmDuty[channel] = value;
+        rp1SysPwmApply(channel);
+      } else {
+        fprintf(stderr, "pwmWrite: invalid channel at GPIO pin %d \n", pin);
+      }
+      return;
+    }
+    usingGpioMemCheck ("pwmWrite") ;
     int readback = 0x00;
     if (piRP1Model()) {
       if (channel>=0 && channel<=3) {
@@ -2437,6 +4356,10 @@ void pwmWrite (int pin, int value)
         fprintf(stderr, "pwmWrite: invalid channel at GPIO pin %d \n", pin);
       }
     } else {
+      if (!bcmPwm()) {
+        fprintf(stderr, "wiringPi: pwmWrite but no pwm memory available, ignoring\n");
+        return;
+      }
       *(pwm + channel) = value ;
       readback = *(pwm + channel);
     }
@@ -2452,6 +4375,149 @@ void pwmWrite (int pin, int value)
 }
 
 
+/*
+ * pwmAutoWrite:
+ *	Pi Specific
+ *	PWM a pin by whatever means it supports: pins that mux to the
+ *	hardware PWM peripheral get the real thing, anything else falls
+ *	back to the softPwm scheduler - so only the pins that truly need
+ *	it cost timer wakeups. The value is always 0-1024 (the hardware
+ *	default range); the soft path scales it to its own range.
+ *	The first write to a pin claims and configures it.
+ *********************************************************************************
+ */
+
+#define	PWM_AUTO_HARD	1
+#define	PWM_AUTO_SOFT	2
+
+static uint8_t pwmAutoPath [64] ;	// 0: unclaimed
+
+void pwmAutoWrite (int pin, int value)
+{
+  int bcm ;
+
+  setupCheck ("pwmAutoWrite") ;
+
+  if ((pin & PI_GPIO_MASK) != 0 || pin > 63)	// On-board pins only
+  {
+    wiringPiError (WPI_ERROR_BAD_PIN, "pwmAutoWrite: pin %d is not an on-board pin", pin) ;
+    return ;
+  }
+
+  if      (value <    0) value =    0 ;
+  else if (value > 1024) value = 1024 ;
+
+  if (pwmAutoPath [pin] == 0)		// First write claims the pin
+  {
+    bcm = pin ;
+    if ((!usingGpioMem || rp1SysPwmUse ()) && ToBCMPin (&bcm) && gpioToPwmALT [bcm] != 0)
+    {
+      pwmAutoPath [pin] = PWM_AUTO_HARD ;
+      pinMode (pin, PWM_OUTPUT) ;	// Muxes the pin, range 1024, clock 32
+    }
+    else
+    {
+      pwmAutoPath [pin] = PWM_AUTO_SOFT ;
+      softPwmCreate (pin, 0, 100) ;
+    }
+  }
+
+  if (pwmAutoPath [pin] == PWM_AUTO_HARD)
+    pwmWrite (pin, value) ;
+  else
+    softPwmWrite (pin, (value * 100) / 1024) ;
+}
+
+
+/*
+ * pwmStreamWrite:
+ *	Pi Specific
+ *	Stream a buffer of samples through the PWM FIFO at a fixed rate -
+ *	servo ramps and audio-rate waveforms without a function call per
+ *	sample. The hardware pops one sample per period so the pacing is
+ *	free; we only top the FIFO up when it has room and sleep while it
+ *	drains. Samples are 0-1023 full-scale and are rescaled onto the
+ *	range the rate works out to. The pin must already be in PWM_OUTPUT
+ *	mode; the range and clock are reprogrammed for the stream and the
+ *	control register is put back afterwards, so pwmWrite() carries on
+ *	working. Blocks until the FIFO has drained. Returns the number of
+ *	samples streamed, or -1 on a bad pin or rate - the Pi 5 included,
+ *	whose RP1 block feeds its FIFO differently and isn't driven here.
+ *********************************************************************************
+ */
+
+int pwmStreamWrite (int pin, const unsigned int *samples, int numSamples, unsigned int rateHz)
+{
+  unsigned int control, range, value, fifoNapUs ;
+  int i ;
+
+  setupCheck ("pwmStreamWrite") ;
+
+  if ((samples == NULL) || (numSamples < 1) || (rateHz == 0) || (rateHz > 9600000))
+    return -1 ;
+  if ((pin & PI_GPIO_MASK) != 0)		// On-board pins only
+    return -1 ;
+  if (piRP1Model ())
+  {
+    wiringPiError (WPI_ERROR_UNSUPPORTED, "pwmStreamWrite: Raspberry Pi 5 missing feature PWM FIFO streaming") ;
+    return -1 ;
+  }
+  if (!ToBCMPin (&pin))
+    return -1 ;
+  if (gpioToPwmALT [pin] == 0)
+  {
+    wiringPiError (WPI_ERROR_BAD_PIN, "pwmStreamWrite: GPIO pin %d has no hardware PWM", pin) ;
+    return -1 ;
+  }
+  usingGpioMemCheck ("pwmStreamWrite") ;
+  if (!bcmPwm () || !bcmClk ())
+  {
+    wiringPiError (WPI_ERROR_NO_PERMISSION, "wiringPi: pwmStreamWrite but no pwm memory available, ignoring") ;
+    return -1 ;
+  }
+
+// One FIFO pop per period: range = 19.2MHz / rate at divisor 1
+
+  range = (OSC_FREQ_DEFAULT * 100000U) / rateHz ;
+  if (range < 2)
+    range = 2 ;
+  fifoNapUs = 8000000U / rateHz ;		// half of the 16-entry FIFO
+  if (fifoNapUs == 0)
+    fifoNapUs = 1 ;
+
+  control = *(pwm + PWM_CONTROL) ;
+  if (gpioToPwmPort [pin] == PWM0_DATA)
+  {
+    *(pwm + PWM0_RANGE) = range ; delayMicroseconds (10) ;
+    pwmSetClock (1) ;
+    *(pwm + PWM_CONTROL) = (control & ~PWM0_SERIAL) | PWM0_MS_MODE | PWM0_USEFIFO | PWM0_ENABLE | PWM_CLRFIFO ;
+  }
+  else
+  {
+    *(pwm + PWM1_RANGE) = range ; delayMicroseconds (10) ;
+    pwmSetClock (1) ;
+    *(pwm + PWM_CONTROL) = (control & ~PWM1_SERIAL) | PWM1_MS_MODE | PWM1_USEFIFO | PWM1_ENABLE | PWM_CLRFIFO ;
+  }
+
+  for (i = 0 ; i < numSamples ; ++i)
+  {
+    while (*(pwm + PWM_STATUS) & PWM_STA_FULL)
+      delayMicroseconds (fifoNapUs) ;
+    value = (samples [i] > 1023) ? 1023 : samples [i] ;
+    *(pwm + PWM_FIFO) = (unsigned int)(((unsigned long long)value * range) >> 10) ;
+  }
+
+// Let the FIFO drain, then hand the channel back to the data register
+
+  while (!(*(pwm + PWM_STATUS) & PWM_STA_EMPT))
+    delayMicroseconds (fifoNapUs) ;
+  delayMicroseconds (fifoNapUs) ;		// the last sample is still clocking out
+
+  *(pwm + PWM_CONTROL) = control ;
+  return numSamples ;
+}
+
+
 /*
  * analogRead:
  *	Read the analog value of a given Pin.
@@ -2491,9 +4557,230 @@ void analogWrite (int pin, int value)
 
 
 /*
- * pwmToneWrite:
- *	Pi Specific.
- *      Output the given frequency on the Pi's PWM pin
+ * digitalWriteBank:
+ * digitalReadBank:
+ *	Access a group of pins on one extension node in a single call.
+ *	Bit N of the mask/values is pin (pinBase + N). Drivers that can
+ *	collapse this into one bus transaction supply the node's bank
+ *	entry points; for everyone else we fall back to the single-pin
+ *	calls bit by bit.
+ *********************************************************************************
+ */
+
+void digitalWriteBank (int pinBase, unsigned int mask, unsigned int values)
+{
+  struct wiringPiNodeStruct *node ;
+  int bit ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return ;
+
+  if (node->digitalWriteBank != NULL)
+  {
+    node->digitalWriteBank (node, mask, values) ;
+    return ;
+  }
+
+  for (bit = 0 ; mask >> bit ; ++bit)
+    if (mask & (1 << bit))
+      node->digitalWrite (node, pinBase + bit, (values & (1 << bit)) ? HIGH : LOW) ;
+}
+
+unsigned int digitalReadBank (int pinBase, unsigned int mask)
+{
+  struct wiringPiNodeStruct *node ;
+  unsigned int values = 0 ;
+  int bit ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return 0 ;
+
+  if (node->digitalReadBank != NULL)
+    return node->digitalReadBank (node, mask) & mask ;
+
+  for (bit = 0 ; mask >> bit ; ++bit)
+    if (mask & (1 << bit))
+      if (node->digitalRead (node, pinBase + bit) != LOW)
+	values |= (1 << bit) ;
+
+  return values ;
+}
+
+
+/*
+ * analogReadScan:
+ *	Convert a set of channels on one ADC node in a single call - bit N
+ *	of the mask selects pin (pinBase + N) and its result lands in
+ *	results [N]. ADC drivers that can chain the conversions into one
+ *	bus transaction supply the node's scan entry point; for everyone
+ *	else we fall back to channel-by-channel analogRead. Returns the
+ *	number of channels converted, -1 if there's no node there.
+ *********************************************************************************
+ */
+
+int analogReadScan (int pinBase, unsigned int mask, int *results)
+{
+  struct wiringPiNodeStruct *node ;
+  int bit, done ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  if (node->analogReadScan != NULL)
+    return node->analogReadScan (node, mask, results) ;
+
+  done = 0 ;
+  for (bit = 0 ; mask >> bit ; ++bit)
+    if (mask & (1 << bit))
+    {
+      results [bit] = node->analogRead (node, pinBase + bit) ;
+      ++done ;
+    }
+
+  return done ;
+}
+
+
+/*
+ * analogReadMulti:
+ *	Convert an arbitrary set of channels, possibly spread over several
+ *	ADC nodes, with the nodes worked concurrently - each node lives on
+ *	its own bus transaction stream, so a scan over three I2C ADCs and
+ *	an SPI one finishes in the time of the slowest, not the sum. Node
+ *	groups are farmed out to the piThreadPool workers (the caller takes
+ *	one group itself); without a pool the groups simply run in turn, so
+ *	the call always works. Within a group the node's scan entry point
+ *	is used where it exists. Pins with no node read as 0, as analogRead
+ *	does. Returns the number of pins that found a node.
+ *********************************************************************************
+ */
+
+#define	ANALOG_MULTI_GROUPS	16	// Distinct nodes worked concurrently
+
+struct analogMultiGroup
+{
+  struct wiringPiNodeStruct *node ;
+  const int *pins ;
+  int *values ;
+  int n ;
+  sem_t *done ;
+} ;
+
+static void analogReadMultiWorker (void *arg)
+{
+  struct analogMultiGroup *g = (struct analogMultiGroup *)arg ;
+  struct wiringPiNodeStruct *node = g->node ;
+  int results [32] ;
+  unsigned int mask ;
+  int i, bit, scannable ;
+
+// One scan transaction where the driver offers it and every channel
+//	fits the 32-bit mask; strays fall back to single reads below
+
+  mask      = 0 ;
+  scannable = (node->analogReadScan != NULL) ;
+  if (scannable)
+    for (i = 0 ; i < g->n ; ++i)
+    {
+      if (wiringPiFindNode (g->pins [i]) != node)
+	continue ;
+      bit = g->pins [i] - node->pinBase ;
+      if (bit < 0 || bit >= 32)
+      {
+	scannable = FALSE ;
+	break ;
+      }
+      mask |= 1u << bit ;
+    }
+
+  if (scannable && mask != 0)
+  {
+    if (node->analogReadScan (node, mask, results) >= 0)
+      for (i = 0 ; i < g->n ; ++i)
+	if (wiringPiFindNode (g->pins [i]) == node)
+	  g->values [i] = results [g->pins [i] - node->pinBase] ;
+  }
+  else
+    for (i = 0 ; i < g->n ; ++i)
+      if (wiringPiFindNode (g->pins [i]) == node)
+	g->values [i] = node->analogRead (node, g->pins [i]) ;
+
+  if (g->done != NULL)
+    sem_post (g->done) ;
+}
+
+int analogReadMulti (const int *pins, int *values, int n)
+{
+  struct analogMultiGroup groups [ANALOG_MULTI_GROUPS] ;
+  struct wiringPiNodeStruct *node ;
+  sem_t done ;
+  int i, g, nGroups, found, waits ;
+
+  if (pins == NULL || values == NULL || n <= 0)
+    return -1 ;
+
+  nGroups = 0 ;
+  found   = 0 ;
+  for (i = 0 ; i < n ; ++i)
+  {
+    values [i] = 0 ;
+    if ((node = wiringPiFindNode (pins [i])) == NULL)
+      continue ;
+    ++found ;
+
+    for (g = 0 ; g < nGroups ; ++g)
+      if (groups [g].node == node)
+	break ;
+    if (g == nGroups)
+    {
+      if (nGroups >= ANALOG_MULTI_GROUPS)	// Improbably many nodes - read this one now
+      {
+	values [i] = node->analogRead (node, pins [i]) ;
+	continue ;
+      }
+      groups [nGroups].node   = node ;
+      groups [nGroups].pins   = pins ;
+      groups [nGroups].values = values ;
+      groups [nGroups].n      = n ;
+      groups [nGroups].done   = NULL ;
+      ++nGroups ;
+    }
+  }
+
+  if (nGroups == 0)
+    return found ;
+
+// Farm out all but the first group - the caller is a worker too - and
+//	meet at the semaphore
+
+  sem_init (&done, 0, 0) ;
+  waits = 0 ;
+  for (g = 1 ; g < nGroups ; ++g)
+  {
+    groups [g].done = &done ;
+    if (piThreadPoolSubmit (analogReadMultiWorker, &groups [g]))
+      ++waits ;
+    else
+      groups [g].done = NULL ;			// No pool (or full) - run it here
+  }
+  for (g = 1 ; g < nGroups ; ++g)
+    if (groups [g].done == NULL)
+      analogReadMultiWorker (&groups [g]) ;
+
+  analogReadMultiWorker (&groups [0]) ;
+
+  while (waits-- > 0)
+    sem_wait (&done) ;
+  sem_destroy (&done) ;
+
+  return found ;
+}
+
+
+/*
+ * pwmToneWrite:
+ *	Pi Specific.
+ *      Output the given frequency on the Pi's PWM pin
  *********************************************************************************
  */
 
@@ -2512,6 +4799,67 @@ void pwmToneWrite (int pin, int freq)
 }
 
 
+/*
+ * toneWriteHw:
+ *	Pi Specific
+ *	Tone a pin by whatever means it supports: the GP clock pins get
+ *	the clock peripheral - a hardware square wave with the fractional
+ *	divider filling in between integer frequencies, and no thread
+ *	waking up twice per cycle - everything else falls back to the
+ *	softTone loop. Drop-in for softToneWrite: freq in Hz, 0 for
+ *	silence. The first write to a pin claims and configures it.
+ *********************************************************************************
+ */
+
+#define	TONE_HW_CLOCK	1
+#define	TONE_HW_SOFT	2
+
+static uint8_t toneHwPath [64] ;	// 0: unclaimed
+
+void toneWriteHw (int pin, int freq)
+{
+  int bcm ;
+
+  setupCheck ("toneWriteHw") ;
+
+  if ((pin & PI_GPIO_MASK) != 0 || pin > 63)	// On-board pins only
+  {
+    wiringPiError (WPI_ERROR_BAD_PIN, "toneWriteHw: pin %d is not an on-board pin", pin) ;
+    return ;
+  }
+  if (freq < 0)
+    freq = 0 ;
+
+  if (toneHwPath [pin] == 0)		// First write claims the pin
+  {
+    bcm = pin ;
+    if (!usingGpioMem && !piRP1Model () && ToBCMPin (&bcm) && gpioToGpClkALT0 [bcm] != 0)
+    {
+      toneHwPath [pin] = TONE_HW_CLOCK ;
+      pinMode (pin, GPIO_CLOCK) ;	// Muxes the pin
+    }
+    else
+    {
+      toneHwPath [pin] = TONE_HW_SOFT ;
+      softToneCreate (pin) ;
+    }
+  }
+
+  if (toneHwPath [pin] == TONE_HW_CLOCK)
+  {
+    bcm = pin ;
+    if (!ToBCMPin (&bcm) || !bcmClk ())
+      return ;
+    if (freq == 0)			// Silence: stop the clock generator
+      *(clk + gpioToClkCon [bcm]) = BCM_PASSWORD | GPIO_CLOCK_SOURCE ;
+    else
+      gpioClockSet (pin, freq) ;
+  }
+  else
+    softToneWrite (pin, freq) ;
+}
+
+
 
 /*
  * digitalWriteByte:
@@ -2536,8 +4884,6 @@ void digitalWriteByte (const int value)
   int mask = 1 ;
   int pin ;
 
-  FailOnModel5("digitalWriteByte");
-
   if (wiringPiMode == WPI_MODE_GPIO_SYS)
   {
     return ;
@@ -2547,15 +4893,35 @@ void digitalWriteByte (const int value)
     for (pin = 0 ; pin < 8 ; ++pin)
     {
       if ((value & mask) == 0)
-	pinClr |= (1 << pinToGpio [pin]) ;
+	pinClr |= (1 << pinDesc [pin].wpiToBcm) ;
       else
-	pinSet |= (1 << pinToGpio [pin]) ;
+	pinSet |= (1 << pinDesc [pin].wpiToBcm) ;
 
       mask <<= 1 ;
     }
 
-    *(gpio + gpioToGPCLR [0]) = pinClr ;
-    *(gpio + gpioToGPSET [0]) = pinSet ;
+    if (ISRP1MODEL)
+    {
+      if (wpiBatchActive)
+      {
+	wpiBatchStore (&rio [RP1_RIO_OUT + RP1_CLR_OFFSET], &rio [RP1_RIO_OUT + RP1_SET_OFFSET], pinClr) ;
+	wpiBatchStore (&rio [RP1_RIO_OUT + RP1_SET_OFFSET], &rio [RP1_RIO_OUT + RP1_CLR_OFFSET], pinSet) ;
+	return ;
+      }
+      rio [RP1_RIO_OUT + RP1_CLR_OFFSET] = pinClr ;	// All 28 lines in one RIO bank
+      rio [RP1_RIO_OUT + RP1_SET_OFFSET] = pinSet ;
+    }
+    else
+    {
+      if (wpiBatchActive)
+      {
+	wpiBatchStore (gpio + gpioToGPCLR [0], gpio + gpioToGPSET [0], pinClr) ;
+	wpiBatchStore (gpio + gpioToGPSET [0], gpio + gpioToGPCLR [0], pinSet) ;
+	return ;
+      }
+      *(gpio + gpioToGPCLR [0]) = pinClr ;
+      *(gpio + gpioToGPSET [0]) = pinSet ;
+    }
   }
 }
 
@@ -2565,18 +4931,16 @@ unsigned int digitalReadByte (void)
   uint32_t raw ;
   uint32_t data = 0 ;
 
-  FailOnModel5("digitalReadByte");
-
   if (wiringPiMode == WPI_MODE_GPIO_SYS)
   {
     return 0;
   }
   else
   {
-    raw = *(gpio + gpioToGPLEV [0]) ; // First bank for these pins
+    raw = ISRP1MODEL ? rio [RP1_RIO_IN] : *(gpio + gpioToGPLEV [0]) ; // First bank for these pins
     for (pin = 0 ; pin < 8 ; ++pin)
     {
-      x = pinToGpio [pin] ;
+      x = pinDesc [pin].wpiToBcm ;
       data = (data << 1) | (((raw & (1 << x)) == 0) ? 0 : 1) ;
     }
   }
@@ -2596,13 +4960,28 @@ unsigned int digitalReadByte (void)
 
 void digitalWriteByte2 (const int value)
 {
-  FailOnModel5("digitalWriteByte2");
-
   if (wiringPiMode == WPI_MODE_GPIO_SYS)
   {
   }
+  else if (ISRP1MODEL)
+  {
+    if (wpiBatchActive)
+    {
+      wpiBatchStore (&rio [RP1_RIO_OUT + RP1_CLR_OFFSET], &rio [RP1_RIO_OUT + RP1_SET_OFFSET], (~value & 0xFF) << 20) ;
+      wpiBatchStore (&rio [RP1_RIO_OUT + RP1_SET_OFFSET], &rio [RP1_RIO_OUT + RP1_CLR_OFFSET], ( value & 0xFF) << 20) ;
+      return ;
+    }
+    rio [RP1_RIO_OUT + RP1_CLR_OFFSET] = (~value & 0xFF) << 20 ;
+    rio [RP1_RIO_OUT + RP1_SET_OFFSET] = ( value & 0xFF) << 20 ;
+  }
   else
   {
+    if (wpiBatchActive)
+    {
+      wpiBatchStore (gpio + gpioToGPCLR [0], gpio + gpioToGPSET [0], (~value & 0xFF) << 20) ;
+      wpiBatchStore (gpio + gpioToGPSET [0], gpio + gpioToGPCLR [0], ( value & 0xFF) << 20) ;
+      return ;
+    }
     *(gpio + gpioToGPCLR [0]) = (~value & 0xFF) << 20 ; // 0x0FF00000; ILJ > CHANGE: Old causes glitch
     *(gpio + gpioToGPSET [0]) = ( value & 0xFF) << 20 ;
   }
@@ -2612,13 +4991,11 @@ unsigned int digitalReadByte2 (void)
 {
   uint32_t data = 0 ;
 
-  FailOnModel5("digitalReadByte2");
-
   if (wiringPiMode == WPI_MODE_GPIO_SYS)
   {
   }
   else
-    data = ((*(gpio + gpioToGPLEV [0])) >> 20) & 0xFF ; // First bank for these pins
+    data = ((ISRP1MODEL ? rio [RP1_RIO_IN] : *(gpio + gpioToGPLEV [0])) >> 20) & 0xFF ; // First bank for these pins
 
   return data ;
 }
@@ -2626,497 +5003,2849 @@ unsigned int digitalReadByte2 (void)
 
 
 /*
- * waitForInterrupt2:
- *	Wait for Interrupt on a GPIO pin and use v2 of the character device API, need Kernel 5.1
- *  Returns struct WPIWfiStatus
+ * digitalWriteMulti:
+ *	Pi Specific
+ *	Write an arbitrary set of on-board pins in one go. The mask and the
+ *	values are in BCM_GPIO numbering - bit N is GPIO N - whatever pin
+ *	numbering mode is in use, as we go directly to the SET/CLR registers.
+ *	On the Pi 5 (RP1) all 28 header lines live in one RIO bank, so the
+ *	whole set updates in at most 2 stores. On the older SoCs it's one
+ *	GPSET/GPCLR pair per 32-pin bank.
+ *	The pins must already be in output mode - we don't check here as
+ *	this is meant for the fast paths.
  *********************************************************************************
  */
 
-struct WPIWfiStatus waitForInterrupt2(int pin, int edgeMode, int ms, unsigned long debounce_period_us)    // ms < 0 wait infinite, = 0 return immediately, > 0 wait timeout
+void digitalWriteMulti (unsigned long long pinMask, unsigned long long values)
 {
-  int ret;
-  int fd, attr, status, readret;
-  struct pollfd polls ;
-  struct gpio_v2_line_event evdata;
-  struct gpio_v2_line_config config;
-  struct gpio_v2_line_request req;
-  const char* strmode = "";
-  struct WPIWfiStatus wfiStatus;
-  
-  memset(&wfiStatus, 0, sizeof(wfiStatus));
-  /* open gpio */
-  if (wiringPiGpioDeviceGetFd()<0 || !ToBCMPin(&pin)) {
-    wfiStatus.statusOK = -1;
-    return wfiStatus;
-  }
-  
-  memset(&req, 0, sizeof(req));
-  memset(&config, 0, sizeof(config));
-  
-  /* setup config */
-  config.flags = GPIO_V2_LINE_FLAG_INPUT;
-  
-  switch(edgeMode) {
-    default:
-    case INT_EDGE_SETUP:
-      if (wiringPiDebug) {
-        printf ("waitForInterrupt2: edgeMode INT_EDGE_SETUP - exiting\n") ;
-      }
-      wfiStatus.statusOK = -1;
-      return wfiStatus;
-    case INT_EDGE_FALLING:
-      config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
-      strmode = "falling";
-      break;
-    case INT_EDGE_RISING:
-      config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
-      strmode = "rising";
-      break;
-    case INT_EDGE_BOTH:
-      config.flags |= (GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_EDGE_RISING);
-      strmode = "both";
-      break;
-  }
-  strcpy(req.consumer, "wiringpi_gpio_irq");
-  
-  if (debounce_period_us) {
-	  attr = config.num_attrs;
-	  config.num_attrs++;
-    gpiotools_set_bit(&config.attrs[attr].mask, 0);
-	  config.attrs[attr].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
-	  config.attrs[attr].attr.debounce_period_us = debounce_period_us;
-  }
-  
-  req.num_lines = 1;
-  req.offsets[0] = pin;
-  req.event_buffer_size = 32;
-  req.config = config;
+  uint64_t pinSet = pinMask &  values ;
+  uint64_t pinClr = pinMask & ~values ;
 
-  status = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
-  if (status == -1) {
-    ReportDeviceError("GPIO_V2_GET_LINE_IOCTL", pin , strmode, status);
-    wfiStatus.statusOK = -1;
-    return wfiStatus;
-  }
+  setupCheck ("digitalWriteMulti") ;
 
-  if (wiringPiDebug) {
-    printf ("waitForInterrupt2: GPIO get line %d , mode %s succeded, fd=%d\n", pin, strmode, req.fd) ;
-  }
- 
-  fd = req.fd;
-  isrFds [pin] = fd;
-  isrDebouncePeriodUs[pin] = debounce_period_us; 
-  
-/* set event fd nonbloack read */ 
-  /*
-  int flags = fcntl(fd, F_GETFL);
-  flags |= O_NONBLOCK;
-  status = fcntl(fd, F_SETFL, flags);
-  if (status) {
-    fprintf(stderr, "wiringPi: ERROR: fcntl set nonblock return=%d\n", status);
-    return -1;
+  if ((wiringPiMode == WPI_MODE_GPIO_DEVICE_BCM) || (wiringPiMode == WPI_MODE_GPIO_DEVICE_WPI) || (wiringPiMode == WPI_MODE_GPIO_DEVICE_PHYS))
+  {
+    digitalWriteMultiDevice (pinMask, values) ;	// One set-values ioctl for the group
+    return ;
   }
-*/
 
-  // Setup poll structure
-  polls.fd      = fd;
-  polls.events  = POLLIN | POLLPRI;
-  polls.revents = 0;
+  if ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO))
+  {
+    wiringPiError (WPI_ERROR_BAD_MODE, "digitalWriteMulti: invalid mode") ;
+    return ;
+  }
 
-  ret = poll(&polls, 1, ms);
-  if (ret < 0) {
-    if (wiringPiDebug) { 
-      fprintf(stderr, "waitForInterrupt2: ERROR: poll returned=%d\n", ret);
-    }
-    wfiStatus.statusOK = -1;
-  } else if (ret == 0) { 
-    if (wiringPiDebug) {
-      fprintf(stderr, "waitForInterrupt2: timeout: poll returned zero\n");
+  if (ISRP1MODEL)
+  {
+    if (wpiBatchActive)
+    {
+      wpiBatchStore (&rio [RP1_RIO_OUT + RP1_CLR_OFFSET], &rio [RP1_RIO_OUT + RP1_SET_OFFSET], (uint32_t)pinClr) ;
+      wpiBatchStore (&rio [RP1_RIO_OUT + RP1_SET_OFFSET], &rio [RP1_RIO_OUT + RP1_CLR_OFFSET], (uint32_t)pinSet) ;
+      return ;
     }
-    wfiStatus.statusOK = 0; // timeout
+    if ((uint32_t)pinClr != 0)
+      rio [RP1_RIO_OUT + RP1_CLR_OFFSET] = (uint32_t)pinClr ;
+    if ((uint32_t)pinSet != 0)
+      rio [RP1_RIO_OUT + RP1_SET_OFFSET] = (uint32_t)pinSet ;
   }
-  else {
-    if (wiringPiDebug) {
-      printf ("waitForInterrupt2: IRQ line %d received %d, fd=%d\n", pin, ret, isrFds[pin]);
+  else
+  {
+    if (wpiBatchActive)
+    {
+      wpiBatchStore (gpio + gpioToGPCLR [ 0], gpio + gpioToGPSET [ 0], (uint32_t)pinClr) ;
+      wpiBatchStore (gpio + gpioToGPSET [ 0], gpio + gpioToGPCLR [ 0], (uint32_t)pinSet) ;
+      wpiBatchStore (gpio + gpioToGPCLR [32], gpio + gpioToGPSET [32], (uint32_t)(pinClr >> 32)) ;
+      wpiBatchStore (gpio + gpioToGPSET [32], gpio + gpioToGPCLR [32], (uint32_t)(pinSet >> 32)) ;
+      return ;
     }
-    if (polls.revents & POLLIN) {  
-      /* read event data */
-      readret = read(isrFds [pin], &evdata, sizeof(evdata));
-      if (readret == sizeof(evdata)) {
-        if (wiringPiDebug) {
-          printf ("waitForInterrupt2: IRQ at PIN: %d, timestamp: %lld\n", evdata.offset, evdata.timestamp_ns) ;
-        }
-        switch (evdata.id) {
-          case GPIO_V2_LINE_EVENT_RISING_EDGE:
-            wfiStatus.edge = INT_EDGE_RISING;
-            if (wiringPiDebug) printf("waitForInterrupV2: rising edge\n");
-          break;
-          case GPIO_V2_LINE_EVENT_FALLING_EDGE:
-            wfiStatus.edge = INT_EDGE_FALLING;
-            if (wiringPiDebug) printf("waitForInterrupt2: falling edge\n");
-			    break;
-		      default:
-            wfiStatus.edge = INT_EDGE_SETUP;        // edge = 0
-            if (wiringPiDebug) printf("waitForInterrupt2: unknown event\n");
-            break;
-		    }
-        wfiStatus.timeStamp_us = evdata.timestamp_ns / 1000LL;    // nanoseconds u64 to microseconds
-        wfiStatus.pinBCM = evdata.offset;
-        wfiStatus.statusOK = 1;
-      }
-      else {
-        wfiStatus.statusOK = -1;
-      }
-    }
-    else {
-        wfiStatus.statusOK = -1;
-    }
-  }
-
-  if (isrFds[pin] > 0) {
-    close(isrFds [pin]);        // release line
-    isrFds [pin] = -1;
-    isrDebouncePeriodUs[pin] = 0;
+    if ((uint32_t)pinClr != 0)
+      *(gpio + gpioToGPCLR [ 0]) = (uint32_t)pinClr ;
+    if ((uint32_t)pinSet != 0)
+      *(gpio + gpioToGPSET [ 0]) = (uint32_t)pinSet ;
+    if ((uint32_t)(pinClr >> 32) != 0)
+      *(gpio + gpioToGPCLR [32]) = (uint32_t)(pinClr >> 32) ;
+    if ((uint32_t)(pinSet >> 32) != 0)
+      *(gpio + gpioToGPSET [32]) = (uint32_t)(pinSet >> 32) ;
   }
-
-  return wfiStatus;
 }
 
-int waitForInterrupt (int pin, int ms) {
-  struct WPIWfiStatus status;
 
-  int edgeMode = isrEdgeMode[pin];
-  if (edgeMode==0) {
-    fprintf(stderr, "waitForInterrupt: ERROR: edge mode missing, legacy function, please use waitForInterrupt2!\n");
-    return -1;
-  }
-  status = waitForInterrupt2(pin, edgeMode, ms, 0);
+/*
+ * wpiBatchBegin:
+ * wpiBatchCommit:
+ *	Group the memory-mapped digitalWrite()s issued between the two
+ *	calls so they land as at most one store per SET/CLR register,
+ *	inside a single barrier pair - every store to the peripheral
+ *	window is a full bus transaction, so a display-strobe sequence
+ *	of digitalWriteByte() plus a strobe pin drops from three
+ *	transactions to two (or one on the Pi 5's single RIO bank).
+ *	Each pin keeps single-store semantics: the last value written
+ *	within the batch is the one that appears, and it appears at
+ *	commit time. Reads and toggles flush the pending batch first so
+ *	levels are never stale; extension nodes and the device/sim modes
+ *	write through as usual. Not thread-safe - like
+ *	digitalWriteByte(), a batch belongs to one thread's write burst.
+ *	Interface V3.17
+ *********************************************************************************
+ */
 
-  return  status.statusOK;
+void wpiBatchBegin (void)
+{
+  if (wpiBatchActive)		// nested begin folds into the outer batch
+    return ;
+  wpiBatchCount  = 0 ;
+  wpiBatchActive = TRUE ;
+}
+
+void wpiBatchCommit (void)
+{
+  wpiBatchActive = FALSE ;
+  wpiBatchFlush () ;
 }
 
+
 /*
- * wiringPiISRStop:
- * stop interruptHandler thread and
- * wait untill stopped.
- * close isrFds[pin], reset isrFds[pin], isrFunction[pin] and isrDebouncePeriodUs[pin]
- *
+ * wiringPiOpenPin:
+ *	Resolve a pin once - pin number translation, register addresses and
+ *	bit mask - into a handle so the tight bit-bang loops can use the
+ *	inline digitalWriteHandle/digitalReadHandle from wiringPi.h and skip
+ *	the per-call mode switch and table lookup entirely.
+ *	Returns 0 on success or -1 if the pin or mode is no good.
  *********************************************************************************
  */
 
-int wiringPiISRStop(int pin) {
+int wiringPiOpenPin (int pin, struct wiringPiPinHandle *handle)
+{
+  setupCheck ("wiringPiOpenPin") ;
 
-  if (wiringPiMode == WPI_MODE_UNINITIALISED) {
-    return wiringPiFailure(WPI_FATAL, "wiringPiISRStop: wiringPi has not been initialised. Unable to continue.\n");
+  if ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO))
+  {
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiOpenPin: invalid mode") ;
+    return -1 ;
   }
-  if (!ToBCMPin(&pin)) {
-    fprintf(stderr, "wiringPiISRStop: wrong pin %d (mode: %d) number!\n", pin, wiringPiMode);
-    return EINVAL;
+
+  if (!ToBCMPin (&pin))
+    return -1 ;
+
+  handle->pinBCM = pin ;
+  if (ISRP1MODEL)
+  {
+    handle->mask   = 1 << pin ;
+    handle->setReg = &rio [RP1_RIO_OUT + RP1_SET_OFFSET] ;
+    handle->clrReg = &rio [RP1_RIO_OUT + RP1_CLR_OFFSET] ;
+    handle->levReg = &rio [RP1_RIO_IN] ;
+    handle->xorReg = &rio [RP1_RIO_OUT + RP1_XOR_OFFSET] ;
   }
-  if (wiringPiDebug) {
-    printf("wiringPiISRStop: pin %d\n", pin) ;
+  else
+  {
+    handle->mask   = 1 << (pin & 31) ;
+    handle->setReg = gpio + gpioToGPSET [pin] ;
+    handle->clrReg = gpio + gpioToGPCLR [pin] ;
+    handle->levReg = gpio + gpioToGPLEV [pin] ;
+    handle->xorReg = NULL ;
   }
+  return 0 ;
+}
 
-  if (isrFds[pin] > 0) {
-    void *res;
 
-    if (wiringPiDebug)
-      printf("wiringPiISRStop: close thread 0x%lX\n", (unsigned long)isrThreads[pin]);
-    
-    if (isrThreads[pin] != 0) {
-      if (pthread_cancel(isrThreads[pin]) == 0) {
-        pthread_join(isrThreads[pin], &res); 
-        if (res == PTHREAD_CANCELED) {
-            if (wiringPiDebug)
-               printf("wiringPiISRStop: thread was canceled\n");
-        }
-        else {
-            if (wiringPiDebug)
-               printf("wiringPiISRStop: thread was not canceled\n");
-        }
-      } else {
-        if (wiringPiDebug)
-          printf("wiringPiISRStop: could not cancel thread\n");
-      }
-    }
-    close(isrFds [pin]);
-  } else {
-      if (wiringPiDebug)
-        printf("wiringPiISRStop: Warning stop isr, but its not active\n");
-  }
-  isrFds [pin] = -1;
-  isrFunctions[pin] = NULL;
-  isrFunctionsV2[pin] = NULL;
-  isrUserdata[pin] = NULL;;
-  isrDebouncePeriodUs[pin] = 0;
-  
-  /* -not closing so far - other isr may be using it - only close if no other is using - will code later
-  if (chipFd>0) {
-    close(chipFd);
+/*
+ * digitalReadMulti:
+ *	Pi Specific
+ *	Snapshot all on-board pin levels with one volatile load per bank and
+ *	return them as a bitmask - bit N is BCM_GPIO N, same numbering rules
+ *	as digitalWriteMulti above. The mask only trims the result, the reads
+ *	are whole-bank anyway so all requested pins come from the same instant.
+ *	Returns 0 on success or -1 if we're not in a memory-mapped mode.
+ *********************************************************************************
+ */
+
+int digitalReadMulti (unsigned long long pinMask, unsigned long long *levels)
+{
+  uint64_t raw ;
+
+  setupCheck ("digitalReadMulti") ;
+
+  if ((wiringPiMode == WPI_MODE_GPIO_DEVICE_BCM) || (wiringPiMode == WPI_MODE_GPIO_DEVICE_WPI) || (wiringPiMode == WPI_MODE_GPIO_DEVICE_PHYS))
+    return digitalReadMultiDevice (pinMask, levels) ;	// One get-values ioctl for the group
+
+  if ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO))
+  {
+    wiringPiError (WPI_ERROR_BAD_MODE, "digitalReadMulti: invalid mode") ;
+    return -1 ;
   }
-  chipFd = -1;
-  */
-  if (wiringPiDebug) {
-    printf("wiringPiISRStop: wiringPiISRStop finished\n");
+
+  if (ISRP1MODEL)
+    raw = rio [RP1_RIO_IN] ;			// One bank of 28 lines on the RP1
+  else
+  {
+    raw = *(gpio + gpioToGPLEV [0]) ;
+    if ((pinMask >> 32) != 0)
+      raw |= (uint64_t)(*(gpio + gpioToGPLEV [32])) << 32 ;
   }
-  return 0;
-}
 
-int waitForInterruptClose(int pin) {
-  return wiringPiISRStop(pin);
+  *levels = raw & pinMask ;
+  return 0 ;
 }
 
+
 /*
- * interruptHandlerV2:
- *	This is a thread and gets started to wait for the interrupt we're
- *	hoping to catch. It will call the user-function when the interrupt
- *	fires.
+ * DMA capture:
+ *	A CPU spin loop tops out around 1-2MSa/s and jitters with the
+ *	scheduler. The BCM DMA controller can do the sampling itself: a
+ *	control-block chain alternates a PWM-FIFO write (DREQ-paced, so
+ *	it sets the tempo) with a GPLEV0 read into a sample buffer, and
+ *	the CPU only waits for the end. Control blocks and samples live
+ *	in uncached VideoCore memory from the mailbox allocator, so
+ *	there's no cache to fight the DMA engine over. BCM parts only -
+ *	the RP1 hangs off PCIe and this DMA can't see it - and pins 0-31,
+ *	one GPLEV bank. The PWM block and its clock are borrowed for the
+ *	duration and restored afterwards.
  *********************************************************************************
  */
 
-void *interruptHandlerV2(void *arg)
+#define	WPI_DMA_CHANNEL		14		// A lite channel the kernel leaves alone
+#define	WPI_DMA_MAX_BUS_MEM	(16*1024*1024)	// Cap on one capture's VC memory
+
+// Mailbox property interface (/dev/vcio)
+
+#define	MB_IOCTL		_IOWR (100, 0, char *)
+#define	MB_MEM_FLAG_DIRECT	0x04		// Uncached 0xC alias
+#define	MB_MEM_FLAG_ZERO	0x10
+
+// DMA registers, word offsets within a channel's 0x100 block
+
+#define	DMA_CS			0
+#define	DMA_CONBLK_AD		1
+
+#define	DMA_CS_RESET		(1u << 31)
+#define	DMA_CS_WAIT_WRITES	(1u << 28)
+#define	DMA_CS_PANIC_PRI	(8u << 20)
+#define	DMA_CS_PRI		(8u << 16)
+#define	DMA_CS_END		(1u << 1)
+#define	DMA_CS_ACTIVE		(1u << 0)
+
+#define	DMA_TI_NO_WIDE		(1u << 26)
+#define	DMA_TI_PERMAP_PWM	(5u << 16)
+#define	DMA_TI_DEST_DREQ	(1u << 6)
+#define	DMA_TI_DEST_INC		(1u << 4)
+#define	DMA_TI_WAIT_RESP	(1u << 3)
+
+// Bus addresses - fixed regardless of where the ARM sees the peripherals
+
+#define	BUS_GPLEV0		0x7E200034u
+#define	BUS_PWM_FIF1		0x7E20C018u
+
+#define	PWM_DMAC		2		// Word offset, not in the table above
+
+struct dmaControlBlock			// As the controller fetches it - 32 bytes
 {
-  const char* strmode = ""; 
-  int pin, EdgeMode, ret, fd, attr, i;
-  unsigned int readret;
-  unsigned long debounce_period_us;
-  struct pollfd polls ;  
-  struct gpio_v2_line_config config;
-  struct gpio_v2_line_request req;
-  struct gpio_v2_line_event evdat[64];  
-  struct WPIWfiStatus wfiStatus;
-  struct timespec tspec = {0, 5e5};  /* 0.5 ms timeout {0, 1e6} */
-  
-  pin = *(int *)arg;
+  uint32_t ti, srcAd, dstAd, txLen, stride, nextCb, pad [2] ;
+} ;
 
-  if (wiringPiGpioDeviceGetFd()<0) {
-    return NULL;
+static volatile uint32_t *dmaRegs = NULL ;
+
+static unsigned int mbProperty (int mbFd, uint32_t tag, uint32_t a, uint32_t b, uint32_t c)
+{
+  uint32_t msg [32] =
+    { 8 * 4 + 3 * 4, 0, tag, 12, 12, a, b, c, 0 } ;
+
+  if (ioctl (mbFd, MB_IOCTL, msg) < 0)
+    return 0 ;
+  return msg [5] ;
+}
+
+static int wiringPiSampleDMA (unsigned long long pinMask, unsigned int rateHz, unsigned long long *buf,
+			unsigned int numSamples, struct wiringPiSampleReport *report)
+{
+  unsigned int cbBytes, smpBytes, total, osc, divi, range, achieved, i ;
+  unsigned int memHandle, busAddr, physAddr ;
+  volatile struct dmaControlBlock *cbs ;
+  volatile uint32_t *chan, *smp ;
+  uint32_t busCbs, busDummy, busSmp, savedCtl, savedRng, savedDiv ;
+  void *vcMem ;
+  int mbFd, memFd ;
+  uint64_t waitNs, spentNs ;
+
+  if (!bcmPwm () || !bcmClk ())
+    return -1 ;
+
+// One dummy pacing word sits behind the control blocks
+
+  cbBytes  = numSamples * 2 * sizeof (struct dmaControlBlock) ;
+  smpBytes = numSamples * 4 ;
+  total    = (cbBytes + 4 + smpBytes + PAGE_SIZE) & ~(PAGE_SIZE - 1) ;
+  if (total > WPI_DMA_MAX_BUS_MEM)
+    return -1 ;				// Too big for one shot - the spin loop can have it
+
+  if (dmaRegs == NULL)
+  {
+    if ((memFd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC)) < 0)
+      return -1 ;
+    dmaRegs = (volatile uint32_t *)mmap (NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+						memFd, piGpioBase + 0x00007000) ;
+    close (memFd) ;
+    if (dmaRegs == MAP_FAILED)
+    {
+      dmaRegs = NULL ;
+      return -1 ;
+    }
   }
-    
-  EdgeMode = isrEdgeMode[pin];
-  debounce_period_us = isrDebouncePeriodUs[pin];
- 
-  if (wiringPiDebug) {
-    printf ("interruptHandlerV2: GPIO line %d, edge mode %d, debounce_period_us %lu \n", pin, EdgeMode, debounce_period_us) ;
-  } 
-  
-  memset(&req, 0, sizeof(req));
-  memset(&config, 0, sizeof(config));
-  
-  /* setup config */
-  config.flags = GPIO_V2_LINE_FLAG_INPUT;
-  switch(EdgeMode) {
-    default:
-    case INT_EDGE_SETUP:
-      if (wiringPiDebug) {
-        printf ("interruptHandlerV2: waitForInterruptMode edge mode INT_EDGE_SETUP - exiting\n") ;
-      }
-      return NULL;
-    case INT_EDGE_FALLING:
-      config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
-      strmode = "falling";
-      break;
-    case INT_EDGE_RISING:
-      config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
-      strmode = "rising";
-      break;
-    case INT_EDGE_BOTH:
-      config.flags |= (GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_EDGE_RISING);
-      strmode = "both";
-      break;
+  chan = dmaRegs + WPI_DMA_CHANNEL * (0x100 / 4) ;
+
+// Uncached memory for the chain and the samples
+
+  if ((mbFd = open ("/dev/vcio", O_RDWR | O_CLOEXEC)) < 0)
+    return -1 ;
+  memHandle = mbProperty (mbFd, 0x3000C, total, PAGE_SIZE, MB_MEM_FLAG_DIRECT | MB_MEM_FLAG_ZERO) ;
+  if (memHandle == 0)
+    { close (mbFd) ; return -1 ; }
+  busAddr  = mbProperty (mbFd, 0x3000D, memHandle, 0, 0) ;
+  physAddr = busAddr & ~0xC0000000u ;
+
+  if ((memFd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC)) < 0)
+    vcMem = MAP_FAILED ;
+  else
+  {
+    vcMem = mmap (NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, physAddr) ;
+    close (memFd) ;
   }
-  strcpy(req.consumer, "wiringpi_gpio_irq");
-  
-  if (debounce_period_us) {
-		attr = config.num_attrs;
-		config.num_attrs++;
-        gpiotools_set_bit(&config.attrs[attr].mask, 0);
-		config.attrs[attr].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
-		config.attrs[attr].attr.debounce_period_us = debounce_period_us;
+  if (busAddr == 0 || vcMem == MAP_FAILED)
+  {
+    mbProperty (mbFd, 0x3000E, memHandle, 0, 0) ;
+    mbProperty (mbFd, 0x3000F, memHandle, 0, 0) ;
+    close (mbFd) ;
+    return -1 ;
   }
-  
-  req.num_lines = 1;
-  req.event_buffer_size = 45;
-  req.offsets[0] = pin;
-  req.config = config;
 
-  ret = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
-  if (ret == -1) {
-    ReportDeviceError("interruptHandlerV2: get line event", pin , strmode, ret);
-    return NULL;
+  cbs      = (volatile struct dmaControlBlock *)vcMem ;
+  smp      = (volatile uint32_t *)((char *)vcMem + cbBytes + 4) ;
+  busCbs   = busAddr ;
+  busDummy = busAddr + cbBytes ;
+  busSmp   = busAddr + cbBytes + 4 ;
+
+// The chain: pace, sample, pace, sample ... every FIFO write waits for
+//	the DREQ, every GPLEV read rides immediately behind one
+
+  for (i = 0 ; i < numSamples ; ++i)
+  {
+    cbs [2 * i].ti         = DMA_TI_NO_WIDE | DMA_TI_PERMAP_PWM | DMA_TI_DEST_DREQ | DMA_TI_WAIT_RESP ;
+    cbs [2 * i].srcAd      = busDummy ;
+    cbs [2 * i].dstAd      = BUS_PWM_FIF1 ;
+    cbs [2 * i].txLen      = 4 ;
+    cbs [2 * i].nextCb     = busCbs + (2 * i + 1) * sizeof (struct dmaControlBlock) ;
+
+    cbs [2 * i + 1].ti     = DMA_TI_NO_WIDE | DMA_TI_WAIT_RESP ;
+    cbs [2 * i + 1].srcAd  = BUS_GPLEV0 ;
+    cbs [2 * i + 1].dstAd  = busSmp + i * 4 ;
+    cbs [2 * i + 1].txLen  = 4 ;
+    cbs [2 * i + 1].nextCb = (i + 1 < numSamples) ? busCbs + (2 * i + 2) * sizeof (struct dmaControlBlock) : 0 ;
   }
 
-  if (wiringPiDebug) 
-    printf ("interruptHandlerV2: GPIO get line %d , mode %s succeded, fd=%d\n", pin, strmode, req.fd) ;
+// Borrow the PWM for pacing: serialiser mode eating FIFO words at
+//	pwmclock/range, so the DREQ fires at the sample rate
+
+  osc      = (piGpioBase == GPIO_PERI_BASE_2711) ? 54000000 : 19200000 ;
+  divi     = 2 ;
+  range    = (osc / divi) / rateHz ;
+  if (range < 1)
+    range  = 1 ;
+  achieved = (osc / divi) / range ;
+
+  savedCtl = *(pwm + PWM_CONTROL) ;
+  savedRng = *(pwm + PWM0_RANGE) ;
+  savedDiv = *(clk + PWMCLK_DIV) ;
+
+  *(pwm + PWM_CONTROL) = 0 ;				// Stop the PWM
+  *(clk + PWMCLK_CNTL) = BCM_PASSWORD | 0x01 ;		// Stop the clock
+  delayMicroseconds (110) ;
+  while ((*(clk + PWMCLK_CNTL) & 0x80) != 0)
+    delayMicroseconds (1) ;
+  *(clk + PWMCLK_DIV)  = BCM_PASSWORD | (divi << 12) ;
+  *(clk + PWMCLK_CNTL) = BCM_PASSWORD | 0x11 ;		// Osc source, enabled
+  delayMicroseconds (10) ;
+
+  *(pwm + PWM0_RANGE)  = range ;
+  *(pwm + PWM_DMAC)    = (1u << 31) | (7 << 8) | 7 ;	// DREQ enabled
+  *(pwm + PWM_CONTROL) = PWM_CLRFIFO ;
+  *(pwm + PWM_CONTROL) = PWM0_USEFIFO | PWM0_SERIAL | PWM0_ENABLE ;
+
+// Fire the channel and wait it out - the whole capture is hardware's
+//	problem now
+
+  *(chan + DMA_CS) = DMA_CS_RESET ;
+  delayMicroseconds (10) ;
+  *(chan + DMA_CS)        = DMA_CS_END ;
+  *(chan + DMA_CONBLK_AD) = busCbs ;
+  *(chan + DMA_CS)        = DMA_CS_WAIT_WRITES | DMA_CS_PANIC_PRI | DMA_CS_PRI | DMA_CS_ACTIVE ;
+
+  waitNs  = ((uint64_t)numSamples * 1000000000ULL) / achieved * 2 + 100000000ULL ;
+  spentNs = 0 ;
+  while ((*(chan + DMA_CS) & DMA_CS_ACTIVE) != 0 && spentNs < waitNs)
+  {
+    delayMicroseconds (100) ;
+    spentNs += 100000ULL ;
+  }
 
-  /* set event fd  */
-  fd = req.fd;
-  isrFds [pin] = fd;
-  
-  (void)piHiPri (55) ;	// Only effective if we run as root
+  i = ((*(chan + DMA_CS) & DMA_CS_ACTIVE) == 0) ;	// Finished, or timed out?
+  *(chan + DMA_CS) = DMA_CS_RESET ;
 
-  for (;;) {    // check if event data is available, check if interruptHandlerV2 thread must be canceled
+// Hand the PWM back the way we found it
 
-  // Setup poll structure
-    polls.fd      = fd;
-    polls.events  = POLLIN | POLLPRI;
-    polls.revents = 0;
-    
-    // get event data, this is also a cancelation point, when pthread_cancel is called
-    ret = ppoll(&polls, 1, &tspec, NULL);     // returns -1 on error, 0 on timeout, >0 number of elements
-  
-    if (ret < 0) {      // we do not reach this point if canceled, ppoll does not return, is Cancellation Point
-        if (wiringPiDebug)  
-            printf("interruptHandlerV2: ERROR: poll returned=%d\n", ret);
-        pthread_exit(NULL); 
-        return NULL;        // never landing here
-    } else if (ret == 0) { 
-//        if (wiringPiDebug)  
-//            printf("interruptHandlerV2: timeout: poll returned=%d\n", ret);
-        continue;
-    }
-    else {
-        if (wiringPiDebug)
-            printf ("interruptHandlerV2: IRQ line %d received %d events, fd=%d\n", pin, ret, isrFds[pin]) ;
-        if (polls.revents & POLLIN) {  
-            /* read event data */
-            readret = read(fd, &evdat, sizeof(evdat));
-            if (readret >= sizeof(evdat[0])) {
-                if (wiringPiDebug)
-                    printf ("interruptHandlerV2: IRQ at PIN: %d, events: %u\n", evdat[0].offset, readret/(unsigned int)sizeof(evdat[0])) ;
-
-                ret = readret/sizeof(evdat[0]);     // number of events read from fd
-                for (i = 0; i < ret; ++i) {
-                    if (isrFunctionsV2[pin]) {
-                        if (wiringPiDebug) 
-                            printf( "interruptHandlerV2: GPIO EVENT at %llu on line %u (%u|%u) \n", evdat[i].timestamp_ns, evdat[i].offset, evdat[i].line_seqno, evdat[i].seqno);
-                        wfiStatus.statusOK = 1;
-                        wfiStatus.pinBCM = pin;
-                        switch (evdat[i].id) {
-                            case GPIO_V2_LINE_EVENT_RISING_EDGE:
-                                wfiStatus.edge = INT_EDGE_RISING;
-                                if (wiringPiDebug)
-                                    printf("waitForInterrupt2: rising edge\n");
-                                break;
-                            case GPIO_V2_LINE_EVENT_FALLING_EDGE:
-                                wfiStatus.edge = INT_EDGE_FALLING;
-                                if (wiringPiDebug)
-                                    printf("waitForInterrupt2: falling edge\n");
-                                break;
-                            default:
-                                wfiStatus.edge = INT_EDGE_SETUP;        // edge = 0
-                                if (wiringPiDebug) 
-                                    printf("waitForInterrupt2: unknown event\n");
-                                break;
-                        }        
-                        wfiStatus.timeStamp_us = evdat[i].timestamp_ns/1000LL;
-                        if (wiringPiDebug) {
-                          printf( "interruptHandlerV2: call isr function\n");
-                        }
-                        isrFunctionsV2[pin](wfiStatus, isrUserdata[pin]);
-                        if (wiringPiDebug) {
-                          printf( "interruptHandlerV2: return from isr function\n");
-                        }
-                    }
-                    if (isrFunctions[pin]) {
-                      if (wiringPiDebug) {
-                        printf( "interruptHandlerV2: call isr function classic\n");
-                      }
-                      isrFunctions[pin]();
-                      if (wiringPiDebug) {
-                        printf( "interruptHandlerV2: return from isr function classic\n");
-                      }
-                    }
-                }
-            }
-            else {  // if thread canceled we do not reach this point, read(...) does not return, is Cancellation Point
-                if (wiringPiDebug)
-                    printf ("interruptHandlerV2: reading events from fd received signal, exit thread\n");
-                pthread_exit(NULL);  
-                return NULL; // never landing here
-            }
-        }
-    }
+  *(pwm + PWM_CONTROL) = 0 ;
+  *(clk + PWMCLK_CNTL) = BCM_PASSWORD | 0x01 ;
+  delayMicroseconds (110) ;
+  while ((*(clk + PWMCLK_CNTL) & 0x80) != 0)
+    delayMicroseconds (1) ;
+  *(clk + PWMCLK_DIV)  = savedDiv | BCM_PASSWORD ;
+  *(clk + PWMCLK_CNTL) = BCM_PASSWORD | 0x11 ;
+  *(pwm + PWM0_RANGE)  = savedRng ;
+  *(pwm + PWM_CONTROL) = savedCtl ;
+
+  if (i)
+    for (i = 0 ; i < numSamples ; ++i)
+      buf [i] = smp [i] & pinMask ;
+
+  munmap (vcMem, total) ;
+  mbProperty (mbFd, 0x3000E, memHandle, 0, 0) ;		// Unlock
+  mbProperty (mbFd, 0x3000F, memHandle, 0, 0) ;		// Free
+  close (mbFd) ;
+
+  if (spentNs >= waitNs)
+    return -1 ;						// Timed out - channel in use?
+
+  if (report != NULL)
+  {
+    report->achievedRateHz  = achieved ;
+    report->missedDeadlines = 0 ;			// The pacing is hardware's
   }
+
+  return (int)numSamples ;
 }
 
 
 /*
- * wiringPiISR:
- *	Pi Specific.
- *	Take the details and create an interrupt handler that will do a call-
- *	back to the user supplied function.
- *  debounce_period_us in microseconds
+ * wiringPiSample:
+ *	Pi Specific
+ *	Logic-analyzer style capture: read the level banks numSamples
+ *	times at rateHz, packing each snapshot (masked, BCM numbering as
+ *	digitalReadMulti) into the caller's buffer. From 2MSa/s up on
+ *	BCM parts the capture runs on the DMA engine instead (see
+ *	above); otherwise pacing is a spin on
+ *	the monotonic clock against absolute per-sample deadlines - at
+ *	the rates this is for, sleeping isn't an option - so run it from
+ *	a thread prepared with piRealtimeSetup() if you care about the
+ *	tail. The optional report returns the rate actually achieved and
+ *	how many samples missed their deadline by more than a period.
+ *	Returns the number of samples captured or -1 if we're not in a
+ *	memory-mapped mode.
  *********************************************************************************
  */
 
-int wiringPiISRInternal(int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), void (*functionClassic)(void), unsigned long debounce_period_us, void* userdata)
+int wiringPiSample (unsigned long long pinMask, unsigned int rateHz, unsigned long long *buf,
+			unsigned int numSamples, struct wiringPiSampleReport *report)
 {
-  if (wiringPiMode == WPI_MODE_UNINITIALISED) {
-    return wiringPiFailure(WPI_FATAL, "wiringPiISR: wiringPi has not been initialised. Unable to continue.\n");
+  struct timespec ts ;
+  uint64_t start, now, deadline, periodNs ;
+  uint64_t raw ;
+  unsigned int i, missed ;
+
+  setupCheck ("wiringPiSample") ;
+
+  if ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO))
+  {
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiSample: only supported in the memory-mapped modes") ;
+    return -1 ;
   }
-  if (!ToBCMPin(&pin)) {
+  if (rateHz == 0 || numSamples == 0 || buf == NULL)
+    return -1 ;
+
+// Above what the spin loop can pace, hand the whole capture to the
+//	DMA engine where the hardware has one we can reach. Any setup
+//	failure just drops through to the spin loop.
+
+  if (!ISRP1MODEL && !usingGpioMem && (rateHz >= 2000000) && ((pinMask >> 32) == 0))
+    if (wiringPiSampleDMA (pinMask, rateHz, buf, numSamples, report) >= 0)
+      return (int)numSamples ;
+
+  periodNs = 1000000000ULL / rateHz ;
+  missed   = 0 ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  start    = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+  deadline = start ;
+
+  for (i = 0 ; i < numSamples ; ++i)
+  {
+    do
+    {
+      clock_gettime (CLOCK_MONOTONIC, &ts) ;
+      now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+    }
+    while (now < deadline) ;
+
+    if (ISRP1MODEL)
+      raw = rio [RP1_RIO_IN] ;			// One bank of 28 lines on the RP1
+    else
+    {
+      raw = *(gpio + gpioToGPLEV [0]) ;
+      if ((pinMask >> 32) != 0)
+	raw |= (uint64_t)(*(gpio + gpioToGPLEV [32])) << 32 ;
+    }
+    buf [i] = raw & pinMask ;
+
+    if (now > deadline + periodNs)		// Late by more than a whole period
+      ++missed ;
+    deadline += periodNs ;
+  }
+
+  if (report != NULL)
+  {
+    report->missedDeadlines = missed ;
+    report->achievedRateHz  = (now > start) ?
+	(unsigned int)(((uint64_t)numSamples * 1000000000ULL) / (now - start)) : rateHz ;
+  }
+
+  return (int)numSamples ;
+}
+
+
+// Continuous capture state - one stream per process, ping-pong between
+//	the caller's two buffers: the capture thread fills one while the
+//	drain thread hands the other to the callback, so the only copy
+//	anywhere is the register read itself.
+
+static struct
+{
+  uint64_t      pinMask ;
+  unsigned int  rateHz ;
+  unsigned int  numSamples ;
+  unsigned long long *bufs [2] ;
+  wiringPiSampleCompletion callback ;
+  int           ready [2] ;
+  struct wiringPiSampleReport report [2] ;
+  volatile int  running ;
+  pthread_t     captureThread ;
+  pthread_t     drainThread ;
+} sampleStream ;
+
+static pthread_mutex_t sampleStreamLock    = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t  sampleStreamReady   = PTHREAD_COND_INITIALIZER ;
+static pthread_cond_t  sampleStreamDrained = PTHREAD_COND_INITIALIZER ;
+
+
+static void *sampleStreamCapture (UNU void *arg)
+{
+  int which = 0 ;
+
+  piHiPri (90) ;
+
+  while (sampleStream.running)
+  {
+    pthread_mutex_lock (&sampleStreamLock) ;
+    while (sampleStream.ready [which] && sampleStream.running)	// Callback still draining it
+      pthread_cond_wait (&sampleStreamDrained, &sampleStreamLock) ;
+    pthread_mutex_unlock (&sampleStreamLock) ;
+    if (!sampleStream.running)
+      break ;
+
+    wiringPiSample (sampleStream.pinMask, sampleStream.rateHz,
+			sampleStream.bufs [which], sampleStream.numSamples, &sampleStream.report [which]) ;
+
+    pthread_mutex_lock (&sampleStreamLock) ;
+    sampleStream.ready [which] = TRUE ;
+    pthread_cond_signal (&sampleStreamReady) ;
+    pthread_mutex_unlock (&sampleStreamLock) ;
+
+    which ^= 1 ;
+  }
+  return NULL ;
+}
+
+
+static void *sampleStreamDrain (UNU void *arg)
+{
+  int which = 0 ;
+
+  for (;;)
+  {
+    pthread_mutex_lock (&sampleStreamLock) ;
+    while (!sampleStream.ready [which] && sampleStream.running)
+      pthread_cond_wait (&sampleStreamReady, &sampleStreamLock) ;
+    if (!sampleStream.ready [which] && !sampleStream.running)
+    {
+      pthread_mutex_unlock (&sampleStreamLock) ;
+      return NULL ;
+    }
+    pthread_mutex_unlock (&sampleStreamLock) ;
+
+    sampleStream.callback (sampleStream.bufs [which], sampleStream.numSamples, &sampleStream.report [which]) ;
+
+    pthread_mutex_lock (&sampleStreamLock) ;
+    sampleStream.ready [which] = FALSE ;
+    pthread_cond_signal (&sampleStreamDrained) ;
+    pthread_mutex_unlock (&sampleStreamLock) ;
+
+    which ^= 1 ;
+  }
+}
+
+
+/*
+ * wiringPiSampleStart:
+ *	Pi Specific
+ *	Continuous capture: fill bufA and bufB alternately at rateHz,
+ *	invoking the callback with each full buffer (on its own thread,
+ *	so capture keeps running while you write to disk). The callback
+ *	must finish before the other buffer fills or capture stalls at a
+ *	buffer boundary. One stream per process; numSamples is the size
+ *	of EACH buffer. Returns 0, or -1 if a stream is already running
+ *	or the arguments are unusable.
+ *********************************************************************************
+ */
+
+int wiringPiSampleStart (unsigned long long pinMask, unsigned int rateHz,
+			unsigned long long *bufA, unsigned long long *bufB,
+			unsigned int numSamples, wiringPiSampleCompletion callback)
+{
+  setupCheck ("wiringPiSampleStart") ;
+
+  if (sampleStream.running)
+    return -1 ;
+  if (rateHz == 0 || numSamples == 0 || bufA == NULL || bufB == NULL || callback == NULL)
+    return -1 ;
+
+  sampleStream.pinMask    = pinMask ;
+  sampleStream.rateHz     = rateHz ;
+  sampleStream.numSamples = numSamples ;
+  sampleStream.bufs [0]   = bufA ;
+  sampleStream.bufs [1]   = bufB ;
+  sampleStream.callback   = callback ;
+  sampleStream.ready [0]  = FALSE ;
+  sampleStream.ready [1]  = FALSE ;
+  sampleStream.running    = TRUE ;
+
+  if (pthread_create (&sampleStream.drainThread, NULL, sampleStreamDrain, NULL) != 0)
+  {
+    sampleStream.running = FALSE ;
+    return -1 ;
+  }
+  if (pthread_create (&sampleStream.captureThread, NULL, sampleStreamCapture, NULL) != 0)
+  {
+    pthread_mutex_lock (&sampleStreamLock) ;
+    sampleStream.running = FALSE ;
+    pthread_cond_broadcast (&sampleStreamReady) ;
+    pthread_mutex_unlock (&sampleStreamLock) ;
+    pthread_join (sampleStream.drainThread, NULL) ;
+    return -1 ;
+  }
+
+  return 0 ;
+}
+
+
+/*
+ * wiringPiSampleStop:
+ *	Stop the capture stream. Any buffer already handed to the
+ *	callback is drained first; a partially filled one is discarded.
+ *********************************************************************************
+ */
+
+int wiringPiSampleStop (void)
+{
+  if (!sampleStream.running)
+    return -1 ;
+
+  pthread_mutex_lock (&sampleStreamLock) ;
+  sampleStream.running = FALSE ;
+  pthread_cond_broadcast (&sampleStreamReady) ;
+  pthread_cond_broadcast (&sampleStreamDrained) ;
+  pthread_mutex_unlock (&sampleStreamLock) ;
+
+  pthread_join (sampleStream.captureThread, NULL) ;
+  pthread_join (sampleStream.drainThread,   NULL) ;
+
+  return 0 ;
+}
+
+
+/*
+ * wpiSampleToStreams: wpiStreamsToSamples:
+ *	Transpose between the sampler's word-per-sample bitmasks and
+ *	packed per-pin bit streams (and back again, for building
+ *	digitalWriteMulti/waveform buffers). Streams are LSB-first:
+ *	bit (s & 7) of byte (s >> 3) in each row is sample s of that
+ *	row's pin, rows are stride bytes apart. A scalar pass walks
+ *	one bit at a time; on AArch64 a NEON pass handles 128 samples
+ *	per iteration, gathering the pin's byte out of each mask with
+ *	de-interleaving loads and packing the bits with a widening-add
+ *	chain. A megasample across 8 pins transposes in well under a
+ *	millisecond either way.
+ *********************************************************************************
+ */
+
+#if defined (__aarch64__) && defined (__ARM_NEON)
+
+// Gather the byte at offset byteOff of each of 16 little-endian 64-bit
+//	words starting at p. vld4 de-interleaves to stride 4; the uzp
+//	separates the two stride-4 lanes a word contributes.
+
+static inline uint8x16_t sampleGather16 (const unsigned char *p, const int byteOff)
+{
+  uint8x16x4_t a = vld4q_u8 (p) ;
+  uint8x16x4_t b = vld4q_u8 (p + 64) ;
+  uint8x16x2_t u = vuzpq_u8 (a.val [byteOff & 3], b.val [byteOff & 3]) ;
+
+  return u.val [byteOff >> 2] ;
+}
+
+#endif
+
+int wpiSampleToStreams (const unsigned long long *samples, unsigned int numSamples,
+			const int *pins, int numPins, unsigned char *streams, unsigned int stride)
+{
+  int c, pin ;
+  unsigned int i, start ;
+  unsigned char *row, byte ;
+  int bit ;
+
+  if (samples == NULL || streams == NULL || pins == NULL || numPins < 1)
+    return -1 ;
+  if (stride < ((numSamples + 7) / 8))
+    return -1 ;
+  for (c = 0 ; c < numPins ; ++c)
+    if (pins [c] < 0 || pins [c] > 63)
+      return -1 ;
+
+  for (c = 0 ; c < numPins ; ++c)
+  {
+    pin   = pins [c] ;
+    row   = streams + (unsigned int)c * stride ;
+    start = 0 ;
+
+#if defined (__aarch64__) && defined (__ARM_NEON)
+    {
+      const unsigned char *p  = (const unsigned char *)samples ;
+      const int8x16_t bitPos  = { 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 } ;
+      const int8x16_t toMsb   = vdupq_n_s8 (7 - (pin & 7)) ;
+      const int byteOff       = pin >> 3 ;
+      uint8x16_t v ;
+      uint64x2_t packed ;
+      int k ;
+
+      for (; start + 128 <= numSamples ; start += 128)
+	for (k = 0 ; k < 8 ; ++k)
+	{
+	  v = sampleGather16 (p + (start + (unsigned int)k * 16) * 8, byteOff) ;
+	  v = vshrq_n_u8 (vshlq_u8 (v, toMsb), 7) ;		// The pin's bit, as 0/1
+	  v = vshlq_u8 (v, bitPos) ;				// Weighted by lane-within-byte
+	  packed = vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (v))) ;	// Horizontal OR (sum of distinct powers)
+	  row [(start >> 3) + (unsigned int)k * 2 + 0] = (unsigned char)vgetq_lane_u64 (packed, 0) ;
+	  row [(start >> 3) + (unsigned int)k * 2 + 1] = (unsigned char)vgetq_lane_u64 (packed, 1) ;
+	}
+    }
+#endif
+
+    for (i = start ; i < numSamples ;)
+    {
+      byte = 0 ;
+      for (bit = 0 ; bit < 8 && i < numSamples ; ++bit, ++i)
+	byte |= (unsigned char)((samples [i] >> pin) & 1ULL) << bit ;
+      row [(i - 1) >> 3] = byte ;
+    }
+  }
+
+  return 0 ;
+}
+
+int wpiStreamsToSamples (const unsigned char *streams, unsigned int stride,
+			const int *pins, int numPins, unsigned long long *samples, unsigned int numSamples)
+{
+  int c, pin ;
+  unsigned int i, start ;
+  const unsigned char *row ;
+
+  if (samples == NULL || streams == NULL || pins == NULL || numPins < 1)
+    return -1 ;
+  if (stride < ((numSamples + 7) / 8))
+    return -1 ;
+  for (c = 0 ; c < numPins ; ++c)
+    if (pins [c] < 0 || pins [c] > 63)
+      return -1 ;
+
+  memset (samples, 0, (size_t)numSamples * sizeof (unsigned long long)) ;
+
+  for (c = 0 ; c < numPins ; ++c)
+  {
+    pin   = pins [c] ;
+    row   = streams + (unsigned int)c * stride ;
+    start = 0 ;
+
+#if defined (__aarch64__) && defined (__ARM_NEON)
+    {
+      unsigned char *p        = (unsigned char *)samples ;
+      const uint8x16_t srcSel = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 } ;
+      const uint8x16_t bitSel = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 } ;
+      const uint8x16_t pinBit = vdupq_n_u8 ((unsigned char)(1 << (pin & 7))) ;
+      const int b4            = (pin >> 3) & 3 ;
+      const int sel           =  pin >> 5 ;
+      uint8x16x4_t a, b ;
+      uint8x16x2_t u, z ;
+      uint8x16_t bytes, bits ;
+      unsigned char *q ;
+      int k ;
+
+      for (; start + 128 <= numSamples ; start += 128)
+	for (k = 0 ; k < 8 ; ++k)
+	{
+	  q = p + (start + (unsigned int)k * 16) * 8 ;
+	  a = vld4q_u8 (q) ;
+	  b = vld4q_u8 (q + 64) ;
+	  u = vuzpq_u8 (a.val [b4], b.val [b4]) ;
+
+	  bytes = vdupq_n_u8 (0) ;				// The two stream bytes, spread 8 lanes each
+	  bytes = vsetq_lane_u8 (row [(start >> 3) + (unsigned int)k * 2 + 0], bytes, 0) ;
+	  bytes = vsetq_lane_u8 (row [(start >> 3) + (unsigned int)k * 2 + 1], bytes, 1) ;
+	  bits  = vandq_u8 (vtstq_u8 (vqtbl1q_u8 (bytes, srcSel), bitSel), pinBit) ;
+
+	  u.val [sel] = vorrq_u8 (u.val [sel], bits) ;
+	  z = vzipq_u8 (u.val [0], u.val [1]) ;
+	  a.val [b4] = z.val [0] ;
+	  b.val [b4] = z.val [1] ;
+	  vst4q_u8 (q,      a) ;
+	  vst4q_u8 (q + 64, b) ;
+	}
+    }
+#endif
+
+    for (i = start ; i < numSamples ; ++i)
+      if (row [i >> 3] & (1 << (i & 7)))
+	samples [i] |= 1ULL << pin ;
+  }
+
+  return 0 ;
+}
+
+
+/*
+ * Busy-poll edge engine:
+ *	The gpiod ISR path is wonderfully cheap when idle but an edge
+ *	still travels kernel - epoll - thread wakeup before the handler
+ *	runs, tens of microseconds on a good day. This engine trades a
+ *	whole core for determinism instead: a pinned SCHED_FIFO thread
+ *	spins on the level bank (GPLEV, or RIO_IN on the RP1 - registers
+ *	we already have mapped), calling the handler inline the moment a
+ *	masked pin changes. Timestamps come from the generic timer cycle
+ *	counter where it's readable, so they cost a few cycles and date
+ *	the register read, not the handler dispatch.
+ *********************************************************************************
+ */
+
+#ifdef __aarch64__
+static uint64_t armTimerFreq ;			// defined with the timer code below
+static inline uint64_t armTimerRead (void) ;
+#endif
+
+static struct
+{
+  volatile int       running ;
+  unsigned long long pinMask ;
+  int                edgeMode ;
+  int                core ;
+  void             (*handler) (int pinBCM, int edge, unsigned long long timeNs) ;
+  pthread_t          thread ;
+} spinPoll ;
+
+static uint64_t spinPollLevels (void)
+{
+  uint64_t raw ;
+
+  if (ISRP1MODEL)
+    raw = rio [RP1_RIO_IN] ;
+  else
+  {
+    raw = *(gpio + gpioToGPLEV [0]) ;
+    if ((spinPoll.pinMask >> 32) != 0)
+      raw |= (uint64_t)(*(gpio + gpioToGPLEV [32])) << 32 ;
+  }
+
+  return raw & spinPoll.pinMask ;
+}
+
+static void *spinPollThread (UNU void *dummy)
+{
+  uint64_t prev, now, diff, t ;
+  struct timespec ts ;
+  int pin, edge ;
+
+  if (spinPoll.core >= 0)
+    piRealtimeSetup (90, spinPoll.core) ;
+  else
+    (void)piHiPri (90) ;
+
+  prev = spinPollLevels () ;
+
+  while (spinPoll.running)
+  {
+    now  = spinPollLevels () ;
+    diff = now ^ prev ;
+    if (diff == 0)
+      continue ;
+
+#ifdef __aarch64__
+    if (armTimerFreq != 0)		// Cycle counter, converted without overflow
+    {
+      t  = armTimerRead () ;
+      t  = (t / armTimerFreq) * 1000000000ULL + ((t % armTimerFreq) * 1000000000ULL) / armTimerFreq ;
+    }
+    else
+#endif
+    {
+      clock_gettime (CLOCK_MONOTONIC, &ts) ;
+      t = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+    }
+
+    while (diff != 0)
+    {
+      pin   = __builtin_ctzll (diff) ;
+      diff &= diff - 1 ;
+      edge  = ((now >> pin) & 1) ? INT_EDGE_RISING : INT_EDGE_FALLING ;
+      if (spinPoll.edgeMode == INT_EDGE_BOTH || spinPoll.edgeMode == edge)
+	spinPoll.handler (pin, edge, t) ;
+    }
+    prev = now ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * wiringPiSpinPollStart:
+ *	Arm the busy-poll engine on a BCM pin mask. The handler runs
+ *	inline on the spinning thread - keep it to a few loads and
+ *	stores, everything else waits behind it. core picks the CPU to
+ *	burn (pass -1 to leave placement to the scheduler, which costs
+ *	latency). One engine per process. Memory-mapped modes only.
+ *********************************************************************************
+ */
+
+int wiringPiSpinPollStart (unsigned long long pinMask, int edgeMode,
+		void (*handler)(int pinBCM, int edge, unsigned long long timeNs), int core)
+{
+  setupCheck ("wiringPiSpinPollStart") ;
+
+  if ((wiringPiMode != WPI_MODE_PINS) && (wiringPiMode != WPI_MODE_PHYS) && (wiringPiMode != WPI_MODE_GPIO))
+  {
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiSpinPollStart: only supported in the memory-mapped modes") ;
+    return -1 ;
+  }
+  if (spinPoll.running || pinMask == 0 || handler == NULL)
+    return -1 ;
+  if (edgeMode != INT_EDGE_RISING && edgeMode != INT_EDGE_FALLING && edgeMode != INT_EDGE_BOTH)
+    return -1 ;
+  if (ISRP1MODEL && (pinMask >> RP1_BANK0_PINS) != 0)
+    return -1 ;				// One bank of 28 lines on the RP1
+
+  spinPoll.pinMask  = pinMask ;
+  spinPoll.edgeMode = edgeMode ;
+  spinPoll.handler  = handler ;
+  spinPoll.core     = core ;
+  spinPoll.running  = TRUE ;
+
+  if (pthread_create (&spinPoll.thread, NULL, spinPollThread, NULL) != 0)
+  {
+    spinPoll.running = FALSE ;
+    return -1 ;
+  }
+
+  return 0 ;
+}
+
+
+/*
+ * wiringPiSpinPollStop:
+ *	Disarm and give the core back.
+ *********************************************************************************
+ */
+
+int wiringPiSpinPollStop (void)
+{
+  if (!spinPoll.running)
+    return -1 ;
+
+  spinPoll.running = FALSE ;
+  pthread_join (spinPoll.thread, NULL) ;
+
+  return 0 ;
+}
+
+
+/*
+ * waitForInterrupt2:
+ *	Wait for Interrupt on a GPIO pin and use v2 of the character device API, need Kernel 5.1
+ *  Returns struct WPIWfiStatus
+ *********************************************************************************
+ */
+
+struct WPIWfiStatus waitForInterrupt2(int pin, int edgeMode, int ms, unsigned long debounce_period_us)    // ms < 0 wait infinite, = 0 return immediately, > 0 wait timeout
+{
+  int ret;
+  int fd, attr, status, readret;
+  struct pollfd polls ;
+  struct gpio_v2_line_event evdata;
+  struct gpio_v2_line_config config;
+  struct gpio_v2_line_request req;
+  const char* strmode = "";
+  struct WPIWfiStatus wfiStatus;
+  
+  memset(&wfiStatus, 0, sizeof(wfiStatus));
+  /* open gpio */
+  if (wiringPiGpioDeviceGetFd()<0 || !ToBCMPin(&pin)) {
+    wfiStatus.statusOK = -1;
+    return wfiStatus;
+  }
+
+  if (isrFds[pin] > 0 && isrThreads[pin] == 0) {
+    /* a stopped ISR left its line request cached - release it or our own
+       request below would come back EBUSY */
+    close(isrFds[pin]);
+    isrFds[pin] = -1;
+    isrLineEdgeMode[pin] = 0;
+    isrLineDebounceUs[pin] = 0;
+    isrLineSoftDebounce[pin] = FALSE;
+  }
+  
+  memset(&req, 0, sizeof(req));
+  memset(&config, 0, sizeof(config));
+  
+  /* setup config */
+  config.flags = GPIO_V2_LINE_FLAG_INPUT;
+  
+  switch(edgeMode) {
+    default:
+    case INT_EDGE_SETUP:
+      if (wiringPiDebug) {
+        printf ("waitForInterrupt2: edgeMode INT_EDGE_SETUP - exiting\n") ;
+      }
+      wfiStatus.statusOK = -1;
+      return wfiStatus;
+    case INT_EDGE_FALLING:
+      config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+      strmode = "falling";
+      break;
+    case INT_EDGE_RISING:
+      config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+      strmode = "rising";
+      break;
+    case INT_EDGE_BOTH:
+      config.flags |= (GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_EDGE_RISING);
+      strmode = "both";
+      break;
+  }
+  strcpy(req.consumer, "wiringpi_gpio_irq");
+  
+  if (debounce_period_us) {
+	  attr = config.num_attrs;
+	  config.num_attrs++;
+    gpiotools_set_bit(&config.attrs[attr].mask, 0);
+	  config.attrs[attr].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+	  config.attrs[attr].attr.debounce_period_us = debounce_period_us;
+  }
+  
+  req.num_lines = 1;
+  req.offsets[0] = pin;
+  req.event_buffer_size = (isrEventBufferSize[pin] != 0) ? isrEventBufferSize[pin] : 32;
+  req.config = config;
+
+  status = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+  if (status == -1) {
+    ReportDeviceError("GPIO_V2_GET_LINE_IOCTL", pin , strmode, status);
+    wfiStatus.statusOK = -1;
+    return wfiStatus;
+  }
+
+  if (wiringPiDebug) {
+    printf ("waitForInterrupt2: GPIO get line %d , mode %s succeded, fd=%d\n", pin, strmode, req.fd) ;
+  }
+ 
+  fd = req.fd;
+  isrFds [pin] = fd;
+  isrDebouncePeriodUs[pin] = debounce_period_us; 
+  
+/* set event fd nonbloack read */ 
+  /*
+  int flags = fcntl(fd, F_GETFL);
+  flags |= O_NONBLOCK;
+  status = fcntl(fd, F_SETFL, flags);
+  if (status) {
+    fprintf(stderr, "wiringPi: ERROR: fcntl set nonblock return=%d\n", status);
+    return -1;
+  }
+*/
+
+  // Setup poll structure
+  polls.fd      = fd;
+  polls.events  = POLLIN | POLLPRI;
+  polls.revents = 0;
+
+  ret = poll(&polls, 1, ms);
+  if (ret < 0) {
+    if (wiringPiDebug) { 
+      fprintf(stderr, "waitForInterrupt2: ERROR: poll returned=%d\n", ret);
+    }
+    wfiStatus.statusOK = -1;
+  } else if (ret == 0) { 
+    if (wiringPiDebug) {
+      fprintf(stderr, "waitForInterrupt2: timeout: poll returned zero\n");
+    }
+    wfiStatus.statusOK = 0; // timeout
+  }
+  else {
+    if (wiringPiDebug) {
+      printf ("waitForInterrupt2: IRQ line %d received %d, fd=%d\n", pin, ret, isrFds[pin]);
+    }
+    if (polls.revents & POLLIN) {  
+      /* read event data */
+      readret = read(isrFds [pin], &evdata, sizeof(evdata));
+      if (readret == sizeof(evdata)) {
+        if (wiringPiDebug) {
+          printf ("waitForInterrupt2: IRQ at PIN: %d, timestamp: %lld\n", evdata.offset, evdata.timestamp_ns) ;
+        }
+        switch (evdata.id) {
+          case GPIO_V2_LINE_EVENT_RISING_EDGE:
+            wfiStatus.edge = INT_EDGE_RISING;
+            if (wiringPiDebug) printf("waitForInterrupV2: rising edge\n");
+          break;
+          case GPIO_V2_LINE_EVENT_FALLING_EDGE:
+            wfiStatus.edge = INT_EDGE_FALLING;
+            if (wiringPiDebug) printf("waitForInterrupt2: falling edge\n");
+			    break;
+		      default:
+            wfiStatus.edge = INT_EDGE_SETUP;        // edge = 0
+            if (wiringPiDebug) printf("waitForInterrupt2: unknown event\n");
+            break;
+		    }
+        wfiStatus.timeStamp_us = evdata.timestamp_ns / 1000LL;    // nanoseconds u64 to microseconds
+        wfiStatus.pinBCM = evdata.offset;
+        wfiStatus.statusOK = 1;
+      }
+      else {
+        wfiStatus.statusOK = -1;
+      }
+    }
+    else {
+        wfiStatus.statusOK = -1;
+    }
+  }
+
+  if (isrFds[pin] > 0) {
+    close(isrFds [pin]);        // release line
+    isrFds [pin] = -1;
+    isrDebouncePeriodUs[pin] = 0;
+  }
+
+  return wfiStatus;
+}
+
+int waitForInterrupt (int pin, int ms) {
+  struct WPIWfiStatus status;
+
+  int edgeMode = isrEdgeMode[pin];
+  if (edgeMode==0) {
+    fprintf(stderr, "waitForInterrupt: ERROR: edge mode missing, legacy function, please use waitForInterrupt2!\n");
+    return -1;
+  }
+  status = waitForInterrupt2(pin, edgeMode, ms, 0);
+
+  return  status.statusOK;
+}
+
+/*
+ * wiringPiISRStop:
+ * stop the interruptHandler thread - one eventfd write plus a join - and
+ * reset isrFunction[pin] and isrDebouncePeriodUs[pin]. The kernel line
+ * request is kept open so a restart with the same configuration skips the
+ * GET_LINE ioctl; call stop a second time to release the line itself.
+ *
+ *********************************************************************************
+ */
+
+int wiringPiISRStop(int pin) {
+
+  if (wiringPiMode == WPI_MODE_UNINITIALISED) {
+    return wiringPiFailure(WPI_FATAL, "wiringPiISRStop: wiringPi has not been initialised. Unable to continue.\n");
+  }
+  if (!ToBCMPin(&pin)) {
+    fprintf(stderr, "wiringPiISRStop: wrong pin %d (mode: %d) number!\n", pin, wiringPiMode);
+    return EINVAL;
+  }
+  if (wiringPiDebug) {
+    printf("wiringPiISRStop: pin %d\n", pin) ;
+  }
+
+  if (isrFds[pin] > 0) {
+    if (isrThreads[pin] != 0) {
+      uint64_t token = 1;
+
+      if (wiringPiDebug)
+        printf("wiringPiISRStop: stop thread 0x%lX\n", (unsigned long)isrThreads[pin]);
+
+      if (isrStopFds[pin] >= 0 && write(isrStopFds[pin], &token, sizeof(token)) == sizeof(token)) {
+        pthread_join(isrThreads[pin], NULL);    // microseconds: the reader wakes on the eventfd
+      }
+      else if (pthread_cancel(isrThreads[pin]) == 0) {    // no eventfd - the old slow path
+        pthread_join(isrThreads[pin], NULL);
+      }
+      isrThreads[pin] = 0;
+#ifdef WIRINGPI_IOURING
+      wiringPiUringRemoveLine(pin);   // retire the in-flight read before any close
+#endif
+      // The line request stays open: a re-register with the same edge mode
+      // and debounce adopts it without another GET_LINE ioctl. A second
+      // stop on an already-stopped pin releases the line for other users.
+    } else {
+      close(isrFds [pin]);
+      isrFds [pin] = -1;
+      isrLineEdgeMode [pin] = 0;
+      isrLineDebounceUs [pin] = 0;
+      isrLineSoftDebounce [pin] = FALSE;
+    }
+  } else {
+      if (wiringPiDebug)
+        printf("wiringPiISRStop: Warning stop isr, but its not active\n");
+  }
+  isrFunctions[pin] = NULL;
+  isrFunctionsV2[pin] = NULL;
+  isrUserdata[pin] = NULL;;
+  isrSchedSet[pin] = FALSE;
+  isrDebouncePeriodUs[pin] = 0;
+  isrSoftDebounceUs[pin] = 0;
+  isrLastEdgeNs[pin] = 0;
+  isrQueued[pin] = FALSE;   // keep the ring allocated - it's reused on re-register
+  
+  /* -not closing so far - other isr may be using it - only close if no other is using - will code later
+  if (chipFd>0) {
+    close(chipFd);
+  }
+  chipFd = -1;
+  */
+  if (wiringPiDebug) {
+    printf("wiringPiISRStop: wiringPiISRStop finished\n");
+  }
+  return 0;
+}
+
+// The V1-era name is a link-time alias, not a wrapper: legacy binaries
+//	land on the same address as wiringPiISRStop, no second call frame
+
+int waitForInterruptClose (int pin) __attribute__ ((alias ("wiringPiISRStop"))) ;
+
+/*
+ * isrStatsRecord:
+ *	Histogram the delta between the kernel's edge timestamp and this
+ *	moment - callback entry. Called by the dispatching thread only, so
+ *	plain increments are safe.
+ *********************************************************************************
+ */
+
+static void isrStatsRecord (int pin, unsigned long long eventNs)
+{
+  struct WPIIsrStats *s = &isrStats [pin] ;
+  struct timespec now ;
+  unsigned long long nowNs, delta ;
+  int bucket ;
+
+  clock_gettime (CLOCK_MONOTONIC, &now) ;
+  nowNs = (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec ;
+  delta = (nowNs > eventNs) ? (nowNs - eventNs) : 0 ;
+
+  ++s->count ;
+  s->totalNs += delta ;
+  if ((s->minNs == 0) || (delta < s->minNs))
+    s->minNs = delta ;
+  if (delta > s->maxNs)
+    s->maxNs = delta ;
+
+  for (bucket = 0 ; bucket < WPI_ISR_STATS_BUCKETS - 1 ; ++bucket)
+    if (delta < (1000ULL << bucket))
+      break ;
+  ++s->buckets [bucket] ;
+}
+
+
+/*
+ * wiringPiISRStatsEnable: wiringPiISRStats:
+ *	Opt a pin in to latency accounting and snapshot the result. The
+ *	snapshot is taken without stopping the dispatcher, so the counters
+ *	may be mid-update by one event - fine for percentile work.
+ *********************************************************************************
+ */
+
+int wiringPiISRStatsEnable (int pin, int enable)
+{
+  if (!ToBCMPin (&pin))
+    return -1 ;
+
+  if (enable)
+    memset (&isrStats [pin], 0, sizeof (struct WPIIsrStats)) ;
+  isrStatsEnabled [pin] = enable ? TRUE : FALSE ;
+
+  return 0 ;
+}
+
+int wiringPiISRStats (int pin, struct WPIIsrStats *stats)
+{
+  if (!ToBCMPin (&pin))
+    return -1 ;
+  if (!isrStatsEnabled [pin] || stats == NULL)
+    return -1 ;
+
+  *stats = isrStats [pin] ;
+  return 0 ;
+}
+
+
+/*
+ * Pulse metering:
+ *	Frequency / duty-cycle measurement without a user callback per edge:
+ *	the reader thread folds every kernel-timestamped edge straight into
+ *	per-pin period and high-time accumulators, and publishes a snapshot
+ *	each time the averaging window closes. Publication is a seqlock -
+ *	odd sequence means the writer is mid-update - so readers never block
+ *	the reader thread and never see a torn snapshot.
+ *********************************************************************************
+ */
+
+struct pulseMeterState
+{
+  int enabled ;
+  unsigned long long windowNs ;
+  unsigned long long lastRiseNs, lastFallNs, windowStartNs ;
+  unsigned long long periodSumNs, highSumNs, periods, pulsesTotal ;
+  unsigned long long minPeriodNs, maxPeriodNs, minHighNs, maxHighNs ;
+  volatile unsigned int seq ;
+  struct WPIPulseMeter snap ;
+} ;
+
+static struct pulseMeterState pulseMeters [64] ;
+
+static void pulseMeterNoop (UNU struct WPIWfiStatus wfiStatus, UNU void *userdata)
+{
+}
+
+static void pulseMeterRecord (int pin, unsigned int id, unsigned long long ns)
+{
+  struct pulseMeterState *m = &pulseMeters [pin] ;
+  unsigned long long period, high, elapsed ;
+
+  if (id == GPIO_V2_LINE_EVENT_RISING_EDGE)
+  {
+    if (m->lastRiseNs == 0)
+      m->windowStartNs = ns ;		// First edge opens the window
+    else if (m->lastFallNs > m->lastRiseNs)
+    {
+      period = ns - m->lastRiseNs ;
+      high   = m->lastFallNs - m->lastRiseNs ;
+
+      m->periodSumNs += period ;
+      m->highSumNs   += high ;
+      ++m->periods ;
+      ++m->pulsesTotal ;
+      if ((m->minPeriodNs == 0) || (period < m->minPeriodNs))
+	m->minPeriodNs = period ;
+      if (period > m->maxPeriodNs)
+	m->maxPeriodNs = period ;
+      if ((m->minHighNs == 0) || (high < m->minHighNs))
+	m->minHighNs = high ;
+      if (high > m->maxHighNs)
+	m->maxHighNs = high ;
+    }
+    m->lastRiseNs = ns ;
+  }
+  else if (id == GPIO_V2_LINE_EVENT_FALLING_EDGE)
+    m->lastFallNs = ns ;
+
+  if ((m->windowStartNs == 0) || ((ns - m->windowStartNs) < m->windowNs) || (m->periods == 0))
+    return ;
+
+// Window closed - publish and start the next one
+
+  elapsed = ns - m->windowStartNs ;
+
+  ++m->seq ;				// Odd: snapshot unstable
+  __atomic_thread_fence (__ATOMIC_RELEASE) ;
+  m->snap.pulses           = m->pulsesTotal ;
+  m->snap.frequencyMilliHz = (unsigned int)((m->periods * 1000000ULL) / (elapsed / 1000ULL)) ;
+  m->snap.dutyCyclePPM     = (unsigned int)((m->highSumNs * 1000000ULL) / m->periodSumNs) ;
+  m->snap.minPeriodNs      = m->minPeriodNs ;
+  m->snap.maxPeriodNs      = m->maxPeriodNs ;
+  m->snap.minHighNs        = m->minHighNs ;
+  m->snap.maxHighNs        = m->maxHighNs ;
+  m->snap.timestampNs      = ns ;
+  __atomic_store_n (&m->seq, m->seq + 1, __ATOMIC_RELEASE) ;	// Even: stable
+
+  m->periodSumNs = m->highSumNs = m->periods = 0 ;
+  m->minPeriodNs = m->maxPeriodNs = m->minHighNs = m->maxHighNs = 0 ;
+  m->windowStartNs = ns ;
+}
+
+
+/*
+ * wiringPiPulseMeter: wiringPiPulseMeterRead: wiringPiPulseMeterStop:
+ *	Arm, snapshot and tear down a meter. Arming claims the pin's edge
+ *	reader for both edges; the read returns zeros until the first window
+ *	has closed and -1 once the meter is stopped. A stalled input stops
+ *	publishing - compare timestampNs against your own clock to spot it.
+ *********************************************************************************
+ */
+
+int wiringPiPulseMeter (int pin, unsigned int windowMs)
+{
+  int bcmPin = pin ;
+  int ret ;
+
+  if (!ToBCMPin (&bcmPin))
+    return -1 ;
+
+  if (windowMs == 0)
+    windowMs = 1000 ;
+  else if (windowMs < 10)
+    windowMs = 10 ;
+  else if (windowMs > 60000)
+    windowMs = 60000 ;
+
+  memset (&pulseMeters [bcmPin], 0, sizeof (struct pulseMeterState)) ;
+  pulseMeters [bcmPin].windowNs = (unsigned long long)windowMs * 1000000ULL ;
+  pulseMeters [bcmPin].enabled  = TRUE ;
+
+  ret = wiringPiISR2 (pin, INT_EDGE_BOTH, pulseMeterNoop, 0, NULL) ;
+  if (ret != 0)
+    pulseMeters [bcmPin].enabled = FALSE ;
+
+  return ret ;
+}
+
+int wiringPiPulseMeterRead (int pin, struct WPIPulseMeter *meter)
+{
+  struct pulseMeterState *m ;
+  unsigned int v1, v2 ;
+
+  if (!ToBCMPin (&pin))
+    return -1 ;
+  m = &pulseMeters [pin] ;
+  if (!m->enabled || (meter == NULL))
+    return -1 ;
+
+  do
+  {
+    v1 = __atomic_load_n (&m->seq, __ATOMIC_ACQUIRE) ;
+    *meter = m->snap ;
+    __atomic_thread_fence (__ATOMIC_ACQUIRE) ;
+    v2 = __atomic_load_n (&m->seq, __ATOMIC_RELAXED) ;
+  }
+  while ((v1 & 1) || (v1 != v2)) ;
+
+  return 0 ;
+}
+
+int wiringPiPulseMeterStop (int pin)
+{
+  int bcmPin = pin ;
+
+  if (!ToBCMPin (&bcmPin))
+    return -1 ;
+  if (!pulseMeters [bcmPin].enabled)
+    return -1 ;
+
+  pulseMeters [bcmPin].enabled = FALSE ;
+  return wiringPiISRStop (pin) ;
+}
+
+
+/*
+ * ISR event queues:
+ *	Optionally decouple the reader threads from the user callbacks with a
+ *	lock-free single-producer/single-consumer ring per pin: the reader
+ *	only stamps the event into the ring (so it's back on the fd within a
+ *	few hundred nanoseconds) and one dispatch thread works the rings off
+ *	and runs the callbacks. If a callback can't keep up the oldest slot
+ *	is simply not overwritten - we count the drop and carry on.
+ *********************************************************************************
+ */
+
+#define	ISR_QUEUE_SIZE	256		// Must be a power of two
+
+struct isrEventQueue
+{
+  struct WPIWfiStatus events [ISR_QUEUE_SIZE] ;
+  volatile unsigned int head ;		// Written by the reader thread only
+  volatile unsigned int tail ;		// Written by the dispatch thread only
+  volatile unsigned int dropped ;
+} ;
+
+static void *isrQueueDispatcher (UNU void *dummy)
+{
+  struct isrEventQueue *q ;
+  int pin ;
+
+  for (;;)
+  {
+    sem_wait (&isrQueueSem) ;
+    for (pin = 0 ; pin < 64 ; ++pin)
+    {
+      q = isrQueues [pin] ;
+      if (q == NULL)
+	continue ;
+      while (q->tail != __atomic_load_n (&q->head, __ATOMIC_ACQUIRE))
+      {
+	struct WPIWfiStatus event = q->events [q->tail & (ISR_QUEUE_SIZE - 1)] ;
+	__atomic_store_n (&q->tail, q->tail + 1, __ATOMIC_RELEASE) ;
+	if (isrFunctionsV2 [pin])
+	{
+	  if (isrStatsEnabled [pin])
+	    isrStatsRecord (pin, (unsigned long long)event.timeStamp_us * 1000ULL) ;
+	  isrFunctionsV2 [pin] (event, isrUserdata [pin]) ;
+	}
+      }
+    }
+  }
+  return NULL ;
+}
+
+
+static void isrQueuePush (int pin, const struct WPIWfiStatus *event)
+{
+  struct isrEventQueue *q = isrQueues [pin] ;
+  unsigned int head = q->head ;
+
+  if ((head - __atomic_load_n (&q->tail, __ATOMIC_ACQUIRE)) >= ISR_QUEUE_SIZE)
+  {
+    ++q->dropped ;			// Ring full - consumer too slow
+    return ;
+  }
+  q->events [head & (ISR_QUEUE_SIZE - 1)] = *event ;
+  __atomic_store_n (&q->head, head + 1, __ATOMIC_RELEASE) ;
+  sem_post (&isrQueueSem) ;
+}
+
+
+/*
+ * isrDispatchEvents:
+ *	Deliver a batch of drained kernel events to the user functions
+ *	registered for this pin, in kernel order.
+ *********************************************************************************
+ */
+
+static void isrDispatchEvents (int pin, const struct gpio_v2_line_event *evdat, int numEvents)
+{
+  struct WPIWfiStatus wfiStatus ;
+  int i ;
+
+  for (i = 0 ; i < numEvents ; ++i)
+  {
+    if (isrLastSeqno [pin] != 0 && evdat [i].line_seqno > isrLastSeqno [pin] + 1)
+      isrLostEvents [pin] += evdat [i].line_seqno - isrLastSeqno [pin] - 1 ;	// kernel buffer overflowed
+    isrLastSeqno [pin] = evdat [i].line_seqno ;
+
+    if (isrSoftDebounceUs [pin] != 0)
+    {
+      if ((evdat [i].timestamp_ns - isrLastEdgeNs [pin]) < (unsigned long long)isrSoftDebounceUs [pin] * 1000ULL)
+	continue ;			// still bouncing - drop it
+      isrLastEdgeNs [pin] = evdat [i].timestamp_ns ;
+    }
+    if (pulseMeters [pin].enabled)
+      pulseMeterRecord (pin, evdat [i].id, evdat [i].timestamp_ns) ;
+    if (isrFunctionsV2 [pin])
+    {
+      if (wiringPiDebug)
+	printf ("isrDispatchEvents: GPIO EVENT at %llu on line %u (%u|%u)\n", evdat [i].timestamp_ns, evdat [i].offset, evdat [i].line_seqno, evdat [i].seqno) ;
+      wfiStatus.statusOK = 1 ;
+      wfiStatus.pinBCM   = pin ;
+      switch (evdat [i].id)
+      {
+	case GPIO_V2_LINE_EVENT_RISING_EDGE:  wfiStatus.edge = INT_EDGE_RISING ;  break ;
+	case GPIO_V2_LINE_EVENT_FALLING_EDGE: wfiStatus.edge = INT_EDGE_FALLING ; break ;
+	default:                              wfiStatus.edge = INT_EDGE_SETUP ;   break ;
+      }
+      wfiStatus.timeStamp_us = evdat [i].timestamp_ns / 1000LL ;
+      WPI_TRACE (WPI_TRACE_ISR, pin, wfiStatus.edge) ;
+      if (isrQueued [pin])
+	isrQueuePush (pin, &wfiStatus) ;
+      else
+      {
+	if (isrStatsEnabled [pin])
+	  isrStatsRecord (pin, evdat [i].timestamp_ns) ;
+	isrFunctionsV2 [pin] (wfiStatus, isrUserdata [pin]) ;
+      }
+    }
+    if (isrFunctions [pin])
+      isrFunctions [pin] () ;
+  }
+}
+
+
+/*
+ * isrApplySched:
+ *	Called by the reader thread on itself before its first poll. With no
+ *	configuration this is the historical piHiPri(55); a wiringPiISR2Sched
+ *	registration gets its CPU pinning and real-time class instead. A
+ *	refusal (usually missing CAP_SYS_NICE) is reported once, not fatal.
+ *********************************************************************************
+ */
+
+#ifndef	SCHED_DEADLINE
+#define	SCHED_DEADLINE	6
+#endif
+
+#ifdef SYS_sched_setattr
+struct wpiSchedAttr {		// linux/sched/types.h isn't exported everywhere
+  uint32_t size ;
+  uint32_t sched_policy ;
+  uint64_t sched_flags ;
+  int32_t  sched_nice ;
+  uint32_t sched_priority ;
+  uint64_t sched_runtime ;
+  uint64_t sched_deadline ;
+  uint64_t sched_period ;
+} ;
+#endif
+
+static void isrApplySched (int pin)
+{
+  const struct WPIIsrSched *s = &isrSched [pin] ;
+  struct sched_param param ;
+  cpu_set_t cpus ;
+  int policy, ret ;
+
+  if (!isrSchedSet [pin])
+  {
+    (void)piHiPri (55) ;	// Only effective if we run as root
+    return ;
+  }
+
+  if (s->cpu >= 0)
+  {
+    CPU_ZERO (&cpus) ;
+    CPU_SET (s->cpu, &cpus) ;
+    ret = pthread_setaffinity_np (pthread_self (), sizeof (cpus), &cpus) ;
+    if (ret != 0)
+      wiringPiError (WPI_ERROR_IO, "wiringPiISR2Sched: cannot pin reader for pin %d to CPU %d: %s", pin, s->cpu, strerror (ret)) ;
+  }
+
+  switch (s->policy)
+  {
+    case WPI_ISR_SCHED_FIFO:
+    case WPI_ISR_SCHED_RR:
+      policy = (s->policy == WPI_ISR_SCHED_FIFO) ? SCHED_FIFO : SCHED_RR ;
+      memset (&param, 0, sizeof (param)) ;
+      param.sched_priority = s->priority ;
+      if (param.sched_priority < sched_get_priority_min (policy))
+	param.sched_priority = sched_get_priority_min (policy) ;
+      if (param.sched_priority > sched_get_priority_max (policy))
+	param.sched_priority = sched_get_priority_max (policy) ;
+      ret = pthread_setschedparam (pthread_self (), policy, &param) ;
+      if (ret != 0)
+	wiringPiError (WPI_ERROR_IO, "wiringPiISR2Sched: real-time class for pin %d refused: %s", pin, strerror (ret)) ;
+      break ;
+
+    case WPI_ISR_SCHED_DEADLINE:
+#ifdef SYS_sched_setattr
+    {
+      struct wpiSchedAttr attr ;
+
+      memset (&attr, 0, sizeof (attr)) ;
+      attr.size           = sizeof (attr) ;
+      attr.sched_policy   = SCHED_DEADLINE ;
+      attr.sched_runtime  = s->runtimeNs ;
+      attr.sched_deadline = s->deadlineNs ;
+      attr.sched_period   = s->periodNs ;
+      if (syscall (SYS_sched_setattr, 0, &attr, 0) != 0)
+	wiringPiError (WPI_ERROR_IO, "wiringPiISR2Sched: SCHED_DEADLINE for pin %d refused: %s", pin, strerror (errno)) ;
+    }
+#else
+      wiringPiError (WPI_ERROR_UNSUPPORTED, "wiringPiISR2Sched: SCHED_DEADLINE not available on this system") ;
+#endif
+      break ;
+
+    default:			// WPI_ISR_SCHED_DEFAULT: affinity only
+      (void)piHiPri (55) ;
+      break ;
+  }
+}
+
+
+/*
+ * interruptHandlerV2:
+ *	This is a thread and gets started to wait for the interrupt we're
+ *	hoping to catch. It will call the user-function when the interrupt
+ *	fires.
+ *********************************************************************************
+ */
+
+void *interruptHandlerV2(void *arg)
+{
+  const char* strmode = ""; 
+  int pin, EdgeMode, ret, fd, attr, stopFd;
+  ssize_t readret;
+  unsigned int bufSize;
+  unsigned long debounce_period_us;
+  struct pollfd polls [2] ;  
+  struct gpio_v2_line_config config;
+  struct gpio_v2_line_request req;
+  struct gpio_v2_line_event evdat[64];
+  struct timespec tspec = {0, 5e5};  /* 0.5 ms timeout {0, 1e6} */
+  
+  pin = *(int *)arg;
+
+  if (wiringPiGpioDeviceGetFd()<0) {
+    return NULL;
+  }
+    
+  EdgeMode = isrEdgeMode[pin];
+  debounce_period_us = isrDebouncePeriodUs[pin];
+  bufSize = (isrEventBufferSize[pin] != 0) ? isrEventBufferSize[pin] : 45;
+ 
+  if (wiringPiDebug) {
+    printf ("interruptHandlerV2: GPIO line %d, edge mode %d, debounce_period_us %lu \n", pin, EdgeMode, debounce_period_us) ;
+  } 
+  
+  fd = -1;
+  if (isrFds[pin] > 0 && isrLineEdgeMode[pin] == EdgeMode && isrLineDebounceUs[pin] == debounce_period_us &&
+      isrLineBufferSize[pin] == bufSize) {
+    /* a previous wiringPiISRStop() left the line request open with this
+       exact configuration: adopt it and skip the GET_LINE ioctl, dropping
+       any events that queued up while nobody was listening */
+    fd = isrFds[pin];
+    while (read(fd, evdat, sizeof(evdat)) > 0)
+      ;
+    if (isrLineSoftDebounce[pin]) {
+      isrSoftDebounceUs[pin] = debounce_period_us;
+    }
+    if (wiringPiDebug) {
+      printf ("interruptHandlerV2: GPIO line %d reusing cached request, fd=%d\n", pin, fd) ;
+    }
+  }
+  else if (isrFds[pin] > 0) {   // cached, but with a different configuration - start over
+    close(isrFds[pin]);
+    isrFds[pin] = -1;
+  }
+
+  if (fd < 0) {
+    memset(&req, 0, sizeof(req));
+    memset(&config, 0, sizeof(config));
+  
+    /* setup config */
+    config.flags = GPIO_V2_LINE_FLAG_INPUT;
+    switch(EdgeMode) {
+      default:
+      case INT_EDGE_SETUP:
+        if (wiringPiDebug) {
+          printf ("interruptHandlerV2: waitForInterruptMode edge mode INT_EDGE_SETUP - exiting\n") ;
+        }
+        return NULL;
+      case INT_EDGE_FALLING:
+        config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        strmode = "falling";
+        break;
+      case INT_EDGE_RISING:
+        config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+        strmode = "rising";
+        break;
+      case INT_EDGE_BOTH:
+        config.flags |= (GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_EDGE_RISING);
+        strmode = "both";
+        break;
+    }
+    strcpy(req.consumer, "wiringpi_gpio_irq");
+  
+    if (debounce_period_us) {
+  		attr = config.num_attrs;
+  		config.num_attrs++;
+          gpiotools_set_bit(&config.attrs[attr].mask, 0);
+  		config.attrs[attr].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+  		config.attrs[attr].attr.debounce_period_us = debounce_period_us;
+    }
+  
+    req.num_lines = 1;
+    req.event_buffer_size = bufSize;
+    req.offsets[0] = pin;
+    req.config = config;
+
+    ret = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+    if (ret == -1 && debounce_period_us) {
+      // Older kernels reject the debounce attribute - retry without it and
+      // let isrDispatchEvents filter on the event timestamps instead
+      config.num_attrs = 0;
+      req.config = config;
+      req.fd = 0;
+      ret = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+      if (ret == 0) {
+        isrSoftDebounceUs[pin] = debounce_period_us;
+      }
+    }
+    if (ret == -1) {
+      ReportDeviceError("interruptHandlerV2: get line event", pin , strmode, ret);
+      return NULL;
+    }
+
+    if (wiringPiDebug) 
+      printf ("interruptHandlerV2: GPIO get line %d , mode %s succeded, fd=%d\n", pin, strmode, req.fd) ;
+
+    /* set event fd  */
+    fd = req.fd;
+    isrFds [pin] = fd;
+
+    /* non-blocking, so we can drain every buffered event after each wake-up */
+    ret = fcntl(fd, F_GETFL);
+    if (ret >= 0) {
+      fcntl(fd, F_SETFL, ret | O_NONBLOCK);
+    }
+
+    isrLineEdgeMode[pin] = EdgeMode;
+    isrLineDebounceUs[pin] = debounce_period_us;
+    isrLineBufferSize[pin] = bufSize;
+    isrLineSoftDebounce[pin] = (isrSoftDebounceUs[pin] != 0);
+  }
+
+#ifdef WIRINGPI_IOURING
+  /* hand the line fd to the shared ring thread - it does the reading
+     and dispatching from now on, so this per-pin thread can exit. Falls
+     through to the classic poll loop when io_uring isn't available */
+  if (wiringPiUringAddLine(pin, fd, &isrDispatchEvents) == 0) {
+    if (wiringPiDebug)
+      printf ("interruptHandlerV2: GPIO line %d handed to the io_uring dispatcher\n", pin) ;
+    return NULL;
+  }
+#endif
+
+  isrApplySched (pin) ;
+
+  stopFd = isrStopFds[pin];
+  if (stopFd >= 0) {            // drop any stale stop token from an earlier cycle
+    uint64_t token;
+    while (read(stopFd, &token, sizeof(token)) > 0)
+      ;
+  }
+
+  for (;;) {    // wait for event data, or for wiringPiISRStop to write the stop eventfd
+
+  // Setup poll structure
+    polls[0].fd      = fd;
+    polls[0].events  = POLLIN | POLLPRI;
+    polls[0].revents = 0;
+    polls[1].fd      = stopFd;
+    polls[1].events  = POLLIN;
+    polls[1].revents = 0;
+    
+    // with a stop eventfd we can sleep forever - no more ticking just to be
+    // a cancellation point; the 0.5 ms timeout remains as the fallback when
+    // the eventfd could not be created and stop still has to cancel us
+    ret = ppoll(polls, (stopFd >= 0) ? 2 : 1, (stopFd >= 0) ? NULL : &tspec, NULL);     // returns -1 on error, 0 on timeout, >0 number of elements
+  
+    if (ret < 0) {      // we do not reach this point if canceled, ppoll does not return, is Cancellation Point
+        if (wiringPiDebug)  
+            printf("interruptHandlerV2: ERROR: poll returned=%d\n", ret);
+        pthread_exit(NULL); 
+        return NULL;        // never landing here
+    } else if (ret == 0) { 
+//        if (wiringPiDebug)  
+//            printf("interruptHandlerV2: timeout: poll returned=%d\n", ret);
+        continue;
+    }
+    else {
+        if ((stopFd >= 0) && (polls[1].revents & POLLIN)) {
+            uint64_t token;
+            readret = read(stopFd, &token, sizeof(token));      // consume the token, then leave cleanly
+            if (wiringPiDebug)
+                printf ("interruptHandlerV2: stop requested for line %d, exiting\n", pin) ;
+            return NULL;
+        }
+        if (wiringPiDebug)
+            printf ("interruptHandlerV2: IRQ line %d received %d events, fd=%d\n", pin, ret, isrFds[pin]) ;
+        if (polls[0].revents & POLLIN) {
+            /* drain event data - more can arrive while we dispatch a batch,
+               so keep reading until the kernel buffer is empty */
+            while ((readret = read(fd, &evdat, sizeof(evdat))) >= (ssize_t)sizeof(evdat[0])) {
+                if (wiringPiDebug)
+                    printf ("interruptHandlerV2: IRQ at PIN: %d, events: %d\n", evdat[0].offset, (int)(readret/sizeof(evdat[0]))) ;
+                isrDispatchEvents(pin, evdat, readret/sizeof(evdat[0]));
+            }
+            if (readret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                if (wiringPiDebug)
+                    printf ("interruptHandlerV2: reading events from fd received signal, exit thread\n");
+                pthread_exit(NULL);
+                return NULL; // never landing here
+            }
+        }
+    }
+  }
+}
+
+
+/*
+ * wiringPiISR:
+ *	Pi Specific.
+ *	Take the details and create an interrupt handler that will do a call-
+ *	back to the user supplied function.
+ *  debounce_period_us in microseconds
+ *********************************************************************************
+ */
+
+int wiringPiISRInternal(int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), void (*functionClassic)(void), unsigned long debounce_period_us, void* userdata)
+{
+  if (wiringPiMode == WPI_MODE_UNINITIALISED) {
+    return wiringPiFailure(WPI_FATAL, "wiringPiISR: wiringPi has not been initialised. Unable to continue.\n");
+  }
+  if (!ToBCMPin(&pin)) {
     fprintf(stderr, "wiringPiISRStop: wrong pin %d (mode: %d) number!\n", pin, wiringPiMode);
     return EINVAL;
   }
   if (wiringPiDebug) {
     printf("wiringPi: wiringPiISR pin %d, edgeMode %d\n", pin, edgeMode);
   }
-  if (isrFunctions[pin] || isrFunctionsV2[pin]) {
-    fprintf(stderr, "wiringPi: ISR function already active, ignoring \n");
+  if (isrFunctions[pin] || isrFunctionsV2[pin]) {
+    fprintf(stderr, "wiringPi: ISR function already active, ignoring \n");
+  }
+
+  isrFunctionsV2[pin] = function;
+  isrUserdata[pin] = userdata;
+  isrFunctions[pin] = functionClassic;
+  isrEdgeMode[pin] = edgeMode;
+  isrDebouncePeriodUs[pin] = debounce_period_us;
+  isrLostEvents[pin] = 0;   // overflow accounting restarts with the registration
+  isrLastSeqno[pin] = 0;
+  
+  if (isrStopFds[pin] < 0) {
+    isrStopFds[pin] = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK) ;   // kept across stop/start cycles
+  }
+
+  if (wiringPiDebug) {
+    printf("wiringPi: mutex in\n");
+  }
+  pthread_mutex_lock (&pinMutex) ;
+    pinPass = pin ;
+    if (wiringPiDebug) {
+      printf("wiringPi: pthread_create before 0x%lX\n", (unsigned long)isrThreads[pin]);
+    }
+    if (pthread_create (&isrThreads[pin], NULL, interruptHandlerV2, &pin)==0) {
+      if (wiringPiDebug) {
+        printf("wiringPi: pthread_create successed, 0x%lX\n", (unsigned long)isrThreads[pin]);
+      }
+/*      while (pinPass != -1)
+        delay (1) ; */
+    // wait so that interruptHandler is up und running. 
+    // when interruptHandler is running, the calling function wiringPiISR
+    // must be still alive, otherwise the thread argument &pin points into nirwana,
+    // when it is picked up from interruptHandler.
+      delay (10);
+    } else {
+      if (wiringPiDebug) {
+        printf("wiringPi: pthread_create failed\n");
+      }
+    }
+
+    if (wiringPiDebug) {
+      printf("wiringPi: mutex out\n");
+    }
+  pthread_mutex_unlock (&pinMutex) ;
+
+  if (wiringPiDebug) {
+    printf("wiringPi: wiringPiISR finished\n");
+  }
+  return 0 ;
+}
+
+int wiringPiISR (int pin, int mode, void (*function)(void))
+{
+  return wiringPiISRInternal(pin, mode, NULL, function, 0, NULL);
+}
+
+int wiringPiISR2(int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata)
+{
+  return wiringPiISRInternal(pin, edgeMode, function, NULL, debounce_period_us, userdata);
+}
+
+/*
+ * wiringPiISR2Sched:
+ *	Like wiringPiISR2, but the reader thread gets the given scheduling
+ *	class and CPU affinity instead of the default piHiPri(55) - see the
+ *	WPIIsrSched notes in wiringPi.h. NULL behaves exactly like
+ *	wiringPiISR2.
+ *********************************************************************************
+ */
+
+int wiringPiISR2Sched(int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata, const struct WPIIsrSched *sched)
+{
+  int bcmPin = pin;
+
+  if (!ToBCMPin(&bcmPin)) {
+    fprintf(stderr, "wiringPiISR2Sched: wrong pin %d (mode: %d) number!\n", pin, wiringPiMode);
+    return EINVAL;
+  }
+
+  if (sched != NULL) {
+    isrSched[bcmPin] = *sched;
+    isrSchedSet[bcmPin] = TRUE;
+  } else {
+    isrSchedSet[bcmPin] = FALSE;
+  }
+
+  return wiringPiISRInternal(pin, edgeMode, function, NULL, debounce_period_us, userdata);
+}
+
+/*
+ * wiringPiISRBufferSize:
+ * wiringPiISRLostEvents:
+ *	Depth of the kernel's per-line event buffer, applied to the next
+ *	line request on the pin - so set it before registering. The kernel
+ *	caps it at 1024; 0 restores our built-in default. When a burst
+ *	overflows the buffer anyway the kernel drops the oldest events and
+ *	the per-line seqno jumps; wiringPiISRLostEvents() returns how many
+ *	went missing that way since the pin was registered.
+ *********************************************************************************
+ */
+
+int wiringPiISRBufferSize(int pin, int numEvents)
+{
+  if (!ToBCMPin(&pin)) {
+    return -1;
+  }
+  if (numEvents < 0 || numEvents > 1024) {
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiISRBufferSize: %d events (valid range 0-1024)", numEvents) ;
+    return -1;
+  }
+  isrEventBufferSize[pin] = numEvents;
+  return 0;
+}
+
+unsigned int wiringPiISRLostEvents(int pin)
+{
+  if (!ToBCMPin(&pin)) {
+    return 0;
+  }
+  return isrLostEvents[pin];
+}
+
+/*
+ * wiringPiISR2Queued:
+ *	Like wiringPiISR2, but the callback runs on a shared dispatch thread
+ *	fed from a lock-free ring, so a slow callback can't stall the reader
+ *	thread draining the kernel event buffer.
+ *********************************************************************************
+ */
+
+int wiringPiISR2Queued(int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata)
+{
+  int bcmPin = pin;
+
+  if (!ToBCMPin(&bcmPin)) {
+    fprintf(stderr, "wiringPiISR2Queued: wrong pin %d (mode: %d) number!\n", pin, wiringPiMode);
+    return EINVAL;
+  }
+
+  if (isrQueues[bcmPin] == NULL) {
+    isrQueues[bcmPin] = (struct isrEventQueue *)calloc(sizeof(struct isrEventQueue), 1);
+    if (isrQueues[bcmPin] == NULL) {
+      return wiringPiFailure(WPI_ALMOST, "wiringPiISR2Queued: Unable to allocate memory: %s\n", strerror(errno));
+    }
+  }
+
+  pthread_mutex_lock (&pinMutex) ;
+  if (!isrDispatchRunning) {
+    sem_init(&isrQueueSem, 0, 0);
+    if (pthread_create(&isrDispatchThread, NULL, isrQueueDispatcher, NULL) != 0) {
+      pthread_mutex_unlock (&pinMutex) ;
+      return -1;
+    }
+    isrDispatchRunning = TRUE;
+  }
+  pthread_mutex_unlock (&pinMutex) ;
+
+  isrQueued[bcmPin] = TRUE;
+  return wiringPiISRInternal(pin, edgeMode, function, NULL, debounce_period_us, userdata);
+}
+
+
+/*
+ * Quadrature encoders:
+ *	Two wiringPiISR2 callbacks sharing a position under piLock start
+ *	missing counts around 20kHz - the lock and the callback overhead
+ *	cost more than the decode. Here both channels go into one two-line
+ *	kernel request, so a single thread drains batched events in kernel
+ *	timestamp order and walks the x4 state machine with nothing to lock
+ *	against. Position and velocity publish through a seqlock, same
+ *	scheme as the pulse meters: readers retry instead of blocking the
+ *	decoder.
+ *********************************************************************************
+ */
+
+#define	MAX_ENCODERS	4
+
+struct encoderState
+{
+  int inUse ;
+  int fd ;				// The two-line event request
+  int stopFd ;				// eventfd poked by detach
+  pthread_t thread ;
+  int pinA, pinB ;			// BCM numbering
+  int state ;				// Current AB, A in bit 1
+  long long position ;
+  unsigned int glitches ;
+  long long velStartPos ;
+  unsigned long long velStartNs ;
+  int velocityCPS ;
+  volatile unsigned int seq ;
+  struct WPIEncoderStatus snap ;
+} ;
+
+static struct encoderState encoders [MAX_ENCODERS] ;
+
+// Step per transition, old AB in bits 3:2 and new in 1:0. Zeros on the
+//	diagonal are no-ops; zeros where both bits flipped are glitches -
+//	we lost an intermediate edge and the direction is unknowable.
+
+static const signed char encoderSteps [16] =
+  { 0, +1, -1, 0, -1, 0, 0, +1, +1, 0, 0, -1, 0, -1, +1, 0 } ;
+
+#define	ENCODER_VEL_WINDOW_NS	100000000ULL	// 100mS velocity window
+
+static void *encoderHandler (void *arg)
+{
+  struct encoderState *enc = (struct encoderState *)arg ;
+  struct gpio_v2_line_event evdat [64] ;
+  struct pollfd polls [2] ;
+  unsigned long long ns = 0 ;
+  ssize_t readret ;
+  int i, n, bit, newState, step ;
+
+  (void)piHiPri (55) ;	// Only effective if we run as root
+
+  polls [0].fd     = enc->fd ;
+  polls [0].events = POLLIN | POLLPRI ;
+  polls [1].fd     = enc->stopFd ;
+  polls [1].events = POLLIN ;
+
+  for (;;)
+  {
+    if (poll (polls, 2, -1) < 0)
+    {
+      if (errno == EINTR)
+	continue ;
+      break ;
+    }
+    if (polls [1].revents != 0)
+      break ;				// Detach woke us
+    if ((polls [0].revents & POLLIN) == 0)
+      continue ;
+
+    readret = read (enc->fd, evdat, sizeof (evdat)) ;
+    if (readret < (ssize_t)sizeof (evdat [0]))
+      continue ;
+    n = (int)(readret / sizeof (evdat [0])) ;
+
+    for (i = 0 ; i < n ; ++i)
+    {
+      bit = (evdat [i].offset == (unsigned int)enc->pinA) ? 2 : 1 ;
+      newState = (evdat [i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ?
+			(enc->state | bit) : (enc->state & ~bit) ;
+      step = encoderSteps [(enc->state << 2) | newState] ;
+      if (step != 0)
+	enc->position += step ;
+      else if (newState != enc->state)
+	++enc->glitches ;		// Both channels apparently moved at once
+      enc->state = newState ;
+      ns = evdat [i].timestamp_ns ;
+    }
+
+    if (enc->velStartNs == 0)
+    {
+      enc->velStartNs  = ns ;
+      enc->velStartPos = enc->position ;
+    }
+    else if ((ns - enc->velStartNs) >= ENCODER_VEL_WINDOW_NS)
+    {
+      enc->velocityCPS = (int)(((enc->position - enc->velStartPos) * 1000000000LL) /
+				(long long)(ns - enc->velStartNs)) ;
+      enc->velStartNs  = ns ;
+      enc->velStartPos = enc->position ;
+    }
+
+    ++enc->seq ;			// Odd: snapshot unstable
+    __atomic_thread_fence (__ATOMIC_RELEASE) ;
+    enc->snap.position    = enc->position ;
+    enc->snap.velocityCPS = enc->velocityCPS ;
+    enc->snap.glitches    = enc->glitches ;
+    enc->snap.timestampNs = ns ;
+    __atomic_store_n (&enc->seq, enc->seq + 1, __ATOMIC_RELEASE) ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * wiringPiEncoderAttach: wiringPiEncoderRead: wiringPiEncoderDetach:
+ *	Claim both channels, start the decoder and hand back a handle; read
+ *	a coherent snapshot; stop the thread and release the lines. Position
+ *	is x4 counts from wherever the shaft was at attach.
+ *********************************************************************************
+ */
+
+int wiringPiEncoderAttach (int pinA, int pinB)
+{
+  struct gpio_v2_line_config config ;
+  struct gpio_v2_line_request req ;
+  struct gpio_v2_line_values values ;
+  struct encoderState *enc ;
+  int encoder ;
+
+  if (!ToBCMPin (&pinA) || !ToBCMPin (&pinB) || (pinA == pinB))
+  {
+    wiringPiError (WPI_ERROR_BAD_PIN, "wiringPiEncoderAttach: bad pin pair %d/%d", pinA, pinB) ;
+    return -1 ;
+  }
+  if (wiringPiGpioDeviceGetFd () < 0)
+    return -1 ;
+
+  for (encoder = 0 ; encoder < MAX_ENCODERS ; ++encoder)
+    if (!encoders [encoder].inUse)
+      break ;
+  if (encoder >= MAX_ENCODERS)
+  {
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiEncoderAttach: all %d encoders in use", MAX_ENCODERS) ;
+    return -1 ;
+  }
+  enc = &encoders [encoder] ;
+  memset (enc, 0, sizeof (struct encoderState)) ;
+
+  memset (&req, 0, sizeof (req)) ;
+  memset (&config, 0, sizeof (config)) ;
+  config.flags = GPIO_V2_LINE_FLAG_INPUT |
+		GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING ;
+  strcpy (req.consumer, "wiringpi_encoder") ;
+  req.num_lines         = 2 ;
+  req.offsets [0]       = pinA ;
+  req.offsets [1]       = pinB ;
+  req.event_buffer_size = 512 ;		// Survive 100kHz bursts between wakeups
+  req.config            = config ;
+
+  if (ioctl (chipFd, GPIO_V2_GET_LINE_IOCTL, &req) == -1 || req.fd < 0)
+  {
+    ReportDeviceError ("get line event", pinA, "wiringPiEncoderAttach", -1) ;
+    return -1 ;
+  }
+
+  memset (&values, 0, sizeof (values)) ;
+  values.mask = 3 ;
+  if (ioctl (req.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0)
+    enc->state = ((values.bits & 1) ? 2 : 0) | ((values.bits & 2) ? 1 : 0) ;
+
+  enc->fd     = req.fd ;
+  enc->pinA   = pinA ;
+  enc->pinB   = pinB ;
+  enc->stopFd = eventfd (0, 0) ;
+  if (enc->stopFd < 0 || pthread_create (&enc->thread, NULL, encoderHandler, enc) != 0)
+  {
+    if (enc->stopFd >= 0)
+      close (enc->stopFd) ;
+    close (enc->fd) ;
+    return -1 ;
+  }
+  enc->inUse = TRUE ;
+
+  return encoder ;
+}
+
+int wiringPiEncoderRead (int encoder, struct WPIEncoderStatus *status)
+{
+  struct encoderState *enc ;
+  unsigned int v1, v2 ;
+
+  if (encoder < 0 || encoder >= MAX_ENCODERS || !encoders [encoder].inUse || (status == NULL))
+    return -1 ;
+  enc = &encoders [encoder] ;
+
+  do
+  {
+    v1 = __atomic_load_n (&enc->seq, __ATOMIC_ACQUIRE) ;
+    *status = enc->snap ;
+    __atomic_thread_fence (__ATOMIC_ACQUIRE) ;
+    v2 = __atomic_load_n (&enc->seq, __ATOMIC_RELAXED) ;
+  }
+  while ((v1 & 1) || (v1 != v2)) ;
+
+  return 0 ;
+}
+
+int wiringPiEncoderDetach (int encoder)
+{
+  struct encoderState *enc ;
+  uint64_t one = 1 ;
+
+  if (encoder < 0 || encoder >= MAX_ENCODERS || !encoders [encoder].inUse)
+    return -1 ;
+  enc = &encoders [encoder] ;
+
+  if (write (enc->stopFd, &one, sizeof (one)) < 0) { }
+  pthread_join (enc->thread, NULL) ;
+  close (enc->stopFd) ;
+  close (enc->fd) ;
+  enc->inUse = FALSE ;
+
+  return 0 ;
+}
+
+
+/*
+ * Event loop:
+ *	One thread and one epoll set serving any number of pins, as an
+ *	alternative to the thread-per-pin wiringPiISR model. Each pin gets
+ *	its own kernel line request (with edge detection and optional
+ *	debounce) and the fd goes into the shared epoll set; an eventfd is
+ *	used to wake the thread up for a clean shutdown.
+ *********************************************************************************
+ */
+
+static int        eventLoopEpollFd = -1 ;
+static int        eventLoopCtlFd   = -1 ;
+static pthread_t  eventLoopThread ;
+static int        eventLoopRunning = FALSE ;
+static int        eventLoopPins    = 0 ;
+
+static int eventLoopFds [64] =
+{
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+} ;
+
+static void (*eventLoopFunctions [64])(struct WPIWfiStatus, void* userdata) ;
+static void  *eventLoopUserdata  [64] ;
+
+// Plain fd watchers in the same epoll set - serial ports, sockets,
+//	timerfds. Tagged in the epoll data as EVENT_LOOP_FD_TAG + slot so
+//	the handler can tell them from pins; the callback owns draining
+//	the fd (the set is level triggered, an undrained fd spins).
+
+#define	EVENT_LOOP_FD_TAG	0x100
+#define	EVENT_LOOP_FD_SLOTS	16
+
+static int eventLoopWatchFds [EVENT_LOOP_FD_SLOTS] =
+	{ [0 ... EVENT_LOOP_FD_SLOTS - 1] = -1 } ;
+static void (*eventLoopWatchFunctions [EVENT_LOOP_FD_SLOTS])(int fd, void *userdata) ;
+static void  *eventLoopWatchUserdata  [EVENT_LOOP_FD_SLOTS] ;
+
+
+/*
+ * requestLineEventV2:
+ *	Request a single line with edge detection (and optional debounce)
+ *	from the character device, returning the event fd or -1.
+ *********************************************************************************
+ */
+
+static int requestLineEventV2 (int pin, int edgeMode, unsigned long debounce_period_us)
+{
+  struct gpio_v2_line_config config ;
+  struct gpio_v2_line_request req ;
+  int attr, ret ;
+
+  if (wiringPiGpioDeviceGetFd () < 0)
+    return -1 ;
+
+  memset (&req, 0, sizeof (req)) ;
+  memset (&config, 0, sizeof (config)) ;
+
+  config.flags = GPIO_V2_LINE_FLAG_INPUT ;
+  switch (edgeMode)
+  {
+    default:
+    case INT_EDGE_SETUP:
+      return -1 ;
+    case INT_EDGE_FALLING:
+      config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING ;
+      break ;
+    case INT_EDGE_RISING:
+      config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING ;
+      break ;
+    case INT_EDGE_BOTH:
+      config.flags |= (GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_EDGE_RISING) ;
+      break ;
+  }
+  strcpy (req.consumer, "wiringpi_gpio_irq") ;
+
+  if (debounce_period_us)
+  {
+    attr = config.num_attrs ;
+    config.num_attrs++ ;
+    gpiotools_set_bit (&config.attrs [attr].mask, 0) ;
+    config.attrs [attr].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE ;
+    config.attrs [attr].attr.debounce_period_us = debounce_period_us ;
   }
 
-  isrFunctionsV2[pin] = function;
-  isrUserdata[pin] = userdata;
-  isrFunctions[pin] = functionClassic;
-  isrEdgeMode[pin] = edgeMode;
-  isrDebouncePeriodUs[pin] = debounce_period_us;
-  
-  if (wiringPiDebug) {
-    printf("wiringPi: mutex in\n");
+  req.num_lines = 1 ;
+  req.event_buffer_size = (isrEventBufferSize [pin] != 0) ? isrEventBufferSize [pin] : 45 ;
+  req.offsets [0] = pin ;
+  req.config = config ;
+
+  ret = ioctl (chipFd, GPIO_V2_GET_LINE_IOCTL, &req) ;
+  if (ret == -1 && debounce_period_us)
+  {
+    // Older kernels reject the debounce attribute - retry without it and
+    // filter on the event timestamps ourselves instead
+    config.num_attrs = 0 ;
+    req.config = config ;
+    req.fd = 0 ;
+    ret = ioctl (chipFd, GPIO_V2_GET_LINE_IOCTL, &req) ;
+    if (ret == 0)
+      isrSoftDebounceUs [pin] = debounce_period_us ;
   }
-  pthread_mutex_lock (&pinMutex) ;
-    pinPass = pin ;
-    if (wiringPiDebug) {
-      printf("wiringPi: pthread_create before 0x%lX\n", (unsigned long)isrThreads[pin]);
+  if (ret == -1 || req.fd < 0)
+  {
+    ReportDeviceError ("get line event", pin, "requestLineEventV2", ret) ;
+    return -1 ;
+  }
+  return req.fd ;
+}
+
+
+static void *eventLoopHandler (UNU void *dummy)
+{
+  struct epoll_event events [16] ;
+  struct gpio_v2_line_event evdat [32] ;
+  struct WPIWfiStatus wfiStatus ;
+  int n, i, e, pin ;
+  ssize_t readret ;
+
+  (void)piHiPri (55) ;	// Only effective if we run as root
+
+  for (;;)
+  {
+    n = epoll_wait (eventLoopEpollFd, events, 16, -1) ;
+    if (n < 0)
+    {
+      if (errno == EINTR)
+	continue ;
+      return NULL ;
     }
-    if (pthread_create (&isrThreads[pin], NULL, interruptHandlerV2, &pin)==0) {
-      if (wiringPiDebug) {
-        printf("wiringPi: pthread_create successed, 0x%lX\n", (unsigned long)isrThreads[pin]);
+
+    for (e = 0 ; e < n ; ++e)
+    {
+      if ((int)events [e].data.u32 == -1)	// Control eventfd - time to go
+      {
+	uint64_t dummy64 ;
+	if (read (eventLoopCtlFd, &dummy64, sizeof (dummy64)) < 0) { }
+	return NULL ;
       }
-/*      while (pinPass != -1)
-        delay (1) ; */
-    // wait so that interruptHandler is up und running. 
-    // when interruptHandler is running, the calling function wiringPiISR
-    // must be still alive, otherwise the thread argument &pin points into nirwana,
-    // when it is picked up from interruptHandler.
-      delay (10);
-    } else {
-      if (wiringPiDebug) {
-        printf("wiringPi: pthread_create failed\n");
+
+      if (events [e].data.u32 >= EVENT_LOOP_FD_TAG &&
+	  events [e].data.u32 <  EVENT_LOOP_FD_TAG + EVENT_LOOP_FD_SLOTS)
+      {
+	int slot = (int)events [e].data.u32 - EVENT_LOOP_FD_TAG ;
+	if (eventLoopWatchFds [slot] >= 0 && eventLoopWatchFunctions [slot] != NULL)
+	  eventLoopWatchFunctions [slot] (eventLoopWatchFds [slot], eventLoopWatchUserdata [slot]) ;
+	continue ;
+      }
+
+      pin = (int)events [e].data.u32 ;
+      if (eventLoopFds [pin] < 0)
+	continue ;
+
+      readret = read (eventLoopFds [pin], &evdat, sizeof (evdat)) ;
+      if (readret < (ssize_t)sizeof (evdat [0]))
+	continue ;
+
+      for (i = 0 ; i < (int)(readret / sizeof (evdat [0])) ; ++i)
+      {
+	if (eventLoopFunctions [pin] == NULL)
+	  continue ;
+	if (isrSoftDebounceUs [pin] != 0)
+	{
+	  if ((evdat [i].timestamp_ns - isrLastEdgeNs [pin]) < (unsigned long long)isrSoftDebounceUs [pin] * 1000ULL)
+	    continue ;			// still bouncing - drop it
+	  isrLastEdgeNs [pin] = evdat [i].timestamp_ns ;
+	}
+	memset (&wfiStatus, 0, sizeof (wfiStatus)) ;
+	wfiStatus.statusOK = 1 ;
+	wfiStatus.pinBCM   = pin ;
+	switch (evdat [i].id)
+	{
+	  case GPIO_V2_LINE_EVENT_RISING_EDGE:  wfiStatus.edge = INT_EDGE_RISING ;  break ;
+	  case GPIO_V2_LINE_EVENT_FALLING_EDGE: wfiStatus.edge = INT_EDGE_FALLING ; break ;
+	  default:                              wfiStatus.edge = INT_EDGE_SETUP ;   break ;
+	}
+	wfiStatus.timeStamp_us = evdat [i].timestamp_ns / 1000LL ;
+	eventLoopFunctions [pin] (wfiStatus, eventLoopUserdata [pin]) ;
       }
     }
+  }
+}
 
-    if (wiringPiDebug) {
-      printf("wiringPi: mutex out\n");
+
+/*
+ * Edge capture:
+ *	Direct, batched access to the kernel's edge events with the full
+ *	nanosecond timestamps - the ISR/event-loop paths round these down to
+ *	microseconds in WPIWfiStatus, which is too coarse for pulse timing
+ *	work. Open a pin once, then each read drains up to a batch of events
+ *	stamped by the kernel (CLOCK_MONOTONIC) at the moment the edge fired,
+ *	unaffected by how late we got scheduled.
+ *********************************************************************************
+ */
+
+static int captureFds [64] =
+{
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+} ;
+
+int wiringPiEdgeCaptureOpen (int pin, int edgeMode, unsigned long debounce_period_us)
+{
+  int fd ;
+
+  if (wiringPiMode == WPI_MODE_UNINITIALISED)
+    return wiringPiFailure (WPI_FATAL, "wiringPiEdgeCaptureOpen: wiringPi has not been initialised. Unable to continue.\n") ;
+  if (!ToBCMPin (&pin))
+    return -1 ;
+  if (captureFds [pin] >= 0)
+    return -1 ;				// Already capturing on this pin
+
+  fd = requestLineEventV2 (pin, edgeMode, debounce_period_us) ;
+  if (fd < 0)
+    return -1 ;
+  captureFds [pin] = fd ;
+  return 0 ;
+}
+
+int wiringPiEdgeCaptureRead (int pin, struct WPIEdgeEvent *events, int maxEvents, int timeout_ms)
+{
+  struct gpio_v2_line_event evdat [64] ;
+  struct pollfd polls ;
+  ssize_t readret ;
+  int i, n, batch, total = 0 ;
+
+  if (!ToBCMPin (&pin) || events == NULL || maxEvents <= 0)
+    return -1 ;
+  if (captureFds [pin] < 0)
+    return -1 ;
+
+  polls.fd      = captureFds [pin] ;
+  polls.events  = POLLIN | POLLPRI ;
+  polls.revents = 0 ;
+
+  n = poll (&polls, 1, timeout_ms) ;
+  if (n < 0)
+    return -1 ;
+  if (n == 0)
+    return 0 ;				// timeout, nothing captured
+
+  while (total < maxEvents)
+  {
+    batch = maxEvents - total ;
+    if (batch > (int)(sizeof (evdat) / sizeof (evdat [0])))
+      batch = sizeof (evdat) / sizeof (evdat [0]) ;
+
+    readret = read (captureFds [pin], &evdat, batch * sizeof (evdat [0])) ;
+    if (readret < (ssize_t)sizeof (evdat [0]))
+      break ;				// drained (the fd is blocking but poll said ready once)
+
+    for (i = 0 ; i < (int)(readret / sizeof (evdat [0])) ; ++i, ++total)
+    {
+      events [total].pinBCM       = pin ;
+      events [total].timeStamp_ns = evdat [i].timestamp_ns ;
+      events [total].seqno        = evdat [i].line_seqno ;
+      switch (evdat [i].id)
+      {
+	case GPIO_V2_LINE_EVENT_RISING_EDGE:  events [total].edge = INT_EDGE_RISING ;  break ;
+	case GPIO_V2_LINE_EVENT_FALLING_EDGE: events [total].edge = INT_EDGE_FALLING ; break ;
+	default:                              events [total].edge = INT_EDGE_SETUP ;   break ;
+      }
+    }
+
+    polls.revents = 0 ;			// anything more already buffered?
+    if (poll (&polls, 1, 0) <= 0)
+      break ;
+  }
+  return total ;
+}
+
+int wiringPiEdgeCaptureClose (int pin)
+{
+  if (!ToBCMPin (&pin))
+    return -1 ;
+  if (captureFds [pin] < 0)
+    return -1 ;
+  close (captureFds [pin]) ;
+  captureFds [pin] = -1 ;
+  return 0 ;
+}
+
+
+/*
+ * eventLoopEnsureSet: eventLoopEnsureThread:
+ *	Lazy creation of the shared epoll set (with its shutdown eventfd)
+ *	and the loop thread. Callers hold pinMutex.
+ *********************************************************************************
+ */
+
+static int eventLoopEnsureSet (void)
+{
+  struct epoll_event ev ;
+
+  if (eventLoopEpollFd >= 0)
+    return 0 ;
+
+  eventLoopEpollFd = epoll_create1 (EPOLL_CLOEXEC) ;
+  eventLoopCtlFd   = eventfd (0, EFD_CLOEXEC) ;
+  if (eventLoopEpollFd < 0 || eventLoopCtlFd < 0)
+    return -1 ;
+
+  ev.events   = EPOLLIN ;
+  ev.data.u32 = (uint32_t)-1 ;
+  epoll_ctl (eventLoopEpollFd, EPOLL_CTL_ADD, eventLoopCtlFd, &ev) ;
+  return 0 ;
+}
+
+static int eventLoopEnsureThread (void)
+{
+  if (eventLoopRunning)
+    return 0 ;
+  if (pthread_create (&eventLoopThread, NULL, eventLoopHandler, NULL) != 0)
+    return -1 ;
+  eventLoopRunning = TRUE ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiEventLoopAdd:
+ *	Register a pin with the shared event loop. The loop thread is
+ *	created on the first registration.
+ *********************************************************************************
+ */
+
+int wiringPiEventLoopAdd (int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata)
+{
+  struct epoll_event ev ;
+  int fd ;
+
+  if (wiringPiMode == WPI_MODE_UNINITIALISED)
+    return wiringPiFailure (WPI_FATAL, "wiringPiEventLoopAdd: wiringPi has not been initialised. Unable to continue.\n") ;
+  if (!ToBCMPin (&pin) || function == NULL)
+    return EINVAL ;
+  if (eventLoopFds [pin] >= 0)
+  {
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiEventLoopAdd: pin %d already registered, ignoring", pin) ;
+    return EBUSY ;
+  }
+
+  pthread_mutex_lock (&pinMutex) ;
+
+  if (eventLoopEnsureSet () != 0)
+  {
+    pthread_mutex_unlock (&pinMutex) ;
+    return -1 ;
+  }
+
+  fd = requestLineEventV2 (pin, edgeMode, debounce_period_us) ;
+  if (fd < 0)
+  {
+    pthread_mutex_unlock (&pinMutex) ;
+    return -1 ;
+  }
+
+  eventLoopFunctions [pin] = function ;
+  eventLoopUserdata  [pin] = userdata ;
+  eventLoopFds       [pin] = fd ;
+
+  ev.events   = EPOLLIN ;
+  ev.data.u32 = (uint32_t)pin ;
+  if (epoll_ctl (eventLoopEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    close (fd) ;
+    eventLoopFds [pin] = -1 ;
+    eventLoopFunctions [pin] = NULL ;
+    pthread_mutex_unlock (&pinMutex) ;
+    return -1 ;
+  }
+  ++eventLoopPins ;
+
+  if (eventLoopEnsureThread () != 0)
+  {
+    pthread_mutex_unlock (&pinMutex) ;
+    return -1 ;
+  }
+
+  pthread_mutex_unlock (&pinMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiEventLoopAddFd:
+ *	Watch a plain file descriptor - a serial port, socket or timerfd -
+ *	with the same loop the pins use. The callback runs on the loop
+ *	thread whenever the fd is readable and must drain it. Needs no
+ *	GPIO, so no wiringPiSetup is required first.
+ *********************************************************************************
+ */
+
+int wiringPiEventLoopAddFd (int fd, void (*function)(int fd, void *userdata), void *userdata)
+{
+  struct epoll_event ev ;
+  int slot ;
+
+  if (fd < 0 || function == NULL)
+    return EINVAL ;
+
+  pthread_mutex_lock (&pinMutex) ;
+
+  for (slot = 0 ; slot < EVENT_LOOP_FD_SLOTS ; ++slot)
+    if (eventLoopWatchFds [slot] == fd)
+    {
+      pthread_mutex_unlock (&pinMutex) ;
+      return EBUSY ;
     }
+
+  for (slot = 0 ; slot < EVENT_LOOP_FD_SLOTS ; ++slot)
+    if (eventLoopWatchFds [slot] == -1)
+      break ;
+  if (slot == EVENT_LOOP_FD_SLOTS || eventLoopEnsureSet () != 0)
+  {
+    pthread_mutex_unlock (&pinMutex) ;
+    return -1 ;
+  }
+
+  eventLoopWatchFunctions [slot] = function ;
+  eventLoopWatchUserdata  [slot] = userdata ;
+  eventLoopWatchFds       [slot] = fd ;
+
+  ev.events   = EPOLLIN ;
+  ev.data.u32 = (uint32_t)(EVENT_LOOP_FD_TAG + slot) ;
+  if (epoll_ctl (eventLoopEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    eventLoopWatchFds       [slot] = -1 ;
+    eventLoopWatchFunctions [slot] = NULL ;
+    pthread_mutex_unlock (&pinMutex) ;
+    return -1 ;
+  }
+  ++eventLoopPins ;
+
+  if (eventLoopEnsureThread () != 0)
+  {
+    pthread_mutex_unlock (&pinMutex) ;
+    return -1 ;
+  }
+
+  pthread_mutex_unlock (&pinMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiEventLoopRemoveFd:
+ *	Stop watching a descriptor. The fd itself stays open - it was
+ *	never ours to close. The loop thread goes down with the last
+ *	registration, pin or fd.
+ *********************************************************************************
+ */
+
+int wiringPiEventLoopRemoveFd (int fd)
+{
+  int slot ;
+
+  pthread_mutex_lock (&pinMutex) ;
+
+  for (slot = 0 ; slot < EVENT_LOOP_FD_SLOTS ; ++slot)
+    if (eventLoopWatchFds [slot] == fd)
+      break ;
+  if (slot == EVENT_LOOP_FD_SLOTS)
+  {
+    pthread_mutex_unlock (&pinMutex) ;
+    return EINVAL ;
+  }
+
+  epoll_ctl (eventLoopEpollFd, EPOLL_CTL_DEL, fd, NULL) ;
+  eventLoopWatchFds       [slot] = -1 ;
+  eventLoopWatchFunctions [slot] = NULL ;
+  eventLoopWatchUserdata  [slot] = NULL ;
+  --eventLoopPins ;
+
+  if (eventLoopPins == 0 && eventLoopRunning)
+  {
+    uint64_t one = 1 ;
+    if (write (eventLoopCtlFd, &one, sizeof (one)) < 0) { }
+    pthread_join (eventLoopThread, NULL) ;
+    eventLoopRunning = FALSE ;
+  }
+
   pthread_mutex_unlock (&pinMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiEventLoopRemove:
+ *	Take a pin out of the event loop again. When the last pin goes, the
+ *	loop thread is woken via the eventfd and joined.
+ *********************************************************************************
+ */
+
+int wiringPiEventLoopRemove (int pin)
+{
+  if (!ToBCMPin (&pin))
+    return EINVAL ;
+  if (eventLoopFds [pin] < 0)
+    return EINVAL ;
+
+  pthread_mutex_lock (&pinMutex) ;
 
-  if (wiringPiDebug) {
-    printf("wiringPi: wiringPiISR finished\n");
+  epoll_ctl (eventLoopEpollFd, EPOLL_CTL_DEL, eventLoopFds [pin], NULL) ;
+  close (eventLoopFds [pin]) ;
+  eventLoopFds       [pin] = -1 ;
+  eventLoopFunctions [pin] = NULL ;
+  eventLoopUserdata  [pin] = NULL ;
+  --eventLoopPins ;
+
+  if (eventLoopPins == 0 && eventLoopRunning)
+  {
+    uint64_t one = 1 ;
+    if (write (eventLoopCtlFd, &one, sizeof (one)) < 0) { }
+    pthread_join (eventLoopThread, NULL) ;
+    eventLoopRunning = FALSE ;
   }
+
+  pthread_mutex_unlock (&pinMutex) ;
   return 0 ;
 }
 
-int wiringPiISR (int pin, int mode, void (*function)(void))
-{
-  return wiringPiISRInternal(pin, mode, NULL, function, 0, NULL);
-}
+/*
+ * armTimerRead:
+ *	Fast timestamp source: the ARM generic timer virtual counter
+ *	(CNTVCT_EL0) can be read from user space in a few cycles, against
+ *	the ~100nS a clock_gettime() call costs, and the softPwm style
+ *	loops take millions of timestamps a second. The counter frequency
+ *	(CNTFRQ_EL0) is fixed (19.2MHz on Pi 3, 54MHz on Pi 4/5) so the
+ *	conversion to microseconds is one multiply and divide. On 32-bit
+ *	builds armTimerFreq stays 0 and the clock_gettime path is used.
+ *********************************************************************************
+ */
 
-int wiringPiISR2(int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata)
+#ifdef __aarch64__
+static uint64_t armTimerFreq  = 0 ;	// 0: not available, use clock_gettime
+static uint64_t armTimerEpoch = 0 ;	// counter value at initialiseEpoch()
+
+static inline uint64_t armTimerRead (void)
 {
-  return wiringPiISRInternal(pin, edgeMode, function, NULL, debounce_period_us, userdata);
+  uint64_t count ;
+
+  asm volatile ("mrs %0, cntvct_el0" : "=r" (count)) ;
+  return count ;
 }
+#endif
+
 
 /*
  * initialiseEpoch:
@@ -3127,6 +7856,10 @@ int wiringPiISR2(int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfi
 
 static void initialiseEpoch (void)
 {
+#ifdef __aarch64__
+  asm volatile ("mrs %0, cntfrq_el0" : "=r" (armTimerFreq)) ;
+  armTimerEpoch = armTimerRead () ;
+#endif
 #ifdef	OLD_WAY
   struct timeval tv ;
 
@@ -3191,22 +7924,172 @@ void delayMicrosecondsHard (unsigned int us)
     gettimeofday (&tNow, NULL) ;
 }
 
+
+/*
+ * delayMicrosecondsCalibrate:
+ *	Measure (once) how late a short nanosleep typically wakes up on
+ *	this board and kernel - anything from 60 to 120uS under load.
+ *	delayMicroseconds() then sleeps short of its target by that slack
+ *	and spins out the remainder, rather than overshooting by it.
+ *********************************************************************************
+ */
+
+static unsigned int delaySleepSlackUs = 0 ;
+static int delaySlackCalibrated = FALSE ;
+
+static void delayMicrosecondsCalibrate (void)
+{
+  struct timespec req, t0, t1 ;
+  unsigned int worst = 0 ;
+
+  for (int try = 0 ; try < 5 ; ++try)
+  {
+    req.tv_sec  = 0 ;
+    req.tv_nsec = 100000L ;		// 100uS
+    clock_gettime (CLOCK_MONOTONIC, &t0) ;
+    clock_nanosleep (CLOCK_MONOTONIC, 0, &req, NULL) ;
+    clock_gettime (CLOCK_MONOTONIC, &t1) ;
+
+    long long tookNs = (t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec) ;
+    if (tookNs > 100000LL)
+    {
+      unsigned int overUs = (unsigned int)((tookNs - 100000LL) / 1000) ;
+      if (overUs > worst)
+	worst = overUs ;
+    }
+  }
+
+  if (worst <   10) worst =   10 ;	// keep a minimum spin tail
+  if (worst > 1000) worst = 1000 ;	// don't spin forever on a bad sample
+  delaySleepSlackUs    = worst ;
+  delaySlackCalibrated = TRUE ;
+}
+
 void delayMicroseconds (unsigned int us)
 {
-  struct timespec sleeper ;
-  unsigned int uSecs = us % 1000000 ;
-  unsigned int wSecs = us / 1000000 ;
+  struct timespec deadline, sleepTo, now ;
 
-  if      (us ==   0)
+  if (us == 0)
     return ;
-  else if (us  < 100)
+  else if (us < 100)
+  {
     delayMicrosecondsHard (us) ;
+    return ;
+  }
+
+  if (!delaySlackCalibrated)
+    delayMicrosecondsCalibrate () ;
+
+// Work from an absolute deadline so the sleep and the spin tail can't
+//	add up to more than the requested delay.
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline) ;
+  deadline.tv_sec  += us / 1000000 ;
+  deadline.tv_nsec += (long)(us % 1000000) * 1000L ;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_nsec -= 1000000000L ;
+    ++deadline.tv_sec ;
+  }
+
+  if (us > delaySleepSlackUs)
+  {
+    sleepTo = deadline ;
+    sleepTo.tv_nsec -= (long)delaySleepSlackUs * 1000L ;
+    if (sleepTo.tv_nsec < 0)
+    {
+      sleepTo.tv_nsec += 1000000000L ;
+      --sleepTo.tv_sec ;
+    }
+    clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &sleepTo, NULL) ;
+  }
+
+  do
+    clock_gettime (CLOCK_MONOTONIC, &now) ;
+  while ((now.tv_sec < deadline.tv_sec) ||
+	 ((now.tv_sec == deadline.tv_sec) && (now.tv_nsec < deadline.tv_nsec))) ;
+}
+
+
+/*
+ * delayNanoseconds:
+ *	Sub-microsecond busy delay for bit-bang setup/hold times - the
+ *	100-500nS the DS1302 and shift-register chains actually need,
+ *	where delayMicroseconds(1) wastes most of a microsecond per edge.
+ *	Spins on the ARM generic timer counter where we have it (18-52nS
+ *	granularity); elsewhere on clock_gettime. The first call measures
+ *	the fixed cost of one timestamp read against clock_gettime and
+ *	that overhead is subtracted from every target, so
+ *	delayNanoseconds(200) is ~200nS, not 200nS plus the call. Below
+ *	the measured overhead the call itself is the delay.
+ *********************************************************************************
+ */
+
+static uint64_t delayNsOverhead   = 0 ;		// nS cost of one timestamp read
+static int      delayNsCalibrated = FALSE ;
+
+static void delayNanosecondsCalibrate (void)
+{
+  struct timespec t0, t1 ;
+  uint64_t elapsed ;
+  int i ;
+
+  clock_gettime (CLOCK_MONOTONIC, &t0) ;
+#ifdef __aarch64__
+  if (armTimerFreq != 0)
+    for (i = 0 ; i < 1000 ; ++i)
+      (void)armTimerRead () ;
   else
+#endif
+    for (i = 0 ; i < 1000 ; ++i)
+      clock_gettime (CLOCK_MONOTONIC, &t1) ;
+  clock_gettime (CLOCK_MONOTONIC, &t1) ;
+
+  elapsed = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ULL + (uint64_t)(t1.tv_nsec - t0.tv_nsec) ;
+  delayNsOverhead = elapsed / 1000 ;
+  if (delayNsOverhead > 500)		// bad sample (preempted) - don't eat whole delays
+    delayNsOverhead = 500 ;
+  delayNsCalibrated = TRUE ;
+}
+
+void delayNanoseconds (unsigned int ns)
+{
+  struct timespec now ;
+  uint64_t startNs, deadlineNs ;
+
+  if (ns == 0)
+    return ;
+  if (ns >= 1000000)			// no business spinning that long
+  {
+    delayMicroseconds (ns / 1000) ;
+    return ;
+  }
+
+  if (!delayNsCalibrated)
+    delayNanosecondsCalibrate () ;
+
+  if (ns <= delayNsOverhead)		// the call itself already took this long
+    return ;
+  ns -= (unsigned int)delayNsOverhead ;
+
+#ifdef __aarch64__
+  if (armTimerFreq != 0)
   {
-    sleeper.tv_sec  = wSecs ;
-    sleeper.tv_nsec = (long)(uSecs * 1000L) ;
-    nanosleep (&sleeper, NULL) ;
+    uint64_t start = armTimerRead () ;
+    uint64_t ticks = (uint64_t)(((unsigned __int128)ns * armTimerFreq + 999999999ULL) / 1000000000ULL) ;
+
+    while ((armTimerRead () - start) < ticks)
+      ;
+    return ;
   }
+#endif
+
+  clock_gettime (CLOCK_MONOTONIC, &now) ;
+  startNs    = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec ;
+  deadlineNs = startNs + ns ;
+  do
+    clock_gettime (CLOCK_MONOTONIC, &now) ;
+  while (((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec) < deadlineNs) ;
 }
 
 
@@ -3221,6 +8104,11 @@ unsigned int millis (void)
 {
   uint64_t now ;
 
+#ifdef __aarch64__
+  if (armTimerFreq != 0)
+    return (uint32_t)(((unsigned __int128)(armTimerRead () - armTimerEpoch) * 1000) / armTimerFreq) ;
+#endif
+
 #ifdef	OLD_WAY
   struct timeval tv ;
 
@@ -3248,6 +8136,12 @@ unsigned int millis (void)
 unsigned int micros (void)
 {
   uint64_t now ;
+
+#ifdef __aarch64__
+  if (armTimerFreq != 0)
+    return (uint32_t)(((unsigned __int128)(armTimerRead () - armTimerEpoch) * 1000000) / armTimerFreq) ;
+#endif
+
 #ifdef	OLD_WAY
   struct timeval tv ;
 
@@ -3268,6 +8162,11 @@ unsigned int micros (void)
 unsigned long long piMicros64(void) {
   struct  timespec ts;
 
+#ifdef __aarch64__
+  if (armTimerFreq != 0)
+    return (uint64_t)(((unsigned __int128)(armTimerRead () - armTimerEpoch) * 1000000) / armTimerFreq) ;
+#endif
+
   clock_gettime (CLOCK_MONOTONIC_RAW, &ts) ;
   uint64_t now  = (uint64_t)ts.tv_sec * (uint64_t)1000000 + (uint64_t)(ts.tv_nsec / 1000) ;
   return (now - epochMicro) ;
@@ -3415,7 +8314,7 @@ int wiringPiGlobalMemoryAccess(void)
  *********************************************************************************
  */
 
-int wiringPiSetup (void)
+static int wiringPiSetupOnce (void)
 {
   int   fd ;
   int   model, rev, mem, maker, overVolted ;
@@ -3424,6 +8323,7 @@ int wiringPiSetup (void)
     return 0 ;
 
   wiringPiSetuped = TRUE ;
+  initPinDescriptors () ;
 
   if (getenv (ENV_DEBUG) != NULL)
     wiringPiDebug = TRUE ;
@@ -3449,16 +8349,7 @@ int wiringPiSetup (void)
   else
     wiringPiMode = WPI_MODE_PINS ;
 
-  if (piGpioLayout () == GPIO_LAYOUT_PI1_REV1)	// A, B, Rev 1, 1.1
-  {
-    pinToGpio =  pinToGpioR1 ;
-    physToGpio = physToGpioR1 ;
-  }
-  else 					// A2, B2, A+, B+, CM, Pi2, Pi3, Zero, Zero W, Zero 2 W
-  {
-    pinToGpio =  pinToGpioR2 ;
-    physToGpio = physToGpioR2 ;
-  }
+  wiringPiSelectLayout (piGpioLayout ()) ;	// A, B, Rev 1, 1.1 vs everything newer
 
 // Open the master /dev/ memory control device
 // Device strategy: December 2016:
@@ -3486,10 +8377,23 @@ int wiringPiSetup (void)
   }
 
   usingGpioMem = FALSE;
-  if (gpiomemGlobal==NULL || (fd = open (gpiomemGlobal, O_RDWR | O_SYNC | O_CLOEXEC)) < 0)
+  fd = -1 ;
+
+// A minimal profile takes /dev/gpiomem by choice even where /dev/mem
+//	would open - on a Pi 5 that's a 192KB mapping instead of the full
+//	4MB RP1 block, at the cost of the root-only peripherals.
+
+  if (wiringPiSetupGpioMemPreferred && gpiomemModule != NULL &&
+	(fd = open (gpiomemModule, O_RDWR | O_SYNC | O_CLOEXEC)) >= 0)
+  {
+    piGpioBase   = 0 ;
+    usingGpioMem = TRUE ;
+  }
+  else if (gpiomemGlobal==NULL || (fd = open (gpiomemGlobal, O_RDWR | O_SYNC | O_CLOEXEC)) < 0)
   {
     if (wiringPiDebug) {
-      printf ("wiringPi: no access to %s try %s\n", gpiomemGlobal, gpiomemModule) ;
+      printf ("wiringPi: no access to %s try %s\n",
+		gpiomemGlobal ? gpiomemGlobal : "(none)", gpiomemModule ? gpiomemModule : "(none)") ;
     }
     if (gpiomemModule && (fd = open (gpiomemModule, O_RDWR | O_SYNC | O_CLOEXEC) ) >= 0)	// We're using gpiomem
     {
@@ -3516,7 +8420,11 @@ int wiringPiSetup (void)
     GPIO_PWM	  = piGpioBase + 0x0020C000 ;
     GPIO_RIO    = 0x00 ;
 
-// Map the individual hardware components
+// Map the individual hardware components.
+//	Only the GPIO and timer blocks are mapped here - PWM, clocks and pads
+//	are mapped on first use through bcmEnsureMapped() above, so programs
+//	that never touch them don't pay for the mmaps at setup time.  The
+//	timer stays eager as nothing in the API would trigger its lazy map.
 
   //	GPIO:
     base = NULL;
@@ -3524,44 +8432,37 @@ int wiringPiSetup (void)
     if (gpio == MAP_FAILED)
       return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (GPIO) failed: %s\n", strerror (errno)) ;
 
-  //	PWM
-
-    pwm = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_PWM) ;
-    if (pwm == MAP_FAILED)
-      return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (PWM) failed: %s\n", strerror (errno)) ;
-
-  //	Clock control (needed for PWM)
+  //	The system timer - skipped by minimal profiles that never read it
 
-    clk = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_CLOCK_ADR) ;
-    if (clk == MAP_FAILED)
-      return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (CLOCK) failed: %s\n", strerror (errno)) ;
-
-  //	The drive pads
-
-    pads = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_PADS) ;
-    if (pads == MAP_FAILED)
-      return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (PADS) failed: %s\n", strerror (errno)) ;
-
-  //	The system timer
-
-    timer = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_TIMER) ;
-    if (timer == MAP_FAILED)
-      return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (TIMER) failed: %s\n", strerror (errno)) ;
+    if (wiringPiSetupSubsystems & WPI_SETUP_TIMER)
+    {
+      timer = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_TIMER) ;
+      if (timer == MAP_FAILED)
+	return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (TIMER) failed: %s\n", strerror (errno)) ;
 
   // Set the timer to free-running, 1MHz.
   //	0xF9 is 249, the timer divide is base clock / (divide+1)
   //	so base clock is 250MHz / 250 = 1MHz.
 
-    *(timer + TIMER_CONTROL) = 0x0000280 ;
-    *(timer + TIMER_PRE_DIV) = 0x00000F9 ;
-    timerIrqRaw = timer + TIMER_IRQ_RAW ;
+      *(timer + TIMER_CONTROL) = 0x0000280 ;
+      *(timer + TIMER_PRE_DIV) = 0x00000F9 ;
+      timerIrqRaw = timer + TIMER_IRQ_RAW ;
+    }
+    else
+      timer = NULL ;
 
-    // Export the base addresses for any external software that might need them
+    wiringPiMmapFd = fd ;
+    pwm  = NULL ;
+    clk  = NULL ;
+    pads = NULL ;
+
+    // Export the base addresses for any external software that might need them.
+    //	The lazily mapped blocks export through their bcm*() accessors.
     _wiringPiBase  = base ;
     _wiringPiGpio  = gpio ;
-    _wiringPiPwm   = pwm ;
-    _wiringPiClk   = clk ;
-    _wiringPiPads  = pads ;
+    _wiringPiPwm   = NULL ;
+    _wiringPiClk   = NULL ;
+    _wiringPiPads  = NULL ;
     _wiringPiTimer = timer ;
     _wiringPiRio   = NULL ;
   } else {
@@ -3602,20 +8503,111 @@ int wiringPiSetup (void)
     _wiringPiRio   = rio ;
   }
   if (wiringPiDebug) {
+    const char *unmapped = piRP1Model() ? "invalid" : "deferred";  // BCM maps these on first use
     printf ("wiringPi: memory map gpio   0x%x %s\n", GPIO_BASE     , _wiringPiGpio ? "valid" : "invalid");
-    printf ("wiringPi: memory map pads   0x%x %s\n", GPIO_PADS     , _wiringPiPads ? "valid" : "invalid");
+    printf ("wiringPi: memory map pads   0x%x %s\n", GPIO_PADS     , _wiringPiPads ? "valid" : unmapped);
     printf ("wiringPi: memory map rio    0x%x %s\n", GPIO_RIO      , _wiringPiRio  ? "valid" : "invalid");
-    printf ("wiringPi: memory map pwm0   0x%x %s\n", GPIO_PWM      , _wiringPiPwm  ? "valid" : "invalid");
-    printf ("wiringPi: memory map clocks 0x%x %s\n", GPIO_CLOCK_ADR, _wiringPiClk  ? "valid" : "invalid");
+    printf ("wiringPi: memory map pwm0   0x%x %s\n", GPIO_PWM      , _wiringPiPwm  ? "valid" : unmapped);
+    printf ("wiringPi: memory map clocks 0x%x %s\n", GPIO_CLOCK_ADR, _wiringPiClk  ? "valid" : unmapped);
     printf ("wiringPi: memory map timer  0x%x %s\n", GPIO_TIMER    ,_wiringPiTimer ? "valid" : "invalid");
   }
 
   initialiseEpoch () ;
 
+  wiringPiSpecialiseDispatch () ;
+
   return 0 ;
 }
 
 
+/*
+ * wpiRealtimeWarmup:
+ *	Prefault and lock everything a timing-critical path may touch.
+ *	The peripheral mmaps and the library's hot data are demand
+ *	faulted, so the first digitalWrite after setup - or the first one
+ *	after memory pressure evicts a page - can eat a page fault of
+ *	tens of microseconds right inside an RT window. Called once after
+ *	setup (and before going real-time), this forces the lazily mapped
+ *	blocks in, touches a word in every mapped page, mlocks them along
+ *	with the dispatch descriptors, and faults in the hot entry points'
+ *	text. Returns 0, or -1 when some mlock was refused (the prefault
+ *	still happened; raise RLIMIT_MEMLOCK for the locks to stick).
+ *	Interface V3.17
+ *********************************************************************************
+ */
+
+int wpiRealtimeWarmup (void)
+{
+  struct { const volatile void *addr ; size_t len ; } blocks [8] ;
+  const volatile unsigned char *p ;
+  size_t off ;
+  int n = 0, i, ok = TRUE ;
+
+  setupCheck ("wpiRealtimeWarmup") ;
+
+  if (piRP1Model ())
+  {
+    if (base != NULL)
+      { blocks [n].addr = base ; blocks [n].len = usingGpioMem ? gpiomem_RP1_Size : pciemem_RP1_Size ; ++n ; }
+  }
+  else
+  {
+    if (!usingGpioMem && (wiringPiMmapFd >= 0))	// Force the lazily mapped blocks in now
+    {
+      (void)bcmPwm  () ;
+      (void)bcmClk  () ;
+      (void)bcmPads () ;
+    }
+    if (gpio  != NULL) { blocks [n].addr = gpio  ; blocks [n].len = BLOCK_SIZE ; ++n ; }
+    if (pwm   != NULL) { blocks [n].addr = pwm   ; blocks [n].len = BLOCK_SIZE ; ++n ; }
+    if (clk   != NULL) { blocks [n].addr = clk   ; blocks [n].len = BLOCK_SIZE ; ++n ; }
+    if (pads  != NULL) { blocks [n].addr = pads  ; blocks [n].len = BLOCK_SIZE ; ++n ; }
+    if (timer != NULL) { blocks [n].addr = timer ; blocks [n].len = BLOCK_SIZE ; ++n ; }
+  }
+
+// The hot library data - the per-pin dispatch descriptors
+
+  blocks [n].addr = pinDesc ;
+  blocks [n].len  = sizeof (pinDesc) ;
+  ++n ;
+
+  for (i = 0 ; i < n ; ++i)
+  {
+    p = (const volatile unsigned char *)blocks [i].addr ;
+    if (mlock ((const void *)p, blocks [i].len) != 0)
+      ok = FALSE ;			// Keep going - the prefault alone still helps
+    for (off = 0 ; off < blocks [i].len ; off += 4096)
+      (void)p [off] ;			// A volatile read faults the page in
+  }
+
+// And the hot entry points themselves, so the first call doesn't fault
+//	in their text either
+
+  (void)*(const volatile unsigned char *)(uintptr_t)&digitalWrite ;
+  (void)*(const volatile unsigned char *)(uintptr_t)&digitalRead ;
+  (void)*(const volatile unsigned char *)(uintptr_t)&digitalWriteMulti ;
+  (void)*(const volatile unsigned char *)(uintptr_t)&delayMicroseconds ;
+
+  return ok ? 0 : -1 ;
+}
+
+int wiringPiSetup (void)
+{
+  int ret ;
+
+  if (__atomic_load_n (&wiringPiSetupDone, __ATOMIC_ACQUIRE))	// Fast path - a setup has completed
+    return 0 ;
+
+  pthread_mutex_lock (&wiringPiSetupMutex) ;
+  ret = wiringPiSetupOnce () ;
+  if (ret == 0)
+    __atomic_store_n (&wiringPiSetupDone, TRUE, __ATOMIC_RELEASE) ;
+  pthread_mutex_unlock (&wiringPiSetupMutex) ;
+
+  return ret ;
+}
+
+
 /*
  * wiringPiSetupGpio:
  *	Must be called once at the start of your program execution.
@@ -3627,12 +8619,16 @@ int wiringPiSetup (void)
 
 int wiringPiSetupGpio (void)
 {
-  (void)wiringPiSetup () ;
+  pthread_mutex_lock (&wiringPiSetupMutex) ;
+  (void)wiringPiSetupOnce () ;
 
   if (wiringPiDebug)
     printf ("wiringPi: wiringPiSetupGpio called\n") ;
 
   wiringPiMode = WPI_MODE_GPIO ;
+  wiringPiSpecialiseDispatch () ;
+  __atomic_store_n (&wiringPiSetupDone, TRUE, __ATOMIC_RELEASE) ;
+  pthread_mutex_unlock (&wiringPiSetupMutex) ;
 
   return 0 ;
 }
@@ -3649,12 +8645,16 @@ int wiringPiSetupGpio (void)
 
 int wiringPiSetupPhys (void)
 {
-  (void)wiringPiSetup () ;
+  pthread_mutex_lock (&wiringPiSetupMutex) ;
+  (void)wiringPiSetupOnce () ;
 
   if (wiringPiDebug)
     printf ("wiringPi: wiringPiSetupPhys called\n") ;
 
   wiringPiMode = WPI_MODE_PHYS ;
+  wiringPiSpecialiseDispatch () ;
+  __atomic_store_n (&wiringPiSetupDone, TRUE, __ATOMIC_RELEASE) ;
+  pthread_mutex_unlock (&wiringPiSetupMutex) ;
 
   return 0 ;
 }
@@ -3666,12 +8666,238 @@ int wiringPiSetupPinType (enum WPIPinType pinType) {
     case WPI_PIN_BCM:  return wiringPiSetupGpio();
     case WPI_PIN_WPI:  return wiringPiSetup();
     case WPI_PIN_PHYS: return wiringPiSetupPhys();
+    case WPI_PIN_SIM:  return wiringPiSetupSim();
     default:           return -1;
   }
 }
 
 
-int wiringPiSetupGpioDevice (enum WPIPinType pinType) {
+/*
+ * wiringPiSetupEx:
+ *	Setup with a profile. A one-shot sensor reader doesn't need the
+ *	system timer mapped or the full /dev/mem peripheral window, and a
+ *	latency-sensitive daemon would rather pay for the PWM/clock maps
+ *	and the gpiochip open here than on the first call that needs them.
+ *	The plain wiringPiSetup*() entry points are unchanged - they keep
+ *	the historical profile (timer mapped, everything else lazy).
+ *********************************************************************************
+ */
+
+int wiringPiSetupEx (const struct WPISetupOpts *opts)
+{
+  int ret ;
+
+  if (opts == NULL)
+    return wiringPiSetup () ;
+
+  if (opts->pinType == WPI_PIN_SIM)
+    return wiringPiSetupSim () ;
+
+  pthread_mutex_lock (&wiringPiSetupMutex) ;
+
+  wiringPiSetupSubsystems       = opts->subsystems ;
+  wiringPiSetupGpioMemPreferred = opts->preferGpioMem ;
+
+  ret = wiringPiSetupOnce () ;
+  if (ret == 0)
+  {
+    switch (opts->pinType)
+    {
+      case WPI_PIN_BCM:  wiringPiMode = WPI_MODE_GPIO ; break ;
+      case WPI_PIN_PHYS: wiringPiMode = WPI_MODE_PHYS ; break ;
+      case WPI_PIN_WPI:  wiringPiMode = WPI_MODE_PINS ; break ;
+      default:           break ;	// keep what wiringPiSetupOnce chose
+    }
+    wiringPiSpecialiseDispatch () ;
+
+    if ((opts->subsystems & WPI_SETUP_PWM) && !piRP1Model () && !usingGpioMem)
+    {
+      (void)bcmPwm () ;			// map now, not on first pwmWrite
+      (void)bcmClk () ;
+    }
+
+    __atomic_store_n (&wiringPiSetupDone, TRUE, __ATOMIC_RELEASE) ;
+  }
+  pthread_mutex_unlock (&wiringPiSetupMutex) ;
+
+  if (ret == 0 && (opts->subsystems & WPI_SETUP_ISR))
+    (void)wiringPiGpioDeviceGetFd () ;	// open the gpiochip before the first ISR needs it
+
+  return ret ;
+}
+
+
+/*
+ * wiringPiSetupSim:
+ *	Simulation setup: no hardware is touched at all. Pin state lives
+ *	in a shared page mapped from WIRINGPI_SIM_FILE (default
+ *	/dev/shm/wiringpi-sim) so a harness process mapping the same file
+ *	can watch the levels the program drives and set the levels it
+ *	reads back - millions of pin operations per second, off-target.
+ *	Pins are BCM numbered. On-board only; extension nodes work as usual.
+ *********************************************************************************
+ */
+
+static int wiringPiSetupSimOnce (void)
+{
+  int fd ;
+  const char *fileName ;
+
+  if (wiringPiSetuped)
+    return (wiringPiMode == WPI_MODE_SIM) ? 0 : -1 ;
+
+  if (getenv (ENV_DEBUG) != NULL)
+    wiringPiDebug = TRUE ;
+
+  if (getenv (ENV_CODES) != NULL)
+    wiringPiReturnCodes = TRUE ;
+
+  if (wiringPiDebug)
+    printf ("wiringPi: wiringPiSetupSim called\n") ;
+
+  if ((fileName = getenv (ENV_SIM_FILE)) == NULL)
+    fileName = WPI_SIM_DEFAULT_FILE ;
+
+  if ((fd = open (fileName, O_CREAT | O_RDWR, 0666)) < 0)
+    return wiringPiFailure (WPI_ALMOST, "wiringPiSetupSim: Unable to open %s: %s\n", fileName, strerror (errno)) ;
+
+  if (ftruncate (fd, sizeof (struct WPISimState)) < 0)
+  {
+    close (fd) ;
+    return wiringPiFailure (WPI_ALMOST, "wiringPiSetupSim: Unable to size %s: %s\n", fileName, strerror (errno)) ;
+  }
+
+  simState = (struct WPISimState *)mmap (NULL, sizeof (struct WPISimState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+  close (fd) ;		// The mapping keeps the page alive
+
+  if (simState == MAP_FAILED)
+  {
+    simState = NULL ;
+    return wiringPiFailure (WPI_ALMOST, "wiringPiSetupSim: mmap (%s) failed: %s\n", fileName, strerror (errno)) ;
+  }
+
+  simState->magic = WPI_SIM_MAGIC ;
+
+  initialiseEpoch () ;
+
+  wiringPiSetuped = TRUE ;
+  wiringPiMode    = WPI_MODE_SIM ;
+  wiringPiSpecialiseDispatch () ;	// back to the generic path
+
+  return 0 ;
+}
+
+int wiringPiSetupSim (void)
+{
+  int ret ;
+
+  pthread_mutex_lock (&wiringPiSetupMutex) ;
+  ret = wiringPiSetupSimOnce () ;
+  if (ret == 0)
+    __atomic_store_n (&wiringPiSetupDone, TRUE, __ATOMIC_RELEASE) ;
+  pthread_mutex_unlock (&wiringPiSetupMutex) ;
+
+  return ret ;
+}
+
+
+/*
+ * wiringPiSimState:
+ *	Hand an in-process harness the simulation page - NULL when not in
+ *	sim mode.
+ *********************************************************************************
+ */
+
+struct WPISimState *wiringPiSimState (void)
+{
+  return simState ;
+}
+
+
+/*
+ * wiringPiBusStatsOpen: wiringPiBusStatsSlot:
+ *	Home for the per-bus transaction counters. When WIRINGPI_STATS_FILE
+ *	is set the slots live in a page mmap'd from it (created by the
+ *	instrumented process, opened read-only by `gpio stats`); otherwise
+ *	they sit in a plain static table and only in-process queries see
+ *	them. Slot lookup is a linear scan - next to an ioctl it's noise.
+ *********************************************************************************
+ */
+
+static struct WPIBusStatsPage *busStatsPage = NULL ;
+static struct WPIBusStatsPage  busStatsLocal ;
+static int busStatsInited = FALSE ;
+static pthread_mutex_t busStatsLock = PTHREAD_MUTEX_INITIALIZER ;
+
+struct WPIBusStatsPage *wiringPiBusStatsOpen (int create)
+{
+  const char *fileName ;
+  int fd ;
+  void *map ;
+
+  if ((fileName = getenv (WPI_BUS_STATS_ENV)) == NULL)
+    return NULL ;
+
+  if ((fd = open (fileName, create ? (O_CREAT | O_RDWR) : O_RDWR, 0666)) < 0)
+    return NULL ;
+
+  if (create && (ftruncate (fd, sizeof (struct WPIBusStatsPage)) < 0))
+  {
+    close (fd) ;
+    return NULL ;
+  }
+
+  map = mmap (NULL, sizeof (struct WPIBusStatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+  close (fd) ;
+  if (map == MAP_FAILED)
+    return NULL ;
+
+  if (create)
+    ((struct WPIBusStatsPage *)map)->magic = WPI_BUS_STATS_MAGIC ;
+  else if (((struct WPIBusStatsPage *)map)->magic != WPI_BUS_STATS_MAGIC)
+  {
+    munmap (map, sizeof (struct WPIBusStatsPage)) ;
+    return NULL ;
+  }
+
+  return (struct WPIBusStatsPage *)map ;
+}
+
+struct WPIBusStats *wiringPiBusStatsSlot (int kind, int id)
+{
+  struct WPIBusStatsSlot *slot ;
+  int i ;
+
+  pthread_mutex_lock (&busStatsLock) ;
+
+  if (!busStatsInited)
+  {
+    busStatsPage = wiringPiBusStatsOpen (TRUE) ;
+    if (busStatsPage == NULL)
+      busStatsPage = &busStatsLocal ;
+    busStatsInited = TRUE ;
+  }
+
+  for (i = 0 ; i < WPI_BUS_STATS_SLOTS ; ++i)
+  {
+    slot = &busStatsPage->slots [i] ;
+    if ((slot->kind == kind) && (slot->id == id))
+      break ;
+    if (slot->kind == 0)
+    {
+      slot->id   = id ;
+      slot->kind = kind ;
+      break ;
+    }
+  }
+
+  pthread_mutex_unlock (&busStatsLock) ;
+
+  return (i < WPI_BUS_STATS_SLOTS) ? &slot->stats : NULL ;
+}
+
+
+static int wiringPiSetupGpioDeviceOnce (enum WPIPinType pinType) {
  if (wiringPiSetuped)
     return 0 ;
   if (wiringPiDebug) {
@@ -3688,13 +8914,7 @@ int wiringPiSetupGpioDevice (enum WPIPinType pinType) {
   }
   wiringPiSetuped = TRUE ;
 
-  if (piGpioLayout () == GPIO_LAYOUT_PI1_REV1){
-    pinToGpio  = pinToGpioR1 ;
-    physToGpio = physToGpioR1 ;
-  } else {
-    pinToGpio  = pinToGpioR2 ;
-    physToGpio = physToGpioR2 ;
-  }
+  wiringPiSelectLayout (piGpioLayout ()) ;
 
   initialiseEpoch () ;
 
@@ -3716,6 +8936,19 @@ int wiringPiSetupGpioDevice (enum WPIPinType pinType) {
   return 0 ;
 }
 
+int wiringPiSetupGpioDevice (enum WPIPinType pinType)
+{
+  int ret ;
+
+  pthread_mutex_lock (&wiringPiSetupMutex) ;
+  ret = wiringPiSetupGpioDeviceOnce (pinType) ;
+  if (ret == 0)
+    __atomic_store_n (&wiringPiSetupDone, TRUE, __ATOMIC_RELEASE) ;
+  pthread_mutex_unlock (&wiringPiSetupMutex) ;
+
+  return ret ;
+}
+
 /*
  * wiringPiSetupSys:
  * GPIO Sysfs Interface for Userspace is deprecated
@@ -54,6 +54,7 @@
 #define	WPI_MODE_GPIO_DEVICE_BCM  5  // BCM pin numbers like WPI_MODE_GPIO
 #define	WPI_MODE_GPIO_DEVICE_WPI  6  // WiringPi pin numbers like WPI_MODE_PINS
 #define	WPI_MODE_GPIO_DEVICE_PHYS 7  // Physic pin numbers like WPI_MODE_PHYS
+#define	WPI_MODE_SIM              8  // Simulated pins in a shared-memory page, BCM numbering
 #define	WPI_MODE_UNINITIALISED -1
 
 // Pin modes
@@ -156,6 +157,21 @@ extern const int   piMemorySize    [ 8] ;
 #define	WPI_FATAL	(1==1)
 #define	WPI_ALMOST	(1==2)
 
+// Non-fatal error codes, handed to the handler installed with
+//	wiringPiSetErrorHandler() along with the formatted message (no
+//	trailing newline). With no handler installed the message goes to
+//	stderr as it always has.
+//	Interface 3.17
+
+#define	WPI_ERROR_BAD_PIN	1	// Pin number invalid for the current mode
+#define	WPI_ERROR_BAD_MODE	2	// Wrong or missing setup for this operation
+#define	WPI_ERROR_BAD_ARGS	3	// Parameter out of range
+#define	WPI_ERROR_NO_PERMISSION	4	// Needs full /dev/mem access
+#define	WPI_ERROR_UNSUPPORTED	5	// Feature missing on this board
+#define	WPI_ERROR_IO		6	// Kernel or device call failed
+
+typedef void (*wiringPiErrorHandler) (int code, const char *message) ;
+
 
 // wiringPiNodeStruct:
 //	This describes additional device nodes in the extended wiringPi
@@ -185,10 +201,69 @@ struct wiringPiNodeStruct
   void (*analogWrite)     (struct wiringPiNodeStruct *node, int pin, int value) ;
 
   struct wiringPiNodeStruct *next ;
+
+// Optional batch entry points - bit N is pin (pinBase + N). Left NULL by
+//	wiringPiNewNode(); drivers that can do a whole port in one bus
+//	transaction fill them in and digitalWriteBank()/digitalReadBank()
+//	use them instead of going pin by pin.
+//	Interface V3.17
+
+  void         (*digitalWriteBank) (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int values) ;
+  unsigned int (*digitalReadBank)  (struct wiringPiNodeStruct *node, unsigned int mask) ;
+
+// As above but for ADC nodes: convert every channel in the mask in one
+//	bus transaction, result for pin (pinBase + N) landing in results [N].
+//	Interface V3.17
+
+  int          (*analogReadScan)   (struct wiringPiNodeStruct *node, unsigned int mask, int *results) ;
+
+// Command queue attached by wiringPiNodeSerialize() - NULL for the
+//	default direct-call behaviour. Opaque to drivers.
+//	Interface V3.17
+
+  void         *cmdQueue ;
+
+// TTL read cache attached by wiringPiNodeCacheReads() - also opaque,
+//	also NULL by default.
+//	Interface V3.17
+
+  void         *readCache ;
 } ;
 
 extern struct wiringPiNodeStruct *wiringPiNodes ;
 
+// Route one node's pin traffic through a lock-free command queue drained
+//	by a per-device worker, so threads can share an expander without a
+//	lock and without interleaving its bus sequences - unrelated devices
+//	keep running in parallel. Writes return as soon as they're queued;
+//	reads wait their turn behind them. Interface V3.17
+
+extern int wiringPiNodeSerialize (int pinBase) ;
+
+// Cache a slow sensor node's analogRead for ttlMs - reads inside the
+//	window return the stored value immediately, an expired read hands
+//	back the stale value and refreshes in the background on the
+//	piThreadPool, so the device converts at most once per TTL. 0
+//	restores direct reads. Interface V3.17
+
+extern int wiringPiNodeCacheReads (int pinBase, unsigned int ttlMs) ;
+
+// wiringPiPinHandle:
+//	A pre-resolved on-board pin - BCM number, register addresses and bit
+//	mask all worked out once by wiringPiOpenPin() - so the handle
+//	read/write inlines below compile down to a single register access.
+//	Interface V3.17
+
+struct wiringPiPinHandle
+{
+  int pinBCM ;
+  unsigned int mask ;
+  volatile unsigned int *setReg ;
+  volatile unsigned int *clrReg ;
+  volatile unsigned int *levReg ;
+  volatile unsigned int *xorReg ;	// RP1 toggle alias, NULL on BCM
+} ;
+
 // Export variables for the hardware pointers
 
 extern volatile unsigned int *_wiringPiGpio ;
@@ -197,6 +272,7 @@ extern volatile unsigned int *_wiringPiClk ;
 extern volatile unsigned int *_wiringPiPads ;
 extern volatile unsigned int *_wiringPiTimer ;
 extern volatile unsigned int *_wiringPiTimerIrqRaw ;
+extern volatile unsigned int *_wiringPiRio ;		// RP1 only, NULL elsewhere
 
 
 // Function prototypes
@@ -212,18 +288,41 @@ extern "C" {
 // Internal
 extern void piGpioLayoutOops (const char *why);
 extern int wiringPiFailure (int fatal, const char *message, ...) ;
+extern void wiringPiError (int code, const char *message, ...) ;		// Interface 3.17, routes to the handler or stderr
+
+extern void wiringPiSetErrorHandler (wiringPiErrorHandler handler) ;	// Interface 3.17, NULL restores stderr
 
 // Core wiringPi functions
 
 extern struct wiringPiNodeStruct *wiringPiFindNode (int pin) ;
 extern struct wiringPiNodeStruct *wiringPiNewNode  (int pinBase, int numPins) ;
+extern void wiringPiRemoveNode (struct wiringPiNodeStruct *node) ;  //Interface 3.17, frees the pin range, not the memory
 
 enum WPIPinType {
   WPI_PIN_BCM = 1,
   WPI_PIN_WPI,
   WPI_PIN_PHYS,
+  WPI_PIN_SIM,		// Interface V3.17, simulation backend - no hardware touched
 };
 
+// Simulation backend - Interface V3.17
+//	wiringPiSetupSim() maps a shared page (WIRINGPI_SIM_FILE, default
+//	/dev/shm/wiringpi-sim) and digitalWrite/digitalRead then run against
+//	it with no syscalls at all - a test harness mapping the same file
+//	sees every level change and can drive the inputs. BCM numbering.
+
+#define	WPI_SIM_MAGIC	0x57695053
+
+struct WPISimState
+{
+  unsigned int magic ;			// WPI_SIM_MAGIC once initialised
+  unsigned int levels [2] ;		// Pin level bits, BCM numbering
+  unsigned char modes [64] ;		// Last pinMode() per pin
+  unsigned char pud [64] ;		// Last pullUpDnControl() per pin
+  unsigned long long writes ;		// Running digitalWrite() count
+  unsigned long long reads ;		// Running digitalRead() count
+} ;
+
 extern void wiringPiVersion	(int *major, int *minor) ;
 extern int  wiringPiGlobalMemoryAccess(void);                 //Interface V3.3
 extern int  wiringPiUserLevelAccess (void) ;
@@ -233,6 +332,64 @@ extern int  wiringPiSetupGpio   (void) ;
 extern int  wiringPiSetupPhys   (void) ;
 extern int  wiringPiSetupPinType (enum WPIPinType pinType);   //Interface V3.3
 extern int  wiringPiSetupGpioDevice(enum WPIPinType pinType); //Interface V3.3
+extern int  wiringPiSetupSim    (void) ;                      //Interface V3.17
+
+// Setup profiles for wiringPiSetupEx - Interface V3.17
+//	subsystems is a WPI_SETUP_* mask: flagged blocks are set up eagerly,
+//	the rest stay lazy or unmapped. WPI_SETUP_DEFAULT matches what the
+//	plain wiringPiSetup*() calls do; 0 is the minimal GPIO-only profile.
+//	preferGpioMem takes /dev/gpiomem even when /dev/mem would open -
+//	the smallest mapping, at the cost of the root-only peripherals.
+
+#define	WPI_SETUP_TIMER		0x01	// map the 1MHz system timer (BCM models)
+#define	WPI_SETUP_PWM		0x02	// map PWM and clocks now, not on first use
+#define	WPI_SETUP_ISR		0x04	// open the gpiochip device now
+
+#define	WPI_SETUP_DEFAULT	WPI_SETUP_TIMER
+
+struct WPISetupOpts
+{
+  enum WPIPinType pinType ;	// 0: as wiringPiSetup() would choose
+  unsigned int subsystems ;	// WPI_SETUP_* mask
+  int preferGpioMem ;		// TRUE: never open /dev/mem
+} ;
+
+extern int  wiringPiSetupEx     (const struct WPISetupOpts *opts) ;   //Interface V3.17
+extern struct WPISimState *wiringPiSimState (void) ;          //Interface V3.17, NULL unless in sim mode
+
+// Per-bus transaction statistics - Interface V3.17
+//	Cheap accounting kept by wiringPiI2C/wiringPiSPI around their
+//	ioctls. Normally in-process (query with wiringPiI2CStats /
+//	wiringPiSPIStats); when WIRINGPI_STATS_FILE names a file the
+//	counters live in a page mmap'd from it instead, so `gpio stats`
+//	can watch another process's bus occupancy live.
+
+#define	WPI_BUS_STATS_ENV	"WIRINGPI_STATS_FILE"
+#define	WPI_BUS_STATS_MAGIC	0x57695374
+#define	WPI_BUS_STATS_SLOTS	48
+#define	WPI_BUS_STATS_I2C	'I'	// id is the bus fd
+#define	WPI_BUS_STATS_SPI	'S'	// id is number * 4 + channel
+
+struct WPIBusStats {
+    unsigned long long transactions;
+    unsigned long long bytes;       // payload bytes moved
+    unsigned long long errors;      // failed transactions
+    unsigned long long busTime_us;  // cumulative wall time on the bus
+};
+
+struct WPIBusStatsSlot {
+    int kind;                       // WPI_BUS_STATS_*, 0 when free
+    int id;
+    struct WPIBusStats stats;
+};
+
+struct WPIBusStatsPage {
+    unsigned int magic;
+    struct WPIBusStatsSlot slots[WPI_BUS_STATS_SLOTS];
+};
+
+extern struct WPIBusStatsPage *wiringPiBusStatsOpen (int create) ;        //Interface V3.17, NULL when env unset
+extern struct WPIBusStats     *wiringPiBusStatsSlot (int kind, int id) ;  //Interface V3.17, for the bus drivers
 
 
 enum WPIPinAlt {
@@ -258,12 +415,75 @@ extern void pinModeAlt          (int pin, int mode) ;
 extern enum WPIPinAlt getPinModeAlt       (int pin) ;  // Interface V3.5, same as getAlt but wie enum
 extern void pinMode             (int pin, int mode) ;
 extern void pullUpDnControl     (int pin, int pud) ;
+
+// Interface 3.17 - single-pass bulk pin configuration
+struct WPIPinConfig
+{
+  int pin ;
+  int mode ;		// INPUT/OUTPUT/etc., -1 to leave unchanged
+  int pud ;		// PUD_OFF/PUD_DOWN/PUD_UP, -1 to leave unchanged
+  int drive ;		// 0-3 pad drive strength (Pi 5), -1 to leave unchanged
+} ;
+extern int  wiringPiConfigPins  (const struct WPIPinConfig *cfgs, int numConfigs) ;
+
+// One captured GPIO configuration for wpiSaveConfig/wpiRestoreConfig -
+//	function select, pulls and pad drive, but not the output levels.
+//	Interface V3.17
+
+struct WPIConfigSnapshot
+{
+  int rp1 ;			// captured on an RP1 - guards cross-model restore
+  unsigned int fsel [6] ;	// BCM GPFSEL0-5
+  unsigned int pull [4] ;	// BCM2711 pull registers (older BCMs can't read them back)
+  unsigned int pads [3] ;	// BCM pad drive groups...
+  int          padsValid ;	// ...when the pads block was mapped
+  unsigned int rp1Ctrl [32] ;	// RP1 per-pin function and debounce
+  unsigned int rp1Pad  [32] ;	// RP1 per-pin pad state
+  unsigned int rp1Oe ;		// RP1 output enables (pin direction)
+} ;
+extern int  wpiSaveConfig       (struct WPIConfigSnapshot *snap) ;		// Interface V3.17
+extern int  wpiRestoreConfig    (const struct WPIConfigSnapshot *snap) ;	// Interface V3.17
+extern void wiringPiExtensionArenaReset (void) ;	// Interface 3.17 - drop all extension nodes and their memory
+
+// Aligned I/O buffers - Interface V3.17
+//	Page-aligned always; WPI_BUF_HUGE asks for hugepage backing (TLB
+//	relief on big sampler buffers), WPI_BUF_LOCK pins the pages.
+
+#define	WPI_BUF_HUGE	0x01
+#define	WPI_BUF_LOCK	0x02
+
+extern void *wpiBufAlloc (unsigned int size, int flags) ;
+extern int   wpiBufFree  (void *mem) ;
+
+extern void wiringPiFselResync  (void) ;	// Interface 3.17 - drop the FSEL/pad shadow after external changes
 extern int  digitalRead         (int pin) ;
 extern void digitalWrite        (int pin, int value) ;
+extern void digitalToggle       (int pin) ;           // Interface 3.17 - one XOR store on Pi 5
 extern void pwmWrite            (int pin, int value) ;
+extern void pwmAutoWrite        (int pin, int value) ;  // Interface V3.17, hardware PWM when the pin can, softPwm otherwise
+extern int  pwmStreamWrite      (int pin, const unsigned int *samples, int numSamples, unsigned int rateHz) ;  // Interface V3.17, waveform through the PWM FIFO
 extern int  analogRead          (int pin) ;
 extern void analogWrite         (int pin, int value) ;
 
+// Pre-resolved pin handles - Interface V3.17
+//	Open once, then use the inlines below in the hot loops. The pin must
+//	already be set to the right mode with pinMode().
+
+extern int  wiringPiOpenPin     (int pin, struct wiringPiPinHandle *handle) ;
+
+static inline void digitalWriteHandle (const struct wiringPiPinHandle *handle, int value)
+{
+  if (value == LOW)
+    *handle->clrReg = handle->mask ;
+  else
+    *handle->setReg = handle->mask ;
+}
+
+static inline int digitalReadHandle (const struct wiringPiPinHandle *handle)
+{
+  return ((*handle->levReg & handle->mask) != 0) ? HIGH : LOW ;
+}
+
 // PiFace specifics
 //	(Deprecated)
 
@@ -283,6 +503,7 @@ extern          void setPadDrive         (int group, int value) ;
 extern          void setPadDrivePin      (int pin, int value);     // Interface V3.0
 extern          int  getAlt              (int pin) ;
 extern          void pwmToneWrite        (int pin, int freq) ;
+extern          void toneWriteHw         (int pin, int freq) ;	// Interface 3.17 - GP clock when the pin can, softTone otherwise
 extern          void pwmSetMode          (int mode) ;
 extern          void pwmSetRange         (unsigned int range) ;
 extern          void pwmSetClock         (int divisor) ;
@@ -291,6 +512,60 @@ extern unsigned int  digitalReadByte     (void) ;
 extern unsigned int  digitalReadByte2    (void) ;
 extern          void digitalWriteByte    (int value) ;
 extern          void digitalWriteByte2   (int value) ;
+extern          void digitalWriteMulti   (unsigned long long pinMask, unsigned long long values) ;  // Interface V3.17, mask in BCM numbering
+extern          void wpiBatchBegin       (void) ;   // Interface V3.17, group writes: one store per SET/CLR register
+extern          void wpiBatchCommit      (void) ;   //   at commit, single-store semantics per pin preserved
+extern          int  digitalReadMulti    (unsigned long long pinMask, unsigned long long *levels) ; // Interface V3.17, mask in BCM numbering
+extern          void digitalWriteBank    (int pinBase, unsigned int mask, unsigned int values) ;    // Interface V3.17, extension nodes
+extern  unsigned int digitalReadBank     (int pinBase, unsigned int mask) ;                         // Interface V3.17, extension nodes
+extern           int analogReadScan      (int pinBase, unsigned int mask, int *results) ;           // Interface V3.17, extension nodes
+extern           int analogReadMulti     (const int *pins, int *values, int n) ;                    // Interface V3.17, nodes read concurrently
+
+// wiringPiSampleReport:
+//	What a capture run actually delivered.
+//	Interface V3.17
+
+struct wiringPiSampleReport
+{
+  unsigned int achievedRateHz ;
+  unsigned int missedDeadlines ;
+} ;
+
+extern          int  wiringPiSample      (unsigned long long pinMask, unsigned int rateHz, unsigned long long *buf,
+						unsigned int numSamples, struct wiringPiSampleReport *report) ;  // Interface V3.17
+
+// Completion function for continuous capture - runs on the stream's
+//	drain thread with a freshly filled buffer.
+//	Interface V3.17
+
+typedef void (*wiringPiSampleCompletion) (unsigned long long *buf, unsigned int numSamples, struct wiringPiSampleReport *report) ;
+
+extern          int  wiringPiSampleStart (unsigned long long pinMask, unsigned int rateHz,
+						unsigned long long *bufA, unsigned long long *bufB,
+						unsigned int numSamples, wiringPiSampleCompletion callback) ;  // Interface V3.17
+extern          int  wiringPiSampleStop  (void) ;                                                           // Interface V3.17
+
+// Transpose between the sampler's word-per-sample bitmasks and packed
+//	per-pin bit streams (one row per pin, rows stride bytes apart,
+//	LSB-first within each byte). NEON-accelerated on AArch64.
+//	Interface V3.17
+
+extern          int  wpiSampleToStreams  (const unsigned long long *samples, unsigned int numSamples,
+						const int *pins, int numPins,
+						unsigned char *streams, unsigned int stride) ;
+extern          int  wpiStreamsToSamples (const unsigned char *streams, unsigned int stride,
+						const int *pins, int numPins,
+						unsigned long long *samples, unsigned int numSamples) ;
+
+// Busy-poll edge engine: a pinned SCHED_FIFO thread spins on the level
+//	bank and calls the handler inline - sub-microsecond reaction at
+//	the price of a dedicated core. The handler runs ON the spinning
+//	thread; keep it tiny. Interface V3.17
+
+extern          int  wiringPiSpinPollStart (unsigned long long pinMask, int edgeMode,
+						void (*handler)(int pinBCM, int edge, unsigned long long timeNs),
+						int core) ;
+extern          int  wiringPiSpinPollStop  (void) ;
 
 // Interrupts
 // status returned from waitForInterruptV2    V3.16
@@ -305,23 +580,168 @@ struct WPIWfiStatus {
 extern int  wiringPiISR         (int pin, int mode, void (*function)(void)) ;
 extern struct WPIWfiStatus  waitForInterrupt2(int pin, int edgeMode, int ms, unsigned long debounce_period_us) ;   // V3.16
 extern int  wiringPiISR2       (int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata) ;  // V3.16
+extern int  wiringPiISR2Queued (int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata) ;  // V3.17, callback on shared dispatch thread
 extern int  wiringPiISRStop     (int pin) ;  //V3.2
 extern int  waitForInterruptClose(int pin) ; //V3.2 legacy use wiringPiISRStop
 
+// Scheduling for the per-pin interrupt reader thread   V3.17
+//	By default every reader runs at piHiPri(55), so an E-stop pin's
+//	handler competes with bulk sensor pins. Register with
+//	wiringPiISR2Sched() instead and the reader gets a real-time class
+//	and optional CPU pinning applied before the first event, bounding
+//	edge-to-callback latency independently of load. SCHED_FIFO/RR need
+//	root (or CAP_SYS_NICE); the *Ns fields are SCHED_DEADLINE only.
+
+#define	WPI_ISR_SCHED_DEFAULT	0
+#define	WPI_ISR_SCHED_FIFO	1
+#define	WPI_ISR_SCHED_RR	2
+#define	WPI_ISR_SCHED_DEADLINE	3
+
+struct WPIIsrSched {
+    int policy ;                    // WPI_ISR_SCHED_*
+    int priority ;                  // 1-99, FIFO and RR only
+    int cpu ;                       // pin the reader to this CPU, -1: don't care
+    unsigned long long runtimeNs ;  // SCHED_DEADLINE worst-case handler runtime
+    unsigned long long deadlineNs ;
+    unsigned long long periodNs ;   // shortest expected edge interval
+} ;
+
+extern int  wiringPiISR2Sched  (int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata, const struct WPIIsrSched *sched) ;  // V3.17
+
+extern int  wiringPiISRBufferSize (int pin, int numEvents) ;    // V3.17, kernel event buffer depth for the next line request on the pin, 1-1024, 0 restores the default
+extern unsigned int wiringPiISRLostEvents (int pin) ;           // V3.17, events dropped kernel-side (seqno gaps) since registration
+
+// Per-pin ISR latency histograms   V3.17
+//	Deltas from the kernel's edge timestamp to user-callback entry,
+//	recorded by the dispatching thread itself so production numbers come
+//	for free - no perf, no tracing. Bucket i counts latencies below
+//	(1uS << i); the top bucket takes everything beyond.
+
+#define	WPI_ISR_STATS_BUCKETS	24
+
+struct WPIIsrStats {
+    unsigned long long count;       // callbacks measured
+    unsigned long long minNs;       // 0 until the first event
+    unsigned long long maxNs;
+    unsigned long long totalNs;     // divide by count for the mean
+    unsigned long long buckets[WPI_ISR_STATS_BUCKETS];
+};
+
+extern int  wiringPiISRStatsEnable (int pin, int enable) ;                // V3.17, enabling zeroes the histogram
+extern int  wiringPiISRStats       (int pin, struct WPIIsrStats *stats) ; // V3.17, snapshot, -1 unless enabled
+
+// Pulse metering   V3.17
+//	Period and high-time statistics for tachs and PWM feedback, folded
+//	into accumulators by the edge reader thread itself from the kernel's
+//	timestamps - no user callback per edge, no callback jitter in the
+//	numbers. A snapshot publishes each time the averaging window closes
+//	and reads lock-free. A stalled input publishes nothing more, so
+//	compare timestampNs against your own clock to detect it.
+
+struct WPIPulseMeter {
+    unsigned long long pulses;          // complete periods since the meter was armed
+    unsigned int frequencyMilliHz;      // mean over the last completed window
+    unsigned int dutyCyclePPM;          // high time per period, parts per million
+    unsigned long long minPeriodNs;     // extremes within that window
+    unsigned long long maxPeriodNs;
+    unsigned long long minHighNs;
+    unsigned long long maxHighNs;
+    unsigned long long timestampNs;     // kernel clock at the window's close
+};
+
+extern int  wiringPiPulseMeter     (int pin, unsigned int windowMs) ;        // V3.17, claims the pin's edge reader; 0 = 1s window
+extern int  wiringPiPulseMeterRead (int pin, struct WPIPulseMeter *meter) ;  // V3.17, zeros until the first window closes
+extern int  wiringPiPulseMeterStop (int pin) ;                               // V3.17
+
+// Quadrature encoders   V3.17
+//	x4 decode run by a dedicated thread draining one two-line kernel
+//	request, so both channels arrive on a single thread in timestamp
+//	order with no lock between them. Snapshots read lock-free, like the
+//	pulse meters. Position counts x4 edges from wherever the shaft was
+//	at attach; glitches count transitions where both channels appear to
+//	flip at once (a lost intermediate edge - direction unknowable).
+
+struct WPIEncoderStatus {
+    long long position;             // x4 counts, signed
+    int velocityCPS;                // counts per second over a 100mS window
+    unsigned int glitches;
+    unsigned long long timestampNs; // kernel clock of the latest decoded edge
+};
+
+extern int  wiringPiEncoderAttach (int pinA, int pinB) ;                         // V3.17, returns a handle
+extern int  wiringPiEncoderRead   (int encoder, struct WPIEncoderStatus *status) ; // V3.17
+extern int  wiringPiEncoderDetach (int encoder) ;                                // V3.17
+
+// Shared epoll event loop - one thread for any number of pins   V3.17
+extern int  wiringPiEventLoopAdd    (int pin, int edgeMode, void (*function)(struct WPIWfiStatus wfiStatus, void* userdata), unsigned long debounce_period_us, void* userdata) ;
+extern int  wiringPiEventLoopRemove (int pin) ;
+
+// Watch plain file descriptors (serial ports, sockets, timerfds) with the
+//	same loop - the callback runs on the loop thread when the fd is
+//	readable, and must drain it. Interface V3.17
+
+extern int  wiringPiEventLoopAddFd    (int fd, void (*function)(int fd, void *userdata), void *userdata) ;
+extern int  wiringPiEventLoopRemoveFd (int fd) ;
+
+// Batched edge capture with the kernel's full nanosecond timestamps   V3.17
+struct WPIEdgeEvent {
+    unsigned int pinBCM;            // gpio as BCM pin
+    int edge;                       // INT_EDGE_FALLING or INT_EDGE_RISING
+    unsigned long long timeStamp_ns;// kernel CLOCK_MONOTONIC stamp of the edge
+    unsigned int seqno;             // per-line sequence number from the kernel
+};
+
+extern int  wiringPiEdgeCaptureOpen  (int pin, int edgeMode, unsigned long debounce_period_us) ;
+extern int  wiringPiEdgeCaptureRead  (int pin, struct WPIEdgeEvent *events, int maxEvents, int timeout_ms) ;
+extern int  wiringPiEdgeCaptureClose (int pin) ;
+
 // Threads
 
 extern int  piThreadCreate      (void *(*fn)(void *)) ;
 extern void piLock              (int key) ;
 extern void piUnlock            (int key) ;
+extern int  piTryLock           (int key) ;  // Interface V3.17, TRUE if taken
 
 // Schedulling priority
 
 extern int piHiPri (const int pri) ;
+extern int piSetAffinity   (const unsigned int cpuMask) ;                        // Interface V3.17, bit N is CPU N
+extern int piSetDeadline   (const unsigned long long runtimeNs, const unsigned long long deadlineNs, const unsigned long long periodNs) ;  // Interface V3.17, SCHED_DEADLINE for the calling thread
+extern int piRealtimeSetup (const int pri, const int cpu) ;                      // Interface V3.17, priority + pinning + mlockall
+extern int piThreadCreateOn (void *(*fn)(void *), const int cpu, const int priority) ;  // Interface V3.17
+
+// Interface V3.17 - warm worker pool for one-shot tasks: lock-free MPMC
+//	submission queue, workers optionally pinned to the CPUs in the mask
+//	(0: no pinning). Submit returns TRUE, or FALSE if the queue is full
+//	or no pool exists.
+
+extern int piThreadPoolCreate (int nThreads, unsigned int affinityMask) ;
+extern int piThreadPoolSubmit (void (*fn)(void *), void *arg) ;
+
+// Interface V3.17 - drift-free periodic tasks: the callback runs on an
+//	absolute CLOCK_MONOTONIC timeline (timerfd), so the long-term rate
+//	is exact no matter how long each callback takes. Ticks missed
+//	behind a slow callback are counted, not replayed.
+
+#define	PI_PERIODIC_RT		0x01	// SCHED_RR worker (falls back if unprivileged)
+#define	PI_PERIODIC_ALIGN	0x02	// first tick on a whole multiple of the period
+#define	PI_PERIODIC_DEADLINE	0x04	// SCHED_DEADLINE reservation (falls back if unprivileged)
+
+extern int          piPeriodicCreate   (unsigned int periodUs, void (*fn)(void *), void *arg, int flags) ;
+extern unsigned int piPeriodicOverruns (int handle) ;
+extern void         piPeriodicDestroy  (int handle) ;
+
+// Interface V3.17 - prefault and mlock the peripheral mappings and hot
+//	library data after setup, so real-time paths never eat a first-
+//	access page fault. -1: an mlock was refused (RLIMIT_MEMLOCK).
+
+extern int          wpiRealtimeWarmup  (void) ;
 
 // Extras from arduino land
 
 extern void         delay             (unsigned int ms) ;
 extern void         delayMicroseconds (unsigned int us) ;
+extern void         delayNanoseconds  (unsigned int ns) ;  // Interface V3.17, calibrated cycle-counter spin for setup/hold times
 extern unsigned int millis            (void) ;
 extern unsigned int micros            (void) ;
 
@@ -0,0 +1,219 @@
+/*
+ * wiringPiBitBang.c:
+ *	Compiled bit-bang engine for clocked 2-wire protocols.
+ *
+ *	Several of our drivers (ds1302, sr595, piNes, ...) hand-roll the
+ *	same shift loop: present or sample a bit on a data line, pulse a
+ *	clock line, pause. This module does that once, properly: at create
+ *	time the pins are resolved down to wiringPiPinHandle register
+ *	descriptors and the pacing is a calibrated delayNanoseconds(), so
+ *	the per-bit cost is a handful of register accesses rather than a
+ *	full digitalWrite() dispatch plus a microsecond-granular sleep.
+ *
+ *	The clock idles low and pulses high once per bit. On output the
+ *	data bit is presented before the rising edge; on input the data
+ *	line is sampled before the rising edge (valid for chips that
+ *	present the next bit on the falling edge, which is all of ours).
+ *
+ * Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdint.h>
+
+#include "wiringPi.h"
+#include "wiringPiBitBang.h"
+
+#define	WPI_BB_MAX	8
+
+struct wpiBitBangDev
+{
+  int clockPin ;			// -1 marks a free slot
+  int dataPin ;
+  unsigned int phaseNs ;
+  unsigned int flags ;
+  int dataMode ;			// last pinMode applied to the data pin
+  int fastPins ;			// both pins resolved to register handles
+  struct wiringPiPinHandle cHandle, dHandle ;
+} ;
+
+static struct wpiBitBangDev bbDevs [WPI_BB_MAX] =
+{
+  [0 ... WPI_BB_MAX - 1] = { .clockPin = -1 }
+} ;
+
+
+static void bbPause (const unsigned int ns)
+{
+  if (ns != 0)
+    delayNanoseconds (ns) ;
+}
+
+
+/*
+ * wpiBitBangCreate:
+ *	Compile a transfer description into a handle. The caller owns the
+ *	pin setup: the clock pin must already be an output, idling low.
+ *	Returns the handle, or -1 when the table is full.
+ *********************************************************************************
+ */
+
+int wpiBitBangCreate (const int clockPin, const int dataPin, const unsigned int phaseNs, const unsigned int flags)
+{
+  int handle ;
+  struct wpiBitBangDev *dev ;
+
+  for (handle = 0 ; handle < WPI_BB_MAX ; ++handle)
+    if (bbDevs [handle].clockPin == -1)
+      break ;
+
+  if (handle == WPI_BB_MAX)
+    return -1 ;
+
+  dev = &bbDevs [handle] ;
+
+  dev->dataPin  = dataPin ;
+  dev->phaseNs  = phaseNs ;
+  dev->flags    = flags ;
+  dev->dataMode = -1 ;
+
+// Resolve down to register handles when the GPIO is memory-mapped -
+//	otherwise the loops below fall back to digitalWrite/digitalRead.
+
+  dev->fastPins = (wiringPiOpenPin (clockPin, &dev->cHandle) >= 0) &&
+		  (wiringPiOpenPin (dataPin,  &dev->dHandle) >= 0) ;
+
+  dev->clockPin = clockPin ;		// Claims the slot
+
+  return handle ;
+}
+
+
+/*
+ * wpiBitBangShiftOut:
+ *	Clock the low "bits" bits of data out: present the bit, pause,
+ *	clock high, pause, clock low, pause.
+ *********************************************************************************
+ */
+
+void wpiBitBangShiftOut (const int handle, const unsigned int data, const int bits)
+{
+  struct wpiBitBangDev *dev ;
+  unsigned int ns ;
+  int i, bit ;
+
+  if ((handle < 0) || (handle >= WPI_BB_MAX) || (bbDevs [handle].clockPin == -1))
+    return ;
+
+  dev = &bbDevs [handle] ;
+  ns  = dev->phaseNs ;
+
+  if (dev->dataMode != OUTPUT)
+  {
+    pinMode (dev->dataPin, OUTPUT) ;
+    dev->dataMode = OUTPUT ;
+  }
+
+  if (dev->fastPins)
+  {
+    for (i = 0 ; i < bits ; ++i)
+    {
+      bit = (dev->flags & WPI_BB_MSBFIRST) ? (bits - 1 - i) : i ;
+      digitalWriteHandle (&dev->dHandle, (data >> bit) & 1) ;	bbPause (ns) ;
+      digitalWriteHandle (&dev->cHandle, HIGH) ;		bbPause (ns) ;
+      digitalWriteHandle (&dev->cHandle, LOW) ;			bbPause (ns) ;
+    }
+    return ;
+  }
+
+  for (i = 0 ; i < bits ; ++i)
+  {
+    bit = (dev->flags & WPI_BB_MSBFIRST) ? (bits - 1 - i) : i ;
+    digitalWrite (dev->dataPin, (data >> bit) & 1) ;	bbPause (ns) ;
+    digitalWrite (dev->clockPin, HIGH) ;		bbPause (ns) ;
+    digitalWrite (dev->clockPin, LOW) ;			bbPause (ns) ;
+  }
+}
+
+
+/*
+ * wpiBitBangShiftIn:
+ *	Clock "bits" bits in: sample the line, then pulse the clock so the
+ *	chip presents the next bit.
+ *********************************************************************************
+ */
+
+unsigned int wpiBitBangShiftIn (const int handle, const int bits)
+{
+  struct wpiBitBangDev *dev ;
+  unsigned int value = 0 ;
+  unsigned int ns ;
+  int i, bit ;
+
+  if ((handle < 0) || (handle >= WPI_BB_MAX) || (bbDevs [handle].clockPin == -1))
+    return 0 ;
+
+  dev = &bbDevs [handle] ;
+  ns  = dev->phaseNs ;
+
+  if (dev->dataMode != INPUT)
+  {
+    pinMode (dev->dataPin, INPUT) ;
+    dev->dataMode = INPUT ;
+    bbPause (ns) ;
+  }
+
+  if (dev->fastPins)
+  {
+    for (i = 0 ; i < bits ; ++i)
+    {
+      bit    = (dev->flags & WPI_BB_MSBFIRST) ? (bits - 1 - i) : i ;
+      value |= (unsigned int)digitalReadHandle (&dev->dHandle) << bit ;
+      digitalWriteHandle (&dev->cHandle, HIGH) ;	bbPause (ns) ;
+      digitalWriteHandle (&dev->cHandle, LOW) ;		bbPause (ns) ;
+    }
+    return value ;
+  }
+
+  for (i = 0 ; i < bits ; ++i)
+  {
+    bit    = (dev->flags & WPI_BB_MSBFIRST) ? (bits - 1 - i) : i ;
+    value |= (unsigned int)digitalRead (dev->dataPin) << bit ;
+    digitalWrite (dev->clockPin, HIGH) ;	bbPause (ns) ;
+    digitalWrite (dev->clockPin, LOW) ;		bbPause (ns) ;
+  }
+
+  return value ;
+}
+
+
+/*
+ * wpiBitBangDelete:
+ *	Release a handle. The pins are left as they are.
+ *********************************************************************************
+ */
+
+void wpiBitBangDelete (const int handle)
+{
+  if ((handle < 0) || (handle >= WPI_BB_MAX))
+    return ;
+
+  bbDevs [handle].clockPin = -1 ;
+}
@@ -0,0 +1,51 @@
+/*
+ * wiringPiBitBang.h:
+ *	Compiled bit-bang engine for clocked 2-wire protocols.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifndef	_WIRINGPI_BITBANG_H
+#define	_WIRINGPI_BITBANG_H
+
+// Option flags for wpiBitBangCreate()
+//	Interface V3.17
+
+#define	WPI_BB_MSBFIRST		0x01	// default is LSB first
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interface V3.17 - the caller describes the transfer once (clock pin,
+//	data pin, per-phase timing, bit order) and gets a handle; the shift
+//	calls then run a pre-resolved register-level loop. phaseNs is the
+//	hold time of each clock phase - pass 0 for flat-out.
+
+extern int          wpiBitBangCreate   (const int clockPin, const int dataPin, const unsigned int phaseNs, const unsigned int flags) ;
+extern void         wpiBitBangShiftOut (const int handle, const unsigned int data, const int bits) ;
+extern unsigned int wpiBitBangShiftIn  (const int handle, const int bits) ;
+extern void         wpiBitBangDelete   (const int handle) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * wiringPiCRC.c:
+ *	Shared CRC routines for the 1-wire style device drivers.
+ *
+ *	Every Dallas/Maxim 1-wire device protects its frames with the
+ *	same reflected CRC8 (scratchpads, ROM codes) or CRC16 (memory
+ *	devices), and each driver computing them bit-by-bit in private
+ *	copies adds up. These are the byte-per-step table versions -
+ *	the tables are built on first use, so an application that never
+ *	checks a CRC pays nothing.
+ *
+ *	CRC32 (the IEEE polynomial zlib and ethernet use) is included
+ *	for checksumming capture buffers and the like; ARMv8 cores
+ *	built with +crc do it a word at a time in hardware.
+ *
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#if defined (__aarch64__) && defined (__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "wiringPi.h"
+#include "wiringPiCRC.h"
+
+// Reflected polynomials. The table builds are idempotent, so a race on
+//	first use from two threads is harmless.
+
+#define	CRC8_POLY	0x8C		// 0x31 reflected
+#define	CRC16_POLY	0xA001		// 0x8005 reflected
+#define	CRC32_POLY	0xEDB88320	// 0x04C11DB7 reflected
+
+static unsigned char  crc8Table  [256] ;
+static unsigned short crc16Table [256] ;
+static unsigned int   crc32Table [256] ;
+
+static int crc8Ready  = FALSE ;
+static int crc16Ready = FALSE ;
+static int crc32Ready = FALSE ;
+
+
+/*
+ * wpiCRC8:
+ *	Dallas/Maxim CRC8 over len bytes, initial value 0. A frame with
+ *	its CRC byte appended computes to 0 when intact.
+ *********************************************************************************
+ */
+
+unsigned char wpiCRC8 (const unsigned char *data, int len)
+{
+  unsigned char crc = 0 ;
+  unsigned int n ;
+  int bit, i ;
+
+  if (!crc8Ready)
+  {
+    for (n = 0 ; n < 256 ; ++n)
+    {
+      crc = (unsigned char)n ;
+      for (bit = 0 ; bit < 8 ; ++bit)
+	crc = (crc & 1) ? (crc >> 1) ^ CRC8_POLY : crc >> 1 ;
+      crc8Table [n] = crc ;
+    }
+    crc8Ready = TRUE ;
+  }
+
+  crc = 0 ;
+  for (i = 0 ; i < len ; ++i)
+    crc = crc8Table [crc ^ data [i]] ;
+
+  return crc ;
+}
+
+
+/*
+ * wpiCRC16:
+ *	1-wire CRC16 over len bytes, initial value 0. Note the bus
+ *	convention: devices transmit the CRC inverted, so check either
+ *	against the complement or feed the inverted bytes through and
+ *	compare with 0xB001.
+ *********************************************************************************
+ */
+
+unsigned short wpiCRC16 (const unsigned char *data, int len)
+{
+  unsigned short crc = 0 ;
+  unsigned int n ;
+  int bit, i ;
+
+  if (!crc16Ready)
+  {
+    for (n = 0 ; n < 256 ; ++n)
+    {
+      crc = (unsigned short)n ;
+      for (bit = 0 ; bit < 8 ; ++bit)
+	crc = (crc & 1) ? (crc >> 1) ^ CRC16_POLY : crc >> 1 ;
+      crc16Table [n] = crc ;
+    }
+    crc16Ready = TRUE ;
+  }
+
+  crc = 0 ;
+  for (i = 0 ; i < len ; ++i)
+    crc = crc16Table [(crc ^ data [i]) & 0xFF] ^ (crc >> 8) ;
+
+  return crc ;
+}
+
+
+/*
+ * wpiCRC32:
+ *	IEEE CRC32 as zlib computes it (pre/post inverted). On ARMv8
+ *	cores built with +crc the crc32x instruction eats 8 bytes per
+ *	step; everywhere else it's the usual table walk.
+ *********************************************************************************
+ */
+
+unsigned int wpiCRC32 (const unsigned char *data, int len)
+{
+  unsigned int crc = 0xFFFFFFFF ;
+  int i = 0 ;
+
+#if defined (__aarch64__) && defined (__ARM_FEATURE_CRC32)
+
+  unsigned long long word ;
+
+  for (; i + 8 <= len ; i += 8)
+  {
+    __builtin_memcpy (&word, data + i, 8) ;
+    crc = __crc32d (crc, word) ;
+  }
+  for (; i < len ; ++i)
+    crc = __crc32b (crc, data [i]) ;
+
+#else
+
+  unsigned int n, c ;
+  int bit ;
+
+  if (!crc32Ready)
+  {
+    for (n = 0 ; n < 256 ; ++n)
+    {
+      c = n ;
+      for (bit = 0 ; bit < 8 ; ++bit)
+	c = (c & 1) ? (c >> 1) ^ CRC32_POLY : c >> 1 ;
+      crc32Table [n] = c ;
+    }
+    crc32Ready = TRUE ;
+  }
+
+  for (; i < len ; ++i)
+    crc = crc32Table [(crc ^ data [i]) & 0xFF] ^ (crc >> 8) ;
+
+#endif
+
+  return crc ^ 0xFFFFFFFF ;
+}
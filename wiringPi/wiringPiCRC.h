@@ -0,0 +1,43 @@
+/*
+ * wiringPiCRC.h:
+ *	Shared CRC routines for the 1-wire style device drivers.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifndef	_WIRINGPI_CRC_H
+#define	_WIRINGPI_CRC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interface V3.17 - all table driven; a valid 1-wire frame with its
+//	trailing CRC byte(s) included computes to 0.
+
+extern unsigned char  wpiCRC8  (const unsigned char *data, int len) ;	// Dallas/Maxim, poly 0x31 reflected
+extern unsigned short wpiCRC16 (const unsigned char *data, int len) ;	// 1-wire CRC16, poly 0x8005 reflected
+extern unsigned int   wpiCRC32 (const unsigned char *data, int len) ;	// IEEE (zlib), hardware on ARMv8+crc
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -51,17 +51,25 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <asm/ioctl.h>
 
 #include "wiringPi.h"
+#include "wiringPiTrace.h"
 #include "wiringPiI2C.h"
 
 // I2C definitions
 
+#define I2C_RETRIES	0x0701	/* Number of times a device address is polled */
+#define I2C_TIMEOUT	0x0702	/* Transfer timeout, in 10mS units */
 #define I2C_SLAVE	0x0703
+#define I2C_RDWR	0x0707	/* Combined R/W transfer, one STOP only */
 #define I2C_SMBUS	0x0720	/* SMBus-level access */
 
+#define I2C_RDWR_IOCTL_MAX_MSGS	42	/* Kernel limit */
+
 #define I2C_SMBUS_READ	1
 #define I2C_SMBUS_WRITE	0
 
@@ -99,15 +107,270 @@ struct i2c_smbus_ioctl_data
   union i2c_smbus_data *data ;
 } ;
 
+// Transaction accounting - wraps the time/byte/error bookkeeping around
+//	one bus operation. See wiringPiBusStatsSlot() for where it lands.
+
+static void i2cStatsBegin (struct timespec *t0)
+{
+  clock_gettime (CLOCK_MONOTONIC, t0) ;
+}
+
+static void i2cStatsEnd (int fd, int bytes, int result, const struct timespec *t0)
+{
+  struct WPIBusStats *s = wiringPiBusStatsSlot (WPI_BUS_STATS_I2C, fd) ;
+  struct timespec t1 ;
+
+  if (s == NULL)
+    return ;
+
+  clock_gettime (CLOCK_MONOTONIC, &t1) ;
+
+  ++s->transactions ;
+  s->busTime_us += (unsigned long long)(t1.tv_sec - t0->tv_sec) * 1000000ULL + (t1.tv_nsec - t0->tv_nsec) / 1000 ;
+  if (result < 0)
+    ++s->errors ;
+  else
+    s->bytes += bytes ;
+}
+
+// Payload bytes on the wire for an SMBus operation of the given size code
+
+static int i2c_smbus_bytes (int size, const union i2c_smbus_data *data)
+{
+  switch (size)
+  {
+    case I2C_SMBUS_BYTE:	return 1 ;
+    case I2C_SMBUS_BYTE_DATA:	return 2 ;
+    case I2C_SMBUS_WORD_DATA:	return 3 ;
+    case I2C_SMBUS_BLOCK_DATA:
+    case I2C_SMBUS_I2C_BLOCK_DATA:
+				return data ? (1 + data->block [0]) : 1 ;
+    default:			return 0 ;
+  }
+}
+
+/*
+ * The stuck-bus circuit breaker:
+ *	A slave that hangs SDA mid-transaction makes every subsequent
+ *	ioctl on that bus burn the full kernel transfer timeout (about a
+ *	second) before failing, so one dead sensor turns a polling loop
+ *	into a cascade of multi-second stalls - and since the breaker is
+ *	per bus fd, devices on healthy buses are never delayed by it.
+ *	A few consecutive timeout-class errors trip the breaker; while
+ *	it's open every call on that fd fails immediately with ETIMEDOUT
+ *	instead of touching the kernel. After a cool-down one caller gets
+ *	through to probe, recovering the bus on the way in - the standard
+ *	fix of clocking SCL by hand until the slave releases SDA, then
+ *	issuing a STOP - and one good transaction closes the breaker.
+ *	Only timeout and arbitration errors count: a NAK is a healthy bus
+ *	saying no.
+ *********************************************************************************
+ */
+
+#define	I2C_BREAKER_SIZE	16
+#define	I2C_BREAKER_TRIP	3	// Consecutive timeout-class errors to open
+#define	I2C_BREAKER_RETRY_MS	500	// Cool-down between recovery attempts
+
+struct i2cBusBreaker
+{
+  int fd ;			// -1: slot free
+  int errors ;			// Consecutive timeout-class errors
+  int open ;			// TRUE: failing fast
+  unsigned long long retryAt_ms ;
+  int sdaPin, sclPin ;		// BCM_GPIO; -1: no recovery pulses for this bus
+  unsigned int recoveries ;
+} ;
+
+static struct i2cBusBreaker i2cBreakers [I2C_BREAKER_SIZE] =
+  { [0 ... I2C_BREAKER_SIZE - 1] = { .fd = -1, .sdaPin = -1, .sclPin = -1 } } ;
+static pthread_mutex_t i2cBreakerLock = PTHREAD_MUTEX_INITIALIZER ;
+
+extern int ToBCMPin (int *pin) ;		// From wiringPi.c
+extern int wiringPiDebug ;
+
+static int i2cFdCacheDevId (int fd) ;		// The fd cache lives further down
+
+static unsigned long long i2cNowMs (void)
+{
+  struct timespec now ;
+
+  clock_gettime (CLOCK_MONOTONIC, &now) ;
+  return (unsigned long long)now.tv_sec * 1000ULL + now.tv_nsec / 1000000 ;
+}
+
+// Find (optionally claim) the breaker slot for a bus fd. Call with the
+//	lock held.
+
+static struct i2cBusBreaker *i2cBreakerFind (int fd, int create)
+{
+  int slot, free = -1 ;
+
+  for (slot = 0 ; slot < I2C_BREAKER_SIZE ; ++slot)
+    if (i2cBreakers [slot].fd == fd)
+      return &i2cBreakers [slot] ;
+    else if ((i2cBreakers [slot].fd == -1) && (free < 0))
+      free = slot ;
+
+  if (!create || (free < 0))
+    return NULL ;
+
+  i2cBreakers [free].fd         = fd ;
+  i2cBreakers [free].errors     = 0 ;
+  i2cBreakers [free].open       = FALSE ;
+  i2cBreakers [free].sdaPin     = -1 ;
+  i2cBreakers [free].sclPin     = -1 ;
+  i2cBreakers [free].recoveries = 0 ;
+  return &i2cBreakers [free] ;
+}
+
+// i2cPinFromBcm:
+//	The core pin functions take numbers in the current wiringPi mode
+//	but the recovery pins are kept as BCM_GPIO, so search the
+//	translation for a match. In GPIO mode the loop finds the pin at
+//	its own index; in a device mode there's no translation and
+//	recovery skips the pulse train.
+
+static int i2cPinFromBcm (int bcm)
+{
+  int pin, t ;
+
+  for (pin = 0 ; pin < 64 ; ++pin)
+  {
+    t = pin ;
+    if (ToBCMPin (&t) && (t == bcm))
+      return pin ;
+  }
+  return -1 ;
+}
+
+// i2cBusUnstick:
+//	Manual bus recovery as the I2C spec prescribes: take SCL as a
+//	GPIO output, clock it until the slave releases SDA (at most nine
+//	pulses - the furthest a slave can be into a byte), generate a
+//	STOP, then hand both pins back to the I2C controller.
+
+static void i2cBusUnstick (int sdaBcm, int sclBcm)
+{
+  int sda, scl, sdaAlt, sclAlt, i ;
+
+  if (((sda = i2cPinFromBcm (sdaBcm)) < 0) || ((scl = i2cPinFromBcm (sclBcm)) < 0))
+    return ;
+
+  sdaAlt = getAlt (sda) ;
+  sclAlt = getAlt (scl) ;
+
+  digitalWrite (scl, HIGH) ;	// Preset the output latch before taking the pin
+  pinMode (scl, OUTPUT) ;
+  pinMode (sda, INPUT) ;	// Watch SDA - the pull-up raises it once released
+
+  for (i = 0 ; (i < 9) && (digitalRead (sda) == LOW) ; ++i)
+  {
+    digitalWrite (scl, LOW) ;
+    delayMicroseconds (5) ;
+    digitalWrite (scl, HIGH) ;
+    delayMicroseconds (5) ;
+  }
+
+  digitalWrite (sda, LOW) ;	// STOP: SDA low to high while SCL is high
+  pinMode (sda, OUTPUT) ;
+  delayMicroseconds (5) ;
+  digitalWrite (sda, HIGH) ;
+  delayMicroseconds (5) ;
+
+  pinModeAlt (sda, sdaAlt) ;
+  pinModeAlt (scl, sclAlt) ;
+}
+
+// Breaker gate around one bus operation: fail fast while the breaker is
+//	open, except that one caller per cool-down is let through to
+//	probe, recovering the bus first.
+
+static int i2cBreakerPass (int fd)
+{
+  struct i2cBusBreaker *b ;
+  unsigned long long now ;
+
+  pthread_mutex_lock (&i2cBreakerLock) ;
+  if (((b = i2cBreakerFind (fd, FALSE)) == NULL) || !b->open)
+  {
+    pthread_mutex_unlock (&i2cBreakerLock) ;
+    return 0 ;
+  }
+
+  now = i2cNowMs () ;
+  if (now < b->retryAt_ms)
+  {
+    pthread_mutex_unlock (&i2cBreakerLock) ;
+    errno = ETIMEDOUT ;
+    return -1 ;
+  }
+
+  b->retryAt_ms = now + I2C_BREAKER_RETRY_MS ;	// We probe; others keep failing fast
+  pthread_mutex_unlock (&i2cBreakerLock) ;
+
+  (void)wiringPiI2CRecoverBus (fd) ;
+  return 0 ;
+}
+
+// Count a result against the breaker. NAKs (ENXIO/EREMOTEIO) don't
+//	count - they're the bus working - and a success resets everything.
+
+static void i2cBreakerCount (int fd, int result)
+{
+  struct i2cBusBreaker *b ;
+
+  if ((result < 0) && (errno != ETIMEDOUT) && (errno != ETIME) &&
+      (errno != EAGAIN) && (errno != EBUSY))
+    return ;
+
+  pthread_mutex_lock (&i2cBreakerLock) ;
+  if ((b = i2cBreakerFind (fd, result < 0)) != NULL)
+  {
+    if (result >= 0)
+    {
+      b->errors = 0 ;
+      b->open   = FALSE ;
+    }
+    else if (++b->errors >= I2C_BREAKER_TRIP)
+    {
+      b->open       = TRUE ;
+      b->retryAt_ms = i2cNowMs () + I2C_BREAKER_RETRY_MS ;
+    }
+  }
+  pthread_mutex_unlock (&i2cBreakerLock) ;
+}
+
+// Release the breaker slot when its fd closes - fd numbers get reused
+
+static void i2cBreakerDrop (int fd)
+{
+  struct i2cBusBreaker *b ;
+
+  pthread_mutex_lock (&i2cBreakerLock) ;
+  if ((b = i2cBreakerFind (fd, FALSE)) != NULL)
+    b->fd = -1 ;
+  pthread_mutex_unlock (&i2cBreakerLock) ;
+}
+
 static inline int i2c_smbus_access (int fd, char rw, uint8_t command, int size, union i2c_smbus_data *data)
 {
   struct i2c_smbus_ioctl_data args ;
+  struct timespec t0 ;
+  int result ;
+
+  if (i2cBreakerPass (fd) != 0)
+    return -1 ;
 
   args.read_write = rw ;
   args.command    = command ;
   args.size       = size ;
   args.data       = data ;
-  return ioctl (fd, I2C_SMBUS, &args) ;
+  WPI_TRACE (WPI_TRACE_I2C, fd, command) ;
+  i2cStatsBegin (&t0) ;
+  result = ioctl (fd, I2C_SMBUS, &args) ;
+  i2cBreakerCount (fd, result) ;
+  i2cStatsEnd (fd, i2c_smbus_bytes (size, data), result, &t0) ;
+  return result ;
 }
 
 
@@ -172,7 +435,17 @@ int wiringPiI2CReadBlockData (int fd, int reg, uint8_t *values, uint8_t size)
 
 int wiringPiI2CRawRead (int fd, uint8_t *values, uint8_t size)
 {
-  return(read(fd, values, size));
+  struct timespec t0 ;
+  int result ;
+
+  if (i2cBreakerPass (fd) != 0)
+    return -1 ;
+
+  i2cStatsBegin (&t0) ;
+  result = read (fd, values, size) ;
+  i2cBreakerCount (fd, result) ;
+  i2cStatsEnd (fd, size, result, &t0) ;
+  return result ;
 }
 
 /*
@@ -223,9 +496,405 @@ int wiringPiI2CWriteBlockData (int fd, int reg, const uint8_t *values, uint8_t s
 
 int wiringPiI2CRawWrite (int fd, const uint8_t *values, uint8_t size)
 {
-  return(write(fd, values, size));
+  struct timespec t0 ;
+  int result ;
+
+  if (i2cBreakerPass (fd) != 0)
+    return -1 ;
+
+  i2cStatsBegin (&t0) ;
+  result = write (fd, values, size) ;
+  i2cBreakerCount (fd, result) ;
+  i2cStatsEnd (fd, size, result, &t0) ;
+  return result ;
+}
+
+
+/*
+ * wiringPiI2CTransfer:
+ *	Execute a chain of message segments as one combined transfer -
+ *	the segments are joined by repeated starts, with a single stop at
+ *	the end. The classic use is write-register + read-data in one bus
+ *	transaction (and one syscall) instead of two. Returns the number
+ *	of segments transferred, or -1 on error.
+ *********************************************************************************
+ */
+
+struct i2c_rdwr_ioctl_data
+{
+  struct wiringPiI2CMsg *msgs ;
+  uint32_t nmsgs ;
+} ;
+
+int wiringPiI2CTransfer (int fd, struct wiringPiI2CMsg *msgs, int nmsgs)
+{
+  struct i2c_rdwr_ioctl_data rdwr ;
+  struct timespec t0 ;
+  int i, nBytes, result ;
+
+  if ((nmsgs < 1) || (nmsgs > I2C_RDWR_IOCTL_MAX_MSGS))
+    return -1 ;
+
+  if (i2cBreakerPass (fd) != 0)
+    return -1 ;
+
+  rdwr.msgs  = msgs ;
+  rdwr.nmsgs = nmsgs ;
+
+  nBytes = 0 ;
+  for (i = 0 ; i < nmsgs ; ++i)
+    nBytes += msgs [i].len ;
+
+  WPI_TRACE (WPI_TRACE_I2C, fd, nmsgs) ;
+  i2cStatsBegin (&t0) ;
+  result = ioctl (fd, I2C_RDWR, &rdwr) ;
+  i2cBreakerCount (fd, result) ;
+  i2cStatsEnd (fd, nBytes, result, &t0) ;
+  return result ;
 }
 
+/*
+ * The asynchronous layer:
+ *	A worker thread per bus fd executes queued transfers in order and
+ *	calls the completion function from the worker, so transfers to
+ *	different buses overlap and the submitting thread never blocks on
+ *	the bus. A control loop reading several sensors submits them all,
+ *	then picks up the results in its callbacks.
+ *********************************************************************************
+ */
+
+#define	I2C_ASYNC_QUEUE_SIZE	64
+#define	I2C_ASYNC_MAX_BUSES	8
+
+#define	I2C_ASYNC_READ8		0
+#define	I2C_ASYNC_WRITE8	1
+#define	I2C_ASYNC_READ16	2
+#define	I2C_ASYNC_WRITE16	3
+#define	I2C_ASYNC_TRANSFER	4
+
+struct i2cAsyncRequest
+{
+  int op ;
+  int reg ;
+  int value ;
+  struct wiringPiI2CMsg *msgs ;
+  int nmsgs ;
+  wiringPiI2CCompletion complete ;
+  void *userdata ;
+} ;
+
+struct i2cAsyncBus
+{
+  int fd ;			// -1: slot free
+  int busy ;			// worker is executing a request
+  pthread_t thread ;
+  pthread_mutex_t lock ;
+  pthread_cond_t  submitted ;
+  pthread_cond_t  drained ;
+  struct i2cAsyncRequest queue [I2C_ASYNC_QUEUE_SIZE] ;
+  int head, tail, count ;
+} ;
+
+static struct i2cAsyncBus i2cAsyncBuses [I2C_ASYNC_MAX_BUSES] =
+  { [0 ... I2C_ASYNC_MAX_BUSES - 1] = { .fd = -1 } } ;
+
+static pthread_mutex_t i2cAsyncSetupLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static void *i2cAsyncWorker (void *arg)
+{
+  struct i2cAsyncBus *bus = (struct i2cAsyncBus *)arg ;
+  struct i2cAsyncRequest req ;
+  int result ;
+
+  for (;;)
+  {
+    pthread_mutex_lock (&bus->lock) ;
+    while (bus->count == 0)
+      pthread_cond_wait (&bus->submitted, &bus->lock) ;
+    req = bus->queue [bus->head] ;
+    bus->head = (bus->head + 1) % I2C_ASYNC_QUEUE_SIZE ;
+    --bus->count ;
+    bus->busy = TRUE ;
+    pthread_mutex_unlock (&bus->lock) ;
+
+    switch (req.op)
+    {
+      case I2C_ASYNC_READ8:    result = wiringPiI2CReadReg8   (bus->fd, req.reg) ;		break ;
+      case I2C_ASYNC_WRITE8:   result = wiringPiI2CWriteReg8  (bus->fd, req.reg, req.value) ;	break ;
+      case I2C_ASYNC_READ16:   result = wiringPiI2CReadReg16  (bus->fd, req.reg) ;		break ;
+      case I2C_ASYNC_WRITE16:  result = wiringPiI2CWriteReg16 (bus->fd, req.reg, req.value) ;	break ;
+      case I2C_ASYNC_TRANSFER: result = wiringPiI2CTransfer   (bus->fd, req.msgs, req.nmsgs) ;	break ;
+      default:                 result = -1 ;							break ;
+    }
+
+    if (req.complete != NULL)
+      req.complete (result, req.userdata) ;
+
+    pthread_mutex_lock (&bus->lock) ;
+    bus->busy = FALSE ;
+    if (bus->count == 0)
+      pthread_cond_broadcast (&bus->drained) ;
+    pthread_mutex_unlock (&bus->lock) ;
+  }
+
+  return NULL ;
+}
+
+static struct i2cAsyncBus *i2cAsyncFindBus (int fd)
+{
+  struct i2cAsyncBus *bus = NULL ;
+  int slot ;
+
+  pthread_mutex_lock (&i2cAsyncSetupLock) ;
+
+  for (slot = 0 ; slot < I2C_ASYNC_MAX_BUSES ; ++slot)
+    if (i2cAsyncBuses [slot].fd == fd)
+    {
+      pthread_mutex_unlock (&i2cAsyncSetupLock) ;
+      return &i2cAsyncBuses [slot] ;
+    }
+
+  for (slot = 0 ; slot < I2C_ASYNC_MAX_BUSES ; ++slot)
+    if (i2cAsyncBuses [slot].fd == -1)
+    {
+      bus = &i2cAsyncBuses [slot] ;
+      break ;
+    }
+
+  if (bus == NULL)
+  {
+    pthread_mutex_unlock (&i2cAsyncSetupLock) ;
+    return NULL ;
+  }
+
+  bus->fd    = fd ;
+  bus->busy  = FALSE ;
+  bus->head  = bus->tail = bus->count = 0 ;
+  pthread_mutex_init (&bus->lock, NULL) ;
+  pthread_cond_init  (&bus->submitted, NULL) ;
+  pthread_cond_init  (&bus->drained, NULL) ;
+
+  if (pthread_create (&bus->thread, NULL, i2cAsyncWorker, bus) != 0)
+  {
+    bus->fd = -1 ;
+    bus = NULL ;
+  }
+
+  pthread_mutex_unlock (&i2cAsyncSetupLock) ;
+  return bus ;
+}
+
+static int i2cAsyncSubmit (int fd, const struct i2cAsyncRequest *req)
+{
+  struct i2cAsyncBus *bus ;
+
+  if ((bus = i2cAsyncFindBus (fd)) == NULL)
+    return -1 ;
+
+  pthread_mutex_lock (&bus->lock) ;
+  if (bus->count == I2C_ASYNC_QUEUE_SIZE)
+  {
+    pthread_mutex_unlock (&bus->lock) ;
+    return -1 ;			// Queue full - submit later or flush
+  }
+  bus->queue [bus->tail] = *req ;
+  bus->tail = (bus->tail + 1) % I2C_ASYNC_QUEUE_SIZE ;
+  ++bus->count ;
+  pthread_cond_signal (&bus->submitted) ;
+  pthread_mutex_unlock (&bus->lock) ;
+
+  return 0 ;
+}
+
+
+/*
+ * wiringPiI2CAsyncReadReg8: wiringPiI2CAsyncWriteReg8: (and 16-bit forms)
+ * wiringPiI2CAsyncTransfer:
+ *	Queue a transfer on the bus worker. The completion function gets
+ *	the same result the synchronous call would have returned. Returns
+ *	0 once queued, -1 if the queue is full or no worker is available.
+ *********************************************************************************
+ */
+
+int wiringPiI2CAsyncReadReg8 (int fd, int reg, wiringPiI2CCompletion complete, void *userdata)
+{
+  struct i2cAsyncRequest req = { .op = I2C_ASYNC_READ8, .reg = reg, .complete = complete, .userdata = userdata } ;
+  return i2cAsyncSubmit (fd, &req) ;
+}
+
+int wiringPiI2CAsyncWriteReg8 (int fd, int reg, int value, wiringPiI2CCompletion complete, void *userdata)
+{
+  struct i2cAsyncRequest req = { .op = I2C_ASYNC_WRITE8, .reg = reg, .value = value, .complete = complete, .userdata = userdata } ;
+  return i2cAsyncSubmit (fd, &req) ;
+}
+
+int wiringPiI2CAsyncReadReg16 (int fd, int reg, wiringPiI2CCompletion complete, void *userdata)
+{
+  struct i2cAsyncRequest req = { .op = I2C_ASYNC_READ16, .reg = reg, .complete = complete, .userdata = userdata } ;
+  return i2cAsyncSubmit (fd, &req) ;
+}
+
+int wiringPiI2CAsyncWriteReg16 (int fd, int reg, int value, wiringPiI2CCompletion complete, void *userdata)
+{
+  struct i2cAsyncRequest req = { .op = I2C_ASYNC_WRITE16, .reg = reg, .value = value, .complete = complete, .userdata = userdata } ;
+  return i2cAsyncSubmit (fd, &req) ;
+}
+
+int wiringPiI2CAsyncTransfer (int fd, struct wiringPiI2CMsg *msgs, int nmsgs, wiringPiI2CCompletion complete, void *userdata)
+{
+  struct i2cAsyncRequest req = { .op = I2C_ASYNC_TRANSFER, .msgs = msgs, .nmsgs = nmsgs, .complete = complete, .userdata = userdata } ;
+  return i2cAsyncSubmit (fd, &req) ;			// msgs must stay valid until completion
+}
+
+
+/*
+ * wiringPiI2CAsyncFlush:
+ *	Wait until everything queued on this bus has completed.
+ *********************************************************************************
+ */
+
+int wiringPiI2CAsyncFlush (int fd)
+{
+  struct i2cAsyncBus *bus ;
+
+  if ((bus = i2cAsyncFindBus (fd)) == NULL)
+    return -1 ;
+
+  pthread_mutex_lock (&bus->lock) ;
+  while ((bus->count != 0) || bus->busy)
+    pthread_cond_wait (&bus->drained, &bus->lock) ;
+  pthread_mutex_unlock (&bus->lock) ;
+
+  return 0 ;
+}
+
+
+/*
+ * wiringPiI2CStats:
+ *	Snapshot the transaction counters for a bus fd. Returns -1 when
+ *	nothing has been counted for it yet.
+ *********************************************************************************
+ */
+
+int wiringPiI2CStats (int fd, struct WPIBusStats *stats)
+{
+  struct WPIBusStats *s = wiringPiBusStatsSlot (WPI_BUS_STATS_I2C, fd) ;
+
+  if ((s == NULL) || (stats == NULL))
+    return -1 ;
+
+  *stats = *s ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiI2CSetRecovery:
+ *	Name the SDA/SCL pins (BCM_GPIO numbering) behind an I2C fd so
+ *	stuck-bus recovery can pulse the bus free. The Pi's own buses 0
+ *	and 1 come preconfigured; call this for a bus behind a mux or on
+ *	other pins. Without pins the breaker still fails fast, it just
+ *	can't unstick the bus itself.
+ *	Interface V3.17
+ *********************************************************************************
+ */
+
+int wiringPiI2CSetRecovery (int fd, int sdaPin, int sclPin)
+{
+  struct i2cBusBreaker *b ;
+
+  pthread_mutex_lock (&i2cBreakerLock) ;
+  if ((b = i2cBreakerFind (fd, TRUE)) == NULL)
+  {
+    pthread_mutex_unlock (&i2cBreakerLock) ;
+    return -1 ;
+  }
+  b->sdaPin = sdaPin ;
+  b->sclPin = sclPin ;
+  pthread_mutex_unlock (&i2cBreakerLock) ;
+
+  return 0 ;
+}
+
+
+/*
+ * wiringPiI2CRecoverBus:
+ *	Kick the bus behind this fd: pulse SCL free and issue a STOP
+ *	(when the bus pins are known), then re-select the slave address
+ *	so the fd is good to go again. The circuit breaker calls this
+ *	automatically on its half-open probes; call it directly after an
+ *	external upset. Returns -1 for an fd the breaker has never seen.
+ *	Interface V3.17
+ *********************************************************************************
+ */
+
+int wiringPiI2CRecoverBus (int fd)
+{
+  struct i2cBusBreaker *b ;
+  int sda, scl, devId ;
+
+  pthread_mutex_lock (&i2cBreakerLock) ;
+  if ((b = i2cBreakerFind (fd, FALSE)) == NULL)
+  {
+    pthread_mutex_unlock (&i2cBreakerLock) ;
+    return -1 ;
+  }
+  sda = b->sdaPin ;
+  scl = b->sclPin ;
+  ++b->recoveries ;
+  pthread_mutex_unlock (&i2cBreakerLock) ;
+
+  if ((sda >= 0) && (scl >= 0))
+    i2cBusUnstick (sda, scl) ;
+
+  if ((devId = i2cFdCacheDevId (fd)) >= 0)	// Reinitialise the fd
+    (void)ioctl (fd, I2C_SLAVE, devId) ;
+
+  if (wiringPiDebug)
+    printf ("wiringPiI2C: bus recovery on fd %d\n", fd) ;
+
+  return 0 ;
+}
+
+
+// The fd cache - several device drivers opening the same (device, address)
+//	pair share one refcounted fd rather than each paying an open() and
+//	an I2C_SLAVE ioctl. Entries with refs == 0 are free. Opens that
+//	don't fit the table still work, they're just not shared.
+
+#define I2C_FD_CACHE_SIZE	64
+
+struct i2cFdCacheEntry
+{
+  char device [32] ;
+  int devId ;
+  int fd ;
+  int refs ;
+} ;
+
+static struct i2cFdCacheEntry i2cFdCache [I2C_FD_CACHE_SIZE] ;
+static pthread_mutex_t i2cFdCacheLock = PTHREAD_MUTEX_INITIALIZER ;
+
+// Look the slave address back up from the fd - bus recovery re-selects
+//	it after unsticking the bus. -1 for an uncached fd.
+
+static int i2cFdCacheDevId (int fd)
+{
+  int slot, devId = -1 ;
+
+  pthread_mutex_lock (&i2cFdCacheLock) ;
+  for (slot = 0 ; slot < I2C_FD_CACHE_SIZE ; ++slot)
+    if ((i2cFdCache [slot].refs > 0) && (i2cFdCache [slot].fd == fd))
+    {
+      devId = i2cFdCache [slot].devId ;
+      break ;
+    }
+  pthread_mutex_unlock (&i2cFdCacheLock) ;
+
+  return devId ;
+}
+
+
 /*
  * wiringPiI2CSetupInterface:
  *	Undocumented access to set the interface explicitly - might be used
@@ -235,18 +904,100 @@ int wiringPiI2CRawWrite (int fd, const uint8_t *values, uint8_t size)
 
 int wiringPiI2CSetupInterface (const char *device, int devId)
 {
-  int fd ;
+  struct i2cBusBreaker *b ;
+  int fd, slot, free, busNum ;
+
+  pthread_mutex_lock (&i2cFdCacheLock) ;
+  free = -1 ;
+  for (slot = 0 ; slot < I2C_FD_CACHE_SIZE ; ++slot)
+    if (i2cFdCache [slot].refs == 0)
+    {
+      if (free < 0)
+	free = slot ;
+    }
+    else if ((i2cFdCache [slot].devId == devId) && (strcmp (i2cFdCache [slot].device, device) == 0))
+    {
+      ++i2cFdCache [slot].refs ;
+      fd = i2cFdCache [slot].fd ;
+      pthread_mutex_unlock (&i2cFdCacheLock) ;
+      return fd ;
+    }
 
   if ((fd = open (device, O_RDWR)) < 0)
+  {
+    pthread_mutex_unlock (&i2cFdCacheLock) ;
     return wiringPiFailure (WPI_ALMOST, "Unable to open I2C device: %s\n", strerror (errno)) ;
+  }
 
   if (ioctl (fd, I2C_SLAVE, devId) < 0)
+  {
+    pthread_mutex_unlock (&i2cFdCacheLock) ;
     return wiringPiFailure (WPI_ALMOST, "Unable to select I2C device: %s\n", strerror (errno)) ;
+  }
+
+  if ((free >= 0) && (strlen (device) < sizeof (i2cFdCache [free].device)))
+  {
+    strcpy (i2cFdCache [free].device, device) ;
+    i2cFdCache [free].devId = devId ;
+    i2cFdCache [free].fd    = fd ;
+    i2cFdCache [free].refs  = 1 ;
+  }
+  pthread_mutex_unlock (&i2cFdCacheLock) ;
+
+// Seed the circuit breaker for this fd. The Pi's own buses have known
+//	pins, so recovery can pulse SCL straight away; anything else
+//	needs wiringPiI2CSetRecovery() to name them.
+
+  busNum = -1 ;
+  (void)sscanf (device, "/dev/i2c-%d", &busNum) ;
+
+  pthread_mutex_lock (&i2cBreakerLock) ;
+  if (((b = i2cBreakerFind (fd, TRUE)) != NULL) && (b->sdaPin < 0))
+    switch (busNum)
+    {
+      case 0:	b->sdaPin = 0 ; b->sclPin = 1 ; break ;
+      case 1:	b->sdaPin = 2 ; b->sclPin = 3 ; break ;
+      default:					break ;
+    }
+  pthread_mutex_unlock (&i2cBreakerLock) ;
 
   return fd ;
 }
 
 
+/*
+ * wiringPiI2CClose:
+ *	Drop one reference on an fd from wiringPiI2CSetup/SetupInterface,
+ *	closing the device once the last user is gone. Flush any pending
+ *	asynchronous work (wiringPiI2CAsyncFlush) before the final close.
+ *********************************************************************************
+ */
+
+int wiringPiI2CClose (int fd)
+{
+  int slot ;
+
+  if (fd < 0)
+    return -1 ;
+
+  pthread_mutex_lock (&i2cFdCacheLock) ;
+  for (slot = 0 ; slot < I2C_FD_CACHE_SIZE ; ++slot)
+    if ((i2cFdCache [slot].refs > 0) && (i2cFdCache [slot].fd == fd))
+    {
+      if (--i2cFdCache [slot].refs > 0)
+      {
+	pthread_mutex_unlock (&i2cFdCacheLock) ;
+	return 0 ;
+      }
+      break ;
+    }
+  pthread_mutex_unlock (&i2cFdCacheLock) ;
+
+  i2cBreakerDrop (fd) ;
+  return close (fd) ;
+}
+
+
 /*
  * wiringPiI2CSetup:
  *	Open the I2C device, and regsiter the target device
@@ -267,3 +1018,57 @@ int wiringPiI2CSetup (const int devId)
 
   return wiringPiI2CSetupInterface (device, devId) ;
 }
+
+
+/*
+ * wiringPiI2CScan:
+ *	Probe every valid address on one bus and return how many devices
+ *	answered, filling addrs[] (when given) with the addresses found.
+ *	The probes are SMBus quick-writes - except the EEPROM and 0x30
+ *	ranges, which get a byte read like i2cdetect does, as a quick
+ *	write can corrupt some EEPROMs - with retries off and the bus
+ *	timeout wound down to one tick, so a whole bus takes milliseconds
+ *	rather than the seconds a stuck device costs i2cdetect. Addresses
+ *	claimed by a kernel driver can't be probed and aren't counted.
+ *	Returns -1 when the bus can't be opened.
+ *********************************************************************************
+ */
+
+int wiringPiI2CScan (const int busNum, int *addrs, int maxAddrs)
+{
+  char device [32] ;
+  union i2c_smbus_data data ;
+  int fd, addr, result, found = 0 ;
+
+  snprintf (device, 32, "/dev/i2c-%d", busNum) ;
+  if ((fd = open (device, O_RDWR)) < 0)
+    return -1 ;
+
+// Fail fast: no retries, shortest transfer timeout the kernel allows
+
+  ioctl (fd, I2C_RETRIES, 0UL) ;
+  ioctl (fd, I2C_TIMEOUT, 1UL) ;
+
+  for (addr = 0x03 ; addr <= 0x77 ; ++addr)
+  {
+    if (ioctl (fd, I2C_SLAVE, addr) < 0)	// busy: owned by a kernel driver
+      continue ;
+
+    if (((addr >= 0x30) && (addr <= 0x37)) || ((addr >= 0x50) && (addr <= 0x5F)))
+      result = i2c_smbus_access (fd, I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &data) ;
+    else
+      result = i2c_smbus_access (fd, I2C_SMBUS_WRITE, 0, I2C_SMBUS_QUICK, NULL) ;
+
+    if (result >= 0)
+    {
+      if ((addrs != NULL) && (found < maxAddrs))
+	addrs [found] = addr ;
+      ++found ;
+    }
+  }
+
+  i2cBreakerDrop (fd) ;	// The shortened timeout will have counted as errors
+  close (fd) ;
+
+  return found ;
+}
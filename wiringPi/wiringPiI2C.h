@@ -24,6 +24,30 @@
 
 #include <stdint.h>
 
+// wiringPiI2CMsg:
+//	One segment of a combined transfer - same layout as the kernel's
+//	struct i2c_msg, defined here so users don't need the GPL'd kernel
+//	headers. Segments in one wiringPiI2CTransfer() call are joined by
+//	repeated starts rather than stop/start, so a register read is a
+//	single bus transaction.
+//	Interface V3.17
+
+struct wiringPiI2CMsg
+{
+  uint16_t addr ;	// slave address
+  uint16_t flags ;	// 0 = write, WPI_I2C_M_RD = read
+  uint16_t len ;	// bytes in buf
+  uint8_t *buf ;
+} ;
+
+#define	WPI_I2C_M_RD	0x0001
+
+// Completion function for the asynchronous calls - runs on the bus worker
+//	thread with the result the synchronous call would have returned.
+//	Interface V3.17
+
+typedef void (*wiringPiI2CCompletion) (int result, void *userdata) ;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -40,8 +64,26 @@ extern int wiringPiI2CWriteReg16     (int fd, int reg, int data) ;
 extern int wiringPiI2CWriteBlockData (int fd, int reg, const uint8_t *values, uint8_t size);  //Interface 3.3
 extern int wiringPiI2CRawWrite       (int fd, const uint8_t *values, uint8_t size);           //Interface 3.3
 
+extern int wiringPiI2CTransfer       (int fd, struct wiringPiI2CMsg *msgs, int nmsgs);        //Interface 3.17
+
+extern int wiringPiI2CAsyncReadReg8   (int fd, int reg, wiringPiI2CCompletion complete, void *userdata);             //Interface 3.17
+extern int wiringPiI2CAsyncWriteReg8  (int fd, int reg, int value, wiringPiI2CCompletion complete, void *userdata);  //Interface 3.17
+extern int wiringPiI2CAsyncReadReg16  (int fd, int reg, wiringPiI2CCompletion complete, void *userdata);             //Interface 3.17
+extern int wiringPiI2CAsyncWriteReg16 (int fd, int reg, int value, wiringPiI2CCompletion complete, void *userdata);  //Interface 3.17
+extern int wiringPiI2CAsyncTransfer   (int fd, struct wiringPiI2CMsg *msgs, int nmsgs, wiringPiI2CCompletion complete, void *userdata); //Interface 3.17
+extern int wiringPiI2CAsyncFlush      (int fd);                                               //Interface 3.17
+
+struct WPIBusStats ;    // see wiringPi.h
+extern int wiringPiI2CStats           (int fd, struct WPIBusStats *stats);                    //Interface 3.17
+
+extern int wiringPiI2CScan           (const int busNum, int *addrs, int maxAddrs) ;            //Interface 3.17 - fast probe of one bus
+
+extern int wiringPiI2CSetRecovery    (int fd, int sdaPin, int sclPin);                        //Interface 3.17 - BCM_GPIO pins for stuck-bus recovery
+extern int wiringPiI2CRecoverBus     (int fd);                                                //Interface 3.17 - pulse a stuck bus free, re-select the slave
+
 extern int wiringPiI2CSetupInterface (const char *device, int devId) ;
 extern int wiringPiI2CSetup          (const int devId) ;
+extern int wiringPiI2CClose          (int fd) ;                                               //Interface 3.17
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,76 @@
+/*
+ * wiringPiInline.h:
+ *	Static-inline fast paths for register-level GPIO access.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+// Even a well-predicted library call costs ~10ns of PLT indirection per
+// pin operation, which is real money at bit-bang rates. These inlines
+// work on a struct wiringPiPinHandle resolved once by wiringPiOpenPin(),
+// so a write compiles down to a single store into the mapped register
+// block - no call at all. The pin must already be in the right mode and
+// the usual rules apply: handles are only valid in the memory-mapped
+// setup modes, on on-board pins.
+//
+// The raw block base pointers (_wiringPiGpio, _wiringPiRio and friends
+// in wiringPi.h) remain available for code that wants to go further
+// down still.
+//	Interface 3.17
+
+#ifndef	__WIRING_PI_INLINE_H__
+#define	__WIRING_PI_INLINE_H__
+
+#include <stddef.h>
+
+#include "wiringPi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void wpiFastWrite (const struct wiringPiPinHandle *pin, int value)
+{
+  if (value == LOW)
+    *pin->clrReg = pin->mask ;
+  else
+    *pin->setReg = pin->mask ;
+}
+
+static inline int wpiFastRead (const struct wiringPiPinHandle *pin)
+{
+  return ((*pin->levReg & pin->mask) != 0) ? HIGH : LOW ;
+}
+
+static inline void wpiFastToggle (const struct wiringPiPinHandle *pin)
+{
+  if (pin->xorReg != NULL)		// RP1: one store into the XOR alias
+    *pin->xorReg = pin->mask ;
+  else if ((*pin->levReg & pin->mask) != 0)
+    *pin->clrReg = pin->mask ;
+  else
+    *pin->setReg = pin->mask ;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
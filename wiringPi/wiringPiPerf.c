@@ -0,0 +1,240 @@
+/*
+ * wiringPiPerf.c:
+ *	Hardware performance-counter access for profiling the hot paths.
+ *
+ *	micros() is fine for millisecond work but its own overhead swamps
+ *	sub-microsecond effects, so per-call costs of things like
+ *	digitalWrite can't be measured with it. This wraps
+ *	perf_event_open: one handle is a group of PMU counters (cycles,
+ *	instructions, cache misses) pinned to the calling thread, read in
+ *	a single syscall. On AArch64 the architected counter-timer is
+ *	also readable directly from userspace, which gives a timestamp in
+ *	a few cycles for the really short intervals.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "wiringPi.h"
+#include "wiringPiPerf.h"
+
+#define	MAX_PERF_GROUPS		4
+#define	PERF_NUM_COUNTERS	3	// cycles, instructions, cache misses
+
+struct wpiPerfGroup
+{
+  int inUse ;
+  int fds  [PERF_NUM_COUNTERS] ;	// fds [0] is the group leader
+  int have [PERF_NUM_COUNTERS] ;
+} ;
+
+static struct wpiPerfGroup perfGroups [MAX_PERF_GROUPS] ;
+static pthread_mutex_t perfLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static int perfEventOpen (struct perf_event_attr *attr, pid_t pid, int cpu, int groupFd, unsigned long flags)
+{
+  return syscall (__NR_perf_event_open, attr, pid, cpu, groupFd, flags) ;
+}
+
+
+/*
+ * wpiPerfOpen:
+ *	Open a counter group on the calling thread and start it counting.
+ *	Counting the kernel too needs perf_event_paranoid <= 1; when that
+ *	is refused the counters are opened user-only instead, which still
+ *	covers the gpiomem fast paths. Returns the handle, or -1 when no
+ *	PMU access is permitted at all.
+ *********************************************************************************
+ */
+
+int wpiPerfOpen (void)
+{
+  static const uint64_t configs [PERF_NUM_COUNTERS] =
+    { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES } ;
+  struct wpiPerfGroup *g = NULL ;
+  struct perf_event_attr attr ;
+  int handle, i, fd, userOnly = FALSE ;
+
+  pthread_mutex_lock (&perfLock) ;
+  for (handle = 0 ; handle < MAX_PERF_GROUPS ; ++handle)
+    if (!perfGroups [handle].inUse)
+    {
+      g = &perfGroups [handle] ;
+      g->inUse = TRUE ;
+      break ;
+    }
+  pthread_mutex_unlock (&perfLock) ;
+
+  if (g == NULL)
+    return -1 ;
+
+  for (i = 0 ; i < PERF_NUM_COUNTERS ; ++i)
+  {
+    memset (&attr, 0, sizeof (attr)) ;
+    attr.type           = PERF_TYPE_HARDWARE ;
+    attr.size           = sizeof (attr) ;
+    attr.config         = configs [i] ;
+    attr.exclude_kernel = userOnly ;
+    attr.exclude_hv     = 1 ;
+    attr.read_format    = (i == 0) ? (PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING) : 0 ;
+
+    fd = perfEventOpen (&attr, 0, -1, (i == 0) ? -1 : g->fds [0], 0) ;
+
+    if ((fd < 0) && (i == 0) && !userOnly && ((errno == EACCES) || (errno == EPERM)))
+    {
+      userOnly = TRUE ;			// No kernel counting allowed - go user-only
+      attr.exclude_kernel = 1 ;
+      fd = perfEventOpen (&attr, 0, -1, -1, 0) ;
+    }
+
+    if ((fd < 0) && (i == 0))		// No cycles counter: no PMU access at all
+    {
+      g->inUse = FALSE ;
+      return -1 ;
+    }
+
+    g->fds  [i] = fd ;
+    g->have [i] = (fd >= 0) ;		// Missing siblings just read as zero
+  }
+
+  return handle ;
+}
+
+
+/*
+ * wpiPerfRead:
+ *	Snapshot the group in one syscall. The counts run from
+ *	wpiPerfOpen(), so bracket the code of interest with two reads and
+ *	subtract.
+ *********************************************************************************
+ */
+
+int wpiPerfRead (int handle, struct WPIPerfCounts *counts)
+{
+  struct
+  {
+    uint64_t nr ;
+    uint64_t timeEnabled ;
+    uint64_t timeRunning ;
+    uint64_t values [PERF_NUM_COUNTERS] ;
+  } buf ;
+  struct wpiPerfGroup *g ;
+  int i, next ;
+
+  if ((handle < 0) || (handle >= MAX_PERF_GROUPS) || !perfGroups [handle].inUse || (counts == NULL))
+    return -1 ;
+
+  g = &perfGroups [handle] ;
+  if (read (g->fds [0], &buf, sizeof (buf)) < 0)
+    return -1 ;
+
+  counts->cycles = counts->instructions = counts->cacheMisses = 0 ;
+  counts->timeEnabled_ns = buf.timeEnabled ;
+  counts->timeRunning_ns = buf.timeRunning ;
+
+// Group values come back in the order the counters were opened, with
+//	the missing ones simply absent
+
+  next = 0 ;
+  for (i = 0 ; i < PERF_NUM_COUNTERS ; ++i)
+  {
+    if (!g->have [i] || (next >= (int)buf.nr))
+      continue ;
+    switch (i)
+    {
+      case 0:	counts->cycles       = buf.values [next] ;	break ;
+      case 1:	counts->instructions = buf.values [next] ;	break ;
+      case 2:	counts->cacheMisses  = buf.values [next] ;	break ;
+    }
+    ++next ;
+  }
+
+  return 0 ;
+}
+
+
+/*
+ * wpiPerfClose:
+ *	Stop the counters and free the handle.
+ *********************************************************************************
+ */
+
+void wpiPerfClose (int handle)
+{
+  struct wpiPerfGroup *g ;
+  int i ;
+
+  if ((handle < 0) || (handle >= MAX_PERF_GROUPS) || !perfGroups [handle].inUse)
+    return ;
+
+  g = &perfGroups [handle] ;
+  for (i = PERF_NUM_COUNTERS - 1 ; i >= 0 ; --i)	// Leader last
+    if (g->have [i])
+    {
+      close (g->fds [i]) ;
+      g->have [i] = FALSE ;
+    }
+  g->inUse = FALSE ;
+}
+
+
+/*
+ * wpiPerfTimerCount: wpiPerfTimerHz:
+ *	The architected counter-timer, read directly where the kernel
+ *	permits it (AArch64 enables userspace CNTVCT access by default).
+ *	Elsewhere this degrades to the monotonic clock in nanoseconds, so
+ *	callers can always divide by wpiPerfTimerHz() to get seconds.
+ *********************************************************************************
+ */
+
+unsigned long long wpiPerfTimerCount (void)
+{
+#if defined(__aarch64__)
+  uint64_t count ;
+
+  __asm__ __volatile__ ("isb ; mrs %0, cntvct_el0" : "=r" (count)) ;
+  return count ;
+#else
+  struct timespec now ;
+
+  clock_gettime (CLOCK_MONOTONIC, &now) ;
+  return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec ;
+#endif
+}
+
+unsigned long long wpiPerfTimerHz (void)
+{
+#if defined(__aarch64__)
+  uint64_t freq ;
+
+  __asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (freq)) ;
+  return freq ;
+#else
+  return 1000000000ULL ;
+#endif
+}
@@ -0,0 +1,59 @@
+/*
+ * wiringPiPerf.h:
+ *	Hardware performance-counter access for profiling the hot paths.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All Interface V3.17. A handle counts cycles, instructions and cache
+//	misses for the calling thread from wpiPerfOpen() on; read before
+//	and after the code of interest and subtract. Counters the PMU
+//	can't provide read as zero, and timeRunning_ns below
+//	timeEnabled_ns means the kernel multiplexed the counters - scale
+//	by the ratio, or distrust the numbers.
+
+struct WPIPerfCounts
+{
+  unsigned long long cycles ;
+  unsigned long long instructions ;	// 0: counter not available
+  unsigned long long cacheMisses ;	// 0: counter not available
+  unsigned long long timeEnabled_ns ;
+  unsigned long long timeRunning_ns ;
+} ;
+
+extern int  wpiPerfOpen  (void) ;
+extern int  wpiPerfRead  (int handle, struct WPIPerfCounts *counts) ;
+extern void wpiPerfClose (int handle) ;
+
+// The architected counter-timer, read directly - far cheaper than a
+//	clock_gettime when all you want is a short interval. Ticks at
+//	wpiPerfTimerHz(); falls back to the monotonic clock in
+//	nanoseconds where userspace access isn't available.
+
+extern unsigned long long wpiPerfTimerCount (void) ;
+extern unsigned long long wpiPerfTimerHz    (void) ;
+
+#ifdef __cplusplus
+}
+#endif
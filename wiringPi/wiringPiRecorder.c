@@ -0,0 +1,473 @@
+/*
+ * wiringPiRecorder.c:
+ *	Capture-to-disk pipeline for the continuous sampler.
+ *
+ *	Streaming sampler buffers through fwrite stalls on the page cache
+ *	- writeback kicks in, the callback overruns its buffer, capture
+ *	misses samples. This pipeline keeps the sampler callback down to
+ *	one memcpy into a preallocated 4096-aligned block and hands the
+ *	disk entirely to a writer thread: O_DIRECT so the page cache
+ *	never builds up, io_uring (raw syscalls, as wiringPiUring.c does
+ *	it) so several blocks stay in flight, and plain pwrite as the
+ *	fallback when either is unavailable. When the writer falls behind
+ *	and the block pool empties, whole buffers are dropped - never
+ *	partially written - and the gap is exact in both the report and
+ *	the on-disk block indices.
+ *
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "wiringPi.h"
+#include "wiringPiRecorder.h"
+
+extern int wiringPiDebug ;
+
+#define	REC_ALIGN		4096
+#define	REC_BLOCK_BYTES		(256*1024)
+#define	REC_POOL_BLOCKS		16	// 4MB of staging - ~2 seconds at 2MSa/s
+#define	REC_QDEPTH		8	// writes in flight
+#define	REC_SLOT_RING		32	// must be a power of two, > REC_POOL_BLOCKS
+
+#define	REC_SAMPLES_PER_BLOCK	((REC_BLOCK_BYTES - sizeof (struct wpiRecBlockHeader)) / 8)
+
+// Two SPSC rings of block-pool slot numbers: the sampler callback pops
+//	free slots and pushes filled ones, the writer does the reverse.
+
+struct recSlotRing
+{
+  int slots [REC_SLOT_RING] ;
+  volatile unsigned int head, tail ;
+} ;
+
+static struct
+{
+  int active ;
+  int fd ;
+  unsigned char *blocks ;		// REC_POOL_BLOCKS aligned staging blocks
+  unsigned long long *bufA, *bufB ;	// the sampler's double buffer
+  struct recSlotRing freeRing, filledRing ;
+  sem_t work ;
+  pthread_t writer ;
+  volatile int stopping ;
+  unsigned long long fileOffset ;
+  struct wpiRecorderReport report ;
+} rec ;
+
+// The writer's private io_uring - -1 means the pwrite fallback
+
+static int wrRingFd = -1 ;
+static unsigned int *wrSqTail, *wrSqMask, *wrSqArray ;
+static unsigned int *wrCqHead, *wrCqTail, *wrCqMask ;
+static struct io_uring_sqe *wrSqes ;
+static struct io_uring_cqe *wrCqes ;
+static int wrInflight ;
+static int wrTried = 0 ;			// ring and its mappings persist once up
+
+
+static void recSlotPush (struct recSlotRing *r, int slot)
+{
+  unsigned int head = r->head ;
+
+  r->slots [head % REC_SLOT_RING] = slot ;
+  __atomic_store_n (&r->head, head + 1, __ATOMIC_RELEASE) ;
+}
+
+static int recSlotPop (struct recSlotRing *r)
+{
+  unsigned int tail = r->tail ;
+  int slot ;
+
+  if (tail == __atomic_load_n (&r->head, __ATOMIC_ACQUIRE))
+    return -1 ;
+  slot = r->slots [tail % REC_SLOT_RING] ;
+  __atomic_store_n (&r->tail, tail + 1, __ATOMIC_RELEASE) ;
+  return slot ;
+}
+
+
+/*
+ * recDropRange:
+ *	A whole buffer had nowhere to go. Extend the previous range when
+ *	the drops are contiguous; the table caps out but the on-disk block
+ *	indices never lie.
+ *********************************************************************************
+ */
+
+static void recDropRange (unsigned long long firstSample, unsigned long long numSamples)
+{
+  struct wpiRecorderReport *rep = &rec.report ;
+  unsigned int n = rep->numDropRanges ;
+
+  rep->samplesDropped += numSamples ;
+  if (n > 0 && rep->dropRanges [n - 1].firstSample + rep->dropRanges [n - 1].numSamples == firstSample)
+  {
+    rep->dropRanges [n - 1].numSamples += numSamples ;
+    return ;
+  }
+  if (n < WPI_RECORDER_DROP_RANGES)
+  {
+    rep->dropRanges [n].firstSample = firstSample ;
+    rep->dropRanges [n].numSamples  = numSamples ;
+    rep->numDropRanges = n + 1 ;
+  }
+}
+
+
+/*
+ * recCompletion:
+ *	Runs on the sampler's drain thread with each full buffer. Must be
+ *	quick - the other buffer is filling behind it - so it's a slot
+ *	pop, a memcpy and a semaphore post, or a drop.
+ *********************************************************************************
+ */
+
+static void recCompletion (unsigned long long *buf, unsigned int numSamples, struct wiringPiSampleReport *report)
+{
+  struct wpiRecBlockHeader *hdr ;
+  unsigned long long base ;
+  unsigned char *blk ;
+  int slot ;
+
+  base = rec.report.samplesSeen ;
+  rec.report.samplesSeen += numSamples ;
+  rec.report.achievedRateHz = report->achievedRateHz ;
+
+  if ((slot = recSlotPop (&rec.freeRing)) < 0)
+  {
+    recDropRange (base, numSamples) ;		// writer is behind and the pool is dry
+    return ;
+  }
+
+  blk = rec.blocks + (size_t)slot * REC_BLOCK_BYTES ;
+  hdr = (struct wpiRecBlockHeader *)blk ;
+  hdr->firstSample = base ;
+  hdr->numSamples  = numSamples ;
+  hdr->pad         = 0 ;
+  memcpy (blk + sizeof (struct wpiRecBlockHeader), buf, (size_t)numSamples * 8) ;
+
+  recSlotPush (&rec.filledRing, slot) ;
+  sem_post (&rec.work) ;
+}
+
+
+/*
+ * recUring*:
+ *	The writer's own ring, set up and driven with raw syscalls exactly
+ *	as the ISR backend does - no liburing dependency. Failure at any
+ *	step just leaves wrRingFd at -1 and the writer uses pwrite.
+ *********************************************************************************
+ */
+
+static int recUringInit (void)
+{
+  struct io_uring_params p ;
+  size_t sqSize, cqSize ;
+  void *sqRing, *cqRing ;
+
+  memset (&p, 0, sizeof (p)) ;
+  if ((wrRingFd = syscall (__NR_io_uring_setup, REC_QDEPTH * 2, &p)) < 0)
+  {
+    wrRingFd = -1 ;
+    return -1 ;
+  }
+
+  sqSize = p.sq_off.array + p.sq_entries * sizeof (unsigned int) ;
+  cqSize = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe) ;
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (cqSize > sqSize)
+      sqSize = cqSize ;
+    cqSize = sqSize ;
+  }
+
+  sqRing = mmap (NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, wrRingFd, IORING_OFF_SQ_RING) ;
+  if (sqRing == MAP_FAILED)
+    goto fail ;
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    cqRing = sqRing ;
+  else
+  {
+    cqRing = mmap (NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, wrRingFd, IORING_OFF_CQ_RING) ;
+    if (cqRing == MAP_FAILED)
+      goto fail ;
+  }
+  wrSqes = mmap (NULL, p.sq_entries * sizeof (struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, wrRingFd, IORING_OFF_SQES) ;
+  if (wrSqes == MAP_FAILED)
+    goto fail ;
+
+  wrSqTail  = (unsigned int *)((char *)sqRing + p.sq_off.tail) ;
+  wrSqMask  = (unsigned int *)((char *)sqRing + p.sq_off.ring_mask) ;
+  wrSqArray = (unsigned int *)((char *)sqRing + p.sq_off.array) ;
+  wrCqHead  = (unsigned int *)((char *)cqRing + p.cq_off.head) ;
+  wrCqTail  = (unsigned int *)((char *)cqRing + p.cq_off.tail) ;
+  wrCqMask  = (unsigned int *)((char *)cqRing + p.cq_off.ring_mask) ;
+  wrCqes    = (struct io_uring_cqe *)((char *)cqRing + p.cq_off.cqes) ;
+  return 0 ;
+
+fail:
+  if (wiringPiDebug)
+    printf ("wiringPiRecorder: io_uring setup failed: %s\n", strerror (errno)) ;
+  close (wrRingFd) ;
+  wrRingFd = -1 ;
+  return -1 ;
+}
+
+static void recUringSubmit (int slot, unsigned long long offset)
+{
+  unsigned int tail = *wrSqTail ;
+  unsigned int idx = tail & *wrSqMask ;
+  struct io_uring_sqe *sqe = &wrSqes [idx] ;
+
+  memset (sqe, 0, sizeof (*sqe)) ;
+  sqe->opcode    = IORING_OP_WRITE ;
+  sqe->fd        = rec.fd ;
+  sqe->addr      = (unsigned long long)(uintptr_t)(rec.blocks + (size_t)slot * REC_BLOCK_BYTES) ;
+  sqe->len       = REC_BLOCK_BYTES ;
+  sqe->off       = offset ;
+  sqe->user_data = slot ;
+  wrSqArray [idx] = idx ;
+  __atomic_store_n (wrSqTail, tail + 1, __ATOMIC_RELEASE) ;
+
+  (void)syscall (__NR_io_uring_enter, wrRingFd, 1, 0, 0, NULL, 0) ;
+  ++wrInflight ;
+}
+
+static void recUringReap (int minComplete)
+{
+  struct io_uring_cqe *cqe ;
+  struct wpiRecBlockHeader *hdr ;
+  unsigned int head, tail ;
+  int slot ;
+
+  if (minComplete > 0)
+    (void)syscall (__NR_io_uring_enter, wrRingFd, 0, minComplete, IORING_ENTER_GETEVENTS, NULL, 0) ;
+
+  head = *wrCqHead ;
+  tail = __atomic_load_n (wrCqTail, __ATOMIC_ACQUIRE) ;
+  for (; head != tail ; ++head)
+  {
+    cqe  = &wrCqes [head & *wrCqMask] ;
+    slot = (int)cqe->user_data ;
+    hdr  = (struct wpiRecBlockHeader *)(rec.blocks + (size_t)slot * REC_BLOCK_BYTES) ;
+
+    if (cqe->res == REC_BLOCK_BYTES)
+    {
+      rec.report.samplesWritten += hdr->numSamples ;
+      ++rec.report.blocksWritten ;
+    }
+    else
+    {
+      ++rec.report.ioErrors ;
+      recDropRange (hdr->firstSample, hdr->numSamples) ;
+    }
+    recSlotPush (&rec.freeRing, slot) ;
+    --wrInflight ;
+  }
+  __atomic_store_n (wrCqHead, head, __ATOMIC_RELEASE) ;
+}
+
+
+/*
+ * recWriter:
+ *	Drains filled blocks to disk, several in flight through the ring
+ *	or one at a time through pwrite. Exits only once the sampler is
+ *	stopped and everything queued has hit the device.
+ *********************************************************************************
+ */
+
+static void *recWriter (void *arg)
+{
+  struct wpiRecBlockHeader *hdr ;
+  unsigned char *blk ;
+  int slot ;
+
+  (void)arg ;
+
+  for (;;)
+  {
+    sem_wait (&rec.work) ;
+
+    while ((slot = recSlotPop (&rec.filledRing)) >= 0)
+    {
+      if (wrRingFd >= 0)
+      {
+	if (wrInflight >= REC_QDEPTH)
+	  recUringReap (1) ;
+	recUringSubmit (slot, rec.fileOffset) ;
+	recUringReap (0) ;
+      }
+      else
+      {
+	blk = rec.blocks + (size_t)slot * REC_BLOCK_BYTES ;
+	hdr = (struct wpiRecBlockHeader *)blk ;
+	if (pwrite (rec.fd, blk, REC_BLOCK_BYTES, rec.fileOffset) == REC_BLOCK_BYTES)
+	{
+	  rec.report.samplesWritten += hdr->numSamples ;
+	  ++rec.report.blocksWritten ;
+	}
+	else
+	{
+	  ++rec.report.ioErrors ;
+	  recDropRange (hdr->firstSample, hdr->numSamples) ;
+	}
+	recSlotPush (&rec.freeRing, slot) ;
+      }
+      rec.fileOffset += REC_BLOCK_BYTES ;
+    }
+
+    if (rec.stopping)
+      break ;
+  }
+
+  while (wrRingFd >= 0 && wrInflight > 0)
+    recUringReap (1) ;
+
+  return NULL ;
+}
+
+
+/*
+ * wiringPiRecorderStart:
+ *	Open the file, stage the block pool and chain the sampler's double
+ *	buffer to the writer. One recording per process; needs the same
+ *	memory-mapped setup the sampler does.
+ *********************************************************************************
+ */
+
+int wiringPiRecorderStart (const char *path, unsigned long long pinMask, unsigned int rateHz)
+{
+  struct wpiRecFileHeader *fileHdr ;
+  void *mem ;
+  int i ;
+
+  if (rec.active || path == NULL || rateHz == 0)
+    return -1 ;
+
+  memset (&rec.report, 0, sizeof (rec.report)) ;
+  rec.stopping   = 0 ;
+  rec.fileOffset = REC_ALIGN ;			// data starts after the header block
+  wrInflight     = 0 ;
+
+  if ((rec.fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, 0644)) < 0)
+    if ((rec.fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+      return -1 ;
+
+  mem = wpiBufAlloc (REC_POOL_BLOCKS * REC_BLOCK_BYTES + REC_ALIGN, WPI_BUF_HUGE | WPI_BUF_LOCK) ;
+  if (mem == NULL)
+  {
+    close (rec.fd) ;
+    return -1 ;
+  }
+  rec.blocks = (unsigned char *)mem ;
+
+  rec.bufA = (unsigned long long *)wpiBufAlloc (REC_SAMPLES_PER_BLOCK * 8, WPI_BUF_HUGE | WPI_BUF_LOCK) ;
+  rec.bufB = (unsigned long long *)wpiBufAlloc (REC_SAMPLES_PER_BLOCK * 8, WPI_BUF_HUGE | WPI_BUF_LOCK) ;
+  if (rec.bufA == NULL || rec.bufB == NULL)
+    goto fail ;
+
+// The header rides in the spare aligned page after the pool
+
+  fileHdr = (struct wpiRecFileHeader *)(rec.blocks + (size_t)REC_POOL_BLOCKS * REC_BLOCK_BYTES) ;
+  memset (fileHdr, 0, REC_ALIGN) ;
+  memcpy (fileHdr->magic, WPI_RECORDER_MAGIC, sizeof (fileHdr->magic)) ;
+  fileHdr->pinMask    = pinMask ;
+  fileHdr->rateHz     = rateHz ;
+  fileHdr->blockBytes = REC_BLOCK_BYTES ;
+  if (pwrite (rec.fd, fileHdr, REC_ALIGN, 0) != REC_ALIGN)
+    goto fail ;
+
+  rec.freeRing.head = rec.freeRing.tail = 0 ;
+  rec.filledRing.head = rec.filledRing.tail = 0 ;
+  for (i = 0 ; i < REC_POOL_BLOCKS ; ++i)
+    recSlotPush (&rec.freeRing, i) ;
+  sem_init (&rec.work, 0, 0) ;
+
+  if (!wrTried)					// the ring persists across recordings
+  {
+    wrTried = 1 ;
+    (void)recUringInit () ;			// pwrite fallback on failure
+  }
+
+  if (pthread_create (&rec.writer, NULL, recWriter, NULL) != 0)
+    goto fail ;
+
+  if (wiringPiSampleStart (pinMask, rateHz, rec.bufA, rec.bufB, REC_SAMPLES_PER_BLOCK, recCompletion) != 0)
+  {
+    rec.stopping = 1 ;
+    sem_post (&rec.work) ;
+    pthread_join (rec.writer, NULL) ;
+    goto fail ;
+  }
+
+  rec.active = TRUE ;
+  return 0 ;
+
+fail:
+  wpiBufFree (rec.bufA) ;    rec.bufA = NULL ;
+  wpiBufFree (rec.bufB) ;    rec.bufB = NULL ;
+  wpiBufFree (rec.blocks) ;  rec.blocks = NULL ;
+  close (rec.fd) ;
+  return -1 ;
+}
+
+
+/*
+ * wiringPiRecorderStop:
+ *	Stop the sampler, let the writer flush everything it has, and
+ *	hand back the accounting.
+ *********************************************************************************
+ */
+
+int wiringPiRecorderStop (struct wpiRecorderReport *report)
+{
+  if (!rec.active)
+    return -1 ;
+
+  wiringPiSampleStop () ;			// drains the buffer in the callback first
+  rec.stopping = 1 ;
+  sem_post (&rec.work) ;
+  pthread_join (rec.writer, NULL) ;
+
+  close (rec.fd) ;
+  sem_destroy (&rec.work) ;
+  wpiBufFree (rec.bufA) ;    rec.bufA = NULL ;
+  wpiBufFree (rec.bufB) ;    rec.bufB = NULL ;
+  wpiBufFree (rec.blocks) ;  rec.blocks = NULL ;
+
+  if (report != NULL)
+    *report = rec.report ;
+  rec.active = FALSE ;
+
+  return 0 ;
+}
@@ -0,0 +1,91 @@
+/*
+ * wiringPiRecorder.h:
+ *	Capture-to-disk pipeline for the continuous sampler.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifndef	_WIRINGPI_RECORDER_H
+#define	_WIRINGPI_RECORDER_H
+
+// On-disk layout: one 4096-byte header block, then fixed-size data
+//	blocks. Every data block opens with a wpiRecBlockHeader giving the
+//	absolute index of its first sample, so a gap between one block's
+//	end and the next block's start is an exact record of samples that
+//	were dropped - the file carries its own loss accounting.
+
+#define	WPI_RECORDER_MAGIC	"WPISMP1"
+
+struct wpiRecFileHeader
+{
+  char magic [8] ;
+  unsigned long long pinMask ;
+  unsigned int rateHz ;
+  unsigned int blockBytes ;		// data block size, wpiRecBlockHeader included
+} ;
+
+struct wpiRecBlockHeader
+{
+  unsigned long long firstSample ;	// absolute sample index of samples [0]
+  unsigned int numSamples ;
+  unsigned int pad ;
+} ;
+
+// What a recording run delivered. The drop-range table holds the first
+//	WPI_RECORDER_DROP_RANGES gaps; the file itself records every gap
+//	exactly, however many there were.
+
+#define	WPI_RECORDER_DROP_RANGES	16
+
+struct wpiRecorderDropRange
+{
+  unsigned long long firstSample ;
+  unsigned long long numSamples ;
+} ;
+
+struct wpiRecorderReport
+{
+  unsigned long long samplesSeen ;
+  unsigned long long samplesWritten ;
+  unsigned long long samplesDropped ;
+  unsigned int blocksWritten ;
+  unsigned int ioErrors ;
+  unsigned int achievedRateHz ;
+  unsigned int numDropRanges ;
+  struct wpiRecorderDropRange dropRanges [WPI_RECORDER_DROP_RANGES] ;
+} ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interface V3.17. One recording per process, like the sampler it
+//	drives. Start opens the file O_DIRECT where the filesystem allows
+//	and writes through its own io_uring when the kernel provides one,
+//	falling back to plain pwrite - the format is identical either way.
+
+extern int wiringPiRecorderStart (const char *path, unsigned long long pinMask, unsigned int rateHz) ;
+extern int wiringPiRecorderStop  (struct wpiRecorderReport *report) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
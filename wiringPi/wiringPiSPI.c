@@ -27,13 +27,16 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <asm/ioctl.h>
 #include <linux/spi/spidev.h>
 #include "wiringPi.h"
+#include "wiringPiTrace.h"
 #include "wiringPiSPI.h"
 
 
@@ -74,11 +77,11 @@ static int         spiFds [7][3] =
 
 int SPICheckLimits(const int number, const int channel) {
   if (channel<0 || channel>=WPI_MaxSPIChannels) {
-    fprintf (stderr, "wiringPiSPI: Invalid SPI channel (%d, valid range 0-%d)", channel, WPI_MaxSPIChannels-1);
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiSPI: Invalid SPI channel (%d, valid range 0-%d)", channel, WPI_MaxSPIChannels-1);
     return -EINVAL;
   }
   if (number<0 || number>=WPI_MaxSPINumbers) {
-    fprintf (stderr, "wiringPiSPI: Invalid SPI number  (%d, valid range 0-%d)", number, WPI_MaxSPINumbers-1);
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiSPI: Invalid SPI number  (%d, valid range 0-%d)", number, WPI_MaxSPINumbers-1);
     return -EINVAL;
   }
 
@@ -88,6 +91,137 @@ int SPICheckLimits(const int number, const int channel) {
 
 #define RETURN_ON_LIMIT_FAIL int ret = SPICheckLimits(number, channel); if(ret!=0) { return ret; };
 
+// spidev bounces every message through a kernel buffer of bufsiz bytes
+//	(a module parameter, typically 4096) and fails transfers beyond it
+//	with EMSGSIZE. Read the limit once so the transfer paths can split
+//	big buffers themselves.
+
+static int spiBufSiz = 0 ;
+
+static int spiStatsIoctl (const int number, const int channel, const unsigned long request, void *argp, const int bytes) ;
+
+static void spiReadBufSiz (void)
+{
+  char buf [16] ;
+  int fd, n ;
+
+  spiBufSiz = 4096 ;	// The module default, if sysfs won't say
+
+  if ((fd = open ("/sys/module/spidev/parameters/bufsiz", O_RDONLY)) < 0)
+    return ;
+  if ((n = read (fd, buf, sizeof (buf) - 1)) > 0)
+  {
+    buf [n] = 0 ;
+    if (atoi (buf) > 0)
+      spiBufSiz = atoi (buf) ;
+  }
+  close (fd) ;
+}
+
+
+/*
+ * spiChunkedTransfer:
+ *	A transfer bigger than bufsiz, issued as successive messages of at
+ *	most bufsiz each. The chip-select must not drop mid-frame, and the
+ *	kernel's rule there is inverted from the intra-message one: cs_change
+ *	set on the LAST transfer of a message holds CS asserted into the
+ *	next message. So every chunk but the final one carries it, and the
+ *	device sees one unbroken frame. Returns total bytes, or the first
+ *	failing ioctl's result.
+ *********************************************************************************
+ */
+
+static int spiChunkedTransfer (const int number, const int channel, const unsigned char *txData, unsigned char *rxData, const int len, const unsigned int speed)
+{
+  struct spi_ioc_transfer spi ;
+  int done = 0, chunk, result, total = 0 ;
+
+  if (spiBufSiz == 0)
+    spiReadBufSiz () ;
+
+  while (done < len)
+  {
+    chunk = len - done ;
+    if (chunk > spiBufSiz)
+      chunk = spiBufSiz ;
+
+    memset (&spi, 0, sizeof (spi)) ;
+    spi.tx_buf        = txData == NULL ? 0UL : (unsigned long)(txData + done) ;
+    spi.rx_buf        = rxData == NULL ? 0UL : (unsigned long)(rxData + done) ;
+    spi.len           = chunk ;
+    spi.delay_usecs   = spiDelay ;
+    spi.speed_hz      = speed ? speed : spiSpeeds [number][channel] ;
+    spi.bits_per_word = spiBPW ;
+    spi.cs_change     = (done + chunk < len) ? 1 : 0 ;	// hold CS into the next message
+
+    result = spiStatsIoctl (number, channel, SPI_IOC_MESSAGE(1), &spi, chunk) ;
+    if (result < 0)
+      return result ;
+
+    total += result ;
+    done  += chunk ;
+  }
+
+  return total ;
+}
+
+
+/*
+ * spiStatsIoctl:
+ *	Issue a transfer ioctl with the per-channel transaction counters
+ *	wrapped around it - see wiringPiBusStatsSlot() for where they live.
+ *********************************************************************************
+ */
+
+static int spiStatsIoctl (const int number, const int channel, const unsigned long request, void *argp, const int bytes)
+{
+  struct WPIBusStats *s = wiringPiBusStatsSlot (WPI_BUS_STATS_SPI, number * 4 + channel) ;
+  struct timespec t0, t1 ;
+  int result ;
+
+  clock_gettime (CLOCK_MONOTONIC, &t0) ;
+  result = ioctl (spiFds [number][channel], request, argp) ;
+
+  if (s != NULL)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &t1) ;
+    ++s->transactions ;
+    s->busTime_us += (unsigned long long)(t1.tv_sec - t0.tv_sec) * 1000000ULL + (t1.tv_nsec - t0.tv_nsec) / 1000 ;
+    if (result < 0)
+      ++s->errors ;
+    else
+      s->bytes += bytes ;
+  }
+
+  return result ;
+}
+
+
+/*
+ * wiringPiSPIxStats: wiringPiSPIStats:
+ *	Snapshot the transaction counters for a channel. Returns -1 when
+ *	nothing has been counted for it yet.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxStats (const int number, const int channel, struct WPIBusStats *stats)
+{
+  struct WPIBusStats *s ;
+
+  if (SPICheckLimits (number, channel) != 0 || stats == NULL)
+    return -1 ;
+  if ((s = wiringPiBusStatsSlot (WPI_BUS_STATS_SPI, number * 4 + channel)) == NULL)
+    return -1 ;
+
+  *stats = *s ;
+  return 0 ;
+}
+
+int wiringPiSPIStats (const int channel, struct WPIBusStats *stats)
+{
+  return wiringPiSPIxStats (0, channel, stats) ;
+}
+
 /*
  * wiringPiSPIGetFd:
  *	Return the file-descriptor for the given channel
@@ -121,10 +255,16 @@ int wiringPiSPIxDataRW (const int number, const int channel, unsigned char *data
 
   RETURN_ON_LIMIT_FAIL
   if (-1==spiFds[number][channel]) {
-    fprintf (stderr, "wiringPiSPI: Invalid SPI number/channel (need wiringPiSPIxSetupMode before read/write)");
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiSPI: Invalid SPI number/channel (need wiringPiSPIxSetupMode before read/write)");
     return -EBADF;
   }
 
+  if (spiBufSiz > 0 && len > spiBufSiz)
+  {
+    WPI_TRACE (WPI_TRACE_SPI, channel, len) ;
+    return spiChunkedTransfer (number, channel, data, data, len, 0) ;
+  }
+
   struct spi_ioc_transfer spi ;
 // Mentioned in spidev.h but not used in the original kernel documentation
 //	test program )-:
@@ -137,13 +277,358 @@ int wiringPiSPIxDataRW (const int number, const int channel, unsigned char *data
   spi.speed_hz      = spiSpeeds [number][channel] ;
   spi.bits_per_word = spiBPW ;
 
-  return ioctl (spiFds[number][channel], SPI_IOC_MESSAGE(1), &spi) ;
+  WPI_TRACE (WPI_TRACE_SPI, channel, len) ;
+  return spiStatsIoctl (number, channel, SPI_IOC_MESSAGE(1), &spi, len) ;
 }
 
 int wiringPiSPIDataRW (int channel, unsigned char *data, int len) {
   return wiringPiSPIxDataRW(0, channel, data, len);
 }
 
+
+/*
+ * wiringPiSPIDataRWSpeed:
+ *	As wiringPiSPIDataRW, but with a per-call clock speed. speed_hz is
+ *	carried in the spi_ioc_transfer itself, so mixed-speed devices on
+ *	one bus no longer need a close/reopen between transfers.
+ *	A speed of 0 uses the channel's setup speed.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxDataRWSpeed (const int number, const int channel, unsigned char *data, const int len, const unsigned int speed)
+{
+  RETURN_ON_LIMIT_FAIL
+  if (-1==spiFds[number][channel]) {
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiSPI: Invalid SPI number/channel (need wiringPiSPIxSetupMode before read/write)");
+    return -EBADF;
+  }
+
+  if (spiBufSiz > 0 && len > spiBufSiz)
+  {
+    WPI_TRACE (WPI_TRACE_SPI, channel, len) ;
+    return spiChunkedTransfer (number, channel, data, data, len, speed) ;
+  }
+
+  struct spi_ioc_transfer spi ;
+  memset (&spi, 0, sizeof (spi)) ;
+
+  spi.tx_buf        = (unsigned long)data ;
+  spi.rx_buf        = (unsigned long)data ;
+  spi.len           = len ;
+  spi.delay_usecs   = spiDelay ;
+  spi.speed_hz      = speed ? speed : spiSpeeds [number][channel] ;
+  spi.bits_per_word = spiBPW ;
+
+  WPI_TRACE (WPI_TRACE_SPI, channel, len) ;
+  return spiStatsIoctl (number, channel, SPI_IOC_MESSAGE(1), &spi, len) ;
+}
+
+int wiringPiSPIDataRWSpeed (int channel, unsigned char *data, int len, unsigned int speed) {
+  return wiringPiSPIxDataRWSpeed(0, channel, data, len, speed);
+}
+
+
+/*
+ * wiringPiSPISetMode:
+ *	Change the SPI mode on the already-open device. The mode is a bus
+ *	property rather than a message one, so unlike speed it can't ride
+ *	in the transfer itself - but a mode ioctl on the existing fd is
+ *	still far cheaper than a close and reopen.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxSetMode (const int number, const int channel, const int mode)
+{
+  RETURN_ON_LIMIT_FAIL
+  if (-1==spiFds[number][channel]) {
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiSPI: Invalid SPI number/channel (need wiringPiSPIxSetupMode before read/write)");
+    return -EBADF;
+  }
+  if (mode<0 || mode>3) { // Mode is 0, 1, 2 or 3 original
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiSPI: Invalid mode (%d, valid range 0-%d)", mode, 3);
+    return -EINVAL;
+  }
+
+  if (ioctl (spiFds[number][channel], SPI_IOC_WR_MODE, &mode) < 0)
+    return wiringPiFailure (WPI_ALMOST, "SPI mode change failure: %s\n", strerror (errno)) ;
+
+  return 0 ;
+}
+
+int wiringPiSPISetMode (int channel, int mode) {
+  return wiringPiSPIxSetMode (0, channel, mode);
+}
+
+
+/*
+ * wiringPiSPITransfer:
+ * wiringPiSPIWrite:
+ * wiringPiSPIRead:
+ *	Full-duplex transfer with separate transmit and receive buffers,
+ *	plus write-only and read-only forms. Unlike wiringPiSPIDataRW the
+ *	transmit data is left untouched, and with a NULL rx (or tx) side
+ *	the kernel skips the copy for that direction entirely.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxTransfer (const int number, const int channel, const unsigned char *txData, unsigned char *rxData, const int len)
+{
+  RETURN_ON_LIMIT_FAIL
+  if (-1==spiFds[number][channel]) {
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiSPI: Invalid SPI number/channel (need wiringPiSPIxSetupMode before read/write)");
+    return -EBADF;
+  }
+
+  if (spiBufSiz > 0 && len > spiBufSiz)
+  {
+    WPI_TRACE (WPI_TRACE_SPI, channel, len) ;
+    return spiChunkedTransfer (number, channel, txData, rxData, len, 0) ;
+  }
+
+  struct spi_ioc_transfer spi ;
+  memset (&spi, 0, sizeof (spi)) ;
+
+  spi.tx_buf        = (unsigned long)txData ;
+  spi.rx_buf        = (unsigned long)rxData ;
+  spi.len           = len ;
+  spi.delay_usecs   = spiDelay ;
+  spi.speed_hz      = spiSpeeds [number][channel] ;
+  spi.bits_per_word = spiBPW ;
+
+  WPI_TRACE (WPI_TRACE_SPI, channel, len) ;
+  return spiStatsIoctl (number, channel, SPI_IOC_MESSAGE(1), &spi, len) ;
+}
+
+int wiringPiSPIxWrite (const int number, const int channel, const unsigned char *data, const int len) {
+  return wiringPiSPIxTransfer (number, channel, data, NULL, len) ;
+}
+
+int wiringPiSPIxRead (const int number, const int channel, unsigned char *data, const int len) {
+  return wiringPiSPIxTransfer (number, channel, NULL, data, len) ;
+}
+
+int wiringPiSPITransfer (int channel, const unsigned char *txData, unsigned char *rxData, int len) {
+  return wiringPiSPIxTransfer (0, channel, txData, rxData, len) ;
+}
+
+int wiringPiSPIWrite (int channel, const unsigned char *data, int len) {
+  return wiringPiSPIxTransfer (0, channel, data, NULL, len) ;
+}
+
+int wiringPiSPIRead (int channel, unsigned char *data, int len) {
+  return wiringPiSPIxTransfer (0, channel, NULL, data, len) ;
+}
+
+
+/*
+ * wiringPiSPIDataRWn:
+ *	Issue a chain of transfer segments as one SPI_IOC_MESSAGE(N)
+ *	ioctl - one syscall and one CS frame (unless a segment asks for a
+ *	CS toggle) instead of one of each per transfer. Useful for daisy
+ *	chained devices and register streams.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxDataRWn (const int number, const int channel, struct wiringPiSPISegment *segments, const int nSegments)
+{
+  struct spi_ioc_transfer spi [WPI_SPI_MAX_SEGMENTS] ;
+  int i, nBytes ;
+
+  RETURN_ON_LIMIT_FAIL
+  if (-1==spiFds[number][channel]) {
+    wiringPiError (WPI_ERROR_BAD_MODE, "wiringPiSPI: Invalid SPI number/channel (need wiringPiSPIxSetupMode before read/write)");
+    return -EBADF;
+  }
+  if (nSegments<1 || nSegments>WPI_SPI_MAX_SEGMENTS) {
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiSPI: Invalid segment count (%d, valid range 1-%d)", nSegments, WPI_SPI_MAX_SEGMENTS);
+    return -EINVAL;
+  }
+
+  memset (spi, 0, sizeof (spi [0]) * nSegments) ;
+  nBytes = 0 ;
+  for (i = 0 ; i < nSegments ; ++i)
+  {
+    nBytes += segments [i].len ;
+    spi [i].tx_buf        = (unsigned long)segments [i].txData ;	// NULL: shift out zeros
+    spi [i].rx_buf        = (unsigned long)segments [i].rxData ;	// NULL: discard
+    spi [i].len           = segments [i].len ;
+    spi [i].delay_usecs   = segments [i].delay ;
+    spi [i].speed_hz      = segments [i].speed ? segments [i].speed : spiSpeeds [number][channel] ;
+    spi [i].bits_per_word = spiBPW ;
+    spi [i].cs_change     = segments [i].csChange ;
+  }
+
+  WPI_TRACE (WPI_TRACE_SPI, channel, nSegments) ;
+  return spiStatsIoctl (number, channel, SPI_IOC_MESSAGE(nSegments), spi, nBytes) ;
+}
+
+int wiringPiSPIDataRWn (int channel, struct wiringPiSPISegment *segments, int nSegments) {
+  return wiringPiSPIxDataRWn(0, channel, segments, nSegments);
+}
+
+
+/*
+ * The asynchronous layer:
+ *	A worker thread per SPI bus number executes queued transfers in
+ *	order and calls the completion function from the worker, so
+ *	transfers to different CS lines on one bus queue back-to-back and
+ *	the submitting thread never stalls in the transfer ioctl. Same
+ *	shape as the I2C asynchronous layer in wiringPiI2C.c.
+ *********************************************************************************
+ */
+
+#define	SPI_ASYNC_QUEUE_SIZE	64
+
+struct spiAsyncRequest
+{
+  int channel ;
+  struct wiringPiSPISegment *segments ;
+  int nSegments ;
+  wiringPiSPICompletion complete ;
+  void *userdata ;
+} ;
+
+struct spiAsyncBus
+{
+  int active ;			// worker thread is up
+  int busy ;			// worker is executing a request
+  int number ;
+  pthread_t thread ;
+  pthread_mutex_t lock ;
+  pthread_cond_t  submitted ;
+  pthread_cond_t  drained ;
+  struct spiAsyncRequest queue [SPI_ASYNC_QUEUE_SIZE] ;
+  int head, tail, count ;
+} ;
+
+static struct spiAsyncBus spiAsyncBuses [7] ;
+static pthread_mutex_t spiAsyncSetupLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static void *spiAsyncWorker (void *arg)
+{
+  struct spiAsyncBus *bus = (struct spiAsyncBus *)arg ;
+  struct spiAsyncRequest req ;
+  int result ;
+
+  for (;;)
+  {
+    pthread_mutex_lock (&bus->lock) ;
+    while (bus->count == 0)
+      pthread_cond_wait (&bus->submitted, &bus->lock) ;
+    req = bus->queue [bus->head] ;
+    bus->head = (bus->head + 1) % SPI_ASYNC_QUEUE_SIZE ;
+    --bus->count ;
+    bus->busy = TRUE ;
+    pthread_mutex_unlock (&bus->lock) ;
+
+    result = wiringPiSPIxDataRWn (bus->number, req.channel, req.segments, req.nSegments) ;
+
+    if (req.complete != NULL)
+      req.complete (result, req.userdata) ;
+
+    pthread_mutex_lock (&bus->lock) ;
+    bus->busy = FALSE ;
+    if (bus->count == 0)
+      pthread_cond_broadcast (&bus->drained) ;
+    pthread_mutex_unlock (&bus->lock) ;
+  }
+
+  return NULL ;
+}
+
+static struct spiAsyncBus *spiAsyncFindBus (int number)
+{
+  struct spiAsyncBus *bus = &spiAsyncBuses [number] ;
+
+  pthread_mutex_lock (&spiAsyncSetupLock) ;
+  if (!bus->active)
+  {
+    bus->number = number ;
+    bus->busy   = FALSE ;
+    bus->head   = bus->tail = bus->count = 0 ;
+    pthread_mutex_init (&bus->lock, NULL) ;
+    pthread_cond_init  (&bus->submitted, NULL) ;
+    pthread_cond_init  (&bus->drained, NULL) ;
+
+    if (pthread_create (&bus->thread, NULL, spiAsyncWorker, bus) != 0)
+      bus = NULL ;
+    else
+      bus->active = TRUE ;
+  }
+  pthread_mutex_unlock (&spiAsyncSetupLock) ;
+
+  return bus ;
+}
+
+
+/*
+ * wiringPiSPIxSubmit:
+ *	Queue a segment chain on the bus worker. The completion function
+ *	gets the wiringPiSPIxDataRWn() result; the segments (and their
+ *	buffers) must stay valid until it runs. Returns 0 once queued, -1
+ *	if the queue is full or no worker could be started.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxSubmit (const int number, const int channel, struct wiringPiSPISegment *segments, const int nSegments, wiringPiSPICompletion complete, void *userdata)
+{
+  struct spiAsyncBus *bus ;
+  struct spiAsyncRequest req = { .channel = channel, .segments = segments, .nSegments = nSegments, .complete = complete, .userdata = userdata } ;
+
+  RETURN_ON_LIMIT_FAIL
+  if ((bus = spiAsyncFindBus (number)) == NULL)
+    return -1 ;
+
+  pthread_mutex_lock (&bus->lock) ;
+  if (bus->count == SPI_ASYNC_QUEUE_SIZE)
+  {
+    pthread_mutex_unlock (&bus->lock) ;
+    return -1 ;			// Queue full - submit later or flush
+  }
+  bus->queue [bus->tail] = req ;
+  bus->tail = (bus->tail + 1) % SPI_ASYNC_QUEUE_SIZE ;
+  ++bus->count ;
+  pthread_cond_signal (&bus->submitted) ;
+  pthread_mutex_unlock (&bus->lock) ;
+
+  return 0 ;
+}
+
+int wiringPiSPISubmit (const int channel, struct wiringPiSPISegment *segments, const int nSegments, wiringPiSPICompletion complete, void *userdata)
+{
+  return wiringPiSPIxSubmit (0, channel, segments, nSegments, complete, userdata) ;
+}
+
+
+/*
+ * wiringPiSPIxFlush:
+ *	Wait until everything queued on this bus number has completed.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxFlush (const int number)
+{
+  struct spiAsyncBus *bus ;
+
+  if ((number < 0) || (number >= WPI_MaxSPINumbers))
+    return -EINVAL ;
+  if (!spiAsyncBuses [number].active)
+    return 0 ;			// nothing ever queued
+
+  bus = &spiAsyncBuses [number] ;
+  pthread_mutex_lock (&bus->lock) ;
+  while ((bus->count != 0) || bus->busy)
+    pthread_cond_wait (&bus->drained, &bus->lock) ;
+  pthread_mutex_unlock (&bus->lock) ;
+
+  return 0 ;
+}
+
+int wiringPiSPIFlush (void)
+{
+  return wiringPiSPIxFlush (0) ;
+}
+
 /*
  * wiringPiSPISetupMode:
  *	Open the SPI device, and set it up, with the mode, etc.
@@ -158,7 +643,7 @@ int wiringPiSPIxSetupMode(const int number, const int channel, const int speed,
 
   RETURN_ON_LIMIT_FAIL
   if (mode<0 || mode>3) { // Mode is 0, 1, 2 or 3 original
-    fprintf (stderr, "wiringPiSPI: Invalid mode (%d, valid range 0-%d)", mode, 3);
+    wiringPiError (WPI_ERROR_BAD_ARGS, "wiringPiSPI: Invalid mode (%d, valid range 0-%d)", mode, 3);
     return -EINVAL;
   }
 
@@ -166,6 +651,9 @@ int wiringPiSPIxSetupMode(const int number, const int channel, const int speed,
   if ((fd = open (spiDev, O_RDWR)) < 0) {
     return wiringPiFailure (WPI_ALMOST, "Unable to open SPI device %s: %s\n", spiDev, strerror (errno)) ;
   }
+
+  if (spiBufSiz == 0)
+    spiReadBufSiz () ;
   spiSpeeds [number][channel] = speed ;
   spiFds    [number][channel] = fd ;
 
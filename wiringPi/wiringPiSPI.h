@@ -22,6 +22,32 @@
  ***********************************************************************
  */
 
+// wiringPiSPISegment:
+//	One segment of a multi-message transfer for wiringPiSPIxDataRWn().
+//	All segments go out in one ioctl; CS stays asserted across them
+//	unless csChange asks for a toggle after a segment. For large or
+//	high-rate transfers put txData/rxData in wpiBufAlloc() buffers -
+//	spidev bounce-copies unaligned ones.
+//	Interface V3.17
+
+#define	WPI_SPI_MAX_SEGMENTS	64
+
+struct wiringPiSPISegment
+{
+  unsigned char *txData ;	// NULL: shift out zeros
+  unsigned char *rxData ;	// NULL: discard incoming data
+  unsigned int   len ;
+  unsigned int   speed ;	// Hz, 0: use the channel's setup speed
+  unsigned short delay ;	// uS to hold CS after this segment
+  unsigned char  csChange ;	// toggle CS before the next segment
+} ;
+
+// Completion function for the asynchronous calls - runs on the bus worker
+//	thread with the result the synchronous call would have returned.
+//	Interface V3.17
+
+typedef void (*wiringPiSPICompletion) (int result, void *userdata) ;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,6 +67,37 @@ int wiringPiSPIxSetupMode (const int number, const int channel, const int speed,
 int wiringPiSPIxSetup     (const int number, const int channel, const int speed) ;
 int wiringPiSPIxClose     (const int number, const int channel);
 
+//Interface 3.17
+int wiringPiSPIDataRWn    (int channel, struct wiringPiSPISegment *segments, int nSegments) ;
+int wiringPiSPIxDataRWn   (const int number, const int channel, struct wiringPiSPISegment *segments, const int nSegments) ;
+
+//Interface 3.17 - per-call speed (0: channel's setup speed) and mode on the open device
+int wiringPiSPIDataRWSpeed  (int channel, unsigned char *data, int len, unsigned int speed) ;
+int wiringPiSPISetMode      (int channel, int mode) ;
+int wiringPiSPIxDataRWSpeed (const int number, const int channel, unsigned char *data, const int len, const unsigned int speed) ;
+int wiringPiSPIxSetMode     (const int number, const int channel, const int mode) ;
+
+//Interface 3.17 - separate tx/rx buffers; NULL skips that direction
+int wiringPiSPITransfer   (int channel, const unsigned char *txData, unsigned char *rxData, int len) ;
+int wiringPiSPIWrite      (int channel, const unsigned char *data, int len) ;
+int wiringPiSPIRead       (int channel, unsigned char *data, int len) ;
+int wiringPiSPIxTransfer  (const int number, const int channel, const unsigned char *txData, unsigned char *rxData, const int len) ;
+int wiringPiSPIxWrite     (const int number, const int channel, const unsigned char *data, const int len) ;
+int wiringPiSPIxRead      (const int number, const int channel, unsigned char *data, const int len) ;
+
+//Interface 3.17 - asynchronous submission: a worker per bus number runs the
+//	queued segment chains in order; segments stay owned by the caller
+//	until their completion runs
+int wiringPiSPISubmit     (const int channel, struct wiringPiSPISegment *segments, const int nSegments, wiringPiSPICompletion complete, void *userdata) ;
+int wiringPiSPIxSubmit    (const int number, const int channel, struct wiringPiSPISegment *segments, const int nSegments, wiringPiSPICompletion complete, void *userdata) ;
+int wiringPiSPIFlush      (void) ;
+int wiringPiSPIxFlush     (const int number) ;
+
+//Interface 3.17 - per-channel transaction counters (see wiringPi.h)
+struct WPIBusStats ;
+int wiringPiSPIStats      (const int channel, struct WPIBusStats *stats) ;
+int wiringPiSPIxStats     (const int number, const int channel, struct WPIBusStats *stats) ;
+
 #ifdef __cplusplus
 }
 #endif
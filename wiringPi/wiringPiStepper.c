@@ -0,0 +1,356 @@
+/*
+ * wiringPiStepper.c:
+ *	Step/direction pulse generator with precomputed acceleration
+ *	ramps.
+ *
+ *	Stepping from a sketch loop of digitalWrite + delayMicroseconds
+ *	falls apart above a few tens of kHz: every late wake-up stretches
+ *	a step and the motor stalls mid-ramp. Here each axis gets its own
+ *	real-time thread working from absolute deadlines like the wave
+ *	engine does, and the whole acceleration ramp is computed once at
+ *	create time - the step loop just indexes a table of intervals, so
+ *	there's no arithmetic (and no square root) between pulses.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "wiringPi.h"
+#include "wiringPiStepper.h"
+
+#define	MAX_STEPPERS		4
+#define	STEPPER_MAX_RAMP	8192	// Ramp steps from standstill to full speed
+#define	STEPPER_MAX_HZ		200000
+#define	STEPPER_PULSE_US	2	// Step pulse width
+#define	STEPPER_SPIN_US		100	// Spin rather than sleep below this - as the wave engine
+
+struct wpiStepper
+{
+  int inUse ;
+  int stepPin, dirPin ;
+  unsigned int rampLen ;
+  unsigned int *rampNs ;	// rampNs [n]: interval after the (n+1)th accel step
+  unsigned int cruiseNs ;
+
+  volatile long long position ;	// __atomic - readable from any thread
+  volatile long long target ;
+  volatile int quitReq ;
+  pthread_t thread ;
+} ;
+
+static struct wpiStepper steppers [MAX_STEPPERS] ;
+
+
+/*
+ * stepperDeadlineWait:
+ *	Wait until an absolute monotonic time - sleep the bulk, spin the
+ *	tail (see waveDeadlineWait, which this mirrors).
+ *********************************************************************************
+ */
+
+static void stepperDeadlineWait (const struct timespec *deadline)
+{
+  struct timespec now ;
+
+  clock_gettime (CLOCK_MONOTONIC, &now) ;
+  long long gapNs = (deadline->tv_sec - now.tv_sec) * 1000000000LL + (deadline->tv_nsec - now.tv_nsec) ;
+
+  if (gapNs > STEPPER_SPIN_US * 1000LL)
+    clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) ;
+
+  do
+    clock_gettime (CLOCK_MONOTONIC, &now) ;
+  while ((now.tv_sec < deadline->tv_sec) ||
+         ((now.tv_sec == deadline->tv_sec) && (now.tv_nsec < deadline->tv_nsec))) ;
+}
+
+
+/*
+ * stepperThread:
+ *	One axis. The speed is just an index into the ramp table: the
+ *	index climbs while accelerating, holds at the cruise interval,
+ *	and falls while decelerating - and since the index is also the
+ *	number of steps needed to stop, the re-plan per step is two
+ *	compares. A retargeted axis decelerates through standstill before
+ *	reversing, so direction changes never skip steps.
+ *********************************************************************************
+ */
+
+static void *stepperThread (void *arg)
+{
+  struct wpiStepper *s = (struct wpiStepper *)arg ;
+  struct timespec deadline ;
+  long long pos, tgt, remaining ;
+  unsigned int idx = 0 ;	// Current ramp index - 0: standstill
+  unsigned int intervalNs ;
+  int dir = 0 ;			// +1 / -1, the dirPin state; 0: not set yet
+  int wantDir, idle = TRUE ;
+
+  piHiPri (90) ;
+  clock_gettime (CLOCK_MONOTONIC, &deadline) ;
+
+  for (;;)
+  {
+    if (s->quitReq)
+      break ;
+
+    pos = s->position ;
+    tgt = __atomic_load_n (&s->target, __ATOMIC_ACQUIRE) ;
+
+    if ((pos == tgt) && (idx == 0))	// Nothing to do - doze, then resync
+    {
+      idle = TRUE ;
+      delay (1) ;
+      continue ;
+    }
+    if (idle)
+    {
+      idle = FALSE ;
+      clock_gettime (CLOCK_MONOTONIC, &deadline) ;
+    }
+
+    wantDir   = (tgt > pos) ? 1 : -1 ;
+    remaining = (tgt > pos) ? (tgt - pos) : (pos - tgt) ;
+
+    if (dir != wantDir)
+    {
+      if (idx > 0)			// Wrong way - ramp down first
+	--idx ;
+      else
+      {
+	dir = wantDir ;			// Reverse at standstill
+	digitalWrite (s->dirPin, (dir > 0) ? HIGH : LOW) ;
+	delayMicroseconds (1) ;		// Direction setup time
+	continue ;
+      }
+    }
+    else if ((pos == tgt) || (remaining <= (long long)idx))
+      --idx ;				// Stopping distance reached
+    else if (idx < s->rampLen)
+      ++idx ;				// Still room to go faster
+
+    if ((idx == 0) && (pos == tgt))
+      continue ;				// Came to rest on target
+
+    intervalNs = (idx >= s->rampLen) ? s->cruiseNs : s->rampNs [(idx == 0) ? 0 : idx - 1] ;
+
+    digitalWrite (s->stepPin, HIGH) ;
+    delayMicroseconds (STEPPER_PULSE_US) ;
+    digitalWrite (s->stepPin, LOW) ;
+    __atomic_store_n (&s->position, pos + dir, __ATOMIC_RELEASE) ;
+
+    deadline.tv_nsec += intervalNs ;
+    while (deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_nsec -= 1000000000L ;
+      ++deadline.tv_sec ;
+    }
+    stepperDeadlineWait (&deadline) ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * stepperCreate:
+ *	Set the pins up, precompute the ramp and start the axis thread.
+ *	maxStepHz caps the step rate (0: 100kHz), accel is in steps/s²
+ *	(0: 2000). Returns the axis handle or -1.
+ *
+ *	The ramp uses the usual linear-acceleration recurrence (AVR446):
+ *	c0 = f·sqrt(2/a), c(n) = c(n-1) - 2·c(n-1)/(4n+1), truncated
+ *	where it reaches the cruise interval or the table limit.
+ *********************************************************************************
+ */
+
+int stepperCreate (int stepPin, int dirPin, unsigned int maxStepHz, unsigned int accel)
+{
+  struct wpiStepper *s = NULL ;
+  unsigned int len ;
+  double c ;
+  int handle ;
+
+  for (handle = 0 ; handle < MAX_STEPPERS ; ++handle)
+    if (!steppers [handle].inUse)
+    {
+      s = &steppers [handle] ;
+      break ;
+    }
+  if (s == NULL)
+    return -1 ;
+
+  if ((maxStepHz == 0) || (maxStepHz > STEPPER_MAX_HZ))
+    maxStepHz = (maxStepHz == 0) ? 100000 : STEPPER_MAX_HZ ;
+  if (accel == 0)
+    accel = 2000 ;
+
+  s->cruiseNs = 1000000000u / maxStepHz ;
+
+  if ((s->rampNs = (unsigned int *)malloc (sizeof (unsigned int) * STEPPER_MAX_RAMP)) == NULL)
+    return -1 ;
+
+  c = 1.0e9 * sqrt (2.0 / (double)accel) ;
+  for (len = 0 ; len < STEPPER_MAX_RAMP ; ++len)
+  {
+    if (c <= (double)s->cruiseNs)
+      break ;
+    s->rampNs [len] = (unsigned int)c ;
+    c -= (2.0 * c) / (double)(4 * (len + 1) + 1) ;
+  }
+  s->rampLen = len ;
+
+  s->stepPin  = stepPin ;
+  s->dirPin   = dirPin ;
+  s->position = 0 ;
+  s->target   = 0 ;
+  s->quitReq  = FALSE ;
+
+  pinMode      (stepPin, OUTPUT) ;
+  pinMode      (dirPin,  OUTPUT) ;
+  digitalWrite (stepPin, LOW) ;
+  digitalWrite (dirPin,  HIGH) ;
+
+  s->inUse = TRUE ;
+  if (pthread_create (&s->thread, NULL, stepperThread, s) != 0)
+  {
+    free (s->rampNs) ;
+    s->rampNs = NULL ;
+    s->inUse  = FALSE ;
+    return -1 ;
+  }
+
+  return handle ;
+}
+
+
+/*
+ * stepperMoveTo:
+ *	Retarget the axis - takes effect on the next step, mid-move or
+ *	not.
+ *********************************************************************************
+ */
+
+int stepperMoveTo (int handle, long long target)
+{
+  if ((handle < 0) || (handle >= MAX_STEPPERS) || !steppers [handle].inUse)
+    return -1 ;
+
+  __atomic_store_n (&steppers [handle].target, target, __ATOMIC_RELEASE) ;
+  return 0 ;
+}
+
+
+/*
+ * stepperPosition:
+ *	Where the axis is right now, in steps.
+ *********************************************************************************
+ */
+
+long long stepperPosition (int handle)
+{
+  if ((handle < 0) || (handle >= MAX_STEPPERS) || !steppers [handle].inUse)
+    return 0 ;
+
+  return __atomic_load_n (&steppers [handle].position, __ATOMIC_ACQUIRE) ;
+}
+
+
+/*
+ * stepperSetPosition:
+ *	Redefine where the axis thinks it is - for homing. Only valid at
+ *	rest (the step loop owns the counter while it's moving).
+ *********************************************************************************
+ */
+
+int stepperSetPosition (int handle, long long position)
+{
+  if ((handle < 0) || (handle >= MAX_STEPPERS) || !steppers [handle].inUse)
+    return -1 ;
+  if (stepperBusy (handle))
+    return -1 ;
+
+  __atomic_store_n (&steppers [handle].position, position, __ATOMIC_RELEASE) ;
+  __atomic_store_n (&steppers [handle].target,   position, __ATOMIC_RELEASE) ;
+  return 0 ;
+}
+
+
+/*
+ * stepperBusy:
+ *	TRUE while the axis is off target.
+ *********************************************************************************
+ */
+
+int stepperBusy (int handle)
+{
+  if ((handle < 0) || (handle >= MAX_STEPPERS) || !steppers [handle].inUse)
+    return FALSE ;
+
+  return __atomic_load_n (&steppers [handle].position, __ATOMIC_ACQUIRE) !=
+	 __atomic_load_n (&steppers [handle].target,   __ATOMIC_ACQUIRE) ;
+}
+
+
+/*
+ * stepperStop:
+ *	Controlled stop - retarget to wherever the axis is, and let the
+ *	ramp bring it to rest a stopping-distance later.
+ *********************************************************************************
+ */
+
+void stepperStop (int handle)
+{
+  if ((handle < 0) || (handle >= MAX_STEPPERS) || !steppers [handle].inUse)
+    return ;
+
+  __atomic_store_n (&steppers [handle].target,
+	__atomic_load_n (&steppers [handle].position, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE) ;
+}
+
+
+/*
+ * stepperDelete:
+ *	Stop dead (no deceleration - the motor may lose steps) and free
+ *	the axis.
+ *********************************************************************************
+ */
+
+void stepperDelete (int handle)
+{
+  struct wpiStepper *s ;
+
+  if ((handle < 0) || (handle >= MAX_STEPPERS) || !steppers [handle].inUse)
+    return ;
+
+  s = &steppers [handle] ;
+  s->quitReq = TRUE ;
+  pthread_join (s->thread, NULL) ;
+
+  digitalWrite (s->stepPin, LOW) ;
+  free (s->rampNs) ;
+  s->rampNs = NULL ;
+  s->inUse  = FALSE ;
+}
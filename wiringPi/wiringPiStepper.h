@@ -0,0 +1,48 @@
+/*
+ * wiringPiStepper.h:
+ *	Step/direction pulse generator with precomputed acceleration
+ *	ramps.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All Interface V3.17. One axis per handle: stepPin pulses, dirPin
+//	HIGH for increasing positions. Targets are absolute positions in
+//	steps and can be changed while a move is in flight - the axis
+//	re-plans on the next step, decelerating through zero first if the
+//	new target is behind it. stepperStop() is a controlled stop (it
+//	just retargets the current position); stepperDelete() stops dead
+//	and frees the axis.
+
+extern int       stepperCreate      (int stepPin, int dirPin, unsigned int maxStepHz, unsigned int accel) ;
+extern int       stepperMoveTo      (int handle, long long target) ;
+extern long long stepperPosition    (int handle) ;
+extern int       stepperSetPosition (int handle, long long position) ;	// Homing - axis must be idle
+extern int       stepperBusy        (int handle) ;
+extern void      stepperStop        (int handle) ;
+extern void      stepperDelete      (int handle) ;
+
+#ifdef __cplusplus
+}
+#endif
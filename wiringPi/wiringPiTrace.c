@@ -0,0 +1,104 @@
+/*
+ * wiringPiTrace.c:
+ *	Hot-path trace hooks - the ring writer. See wiringPiTrace.h for
+ *	the layout; this whole file compiles to nothing unless the build
+ *	enables WIRINGPI_TRACE.
+ *
+ * Copyright (c) 2012-2024 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifdef WIRINGPI_TRACE
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "wiringPiTrace.h"
+
+#define	ENV_TRACE_FILE		"WIRINGPI_TRACE_FILE"
+#define	WPI_TRACE_DEFAULT_FILE	"/dev/shm/wiringpi-trace"
+
+static struct WPITraceRing *traceRing = NULL ;
+static pthread_once_t traceOnce = PTHREAD_ONCE_INIT ;
+
+
+static void traceOpen (void)
+{
+  const char *fileName ;
+  int fd ;
+  void *map ;
+
+  if ((fileName = getenv (ENV_TRACE_FILE)) == NULL)
+    fileName = WPI_TRACE_DEFAULT_FILE ;
+
+  if ((fd = open (fileName, O_CREAT | O_RDWR, 0666)) < 0)
+    return ;				// Tracing silently off
+
+  if (ftruncate (fd, sizeof (struct WPITraceRing)) < 0)
+  {
+    close (fd) ;
+    return ;
+  }
+
+  map = mmap (NULL, sizeof (struct WPITraceRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+  close (fd) ;
+
+  if (map == MAP_FAILED)
+    return ;
+
+  traceRing = (struct WPITraceRing *)map ;
+  traceRing->magic = WPI_TRACE_MAGIC ;
+}
+
+
+/*
+ * wiringPiTraceEmit:
+ *	Stamp one record into the ring. Threads claim slots with a single
+ *	atomic add - no locks on the hot path; a reader treats a slot as
+ *	valid when the stored seq matches its generation.
+ *********************************************************************************
+ */
+
+void wiringPiTraceEmit (int op, int pin, int aux)
+{
+  struct WPITraceRecord *r ;
+  struct timespec now ;
+  unsigned int slot ;
+
+  pthread_once (&traceOnce, traceOpen) ;
+  if (traceRing == NULL)
+    return ;
+
+  slot = __atomic_fetch_add (&traceRing->head, 1, __ATOMIC_RELAXED) ;
+  r    = &traceRing->records [slot & (WPI_TRACE_RECORDS - 1)] ;
+
+  clock_gettime (CLOCK_MONOTONIC, &now) ;
+  r->timeStamp_ns = (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec ;
+  r->op           = (unsigned short)op ;
+  r->pin          = (unsigned short)pin ;
+  r->aux          = (unsigned int)aux ;
+  __atomic_store_n (&r->seq, slot, __ATOMIC_RELEASE) ;
+}
+
+#endif
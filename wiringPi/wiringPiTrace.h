@@ -0,0 +1,87 @@
+/*
+ * wiringPiTrace.h:
+ *	Hot-path trace hooks with compiled-out zero overhead.
+ *
+ *	Build the library with WIRINGPI_TRACE=1 on the make command line
+ *	and the WPI_TRACE() hooks around the hot entry points - pin
+ *	dispatch, I2C/SPI ioctls, ISR delivery - write fixed-size binary
+ *	records into a ring mmap'd from WIRINGPI_TRACE_FILE (default
+ *	/dev/shm/wiringpi-trace). A reader maps the same file and walks
+ *	the records; a record is valid when its seq matches the slot's
+ *	generation. In a normal build the hooks expand to nothing at all.
+ *
+ * Copyright (c) 2012-2024 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifndef	_WIRINGPI_TRACE_H
+#define	_WIRINGPI_TRACE_H
+
+// Operations
+
+#define	WPI_TRACE_DWRITE	1	// pin, aux = value
+#define	WPI_TRACE_DREAD		2	// pin
+#define	WPI_TRACE_PINMODE	3	// pin, aux = mode
+#define	WPI_TRACE_I2C		4	// pin = fd, aux = command
+#define	WPI_TRACE_SPI		5	// pin = channel, aux = length
+#define	WPI_TRACE_ISR		6	// pin, aux = edge
+
+// Ring layout - shared with the reader process
+
+#define	WPI_TRACE_MAGIC		0x57695472
+#define	WPI_TRACE_RECORDS	4096	// Must be a power of two
+
+struct WPITraceRecord
+{
+  unsigned long long timeStamp_ns ;	// CLOCK_MONOTONIC
+  unsigned int seq ;			// Free-running slot number
+  unsigned short op ;			// WPI_TRACE_*
+  unsigned short pin ;
+  unsigned int aux ;
+} ;
+
+struct WPITraceRing
+{
+  unsigned int magic ;
+  unsigned int head ;			// Next slot, free-running
+  struct WPITraceRecord records [WPI_TRACE_RECORDS] ;
+} ;
+
+#ifdef WIRINGPI_TRACE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void wiringPiTraceEmit (int op, int pin, int aux) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#define	WPI_TRACE(op,pin,aux)	wiringPiTraceEmit (op, pin, aux)
+
+#else
+
+#define	WPI_TRACE(op,pin,aux)	do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * wiringPiUring.h:
+ *	Optional io_uring backend for the ISR line-event fds.
+ *	Compiled in with: make WIRINGPI_IOURING=1
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifndef	_WIRINGPI_URING_H
+#define	_WIRINGPI_URING_H
+
+#ifdef WIRINGPI_IOURING
+
+#include <linux/gpio.h>
+
+// The dispatcher runs on the ring thread with a batch of events read
+//	from one line fd - same shape as isrDispatchEvents() in wiringPi.c.
+
+typedef void (*wiringPiUringDispatcher) (int pin, const struct gpio_v2_line_event *evdat, int numEvents) ;
+
+// Internal interface, used by the ISR machinery only. AddLine hands a
+//	line-event fd to the shared ring thread (returns -1 when io_uring
+//	is unavailable - caller falls back to its own poll loop);
+//	RemoveLine waits until the in-flight read on that pin is retired,
+//	after which the fd is safe to close.
+
+extern int wiringPiUringAddLine    (int pin, int fd, wiringPiUringDispatcher dispatch) ;
+extern int wiringPiUringRemoveLine (int pin) ;
+
+#endif
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * wiringPiWave.c:
+ *	Waveform / pulse-train engine for the on-board GPIO.
+ *
+ *	A wave is compiled once from a list of pulses and then played by a
+ *	single real-time thread. Each step is one or two whole-bank register
+ *	stores (via digitalWriteMulti) and the timing works from absolute
+ *	deadlines on the monotonic clock, so late wake-ups don't accumulate
+ *	into drift and sub-100µS gaps are spun out in a hard loop like
+ *	delayMicroseconds does.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "wiringPi.h"
+#include "wiringPiWave.h"
+
+#define	MAX_WAVES	32
+
+// Spin rather than sleep for gaps below this - same threshold as
+//	delayMicroseconds uses.
+
+#define	WAVE_SPIN_US	100
+
+struct wpiWave
+{
+  struct wpiWavePulse *pulses ;
+  int numPulses ;
+  int inUse ;
+} ;
+
+static struct wpiWave waves [MAX_WAVES] ;
+
+static pthread_t       waveThread ;
+static volatile int    waveTxWave   = -1 ;
+static volatile int    waveTxRepeat = 0 ;
+static volatile int    waveTxBusy   = 0 ;
+static volatile int    waveTxStopReq= 0 ;
+static pthread_mutex_t waveMutex    = PTHREAD_MUTEX_INITIALIZER ;
+
+
+/*
+ * waveDeadlineWait:
+ *	Wait until an absolute monotonic time. Long waits sleep with
+ *	TIMER_ABSTIME, the tail is spun out for accuracy.
+ *********************************************************************************
+ */
+
+static void waveDeadlineWait (const struct timespec *deadline)
+{
+  struct timespec now ;
+
+  clock_gettime (CLOCK_MONOTONIC, &now) ;
+  long long gapNs = (deadline->tv_sec - now.tv_sec) * 1000000000LL + (deadline->tv_nsec - now.tv_nsec) ;
+
+  if (gapNs > WAVE_SPIN_US * 1000LL)
+    clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) ;
+
+  do
+    clock_gettime (CLOCK_MONOTONIC, &now) ;
+  while ((now.tv_sec < deadline->tv_sec) ||
+         ((now.tv_sec == deadline->tv_sec) && (now.tv_nsec < deadline->tv_nsec))) ;
+}
+
+
+/*
+ * waveTxThread:
+ *	Play the current wave until done (or forever if repeating), then
+ *	mark the transmitter idle.
+ *********************************************************************************
+ */
+
+static void *waveTxThread (UNU void *dummy)
+{
+  struct timespec deadline ;
+  int i ;
+
+  piHiPri (90) ;
+
+  const struct wpiWave *wave = &waves [waveTxWave] ;
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline) ;
+
+  do
+  {
+    for (i = 0 ; i < wave->numPulses ; ++i)
+    {
+      const struct wpiWavePulse *p = &wave->pulses [i] ;
+
+      if (waveTxStopReq)
+	break ;
+
+      digitalWriteMulti (p->gpioOn | p->gpioOff, p->gpioOn) ;
+
+      deadline.tv_nsec += (long)p->usDelay * 1000L ;
+      while (deadline.tv_nsec >= 1000000000L)
+      {
+	deadline.tv_nsec -= 1000000000L ;
+	++deadline.tv_sec ;
+      }
+      waveDeadlineWait (&deadline) ;
+    }
+  }
+  while (waveTxRepeat && !waveTxStopReq) ;
+
+  waveTxBusy = 0 ;
+  return NULL ;
+}
+
+
+/*
+ * wpiWaveCreate:
+ *	Compile a pulse list into a wave slot. Returns the wave id or -1.
+ *********************************************************************************
+ */
+
+int wpiWaveCreate (const struct wpiWavePulse *pulses, int numPulses)
+{
+  int wave ;
+
+  if ((pulses == NULL) || (numPulses <= 0))
+    return -1 ;
+
+  pthread_mutex_lock (&waveMutex) ;
+
+  for (wave = 0 ; wave < MAX_WAVES ; ++wave)
+    if (!waves [wave].inUse)
+      break ;
+
+  if (wave == MAX_WAVES)
+  {
+    pthread_mutex_unlock (&waveMutex) ;
+    return -1 ;
+  }
+
+  waves [wave].pulses = (struct wpiWavePulse *)malloc (sizeof (struct wpiWavePulse) * numPulses) ;
+  if (waves [wave].pulses == NULL)
+  {
+    pthread_mutex_unlock (&waveMutex) ;
+    return -1 ;
+  }
+
+  memcpy (waves [wave].pulses, pulses, sizeof (struct wpiWavePulse) * numPulses) ;
+  waves [wave].numPulses = numPulses ;
+  waves [wave].inUse     = 1 ;
+
+  pthread_mutex_unlock (&waveMutex) ;
+  return wave ;
+}
+
+
+/*
+ * wpiWaveDelete:
+ *	Release a wave slot. The wave must not be transmitting.
+ *********************************************************************************
+ */
+
+int wpiWaveDelete (int wave)
+{
+  if ((wave < 0) || (wave >= MAX_WAVES) || !waves [wave].inUse)
+    return -1 ;
+
+  if (waveTxBusy && (waveTxWave == wave))
+    return -1 ;
+
+  pthread_mutex_lock (&waveMutex) ;
+  free (waves [wave].pulses) ;
+  waves [wave].pulses    = NULL ;
+  waves [wave].numPulses = 0 ;
+  waves [wave].inUse     = 0 ;
+  pthread_mutex_unlock (&waveMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * wpiWaveTxStart:
+ *	Start sending a wave, optionally repeating until stopped. Only one
+ *	wave can be in flight - returns -1 if the transmitter is busy.
+ *********************************************************************************
+ */
+
+int wpiWaveTxStart (int wave, int repeat)
+{
+  if ((wave < 0) || (wave >= MAX_WAVES) || !waves [wave].inUse)
+    return -1 ;
+
+  if (waveTxBusy)
+    return -1 ;
+
+  waveTxWave    = wave ;
+  waveTxRepeat  = repeat ;
+  waveTxStopReq = 0 ;
+  waveTxBusy    = 1 ;
+
+  if (pthread_create (&waveThread, NULL, waveTxThread, NULL) != 0)
+  {
+    waveTxBusy = 0 ;
+    return -1 ;
+  }
+  return 0 ;
+}
+
+
+/*
+ * wpiWaveTxStop:
+ *	Ask the transmitter to stop at the next pulse boundary and wait for
+ *	it to finish.
+ *********************************************************************************
+ */
+
+int wpiWaveTxStop (void)
+{
+  if (!waveTxBusy)
+    return 0 ;
+
+  waveTxStopReq = 1 ;
+  pthread_join (waveThread, NULL) ;
+  return 0 ;
+}
+
+
+/*
+ * wpiWaveTxBusy:
+ *	TRUE while a wave is being sent.
+ *********************************************************************************
+ */
+
+int wpiWaveTxBusy (void)
+{
+  return waveTxBusy ;
+}
@@ -0,0 +1,68 @@
+/*
+ * wiringPiWave.h:
+ *	Waveform / pulse-train engine for the on-board GPIO.
+ *	Copyright (c) 2012-2025 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifndef	_WIRINGPI_WAVE_H
+#define	_WIRINGPI_WAVE_H
+
+// One step of a waveform: pins to drive high, pins to drive low (both in
+//	BCM numbering, like digitalWriteMulti) and how long to hold the new
+//	state in microseconds before the next step.
+
+struct wpiWavePulse
+{
+  unsigned long long gpioOn ;
+  unsigned long long gpioOff ;
+  unsigned int       usDelay ;
+} ;
+
+// The .wpiwave on-disk format - Interface V3.17
+//	A 24-byte header, then numPulses packed wpiWavePulse records
+//	exactly as the structs lie in memory, so a file mmaps straight
+//	into wpiWaveCreate() with no parse step (see `gpio wave`).
+
+#define	WPI_WAVE_MAGIC	"WPIWAVE1"
+
+struct wpiWaveFileHeader
+{
+  char magic [8] ;
+  unsigned int numPulses ;
+  unsigned int reserved ;
+  unsigned long long pinMask ;	// union of every step's gpioOn|gpioOff (BCM)
+} ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int wpiWaveCreate  (const struct wpiWavePulse *pulses, int numPulses) ;
+extern int wpiWaveDelete  (int wave) ;
+extern int wpiWaveTxStart (int wave, int repeat) ;
+extern int wpiWaveTxStop  (void) ;
+extern int wpiWaveTxBusy  (void) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
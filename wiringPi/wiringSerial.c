@@ -28,12 +28,77 @@
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/serial.h>
 
 #include "wiringSerial.h"
 
+// Receive buffering
+//	One read() per byte is ruinous at high baud rates, so the read side
+//	keeps a per-port buffer filled by large read()s. The buffer is
+//	attached to the fd on first use - ports that only ever use
+//	serialGetchar() the old way just pay one slot lookup per call.
+
+#define	SERIAL_RX_PORTS	8
+#define	SERIAL_RX_SIZE	4096
+
+struct serialRxBuffer
+{
+  int     fd ;
+  int     head ;	// next byte out
+  int     count ;	// bytes buffered
+  uint8_t buf [SERIAL_RX_SIZE] ;
+} ;
+
+static struct serialRxBuffer serialRxBuffers [SERIAL_RX_PORTS] =
+  { [0 ... SERIAL_RX_PORTS - 1] = { .fd = -1 } } ;
+
+
+static struct serialRxBuffer *serialRxFind (const int fd, const int create)
+{
+  int slot, freeSlot = -1 ;
+
+  for (slot = 0 ; slot < SERIAL_RX_PORTS ; ++slot)
+  {
+    if (serialRxBuffers [slot].fd == fd)
+      return &serialRxBuffers [slot] ;
+    if (serialRxBuffers [slot].fd == -1 && freeSlot == -1)
+      freeSlot = slot ;
+  }
+
+  if (!create || freeSlot == -1)
+    return NULL ;
+
+  serialRxBuffers [freeSlot].fd    = fd ;
+  serialRxBuffers [freeSlot].head  = 0 ;
+  serialRxBuffers [freeSlot].count = 0 ;
+  return &serialRxBuffers [freeSlot] ;
+}
+
+
+static int serialRxFill (struct serialRxBuffer *rx)
+{
+  int n ;
+
+  if (rx->count > 0)
+    return rx->count ;
+
+  n = read (rx->fd, rx->buf, SERIAL_RX_SIZE) ;	// VMIN/VTIME rules apply as before
+  if (n <= 0)
+    return n ;
+
+  rx->head  = 0 ;
+  rx->count = n ;
+  return n ;
+}
+
+
 /*
  * serialOpen:
  *	Open and initialise the serial port, setting all the right
@@ -123,6 +188,220 @@ int serialOpen (const char *device, const int baud)
 }
 
 
+// termios2:
+//	The glibc termios API only knows the classic Bxxx constants, but the
+//	kernel takes any integer rate via the termios2 ioctls and BOTHER.
+//	Define the bits here rather than pulling in <asm/termbits.h>, which
+//	can't coexist with <termios.h> in one translation unit.
+
+#define	WPI_NCCS	19
+
+struct wpiTermios2
+{
+  tcflag_t c_iflag ;
+  tcflag_t c_oflag ;
+  tcflag_t c_cflag ;
+  tcflag_t c_lflag ;
+  cc_t     c_line ;
+  cc_t     c_cc [WPI_NCCS] ;
+  speed_t  c_ispeed ;
+  speed_t  c_ospeed ;
+} ;
+
+#ifndef BOTHER
+#define	BOTHER	0010000
+#endif
+
+// Local ioctl numbers - the system TCGETS2/TCSETS2 reference the kernel's
+//	struct termios2, which we deliberately don't have
+
+#define	WPI_TCGETS2	_IOR ('T', 0x2A, struct wpiTermios2)
+#define	WPI_TCSETS2	_IOW ('T', 0x2B, struct wpiTermios2)
+
+
+/*
+ * serialOpenEx:
+ *	As serialOpen, but takes any integer baud rate (using termios2 and
+ *	BOTHER, so 250000 baud DMX or 2M baud RS-485 work natively) plus
+ *	framing and RS-485 option flags.
+ *********************************************************************************
+ */
+
+int serialOpenEx (const char *device, const int baud, const unsigned int flags)
+{
+  struct wpiTermios2 options ;
+  int status, fd ;
+
+  if (baud <= 0)
+    return -2 ;
+
+  if ((fd = open (device, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK)) == -1)
+    return -1 ;
+
+  fcntl (fd, F_SETFL, O_RDWR) ;
+
+// Get and modify current options - raw mode by hand, as cfmakeraw only
+//	knows the glibc termios
+
+  if (ioctl (fd, WPI_TCGETS2, &options) == -1)
+  {
+    close (fd) ;
+    return -1 ;
+  }
+
+    options.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON) ;
+    options.c_oflag &= ~OPOST ;
+    options.c_lflag &= ~(ICANON | ECHO | ECHOE | ECHONL | ISIG) ;
+
+    options.c_cflag &= ~(CBAUD | CSIZE | PARENB | PARODD | CSTOPB) ;
+    options.c_cflag |= BOTHER | CS8 | CLOCAL | CREAD ;
+    options.c_ispeed = baud ;
+    options.c_ospeed = baud ;
+
+    if (flags & (WPI_SERIAL_PARITY_EVEN | WPI_SERIAL_PARITY_ODD))
+      options.c_cflag |= PARENB ;
+    if (flags & WPI_SERIAL_PARITY_ODD)
+      options.c_cflag |= PARODD ;
+    if (flags & WPI_SERIAL_STOPBITS_2)
+      options.c_cflag |= CSTOPB ;
+
+    options.c_cc [VMIN]  =   0 ;
+    options.c_cc [VTIME] = 100 ;	// Ten seconds (100 deciseconds)
+
+  if (ioctl (fd, WPI_TCSETS2, &options) == -1)
+  {
+    close (fd) ;
+    return -1 ;
+  }
+
+  if (flags & WPI_SERIAL_RS485)		// Let the driver work the RTS direction line
+  {
+    struct serial_rs485 rs485 ;
+
+    memset (&rs485, 0, sizeof (rs485)) ;
+    rs485.flags = SER_RS485_ENABLED ;
+    if (flags & WPI_SERIAL_RS485_RTS_LOW)
+      rs485.flags |= SER_RS485_RTS_AFTER_SEND ;
+    else
+      rs485.flags |= SER_RS485_RTS_ON_SEND ;
+
+    if (ioctl (fd, TIOCSRS485, &rs485) == -1)
+    {
+      fprintf (stderr, "serialOpenEx: RS-485 mode not supported on %s\n", device) ;
+      close (fd) ;
+      return -1 ;
+    }
+  }
+  else		// RTS is ours to raise, as serialOpen does
+  {
+    ioctl (fd, TIOCMGET, &status) ;
+
+    status |= TIOCM_DTR ;
+    status |= TIOCM_RTS ;
+
+    ioctl (fd, TIOCMSET, &status) ;
+  }
+
+  usleep (10000) ;	// 10mS
+
+  return fd ;
+}
+
+
+/*
+ * serialSetLowLatency:
+ *	Ask the driver to deliver received bytes immediately instead of
+ *	batching them up. Native UARTs interrupt per FIFO watermark and
+ *	need nothing, but USB adapters run a transfer timer (16mS on the
+ *	common FTDI parts) that sits squarely in every request-response
+ *	turnaround. Sets ASYNC_LOW_LATENCY, and forces the adapter's
+ *	latency_timer to 1mS through sysfs where it has one.
+ *
+ *	Returns the effective receive latency in milliseconds - 0 for a
+ *	native UART, the (re-read) timer value for a USB adapter - or -1
+ *	if the fd isn't a tty.
+ *********************************************************************************
+ */
+
+int serialSetLowLatency (const int fd)
+{
+  struct serial_struct ser ;
+  char sysPath [128], buf [16] ;
+  const char *name ;
+  int sfd, n, latency ;
+
+  if (!isatty (fd))
+    return -1 ;
+
+// The classic knob. Some USB drivers don't implement TIOCSSERIAL -
+//	that's fine, the sysfs timer below is the one that matters there.
+
+  if (ioctl (fd, TIOCGSERIAL, &ser) == 0)
+  {
+    ser.flags |= ASYNC_LOW_LATENCY ;
+    ioctl (fd, TIOCSSERIAL, &ser) ;
+  }
+
+// USB-serial adapters expose their transfer timer in sysfs. Write the
+//	minimum, then read back what the driver actually settled on -
+//	that, not what we asked for, is the latency we report.
+
+  latency = 0 ;
+  if ((name = ttyname (fd)) != NULL && strncmp (name, "/dev/", 5) == 0)
+  {
+    snprintf (sysPath, sizeof (sysPath), "/sys/bus/usb-serial/devices/%s/latency_timer", name + 5) ;
+    if ((sfd = open (sysPath, O_RDWR)) >= 0)
+    {
+      if (write (sfd, "1", 1) < 1)
+	{ /* unwritable (permissions) - report what's there */ }
+      lseek (sfd, 0, SEEK_SET) ;
+      if ((n = read (sfd, buf, sizeof (buf) - 1)) > 0)
+      {
+	buf [n] = 0 ;
+	latency = atoi (buf) ;
+      }
+      close (sfd) ;
+    }
+    else if ((sfd = open (sysPath, O_RDONLY)) >= 0)
+    {
+      if ((n = read (sfd, buf, sizeof (buf) - 1)) > 0)
+      {
+	buf [n] = 0 ;
+	latency = atoi (buf) ;
+      }
+      close (sfd) ;
+    }
+  }
+
+  return latency ;
+}
+
+
+/*
+ * serialOutQueue: serialDrain:
+ *	The kernel-side transmit buffer: how many bytes are still queued
+ *	(and not yet on the wire), and a blocking wait for it to empty.
+ *	An RS-485 master must not open the line to a slave's reply while
+ *	its own request is still draining.
+ *********************************************************************************
+ */
+
+int serialOutQueue (const int fd)
+{
+  int pending ;
+
+  if (ioctl (fd, TIOCOUTQ, &pending) == -1)
+    return -1 ;
+
+  return pending ;
+}
+
+void serialDrain (const int fd)
+{
+  tcdrain (fd) ;
+}
+
+
 /*
  * serialFlush:
  *	Flush the serial buffers (both tx & rx)
@@ -131,6 +410,11 @@ int serialOpen (const char *device, const int baud)
 
 void serialFlush (const int fd)
 {
+  struct serialRxBuffer *rx = serialRxFind (fd, 0) ;
+
+  if (rx != NULL)
+    rx->count = 0 ;
+
   tcflush (fd, TCIOFLUSH) ;
 }
 
@@ -143,10 +427,380 @@ void serialFlush (const int fd)
 
 void serialClose (const int fd)
 {
+  struct serialRxBuffer *rx = serialRxFind (fd, 0) ;
+
+  if (rx != NULL)
+  {
+    rx->fd    = -1 ;
+    rx->count =  0 ;
+  }
+
   close (fd) ;
 }
 
 
+// From wiringPi.c - the shared epoll event loop (declared here rather
+//	than pulling all of wiringPi.h into this file)
+
+extern int wiringPiEventLoopAddFd    (int fd, void (*function)(int fd, void *userdata), void *userdata) ;
+extern int wiringPiEventLoopRemoveFd (int fd) ;
+
+// Receive callbacks
+//	Polling serialDataAvail() across several ports burns constant
+//	wakeups for data that mostly isn't there. serialOnData() parks the
+//	fd in the shared epoll event loop instead: the loop thread drains
+//	whatever arrived and hands it to the callback, so idle ports cost
+//	nothing and a busy one reacts as soon as the kernel has bytes.
+
+#define	SERIAL_CB_PORTS	8
+
+struct serialRxWatch
+{
+  int fd ;			// -1: slot free
+  serialDataCallback callback ;
+  void *userdata ;
+} ;
+
+static struct serialRxWatch serialRxWatches [SERIAL_CB_PORTS] =
+  { [0 ... SERIAL_CB_PORTS - 1] = { .fd = -1 } } ;
+
+
+static void serialRxDispatch (int fd, void *userdata)
+{
+  struct serialRxWatch *w = (struct serialRxWatch *)userdata ;
+  unsigned char buf [SERIAL_RX_SIZE] ;
+  int n ;
+
+  n = read (fd, buf, sizeof (buf)) ;	// The loop said readable - this returns at once
+  if (n > 0 && w->callback != NULL)
+    w->callback (fd, buf, n, w->userdata) ;
+}
+
+
+/*
+ * serialOnData:
+ *	Deliver received bytes to a callback (run on the event loop
+ *	thread) instead of being polled for. A NULL callback unregisters
+ *	the port. Don't mix with serialGetchar/serialRead on the same fd -
+ *	whoever reads first gets the bytes.
+ *********************************************************************************
+ */
+
+int serialOnData (const int fd, serialDataCallback callback, void *userdata)
+{
+  int slot, freeSlot = -1 ;
+
+  for (slot = 0 ; slot < SERIAL_CB_PORTS ; ++slot)
+  {
+    if (serialRxWatches [slot].fd == fd)
+      break ;
+    if (serialRxWatches [slot].fd == -1 && freeSlot == -1)
+      freeSlot = slot ;
+  }
+
+  if (callback == NULL)			// Unregister
+  {
+    if (slot == SERIAL_CB_PORTS)
+      return -1 ;
+    wiringPiEventLoopRemoveFd (fd) ;
+    serialRxWatches [slot].fd = -1 ;
+    return 0 ;
+  }
+
+  if (slot < SERIAL_CB_PORTS)		// Re-register: just swap the callback
+  {
+    serialRxWatches [slot].callback = callback ;
+    serialRxWatches [slot].userdata = userdata ;
+    return 0 ;
+  }
+
+  if (freeSlot == -1)
+    return -1 ;
+
+  serialRxWatches [freeSlot].callback = callback ;
+  serialRxWatches [freeSlot].userdata = userdata ;
+  serialRxWatches [freeSlot].fd       = fd ;
+
+  if (wiringPiEventLoopAddFd (fd, serialRxDispatch, &serialRxWatches [freeSlot]) != 0)
+  {
+    serialRxWatches [freeSlot].fd = -1 ;
+    return -1 ;
+  }
+
+  return 0 ;
+}
+
+
+// Transmit ring
+//	write() blocks once the kernel queue fills - a surprise stall in
+//	whatever thread produced the data. serialTxStart() hangs a ring on
+//	the fd with a background writer draining it: producers memcpy into
+//	the ring and leave, and what happens on overflow is a declared
+//	policy instead of a stall. The ring is a classic single-producer
+//	single-consumer pair of free-running indices, so the enqueue path
+//	takes no lock; one producing thread per port.
+
+#define	SERIAL_TX_PORTS	4
+#define	SERIAL_TX_SIZE	65536		// Power of two
+
+struct serialTxRing
+{
+  int fd ;				// -1: slot free
+  int policy ;
+  volatile unsigned int head ;		// writer thread consumes here
+  volatile unsigned int tail ;		// producer fills here
+  volatile int running ;
+  int lowWater, highWater ;
+  serialTxCallback onLow, onHigh ;
+  pthread_t thread ;
+  uint8_t buf [SERIAL_TX_SIZE] ;
+} ;
+
+static struct serialTxRing serialTxRings [SERIAL_TX_PORTS] =
+  { [0 ... SERIAL_TX_PORTS - 1] = { .fd = -1 } } ;
+
+
+static struct serialTxRing *serialTxFind (const int fd)
+{
+  int slot ;
+
+  for (slot = 0 ; slot < SERIAL_TX_PORTS ; ++slot)
+    if (serialTxRings [slot].fd == fd)
+      return &serialTxRings [slot] ;
+
+  return NULL ;
+}
+
+
+/*
+ * serialTxWriter:
+ *	The drain thread: write out the largest contiguous run, advance
+ *	head, fire the low watermark on the way down. Keeps going until
+ *	stopped AND empty, so a stop drains.
+ *********************************************************************************
+ */
+
+static void *serialTxWriter (void *arg)
+{
+  struct serialTxRing *tx = (struct serialTxRing *)arg ;
+  unsigned int head, tail, off, n ;
+  int written, before, after ;
+
+  for (;;)
+  {
+    head = tx->head ;
+    tail = __atomic_load_n (&tx->tail, __ATOMIC_ACQUIRE) ;
+
+    if (head == tail)
+    {
+      if (!tx->running)
+	break ;
+      usleep (1000) ;
+      continue ;
+    }
+
+    off = head & (SERIAL_TX_SIZE - 1) ;
+    n   = tail - head ;
+    if (n > SERIAL_TX_SIZE - off)	// Stop at the wrap - next pass gets the rest
+      n = SERIAL_TX_SIZE - off ;
+
+    written = write (tx->fd, tx->buf + off, n) ;
+    if (written <= 0)
+    {
+      usleep (1000) ;			// Transient (or the port died) - don't spin
+      continue ;
+    }
+
+// An overwriting producer may have moved head past us while we were in
+//	write() - the CAS simply loses then, nothing to redo
+
+    before = (int)(tail - head) ;
+    __atomic_compare_exchange_n (&tx->head, &head, head + written,
+					0, __ATOMIC_RELEASE, __ATOMIC_RELAXED) ;
+
+    after = (int)(__atomic_load_n (&tx->tail, __ATOMIC_ACQUIRE) - tx->head) ;
+    if (tx->onLow != NULL && after <= tx->lowWater && before > tx->lowWater)
+      tx->onLow (tx->fd, after) ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * serialTxStart:
+ *	Attach a transmit ring to the port and start its writer. policy
+ *	says what an enqueue finding the ring full does: drop the new
+ *	bytes, overwrite the oldest, or wait for room.
+ *********************************************************************************
+ */
+
+int serialTxStart (const int fd, const int policy)
+{
+  struct serialTxRing *tx ;
+  int slot ;
+
+  if (policy < WPI_SERIAL_TX_DROP || policy > WPI_SERIAL_TX_BLOCK)
+    return -1 ;
+  if (serialTxFind (fd) != NULL)
+    return -1 ;			// Already running on this port
+
+  tx = NULL ;
+  for (slot = 0 ; slot < SERIAL_TX_PORTS ; ++slot)
+    if (serialTxRings [slot].fd == -1)
+    {
+      tx = &serialTxRings [slot] ;
+      break ;
+    }
+  if (tx == NULL)
+    return -1 ;
+
+  tx->policy    = policy ;
+  tx->head      = tx->tail = 0 ;
+  tx->lowWater  = tx->highWater = 0 ;
+  tx->onLow     = tx->onHigh    = NULL ;
+  tx->running   = 1 ;
+
+  if (pthread_create (&tx->thread, NULL, serialTxWriter, tx) != 0)
+  {
+    tx->running = 0 ;
+    return -1 ;
+  }
+
+  tx->fd = fd ;
+  return 0 ;
+}
+
+
+/*
+ * serialTxWatermarks:
+ *	Optional callbacks: onHigh fires from the producer when an enqueue
+ *	takes the fill level up through highWater, onLow from the writer
+ *	thread when a drain brings it down through lowWater.
+ *********************************************************************************
+ */
+
+int serialTxWatermarks (const int fd, const int lowWater, const int highWater,
+				serialTxCallback onLow, serialTxCallback onHigh)
+{
+  struct serialTxRing *tx = serialTxFind (fd) ;
+
+  if (tx == NULL || lowWater < 0 || highWater < lowWater || highWater > SERIAL_TX_SIZE)
+    return -1 ;
+
+  tx->lowWater  = lowWater ;
+  tx->highWater = highWater ;
+  tx->onLow     = onLow ;
+  tx->onHigh    = onHigh ;
+  return 0 ;
+}
+
+
+/*
+ * serialTxQueue:
+ *	Enqueue len bytes; returns how many were accepted (under the drop
+ *	policy that can be fewer - the rest were dropped, and you know).
+ *********************************************************************************
+ */
+
+int serialTxQueue (const int fd, const unsigned char *buf, const int len)
+{
+  struct serialTxRing *tx = serialTxFind (fd) ;
+  unsigned int head, tail, space, off, n ;
+  int left, queued = 0, before ;
+
+  if (tx == NULL || len < 0)
+    return -1 ;
+
+  left = len ;
+  while (left > 0)
+  {
+    head  = __atomic_load_n (&tx->head, __ATOMIC_ACQUIRE) ;
+    tail  = tx->tail ;
+    space = SERIAL_TX_SIZE - (tail - head) ;
+
+    if (space == 0)
+    {
+      if (tx->policy == WPI_SERIAL_TX_DROP)
+	break ;
+      if (tx->policy == WPI_SERIAL_TX_BLOCK)
+      {
+	usleep (100) ;
+	continue ;
+      }
+
+// Overwrite: discard the oldest bytes to make room. If the writer
+//	advances head first our CAS loses and we just look again.
+
+      n = (unsigned int)left > SERIAL_TX_SIZE / 4 ? SERIAL_TX_SIZE / 4 : (unsigned int)left ;
+      __atomic_compare_exchange_n (&tx->head, &head, head + n,
+					0, __ATOMIC_RELEASE, __ATOMIC_RELAXED) ;
+      continue ;
+    }
+
+    n = (unsigned int)left < space ? (unsigned int)left : space ;
+    off = tail & (SERIAL_TX_SIZE - 1) ;
+    if (n > SERIAL_TX_SIZE - off)	// Two memcpys around the wrap
+    {
+      memcpy (tx->buf + off, buf + queued, SERIAL_TX_SIZE - off) ;
+      memcpy (tx->buf, buf + queued + (SERIAL_TX_SIZE - off), n - (SERIAL_TX_SIZE - off)) ;
+    }
+    else
+      memcpy (tx->buf + off, buf + queued, n) ;
+
+    before = (int)(tail - head) ;
+    __atomic_store_n (&tx->tail, tail + n, __ATOMIC_RELEASE) ;
+
+    queued += n ;
+    left   -= n ;
+
+    if (tx->onHigh != NULL && before + (int)n >= tx->highWater && before < tx->highWater)
+      tx->onHigh (tx->fd, before + (int)n) ;
+  }
+
+  return queued ;
+}
+
+
+/*
+ * serialTxPending:
+ *	Bytes sitting in the ring (the kernel queue is extra - see
+ *	serialOutQueue for that side).
+ *********************************************************************************
+ */
+
+int serialTxPending (const int fd)
+{
+  struct serialTxRing *tx = serialTxFind (fd) ;
+
+  if (tx == NULL)
+    return -1 ;
+
+  return (int)(tx->tail - tx->head) ;
+}
+
+
+/*
+ * serialTxStop:
+ *	Drain what's queued, stop the writer, detach the ring. The port
+ *	itself stays open and the direct-write calls keep working.
+ *********************************************************************************
+ */
+
+int serialTxStop (const int fd)
+{
+  struct serialTxRing *tx = serialTxFind (fd) ;
+
+  if (tx == NULL)
+    return -1 ;
+
+  tx->running = 0 ;
+  pthread_join (tx->thread, NULL) ;
+  tx->fd = -1 ;
+  return 0 ;
+}
+
+
 /*
  * serialPutchar:
  *	Send a single character to the serial port
@@ -155,6 +809,11 @@ void serialClose (const int fd)
 
 void serialPutchar(const int fd, const unsigned char c)
 {
+    if (serialTxFind (fd) != NULL) {
+      serialTxQueue (fd, &c, 1) ;
+      return ;
+    }
+
     ssize_t bytes_written = write(fd, &c, 1);
     if (bytes_written != 1) {
       perror("Error writing to file descriptor");
@@ -171,12 +830,68 @@ void serialPutchar(const int fd, const unsigned char c)
 void serialPuts(const int fd, const char *s)
 {
     size_t len = strlen(s);
+
+    if (serialTxFind (fd) != NULL) {
+      serialTxQueue (fd, (const unsigned char *)s, (int)len) ;
+      return ;
+    }
+
     ssize_t bytes_written = write(fd, s, len);
     if (bytes_written != (ssize_t)len) {
       perror("Error writing to file descriptor");
     }
 }
 
+/*
+ * serialWrite:
+ *	Send a block of bytes of known length - no strlen, and binary
+ *	safe (embedded zeros are fine)
+ *********************************************************************************
+ */
+
+void serialWrite (const int fd, const unsigned char *buf, const int len)
+{
+    if (serialTxFind (fd) != NULL) {
+      serialTxQueue (fd, buf, len) ;
+      return ;
+    }
+
+    ssize_t bytes_written = write(fd, buf, len);
+    if (bytes_written != (ssize_t)len) {
+      perror("Error writing to file descriptor");
+    }
+}
+
+
+/*
+ * serialWritev:
+ *	Send several buffers as one writev() syscall - e.g. header,
+ *	payload and CRC - without gathering them into a scratch buffer
+ *	first
+ *********************************************************************************
+ */
+
+void serialWritev (const int fd, const struct iovec *iov, const int iovcnt)
+{
+    ssize_t total = 0 ;
+    int i ;
+
+    for (i = 0 ; i < iovcnt ; ++i)
+      total += iov [i].iov_len ;
+
+    if (serialTxFind (fd) != NULL) {	// Queued piecewise - the ring keeps the order
+      for (i = 0 ; i < iovcnt ; ++i)
+        serialTxQueue (fd, (const unsigned char *)iov [i].iov_base, (int)iov [i].iov_len) ;
+      return ;
+    }
+
+    ssize_t bytes_written = writev(fd, iov, iovcnt);
+    if (bytes_written != total) {
+      perror("Error writing to file descriptor");
+    }
+}
+
+
 /*
  * serialPrintf:
  *	Printf over Serial
@@ -187,12 +902,18 @@ void serialPrintf (const int fd, const char *message, ...)
 {
   va_list argp ;
   char buffer [1024] ;
+  int  len ;
 
   va_start (argp, message) ;
-    vsnprintf (buffer, 1023, message, argp) ;
+    len = vsnprintf (buffer, 1023, message, argp) ;
   va_end (argp) ;
 
-  serialPuts (fd, buffer) ;
+  if (len < 0)
+    return ;
+  if (len > 1023)	// Truncated
+    len = 1023 ;
+
+  serialWrite (fd, (unsigned char *)buffer, len) ;	// vsnprintf told us the length
 }
 
 
@@ -204,8 +925,12 @@ void serialPrintf (const int fd, const char *message, ...)
 
 int serialDataAvail (const int fd)
 {
+  struct serialRxBuffer *rx = serialRxFind (fd, 0) ;
   int result ;
 
+  if ((rx != NULL) && (rx->count > 0))	// Already buffered - no ioctl needed
+    return rx->count ;
+
   if (ioctl (fd, FIONREAD, &result) == -1)
     return -1 ;
 
@@ -223,10 +948,274 @@ int serialDataAvail (const int fd)
 
 int serialGetchar (const int fd)
 {
+  struct serialRxBuffer *rx = serialRxFind (fd, 1) ;
   uint8_t x ;
 
-  if (read (fd, &x, 1) != 1)
+  if (rx == NULL)	// All slots in use: plain read as before
+  {
+    if (read (fd, &x, 1) != 1)
+      return -1 ;
+    return ((int)x) & 0xFF ;
+  }
+
+  if (serialRxFill (rx) <= 0)
     return -1 ;
 
-  return ((int)x) & 0xFF ;
+  --rx->count ;
+  return ((int)rx->buf [rx->head++]) & 0xFF ;
+}
+
+
+/*
+ * serialRead:
+ *	Get up to len bytes from the serial device in one call. Returns
+ *	the number of bytes read - possibly fewer than asked for, zero on
+ *	the 10 second timeout - or -1 on error.
+ *********************************************************************************
+ */
+
+int serialRead (const int fd, unsigned char *buf, const int len)
+{
+  struct serialRxBuffer *rx = serialRxFind (fd, 1) ;
+  int n ;
+
+  if (len <= 0)
+    return 0 ;
+
+  if (rx == NULL)	// All slots in use: plain read as before
+    return read (fd, buf, len) ;
+
+  n = serialRxFill (rx) ;
+  if (n <= 0)
+    return n ;
+
+  if (n > len)
+    n = len ;
+
+  memcpy (buf, &rx->buf [rx->head], n) ;
+  rx->head  += n ;
+  rx->count -= n ;
+  return n ;
+}
+
+
+/*
+ * serialReadLine:
+ *	Read characters up to a newline (or the buffer limit). CR and LF
+ *	are stripped and the line is zero terminated. Returns the line
+ *	length, or -1 if nothing arrived before the timeout.
+ *********************************************************************************
+ */
+
+int serialReadLine (const int fd, char *line, const int maxLen)
+{
+  int c, len = 0 ;
+
+  if (maxLen < 1)
+    return -1 ;
+
+  while (len < (maxLen - 1))
+  {
+    if ((c = serialGetchar (fd)) == -1)
+    {
+      if (len == 0)
+	return -1 ;
+      break ;
+    }
+
+    if (c == '\n')
+      break ;
+    if (c == '\r')
+      continue ;
+
+    line [len++] = (char)c ;
+  }
+
+  line [len] = 0 ;
+  return len ;
+}
+
+
+/*
+ * serialBridge:
+ *	Forward everything arriving on fdIn to fdOut entirely in-kernel:
+ *	a background thread splice()s input into a pipe and splices the
+ *	pipe onward, so an RS-485-to-TCP gateway moves its bytes with
+ *	zero userspace copies instead of two copies and two syscalls per
+ *	byte. serialBridgeTap() tee()s a live copy of the stream into a
+ *	third fd for monitoring without disturbing the main path, and
+ *	serialBridgeBytes() reports the running total forwarded.
+ *	One direction per bridge - a full gateway is two of them.
+ *	Returns a handle, or -1.
+ *********************************************************************************
+ */
+
+#define	SERIAL_BRIDGES		4
+#define	SERIAL_BRIDGE_CHUNK	65536
+
+static struct serialBridgeData
+{
+  int fdIn ;
+  int fdOut ;
+  int pipeFds [2] ;		// the splice transit pipe
+  int tapPipe [2] ;		// tee target, then spliced on to tapFd
+  int tapFd ;			// -1: no tap
+  volatile int running ;
+  unsigned long long bytes ;
+  pthread_t thread ;
+} serialBridges [SERIAL_BRIDGES] = { [0 ... SERIAL_BRIDGES - 1] = { .fdIn = -1 } } ;
+
+static void *serialBridgeWorker (void *data)
+{
+  struct serialBridgeData *bridge = (struct serialBridgeData *)data ;
+  struct pollfd pfd ;
+  ssize_t got, sent ;
+  int tap ;
+
+  pfd.fd     = bridge->fdIn ;
+  pfd.events = POLLIN ;
+
+  while (bridge->running)
+  {
+    if (poll (&pfd, 1, 200) <= 0)	// timeout: re-check running
+      continue ;
+    if ((pfd.revents & (POLLERR | POLLHUP)) != 0)
+      break ;
+
+    got = splice (bridge->fdIn, NULL, bridge->pipeFds [1], NULL, SERIAL_BRIDGE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE) ;
+    if (got == 0)			// EOF - peer gone
+      break ;
+    if (got < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+	continue ;
+      break ;
+    }
+
+// A tap gets its copy first - tee() duplicates the pipe contents
+//	without consuming them, then a second splice drains the copy to
+//	wherever the monitor fd points. Best effort: a wedged tap drops
+//	its copy rather than stalling the bridge.
+
+    tap = __atomic_load_n (&bridge->tapFd, __ATOMIC_ACQUIRE) ;
+    if (tap >= 0)
+      if (tee (bridge->pipeFds [0], bridge->tapPipe [1], (size_t)got, SPLICE_F_NONBLOCK) > 0)
+	(void)splice (bridge->tapPipe [0], NULL, tap, NULL, (size_t)got, SPLICE_F_MOVE | SPLICE_F_NONBLOCK) ;
+
+    while (got > 0)
+    {
+      sent = splice (bridge->pipeFds [0], NULL, bridge->fdOut, NULL, (size_t)got, SPLICE_F_MOVE | SPLICE_F_MORE) ;
+      if (sent <= 0)
+      {
+	if (sent < 0 && errno == EINTR)
+	  continue ;
+	bridge->running = 0 ;
+	break ;
+      }
+      got -= sent ;
+      __atomic_add_fetch (&bridge->bytes, (unsigned long long)sent, __ATOMIC_RELAXED) ;
+    }
+  }
+
+  return NULL ;
+}
+
+int serialBridge (const int fdIn, const int fdOut, const unsigned int opts)
+{
+  struct serialBridgeData *bridge ;
+  int handle ;
+
+  (void)opts ;				// reserved
+
+  if (fdIn < 0 || fdOut < 0)
+    return -1 ;
+
+  for (handle = 0 ; handle < SERIAL_BRIDGES ; ++handle)
+    if (serialBridges [handle].fdIn < 0)
+      break ;
+  if (handle == SERIAL_BRIDGES)
+    return -1 ;
+
+  bridge = &serialBridges [handle] ;
+  if (pipe (bridge->pipeFds) != 0)
+    return -1 ;
+  if (pipe (bridge->tapPipe) != 0)
+  {
+    close (bridge->pipeFds [0]) ;
+    close (bridge->pipeFds [1]) ;
+    return -1 ;
+  }
+
+  bridge->fdOut   = fdOut ;
+  bridge->tapFd   = -1 ;
+  bridge->bytes   = 0 ;
+  bridge->running = 1 ;
+
+  if (pthread_create (&bridge->thread, NULL, serialBridgeWorker, bridge) != 0)
+  {
+    close (bridge->pipeFds [0]) ; close (bridge->pipeFds [1]) ;
+    close (bridge->tapPipe [0]) ; close (bridge->tapPipe [1]) ;
+    return -1 ;
+  }
+
+  bridge->fdIn = fdIn ;			// claims the slot
+  return handle ;
+}
+
+
+/*
+ * serialBridgeTap:
+ *	Duplicate the bridged stream into another fd (a capture file, a
+ *	logging socket). -1 turns the tap off. Best effort - the tap
+ *	never stalls the bridge.
+ *********************************************************************************
+ */
+
+int serialBridgeTap (const int handle, const int tapFd)
+{
+  if (handle < 0 || handle >= SERIAL_BRIDGES || serialBridges [handle].fdIn < 0)
+    return -1 ;
+
+  __atomic_store_n (&serialBridges [handle].tapFd, tapFd, __ATOMIC_RELEASE) ;
+  return 0 ;
+}
+
+
+/*
+ * serialBridgeBytes:
+ *	Running total of bytes forwarded by a bridge.
+ *********************************************************************************
+ */
+
+unsigned long long serialBridgeBytes (const int handle)
+{
+  if (handle < 0 || handle >= SERIAL_BRIDGES || serialBridges [handle].fdIn < 0)
+    return 0 ;
+
+  return __atomic_load_n (&serialBridges [handle].bytes, __ATOMIC_RELAXED) ;
+}
+
+
+/*
+ * serialBridgeStop:
+ *	Stop a bridge and release its slot. The worker notices within
+ *	its 200mS poll tick; the bridged fds themselves stay open - they
+ *	belong to the caller.
+ *********************************************************************************
+ */
+
+void serialBridgeStop (const int handle)
+{
+  struct serialBridgeData *bridge ;
+
+  if (handle < 0 || handle >= SERIAL_BRIDGES || serialBridges [handle].fdIn < 0)
+    return ;
+
+  bridge = &serialBridges [handle] ;
+  bridge->running = 0 ;
+  pthread_join (bridge->thread, NULL) ;
+
+  close (bridge->pipeFds [0]) ; close (bridge->pipeFds [1]) ;
+  close (bridge->tapPipe [0]) ; close (bridge->tapPipe [1]) ;
+  bridge->fdIn = -1 ;
 }
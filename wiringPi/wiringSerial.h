@@ -20,19 +20,80 @@
  ***********************************************************************
  */
 
+#include <sys/uio.h>
+
+// Option flags for serialOpenEx()
+//	Interface V3.17
+
+#define	WPI_SERIAL_PARITY_EVEN		0x01
+#define	WPI_SERIAL_PARITY_ODD		0x02
+#define	WPI_SERIAL_STOPBITS_2		0x04
+#define	WPI_SERIAL_RS485		0x08	// driver asserts RTS while sending
+#define	WPI_SERIAL_RS485_RTS_LOW	0x10	// ... active low instead
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern int   serialOpen      (const char *device, const int baud) ;
+extern int   serialOpenEx    (const char *device, const int baud, const unsigned int flags) ;  //Interface 3.17
 extern void  serialClose     (const int fd) ;
 extern void  serialFlush     (const int fd) ;
+
+// Interface V3.17 - receive latency and kernel transmit queue control.
+//	serialSetLowLatency returns the effective latency in mS (0 for a
+//	native UART, the adapter's transfer timer for USB serial).
+
+extern int   serialSetLowLatency (const int fd) ;
+extern int   serialOutQueue      (const int fd) ;   // bytes queued, not yet on the wire
+extern void  serialDrain         (const int fd) ;   // block until the queue empties
 extern void  serialPutchar   (const int fd, const unsigned char c) ;
 extern void  serialPuts      (const int fd, const char *s) ;
 extern void  serialPrintf    (const int fd, const char *message, ...) ;
+extern void  serialWrite     (const int fd, const unsigned char *buf, const int len) ;      //Interface 3.17
+extern void  serialWritev    (const int fd, const struct iovec *iov, const int iovcnt) ;    //Interface 3.17
 extern int   serialDataAvail (const int fd) ;
 extern int   serialGetchar   (const int fd) ;
 
+//Interface 3.17 - buffered bulk receive
+extern int   serialRead      (const int fd, unsigned char *buf, const int len) ;
+extern int   serialReadLine  (const int fd, char *line, const int maxLen) ;
+
+// Interface V3.17 - event-driven receive: the callback runs on the shared
+//	event loop thread with whatever bytes arrived. NULL unregisters.
+//	Don't mix with serialGetchar/serialRead on the same fd.
+
+typedef void (*serialDataCallback) (const int fd, const unsigned char *buf, const int len, void *userdata) ;
+
+extern int   serialOnData (const int fd, serialDataCallback callback, void *userdata) ;
+
+// Interface V3.17 - asynchronous transmit: a per-port ring drained by a
+//	background writer. Producers enqueue without blocking; the policy
+//	says what a full ring does. Once started, serialPutchar/Puts/
+//	Write/Writev on that fd go through the ring automatically.
+
+#define	WPI_SERIAL_TX_DROP	0	// full: new bytes are discarded
+#define	WPI_SERIAL_TX_OVERWRITE	1	// full: oldest bytes are discarded
+#define	WPI_SERIAL_TX_BLOCK	2	// full: enqueue waits for room
+
+typedef void (*serialTxCallback) (const int fd, const int queued) ;
+
+extern int   serialTxStart      (const int fd, const int policy) ;
+extern int   serialTxWatermarks (const int fd, const int lowWater, const int highWater,
+					serialTxCallback onLow, serialTxCallback onHigh) ;
+extern int   serialTxQueue      (const int fd, const unsigned char *buf, const int len) ;
+extern int   serialTxPending    (const int fd) ;
+extern int   serialTxStop       (const int fd) ;   // drains, then detaches
+
+// Interface V3.17 - in-kernel forwarding: a background thread splices
+//	fdIn to fdOut through a pipe with zero userspace copies. One
+//	direction per bridge; opts is reserved (pass 0).
+
+extern int                serialBridge      (const int fdIn, const int fdOut, const unsigned int opts) ;
+extern int                serialBridgeTap   (const int handle, const int tapFd) ;  // tee a live copy, -1 off
+extern unsigned long long serialBridgeBytes (const int handle) ;
+extern void               serialBridgeStop  (const int handle) ;
+
 #ifdef __cplusplus
 }
 #endif
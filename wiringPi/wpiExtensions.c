@@ -33,6 +33,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <fcntl.h>
 
@@ -58,6 +59,7 @@
 #include "drcNet.h"
 #include "../wiringPiD/drcNetCmd.h"
 #include "pseudoPins.h"
+#include "gpioChip.h"
 #include "bmp180.h"
 #include "htu21d.h"
 #include "ds18b20.h"
@@ -66,6 +68,7 @@
 #include "wpiExtensions.h"
 
 extern int wiringPiDebug ;
+extern void *wiringPiExtensionAlloc (size_t size) ;	// the extension arena, wiringPi.c
 
 static int verbose ;
 static char errorMessage [1024] ;
@@ -180,7 +183,7 @@ static char *extractStr (char *progName, char *p, char **str)
       ++q ;
   }
 
-  *str = r = calloc (q - p + 2, 1) ;	// Zeros it
+  *str = r = wiringPiExtensionAlloc (q - p + 2) ;	// Zeroed; freed with the arena
 
   while (p != q)
     *r++ = *p++ ;
@@ -471,6 +474,33 @@ static int doExtensionPseudoPins (UNU char *progName, int pinBase, UNU char *par
 }
 
 
+/*
+ * doExtensionGpioChip:
+ *	Another kernel gpiochip character device
+ *	gpiochip:base:chipNum
+ *********************************************************************************
+ */
+
+static int doExtensionGpioChip (char *progName, int pinBase, char *params)
+{
+  char device [32] ;
+  int chipNum ;
+
+  if ((params = extractInt (progName, params, &chipNum)) == NULL)
+    return FALSE ;
+
+  if ((chipNum < 0) || (chipNum > 99))
+  {
+    verbError ("%s: gpiochip number (%d) out of range", progName, chipNum) ;
+    return FALSE ;
+  }
+
+  sprintf (device, "/dev/gpiochip%d", chipNum) ;
+
+  return wiringPiAttachChip (device, pinBase) ;
+}
+
+
 /*
  * doExtensionBmp180:
  *	Analog Temp + Pressure
@@ -841,6 +871,7 @@ static struct extensionFunctionStruct extensionFunctions [] =
   { "pcf8591",		&doExtensionPcf8591	},
   { "bmp180",		&doExtensionBmp180	},
   { "pseudoPins",	&doExtensionPseudoPins	},
+  { "gpiochip",		&doExtensionGpioChip	},
   { "htu21d",		&doExtensionHtu21d	},
   { "ds18b20",		&doExtensionDs18b20	},
   { "rht03",		&doExtensionRht03	},
@@ -926,3 +957,276 @@ int loadWPiExtension (char *progName, char *extensionData, int printErrors)
   fprintf (stderr, "%s: extension %s not found", progName, extension) ;
   return FALSE ;
 }
+
+
+// Table loading:
+//	Starting a panel's worth of extensions one blocking setup after
+//	another serialises every device's probe I/O. The table loader runs
+//	the entries flagged PARALLEL on their own threads (devices on
+//	distinct buses genuinely overlap; two on one I2C bus just queue in
+//	the kernel) and TRUST entries with wpiExtensionTrust raised so
+//	drivers that can skip their start-up reads do.
+
+int wpiExtensionTrust = FALSE ;
+
+struct extensionThreadStruct
+{
+  char *progName ;
+  char *extension ;	// Our own copy - loadWPiExtension scribbles on it
+  pthread_t thread ;
+  int result ;
+} ;
+
+static void *extensionThread (void *arg)
+{
+  struct extensionThreadStruct *t = (struct extensionThreadStruct *)arg ;
+
+  t->result = loadWPiExtension (t->progName, t->extension, verbose) ;
+  return NULL ;
+}
+
+
+/*
+ * loadWPiExtensionPhase:
+ *	Run every table entry whose TRUST flag matches the phase - the
+ *	PARALLEL ones on threads, the rest inline - and count successes.
+ *********************************************************************************
+ */
+
+static int loadWPiExtensionPhase (char *progName, const struct wpiExtensionEntry *table, int count, int trusted)
+{
+  struct extensionThreadStruct *threads ;
+  char *copy ;
+  int i, ok = 0 ;
+
+  if ((threads = calloc (count, sizeof (struct extensionThreadStruct))) == NULL)
+    return 0 ;
+
+  wpiExtensionTrust = trusted ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    if ((((table [i].flags & WPI_EXTENSION_TRUST) != 0) != trusted) ||
+	 ((table [i].flags & WPI_EXTENSION_PARALLEL) == 0))
+      continue ;
+
+    threads [i].progName  = progName ;
+    threads [i].extension = strdup (table [i].extension) ;
+    if (pthread_create (&threads [i].thread, NULL, extensionThread, &threads [i]) != 0)
+    {
+      threads [i].result = loadWPiExtension (progName, threads [i].extension, verbose) ;
+      threads [i].thread = 0 ;
+    }
+  }
+
+  for (i = 0 ; i < count ; ++i)		// The serial ones, while those run
+  {
+    if ((((table [i].flags & WPI_EXTENSION_TRUST) != 0) != trusted) ||
+	 ((table [i].flags & WPI_EXTENSION_PARALLEL) != 0))
+      continue ;
+
+    copy = strdup (table [i].extension) ;
+    if (loadWPiExtension (progName, copy, verbose))
+      ++ok ;
+    free (copy) ;
+  }
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    if (threads [i].extension == NULL)
+      continue ;
+
+    if (threads [i].thread != 0)
+      pthread_join (threads [i].thread, NULL) ;
+    if (threads [i].result)
+      ++ok ;
+    free (threads [i].extension) ;
+  }
+
+  wpiExtensionTrust = FALSE ;
+  free (threads) ;
+  return ok ;
+}
+
+
+// Lazy loading:
+//	Plenty of registered extensions serve pins that aren't touched until
+//	minutes after boot, or ever - yet their device setup I/O still runs
+//	at load time, one after another. A lazily loaded extension just
+//	claims its pin range with a placeholder node; the first access to
+//	any of its pins runs the real loadWPiExtension() then forwards the
+//	call to the device that setup created.
+
+#define	MAX_LAZY_EXTENSIONS	16
+
+#define	LAZY_PENDING	0
+#define	LAZY_READY	1
+#define	LAZY_FAILED	2
+
+struct lazyExtensionStruct
+{
+  char *progName ;
+  char *extension ;
+  int pinBase ;
+  int state ;
+  int printErrors ;
+} ;
+
+static struct lazyExtensionStruct lazyExtensions [MAX_LAZY_EXTENSIONS] ;
+static int lazyCount = 0 ;
+static pthread_mutex_t lazyLock = PTHREAD_MUTEX_INITIALIZER ;
+
+
+/*
+ * lazyResolve:
+ *	First touch of a lazy extension's pins: drop the placeholder, run
+ *	the real setup and hand back the node it registered (NULL if the
+ *	setup failed - accesses then fall into the usual no-node void).
+ *********************************************************************************
+ */
+
+static struct wiringPiNodeStruct *lazyResolve (struct wiringPiNodeStruct *placeholder)
+{
+  struct lazyExtensionStruct *lz = &lazyExtensions [placeholder->data0] ;
+
+  pthread_mutex_lock (&lazyLock) ;
+
+  if (lz->state == LAZY_PENDING)
+  {
+    wiringPiRemoveNode (placeholder) ;	// Free the range for the real node
+    lz->state = loadWPiExtension (lz->progName, lz->extension, lz->printErrors)
+			? LAZY_READY : LAZY_FAILED ;
+  }
+
+  pthread_mutex_unlock (&lazyLock) ;
+
+  return (lz->state == LAZY_READY) ? wiringPiFindNode (lz->pinBase) : NULL ;
+}
+
+
+static void lazyPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  if ((node = lazyResolve (node)) != NULL)
+    node->pinMode (node, pin, mode) ;
+}
+
+static void lazyPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int pud)
+{
+  if ((node = lazyResolve (node)) != NULL)
+    node->pullUpDnControl (node, pin, pud) ;
+}
+
+static int lazyDigitalRead (struct wiringPiNodeStruct *node, int pin)
+{
+  return ((node = lazyResolve (node)) != NULL) ? node->digitalRead (node, pin) : LOW ;
+}
+
+static void lazyDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  if ((node = lazyResolve (node)) != NULL)
+    node->digitalWrite (node, pin, value) ;
+}
+
+static void lazyPwmWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  if ((node = lazyResolve (node)) != NULL)
+    node->pwmWrite (node, pin, value) ;
+}
+
+static int lazyAnalogRead (struct wiringPiNodeStruct *node, int pin)
+{
+  return ((node = lazyResolve (node)) != NULL) ? node->analogRead (node, pin) : 0 ;
+}
+
+static void lazyAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  if ((node = lazyResolve (node)) != NULL)
+    node->analogWrite (node, pin, value) ;
+}
+
+
+/*
+ * loadWPiExtensionLazy:
+ *	As loadWPiExtension, but nothing touches the device until one of
+ *	its pins is first used. The caller says how many pins the
+ *	extension will claim - we can't ask the driver without running it.
+ *********************************************************************************
+ */
+
+int loadWPiExtensionLazy (char *progName, char *extensionData, int numPins, int printErrors)
+{
+  struct lazyExtensionStruct *lz ;
+  struct wiringPiNodeStruct *node ;
+  const char *p ;
+  int pinBase ;
+
+  verbose = printErrors ;
+
+  if (lazyCount == MAX_LAZY_EXTENSIONS)
+  {
+    verbError ("%s: too many lazy extensions (max %d)", progName, MAX_LAZY_EXTENSIONS) ;
+    return FALSE ;
+  }
+
+  if ((numPins < 1) || (numPins > 1000))
+  {
+    verbError ("%s: numPins (%d) out of range", progName, numPins) ;
+    return FALSE ;
+  }
+
+// Peek at the pinBase - the real parse happens at resolve time
+
+  if ((p = strchr (extensionData, ':')) == NULL)
+  {
+    verbError ("%s: extension name not terminated by a colon", progName) ;
+    return FALSE ;
+  }
+
+  pinBase = atoi (p + 1) ;
+  if (pinBase < 64)
+  {
+    verbError ("%s: pinBase (%d) too small. Minimum is 64.", progName, pinBase) ;
+    return FALSE ;
+  }
+
+  lz = &lazyExtensions [lazyCount] ;
+  lz->progName    = strcpy (wiringPiExtensionAlloc (strlen (progName) + 1), progName) ;
+  lz->extension   = strcpy (wiringPiExtensionAlloc (strlen (extensionData) + 1), extensionData) ;
+  lz->pinBase     = pinBase ;
+  lz->state       = LAZY_PENDING ;
+  lz->printErrors = printErrors ;
+
+  node = wiringPiNewNode (pinBase, numPins) ;
+
+  node->data0           = lazyCount++ ;
+  node->pinMode         = lazyPinMode ;
+  node->pullUpDnControl = lazyPullUpDnControl ;
+  node->digitalRead     = lazyDigitalRead ;
+  node->digitalWrite    = lazyDigitalWrite ;
+  node->pwmWrite        = lazyPwmWrite ;
+  node->analogRead      = lazyAnalogRead ;
+  node->analogWrite     = lazyAnalogWrite ;
+
+  return TRUE ;
+}
+
+
+/*
+ * loadWPiExtensionTable:
+ *	Load a set of extensions in one go - trusted entries first, then
+ *	the rest, parallelising within each phase. Returns the number
+ *	successfully loaded.
+ *********************************************************************************
+ */
+
+int loadWPiExtensionTable (char *progName, const struct wpiExtensionEntry *table, int count, int printErrors)
+{
+  int ok ;
+
+  verbose = printErrors ;
+
+  ok  = loadWPiExtensionPhase (progName, table, count, TRUE) ;
+  ok += loadWPiExtensionPhase (progName, table, count, FALSE) ;
+
+  return ok ;
+}
@@ -24,3 +24,27 @@
 
 
 extern int loadWPiExtension (char *progName, char *extensionData, int verbose) ;
+
+// Interface V3.17 - table-driven startup:
+//	Load a whole set of extensions in one call. Entries flagged PARALLEL
+//	initialise on their own threads (only flag devices on distinct
+//	buses); entries flagged TRUST skip whatever start-up probing their
+//	driver can skip - e.g. the MCP expanders seed their register shadows
+//	from the power-on defaults instead of reading them back.
+
+#define	WPI_EXTENSION_PARALLEL	0x01
+#define	WPI_EXTENSION_TRUST	0x02
+
+struct wpiExtensionEntry
+{
+  const char *extension ;	// "name:pinBase:params", as for loadWPiExtension
+  int flags ;
+} ;
+
+extern int wpiExtensionTrust ;	// Drivers consult this during setup
+extern int loadWPiExtensionTable (char *progName, const struct wpiExtensionEntry *table, int count, int verbose) ;
+
+// Interface V3.17 - register now, initialise the device on first pin
+//	access. numPins is the range the extension will claim.
+
+extern int loadWPiExtensionLazy (char *progName, char *extensionData, int numPins, int verbose) ;
@@ -21,6 +21,8 @@
  */
 
 #define	DEFAULT_SERVER_PORT	6124
+#define	DEFAULT_UNIX_SOCKET	"/var/run/wiringpid.sock"
+#define	DEFAULT_SHM_RING	"/wiringpid-ring"
 
 #define	DRCN_PIN_MODE		1
 #define	DRCN_PULL_UP_DN		2
@@ -34,6 +36,82 @@
 #define	DRCN_DIGITAL_READ8	8
 #define	DRCN_ANALOG_READ	9
 
+// Edge subscriptions:
+//	SUBSCRIBE: data holds the edge mode (INT_EDGE_FALLING/RISING/BOTH);
+//	the echoed reply has data 1 if the subscription took, 0 if not.
+//	The server then pushes a DRCN_EVENT record per edge, asynchronously:
+//	pin holds the pin in the low 16 bits with the edge (1: rising) in
+//	bit 16, data the low 32 bits of the event's microsecond timestamp.
+
+#define	DRCN_SUBSCRIBE		10
+#define	DRCN_UNSUBSCRIBE	11
+#define	DRCN_EVENT		12
+
+// Macros:
+//	MACRO_BEGIN: pin holds the macro id, data the number of step
+//	records that follow in the stream; the daemon stores them instead
+//	of executing them and replies once with data 1 (stored) or 0
+//	(rejected). MACRO_RUN executes the stored list in the daemon's
+//	command thread - atomically with respect to other clients, with
+//	local GPIO latency - and replies with the accumulated result:
+//	each MACRO_READ step shifts it left one and ors in the pin's bit.
+//	Steps may be PIN_MODE, PULL_UP_DN, DIGITAL_WRITE, PWM_WRITE,
+//	ANALOG_WRITE or the three step-only records below. MACRO_SKIP_IF
+//	skips the next step when digitalRead(pin) == data, MACRO_DELAY
+//	waits data microseconds (capped at one second).
+
+#define	DRCN_MACRO_BEGIN	13
+#define	DRCN_MACRO_RUN		14
+#define	DRCN_MACRO_DROP		15
+
+#define	DRCN_MACRO_DELAY	16	// Step records - only valid inside a macro
+#define	DRCN_MACRO_READ		17
+#define	DRCN_MACRO_SKIP_IF	18
+
+#define	DRCN_MACRO_MAX		16	// Macro ids 0 to 15
+#define	DRCN_MACRO_MAX_STEPS	64
+
+
+#define	DRCN_COMPACT		19
+
+// Sessions:
+//	An authenticated client sends DRCN_SESSION and the echoed reply
+//	carries a short-lived resume token (pin: high word, data: low
+//	word). A later reconnect can present it in the challenge phase -
+//	86 bytes reading "RESUME " plus the 16 hex digits, padded with
+//	'.' - and skip the crypt handshake entirely, so failover to a
+//	node is a connect and one line rather than a full hash exchange.
+//	Tokens are single-use and expire; a rejected resume just drops
+//	the connection like a bad password, and the client falls back.
+
+#define	DRCN_SESSION		20
+
+// Coalesced sync:
+//	A dashboard mirroring a noisy pin bank doesn't want one DRCN_EVENT
+//	per edge. DRCN_SYNC with data the window in milliseconds (0 turns
+//	it off; the echoed reply has data 1 or 0) switches the client's
+//	subscriptions to delta frames: everything that happened in a
+//	window folds into one pushed record per dirty 32-pin bank - cmd
+//	DRCN_SYNC with the bank (0: pins 0-31) in bit 16, pin the
+//	changed-pins mask and data those pins' current levels - so the
+//	bandwidth is bounded by the window, not the edge rate. Quiet
+//	windows send nothing; subscriptions on extension pins (64 up)
+//	don't fit a mask and keep their per-edge events.
+
+#define	DRCN_SYNC		21
+
+// Broadcast fan-out:
+//	A daemon acting as a proxy (-z, with -x drcn nodes for the
+//	downstream daemons) writes the same frame to every node it
+//	holds a connection to. pin is the offset within each node's pin
+//	range, data the value, and the write op (DRCN_PIN_MODE to
+//	DRCN_ANALOG_WRITE; 0 means DRCN_DIGITAL_WRITE) rides in bits 16
+//	up of cmd. The fan-out sends to every node before collecting any
+//	echo, so the downstream round trips overlap - one RTT for the
+//	lot - and the echoed reply carries the number of nodes reached
+//	in data.
+
+#define	DRCN_BROADCAST		22
 
 struct drcNetComStruct
 {
@@ -41,3 +119,77 @@ struct drcNetComStruct
   uint32_t cmd ;
   uint32_t data ;
 };
+
+
+// Compact records:
+//	At replication rates the 12-byte record is mostly padding - a pin
+//	is never over 255 here and no write carries more than 16 bits.
+//	A client sends DRCN_COMPACT (full-size, data 1) and everything
+//	after it, both ways, uses the 4-byte layout below: three times
+//	the commands per packet and less copying per command. Only the
+//	stateless pin commands (DRCN_PIN_MODE to DRCN_ANALOG_READ) run
+//	in compact mode, every record is echoed as its reply (reads with
+//	the value, unknown ops with data 0xFFFF), and a compact
+//	DRCN_COMPACT with data 0 switches back to full records.
+
+struct drcNetComCompact
+{
+  uint8_t  cmd ;
+  uint8_t  pin ;
+  uint16_t data ;
+};
+
+
+// Shared-memory ring:
+//	A single co-located client maps the daemon's shm segment (see
+//	serverEnableShmRing) and trades records through a pair of
+//	single-producer single-consumer rings - no sockets, no syscalls
+//	on the fast path. The indices run free (slot = index % slots) and
+//	the futex protocol is: bump the head, then FUTEX_WAKE it only if
+//	the other side set its waiting flag; a reader that finds its ring
+//	empty sets the flag, re-checks, then FUTEX_WAITs on the head.
+//	Both sides MUST put a full memory barrier (seq-cst fence) between
+//	their store and the load that follows it - after bumping a head,
+//	before reading the peer's waiting flag; and after setting the
+//	waiting flag, before re-checking the head. Without it ARM may
+//	reorder the store past the load, each side sees the other's old
+//	value, and writer and sleeper miss each other for good.
+//	Every request gets exactly one response record (the request
+//	echoed, data carrying any result), in order, so a client must
+//	drain responses before it has DRCN_SHM_SLOTS commands in flight.
+//	Only the stateless pin commands run here - PIN_MODE through
+//	ANALOG_READ; subscriptions and macros stay on the sockets.
+//	Opening the segment is the authentication: the daemon creates it
+//	mode 0660, so file permissions say who gets the fast path.
+
+#define	DRCN_SHM_MAGIC		0x44524331	// "DRC1"
+#define	DRCN_SHM_SLOTS		64		// Power of two
+
+struct drcShmRing
+{
+  uint32_t magic ;
+  uint32_t slots ;			// DRCN_SHM_SLOTS, so both sides agree
+  volatile uint32_t reqHead ;		// Client bumps; daemon futex-waits here
+  volatile uint32_t reqTail ;		// Daemon bumps after copying a request out
+  volatile uint32_t rspHead ;		// Daemon bumps; client futex-waits here
+  volatile uint32_t rspTail ;		// Client bumps after consuming a response
+  volatile uint32_t reqWaiting ;	// Daemon is (about to be) asleep on reqHead
+  volatile uint32_t rspWaiting ;	// Client is (about to be) asleep on rspHead
+  struct drcNetComStruct req [DRCN_SHM_SLOTS] ;
+  struct drcNetComStruct rsp [DRCN_SHM_SLOTS] ;
+};
+
+// UDP transport:
+//	A datagram is one of these headers followed by count command
+//	records. No replies, no retransmit - the sequence number lets the
+//	receiver drop duplicated or re-ordered datagrams, and the sender
+//	heals losses by periodically re-sending its full state.
+
+#define	DRCN_UDP_MAGIC	0x44524355	// "DRCU"
+
+struct drcNetUdpHead
+{
+  uint32_t magic ;
+  uint32_t seq ;
+  uint32_t count ;
+};
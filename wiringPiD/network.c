@@ -22,18 +22,33 @@
  */
 
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdarg.h>
 #include <malloc.h>
+#include <errno.h>
 
 #include <fcntl.h>
 #include <crypt.h>
-
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "drcNetCmd.h"
 #include "network.h"
 
 #define	TRUE	(1==1)
@@ -47,6 +62,80 @@ static char salt [SALT_LEN + 1] ;
 static char *returnedHash = NULL ;
 static int serverFd = -1 ;
 
+// Multi-client mode:
+//	One slot per connected client - its own authentication salt and its
+//	own receive buffer, so a slow or chatty client can't stall the rest.
+
+#define	MAX_CLIENTS	64
+#define	CLIENT_RX_SIZE	4096
+#define	CLIENT_TX_SIZE	4096
+#define	HASH_LEN	86		// An SHA-512 hash is exactly this long
+
+#define	CS_CHALLENGED	0		// Waiting for the password hash
+#define	CS_RUNNING	1		// Authenticated - running commands
+
+struct wpidClient
+{
+  int fd ;				// -1: slot free
+  int state ;
+  char clientSalt [SALT_LEN + 1] ;
+  uint8_t rxBuf [CLIENT_RX_SIZE] ;
+  int rxLen ;
+  uint8_t txBuf [CLIENT_TX_SIZE] ;	// Replies coalesce here until the batch is done
+  int txLen ;
+  int recordSize ;			// 0: the server default
+} ;
+
+static struct wpidClient clients [MAX_CLIENTS] =
+	{ [0 ... MAX_CLIENTS - 1] = { .fd = -1 } } ;
+
+static void (*clientClosed) (int fd) = NULL ;	// Told whenever a client goes
+
+// The periodic tick (serverSetTick) - a timerfd in the epoll set, so
+//	the handler runs on the server thread between client commands.
+
+static int epollServerFd = -1 ;
+static int tickFd = -1 ;
+static void (*tickHandler) (void) = NULL ;
+
+// UDP write path:
+//	Unauthenticated fire-and-forget datagrams - only enabled when the
+//	daemon asks for it (trusted networks only). Per-source sequence
+//	tracking drops anything duplicated or re-ordered in flight.
+
+#define	MAX_UDP_SOURCES	16
+
+struct udpSource
+{
+  int used ;
+  socklen_t addrLen ;
+  struct sockaddr_storage addr ;
+  uint32_t lastSeq ;
+} ;
+
+static struct udpSource udpSources [MAX_UDP_SOURCES] ;
+static int udpFd = -1 ;
+static void (*udpRecord) (void *record) = NULL ;
+
+// Unix-domain path:
+//	A SOCK_SEQPACKET listener for local peers - the kernel tells us who
+//	they are (SO_PEERCRED) so there's no password handshake, and being
+//	loopback-free knocks most of the syscall latency off each command.
+
+static int unixFd = -1 ;
+static char unixPath [108] ;		// sizeof sun_path
+static uid_t unixAllowedUid = (uid_t)-1 ;	// As well as root and ourselves
+
+// Shared-memory ring path:
+//	Layout and protocol in drcNetCmd.h. A dedicated thread serves the
+//	ring - the futex it sleeps on can't go into the epoll set, and a
+//	real-time client is exactly who shouldn't be queueing behind the
+//	socket traffic anyway.
+
+static char shmRingName [NAME_MAX] ;
+static struct drcShmRing *shmRing = NULL ;
+static void (*shmRecord) (void *record) = NULL ;
+
 // Union for the server Socket Address
 
 static union
@@ -230,37 +319,114 @@ int getResponse (int clientFd)
  *********************************************************************************
  */
 
-int passwordMatch (const char *password)
+static int hashMatch (const char *theSalt, const char *password, const char *hash)
 {
   char *encrypted ;
   char salted [1024] ;
 
-  sprintf (salted, "$6$%s$", salt) ;
+  sprintf (salted, "$6$%s$", theSalt) ;
 
   encrypted = crypt (password, salted) ;
 
 // 20: $6$ then 16 characters of salt, then $
 // 86 is the length of an SHA-512 hash
 
-  return strncmp (encrypted + 20, returnedHash, 86) == 0 ;
+  return strncmp (encrypted + 20, hash, HASH_LEN) == 0 ;
 }
 
+int passwordMatch (const char *password)
+{
+  return hashMatch (salt, password, returnedHash) ;
+}
 
-/* 
- * setupServer:
- *	Do what's needed to create a local server socket instance that can listen
- *	on both IPv4 and IPv6 interfaces.
+
+/*
+ * serverSessionToken: sessionRedeem:
+ *	Short-lived single-use resume tokens (see DRCN_SESSION in
+ *	drcNetCmd.h): an authenticated client asks for one and a later
+ *	reconnect presents it in place of the password hash, skipping
+ *	the crypt exchange. Five minutes covers a supervisor restart
+ *	without leaving credentials lying around for long.
  *********************************************************************************
  */
 
-int setupServer (int serverPort)
+#define	MAX_SESSIONS	64
+#define	SESSION_LIFE	300		// Seconds
+
+struct wpidSession
 {
-  socklen_t clientSockAddrSize = sizeof (clientSockAddr) ;
+  uint32_t hi, lo ;
+  time_t expires ;			// 0: slot free
+} ;
+
+static struct wpidSession sessions [MAX_SESSIONS] ;
+
+int serverSessionToken (uint32_t *hi, uint32_t *lo)
+{
+  uint32_t words [2] ;
+  time_t now = time (NULL) ;
+  int fd, i, slot = -1 ;
+
+  for (i = 0 ; i < MAX_SESSIONS ; ++i)
+  {
+    if ((sessions [i].expires != 0) && (sessions [i].expires < now))
+      sessions [i].expires = 0 ;
+    if ((sessions [i].expires == 0) && (slot == -1))
+      slot = i ;
+  }
+
+  if (slot == -1)
+    return -1 ;
+
+  if ((fd = open ("/dev/urandom", O_RDONLY)) < 0)
+    return -1 ;
+  if (read (fd, words, sizeof (words)) != sizeof (words))
+  {
+    close (fd) ;
+    return -1 ;
+  }
+  close (fd) ;
+
+  sessions [slot].hi      = words [0] ;
+  sessions [slot].lo      = words [1] ;
+  sessions [slot].expires = now + SESSION_LIFE ;
+
+  *hi = words [0] ;
+  *lo = words [1] ;
+  return 0 ;
+}
+
+static int sessionRedeem (uint32_t hi, uint32_t lo)
+{
+  time_t now = time (NULL) ;
+  int i ;
+
+  for (i = 0 ; i < MAX_SESSIONS ; ++i)
+    if ((sessions [i].expires != 0) && (sessions [i].hi == hi) && (sessions [i].lo == lo))
+    {
+      int live = sessions [i].expires >= now ;
+
+      sessions [i].expires = 0 ;	// Single use either way
+      return live ;
+    }
+
+  return FALSE ;
+}
+
+
+/*
+ * setupListener:
+ *	Create the local server socket instance that can listen on both
+ *	IPv4 and IPv6 interfaces, bound and listening but with no client
+ *	accepted yet.
+ *********************************************************************************
+ */
 
+static int setupListener (int serverPort)
+{
   int on = 1 ;
   int family ;
   socklen_t serverSockAddrSize ;
-  int clientFd ;
 
 // Try to create an IPv6 socket
 
@@ -302,12 +468,31 @@ int setupServer (int serverPort)
       serverSockAddr.sin6.sin6_port   = htons (serverPort) ;
   }
 
-// Bind, listen and accept
+// Bind and listen
 
   if (bind (serverFd, (struct sockaddr *)&serverSockAddr, serverSockAddrSize) < 0)
     return -1 ;
 
-  if (listen (serverFd, 4) < 0)	// Really only going to talk to one client at a time...
+  if (listen (serverFd, 8) < 0)
+    return -1 ;
+
+  return serverFd ;
+}
+
+
+/*
+ * setupServer:
+ *	The classic single-client entry point: listen, then block until
+ *	one client connects and return its fd.
+ *********************************************************************************
+ */
+
+int setupServer (int serverPort)
+{
+  socklen_t clientSockAddrSize = sizeof (clientSockAddr) ;
+  int clientFd ;
+
+  if (setupListener (serverPort) < 0)
     return -1 ;
 
   if ((clientFd = accept (serverFd, (struct sockaddr *)&clientSockAddr, &clientSockAddrSize)) < 0)
@@ -317,6 +502,808 @@ int setupServer (int serverPort)
 }
 
 
+/*
+ * clientNew: clientDrop:
+ *	Slot management for the multi-client server.
+ *********************************************************************************
+ */
+
+static struct wpidClient *clientNew (int fd)
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_CLIENTS ; ++i)
+    if (clients [i].fd == -1)
+    {
+      clients [i].fd    = fd ;
+      clients [i].state = CS_CHALLENGED ;
+      clients [i].rxLen = 0 ;
+      clients [i].txLen = 0 ;
+      clients [i].recordSize = 0 ;
+      return &clients [i] ;
+    }
+
+  return NULL ;
+}
+
+static void clientDrop (int epollFd, struct wpidClient *client)
+{
+  if (clientClosed != NULL)
+    clientClosed (client->fd) ;
+
+  (void)epoll_ctl (epollFd, EPOLL_CTL_DEL, client->fd, NULL) ;
+  close (client->fd) ;
+  client->fd = -1 ;
+}
+
+static struct wpidClient *clientFind (int fd)
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_CLIENTS ; ++i)
+    if (clients [i].fd == fd)
+      return &clients [i] ;
+
+  return NULL ;
+}
+
+
+/*
+ * clientFlushReplies:
+ *	Push the client's queued replies out in one write. The socket is
+ *	non-blocking, so a full send queue gets a short grace via poll
+ *	rather than dropping the client on the spot; a client that stays
+ *	wedged past it is dropped by the caller.
+ *********************************************************************************
+ */
+
+static int clientFlushReplies (struct wpidClient *client)
+{
+  struct pollfd p ;
+  int sent, len ;
+
+  sent = 0 ;
+  while (sent < client->txLen)
+  {
+    len = write (client->fd, client->txBuf + sent, client->txLen - sent) ;
+    if (len > 0)
+    {
+      sent += len ;
+      continue ;
+    }
+
+    if ((len < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+    {
+      p.fd      = client->fd ;
+      p.events  = POLLOUT ;
+      p.revents = 0 ;
+      if (poll (&p, 1, 1000) > 0)
+	continue ;
+    }
+    client->txLen = 0 ;
+    return -1 ;
+  }
+
+  client->txLen = 0 ;
+  return 0 ;
+}
+
+
+/*
+ * clientQueueReply:
+ *	Queue one reply record for the given client - it goes out with the
+ *	rest of its batch when clientData flushes at the end of the
+ *	records in hand, so a pipelined burst of commands costs one write
+ *	and one packet coming back instead of one each. Falls back to a
+ *	direct send for fds the epoll server isn't holding (the classic
+ *	single-client loop).
+ *********************************************************************************
+ */
+
+int clientQueueReply (int fd, const void *record, int len)
+{
+  struct wpidClient *client ;
+
+  if ((client = clientFind (fd)) == NULL)
+    return (send (fd, record, len, 0) == len) ? 0 : -1 ;
+
+  if ((client->txLen + len) > CLIENT_TX_SIZE)
+    if (clientFlushReplies (client) < 0)
+      return -1 ;
+
+  memcpy (client->txBuf + client->txLen, record, len) ;
+  client->txLen += len ;
+  return 0 ;
+}
+
+
+/*
+ * clientSetRecordSize:
+ *	Change how the client's command stream is framed from the next
+ *	record on - the compact protocol switches a client between the
+ *	full and 4-byte record layouts mid-stream.
+ *********************************************************************************
+ */
+
+void clientSetRecordSize (int fd, int size)
+{
+  struct wpidClient *client ;
+
+  if ((client = clientFind (fd)) != NULL)
+    client->recordSize = size ;
+}
+
+
+/*
+ * clientAccept:
+ *	Take a new connection off the listening socket: non-blocking fd,
+ *	then greeting and challenge (with a per-client salt).
+ *********************************************************************************
+ */
+
+static void clientAccept (int epollFd, void (*notify)(const char *message))
+{
+  socklen_t clientSockAddrSize = sizeof (clientSockAddr) ;
+  struct epoll_event ev ;
+  struct wpidClient *client ;
+  char message [1200] ;
+  int fd, len ;
+
+  if ((fd = accept (serverFd, (struct sockaddr *)&clientSockAddr, &clientSockAddrSize)) < 0)
+    return ;
+
+  if ((client = clientNew (fd)) == NULL)	// All slots busy
+  {
+    (void)clientPstr (fd, "500 Too many clients\n") ;
+    close (fd) ;
+    return ;
+  }
+
+  (void)fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK) ;
+
+// Nagle off: we coalesce replies ourselves at batch boundaries, so
+//	there's nothing for the kernel to usefully delay.
+
+  len = 1 ;
+  (void)setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, (void *)&len, sizeof (len)) ;
+
+  if ((getSalt (client->clientSalt)                              < 0) ||
+      (sendGreeting (fd)                                         < 0) ||
+      (clientPrintf (fd, "Challenge %s\n", client->clientSalt) < 0))
+  {
+    close (fd) ;
+    client->fd = -1 ;
+    return ;
+  }
+
+  ev.events   = EPOLLIN ;
+  ev.data.fd  = fd ;
+  if (epoll_ctl (epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    close (fd) ;
+    client->fd = -1 ;
+    return ;
+  }
+
+  if (notify != NULL)
+  {
+    snprintf (message, sizeof (message), "New connection from: %s", getClientIP ()) ;
+    notify (message) ;
+  }
+}
+
+
+/*
+ * clientData:
+ *	Data has arrived from a client: buffer it, then consume whatever is
+ *	complete - the password hash while authenticating, then as many
+ *	whole command records as the buffer holds, so a pipelined burst is
+ *	parsed from a single recv.
+ *********************************************************************************
+ */
+
+static void clientData (int epollFd, struct wpidClient *client, const char *password,
+	int recordSize, int (*handler)(int fd, void *record), void (*notify)(const char *message))
+{
+  char hash [HASH_LEN + 1] ;
+  int len, off ;
+
+  len = recv (client->fd, client->rxBuf + client->rxLen, CLIENT_RX_SIZE - client->rxLen, 0) ;
+  if (len <= 0)
+  {
+    if ((len < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+      return ;
+
+    clientDrop (epollFd, client) ;
+    if (notify != NULL)
+      notify ("Client disconnected") ;
+    return ;
+  }
+  client->rxLen += len ;
+
+  if (client->state == CS_CHALLENGED)
+  {
+    if (client->rxLen < HASH_LEN)
+      return ;
+
+    memcpy (hash, client->rxBuf, HASH_LEN) ;
+    hash [HASH_LEN] = 0 ;
+
+// A resume token rides in the same 86-byte slot as the hash
+
+    if (strncmp (hash, "RESUME ", 7) == 0)
+    {
+      uint32_t hi, lo ;
+
+      if ((sscanf (hash + 7, "%8x%8x", &hi, &lo) != 2) || !sessionRedeem (hi, lo))
+      {
+	clientDrop (epollFd, client) ;
+	if (notify != NULL)
+	  notify ("Bad resume token") ;
+	return ;
+      }
+      if (notify != NULL)
+	notify ("Session resumed") ;
+    }
+    else if (!hashMatch (client->clientSalt, password, hash))
+    {
+      clientDrop (epollFd, client) ;		// No 3 chances here either
+      if (notify != NULL)
+	notify ("Password failure") ;
+      return ;
+    }
+    else if (notify != NULL)
+      notify ("Password OK - Starting") ;
+
+    client->rxLen -= HASH_LEN ;
+    memmove (client->rxBuf, client->rxBuf + HASH_LEN, client->rxLen) ;
+    client->state = CS_RUNNING ;
+  }
+
+// Run every complete record we're holding. The size is re-fetched each
+//	time round: a record may switch its own stream's framing.
+
+  off = 0 ;
+  for (;;)
+  {
+    int rs = (client->recordSize != 0) ? client->recordSize : recordSize ;
+
+    if ((client->rxLen - off) < rs)
+      break ;
+
+    if (handler (client->fd, client->rxBuf + off) < 0)
+    {
+      clientDrop (epollFd, client) ;
+      return ;
+    }
+    off += rs ;
+  }
+
+  if (off != 0)
+  {
+    client->rxLen -= off ;
+    memmove (client->rxBuf, client->rxBuf + off, client->rxLen) ;
+  }
+
+// Batch boundary - everything queued goes out in one write
+
+  if (client->txLen != 0)
+    if (clientFlushReplies (client) < 0)
+    {
+      clientDrop (epollFd, client) ;
+      if (notify != NULL)
+	notify ("Client reply queue wedged - dropped") ;
+    }
+}
+
+
+/*
+ * serverEnableUdp:
+ *	Ask for the datagram write path: handler gets each accepted
+ *	command record. Call before runMultiServer.
+ *********************************************************************************
+ */
+
+int serverEnableUdp (void (*handler)(void *record))
+{
+  udpRecord = handler ;
+  return 0 ;
+}
+
+
+/*
+ * serverEnableUnix:
+ *	Ask for a local Unix-domain listener at the given path. Peers
+ *	running as root, as the daemon's own user or as allowedUid (-1:
+ *	nobody extra) are let straight in - the kernel's SO_PEERCRED is
+ *	the authentication. Call before runMultiServer.
+ *********************************************************************************
+ */
+
+int serverEnableUnix (const char *path, int allowedUid)
+{
+  if (strlen (path) >= sizeof (unixPath))
+    return -1 ;
+
+  strcpy (unixPath, path) ;
+  unixAllowedUid = (uid_t)allowedUid ;
+  return 0 ;
+}
+
+
+/*
+ * serverEnableShmRing:
+ *	Ask for the shared-memory command ring under the given shm name
+ *	(see drcShmRing in drcNetCmd.h): a co-located client maps the
+ *	segment and issues commands in about a microsecond without
+ *	entering the network stack, while the daemon keeps /dev/mem to
+ *	itself. handler gets each request record and rewrites it into the
+ *	response. Call before runMultiServer.
+ *********************************************************************************
+ */
+
+int serverEnableShmRing (const char *name, void (*handler)(void *record))
+{
+  if ((name [0] != '/') || (strlen (name) >= sizeof (shmRingName)))
+    return -1 ;
+
+  strcpy (shmRingName, name) ;
+  shmRecord = handler ;
+  return 0 ;
+}
+
+
+/*
+ * udpSourceCheck:
+ *	TRUE if this datagram's sequence number moves its sender forward;
+ *	duplicates and stragglers are dropped. An unknown sender claims a
+ *	slot (round-robbing over the oldest on overflow would be nicer,
+ *	but 16 senders is already past anything we've deployed).
+ *********************************************************************************
+ */
+
+static int udpSourceCheck (struct sockaddr_storage *addr, socklen_t addrLen, uint32_t seq)
+{
+  int i, slot = -1 ;
+
+  for (i = 0 ; i < MAX_UDP_SOURCES ; ++i)
+  {
+    if (udpSources [i].used && (udpSources [i].addrLen == addrLen) &&
+		(memcmp (&udpSources [i].addr, addr, addrLen) == 0))
+    {
+      if ((int32_t)(seq - udpSources [i].lastSeq) <= 0)	// Old news
+	return FALSE ;
+      udpSources [i].lastSeq = seq ;
+      return TRUE ;
+    }
+    if (!udpSources [i].used && (slot == -1))
+      slot = i ;
+  }
+
+  if (slot == -1)
+    return FALSE ;
+
+  udpSources [slot].used    = TRUE ;
+  udpSources [slot].addrLen = addrLen ;
+  memcpy (&udpSources [slot].addr, addr, addrLen) ;
+  udpSources [slot].lastSeq = seq ;
+  return TRUE ;
+}
+
+
+/*
+ * udpData:
+ *	A datagram has arrived: check the framing and the sender's
+ *	sequence, then run every record it carries.
+ *********************************************************************************
+ */
+
+static void udpData (int recordSize)
+{
+  uint8_t packet [sizeof (struct drcNetUdpHead) + CLIENT_RX_SIZE] ;
+  struct drcNetUdpHead head ;
+  struct sockaddr_storage from ;
+  socklen_t fromLen = sizeof (from) ;
+  ssize_t len ;
+  uint32_t i ;
+
+  len = recvfrom (udpFd, packet, sizeof (packet), 0, (struct sockaddr *)&from, &fromLen) ;
+  if (len < (ssize_t)sizeof (struct drcNetUdpHead))
+    return ;
+
+  memcpy (&head, packet, sizeof (head)) ;
+
+  if (head.magic != DRCN_UDP_MAGIC)
+    return ;
+
+  if (len != (ssize_t)(sizeof (head) + head.count * recordSize))
+    return ;
+
+  if (!udpSourceCheck (&from, fromLen, head.seq))
+    return ;
+
+  for (i = 0 ; i < head.count ; ++i)
+    udpRecord (packet + sizeof (head) + i * recordSize) ;
+}
+
+
+/*
+ * setupUdpListener:
+ *	A datagram socket on the same port as the stream one - IPv6 with
+ *	IPv4 fallback, like setupListener.
+ *********************************************************************************
+ */
+
+static int setupUdpListener (int serverPort)
+{
+  struct sockaddr_in6 sin6 ;
+  struct sockaddr_in  sin ;
+
+  if ((udpFd = socket (PF_INET6, SOCK_DGRAM, 0)) >= 0)
+  {
+    memset (&sin6, 0, sizeof (sin6)) ;
+    sin6.sin6_family = AF_INET6 ;
+    sin6.sin6_addr   = in6addr_any ;
+    sin6.sin6_port   = htons (serverPort) ;
+    if (bind (udpFd, (struct sockaddr *)&sin6, sizeof (sin6)) == 0)
+      return udpFd ;
+    close (udpFd) ;
+  }
+
+  if ((udpFd = socket (PF_INET, SOCK_DGRAM, 0)) < 0)
+    return -1 ;
+
+  memset (&sin, 0, sizeof (sin)) ;
+  sin.sin_family      = AF_INET ;
+  sin.sin_addr.s_addr = htonl (INADDR_ANY) ;
+  sin.sin_port        = htons (serverPort) ;
+  if (bind (udpFd, (struct sockaddr *)&sin, sizeof (sin)) < 0)
+  {
+    close (udpFd) ;
+    udpFd = -1 ;
+    return -1 ;
+  }
+
+  return udpFd ;
+}
+
+
+/*
+ * setupUnixListener:
+ *	The local SOCK_SEQPACKET listener - each send is one framed
+ *	message, so a batched burst of commands arrives in one piece.
+ *********************************************************************************
+ */
+
+static int setupUnixListener (void)
+{
+  struct sockaddr_un sun ;
+
+  if ((unixFd = socket (AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+    return -1 ;
+
+  memset (&sun, 0, sizeof (sun)) ;
+  sun.sun_family = AF_UNIX ;
+  strcpy (sun.sun_path, unixPath) ;
+
+  (void)unlink (unixPath) ;		// A stale one from a previous run
+
+  if (bind (unixFd, (struct sockaddr *)&sun, sizeof (sun)) < 0)
+  {
+    close (unixFd) ;
+    unixFd = -1 ;
+    return -1 ;
+  }
+
+  if (listen (unixFd, 8) < 0)
+  {
+    close (unixFd) ;
+    unixFd = -1 ;
+    return -1 ;
+  }
+
+  return unixFd ;
+}
+
+
+/*
+ * shmRingThread:
+ *	The ring's consumer: sleep on the request head, copy each record
+ *	out (freeing its slot straight away), run it, and publish the
+ *	response. A client that stops draining responses stalls only its
+ *	own ring - the timed waits below keep us responsive if it then
+ *	recovers, without it having to wake us - and bound the damage if
+ *	a client misses the fence the protocol demands and loses a wake.
+ *********************************************************************************
+ */
+
+static void *shmRingThread (__attribute__((unused)) void *arg)
+{
+  struct drcShmRing *ring = shmRing ;
+  struct drcNetComStruct record ;
+  struct timespec drain = { 0, 10000000 } ;	// 10mS
+  uint32_t head ;
+
+  for (;;)
+  {
+    head = __atomic_load_n (&ring->reqHead, __ATOMIC_ACQUIRE) ;
+    if (ring->reqTail == head)
+    {
+      ring->reqWaiting = 1 ;
+      __atomic_thread_fence (__ATOMIC_SEQ_CST) ;	// Flag store must not pass the re-check below
+      if (__atomic_load_n (&ring->reqHead, __ATOMIC_ACQUIRE) == head)	// Re-check after publishing the flag
+	(void)syscall (SYS_futex, &ring->reqHead, FUTEX_WAIT, head, &drain, NULL, 0) ;
+      ring->reqWaiting = 0 ;
+      continue ;
+    }
+
+    record = ring->req [ring->reqTail % DRCN_SHM_SLOTS] ;
+    __atomic_store_n (&ring->reqTail, ring->reqTail + 1, __ATOMIC_RELEASE) ;
+
+    shmRecord (&record) ;
+
+    while ((ring->rspHead - __atomic_load_n (&ring->rspTail, __ATOMIC_ACQUIRE)) >= DRCN_SHM_SLOTS)
+      (void)syscall (SYS_futex, &ring->rspTail, FUTEX_WAIT, ring->rspTail, &drain, NULL, 0) ;
+
+    ring->rsp [ring->rspHead % DRCN_SHM_SLOTS] = record ;
+    __atomic_store_n (&ring->rspHead, ring->rspHead + 1, __ATOMIC_RELEASE) ;
+    __atomic_thread_fence (__ATOMIC_SEQ_CST) ;	// Head store must not pass the flag load below
+    if (ring->rspWaiting)
+      (void)syscall (SYS_futex, &ring->rspHead, FUTEX_WAKE, 1, NULL, NULL, 0) ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * setupShmRing:
+ *	Create (or take over) the shm segment, initialise the ring and
+ *	start its consumer thread. Mode 0660: being able to open the
+ *	segment is the client's authentication, the same way the Unix
+ *	socket leans on file permissions.
+ *********************************************************************************
+ */
+
+static int setupShmRing (void)
+{
+  pthread_t thread ;
+  int fd ;
+
+  if ((fd = shm_open (shmRingName, O_CREAT | O_RDWR, 0660)) < 0)
+    return -1 ;
+
+  if (ftruncate (fd, sizeof (struct drcShmRing)) < 0)
+  {
+    close (fd) ;
+    return -1 ;
+  }
+
+  shmRing = (struct drcShmRing *)mmap (NULL, sizeof (struct drcShmRing),
+		PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+  close (fd) ;
+  if (shmRing == MAP_FAILED)
+  {
+    shmRing = NULL ;
+    return -1 ;
+  }
+
+  memset (shmRing, 0, sizeof (struct drcShmRing)) ;
+  shmRing->slots = DRCN_SHM_SLOTS ;
+  __atomic_store_n (&shmRing->magic, DRCN_SHM_MAGIC, __ATOMIC_RELEASE) ;	// Clients wait for this
+
+  if (pthread_create (&thread, NULL, shmRingThread, NULL) != 0)
+    return -1 ;
+  pthread_detach (thread) ;
+
+  return 0 ;
+}
+
+
+/*
+ * unixAccept:
+ *	A local peer: SO_PEERCRED says who it is. The right identities go
+ *	straight to running - no challenge - everyone else is dropped.
+ *********************************************************************************
+ */
+
+static void unixAccept (int epollFd, void (*notify)(const char *message))
+{
+  struct epoll_event ev ;
+  struct wpidClient *client ;
+  struct ucred cred ;
+  socklen_t credLen = sizeof (cred) ;
+  char message [128] ;
+  int fd ;
+
+  if ((fd = accept (unixFd, NULL, NULL)) < 0)
+    return ;
+
+  if (getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) < 0)
+  {
+    close (fd) ;
+    return ;
+  }
+
+  if ((cred.uid != 0) && (cred.uid != geteuid ()) && (cred.uid != unixAllowedUid))
+  {
+    (void)clientPstr (fd, "500 Permission denied\n") ;
+    close (fd) ;
+    if (notify != NULL)
+    {
+      snprintf (message, sizeof (message), "Local connection from uid %d refused", cred.uid) ;
+      notify (message) ;
+    }
+    return ;
+  }
+
+  if ((client = clientNew (fd)) == NULL)
+  {
+    (void)clientPstr (fd, "500 Too many clients\n") ;
+    close (fd) ;
+    return ;
+  }
+
+  (void)fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK) ;
+  client->state = CS_RUNNING ;		// The peercred check was the auth
+
+  ev.events  = EPOLLIN ;
+  ev.data.fd = fd ;
+  if (epoll_ctl (epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    close (fd) ;
+    client->fd = -1 ;
+    return ;
+  }
+
+  if (notify != NULL)
+  {
+    snprintf (message, sizeof (message), "Local connection from uid %d", cred.uid) ;
+    notify (message) ;
+  }
+}
+
+
+/*
+ * serverSetTick:
+ *	Arm (ms > 0) or disarm (ms 0) a periodic tick on the epoll loop.
+ *	The handler runs on the server thread between client commands, so
+ *	it can use clientQueueReply freely - the coalesced sync mode
+ *	flushes its delta frames from here.
+ *********************************************************************************
+ */
+
+int serverSetTick (unsigned int ms, void (*handler)(void))
+{
+  struct itimerspec its ;
+  struct epoll_event ev ;
+
+  if (ms == 0)
+  {
+    if (tickFd != -1)
+    {
+      (void)epoll_ctl (epollServerFd, EPOLL_CTL_DEL, tickFd, NULL) ;
+      close (tickFd) ;
+      tickFd = -1 ;
+    }
+    tickHandler = NULL ;
+    return 0 ;
+  }
+
+  if (epollServerFd == -1)	// Not running the epoll server
+    return -1 ;
+
+  if (tickFd == -1)
+  {
+    if ((tickFd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+      return -1 ;
+    ev.events  = EPOLLIN ;
+    ev.data.fd = tickFd ;
+    if (epoll_ctl (epollServerFd, EPOLL_CTL_ADD, tickFd, &ev) < 0)
+    {
+      close (tickFd) ;
+      tickFd = -1 ;
+      return -1 ;
+    }
+  }
+
+  its.it_interval.tv_sec  = ms / 1000 ;
+  its.it_interval.tv_nsec = (long)(ms % 1000) * 1000000L ;
+  its.it_value = its.it_interval ;
+  if (timerfd_settime (tickFd, 0, &its, NULL) < 0)
+    return -1 ;
+
+  tickHandler = handler ;
+  return 0 ;
+}
+
+
+/*
+ * runMultiServer:
+ *	The epoll server loop: any number of clients (up to MAX_CLIENTS),
+ *	each with its own buffer, none able to block the others. Each
+ *	complete recordSize-byte command is handed to the handler which
+ *	returns < 0 to drop that client. Only returns on a fatal error.
+ *********************************************************************************
+ */
+
+int runMultiServer (int serverPort, const char *password, int recordSize,
+	int (*handler)(int fd, void *record), void (*notify)(const char *message),
+	void (*closed)(int fd))
+{
+  struct epoll_event ev, events [16] ;
+  struct wpidClient *client ;
+  int epollFd, num, i ;
+
+  clientClosed = closed ;
+
+  if (setupListener (serverPort) < 0)
+    return -1 ;
+
+  if ((epollFd = epoll_create1 (0)) < 0)
+    return -1 ;
+  epollServerFd = epollFd ;
+
+  ev.events  = EPOLLIN ;
+  ev.data.fd = serverFd ;
+  if (epoll_ctl (epollFd, EPOLL_CTL_ADD, serverFd, &ev) < 0)
+    return -1 ;
+
+  if (udpRecord != NULL)
+  {
+    if (setupUdpListener (serverPort) < 0)
+      return -1 ;
+    ev.events  = EPOLLIN ;
+    ev.data.fd = udpFd ;
+    if (epoll_ctl (epollFd, EPOLL_CTL_ADD, udpFd, &ev) < 0)
+      return -1 ;
+  }
+
+  if (unixPath [0] != 0)
+  {
+    if (setupUnixListener () < 0)
+      return -1 ;
+    ev.events  = EPOLLIN ;
+    ev.data.fd = unixFd ;
+    if (epoll_ctl (epollFd, EPOLL_CTL_ADD, unixFd, &ev) < 0)
+      return -1 ;
+  }
+
+  if (shmRingName [0] != 0)
+    if (setupShmRing () < 0)
+      return -1 ;
+
+  for (;;)
+  {
+    if ((num = epoll_wait (epollFd, events, 16, -1)) < 0)
+    {
+      if (errno == EINTR)
+	continue ;
+      return -1 ;
+    }
+
+    for (i = 0 ; i < num ; ++i)
+    {
+      if (events [i].data.fd == serverFd)
+	clientAccept (epollFd, notify) ;
+      else if ((unixFd != -1) && (events [i].data.fd == unixFd))
+	unixAccept (epollFd, notify) ;
+      else if ((udpFd != -1) && (events [i].data.fd == udpFd))
+	udpData (recordSize) ;
+      else if ((tickFd != -1) && (events [i].data.fd == tickFd))
+      {
+	uint64_t expirations ;
+
+	if ((read (tickFd, &expirations, sizeof (expirations)) == sizeof (expirations)) && (tickHandler != NULL))
+	  tickHandler () ;
+      }
+      else if ((client = clientFind (events [i].data.fd)) != NULL)
+	clientData (epollFd, client, password, recordSize, handler, notify) ;
+    }
+  }
+}
+
+
 /*
  * closeServer:
  *********************************************************************************
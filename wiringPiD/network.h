@@ -29,3 +29,19 @@ extern int   sendChallenge (int clientFd) ;
 extern int   getResponse   (int clientFd) ;
 extern int   passwordMatch (const char *password) ;
 extern void  closeServer   (int clientFd) ;
+
+// The epoll multi-client server - handler gets each complete command
+//	record, notify (may be NULL) gets one-line progress messages.
+
+extern int   clientQueueReply    (int fd, const void *record, int len) ;
+extern void  clientSetRecordSize (int fd, int size) ;
+extern int   serverSessionToken  (uint32_t *hi, uint32_t *lo) ;
+
+extern int   serverSetTick       (unsigned int ms, void (*handler)(void)) ;
+
+extern int   serverEnableUdp     (void (*handler)(void *record)) ;
+extern int   serverEnableUnix    (const char *path, int allowedUid) ;
+extern int   serverEnableShmRing (const char *name, void (*handler)(void *record)) ;
+extern int   runMultiServer (int serverPort, const char *password, int recordSize,
+		int (*handler)(int fd, void *record), void (*notify)(const char *message),
+		void (*closed)(int fd)) ;
@@ -29,10 +29,12 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 //#include <stdarg.h>
 
 #include <wiringPi.h>
 #include <wpiExtensions.h>
+#include <drcNet.h>
 
 #include "drcNetCmd.h"
 #include "network.h"
@@ -43,82 +45,727 @@
 int noLocalPins = FALSE ;
 
 
-void runRemoteCommands (int fd)
+// Edge subscriptions:
+//	A client asks once (DRCN_SUBSCRIBE) and the daemon attaches
+//	wiringPiISR2 to the pin, pushing a timestamped DRCN_EVENT record
+//	down the client's socket from the ISR thread on every edge - so
+//	remote input monitoring costs nothing while idle instead of a
+//	polling read per pin per interval.
+
+#define	MAX_SUBSCRIPTIONS	32
+
+struct drcSubscription
 {
-  register uint32_t pin ;
-  int len ;
-  struct drcNetComStruct cmd ;
+  int fd ;		// -1: slot free
+  int pin ;
+} ;
 
-  len = sizeof (struct drcNetComStruct) ;
+static struct drcSubscription subscriptions [MAX_SUBSCRIPTIONS] =
+	{ [0 ... MAX_SUBSCRIPTIONS - 1] = { .fd = -1 } } ;
 
-  if (setsockopt (fd, SOL_SOCKET, SO_RCVLOWAT, (void *)&len, sizeof (len)) < 0)
+
+// Coalesced sync (DRCN_SYNC):
+//	Per-client delta accumulators. While a client has a window set
+//	its subscriptions stop sending one DRCN_EVENT per edge - the ISR
+//	threads just mark the pin here and the epoll tick (serverSetTick)
+//	flushes one changed-mask/values record per dirty 32-pin bank per
+//	window, so a bursty bank costs one small packet per window no
+//	matter how fast it toggles.
+
+#define	MAX_SYNC_CLIENTS	8
+#define	SYNC_TICK_MS		10
+#define	SYNC_MAX_WINDOW_MS	10000
+
+struct drcSyncState
+{
+  int fd ;			// -1: slot free
+  unsigned int windowMs ;
+  unsigned int elapsedMs ;	// Since the last flush
+  uint64_t changed ;		// Both under syncLock
+  uint64_t values ;
+} ;
+
+static struct drcSyncState syncStates [MAX_SYNC_CLIENTS] =
+	{ [0 ... MAX_SYNC_CLIENTS - 1] = { .fd = -1 } } ;
+static pthread_mutex_t syncLock = PTHREAD_MUTEX_INITIALIZER ;
+
+
+static struct drcSyncState *syncFind (int fd)
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_SYNC_CLIENTS ; ++i)
+    if (syncStates [i].fd == fd)
+      return &syncStates [i] ;
+
+  return NULL ;
+}
+
+
+// The tick handler: runs on the epoll thread, so queueing the frames
+//	through the normal reply path is safe.
+
+static void syncFlush (void)
+{
+  struct drcSyncState *s ;
+  struct drcNetComStruct rec ;
+  uint64_t changed, values ;
+  int i, bank ;
+
+  for (i = 0 ; i < MAX_SYNC_CLIENTS ; ++i)
+  {
+    s = &syncStates [i] ;
+    if (s->fd == -1)
+      continue ;
+    if ((s->elapsedMs += SYNC_TICK_MS) < s->windowMs)
+      continue ;
+    s->elapsedMs = 0 ;
+
+    pthread_mutex_lock (&syncLock) ;
+      changed = s->changed ;
+      values  = s->values ;
+      s->changed = 0 ;
+    pthread_mutex_unlock (&syncLock) ;
+
+    if (changed == 0)		// Quiet window - nothing on the wire
+      continue ;
+
+    for (bank = 0 ; bank < 2 ; ++bank)
+      if ((uint32_t)(changed >> (bank * 32)) != 0)
+      {
+	rec.cmd  = DRCN_SYNC | ((uint32_t)bank << 16) ;
+	rec.pin  = (uint32_t)(changed >> (bank * 32)) ;
+	rec.data = (uint32_t)(values  >> (bank * 32)) ;
+	(void)clientQueueReply (s->fd, &rec, sizeof (rec)) ;
+      }
+  }
+}
+
+
+static int syncSet (int fd, unsigned int windowMs)
+{
+  struct drcSyncState *s ;
+  int i, active ;
+
+  if (windowMs == 0)
+  {
+    if ((s = syncFind (fd)) != NULL)
+      s->fd = -1 ;
+  }
+  else
+  {
+    if (windowMs < SYNC_TICK_MS)
+      windowMs = SYNC_TICK_MS ;
+    else if (windowMs > SYNC_MAX_WINDOW_MS)
+      windowMs = SYNC_MAX_WINDOW_MS ;
+
+    if ((s = syncFind (fd)) == NULL)
+    {
+      for (i = 0 ; i < MAX_SYNC_CLIENTS ; ++i)
+	if (syncStates [i].fd == -1)
+	{
+	  s = &syncStates [i] ;
+	  break ;
+	}
+      if (s == NULL)
+	return FALSE ;
+      s->changed = 0 ;
+      s->values  = 0 ;
+      s->fd      = fd ;
+    }
+    s->windowMs  = windowMs ;
+    s->elapsedMs = 0 ;
+  }
+
+// The tick runs while anyone is in sync mode
+
+  active = FALSE ;
+  for (i = 0 ; i < MAX_SYNC_CLIENTS ; ++i)
+    if (syncStates [i].fd != -1)
+      active = TRUE ;
+
+  if (serverSetTick (active ? SYNC_TICK_MS : 0, syncFlush) < 0)
+  {
+    if (s != NULL)
+      s->fd = -1 ;	// No tick, no sync - fall back to plain events
+    return FALSE ;
+  }
+
+  return TRUE ;
+}
+
+
+static void subscriptionEvent (struct WPIWfiStatus status, void *userdata)
+{
+  struct drcSubscription *sub = (struct drcSubscription *)userdata ;
+  struct drcSyncState *s ;
+  struct drcNetComStruct event ;
+  uint64_t bit ;
+
+  if (sub->fd == -1)		// Unsubscribed under us
     return ;
 
-  for (;;)
+// A sync-mode client accumulates instead (the fd test races with
+//	teardown exactly like the one above - worst case is one stray
+//	frame). Extension pins don't fit the mask: per-edge as before.
+
+  if ((sub->pin >= 0) && (sub->pin < 64) && ((s = syncFind (sub->fd)) != NULL))
   {
-    if (recv (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))	// Probably remote hangup
-      return ;
+    bit = 1ULL << sub->pin ;
+    pthread_mutex_lock (&syncLock) ;
+      s->changed |= bit ;
+      if (status.edge == INT_EDGE_RISING)
+	s->values |=  bit ;
+      else
+	s->values &= ~bit ;
+    pthread_mutex_unlock (&syncLock) ;
+    return ;
+  }
+
+  event.cmd  = DRCN_EVENT ;
+  event.pin  = (sub->pin & 0xFFFF) | ((status.edge == INT_EDGE_RISING) ? (1 << 16) : 0) ;
+  event.data = (uint32_t)status.timeStamp_us ;
+
+  (void)send (sub->fd, &event, sizeof (event), 0) ;
+}
+
+
+static int subscriptionAdd (int fd, int pin, int mode)
+{
+  int i, slot = -1 ;
 
-    pin = cmd.pin ;
-    if (noLocalPins && ((pin & PI_GPIO_MASK) == 0))
+  if ((mode != INT_EDGE_FALLING) && (mode != INT_EDGE_RISING) && (mode != INT_EDGE_BOTH))
+    return FALSE ;
+
+  for (i = 0 ; i < MAX_SUBSCRIPTIONS ; ++i)
+  {
+    if ((subscriptions [i].fd != -1) && (subscriptions [i].pin == pin))
+      return FALSE ;		// The ISR is per-pin - one subscriber each
+    if ((subscriptions [i].fd == -1) && (slot == -1))
+      slot = i ;
+  }
+
+  if (slot == -1)
+    return FALSE ;
+
+  subscriptions [slot].fd  = fd ;
+  subscriptions [slot].pin = pin ;
+
+  if (wiringPiISR2 (pin, mode, subscriptionEvent, 0, &subscriptions [slot]) < 0)
+  {
+    subscriptions [slot].fd = -1 ;
+    return FALSE ;
+  }
+
+  return TRUE ;
+}
+
+
+static void subscriptionRemove (int fd, int pin)	// pin -1: everything this client has
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_SUBSCRIPTIONS ; ++i)
+    if ((subscriptions [i].fd == fd) && ((pin == -1) || (subscriptions [i].pin == pin)))
     {
-      if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	return ;
-      continue ;
+      subscriptions [i].fd = -1 ;
+      (void)wiringPiISRStop (subscriptions [i].pin) ;
     }
+}
+
+
+// Macros:
+//	Bounded server-side command lists (see drcNetCmd.h). A sequence
+//	like pulse-SSR, wait 20ms, read-ACK used to take three network
+//	round trips; stored as a macro it runs here in the command thread
+//	with local GPIO latency and one aggregated reply, so its internal
+//	timing is immune to network jitter. The epoll loop dispatches one
+//	record at a time, so a running macro can't be interleaved with
+//	another client's commands.
+
+struct drcMacro
+{
+  int numSteps ;		// 0: empty slot
+  struct drcNetComStruct steps [DRCN_MACRO_MAX_STEPS] ;
+} ;
+
+static struct drcMacro macros [DRCN_MACRO_MAX] ;
+
+// An upload in progress: records from this fd are stored, not executed,
+//	until the announced count has arrived.
+
+#define	MAX_MACRO_LOADS	8
+
+struct drcMacroLoad
+{
+  int fd ;		// -1: slot free
+  int id ;
+  int expect ;
+  int got ;
+  int bad ;		// Saw an invalid step - swallow the rest, then reject
+} ;
+
+static struct drcMacroLoad macroLoads [MAX_MACRO_LOADS] =
+	{ [0 ... MAX_MACRO_LOADS - 1] = { .fd = -1 } } ;
+
+
+static int macroStepValid (const struct drcNetComStruct *step)
+{
+  switch (step->cmd)
+  {
+    case DRCN_PIN_MODE:
+    case DRCN_PULL_UP_DN:
+    case DRCN_DIGITAL_WRITE:
+    case DRCN_PWM_WRITE:
+    case DRCN_ANALOG_WRITE:
+    case DRCN_MACRO_READ:
+    case DRCN_MACRO_SKIP_IF:
+      return TRUE ;
+    case DRCN_MACRO_DELAY:
+      return step->data <= 1000000 ;	// Keep the command thread responsive
+    default:
+      return FALSE ;
+  }
+}
+
+static int macroLoadBegin (int fd, int id, int numSteps)
+{
+  int i ;
+
+  if ((id < 0) || (id >= DRCN_MACRO_MAX) || (numSteps < 1) || (numSteps > DRCN_MACRO_MAX_STEPS))
+    return FALSE ;
 
-    switch (cmd.cmd)
+  for (i = 0 ; i < MAX_MACRO_LOADS ; ++i)
+    if (macroLoads [i].fd == -1)
     {
-      case DRCN_PIN_MODE:
-	pinMode (pin, cmd.data) ;
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
-	break ;
+      macroLoads [i].fd     = fd ;
+      macroLoads [i].id     = id ;
+      macroLoads [i].expect = numSteps ;
+      macroLoads [i].got    = 0 ;
+      macroLoads [i].bad    = FALSE ;
+      macros [id].numSteps  = 0 ;	// Old contents die with the upload
+      return TRUE ;
+    }
 
-      case DRCN_PULL_UP_DN:
-	pullUpDnControl (pin, cmd.data) ;
-	break ;
+  return FALSE ;
+}
 
-      case DRCN_PWM_WRITE:
-	pwmWrite (pin, cmd.data) ;
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
-	break ;
+static struct drcMacroLoad *macroLoadFind (int fd)
+{
+  int i ;
 
-      case DRCN_DIGITAL_WRITE:
-	digitalWrite (pin, cmd.data) ;
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
-	break ;
+  for (i = 0 ; i < MAX_MACRO_LOADS ; ++i)
+    if (macroLoads [i].fd == fd)
+      return &macroLoads [i] ;
 
-      case DRCN_DIGITAL_WRITE8:
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
-	break ;
+  return NULL ;
+}
 
-      case DRCN_DIGITAL_READ:
-	cmd.data = digitalRead (pin) ;
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
-	break ;
+static void macroLoadAbort (int fd)
+{
+  struct drcMacroLoad *load = macroLoadFind (fd) ;
 
-      case DRCN_DIGITAL_READ8:
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
+  if (load != NULL)
+    load->fd = -1 ;
+}
+
+// Returns TRUE when the upload is finished (good or bad) and the reply
+//	should go out; *ok says which it was.
+
+static int macroLoadStep (struct drcMacroLoad *load, const struct drcNetComStruct *step, int *ok)
+{
+  if (!macroStepValid (step))
+    load->bad = TRUE ;
+  else if (!load->bad)
+    macros [load->id].steps [load->got] = *step ;
+
+  if (++load->got < load->expect)
+    return FALSE ;
+
+  if (!load->bad)
+    macros [load->id].numSteps = load->expect ;
+  *ok = !load->bad ;
+  load->fd = -1 ;
+  return TRUE ;
+}
+
+static uint32_t macroRun (int id)
+{
+  struct drcMacro *m ;
+  struct drcNetComStruct *step ;
+  uint32_t result = 0 ;
+  int i ;
+
+  if ((id < 0) || (id >= DRCN_MACRO_MAX))
+    return 0 ;
+
+  m = &macros [id] ;
+  for (i = 0 ; i < m->numSteps ; ++i)
+  {
+    step = &m->steps [i] ;
+    if (noLocalPins && ((step->pin & PI_GPIO_MASK) == 0))
+      continue ;
+
+    switch (step->cmd)
+    {
+      case DRCN_PIN_MODE:	pinMode         (step->pin, step->data) ;	break ;
+      case DRCN_PULL_UP_DN:	pullUpDnControl (step->pin, step->data) ;	break ;
+      case DRCN_DIGITAL_WRITE:	digitalWrite    (step->pin, step->data) ;	break ;
+      case DRCN_PWM_WRITE:	pwmWrite        (step->pin, step->data) ;	break ;
+      case DRCN_ANALOG_WRITE:	analogWrite     (step->pin, step->data) ;	break ;
+
+      case DRCN_MACRO_DELAY:
+	delayMicroseconds (step->data) ;
 	break ;
 
-      case DRCN_ANALOG_WRITE:
-	analogWrite (pin, cmd.data) ;
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
+      case DRCN_MACRO_READ:
+	result = (result << 1) | (digitalRead (step->pin) & 1) ;
 	break ;
 
-      case DRCN_ANALOG_READ:
-	cmd.data = analogRead (pin) ;
-	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
-	  return ;
+      case DRCN_MACRO_SKIP_IF:
+	if ((uint32_t)digitalRead (step->pin) == step->data)
+	  ++i ;
 	break ;
     }
   }
 
+  return result ;
+}
+
+
+// Compact mode:
+//	Which clients have switched to the 4-byte records (see
+//	drcNetCmd.h). The framing itself lives in network.c
+//	(clientSetRecordSize) - this list is how the dispatcher knows
+//	what a record from each fd looks like.
+
+#define	MAX_COMPACT	64
+
+static int compactFds [MAX_COMPACT] = { [0 ... MAX_COMPACT - 1] = -1 } ;
+
+static int compactFind (int fd)
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_COMPACT ; ++i)
+    if (compactFds [i] == fd)
+      return i ;
+
+  return -1 ;
+}
+
+static int compactSet (int fd, int on)
+{
+  int i ;
+
+  if (!on)
+  {
+    if ((i = compactFind (fd)) != -1)
+      compactFds [i] = -1 ;
+    clientSetRecordSize (fd, (int)sizeof (struct drcNetComStruct)) ;
+    return TRUE ;
+  }
+
+  if (compactFind (fd) != -1)
+    return TRUE ;
+
+  for (i = 0 ; i < MAX_COMPACT ; ++i)
+    if (compactFds [i] == -1)
+    {
+      compactFds [i] = fd ;
+      clientSetRecordSize (fd, (int)sizeof (struct drcNetComCompact)) ;
+      return TRUE ;
+    }
+
+  return FALSE ;
+}
+
+
+/*
+ * runRemoteCompactCommand:
+ *	The 4-byte record dispatcher - just the stateless pin commands,
+ *	each record echoed as its own reply. The op range is dense so
+ *	the switch compiles to an indexed jump; there's nothing left to
+ *	parse beyond picking the op byte out.
+ *********************************************************************************
+ */
+
+static int runRemoteCompactCommand (int fd, struct drcNetComCompact *cmd)
+{
+  register uint32_t pin = cmd->pin ;
+
+  if (noLocalPins && ((pin & PI_GPIO_MASK) == 0))
+  {
+    cmd->data = 0xFFFF ;
+    return clientQueueReply (fd, cmd, sizeof (*cmd)) ;
+  }
+
+  switch (cmd->cmd)
+  {
+    case DRCN_PIN_MODE:		pinMode         (pin, cmd->data) ;	break ;
+    case DRCN_PULL_UP_DN:	pullUpDnControl (pin, cmd->data) ;	break ;
+    case DRCN_DIGITAL_WRITE:	digitalWrite    (pin, cmd->data) ;	break ;
+    case DRCN_PWM_WRITE:	pwmWrite        (pin, cmd->data) ;	break ;
+    case DRCN_ANALOG_WRITE:	analogWrite     (pin, cmd->data) ;	break ;
+    case DRCN_DIGITAL_READ:	cmd->data = (uint16_t)digitalRead (pin) ;	break ;
+    case DRCN_ANALOG_READ:	cmd->data = (uint16_t)analogRead  (pin) ;	break ;
+
+    case DRCN_COMPACT:		// data 0: back to full records
+      (void)compactSet (fd, cmd->data != 0) ;
+      break ;
+
+    default:
+      cmd->data = 0xFFFF ;
+      break ;
+  }
+
+  return clientQueueReply (fd, cmd, sizeof (*cmd)) ;
+}
+
+
+/*
+ * runRemoteClientClosed:
+ *	A client connection has gone away - tear down anything it was
+ *	subscribed to before the fd gets reused.
+ *********************************************************************************
+ */
+
+void runRemoteClientClosed (int fd)
+{
+  int i ;
+
+  subscriptionRemove (fd, -1) ;
+  (void)syncSet (fd, 0) ;
+  macroLoadAbort (fd) ;
+
+  if ((i = compactFind (fd)) != -1)
+    compactFds [i] = -1 ;
+}
+
+
+/*
+ * runRemoteCommand:
+ *	Execute a single decoded command for the given client, sending the
+ *	reply (where the command has one) back down its socket.
+ *	Returns 0, or -1 if the reply couldn't be sent and the caller
+ *	should drop the client.
+ *********************************************************************************
+ */
+
+int runRemoteCommand (int fd, void *data)
+{
+  struct drcNetComStruct *cmd = (struct drcNetComStruct *)data ;
+  struct drcMacroLoad *load ;
+  register uint32_t pin = cmd->pin ;
+  int ok ;
+
+// A compact-mode client's records have the short layout
+
+  if (compactFind (fd) != -1)
+    return runRemoteCompactCommand (fd, (struct drcNetComCompact *)data) ;
+
+// A macro upload in progress swallows the stream until its count is in
+
+  if ((load = macroLoadFind (fd)) != NULL)
+  {
+    if (!macroLoadStep (load, cmd, &ok))
+      return 0 ;
+    cmd->cmd  = DRCN_MACRO_BEGIN ;
+    cmd->pin  = load->id ;
+    cmd->data = ok ? 1 : 0 ;
+    return clientQueueReply (fd, cmd, sizeof (*cmd)) ;
+  }
+
+// Broadcast fan-out to our downstream drcn nodes - the write op rides
+//	in the high half of cmd, pin is the offset within each node's
+//	range, and the reply carries the number of nodes reached. Checked
+//	before the local-pin guard: the offset isn't a local pin.
+
+  if ((cmd->cmd & 0xFFFF) == DRCN_BROADCAST)
+  {
+    int reached = drcNetBroadcast ((int)pin, (int)(cmd->cmd >> 16), cmd->data) ;
+
+    cmd->data = (reached < 0) ? 0 : (uint32_t)reached ;
+    return clientQueueReply (fd, cmd, sizeof (*cmd)) ;
+  }
+
+  if (noLocalPins && ((pin & PI_GPIO_MASK) == 0) &&
+      (cmd->cmd != DRCN_MACRO_BEGIN) && (cmd->cmd != DRCN_MACRO_RUN) && (cmd->cmd != DRCN_MACRO_DROP))
+    return clientQueueReply (fd, cmd, sizeof (*cmd)) ;
+
+  switch (cmd->cmd)
+  {
+    case DRCN_PIN_MODE:
+      pinMode (pin, cmd->data) ;
+      break ;
+
+    case DRCN_PULL_UP_DN:
+      pullUpDnControl (pin, cmd->data) ;
+      return 0 ;	// Never had a reply
+
+    case DRCN_PWM_WRITE:
+      pwmWrite (pin, cmd->data) ;
+      break ;
+
+    case DRCN_DIGITAL_WRITE:
+      digitalWrite (pin, cmd->data) ;
+      break ;
+
+    case DRCN_DIGITAL_WRITE8:
+      break ;
+
+    case DRCN_DIGITAL_READ:
+      cmd->data = digitalRead (pin) ;
+      break ;
+
+    case DRCN_DIGITAL_READ8:
+      break ;
+
+    case DRCN_ANALOG_WRITE:
+      analogWrite (pin, cmd->data) ;
+      break ;
+
+    case DRCN_ANALOG_READ:
+      cmd->data = analogRead (pin) ;
+      break ;
+
+    case DRCN_SUBSCRIBE:
+      cmd->data = subscriptionAdd (fd, pin, cmd->data) ? 1 : 0 ;
+      break ;
+
+    case DRCN_UNSUBSCRIBE:
+      subscriptionRemove (fd, pin) ;
+      break ;
+
+    case DRCN_SYNC:
+      cmd->data = syncSet (fd, cmd->data) ? 1 : 0 ;
+      break ;
+
+    case DRCN_MACRO_BEGIN:
+      if (!macroLoadBegin (fd, (int)pin, (int)cmd->data))
+      {
+	cmd->data = 0 ;		// Rejected up front - reply now
+	break ;
+      }
+      return 0 ;		// Reply goes out when the steps are in
+
+    case DRCN_MACRO_RUN:
+      cmd->data = macroRun ((int)pin) ;
+      break ;
+
+    case DRCN_MACRO_DROP:
+      if (((int)pin >= 0) && ((int)pin < DRCN_MACRO_MAX))
+	macros [pin].numSteps = 0 ;
+      break ;
+
+    case DRCN_COMPACT:
+      if (cmd->data != 0)
+	cmd->data = compactSet (fd, TRUE) ? 1 : 0 ;	// This reply is still full-size
+      else
+	(void)compactSet (fd, FALSE) ;
+      break ;
+
+    case DRCN_SESSION:
+      if (serverSessionToken (&cmd->pin, &cmd->data) < 0)
+	cmd->pin = cmd->data = 0 ;	// No token to be had - full auth next time
+      break ;
+
+    default:
+      return 0 ;	// Unknown: swallow it rather than de-sync the stream
+  }
+
+  return clientQueueReply (fd, cmd, sizeof (*cmd)) ;
+}
+
+
+/*
+ * runRemoteWriteCommand:
+ *	The datagram path: execute a record if (and only if) it's an
+ *	idempotent write - no reply ever goes back, so a re-sent state
+ *	sync just writes the same values again.
+ *********************************************************************************
+ */
+
+void runRemoteWriteCommand (void *data)
+{
+  struct drcNetComStruct *cmd = (struct drcNetComStruct *)data ;
+  register uint32_t pin = cmd->pin ;
+
+  if (noLocalPins && ((pin & PI_GPIO_MASK) == 0))
+    return ;
+
+  switch (cmd->cmd)
+  {
+    case DRCN_PIN_MODE:		pinMode         (pin, cmd->data) ;	break ;
+    case DRCN_PULL_UP_DN:	pullUpDnControl (pin, cmd->data) ;	break ;
+    case DRCN_DIGITAL_WRITE:	digitalWrite    (pin, cmd->data) ;	break ;
+    case DRCN_PWM_WRITE:	pwmWrite        (pin, cmd->data) ;	break ;
+    case DRCN_ANALOG_WRITE:	analogWrite     (pin, cmd->data) ;	break ;
+  }
+}
+
+
+/*
+ * runRemoteRingCommand:
+ *	The shared-memory ring path: execute the record in place, leaving
+ *	the response in it - the ring thread publishes it back. Only the
+ *	stateless pin commands run here; subscriptions need a socket to
+ *	push events down and the macro store belongs to the epoll thread,
+ *	so anything else answers data -1.
+ *********************************************************************************
+ */
+
+void runRemoteRingCommand (void *data)
+{
+  struct drcNetComStruct *cmd = (struct drcNetComStruct *)data ;
+  register uint32_t pin = cmd->pin ;
+
+  if (noLocalPins && ((pin & PI_GPIO_MASK) == 0))
+  {
+    cmd->data = (uint32_t)-1 ;
+    return ;
+  }
+
+  switch (cmd->cmd)
+  {
+    case DRCN_PIN_MODE:		pinMode         (pin, cmd->data) ;	break ;
+    case DRCN_PULL_UP_DN:	pullUpDnControl (pin, cmd->data) ;	break ;
+    case DRCN_DIGITAL_WRITE:	digitalWrite    (pin, cmd->data) ;	break ;
+    case DRCN_PWM_WRITE:	pwmWrite        (pin, cmd->data) ;	break ;
+    case DRCN_ANALOG_WRITE:	analogWrite     (pin, cmd->data) ;	break ;
+    case DRCN_DIGITAL_READ:	cmd->data = digitalRead (pin) ;		break ;
+    case DRCN_ANALOG_READ:	cmd->data = analogRead  (pin) ;		break ;
+
+    default:
+      cmd->data = (uint32_t)-1 ;
+      break ;
+  }
+}
+
+
+/*
+ * runRemoteCommands:
+ *	Classic blocking single-client loop - read a command, run it,
+ *	repeat until the remote hangs up.
+ *********************************************************************************
+ */
+
+void runRemoteCommands (int fd)
+{
+  int len ;
+  struct drcNetComStruct cmd ;
+
+  len = sizeof (struct drcNetComStruct) ;
+
+  if (setsockopt (fd, SOL_SOCKET, SO_RCVLOWAT, (void *)&len, sizeof (len)) < 0)
+    return ;
+
+  for (;;)
+  {
+    if (recv (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))	// Probably remote hangup
+      return ;
+
+    if (runRemoteCommand (fd, &cmd) < 0)
+      return ;
+  }
 }
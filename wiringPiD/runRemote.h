@@ -26,4 +26,8 @@
 
 extern int noLocalPins ;
 
-extern void runRemoteCommands (int fd) ;
+extern int  runRemoteCommand     (int fd, void *data) ;
+extern void runRemoteWriteCommand (void *data) ;
+extern void runRemoteRingCommand (void *data) ;
+extern void runRemoteCommands    (int fd) ;
+extern void runRemoteClientClosed (int fd) ;
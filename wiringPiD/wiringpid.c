@@ -45,7 +45,7 @@
 
 // Globals
 
-static const char *usage = "[-h] [-d] [-g | -1 | -z] [[-x extension:pin:params] ...] password" ;
+static const char *usage = "[-h] [-d] [-u] [-U [path][:uid]] [-S [name]] [-g | -1 | -z] [[-x extension:pin:params] ...] password" ;
 static int doDaemon = FALSE ;
 
 //
@@ -65,6 +65,11 @@ static void logMsg (const char *message, ...)
     printf ("%s\n", buffer) ;
 }
 
+static void serverNotify (const char *message)
+{
+  logMsg ("%s", message) ;
+}
+
 
 /*
  * sigHandler:
@@ -124,7 +129,6 @@ void setupSigHandler (void)
 
 int main (int argc, char *argv [])
 {
-  int clientFd ;
   char *p, *password ;
   int i ;
   int port = DEFAULT_SERVER_PORT ;
@@ -221,6 +225,97 @@ int main (int argc, char *argv [])
       continue ;
     }
 
+//	-u - also accept unauthenticated UDP write datagrams.
+//		Trusted networks only - there's no password on this path.
+
+    if (strcmp (argv [1], "-u") == 0)	// Case matters: -U is the local socket
+    {
+      logMsg ("UDP write path enabled") ;
+      serverEnableUdp (runRemoteWriteCommand) ;
+
+      for (i = 2 ; i < argc ; ++i)
+	argv [i - 1] = argv [i] ;
+      --argc ;
+      continue ;
+    }
+
+//	-U [path][:uid] - also listen on a local Unix-domain socket.
+//		Local peers authenticate by identity (root, us, or the
+//		given uid) - no password. Empty path: the default one.
+
+    if (strcmp (argv [1], "-U") == 0)
+    {
+      const char *path = DEFAULT_UNIX_SOCKET ;
+      int allowedUid = -1 ;
+      char *colon ;
+
+      if (argc < 3)
+      {
+	logMsg ("-U missing socket path") ;
+	exit (EXIT_FAILURE) ;
+      }
+
+      if ((colon = strchr (argv [2], ':')) != NULL)
+      {
+	*colon = 0 ;
+	allowedUid = atoi (colon + 1) ;
+      }
+      if (argv [2][0] != 0)
+	path = argv [2] ;
+
+      logMsg ("Local socket: %s", path) ;
+
+      if (serverEnableUnix (path, allowedUid) < 0)
+      {
+	logMsg ("Invalid socket path: %s", path) ;
+	exit (EXIT_FAILURE) ;
+      }
+
+// Shift args down by 2
+
+      for (i = 3 ; i < argc ; ++i)
+	argv [i - 2] = argv [i] ;
+      argc -= 2 ;
+
+      continue ;
+    }
+
+//	-S [name] - also serve a shared-memory command ring.
+//		A co-located client maps the segment and issues pin
+//		commands in about a microsecond without touching the
+//		network stack; opening the 0660 segment is the
+//		authentication. Empty name: the default one.
+
+    if (strcmp (argv [1], "-S") == 0)
+    {
+      const char *name = DEFAULT_SHM_RING ;
+
+      if (argc < 3)
+      {
+	logMsg ("-S missing ring name") ;
+	exit (EXIT_FAILURE) ;
+      }
+
+      if (argv [2][0] != 0)
+	name = argv [2] ;
+
+      logMsg ("Shared-memory ring: %s", name) ;
+
+      if (serverEnableShmRing (name, runRemoteRingCommand) < 0)
+      {
+	logMsg ("Invalid ring name: %s", name) ;
+	exit (EXIT_FAILURE) ;
+      }
+
+// Shift args down by 2
+
+      for (i = 3 ; i < argc ; ++i)
+	argv [i - 2] = argv [i] ;
+      argc -= 2 ;
+
+      continue ;
+    }
+
 // -p to select the port
 
     if (strcasecmp (argv [1], "-p") == 0)
@@ -318,64 +413,16 @@ int main (int argc, char *argv [])
     *p = ' ' ;
 
   setupSigHandler () ;
- 
-// Enter our big loop
-
-  for (;;)
-  {
-
-    if (!doDaemon)
-      printf ("-=-\nWaiting for a new connection...\n") ;
-
-    if ((clientFd = setupServer (port)) < 0)
-    {
-      logMsg ("Unable to setup server: %s", strerror (errno)) ;
-      exit (EXIT_FAILURE) ;
-    }
-
-    logMsg ("New connection from: %s.", getClientIP ()) ;
-
-    if (!doDaemon)
-      printf ("Sending Greeting.\n") ;
-
-    if (sendGreeting (clientFd) < 0)
-    {
-      logMsg ("Unable to send greeting message: %s", strerror (errno)) ;
-      closeServer (clientFd) ;
-      continue ;
-    }
-
-    if (!doDaemon)
-      printf ("Sending Challenge.\n") ;
-
-    if (sendChallenge (clientFd) < 0)
-    {
-      logMsg ("Unable to send challenge message: %s", strerror (errno)) ;
-      closeServer (clientFd) ;
-      continue ;
-    }
 
-    if (!doDaemon)
-      printf ("Waiting for response.\n") ;
+// Enter our big loop - the epoll server only returns on a fatal error,
+//	handling every client concurrently
 
-    if (getResponse (clientFd) < 0)
-    {
-      logMsg ("Connection closed waiting for response: %s", strerror (errno)) ;
-      closeServer (clientFd) ;
-      continue ;
-    }
+  logMsg ("Listening on port %d", port) ;
 
-    if (!passwordMatch (password))
-    {
-      logMsg ("Password failure") ;
-      closeServer (clientFd) ;
-      continue ;
-    }
-
-    logMsg ("Password OK - Starting") ;
-
-    runRemoteCommands (clientFd) ;
-    closeServer       (clientFd) ;
+  if (runMultiServer (port, password, sizeof (struct drcNetComStruct), runRemoteCommand, serverNotify, runRemoteClientClosed) < 0)
+  {
+    logMsg ("Server failed: %s", strerror (errno)) ;
+    exit (EXIT_FAILURE) ;
   }
 
   return 0 ;